@@ -27,6 +27,36 @@ class GameState {
         virtual void copyFrom( GameState *inOther ) = 0;
 
         virtual void printState() = 0;
+
+
+        
+        // Optional extensions used by parallelMinMax.h.
+        // States that don't override them still work, just slower.
+
+
+        // key identifying this position, including the side to move,
+        // for transposition tables (Zobrist hashing works well)
+        // 0 means "no key", and disables table lookups for this state
+        virtual unsigned long long getHashKey() {
+            return 0;
+            }
+        
+
+        // number of moves available from this state, or -1 if
+        // applyMove is not supported
+        // if supported, getNumPossibleMoves and applyMove must index
+        // moves in the same order as getPossibleMoves
+        virtual int getNumPossibleMoves() {
+            return -1;
+            }
+        
+
+        // turns this state into the result of taking the move with the
+        // given index
+        // lets a search recycle child states through copyFrom instead
+        // of allocating new ones
+        virtual void applyMove( int ) {
+            }
         
     };
 
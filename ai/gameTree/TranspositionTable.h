@@ -0,0 +1,143 @@
+#ifndef TRANSPOSITION_TABLE_INCLUDED
+#define TRANSPOSITION_TABLE_INCLUDED
+
+
+#include <string.h>
+
+
+
+enum TranspositionBound {
+    boundExact = 0,
+    // score is a lower bound (search failed high)
+    boundLower = 1,
+    // score is an upper bound (search failed low)
+    boundUpper = 2 };
+
+
+
+typedef struct TranspositionEntry {
+        int score;
+        int depth;
+        TranspositionBound bound;
+        // index of best move found, or -1
+        int bestMove;
+    } TranspositionEntry;
+
+
+
+/**
+ * Fixed-size, lock-free transposition table for game tree searches.
+ *
+ * Uses the "lockless hashing" trick:  each slot holds the key XORed with
+ * the packed entry data, plus the data itself.  A slot torn by two threads
+ * writing at once fails the key check on probe and reads as a miss, so
+ * no locks are needed around probe or store.
+ */
+class TranspositionTable {
+
+    public:
+
+
+        /**
+         * @param inSizeLog2 table holds 2^inSizeLog2 slots of 16 bytes.
+         */
+        TranspositionTable( int inSizeLog2 = 20 )
+                : mNumSlots( 1 << inSizeLog2 ),
+                  mMask( ( 1 << inSizeLog2 ) - 1 ),
+                  mSlots( new Slot[ 1 << inSizeLog2 ] ) {
+            clear();
+            }
+
+
+        ~TranspositionTable() {
+            delete [] mSlots;
+            }
+
+
+        void clear() {
+            memset( (void*)mSlots, 0, sizeof( Slot ) * mNumSlots );
+            }
+
+
+        // inKey must be non-zero
+        // returns true if found, filling outEntry
+        char probe( unsigned long long inKey, TranspositionEntry *outEntry ) {
+            Slot *s = &( mSlots[ inKey & mMask ] );
+
+            unsigned long long keyXorData = s->keyXorData;
+            unsigned long long data = s->data;
+
+            if( ( keyXorData ^ data ) != inKey ) {
+                return false;
+                }
+
+            unpack( data, outEntry );
+            return true;
+            }
+
+
+        // replaces whatever is in the slot unless the slot holds the same
+        // position searched to a greater depth
+        void store( unsigned long long inKey, TranspositionEntry *inEntry ) {
+            Slot *s = &( mSlots[ inKey & mMask ] );
+
+            unsigned long long oldKeyXorData = s->keyXorData;
+            unsigned long long oldData = s->data;
+
+            if( ( oldKeyXorData ^ oldData ) == inKey ) {
+                TranspositionEntry old;
+                unpack( oldData, &old );
+
+                if( old.depth > inEntry->depth ) {
+                    return;
+                    }
+                }
+
+            unsigned long long data = pack( inEntry );
+
+            s->keyXorData = inKey ^ data;
+            s->data = data;
+            }
+
+
+
+    private:
+
+        typedef struct Slot {
+                volatile unsigned long long keyXorData;
+                volatile unsigned long long data;
+            } Slot;
+
+
+        // 32 bits score, 16 bits depth, 2 bits bound, 14 bits move + 1
+        static unsigned long long pack( TranspositionEntry *inEntry ) {
+            unsigned long long data =
+                (unsigned long long)(unsigned int)( inEntry->score );
+
+            data |= (unsigned long long)( inEntry->depth & 0xFFFF ) << 32;
+            data |= (unsigned long long)( inEntry->bound & 0x3 ) << 48;
+            data |=
+                (unsigned long long)( ( inEntry->bestMove + 1 ) & 0x3FFF )
+                << 50;
+            return data;
+            }
+
+
+        static void unpack( unsigned long long inData,
+                            TranspositionEntry *outEntry ) {
+            outEntry->score = (int)(unsigned int)( inData & 0xFFFFFFFF );
+            outEntry->depth = (int)( ( inData >> 32 ) & 0xFFFF );
+            outEntry->bound = (TranspositionBound)( ( inData >> 48 ) & 0x3 );
+            outEntry->bestMove = (int)( ( inData >> 50 ) & 0x3FFF ) - 1;
+            }
+
+
+        int mNumSlots;
+        unsigned long long mMask;
+
+        Slot *mSlots;
+    };
+
+
+
+#endif
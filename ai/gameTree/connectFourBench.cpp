@@ -0,0 +1,340 @@
+// Connect-four benchmark for minMax.h and parallelMinMax.h
+//
+// Usage:  connectFourBench [depth] [numThreads]
+//
+// Searches the same position with the plain recursive minMax, with
+// parallelMinMax on one thread, and with parallelMinMax across a thread
+// pool, then reports nodes per second for each.  Fails if either
+// parallelMinMax search scores its move differently than minMax scores
+// the move it picked.
+
+
+#include "minMax.h"
+#include "parallelMinMax.h"
+
+#include "minorGems/system/Time.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#define COLS 7
+#define ROWS 6
+
+#define WIN_SCORE 100000
+
+
+static unsigned long long zobrist[2][ COLS * ROWS ];
+
+
+static void initZobrist() {
+    // fixed xorshift sequence, so keys are the same on every run
+    unsigned long long x = 88172645463325252ULL;
+
+    for( int p=0; p<2; p++ ) {
+        for( int i=0; i<COLS*ROWS; i++ ) {
+            x ^= x << 13;
+            x ^= x >> 7;
+            x ^= x << 17;
+            zobrist[p][i] = x;
+            }
+        }
+    }
+
+
+// columns tried center first, which helps alpha-beta a lot
+static int columnOrder[ COLS ] = { 3, 2, 4, 1, 5, 0, 6 };
+
+
+
+class ConnectFourState : public GameState {
+    public:
+
+        ConnectFourState()
+                : mToMove( 0 ), mNumPlayed( 0 ), mKey( 1 ),
+                  mWinner( -1 ) {
+            memset( mCells, -1, sizeof( mCells ) );
+            memset( mHeights, 0, sizeof( mHeights ) );
+            }
+
+
+        virtual int getScore( char inDebug=false ) {
+            if( mWinner == 0 ) {
+                return WIN_SCORE - mNumPlayed;
+                }
+            if( mWinner == 1 ) {
+                return -WIN_SCORE + mNumPlayed;
+                }
+
+            // count four-windows still open for only one player
+            int score = 0;
+
+            for( int r=0; r<ROWS; r++ ) {
+                for( int c=0; c<COLS; c++ ) {
+                    score += windowScore( r, c, 0, 1 );
+                    score += windowScore( r, c, 1, 0 );
+                    score += windowScore( r, c, 1, 1 );
+                    score += windowScore( r, c, 1, -1 );
+                    }
+                }
+            return score;
+            }
+
+
+        virtual char getGameOver() {
+            return mWinner != -1 || mNumPlayed == COLS * ROWS;
+            }
+
+
+        virtual int getNumPossibleMoves() {
+            if( getGameOver() ) {
+                return 0;
+                }
+            int n = 0;
+            for( int c=0; c<COLS; c++ ) {
+                if( mHeights[c] < ROWS ) {
+                    n++;
+                    }
+                }
+            return n;
+            }
+
+
+        virtual void applyMove( int inMoveIndex ) {
+            int n = 0;
+            for( int k=0; k<COLS; k++ ) {
+                int c = columnOrder[k];
+                if( mHeights[c] < ROWS ) {
+                    if( n == inMoveIndex ) {
+                        drop( c );
+                        return;
+                        }
+                    n++;
+                    }
+                }
+            }
+
+
+        virtual SimpleVector<GameState *> getPossibleMoves() {
+            SimpleVector<GameState *> moves;
+
+            int n = getNumPossibleMoves();
+            for( int i=0; i<n; i++ ) {
+                GameState *s = copy();
+                s->applyMove( i );
+                moves.push_back( s );
+                }
+            return moves;
+            }
+
+
+        virtual unsigned long long getHashKey() {
+            return mKey;
+            }
+
+
+        virtual GameState *copy() {
+            ConnectFourState *s = new ConnectFourState();
+            s->copyFrom( this );
+            return s;
+            }
+
+
+        virtual void copyFrom( GameState *inOther ) {
+            ConnectFourState *other = (ConnectFourState *)inOther;
+
+            memcpy( mCells, other->mCells, sizeof( mCells ) );
+            memcpy( mHeights, other->mHeights, sizeof( mHeights ) );
+            mToMove = other->mToMove;
+            mNumPlayed = other->mNumPlayed;
+            mKey = other->mKey;
+            mWinner = other->mWinner;
+            }
+
+
+        virtual void printState() {
+            for( int r=ROWS-1; r>=0; r-- ) {
+                for( int c=0; c<COLS; c++ ) {
+                    char v = mCells[ r * COLS + c ];
+                    printf( "%c", v == -1 ? '.' : ( v == 0 ? 'X' : 'O' ) );
+                    }
+                printf( "\n" );
+                }
+            }
+
+
+        void drop( int inCol ) {
+            int r = mHeights[ inCol ];
+            int cell = r * COLS + inCol;
+
+            mCells[ cell ] = mToMove;
+            mHeights[ inCol ] ++;
+            mNumPlayed ++;
+            mKey ^= zobrist[ (int)mToMove ][ cell ];
+
+            if( checkWin( r, inCol ) ) {
+                mWinner = mToMove;
+                }
+            mToMove = 1 - mToMove;
+            }
+
+
+    private:
+
+        int windowScore( int inR, int inC, int inDR, int inDC ) {
+            int endR = inR + 3 * inDR;
+            int endC = inC + 3 * inDC;
+
+            if( endR < 0 || endR >= ROWS || endC < 0 || endC >= COLS ) {
+                return 0;
+                }
+
+            int counts[2] = { 0, 0 };
+            for( int i=0; i<4; i++ ) {
+                char v = mCells[ ( inR + i * inDR ) * COLS + inC + i * inDC ];
+                if( v != -1 ) {
+                    counts[ (int)v ] ++;
+                    }
+                }
+
+            if( counts[1] == 0 ) {
+                return counts[0] * counts[0];
+                }
+            if( counts[0] == 0 ) {
+                return - counts[1] * counts[1];
+                }
+            return 0;
+            }
+
+
+        int countDir( int inR, int inC, int inDR, int inDC, char inWho ) {
+            int n = 0;
+            int r = inR + inDR;
+            int c = inC + inDC;
+            while( r >= 0 && r < ROWS && c >= 0 && c < COLS &&
+                   mCells[ r * COLS + c ] == inWho ) {
+                n++;
+                r += inDR;
+                c += inDC;
+                }
+            return n;
+            }
+
+
+        char checkWin( int inR, int inC ) {
+            char who = mCells[ inR * COLS + inC ];
+            int dirs[4][2] = { {0,1}, {1,0}, {1,1}, {1,-1} };
+
+            for( int d=0; d<4; d++ ) {
+                int n = 1 +
+                    countDir( inR, inC, dirs[d][0], dirs[d][1], who ) +
+                    countDir( inR, inC, -dirs[d][0], -dirs[d][1], who );
+                if( n >= 4 ) {
+                    return true;
+                    }
+                }
+            return false;
+            }
+
+
+        char mCells[ COLS * ROWS ];
+        char mHeights[ COLS ];
+        char mToMove;
+        int mNumPlayed;
+        unsigned long long mKey;
+        char mWinner;
+    };
+
+
+
+static void report( const char *inName, MinMaxSearchStats *inStats ) {
+    printf( "%-28s depth %2d  score %7d  %12llu nodes  %7.3fs  "
+            "%10.0f nodes/sec\n",
+            inName, inStats->depthReached, inStats->score,
+            inStats->nodesVisited, inStats->seconds,
+            inStats->nodesVisited / inStats->seconds );
+    }
+
+
+
+int main( int inNumArgs, char **inArgs ) {
+
+    int depth = 8;
+    int numThreads = -1;
+
+    if( inNumArgs > 1 ) {
+        depth = atoi( inArgs[1] );
+        }
+    if( inNumArgs > 2 ) {
+        numThreads = atoi( inArgs[2] );
+        }
+
+    initZobrist();
+
+    // a few opening moves so the tree isn't symmetric
+    ConnectFourState start;
+    start.drop( 3 );
+    start.drop( 3 );
+    start.drop( 2 );
+    start.drop( 4 );
+
+    start.printState();
+    printf( "\n" );
+
+
+    double t = Time::getCurrentTime();
+    GameState *plainMove = minMaxPickMove( &start, max, depth );
+    double plainSeconds = Time::getCurrentTime() - t;
+    printf( "%-28s depth %2d  %7.3fs\n", "minMax", depth, plainSeconds );
+
+    // scored the way minMaxPickMove scored it
+    int plainScore = 0;
+    if( plainMove != NULL ) {
+        plainScore = minMax( plainMove, min, depth );
+        }
+
+
+    MinMaxSearchStats serialStats;
+    GameState *serialMove = parallelMinMaxPickMove( &start, max, depth,
+                                                    NULL, NULL,
+                                                    &serialStats );
+    report( "parallelMinMax, no pool", &serialStats );
+
+
+    ThreadPool pool( numThreads );
+
+    MinMaxSearchStats poolStats;
+    GameState *poolMove = parallelMinMaxPickMove( &start, max, depth,
+                                                  &pool, NULL, &poolStats );
+
+    char name[64];
+    snprintf( name, sizeof( name ), "parallelMinMax, %d threads",
+              pool.getNumThreads() );
+    report( name, &poolStats );
+
+    printf( "\nmove scores:  minMax %d, no pool %d, pool %d\n",
+            plainScore, serialStats.score, poolStats.score );
+
+    int result = 0;
+    if( plainMove == NULL || plainScore != poolStats.score ) {
+        printf( "FAILED:  parallel search score differs from minMax\n" );
+        result = 1;
+        }
+    if( serialStats.score != poolStats.score ) {
+        printf( "FAILED:  parallel search score differs from serial\n" );
+        result = 1;
+        }
+
+    if( plainMove != NULL ) {
+        delete plainMove;
+        }
+    if( serialMove != NULL ) {
+        delete serialMove;
+        }
+    if( poolMove != NULL ) {
+        delete poolMove;
+        }
+
+    return result;
+    }
@@ -0,0 +1,790 @@
+#include "parallelMinMax.h"
+
+#include "minorGems/system/MutexLock.h"
+#include "minorGems/system/Time.h"
+
+#include <string.h>
+
+
+
+// nodes closer to the leaves than this are searched serially
+#define MIN_SPLIT_DEPTH 3
+
+// depth stored in the table for subtrees that were searched all the way
+// to game-over states, which hold at any requested depth
+#define RESOLVED_DEPTH 0x7FFF
+
+
+
+static MinOrMax otherSide( MinOrMax inSide ) {
+    if( inSide == min ) {
+        return max;
+        }
+    return min;
+    }
+
+
+
+// table key for a state with a given side to move, or 0
+static unsigned long long sideKey( GameState *inState, MinOrMax inSide ) {
+    unsigned long long key = inState->getHashKey();
+
+    if( key == 0 ) {
+        return 0;
+        }
+
+    if( inSide == min ) {
+        key ^= 0x9E3779B97F4A7C15ULL;
+        }
+    if( key == 0 ) {
+        key = 1;
+        }
+    return key;
+    }
+
+
+
+// per-thread search state
+class SearchContext {
+    public:
+
+        SearchContext( TranspositionTable *inTable )
+                : mTable( inTable ), mNodes( 0 ), mTableCutoffs( 0 ),
+                  mHitDepthLimit( false ), mAbort( NULL ) {
+            }
+
+
+        ~SearchContext() {
+            for( int i=0; i<mChildSlots.size(); i++ ) {
+                GameState *s = mChildSlots.getElementDirect( i );
+                if( s != NULL ) {
+                    delete s;
+                    }
+                }
+            }
+
+
+        // a scratch state owned by this context for children at inPly
+        GameState *getChildSlot( int inPly, GameState *inParent ) {
+            while( mChildSlots.size() <= inPly ) {
+                mChildSlots.push_back( NULL );
+                }
+
+            GameState **slot = mChildSlots.getElement( inPly );
+
+            if( *slot == NULL ) {
+                *slot = inParent->copy();
+                }
+            return *slot;
+            }
+
+
+        TranspositionTable *mTable;
+
+        unsigned long long mNodes;
+        unsigned long long mTableCutoffs;
+
+        // true if some leaf was cut off by the depth limit
+        char mHitDepthLimit;
+
+        // points to the cutoff flag of the split this context is
+        // working on, if any
+        volatile char *mAbort;
+
+    private:
+        SimpleVector<GameState *> mChildSlots;
+    };
+
+
+
+// fills outEntry's bound from the window the node was searched with
+static void setBound( TranspositionEntry *outEntry, int inScore,
+                      int inAlpha, int inBeta ) {
+    if( inScore <= inAlpha ) {
+        outEntry->bound = boundUpper;
+        }
+    else if( inScore >= inBeta ) {
+        outEntry->bound = boundLower;
+        }
+    else {
+        outEntry->bound = boundExact;
+        }
+    }
+
+
+
+// returns true if the table entry settles this node, setting outScore
+static char tableCutoff( SearchContext *inContext,
+                         TranspositionEntry *inEntry, int inDepth,
+                         int inAlpha, int inBeta, int *outScore ) {
+    if( inEntry->depth < inDepth ) {
+        return false;
+        }
+
+    if( inEntry->bound == boundExact ||
+        ( inEntry->bound == boundLower && inEntry->score >= inBeta ) ||
+        ( inEntry->bound == boundUpper && inEntry->score <= inAlpha ) ) {
+
+        if( inEntry->depth != RESOLVED_DEPTH ) {
+            inContext->mHitDepthLimit = true;
+            }
+        inContext->mTableCutoffs ++;
+        *outScore = inEntry->score;
+        return true;
+        }
+    return false;
+    }
+
+
+
+// serial fail-soft alpha-beta, used below split depth and by workers
+static int search( SearchContext *inContext, GameState *inState,
+                   MinOrMax inSide, int inDepth,
+                   int inAlpha, int inBeta, int inPly ) {
+
+    inContext->mNodes ++;
+
+    if( inState->getGameOver() ) {
+        return inState->getScore();
+        }
+
+    if( inDepth == 0 ) {
+        inContext->mHitDepthLimit = true;
+        return inState->getScore();
+        }
+
+
+    unsigned long long key = sideKey( inState, inSide );
+    int tableMove = -1;
+
+    if( key != 0 ) {
+        TranspositionEntry entry;
+
+        if( inContext->mTable->probe( key, &entry ) ) {
+            int score;
+            if( tableCutoff( inContext, &entry, inDepth,
+                             inAlpha, inBeta, &score ) ) {
+                return score;
+                }
+            tableMove = entry.bestMove;
+            }
+        }
+
+
+    SimpleVector<GameState *> *allocatedMoves = NULL;
+
+    int numMoves = inState->getNumPossibleMoves();
+
+    if( numMoves < 0 ) {
+        allocatedMoves =
+            new SimpleVector<GameState *>( inState->getPossibleMoves() );
+        numMoves = allocatedMoves->size();
+        }
+
+    if( numMoves == 0 ) {
+        if( allocatedMoves != NULL ) {
+            delete allocatedMoves;
+            }
+        return inState->getScore();
+        }
+
+    if( tableMove >= numMoves ) {
+        tableMove = -1;
+        }
+
+
+    // track depth-limit hits for this subtree only
+    char parentHit = inContext->mHitDepthLimit;
+    inContext->mHitDepthLimit = false;
+
+    int alpha = inAlpha;
+    int beta = inBeta;
+
+    int best = INT_MIN;
+    if( inSide == min ) {
+        best = INT_MAX;
+        }
+    int bestMove = -1;
+
+    char aborted = false;
+
+    // table move first, then the rest in generation order
+    for( int k=-1; k<numMoves; k++ ) {
+        int i = k;
+
+        if( k == -1 ) {
+            if( tableMove < 0 ) {
+                continue;
+                }
+            i = tableMove;
+            }
+        else if( k == tableMove ) {
+            continue;
+            }
+
+        GameState *child;
+
+        if( allocatedMoves != NULL ) {
+            child = allocatedMoves->getElementDirect( i );
+            }
+        else {
+            child = inContext->getChildSlot( inPly, inState );
+            child->copyFrom( inState );
+            child->applyMove( i );
+            }
+
+        int score = search( inContext, child, otherSide( inSide ),
+                            inDepth - 1, alpha, beta, inPly + 1 );
+
+        if( inContext->mAbort != NULL && *( inContext->mAbort ) ) {
+            aborted = true;
+            break;
+            }
+
+        if( inSide == max ) {
+            if( score > best ) {
+                best = score;
+                bestMove = i;
+                }
+            if( best > alpha ) {
+                alpha = best;
+                }
+            }
+        else {
+            if( score < best ) {
+                best = score;
+                bestMove = i;
+                }
+            if( best < beta ) {
+                beta = best;
+                }
+            }
+
+        if( alpha >= beta ) {
+            break;
+            }
+        }
+
+    if( allocatedMoves != NULL ) {
+        for( int i=0; i<allocatedMoves->size(); i++ ) {
+            delete allocatedMoves->getElementDirect( i );
+            }
+        delete allocatedMoves;
+        }
+
+
+    char subtreeHit = inContext->mHitDepthLimit;
+    inContext->mHitDepthLimit = parentHit || subtreeHit;
+
+    if( aborted ) {
+        // partial result, never store it
+        return best;
+        }
+
+    if( key != 0 ) {
+        TranspositionEntry entry;
+        entry.score = best;
+        entry.depth = inDepth;
+        if( ! subtreeHit ) {
+            entry.depth = RESOLVED_DEPTH;
+            }
+        entry.bestMove = bestMove;
+        setBound( &entry, best, inAlpha, inBeta );
+
+        inContext->mTable->store( key, &entry );
+        }
+
+    return best;
+    }
+
+
+
+
+// shared state for children of one node searched in parallel
+class SplitPoint {
+    public:
+        MutexLock mLock;
+
+        SimpleVector<GameState *> *mChildren;
+
+        // positions in mOrder still to be handed out start here
+        int *mOrder;
+        int mNumOrder;
+        int mNextOrder;
+
+        MinOrMax mSide;
+        int mDepth;
+        int mPly;
+
+        int mAlpha;
+        int mBeta;
+
+        int mBest;
+        int mBestMove;
+
+        // per child score, or NULL
+        int *mChildScores;
+
+        volatile char mCutoff;
+    };
+
+
+
+static void runSplitWork( SplitPoint *inSplit, SearchContext *inContext ) {
+
+    volatile char *oldAbort = inContext->mAbort;
+    inContext->mAbort = &( inSplit->mCutoff );
+
+    while( true ) {
+        inSplit->mLock.lock();
+
+        if( inSplit->mCutoff || inSplit->mNextOrder >= inSplit->mNumOrder ) {
+            inSplit->mLock.unlock();
+            break;
+            }
+
+        int i = inSplit->mOrder[ inSplit->mNextOrder ];
+        inSplit->mNextOrder ++;
+
+        int alpha = inSplit->mAlpha;
+        int beta = inSplit->mBeta;
+
+        inSplit->mLock.unlock();
+
+
+        GameState *child = inSplit->mChildren->getElementDirect( i );
+
+        int score = search( inContext, child, otherSide( inSplit->mSide ),
+                            inSplit->mDepth - 1, alpha, beta,
+                            inSplit->mPly + 1 );
+
+
+        inSplit->mLock.lock();
+
+        if( ! inSplit->mCutoff ) {
+
+            if( inSplit->mChildScores != NULL ) {
+                inSplit->mChildScores[i] = score;
+                }
+
+            if( inSplit->mSide == max ) {
+                if( score > inSplit->mBest ) {
+                    inSplit->mBest = score;
+                    inSplit->mBestMove = i;
+                    }
+                if( inSplit->mBest > inSplit->mAlpha ) {
+                    inSplit->mAlpha = inSplit->mBest;
+                    }
+                }
+            else {
+                if( score < inSplit->mBest ) {
+                    inSplit->mBest = score;
+                    inSplit->mBestMove = i;
+                    }
+                if( inSplit->mBest < inSplit->mBeta ) {
+                    inSplit->mBeta = inSplit->mBest;
+                    }
+                }
+
+            if( inSplit->mAlpha >= inSplit->mBeta ) {
+                inSplit->mCutoff = true;
+                }
+            }
+
+        inSplit->mLock.unlock();
+        }
+
+    inContext->mAbort = oldAbort;
+    }
+
+
+
+class SplitJob : public ThreadPoolJob {
+    public:
+        SplitPoint *mSplit;
+        SearchContext *mContext;
+
+        virtual void runJob() {
+            runSplitWork( mSplit, mContext );
+            }
+    };
+
+
+
+class Searcher {
+    public:
+
+        Searcher( ThreadPool *inPool, TranspositionTable *inTable )
+                : mPool( inPool ), mMain( inTable ) {
+
+            if( mPool != NULL ) {
+                for( int i=0; i<mPool->getNumThreads(); i++ ) {
+                    mWorkers.push_back( new SearchContext( inTable ) );
+                    }
+                }
+            }
+
+
+        ~Searcher() {
+            for( int i=0; i<mWorkers.size(); i++ ) {
+                delete mWorkers.getElementDirect( i );
+                }
+            }
+
+
+        ThreadPool *mPool;
+        SearchContext mMain;
+        SimpleVector<SearchContext *> mWorkers;
+    };
+
+
+
+// searches the children of a split point on all workers, then folds
+// worker depth-limit hits back into the main context
+static void searchSplit( Searcher *inSearcher, SplitPoint *inSplit ) {
+
+    if( inSearcher->mPool == NULL ) {
+        runSplitWork( inSplit, &( inSearcher->mMain ) );
+        return;
+        }
+
+    int numJobs = inSearcher->mWorkers.size();
+    int numLeft = inSplit->mNumOrder - inSplit->mNextOrder;
+
+    if( numJobs > numLeft ) {
+        numJobs = numLeft;
+        }
+
+    SplitJob *jobs = new SplitJob[ numJobs ];
+
+    for( int j=0; j<numJobs; j++ ) {
+        jobs[j].mSplit = inSplit;
+        jobs[j].mContext = inSearcher->mWorkers.getElementDirect( j );
+        jobs[j].mContext->mHitDepthLimit = false;
+
+        inSearcher->mPool->addJob( &( jobs[j] ) );
+        }
+
+    inSearcher->mPool->waitForAllJobs();
+
+    for( int j=0; j<numJobs; j++ ) {
+        if( jobs[j].mContext->mHitDepthLimit ) {
+            inSearcher->mMain.mHitDepthLimit = true;
+            }
+        }
+
+    delete [] jobs;
+    }
+
+
+
+// principal-variation splitting:  the first child of each node along the
+// leftmost path is searched (recursively) first to establish a bound, then
+// the remaining children are searched in parallel with that bound
+//
+// inRootChildren, inRootOrder and outChildScores are used at the root only,
+// where children are kept across iterations; elsewhere they are NULL
+static int splitSearch( Searcher *inSearcher, GameState *inState,
+                        MinOrMax inSide, int inDepth,
+                        int inAlpha, int inBeta, int inPly,
+                        SimpleVector<GameState *> *inRootChildren = NULL,
+                        int *inRootOrder = NULL,
+                        int *outChildScores = NULL,
+                        int *outBestMove = NULL ) {
+
+    SearchContext *context = &( inSearcher->mMain );
+
+    if( inRootChildren == NULL &&
+        ( inSearcher->mPool == NULL || inDepth < MIN_SPLIT_DEPTH ) ) {
+        return search( context, inState, inSide, inDepth,
+                       inAlpha, inBeta, inPly );
+        }
+
+    context->mNodes ++;
+
+    if( inState->getGameOver() ) {
+        return inState->getScore();
+        }
+    if( inDepth == 0 ) {
+        context->mHitDepthLimit = true;
+        return inState->getScore();
+        }
+
+
+    unsigned long long key = 0;
+    int tableMove = -1;
+
+    if( inRootChildren == NULL ) {
+        key = sideKey( inState, inSide );
+
+        if( key != 0 ) {
+            TranspositionEntry entry;
+
+            if( context->mTable->probe( key, &entry ) ) {
+                int score;
+                if( tableCutoff( context, &entry, inDepth,
+                                 inAlpha, inBeta, &score ) ) {
+                    return score;
+                    }
+                tableMove = entry.bestMove;
+                }
+            }
+        }
+
+
+    SimpleVector<GameState *> *children = inRootChildren;
+
+    if( children == NULL ) {
+        // workers need children they can search independently
+        int numMoves = inState->getNumPossibleMoves();
+
+        if( numMoves < 0 ) {
+            children =
+                new SimpleVector<GameState *>( inState->getPossibleMoves() );
+            }
+        else {
+            children = new SimpleVector<GameState *>( numMoves );
+
+            for( int i=0; i<numMoves; i++ ) {
+                GameState *child = inState->copy();
+                child->applyMove( i );
+                children->push_back( child );
+                }
+            }
+        }
+
+    int numMoves = children->size();
+
+    if( numMoves == 0 ) {
+        if( children != inRootChildren ) {
+            delete children;
+            }
+        return inState->getScore();
+        }
+
+    if( tableMove >= numMoves ) {
+        tableMove = -1;
+        }
+
+
+    int *order = new int[ numMoves ];
+
+    if( inRootOrder != NULL ) {
+        memcpy( order, inRootOrder, sizeof( int ) * numMoves );
+        }
+    else {
+        int n = 0;
+        if( tableMove >= 0 ) {
+            order[ n++ ] = tableMove;
+            }
+        for( int i=0; i<numMoves; i++ ) {
+            if( i != tableMove ) {
+                order[ n++ ] = i;
+                }
+            }
+        }
+
+
+    char parentHit = context->mHitDepthLimit;
+    context->mHitDepthLimit = false;
+
+
+    SplitPoint split;
+    split.mChildren = children;
+    split.mOrder = order;
+    split.mNumOrder = numMoves;
+    split.mNextOrder = 1;
+    split.mSide = inSide;
+    split.mDepth = inDepth;
+    split.mPly = inPly;
+    split.mAlpha = inAlpha;
+    split.mBeta = inBeta;
+    split.mChildScores = outChildScores;
+    split.mCutoff = false;
+
+
+    // principal variation first
+    int first = order[0];
+
+    int score = splitSearch( inSearcher, children->getElementDirect( first ),
+                             otherSide( inSide ), inDepth - 1,
+                             inAlpha, inBeta, inPly + 1 );
+
+    split.mBest = score;
+    split.mBestMove = first;
+
+    if( outChildScores != NULL ) {
+        outChildScores[ first ] = score;
+        }
+
+    if( inSide == max ) {
+        if( score > split.mAlpha ) {
+            split.mAlpha = score;
+            }
+        }
+    else {
+        if( score < split.mBeta ) {
+            split.mBeta = score;
+            }
+        }
+
+    if( split.mAlpha >= split.mBeta ) {
+        split.mCutoff = true;
+        }
+    else if( numMoves > 1 ) {
+        searchSplit( inSearcher, &split );
+        }
+
+
+    int best = split.mBest;
+
+    if( outBestMove != NULL ) {
+        *outBestMove = split.mBestMove;
+        }
+
+    delete [] order;
+
+    if( children != inRootChildren ) {
+        for( int i=0; i<numMoves; i++ ) {
+            delete children->getElementDirect( i );
+            }
+        delete children;
+        }
+
+
+    char subtreeHit = context->mHitDepthLimit;
+    context->mHitDepthLimit = parentHit || subtreeHit;
+
+    if( key != 0 ) {
+        TranspositionEntry entry;
+        entry.score = best;
+        entry.depth = inDepth;
+        if( ! subtreeHit ) {
+            entry.depth = RESOLVED_DEPTH;
+            }
+        entry.bestMove = split.mBestMove;
+        setBound( &entry, best, inAlpha, inBeta );
+
+        context->mTable->store( key, &entry );
+        }
+
+    return best;
+    }
+
+
+
+GameState *parallelMinMaxPickMove( GameState *inCurrentState,
+                                   MinOrMax inSide,
+                                   int inDepthLimit,
+                                   ThreadPool *inPool,
+                                   TranspositionTable *inTable,
+                                   MinMaxSearchStats *outStats ) {
+
+    double startTime = Time::getCurrentTime();
+
+    SimpleVector<GameState *> rootChildren =
+        inCurrentState->getPossibleMoves();
+
+    int numMoves = rootChildren.size();
+
+    if( numMoves == 0 ) {
+        return NULL;
+        }
+
+
+    TranspositionTable *table = inTable;
+    if( table == NULL ) {
+        table = new TranspositionTable();
+        }
+
+    Searcher searcher( inPool, table );
+
+
+    int *order = new int[ numMoves ];
+    int *scores = new int[ numMoves ];
+
+    for( int i=0; i<numMoves; i++ ) {
+        order[i] = i;
+        scores[i] = 0;
+        }
+
+    int bestMove = 0;
+    int bestScore = 0;
+    int depthReached = 0;
+
+    int depth = 1;
+
+    while( inDepthLimit < 0 || depth <= inDepthLimit ) {
+
+        searcher.mMain.mHitDepthLimit = false;
+
+        // minMaxPickMove searches each child with the full depth limit,
+        // so the root sits one level above that
+        bestScore = splitSearch( &searcher, inCurrentState, inSide,
+                                 depth + 1, INT_MIN, INT_MAX, 0,
+                                 &rootChildren, order, scores, &bestMove );
+
+        depthReached = depth;
+
+        if( ! searcher.mMain.mHitDepthLimit ) {
+            // whole tree searched, deeper iterations can't change anything
+            break;
+            }
+
+        if( depth + 1 >= RESOLVED_DEPTH ) {
+            break;
+            }
+
+        // order root moves by this iteration's scores for the next one
+        // (stable insertion sort, best first for inSide)
+        for( int i=1; i<numMoves; i++ ) {
+            int moveIndex = order[i];
+            int s = scores[ moveIndex ];
+
+            int j = i - 1;
+            while( j >= 0 &&
+                   ( ( inSide == max && scores[ order[j] ] < s ) ||
+                     ( inSide == min && scores[ order[j] ] > s ) ) ) {
+                order[ j + 1 ] = order[j];
+                j--;
+                }
+            order[ j + 1 ] = moveIndex;
+            }
+
+        depth ++;
+        }
+
+
+    GameState *bestPossible = rootChildren.getElementDirect( bestMove );
+
+    for( int i=0; i<numMoves; i++ ) {
+        if( i != bestMove ) {
+            delete rootChildren.getElementDirect( i );
+            }
+        }
+
+    delete [] order;
+    delete [] scores;
+
+
+    if( outStats != NULL ) {
+        outStats->nodesVisited = searcher.mMain.mNodes;
+        outStats->tableCutoffs = searcher.mMain.mTableCutoffs;
+
+        for( int i=0; i<searcher.mWorkers.size(); i++ ) {
+            SearchContext *c = searcher.mWorkers.getElementDirect( i );
+            outStats->nodesVisited += c->mNodes;
+            outStats->tableCutoffs += c->mTableCutoffs;
+            }
+
+        outStats->depthReached = depthReached;
+        outStats->score = bestScore;
+        outStats->seconds = Time::getCurrentTime() - startTime;
+        }
+
+    if( table != inTable ) {
+        delete table;
+        }
+
+    return bestPossible;
+    }
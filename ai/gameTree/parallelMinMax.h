@@ -0,0 +1,59 @@
+#ifndef PARALLEL_MIN_MAX_INCLUDED
+#define PARALLEL_MIN_MAX_INCLUDED
+
+
+#include "minMax.h"
+#include "TranspositionTable.h"
+
+#include "minorGems/system/ThreadPool.h"
+
+
+
+typedef struct MinMaxSearchStats {
+        // total states visited, across all threads and iterations
+        unsigned long long nodesVisited;
+
+        // transposition table probes that ended the search of a node
+        unsigned long long tableCutoffs;
+
+        // deepest iteration that was completed
+        int depthReached;
+
+        // minMax score of the chosen move
+        int score;
+
+        double seconds;
+    } MinMaxSearchStats;
+
+
+
+/**
+ * Alpha-beta search with iterative deepening, transposition table move
+ * ordering, and principal-variation splitting across a thread pool.
+ *
+ * Same contract as minMaxPickMove:  returns a newly allocated state for the
+ * best move from inCurrentState (destroyed by caller), or NULL if there
+ * are no moves.
+ *
+ * States that implement the optional GameState::getHashKey use the table,
+ * and states that implement getNumPossibleMoves/applyMove have their
+ * children recycled through copyFrom instead of allocated at each node.
+ *
+ * @param inDepthLimit the deepest iteration, or -1 to keep deepening
+ *   until the whole tree has been searched.
+ * @param inPool the pool to split work across, or NULL to search on the
+ *   calling thread only.
+ * @param inTable the table to use, or NULL to use a temporary table.
+ *   A table may be kept between calls to reuse earlier results.
+ * @param outStats filled with search statistics, or NULL.
+ */
+GameState *parallelMinMaxPickMove( GameState *inCurrentState,
+                                   MinOrMax inSide,
+                                   int inDepthLimit = -1,
+                                   ThreadPool *inPool = NULL,
+                                   TranspositionTable *inTable = NULL,
+                                   MinMaxSearchStats *outStats = NULL );
+
+
+
+#endif
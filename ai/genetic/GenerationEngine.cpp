@@ -0,0 +1,251 @@
+#include "GenerationEngine.h"
+
+#include "minorGems/system/Time.h"
+#include "minorGems/util/random/JenkinsRandomSource.h"
+
+#include <string.h>
+
+
+
+// slots per job, small enough to balance uneven fitness costs
+#define SLOTS_PER_JOB 4
+
+
+
+// 32-bit finalizer from MurmurHash3
+static inline unsigned int mixSeed( unsigned int inX ) {
+	inX ^= inX >> 16;
+	inX *= 0x85EBCA6BU;
+	inX ^= inX >> 13;
+	inX *= 0xC2B2AE35U;
+	inX ^= inX >> 16;
+	return inX;
+	}
+
+
+
+static unsigned int slotSeed( unsigned int inRunSeed, int inGeneration,
+							  int inSlot ) {
+	return mixSeed( inRunSeed ^
+					mixSeed( (unsigned int)inGeneration * 0x9E3779B9U ^
+							 mixSeed( (unsigned int)inSlot ) ) );
+	}
+
+
+
+class GenerationEngineJob : public ThreadPoolJob {
+
+	public:
+
+		GenerationEngine *mEngine;
+		int mStartSlot;
+		int mEndSlot;
+		int mGeneration;
+		char mBreed;
+		float mMutationProb;
+		float mMaxMutationMagnitude;
+		unsigned int mRunSeed;
+
+		JenkinsRandomSource mRandSource;
+
+
+		virtual void runJob() {
+			for( int s=mStartSlot; s<mEndSlot; s++ ) {
+				mRandSource.reseed( slotSeed( mRunSeed, mGeneration, s ) );
+
+				if( mBreed ) {
+					mEngine->breedAndScore( s, mMutationProb,
+											mMaxMutationMagnitude,
+											&mRandSource );
+					}
+				else {
+					mEngine->score( s, &mRandSource );
+					}
+				}
+			}
+	};
+
+
+
+GenerationEngine::GenerationEngine( ReusableCrossbreedable **inPopulation,
+	int inPopulationSize, int inNumSurvivors,
+	FitnessEvaluator *inEvaluator, unsigned int inSeed,
+	ThreadPool *inPool )
+	: mPopulationSize( inPopulationSize ), mNumSurvivors( inNumSurvivors ),
+	  mEvaluator( inEvaluator ), mSeed( inSeed ), mPool( inPool ),
+	  mGeneration( 0 ) {
+
+	if( mNumSurvivors < 2 ) {
+		mNumSurvivors = 2;
+		}
+	if( mNumSurvivors > mPopulationSize ) {
+		mNumSurvivors = mPopulationSize;
+		}
+
+	mPopulation = new ReusableCrossbreedable*[ mPopulationSize ];
+	memcpy( mPopulation, inPopulation,
+			sizeof( ReusableCrossbreedable* ) * mPopulationSize );
+
+	mScores = new double[ mPopulationSize ];
+	for( int i=0; i<mPopulationSize; i++ ) {
+		mScores[i] = 0;
+		}
+
+	mIndices = new int[ mPopulationSize ];
+	mTempPopulation = new ReusableCrossbreedable*[ mPopulationSize ];
+	mTempScores = new double[ mPopulationSize ];
+	}
+
+
+
+GenerationEngine::~GenerationEngine() {
+	for( int i=0; i<mPopulationSize; i++ ) {
+		delete mPopulation[i];
+		}
+	delete [] mPopulation;
+	delete [] mScores;
+	delete [] mIndices;
+	delete [] mTempPopulation;
+	delete [] mTempScores;
+	}
+
+
+
+int GenerationEngine::getGenerationNumber() {
+	return mGeneration;
+	}
+
+
+
+int GenerationEngine::getPopulationSize() {
+	return mPopulationSize;
+	}
+
+
+
+ReusableCrossbreedable *GenerationEngine::getMember( int inIndex ) {
+	return mPopulation[ inIndex ];
+	}
+
+
+
+double GenerationEngine::getScore( int inIndex ) {
+	return mScores[ inIndex ];
+	}
+
+
+
+void GenerationEngine::score( int inSlot, RandomSource *inRandSource ) {
+	mScores[ inSlot ] =
+		mEvaluator->getFitness( mPopulation[ inSlot ], inRandSource );
+	}
+
+
+
+void GenerationEngine::breedAndScore( int inSlot, float inMutationProb,
+									  float inMaxMutationMagnitude,
+									  RandomSource *inRandSource ) {
+
+	// two different survivors, picked with this slot's randomness
+	int a = inRandSource->getRandomBoundedInt( 0, mNumSurvivors - 1 );
+	int b = inRandSource->getRandomBoundedInt( 0, mNumSurvivors - 2 );
+	if( b >= a ) {
+		b++;
+		}
+
+	ReusableCrossbreedable *parentA = mPopulation[a];
+	ReusableCrossbreedable *parentB = mPopulation[b];
+
+	ReusableCrossbreedable *offspring = mPopulation[ inSlot ];
+
+	offspring->crossbreedFrom( parentA, parentB, 0.5f, inMutationProb,
+							   inMaxMutationMagnitude, inRandSource );
+	offspring->setGeneration( parentA, parentB );
+
+	score( inSlot, inRandSource );
+	}
+
+
+
+void GenerationEngine::runSlots( int inFirstSlot, char inBreed,
+								 float inMutationProb,
+								 float inMaxMutationMagnitude ) {
+
+	int numSlots = mPopulationSize - inFirstSlot;
+	int numJobs = ( numSlots + SLOTS_PER_JOB - 1 ) / SLOTS_PER_JOB;
+
+	GenerationEngineJob *jobs = new GenerationEngineJob[ numJobs ];
+
+	for( int j=0; j<numJobs; j++ ) {
+		GenerationEngineJob *job = &( jobs[j] );
+
+		job->mEngine = this;
+		job->mStartSlot = inFirstSlot + j * SLOTS_PER_JOB;
+		job->mEndSlot = job->mStartSlot + SLOTS_PER_JOB;
+		if( job->mEndSlot > mPopulationSize ) {
+			job->mEndSlot = mPopulationSize;
+			}
+		job->mGeneration = mGeneration;
+		job->mBreed = inBreed;
+		job->mMutationProb = inMutationProb;
+		job->mMaxMutationMagnitude = inMaxMutationMagnitude;
+		job->mRunSeed = mSeed;
+
+		if( mPool != NULL ) {
+			mPool->addJob( job );
+			}
+		else {
+			job->runJob();
+			}
+		}
+
+	if( mPool != NULL ) {
+		mPool->waitForAllJobs();
+		}
+
+	delete [] jobs;
+	}
+
+
+
+void GenerationEngine::selectSurvivors() {
+	for( int i=0; i<mPopulationSize; i++ ) {
+		mIndices[i] = i;
+		}
+
+	partialSortIndices( mScores, mIndices, mPopulationSize, mNumSurvivors,
+						true );
+
+	for( int i=0; i<mPopulationSize; i++ ) {
+		mTempPopulation[i] = mPopulation[ mIndices[i] ];
+		mTempScores[i] = mScores[ mIndices[i] ];
+		}
+
+	// swap buffers
+	ReusableCrossbreedable **population = mPopulation;
+	mPopulation = mTempPopulation;
+	mTempPopulation = population;
+
+	double *scores = mScores;
+	mScores = mTempScores;
+	mTempScores = scores;
+	}
+
+
+
+void GenerationEngine::runGeneration( float inMutationProb,
+									  float inMaxMutationMagnitude ) {
+
+	if( mGeneration == 0 ) {
+		// score the starting population
+		runSlots( 0, false, 0, 0 );
+		selectSurvivors();
+		}
+
+	mGeneration++;
+
+	// culled members become offspring
+	runSlots( mNumSurvivors, true, inMutationProb, inMaxMutationMagnitude );
+
+	selectSurvivors();
+	}
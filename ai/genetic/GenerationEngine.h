@@ -0,0 +1,155 @@
+#ifndef GENERATION_ENGINE_INCLUDED
+#define GENERATION_ENGINE_INCLUDED
+
+#include "ReusableCrossbreedable.h"
+#include "PopulationSorter.h"
+
+#include "minorGems/system/ThreadPool.h"
+#include "minorGems/util/random/RandomSource.h"
+
+
+/**
+ * Interface for scoring population members.
+ */
+class FitnessEvaluator {
+
+	public:
+
+		virtual ~FitnessEvaluator() {
+			}
+
+		/**
+		 * Scores a member.  Higher scores are better.
+		 *
+		 * Called from several threads at once, on different members.
+		 *
+		 * @param inMember the member to score.
+		 * @param inRandSource source for any random choices during
+		 *   scoring, seeded for this member.  Must be destroyed by caller.
+		 *
+		 * @return the member's fitness.
+		 */
+		virtual double getFitness( ReusableCrossbreedable *inMember,
+								   RandomSource *inRandSource ) = 0;
+	};
+
+
+
+/**
+ * Runs generations of a genetic algorithm across a ThreadPool.
+ *
+ * Each generation keeps the best inNumSurvivors members and breeds random
+ * pairs of them into the storage of the culled members, so no members are
+ * allocated or deleted between generations.  Each offspring is bred and
+ * then scored by the same job, so scoring starts as soon as the first
+ * offspring exists instead of after a whole-population breeding pass.
+ * Survivors are picked with a partial sort (PopulationSorter) rather than
+ * a full sort.
+ *
+ * Every offspring gets its own RandomSource, seeded from the run seed, the
+ * generation number and the offspring's slot, so a run produces the same
+ * population no matter how many threads are used.
+ *
+ * Survivors keep their scores from earlier generations, so fitness should
+ * be deterministic for a given member and RandomSource.
+ */
+class GenerationEngine : public PopulationSorter {
+
+	public:
+
+		/**
+		 * Constructs an engine.
+		 *
+		 * @param inPopulation the starting population.  The array must
+		 *   be destroyed by caller, but the members are destroyed when
+		 *   this class is destroyed.
+		 * @param inPopulationSize the population size.
+		 * @param inNumSurvivors the number of members kept each
+		 *   generation, in [2..inPopulationSize).
+		 * @param inEvaluator the fitness function.  Must be destroyed by
+		 *   caller after this class is destroyed.
+		 * @param inSeed seed for all breeding and scoring randomness.
+		 * @param inPool the thread pool to breed and score on, or NULL
+		 *   to run on the calling thread.  Must be destroyed by caller
+		 *   after this class is destroyed.
+		 */
+		GenerationEngine( ReusableCrossbreedable **inPopulation,
+			int inPopulationSize, int inNumSurvivors,
+			FitnessEvaluator *inEvaluator, unsigned int inSeed,
+			ThreadPool *inPool = NULL );
+
+		~GenerationEngine();
+
+
+
+		/**
+		 * Runs one generation.  The first call also scores the starting
+		 * population.
+		 *
+		 * @param inMutationProb the probability of mutations throughout
+		 *   each crossbreeding.
+		 * @param inMaxMutationMagnitude the maximum "severity" of any
+		 *   individual mutation, in [0..1].
+		 */
+		void runGeneration( float inMutationProb,
+							float inMaxMutationMagnitude );
+
+
+
+		// number of generations run so far
+		int getGenerationNumber();
+
+		int getPopulationSize();
+
+
+		/**
+		 * Gets a member after runGeneration.  The first inNumSurvivors
+		 * members are in decreasing fitness order.
+		 *
+		 * @param inIndex the member index.
+		 *
+		 * @return the member.  Destroyed by this class.
+		 */
+		ReusableCrossbreedable *getMember( int inIndex );
+
+		double getScore( int inIndex );
+
+
+
+		// used by breeding jobs
+		void breedAndScore( int inSlot, float inMutationProb,
+							float inMaxMutationMagnitude,
+							RandomSource *inRandSource );
+
+		void score( int inSlot, RandomSource *inRandSource );
+
+
+	protected:
+
+		// runs breedAndScore (or just score) on slots in
+		// [inFirstSlot, mPopulationSize) across the pool
+		void runSlots( int inFirstSlot, char inBreed,
+					   float inMutationProb, float inMaxMutationMagnitude );
+
+		// moves the best mNumSurvivors members to the front
+		void selectSurvivors();
+
+
+		ReusableCrossbreedable **mPopulation;
+		double *mScores;
+		int mPopulationSize;
+		int mNumSurvivors;
+
+		FitnessEvaluator *mEvaluator;
+		unsigned int mSeed;
+		ThreadPool *mPool;
+
+		int mGeneration;
+
+		// for permuting mPopulation and mScores
+		int *mIndices;
+		ReusableCrossbreedable **mTempPopulation;
+		double *mTempScores;
+	};
+
+#endif
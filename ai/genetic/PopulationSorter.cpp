@@ -11,6 +11,8 @@
 
 #include "PopulationSorter.h"
 
+#include <string.h>
+
 void PopulationSorter::sortPopulation( PopulationMember** inPopulation, 
 	double* inScores, int inPopulationSize, char inDecreasingOrder ) {
 
@@ -25,8 +27,8 @@ void PopulationSorter::sortPopulation( PopulationMember** inPopulation,
 		int bestInd = t;
 		
 		for( int u=t+1; u<inPopulationSize; u++ ) {
-			if( !inDecreasingOrder && inScores[u] < best
-				|| inDecreasingOrder && inScores[u] > best ) {
+			if( ( !inDecreasingOrder && inScores[u] < best )
+				|| ( inDecreasingOrder && inScores[u] > best ) ) {
 				best = inScores[u];
 				bestInd = u;
 				}
@@ -42,3 +44,138 @@ void PopulationSorter::sortPopulation( PopulationMember** inPopulation,
 			}
 		}
 	}
+
+
+
+// total order on indices:  by score, then by index
+static inline char indexBefore( double* inScores, int inA, int inB,
+	char inDecreasingOrder ) {
+	
+	if( inScores[inA] != inScores[inB] ) {
+		if( inDecreasingOrder ) {
+			return inScores[inA] > inScores[inB];
+			}
+		else {
+			return inScores[inA] < inScores[inB];
+			}
+		}
+	return inA < inB;
+	}
+
+
+
+static inline void swapIndices( int* ioIndices, int inA, int inB ) {
+	int temp = ioIndices[inA];
+	ioIndices[inA] = ioIndices[inB];
+	ioIndices[inB] = temp;
+	}
+
+
+
+// quicksort that only descends into partitions overlapping [0,inNumToSort)
+static void partialQuickSort( double* inScores, int* ioIndices,
+	int inLow, int inHigh, int inNumToSort, char inDecreasingOrder ) {
+
+	while( inHigh - inLow > 16 ) {
+		
+		// median of three as the pivot, moved to the end
+		int mid = inLow + ( inHigh - inLow ) / 2;
+		int last = inHigh - 1;
+		
+		if( indexBefore( inScores, ioIndices[mid], ioIndices[inLow],
+						 inDecreasingOrder ) ) {
+			swapIndices( ioIndices, mid, inLow );
+			}
+		if( indexBefore( inScores, ioIndices[last], ioIndices[inLow],
+						 inDecreasingOrder ) ) {
+			swapIndices( ioIndices, last, inLow );
+			}
+		if( indexBefore( inScores, ioIndices[mid], ioIndices[last],
+						 inDecreasingOrder ) ) {
+			swapIndices( ioIndices, mid, last );
+			}
+		
+		int pivot = ioIndices[last];
+		
+		int store = inLow;
+		for( int i=inLow; i<last; i++ ) {
+			if( indexBefore( inScores, ioIndices[i], pivot,
+							 inDecreasingOrder ) ) {
+				swapIndices( ioIndices, i, store );
+				store++;
+				}
+			}
+		swapIndices( ioIndices, store, last );
+		
+		
+		if( store >= inNumToSort ) {
+			// everything we need is left of the pivot
+			inHigh = store;
+			}
+		else {
+			partialQuickSort( inScores, ioIndices, inLow, store,
+							  inNumToSort, inDecreasingOrder );
+			inLow = store + 1;
+			}
+		}
+	
+	// insertion sort for short ranges
+	for( int i=inLow+1; i<inHigh; i++ ) {
+		int current = ioIndices[i];
+		int j = i;
+		while( j > inLow && 
+			   indexBefore( inScores, current, ioIndices[j-1],
+							inDecreasingOrder ) ) {
+			ioIndices[j] = ioIndices[j-1];
+			j--;
+			}
+		ioIndices[j] = current;
+		}
+	}
+
+
+
+void PopulationSorter::partialSortIndices( double* inScores, int* ioIndices,
+	int inNumIndices, int inNumToSort, char inDecreasingOrder ) {
+
+	if( inNumToSort > inNumIndices ) {
+		inNumToSort = inNumIndices;
+		}
+	if( inNumToSort <= 0 ) {
+		return;
+		}
+	
+	partialQuickSort( inScores, ioIndices, 0, inNumIndices, inNumToSort,
+					  inDecreasingOrder );
+	}
+
+
+
+void PopulationSorter::partialSortPopulation( PopulationMember** inPopulation, 
+	double* inScores, int inPopulationSize, int inNumToSort,
+	char inDecreasingOrder ) {
+
+	int *indices = new int[ inPopulationSize ];
+	for( int i=0; i<inPopulationSize; i++ ) {
+		indices[i] = i;
+		}
+	
+	partialSortIndices( inScores, indices, inPopulationSize, inNumToSort,
+						inDecreasingOrder );
+	
+	PopulationMember **members = new PopulationMember*[ inPopulationSize ];
+	double *scores = new double[ inPopulationSize ];
+	
+	for( int i=0; i<inPopulationSize; i++ ) {
+		members[i] = inPopulation[ indices[i] ];
+		scores[i] = inScores[ indices[i] ];
+		}
+	
+	memcpy( inPopulation, members,
+			sizeof( PopulationMember* ) * inPopulationSize );
+	memcpy( inScores, scores, sizeof( double ) * inPopulationSize );
+	
+	delete [] members;
+	delete [] scores;
+	delete [] indices;
+	}
@@ -30,6 +30,47 @@ class PopulationSorter {
 		void sortPopulation( PopulationMember** inPopulation, 
 			double* inScores, int inPopulationSize, 
 			char inDecreasingOrder=false );
+
+
+
+		/**
+		 * Moves the best inNumToSort members of a population to the
+		 * front in sorted order (scores are moved too).  The order of the
+		 * remaining members is unspecified.
+		 *
+		 * Runs in expected O(n + k log k) time, where sortPopulation
+		 * is O(n^2).
+		 *
+		 * @param inPopulation array of population members.
+		 * @param inScores array of scores associated with each population
+		 *   member.
+		 * @param inPopulationSize size of population.
+		 * @param inNumToSort the number of members to sort to the front.
+		 * @param inDecreasingOrder set to true if the highest scores
+		 *   are best (default is false).
+		 */ 
+		void partialSortPopulation( PopulationMember** inPopulation, 
+			double* inScores, int inPopulationSize, int inNumToSort,
+			char inDecreasingOrder=false );
+
+
+
+		/**
+		 * Same as partialSortPopulation, but permutes an array of indices
+		 * into inScores instead of moving members and scores.
+		 *
+		 * Ties are broken by index, so the result is deterministic.
+		 *
+		 * @param inScores array of scores, not modified.
+		 * @param ioIndices array of inNumIndices indices into inScores.
+		 * @param inNumIndices size of ioIndices.
+		 * @param inNumToSort the number of indices to sort to the front.
+		 * @param inDecreasingOrder set to true if the highest scores
+		 *   are best (default is false).
+		 */ 
+		void partialSortIndices( double* inScores, int* ioIndices, 
+			int inNumIndices, int inNumToSort,
+			char inDecreasingOrder=false );
 	};
 
 #endif
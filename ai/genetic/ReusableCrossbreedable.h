@@ -0,0 +1,53 @@
+#ifndef REUSABLE_CROSSBREEDABLE_INCLUDED
+#define REUSABLE_CROSSBREEDABLE_INCLUDED
+
+#include "Crossbreedable.h"
+
+#include "minorGems/util/random/RandomSource.h"
+
+
+/**
+ * A Crossbreedable that can be bred into existing storage, so a population
+ * can be carried from generation to generation without allocating
+ * members.  Used by GenerationEngine.
+ *
+ * All randomness comes from a passed-in RandomSource, so breeding is
+ * reproducible and several members can be bred at once on different
+ * threads.
+ */
+class ReusableCrossbreedable : public Crossbreedable {
+
+	public:
+
+		virtual ~ReusableCrossbreedable() {
+			}
+
+
+
+		/**
+		 * Replaces this member's contents with a crossbreed of two parents.
+		 *
+		 * Must only read the parents, which may be bred from by other
+		 * threads at the same time.  Neither parent is ever this object.
+		 *
+		 * @param inParentA the first parent.
+		 * @param inParentB the second parent.
+		 * @param inFractionOther the fraction of inParentB's
+		 *   characteristics, in [0..1], that will end up in this member.
+		 * @param inMutationProb the probability of mutations throughout
+		 *   the breeding process.
+		 * @param inMaxMutationMagnitude the maximum "severity" of any
+		 *   individual mutation, in [0..1].
+		 * @param inRandSource the source for all random choices.
+		 *   Must be destroyed by caller.
+		 */
+		virtual void crossbreedFrom( ReusableCrossbreedable *inParentA,
+			ReusableCrossbreedable *inParentB,
+			float inFractionOther, float inMutationProb,
+			float inMaxMutationMagnitude,
+			RandomSource *inRandSource ) = 0;
+
+
+	};
+
+#endif
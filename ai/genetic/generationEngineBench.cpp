@@ -0,0 +1,327 @@
+// Benchmark for GenerationEngine
+//
+// Usage:  generationEngineBench [numGenerations] [numThreads]
+//
+// Minimizes the Rastrigin function over vectors of doubles, first with
+// PopulationSorter::sortPopulation and PopulationBreeder::breedPopulation,
+// then with GenerationEngine on the calling thread and across thread pools
+// of several sizes.  Engine runs must finish with identical populations
+// regardless of thread count.
+
+
+#include "GenerationEngine.h"
+#include "PopulationBreeder.h"
+#include "PopulationSorter.h"
+
+#include "minorGems/system/Time.h"
+#include "minorGems/util/random/CustomRandomSource.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+
+
+#define NUM_GENES 32
+#define GENE_RANGE 5.12
+
+// repeats of the fitness function, standing in for an expensive simulation
+#define FITNESS_WORK 40
+
+#define POPULATION_SIZE 1000
+
+
+
+// used only by the old serial crossbreed and mutate
+static CustomRandomSource serialRandSource( 1 );
+
+
+
+class VectorGenome : public ReusableCrossbreedable, public PopulationMember {
+
+	public:
+
+		VectorGenome() {
+			for( int i=0; i<NUM_GENES; i++ ) {
+				mGenes[i] = 0;
+				}
+			}
+
+
+		void randomize( RandomSource *inRandSource ) {
+			for( int i=0; i<NUM_GENES; i++ ) {
+				mGenes[i] = inRandSource->getRandomBoundedDouble(
+					-GENE_RANGE, GENE_RANGE );
+				}
+			}
+
+
+		virtual void crossbreedFrom( ReusableCrossbreedable *inParentA,
+			ReusableCrossbreedable *inParentB,
+			float inFractionOther, float inMutationProb,
+			float inMaxMutationMagnitude,
+			RandomSource *inRandSource ) {
+
+			VectorGenome *a = (VectorGenome *)inParentA;
+			VectorGenome *b = (VectorGenome *)inParentB;
+
+			for( int i=0; i<NUM_GENES; i++ ) {
+				if( inRandSource->getRandomFloat() < inFractionOther ) {
+					mGenes[i] = b->mGenes[i];
+					}
+				else {
+					mGenes[i] = a->mGenes[i];
+					}
+				}
+			mutateWith( inMutationProb, inMaxMutationMagnitude,
+						inRandSource );
+			}
+
+
+		virtual void *crossbreed( Crossbreedable *inOther,
+			float inFractionOther, float inMutationProb,
+			float inMaxMutationMagnitude ) {
+
+			VectorGenome *offspring = new VectorGenome();
+			offspring->crossbreedFrom( this, (VectorGenome *)inOther,
+									   inFractionOther, inMutationProb,
+									   inMaxMutationMagnitude,
+									   &serialRandSource );
+			offspring->setGeneration( this, (VectorGenome *)inOther );
+			return offspring;
+			}
+
+
+		virtual void mutate( float inMutationProb,
+							 float inMaxMutationMagnitude ) {
+			mutateWith( inMutationProb, inMaxMutationMagnitude,
+						&serialRandSource );
+			}
+
+
+		double getError() {
+			double sum = 0;
+			for( int w=0; w<FITNESS_WORK; w++ ) {
+				double error = 10 * NUM_GENES;
+				for( int i=0; i<NUM_GENES; i++ ) {
+					double x = mGenes[i];
+					error += x * x - 10 * cos( 2 * M_PI * x );
+					}
+				sum += error;
+				}
+			return sum / FITNESS_WORK;
+			}
+
+
+		double mGenes[ NUM_GENES ];
+
+
+	protected:
+
+		void mutateWith( float inMutationProb, float inMaxMutationMagnitude,
+						 RandomSource *inRandSource ) {
+			for( int i=0; i<NUM_GENES; i++ ) {
+				if( inRandSource->getRandomFloat() < inMutationProb ) {
+					mGenes[i] += inRandSource->getRandomBoundedDouble(
+						-1, 1 ) * inMaxMutationMagnitude * GENE_RANGE;
+					}
+				}
+			}
+	};
+
+
+
+class NegativeErrorEvaluator : public FitnessEvaluator {
+	public:
+		virtual double getFitness( ReusableCrossbreedable *inMember,
+								   RandomSource *inRandSource ) {
+			return - ( (VectorGenome *)inMember )->getError();
+			}
+	};
+
+
+
+class GenomeDeleter : public PopulationDeleter {
+	public:
+		GenomeDeleter( VectorGenome **inPopulation )
+			: mPopulation( inPopulation ) {
+			}
+
+		virtual void deleteCrossbreedable( int inMemberIndex ) {
+			delete mPopulation[ inMemberIndex ];
+			mPopulation[ inMemberIndex ] = NULL;
+			}
+
+		virtual void addCrossbreedable( int inMemberIndex,
+										void *inNewMember ) {
+			mPopulation[ inMemberIndex ] = (VectorGenome *)inNewMember;
+			}
+
+		VectorGenome **mPopulation;
+	};
+
+
+
+static void makeStartingPopulation( VectorGenome **outPopulation ) {
+	CustomRandomSource randSource( 12345 );
+
+	for( int i=0; i<POPULATION_SIZE; i++ ) {
+		outPopulation[i] = new VectorGenome();
+		outPopulation[i]->randomize( &randSource );
+		}
+	}
+
+
+
+// the original serial loop:  score, full sort, breed
+static double runSerial( int inNumGenerations ) {
+	VectorGenome *population[ POPULATION_SIZE ];
+	makeStartingPopulation( population );
+
+	PopulationMember *members[ POPULATION_SIZE ];
+	Crossbreedable *breedables[ POPULATION_SIZE ];
+	double scores[ POPULATION_SIZE ];
+
+	PopulationSorter sorter;
+	PopulationBreeder breeder;
+	GenomeDeleter deleter( population );
+
+	double best = 0;
+
+	for( int g=0; g<inNumGenerations; g++ ) {
+		for( int i=0; i<POPULATION_SIZE; i++ ) {
+			members[i] = population[i];
+			scores[i] = population[i]->getError();
+			}
+
+		sorter.sortPopulation( members, scores, POPULATION_SIZE );
+		best = scores[0];
+
+		for( int i=0; i<POPULATION_SIZE; i++ ) {
+			population[i] = (VectorGenome *)members[i];
+			breedables[i] = population[i];
+			}
+
+		breeder.breedPopulation( breedables, POPULATION_SIZE, 0.1f, 0.2f,
+								 &deleter );
+		}
+
+	for( int i=0; i<POPULATION_SIZE; i++ ) {
+		delete population[i];
+		}
+	return best;
+	}
+
+
+
+// survivors and genes for checking runs against each other
+static double finalGenes[ POPULATION_SIZE ][ NUM_GENES ];
+static char haveFinalGenes = false;
+
+
+static int runEngine( int inNumGenerations, int inNumSurvivors,
+					  ThreadPool *inPool, double *outBest ) {
+	VectorGenome *population[ POPULATION_SIZE ];
+	makeStartingPopulation( population );
+
+	ReusableCrossbreedable *breedables[ POPULATION_SIZE ];
+	for( int i=0; i<POPULATION_SIZE; i++ ) {
+		breedables[i] = population[i];
+		}
+
+	NegativeErrorEvaluator evaluator;
+
+	GenerationEngine engine( breedables, POPULATION_SIZE, inNumSurvivors,
+							 &evaluator, 777, inPool );
+
+	for( int g=0; g<inNumGenerations; g++ ) {
+		engine.runGeneration( 0.1f, 0.2f );
+		}
+
+	*outBest = - engine.getScore( 0 );
+
+	int numDifferent = 0;
+	for( int i=0; i<POPULATION_SIZE; i++ ) {
+		VectorGenome *member = (VectorGenome *)engine.getMember( i );
+
+		if( ! haveFinalGenes ) {
+			memcpy( finalGenes[i], member->mGenes, sizeof( member->mGenes ) );
+			}
+		else if( memcmp( finalGenes[i], member->mGenes,
+						 sizeof( member->mGenes ) ) != 0 ) {
+			numDifferent++;
+			}
+		}
+	haveFinalGenes = true;
+
+	return numDifferent;
+	}
+
+
+
+int main( int inNumArgs, char **inArgs ) {
+
+	int numGenerations = 50;
+	int numThreads = -1;
+
+	if( inNumArgs > 1 ) {
+		numGenerations = atoi( inArgs[1] );
+		}
+	if( inNumArgs > 2 ) {
+		numThreads = atoi( inArgs[2] );
+		}
+
+	// same number of parents PopulationBreeder keeps
+	int numSurvivors =
+		(int)( ( -1 + sqrt( 1 + 8 * POPULATION_SIZE ) ) * 0.5 );
+
+	printf( "population %d, %d survivors, %d generations\n\n",
+			POPULATION_SIZE, numSurvivors, numGenerations );
+
+
+	// PopulationBreeder prints a line per generation
+	double t = Time::getCurrentTime();
+	double serialBest = runSerial( numGenerations );
+	double serialTime = Time::getCurrentTime() - t;
+
+	printf( "\n%-32s %8.3fs  best error %.6f\n",
+			"sortPopulation/breedPopulation", serialTime, serialBest );
+
+
+	double best;
+	t = Time::getCurrentTime();
+	runEngine( numGenerations, numSurvivors, NULL, &best );
+	printf( "%-32s %8.3fs  best error %.6f\n",
+			"GenerationEngine, no pool", Time::getCurrentTime() - t, best );
+
+
+	int numBad = 0;
+
+	int threadCounts[3] = { 1, 4, numThreads };
+
+	for( int i=0; i<3; i++ ) {
+		ThreadPool pool( threadCounts[i] );
+
+		double poolBest;
+		t = Time::getCurrentTime();
+		int numDifferent = runEngine( numGenerations, numSurvivors,
+									  &pool, &poolBest );
+
+		char name[64];
+		snprintf( name, sizeof( name ), "GenerationEngine, %d threads",
+				  pool.getNumThreads() );
+		printf( "%-32s %8.3fs  best error %.6f  %s\n",
+				name, Time::getCurrentTime() - t, poolBest,
+				numDifferent == 0 ? "same population" : "DIFFERENT" );
+
+		numBad += numDifferent;
+		}
+
+	if( numBad != 0 ) {
+		printf( "FAILED:  populations depend on thread count\n" );
+		return 1;
+		}
+
+	return 0;
+	}
@@ -0,0 +1,182 @@
+#ifndef SAD_WINDOW_STEREO_INCLUDED
+#define SAD_WINDOW_STEREO_INCLUDED
+
+
+#include "PartialStereo.h"
+#include "WindowSADEngine.h"
+
+#include "minorGems/graphics/ImageColorConverter.h"
+
+#include <stdio.h>
+
+
+
+/**
+ * Local window stereo using sum-of-absolute-difference windows computed
+ * incrementally by WindowSADEngine.
+ *
+ * Same window placement and output as LocalWindowStereo, but cost per pixel
+ * does not grow with the window size, and rows are split across a
+ * ThreadPool instead of only channels.  Windows that would shift outside
+ * the right image are skipped rather than scored against random values,
+ * so results are deterministic.
+ *
+ * Callers with 8-bit or 16-bit camera data can skip the Image conversion
+ * entirely with computeDisparities.
+ */
+class SADWindowStereo : public PartialStereo {
+
+	public:
+
+		/**
+		 * Constructs a stereo object.
+		 *
+		 * @param inMaxDisparity the maximum disparity in pixels.
+		 * @param inWindowSize the diameter of each square pixel window.
+		 * @param inPool the thread pool to split rows across, or NULL
+		 *   to compute on the calling thread.  Shared by copies, and
+		 *   must be destroyed by caller after this object.
+		 */
+		SADWindowStereo( int inMaxDisparity, int inWindowSize,
+						 ThreadPool *inPool = NULL );
+
+
+		// implements the stereo interface
+		virtual Image *computeDepthMap( Image *inLeft, Image *inRight );
+		virtual Stereo *copy();
+
+
+		/**
+		 * Computes raw disparities for the current range, with no
+		 * conversion to or from Image.
+		 *
+		 * @param inLeft, inRight inWidth*inHeight row-major intensities.
+		 * @param outDisparities inWidth*inHeight disparities in pixels.
+		 *   Pixels outside the range (or too near the image edge for a
+		 *   full window) are set to 0.
+		 */
+		void computeDisparities( unsigned char *inLeft,
+								 unsigned char *inRight,
+								 int inWidth, int inHeight,
+								 unsigned short *outDisparities );
+
+		void computeDisparities( unsigned short *inLeft,
+								 unsigned short *inRight,
+								 int inWidth, int inHeight,
+								 unsigned short *outDisparities );
+
+	private:
+		int mWindowSize;
+
+		ThreadPool *mPool;
+	};
+
+
+
+inline SADWindowStereo::SADWindowStereo(
+	int inMaxDisparity, int inWindowSize, ThreadPool *inPool )
+	: PartialStereo( inMaxDisparity ), mWindowSize( inWindowSize ),
+	  mPool( inPool ) {
+
+	}
+
+
+
+inline Stereo *SADWindowStereo::copy() {
+
+	SADWindowStereo *returnValue =
+		new SADWindowStereo( mMaxDisparity, mWindowSize, mPool );
+	returnValue->setRange( mXStart, mXEnd, mYStart, mYEnd );
+	returnValue->setImageChannel( mChannelNumber );
+
+	return returnValue;
+	}
+
+
+
+inline void SADWindowStereo::computeDisparities(
+	unsigned char *inLeft, unsigned char *inRight,
+	int inWidth, int inHeight,
+	unsigned short *outDisparities ) {
+
+	memset( outDisparities, 0,
+			sizeof( unsigned short ) * inWidth * inHeight );
+
+	WindowSADEngine engine( mMaxDisparity, mWindowSize, mPool );
+
+	engine.computeDisparities(
+		inLeft, inRight, inWidth, inHeight,
+		(int)( mXStart * inWidth ), (int)( mXEnd * inWidth ) - 1,
+		(int)( mYStart * inHeight ), (int)( mYEnd * inHeight ) - 1,
+		outDisparities );
+	}
+
+
+
+inline void SADWindowStereo::computeDisparities(
+	unsigned short *inLeft, unsigned short *inRight,
+	int inWidth, int inHeight,
+	unsigned short *outDisparities ) {
+
+	memset( outDisparities, 0,
+			sizeof( unsigned short ) * inWidth * inHeight );
+
+	WindowSADEngine engine( mMaxDisparity, mWindowSize, mPool );
+
+	engine.computeDisparities(
+		inLeft, inRight, inWidth, inHeight,
+		(int)( mXStart * inWidth ), (int)( mXEnd * inWidth ) - 1,
+		(int)( mYStart * inHeight ), (int)( mYEnd * inHeight ) - 1,
+		outDisparities );
+	}
+
+
+
+inline Image *SADWindowStereo::computeDepthMap( Image *inLeft,
+												Image *inRight ) {
+
+	int w = inLeft->getWidth();
+	int h = inLeft->getHeight();
+
+	if( h != inRight->getHeight() || w != inRight->getWidth() ) {
+		printf( "SADWindowStereo:  "
+				"Left and right images must be the same size.\n" );
+		return NULL;
+		}
+
+	int channel = mChannelNumber;
+	if( channel >= inLeft->getNumChannels() ) {
+		channel = 0;
+		}
+
+	unsigned char *leftChannel =
+		ImageColorConverter::grayscaleToByteArray( inLeft, channel );
+	unsigned char *rightChannel =
+		ImageColorConverter::grayscaleToByteArray( inRight, channel );
+
+	int numPixels = w * h;
+
+	unsigned short *disparities = new unsigned short[ numPixels ];
+
+	computeDisparities( leftChannel, rightChannel, w, h, disparities );
+
+	delete [] leftChannel;
+	delete [] rightChannel;
+
+
+	Image *outImage = new Image( w, h, 1 );
+	double *outChannel = outImage->getChannel( 0 );
+
+	double invMax = 1.0 / (double)mMaxDisparity;
+
+	for( int i=0; i<numPixels; i++ ) {
+		outChannel[i] = disparities[i] * invMax;
+		}
+
+	delete [] disparities;
+
+	return outImage;
+	}
+
+
+#endif
@@ -0,0 +1,609 @@
+#ifndef WINDOW_SAD_ENGINE_INCLUDED
+#define WINDOW_SAD_ENGINE_INCLUDED
+
+
+#include "minorGems/system/ThreadPool.h"
+
+#include <limits.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+
+
+/**
+ * Winner-take-all disparity search over square sum-of-absolute-difference
+ * windows, on raw 8-bit or 16-bit intensity rows.
+ *
+ * Window costs are computed incrementally.  For each disparity, per-column
+ * sums of absolute differences are slid down the image one row at a time
+ * (one row added, one removed), and window sums are slid across each row
+ * the same way, so the cost per pixel per disparity does not depend on the
+ * window size.  Column sums are updated with SSE2 where available.
+ *
+ * Rows are split into tiles that run in parallel on a ThreadPool.
+ *
+ * Window placement and the valid output region match LocalWindowStereo:
+ * for even window sizes, the window extends one pixel further up and left.
+ * A disparity d is only considered at x if the whole window, shifted left
+ * by d, lands inside the right image.  Ties go to the smaller disparity.
+ */
+class WindowSADEngine {
+
+    public:
+
+
+        /**
+         * @param inMaxDisparity the largest disparity searched.
+         * @param inWindowSize the diameter of each square window.
+         * @param inPool the pool to spread row tiles across, or NULL
+         *   to run on the calling thread.  Not destroyed by this class.
+         */
+        WindowSADEngine( int inMaxDisparity, int inWindowSize,
+                         ThreadPool *inPool = NULL );
+
+
+        /**
+         * Computes the best disparity for each pixel in a region.
+         *
+         * @param inLeft, inRight w*h row-major intensities.
+         * @param inXStart, inXEnd, inYStart, inYEnd inclusive pixel bounds
+         *   of the region to compute.  Clamped so every window fits in
+         *   the image.
+         * @param outDisparities w*h values, written only inside the
+         *   clamped region.
+         */
+        void computeDisparities( unsigned char *inLeft,
+                                 unsigned char *inRight,
+                                 int inWidth, int inHeight,
+                                 int inXStart, int inXEnd,
+                                 int inYStart, int inYEnd,
+                                 unsigned short *outDisparities );
+
+
+        void computeDisparities( unsigned short *inLeft,
+                                 unsigned short *inRight,
+                                 int inWidth, int inHeight,
+                                 int inXStart, int inXEnd,
+                                 int inYStart, int inYEnd,
+                                 unsigned short *outDisparities );
+
+
+        // window extent below/right of and above/left of the center pixel
+        int getBoxRadius() {
+            return mBoxRad;
+            }
+
+        int getStartBox() {
+            return mStartBox;
+            }
+
+
+
+        // one computeDisparities call, shared by all tiles
+        template< class Pixel >
+        struct Frame {
+                Pixel *left;
+                Pixel *right;
+                int w;
+                int xStart, xEnd;
+                int maxDisparity;
+                int boxRad, startBox;
+                unsigned short *out;
+            };
+
+
+        // computes output rows [inY0, inY1] of a frame
+        template< class Pixel, class Sum >
+        static void computeRows( Frame<Pixel> *inFrame, int inY0, int inY1 );
+
+
+    private:
+
+        template< class Pixel, class Sum >
+        void compute( Frame<Pixel> *inFrame, int inYStart, int inYEnd );
+
+
+        int mMaxDisparity;
+        int mBoxRad;
+        int mStartBox;
+
+        ThreadPool *mPool;
+    };
+
+
+
+
+// column sums += |L[x] - R[x-d]|, for x in [inX, w)
+template< class Pixel, class Sum >
+inline void windowSADAddRow( Sum *ioSums, Pixel *inL, Pixel *inR,
+                             int inD, int inX, int inW ) {
+    for( int x=inX; x<inW; x++ ) {
+        int diff = (int)inL[x] - (int)inR[ x - inD ];
+        if( diff < 0 ) {
+            diff = -diff;
+            }
+        ioSums[x] += (Sum)diff;
+        }
+    }
+
+
+
+// column sums += one row's differences - another row's differences
+// (unsigned wrap-around cancels out, since the true sums always fit)
+template< class Pixel, class Sum >
+inline void windowSADSlideRow( Sum *ioSums,
+                               Pixel *inAddL, Pixel *inAddR,
+                               Pixel *inSubL, Pixel *inSubR,
+                               int inD, int inX, int inW ) {
+    for( int x=inX; x<inW; x++ ) {
+        int add = (int)inAddL[x] - (int)inAddR[ x - inD ];
+        if( add < 0 ) {
+            add = -add;
+            }
+        int sub = (int)inSubL[x] - (int)inSubR[ x - inD ];
+        if( sub < 0 ) {
+            sub = -sub;
+            }
+        ioSums[x] += (Sum)add;
+        ioSums[x] -= (Sum)sub;
+        }
+    }
+
+
+
+#ifdef __SSE2__
+
+
+static inline __m128i windowSADAbsDiff8( unsigned char *inL,
+                                         unsigned char *inR ) {
+    __m128i a = _mm_loadu_si128( (__m128i*)inL );
+    __m128i b = _mm_loadu_si128( (__m128i*)inR );
+    return _mm_or_si128( _mm_subs_epu8( a, b ), _mm_subs_epu8( b, a ) );
+    }
+
+
+static inline __m128i windowSADAbsDiff16( unsigned short *inL,
+                                          unsigned short *inR ) {
+    __m128i a = _mm_loadu_si128( (__m128i*)inL );
+    __m128i b = _mm_loadu_si128( (__m128i*)inR );
+    return _mm_or_si128( _mm_subs_epu16( a, b ), _mm_subs_epu16( b, a ) );
+    }
+
+
+
+// 8-bit pixels, 16-bit sums, 16 columns per step
+
+template<>
+inline void windowSADAddRow( unsigned short *ioSums,
+                             unsigned char *inL, unsigned char *inR,
+                             int inD, int inX, int inW ) {
+    __m128i zero = _mm_setzero_si128();
+
+    int x = inX;
+    for( ; x + 16 <= inW; x += 16 ) {
+        __m128i ad = windowSADAbsDiff8( &( inL[x] ), &( inR[ x - inD ] ) );
+
+        __m128i *s = (__m128i*)&( ioSums[x] );
+
+        __m128i s0 = _mm_loadu_si128( s );
+        __m128i s1 = _mm_loadu_si128( s + 1 );
+
+        s0 = _mm_add_epi16( s0, _mm_unpacklo_epi8( ad, zero ) );
+        s1 = _mm_add_epi16( s1, _mm_unpackhi_epi8( ad, zero ) );
+
+        _mm_storeu_si128( s, s0 );
+        _mm_storeu_si128( s + 1, s1 );
+        }
+
+    for( ; x<inW; x++ ) {
+        int diff = (int)inL[x] - (int)inR[ x - inD ];
+        if( diff < 0 ) {
+            diff = -diff;
+            }
+        ioSums[x] += (unsigned short)diff;
+        }
+    }
+
+
+
+template<>
+inline void windowSADSlideRow( unsigned short *ioSums,
+                               unsigned char *inAddL, unsigned char *inAddR,
+                               unsigned char *inSubL, unsigned char *inSubR,
+                               int inD, int inX, int inW ) {
+    __m128i zero = _mm_setzero_si128();
+
+    int x = inX;
+    for( ; x + 16 <= inW; x += 16 ) {
+        __m128i add = windowSADAbsDiff8( &( inAddL[x] ),
+                                         &( inAddR[ x - inD ] ) );
+        __m128i sub = windowSADAbsDiff8( &( inSubL[x] ),
+                                         &( inSubR[ x - inD ] ) );
+
+        __m128i *s = (__m128i*)&( ioSums[x] );
+
+        __m128i s0 = _mm_loadu_si128( s );
+        __m128i s1 = _mm_loadu_si128( s + 1 );
+
+        s0 = _mm_add_epi16( s0, _mm_unpacklo_epi8( add, zero ) );
+        s1 = _mm_add_epi16( s1, _mm_unpackhi_epi8( add, zero ) );
+        s0 = _mm_sub_epi16( s0, _mm_unpacklo_epi8( sub, zero ) );
+        s1 = _mm_sub_epi16( s1, _mm_unpackhi_epi8( sub, zero ) );
+
+        _mm_storeu_si128( s, s0 );
+        _mm_storeu_si128( s + 1, s1 );
+        }
+
+    for( ; x<inW; x++ ) {
+        int add = (int)inAddL[x] - (int)inAddR[ x - inD ];
+        if( add < 0 ) {
+            add = -add;
+            }
+        int sub = (int)inSubL[x] - (int)inSubR[ x - inD ];
+        if( sub < 0 ) {
+            sub = -sub;
+            }
+        ioSums[x] += (unsigned short)add;
+        ioSums[x] -= (unsigned short)sub;
+        }
+    }
+
+
+
+// 16-bit pixels, 32-bit sums, 8 columns per step
+
+template<>
+inline void windowSADAddRow( unsigned int *ioSums,
+                             unsigned short *inL, unsigned short *inR,
+                             int inD, int inX, int inW ) {
+    __m128i zero = _mm_setzero_si128();
+
+    int x = inX;
+    for( ; x + 8 <= inW; x += 8 ) {
+        __m128i ad = windowSADAbsDiff16( &( inL[x] ), &( inR[ x - inD ] ) );
+
+        __m128i *s = (__m128i*)&( ioSums[x] );
+
+        __m128i s0 = _mm_loadu_si128( s );
+        __m128i s1 = _mm_loadu_si128( s + 1 );
+
+        s0 = _mm_add_epi32( s0, _mm_unpacklo_epi16( ad, zero ) );
+        s1 = _mm_add_epi32( s1, _mm_unpackhi_epi16( ad, zero ) );
+
+        _mm_storeu_si128( s, s0 );
+        _mm_storeu_si128( s + 1, s1 );
+        }
+
+    for( ; x<inW; x++ ) {
+        int diff = (int)inL[x] - (int)inR[ x - inD ];
+        if( diff < 0 ) {
+            diff = -diff;
+            }
+        ioSums[x] += (unsigned int)diff;
+        }
+    }
+
+
+
+template<>
+inline void windowSADSlideRow( unsigned int *ioSums,
+                               unsigned short *inAddL, unsigned short *inAddR,
+                               unsigned short *inSubL, unsigned short *inSubR,
+                               int inD, int inX, int inW ) {
+    __m128i zero = _mm_setzero_si128();
+
+    int x = inX;
+    for( ; x + 8 <= inW; x += 8 ) {
+        __m128i add = windowSADAbsDiff16( &( inAddL[x] ),
+                                          &( inAddR[ x - inD ] ) );
+        __m128i sub = windowSADAbsDiff16( &( inSubL[x] ),
+                                          &( inSubR[ x - inD ] ) );
+
+        __m128i *s = (__m128i*)&( ioSums[x] );
+
+        __m128i s0 = _mm_loadu_si128( s );
+        __m128i s1 = _mm_loadu_si128( s + 1 );
+
+        s0 = _mm_add_epi32( s0, _mm_unpacklo_epi16( add, zero ) );
+        s1 = _mm_add_epi32( s1, _mm_unpackhi_epi16( add, zero ) );
+        s0 = _mm_sub_epi32( s0, _mm_unpacklo_epi16( sub, zero ) );
+        s1 = _mm_sub_epi32( s1, _mm_unpackhi_epi16( sub, zero ) );
+
+        _mm_storeu_si128( s, s0 );
+        _mm_storeu_si128( s + 1, s1 );
+        }
+
+    for( ; x<inW; x++ ) {
+        int add = (int)inAddL[x] - (int)inAddR[ x - inD ];
+        if( add < 0 ) {
+            add = -add;
+            }
+        int sub = (int)inSubL[x] - (int)inSubR[ x - inD ];
+        if( sub < 0 ) {
+            sub = -sub;
+            }
+        ioSums[x] += (unsigned int)add;
+        ioSums[x] -= (unsigned int)sub;
+        }
+    }
+
+
+#endif
+
+
+
+
+template< class Pixel, class Sum >
+void WindowSADEngine::computeRows( Frame<Pixel> *inFrame,
+                                   int inY0, int inY1 ) {
+
+    int w = inFrame->w;
+    int boxRad = inFrame->boxRad;
+    int startBox = inFrame->startBox;
+    int xStart = inFrame->xStart;
+    int xEnd = inFrame->xEnd;
+
+    int numRows = inY1 - inY0 + 1;
+    int rowWidth = xEnd - xStart + 1;
+
+    Sum *colSums = new Sum[ w ];
+
+    unsigned int *bestCost = new unsigned int[ numRows * rowWidth ];
+    unsigned short *bestDisp = new unsigned short[ numRows * rowWidth ];
+
+    for( int i=0; i<numRows * rowWidth; i++ ) {
+        bestCost[i] = UINT_MAX;
+        bestDisp[i] = 0;
+        }
+
+
+    int maxD = inFrame->maxDisparity;
+
+    // no window can shift further than this and stay in the image
+    if( maxD > xEnd - startBox ) {
+        maxD = xEnd - startBox;
+        }
+
+    for( int d=0; d<=maxD; d++ ) {
+
+        // leftmost output x whose shifted window stays in the image
+        int x0 = startBox + d;
+        if( x0 < xStart ) {
+            x0 = xStart;
+            }
+
+        // only columns from here on feed any window
+        int colStart = x0 - startBox;
+
+        memset( colSums, 0, sizeof( Sum ) * w );
+
+        for( int r = inY0 - startBox; r <= inY0 + boxRad; r++ ) {
+            windowSADAddRow<Pixel,Sum>(
+                colSums,
+                &( inFrame->left[ r * w ] ), &( inFrame->right[ r * w ] ),
+                d, colStart, w );
+            }
+
+        for( int y=inY0; y<=inY1; y++ ) {
+
+            // slide across the row
+            unsigned int sum = 0;
+            for( int x = x0 - startBox; x <= x0 + boxRad; x++ ) {
+                sum += colSums[x];
+                }
+
+            unsigned int *rowCost = &( bestCost[ ( y - inY0 ) * rowWidth ] );
+            unsigned short *rowDisp =
+                &( bestDisp[ ( y - inY0 ) * rowWidth ] );
+
+            for( int x=x0; x<=xEnd; x++ ) {
+                int i = x - xStart;
+
+                if( sum < rowCost[i] ) {
+                    rowCost[i] = sum;
+                    rowDisp[i] = (unsigned short)d;
+                    }
+
+                if( x < xEnd ) {
+                    sum += colSums[ x + boxRad + 1 ];
+                    sum -= colSums[ x - startBox ];
+                    }
+                }
+
+
+            // slide down to the next row
+            if( y < inY1 ) {
+                int addRow = ( y + boxRad + 1 ) * w;
+                int subRow = ( y - startBox ) * w;
+
+                windowSADSlideRow<Pixel,Sum>(
+                    colSums,
+                    &( inFrame->left[ addRow ] ),
+                    &( inFrame->right[ addRow ] ),
+                    &( inFrame->left[ subRow ] ),
+                    &( inFrame->right[ subRow ] ),
+                    d, colStart, w );
+                }
+            }
+        }
+
+
+    for( int y=inY0; y<=inY1; y++ ) {
+        memcpy( &( inFrame->out[ y * w + xStart ] ),
+                &( bestDisp[ ( y - inY0 ) * rowWidth ] ),
+                sizeof( unsigned short ) * rowWidth );
+        }
+
+    delete [] colSums;
+    delete [] bestCost;
+    delete [] bestDisp;
+    }
+
+
+
+template< class Pixel, class Sum >
+class WindowSADJob : public ThreadPoolJob {
+    public:
+        WindowSADEngine::Frame<Pixel> *mFrame;
+        int mY0, mY1;
+
+        virtual void runJob() {
+            WindowSADEngine::computeRows<Pixel,Sum>( mFrame, mY0, mY1 );
+            }
+    };
+
+
+
+template< class Pixel, class Sum >
+void WindowSADEngine::compute( Frame<Pixel> *inFrame,
+                               int inYStart, int inYEnd ) {
+
+    if( inFrame->xEnd < inFrame->xStart || inYEnd < inYStart ) {
+        return;
+        }
+
+    int numRows = inYEnd - inYStart + 1;
+
+    if( mPool == NULL || mPool->getNumThreads() < 2 ) {
+        computeRows<Pixel,Sum>( inFrame, inYStart, inYEnd );
+        return;
+        }
+
+    // a few tiles per thread to even out load, but tall enough that
+    // refilling the column sums at the top of each tile stays cheap
+    int tileRows = numRows / ( mPool->getNumThreads() * 4 );
+
+    int minTileRows = 4 * ( mBoxRad + mStartBox + 1 );
+    if( tileRows < minTileRows ) {
+        tileRows = minTileRows;
+        }
+
+    int numTiles = ( numRows + tileRows - 1 ) / tileRows;
+
+    WindowSADJob<Pixel,Sum> *jobs = new WindowSADJob<Pixel,Sum>[ numTiles ];
+
+    for( int t=0; t<numTiles; t++ ) {
+        jobs[t].mFrame = inFrame;
+        jobs[t].mY0 = inYStart + t * tileRows;
+        jobs[t].mY1 = jobs[t].mY0 + tileRows - 1;
+
+        if( jobs[t].mY1 > inYEnd ) {
+            jobs[t].mY1 = inYEnd;
+            }
+        mPool->addJob( &( jobs[t] ) );
+        }
+
+    mPool->waitForAllJobs();
+
+    delete [] jobs;
+    }
+
+
+
+inline WindowSADEngine::WindowSADEngine( int inMaxDisparity,
+                                         int inWindowSize,
+                                         ThreadPool *inPool )
+        : mMaxDisparity( inMaxDisparity ), mPool( inPool ) {
+
+    mBoxRad = inWindowSize / 2;
+    mStartBox = mBoxRad;
+
+    if( inWindowSize % 2 == 0 ) {
+        mBoxRad -= 1;
+        }
+    }
+
+
+
+// fills a frame, clamping the region so every window fits in the image
+// returns false if the region is empty
+template< class Pixel >
+inline char windowSADSetupFrame( WindowSADEngine::Frame<Pixel> *outFrame,
+                                 Pixel *inLeft, Pixel *inRight,
+                                 int inWidth, int inHeight,
+                                 int inXStart, int inXEnd,
+                                 int *ioYStart, int *ioYEnd,
+                                 int inMaxDisparity,
+                                 int inBoxRad, int inStartBox,
+                                 unsigned short *outDisparities ) {
+
+    if( *ioYStart < inStartBox ) {
+        *ioYStart = inStartBox;
+        }
+    if( *ioYEnd > inHeight - inBoxRad - 1 ) {
+        *ioYEnd = inHeight - inBoxRad - 1;
+        }
+    if( inXStart < inStartBox ) {
+        inXStart = inStartBox;
+        }
+    if( inXEnd > inWidth - inBoxRad - 1 ) {
+        inXEnd = inWidth - inBoxRad - 1;
+        }
+
+    outFrame->left = inLeft;
+    outFrame->right = inRight;
+    outFrame->w = inWidth;
+    outFrame->xStart = inXStart;
+    outFrame->xEnd = inXEnd;
+    outFrame->maxDisparity = inMaxDisparity;
+    outFrame->boxRad = inBoxRad;
+    outFrame->startBox = inStartBox;
+    outFrame->out = outDisparities;
+
+    return ( inXStart <= inXEnd && *ioYStart <= *ioYEnd );
+    }
+
+
+
+inline void WindowSADEngine::computeDisparities(
+    unsigned char *inLeft, unsigned char *inRight,
+    int inWidth, int inHeight,
+    int inXStart, int inXEnd, int inYStart, int inYEnd,
+    unsigned short *outDisparities ) {
+
+    Frame<unsigned char> frame;
+
+    if( ! windowSADSetupFrame( &frame, inLeft, inRight, inWidth, inHeight,
+                               inXStart, inXEnd, &inYStart, &inYEnd,
+                               mMaxDisparity, mBoxRad, mStartBox,
+                               outDisparities ) ) {
+        return;
+        }
+
+    int windowHeight = mBoxRad + mStartBox + 1;
+
+    if( windowHeight * 255 <= 0xFFFF ) {
+        compute<unsigned char, unsigned short>( &frame, inYStart, inYEnd );
+        }
+    else {
+        // column sums could overflow 16 bits
+        compute<unsigned char, unsigned int>( &frame, inYStart, inYEnd );
+        }
+    }
+
+
+
+inline void WindowSADEngine::computeDisparities(
+    unsigned short *inLeft, unsigned short *inRight,
+    int inWidth, int inHeight,
+    int inXStart, int inXEnd, int inYStart, int inYEnd,
+    unsigned short *outDisparities ) {
+
+    Frame<unsigned short> frame;
+
+    if( ! windowSADSetupFrame( &frame, inLeft, inRight, inWidth, inHeight,
+                               inXStart, inXEnd, &inYStart, &inYEnd,
+                               mMaxDisparity, mBoxRad, mStartBox,
+                               outDisparities ) ) {
+        return;
+        }
+
+    compute<unsigned short, unsigned int>( &frame, inYStart, inYEnd );
+    }
+
+
+
+#endif
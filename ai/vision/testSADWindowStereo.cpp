@@ -0,0 +1,219 @@
+// Checks SADWindowStereo against a brute-force window SAD search, then
+// times it against LocalWindowStereo on a 640x480 synthetic pair.
+//
+// Usage:  testSADWindowStereo [numThreads]
+
+
+#include "SADWindowStereo.h"
+#include "LocalWindowStereo.h"
+
+#include "minorGems/system/Time.h"
+#include "minorGems/util/random/StdRandomSource.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+
+
+// straightforward O(r^2) per disparity search with the same rules
+template< class Pixel >
+static void bruteForce( Pixel *inLeft, Pixel *inRight, int inW, int inH,
+                        int inMaxD, int inWindowSize,
+                        unsigned short *outDisp ) {
+
+    int boxRad = inWindowSize / 2;
+    int startBox = boxRad;
+    if( inWindowSize % 2 == 0 ) {
+        boxRad -= 1;
+        }
+
+    memset( outDisp, 0, sizeof( unsigned short ) * inW * inH );
+
+    for( int y=startBox; y<inH-boxRad; y++ ) {
+        for( int x=startBox; x<inW-boxRad; x++ ) {
+
+            unsigned long bestCost = ULONG_MAX;
+            int bestD = 0;
+
+            for( int d=0; d<=inMaxD && x - startBox - d >= 0; d++ ) {
+                unsigned long cost = 0;
+
+                for( int dy=-startBox; dy<=boxRad; dy++ ) {
+                    for( int dx=-startBox; dx<=boxRad; dx++ ) {
+                        int i = ( y + dy ) * inW + x + dx;
+                        int diff = (int)inLeft[i] - (int)inRight[ i - d ];
+                        cost += ( diff < 0 ) ? -diff : diff;
+                        }
+                    }
+                if( cost < bestCost ) {
+                    bestCost = cost;
+                    bestD = d;
+                    }
+                }
+            outDisp[ y * inW + x ] = (unsigned short)bestD;
+            }
+        }
+    }
+
+
+
+// right image is the left image shifted by a disparity that grows
+// toward the bottom, plus noise
+template< class Pixel >
+static void makePair( Pixel *outLeft, Pixel *outRight, int inW, int inH,
+                      int inMaxValue, int inMaxD ) {
+
+    for( int i=0; i<inW*inH; i++ ) {
+        outLeft[i] = (Pixel)( rand() % ( inMaxValue + 1 ) );
+        }
+
+    for( int y=0; y<inH; y++ ) {
+        int d = ( y * inMaxD ) / inH;
+
+        for( int x=0; x<inW; x++ ) {
+            int sx = x + d;
+            if( sx >= inW ) {
+                sx = inW - 1;
+                }
+            int v = outLeft[ y * inW + sx ] + ( rand() % 5 ) - 2;
+            if( v < 0 ) {
+                v = 0;
+                }
+            if( v > inMaxValue ) {
+                v = inMaxValue;
+                }
+            outRight[ y * inW + x ] = (Pixel)v;
+            }
+        }
+    }
+
+
+
+template< class Pixel >
+static int checkAgainstBruteForce( int inW, int inH, int inMaxValue,
+                                   int inMaxD, int inWindowSize,
+                                   ThreadPool *inPool ) {
+
+    Pixel *left = new Pixel[ inW * inH ];
+    Pixel *right = new Pixel[ inW * inH ];
+
+    makePair( left, right, inW, inH, inMaxValue, inMaxD );
+
+    unsigned short *expected = new unsigned short[ inW * inH ];
+    unsigned short *result = new unsigned short[ inW * inH ];
+
+    bruteForce( left, right, inW, inH, inMaxD, inWindowSize, expected );
+
+    SADWindowStereo stereo( inMaxD, inWindowSize, inPool );
+    stereo.computeDisparities( left, right, inW, inH, result );
+
+    int numBad = 0;
+    for( int i=0; i<inW*inH; i++ ) {
+        if( expected[i] != result[i] ) {
+            numBad++;
+            }
+        }
+
+    printf( "%2d-bit, %3dx%3d, window %2d, maxD %2d, %s:  %s\n",
+            (int)sizeof( Pixel ) * 8, inW, inH, inWindowSize, inMaxD,
+            inPool == NULL ? "serial" : "pool  ",
+            numBad == 0 ? "ok" : "MISMATCH" );
+
+    delete [] left;
+    delete [] right;
+    delete [] expected;
+    delete [] result;
+
+    return numBad;
+    }
+
+
+
+int main( int inNumArgs, char **inArgs ) {
+
+    int numThreads = -1;
+    if( inNumArgs > 1 ) {
+        numThreads = atoi( inArgs[1] );
+        }
+
+    srand( 1 );
+
+    ThreadPool pool( numThreads );
+
+    int numBad = 0;
+
+    int windowSizes[4] = { 3, 4, 7, 10 };
+
+    for( int i=0; i<4; i++ ) {
+        numBad += checkAgainstBruteForce<unsigned char>(
+            101, 67, 255, 12, windowSizes[i], NULL );
+        numBad += checkAgainstBruteForce<unsigned char>(
+            101, 67, 255, 12, windowSizes[i], &pool );
+        numBad += checkAgainstBruteForce<unsigned short>(
+            77, 90, 65535, 9, windowSizes[i], &pool );
+        }
+
+    if( numBad != 0 ) {
+        printf( "FAILED\n" );
+        return 1;
+        }
+
+
+    // timing at camera resolution
+    int w = 640;
+    int h = 480;
+    int maxD = 48;
+    int windowSize = 9;
+
+    Image left( w, h, 1 );
+    Image right( w, h, 1 );
+
+    unsigned char *leftBytes = new unsigned char[ w * h ];
+    unsigned char *rightBytes = new unsigned char[ w * h ];
+    makePair( leftBytes, rightBytes, w, h, 255, maxD );
+
+    for( int i=0; i<w*h; i++ ) {
+        left.getChannel( 0 )[i] = leftBytes[i] / 255.0;
+        right.getChannel( 0 )[i] = rightBytes[i] / 255.0;
+        }
+
+    printf( "\n%dx%d, window %d, maxD %d\n", w, h, windowSize, maxD );
+
+    StdRandomSource randSource( 1 );
+    LocalWindowStereo oldStereo( maxD, windowSize, &randSource );
+
+    double t = Time::getCurrentTime();
+    Image *oldMap = oldStereo.computeDepthMap( &left, &right );
+    printf( "LocalWindowStereo:                %8.1f ms\n",
+            1000 * ( Time::getCurrentTime() - t ) );
+    delete oldMap;
+
+
+    SADWindowStereo serialStereo( maxD, windowSize );
+    t = Time::getCurrentTime();
+    Image *newMap = serialStereo.computeDepthMap( &left, &right );
+    printf( "SADWindowStereo, Image, serial:   %8.1f ms\n",
+            1000 * ( Time::getCurrentTime() - t ) );
+    delete newMap;
+
+
+    SADWindowStereo poolStereo( maxD, windowSize, &pool );
+
+    unsigned short *disp = new unsigned short[ w * h ];
+
+    int numFrames = 10;
+    t = Time::getCurrentTime();
+    for( int f=0; f<numFrames; f++ ) {
+        poolStereo.computeDisparities( leftBytes, rightBytes, w, h, disp );
+        }
+    double frameTime = ( Time::getCurrentTime() - t ) / numFrames;
+
+    printf( "SADWindowStereo, bytes, %2d threads:%7.1f ms  (%.1f fps)\n",
+            pool.getNumThreads(), 1000 * frameTime, 1 / frameTime );
+
+    delete [] disp;
+    delete [] leftBytes;
+    delete [] rightBytes;
+
+    return 0;
+    }
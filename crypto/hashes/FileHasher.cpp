@@ -0,0 +1,647 @@
+#include "FileHasher.h"
+
+#include "minorGems/formats/encodingUtils.h"
+#include "minorGems/util/stringUtils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef WIN_32
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+
+
+// deep enough for any install tree
+#define MAX_TREE_DEPTH 64
+
+
+
+FileHashManifest::FileHashManifest() {
+    }
+
+
+
+FileHashManifest::~FileHashManifest() {
+    clear();
+    }
+
+
+
+void FileHashManifest::clear() {
+    for( int i=0; i<mEntries.size(); i++ ) {
+        delete [] mEntries.getElement( i )->path;
+        }
+    mEntries.deleteAll();
+    }
+
+
+
+void FileHashManifest::addEntry( const char *inPath, long inLength,
+                                 timeSec_t inModificationTime,
+                                 unsigned char *inDigest ) {
+    FileHashEntry entry;
+
+    entry.path = stringDuplicate( inPath );
+    entry.length = inLength;
+    entry.modificationTime = inModificationTime;
+    memcpy( entry.digest, inDigest, SHA1_DIGEST_LENGTH );
+
+    mEntries.push_back( entry );
+    }
+
+
+
+int FileHashManifest::getNumEntries() {
+    return mEntries.size();
+    }
+
+
+
+FileHashEntry *FileHashManifest::getEntry( int inIndex ) {
+    return mEntries.getElement( inIndex );
+    }
+
+
+
+static int compareEntryPaths( const void *inA, const void *inB ) {
+    return strcmp( ( (const FileHashEntry *)inA )->path,
+                   ( (const FileHashEntry *)inB )->path );
+    }
+
+
+
+void FileHashManifest::sortByPath() {
+    int numEntries = mEntries.size();
+
+    if( numEntries < 2 ) {
+        return;
+        }
+
+    FileHashEntry *entries = mEntries.getElementArray();
+
+    qsort( entries, numEntries, sizeof( FileHashEntry ),
+           compareEntryPaths );
+
+    mEntries.deleteAll();
+    mEntries.appendArray( entries, numEntries );
+
+    delete [] entries;
+    }
+
+
+
+char FileHashManifest::readFromFile( File *inFile ) {
+    clear();
+
+    char *contents = inFile->readFileContents();
+
+    if( contents == NULL ) {
+        return false;
+        }
+
+    char ok = true;
+
+    char *line = contents;
+
+    while( *line != '\0' && ok ) {
+        char *lineEnd = strchr( line, '\n' );
+        char *next;
+
+        if( lineEnd != NULL ) {
+            next = lineEnd + 1;
+            }
+        else {
+            lineEnd = &( line[ strlen( line ) ] );
+            next = lineEnd;
+            }
+
+        if( lineEnd > line && lineEnd[-1] == '\r' ) {
+            lineEnd--;
+            }
+        *lineEnd = '\0';
+
+        if( *line != '\0' ) {
+            char hex[41];
+            long length;
+            double modificationTime;
+            int pathStart = -1;
+
+            int numRead = sscanf( line, "%40s %ld %lf %n", hex, &length,
+                                  &modificationTime, &pathStart );
+
+            unsigned char *digest = NULL;
+
+            if( numRead == 3 && pathStart > 0 && line[ pathStart ] != '\0'
+                && strlen( hex ) == 2 * SHA1_DIGEST_LENGTH ) {
+                digest = hexDecode( hex );
+                }
+
+            if( digest != NULL ) {
+                addEntry( &( line[ pathStart ] ), length, modificationTime,
+                          digest );
+                delete [] digest;
+                }
+            else {
+                ok = false;
+                }
+            }
+
+        line = next;
+        }
+
+    delete [] contents;
+
+    if( ! ok ) {
+        clear();
+        }
+
+    return ok;
+    }
+
+
+
+char FileHashManifest::writeToFile( File *inFile ) {
+    SimpleVector<char> text;
+
+    for( int i=0; i<mEntries.size(); i++ ) {
+        FileHashEntry *entry = mEntries.getElement( i );
+
+        char *hex = hexEncode( entry->digest, SHA1_DIGEST_LENGTH );
+
+        char *line = autoSprintf( "%s %ld %.0f %s\n", hex, entry->length,
+                                  entry->modificationTime, entry->path );
+
+        text.appendElementString( line );
+
+        delete [] line;
+        delete [] hex;
+        }
+
+    char *textString = text.getElementString();
+
+    char ok = inFile->writeToFile( textString );
+
+    delete [] textString;
+
+    return ok;
+    }
+
+
+
+// a file to read on a worker, started largest first
+class FileJob : public ThreadPoolJob {
+
+    public:
+
+        FileJob( char *inPath, long inLength, int inChunkBytes,
+                 int inOrder )
+                : mPath( inPath ), mLength( inLength ),
+                  mChunkBytes( inChunkBytes ), mOrder( inOrder ) {
+            }
+
+        virtual ~FileJob() {
+            delete [] mPath;
+            }
+
+        char *mPath;
+        long mLength;
+        int mChunkBytes;
+
+        // submission order, for ties
+        int mOrder;
+    };
+
+
+
+class FileHashJob : public FileJob {
+
+    public:
+
+        FileHashJob( char *inPath, long inLength, int inChunkBytes,
+                     int inOrder, unsigned char *outDigest )
+                : FileJob( inPath, inLength, inChunkBytes, inOrder ),
+                  mDigest( outDigest ), mSucceeded( false ) {
+            }
+
+        void runJob() {
+            mSucceeded = FileHasher::hashFile( mPath, mLength,
+                                               mChunkBytes, mDigest );
+            }
+
+        unsigned char *mDigest;
+        char mSucceeded;
+    };
+
+
+
+class FileVerifyJob : public FileJob {
+
+    public:
+
+        FileVerifyJob( char *inPath, int inChunkBytes, int inOrder,
+                       FileHashEntry *inEntry, char inRehashAll )
+                : FileJob( inPath, inEntry->length, inChunkBytes, inOrder ),
+                  mEntry( inEntry ), mRehashAll( inRehashAll ),
+                  mGood( false ), mRehashed( false ), mRefreshed( false ) {
+            }
+
+        void runJob() {
+            File file( NULL, mPath );
+
+            if( ! file.exists() ) {
+                return;
+                }
+
+            // before reading, so a change while we read shows up next time
+            long length = file.getLength();
+            timeSec_t modificationTime = file.getModificationTime();
+
+            if( length != mEntry->length ) {
+                return;
+                }
+
+            if( modificationTime == mEntry->modificationTime &&
+                ! mRehashAll ) {
+                mGood = true;
+                return;
+                }
+
+            unsigned char digest[ SHA1_DIGEST_LENGTH ];
+
+            mRehashed = true;
+
+            if( ! FileHasher::hashFile( mPath, length, mChunkBytes,
+                                        digest ) ) {
+                return;
+                }
+
+            if( memcmp( digest, mEntry->digest, SHA1_DIGEST_LENGTH ) == 0 ) {
+                mGood = true;
+
+                if( modificationTime != mEntry->modificationTime ) {
+                    // touched, but the same
+                    mEntry->modificationTime = modificationTime;
+                    mRefreshed = true;
+                    }
+                }
+            }
+
+        FileHashEntry *mEntry;
+        char mRehashAll;
+
+        char mGood;
+        char mRehashed;
+        char mRefreshed;
+    };
+
+
+
+static int compareJobs( const void *inA, const void *inB ) {
+    FileJob *a = *(FileJob **)inA;
+    FileJob *b = *(FileJob **)inB;
+
+    if( a->mLength != b->mLength ) {
+        return ( a->mLength > b->mLength ) ? -1 : 1;
+        }
+    return a->mOrder - b->mOrder;
+    }
+
+
+
+// runs jobs to completion, largest first, leaving inJobs in given order
+static void runJobs( ThreadPool *inPool, FileJob **inJobs, int inNumJobs ) {
+    if( inNumJobs == 0 ) {
+        return;
+        }
+
+    FileJob **sorted = new FileJob*[ inNumJobs ];
+    memcpy( sorted, inJobs, inNumJobs * sizeof( FileJob * ) );
+
+    qsort( sorted, inNumJobs, sizeof( FileJob * ), compareJobs );
+
+    for( int i=0; i<inNumJobs; i++ ) {
+        if( inPool != NULL ) {
+            inPool->addJob( sorted[i] );
+            }
+        else {
+            sorted[i]->runJob();
+            }
+        }
+
+    if( inPool != NULL ) {
+        inPool->waitForAllJobs();
+        }
+
+    delete [] sorted;
+    }
+
+
+
+FileHasher::FileHasher( int inNumThreads )
+        : mChunkBytes( 1024 * 1024 ), mPool( NULL ) {
+
+    if( inNumThreads != 1 ) {
+        mPool = new ThreadPool( inNumThreads );
+        }
+    }
+
+
+
+FileHasher::~FileHasher() {
+    if( mPool != NULL ) {
+        delete mPool;
+        }
+    }
+
+
+
+void FileHasher::setChunkBytes( int inBytes ) {
+    if( inBytes < 1 ) {
+        inBytes = 1;
+        }
+    mChunkBytes = inBytes;
+    }
+
+
+
+char FileHasher::hashFile( const char *inPath, long inLengthHint,
+                           int inChunkBytes, unsigned char *outDigest ) {
+
+    // no bigger than the file, so small files don't each allocate a
+    // whole chunk
+    int bufferSize = inChunkBytes;
+    if( inLengthHint >= 0 && inLengthHint < bufferSize ) {
+        bufferSize = (int)inLengthHint;
+
+        if( bufferSize < 4096 ) {
+            // in case the file has grown
+            bufferSize = 4096;
+            }
+        if( bufferSize > inChunkBytes ) {
+            bufferSize = inChunkBytes;
+            }
+        }
+
+#ifdef WIN_32
+    FILE *file = fopen( inPath, "rb" );
+
+    if( file == NULL ) {
+        return false;
+        }
+#else
+    int fd = open( inPath, O_RDONLY );
+
+    if( fd == -1 ) {
+        return false;
+        }
+
+    #ifdef __linux__
+    posix_fadvise( fd, 0, 0, POSIX_FADV_SEQUENTIAL );
+    #endif
+#endif
+
+    unsigned char *buffer = new unsigned char[ bufferSize ];
+
+    SHA_CTX context;
+    SHA1_Init( &context );
+
+    char error = false;
+    char done = false;
+
+#ifndef WIN_32
+    off_t offset = 0;
+#endif
+
+    while( ! done && ! error ) {
+#ifdef WIN_32
+        size_t numRead = fread( buffer, 1, bufferSize, file );
+
+        if( numRead < (size_t)bufferSize ) {
+            if( ferror( file ) ) {
+                error = true;
+                }
+            done = true;
+            }
+#else
+        ssize_t numRead = pread( fd, buffer, bufferSize, offset );
+
+        if( numRead < 0 ) {
+            if( errno != EINTR ) {
+                error = true;
+                }
+            numRead = 0;
+            }
+        else if( numRead == 0 ) {
+            done = true;
+            }
+        offset += numRead;
+#endif
+
+        if( numRead > 0 && ! error ) {
+            SHA1_Update( &context, buffer, (unsigned int)numRead );
+            }
+        }
+
+    delete [] buffer;
+
+#ifdef WIN_32
+    fclose( file );
+#else
+    close( fd );
+#endif
+
+    if( error ) {
+        return false;
+        }
+
+    SHA1_Final( outDigest, &context );
+
+    return true;
+    }
+
+
+
+void FileHasher::hashFiles( int inNumFiles, char **inPaths,
+                            unsigned char *outDigests,
+                            char *outSucceeded ) {
+
+    FileJob **jobs = new FileJob*[ inNumFiles ];
+
+    for( int i=0; i<inNumFiles; i++ ) {
+        File file( NULL, inPaths[i] );
+
+        jobs[i] = new FileHashJob(
+            stringDuplicate( inPaths[i] ), file.getLength(), mChunkBytes, i,
+            &( outDigests[ i * SHA1_DIGEST_LENGTH ] ) );
+        }
+
+    runJobs( mPool, jobs, inNumFiles );
+
+    for( int i=0; i<inNumFiles; i++ ) {
+        outSucceeded[i] = ( (FileHashJob *)jobs[i] )->mSucceeded;
+        delete jobs[i];
+        }
+
+    delete [] jobs;
+    }
+
+
+
+FileHashManifest *FileHasher::hashTree( File *inRoot, int *outNumFailed ) {
+    *outNumFailed = 0;
+
+    if( ! inRoot->isDirectory() ) {
+        return NULL;
+        }
+
+    int rootLength;
+    char *rootName = inRoot->getFullFileName( &rootLength );
+
+    int numChildren;
+    File **children = inRoot->getChildFilesRecursive( MAX_TREE_DEPTH,
+                                                      &numChildren );
+
+    SimpleVector<char *> fullNames;
+    SimpleVector<char *> relativePaths;
+    SimpleVector<long> lengths;
+    SimpleVector<timeSec_t> modificationTimes;
+
+    for( int i=0; i<numChildren; i++ ) {
+        File *child = children[i];
+
+        if( ! child->isDirectory() ) {
+            char *fullName = child->getFullFileName();
+
+            const char *relativePath = fullName;
+
+            if( strncmp( fullName, rootName, rootLength ) == 0 ) {
+                relativePath = &( fullName[ rootLength ] );
+                }
+            while( *relativePath == '/' || *relativePath == '\\' ) {
+                relativePath++;
+                }
+
+            char *manifestPath = stringDuplicate( relativePath );
+#ifdef WIN_32
+            for( char *c = manifestPath; *c != '\0'; c++ ) {
+                if( *c == '\\' ) {
+                    *c = '/';
+                    }
+                }
+#endif
+            fullNames.push_back( fullName );
+            relativePaths.push_back( manifestPath );
+
+            // before reading, so a change while we read shows up next time
+            lengths.push_back( child->getLength() );
+            modificationTimes.push_back( child->getModificationTime() );
+            }
+
+        delete child;
+        }
+
+    if( children != NULL ) {
+        delete [] children;
+        }
+    delete [] rootName;
+
+
+    int numFiles = fullNames.size();
+
+    unsigned char *digests =
+        new unsigned char[ numFiles * SHA1_DIGEST_LENGTH ];
+
+    FileJob **jobs = new FileJob*[ numFiles ];
+
+    for( int i=0; i<numFiles; i++ ) {
+        jobs[i] = new FileHashJob( fullNames.getElementDirect( i ),
+                                   lengths.getElementDirect( i ),
+                                   mChunkBytes, i,
+                                   &( digests[ i * SHA1_DIGEST_LENGTH ] ) );
+        }
+
+    runJobs( mPool, jobs, numFiles );
+
+
+    FileHashManifest *manifest = new FileHashManifest();
+
+    for( int i=0; i<numFiles; i++ ) {
+        FileHashJob *job = (FileHashJob *)jobs[i];
+
+        if( job->mSucceeded ) {
+            manifest->addEntry( relativePaths.getElementDirect( i ),
+                                job->mLength,
+                                modificationTimes.getElementDirect( i ),
+                                job->mDigest );
+            }
+        else {
+            (*outNumFailed)++;
+            }
+
+        delete job;
+        delete [] relativePaths.getElementDirect( i );
+        }
+
+    delete [] jobs;
+    delete [] digests;
+
+    manifest->sortByPath();
+
+    return manifest;
+    }
+
+
+
+int FileHasher::verifyTree( File *inRoot, FileHashManifest *inManifest,
+                            char inRehashAll,
+                            SimpleVector<char *> *outBadPaths,
+                            int *outNumRehashed, int *outNumRefreshed ) {
+
+    char *rootName = inRoot->getFullFileName();
+
+    int numEntries = inManifest->getNumEntries();
+
+    FileJob **jobs = new FileJob*[ numEntries ];
+
+    for( int i=0; i<numEntries; i++ ) {
+        FileHashEntry *entry = inManifest->getEntry( i );
+
+        jobs[i] = new FileVerifyJob(
+            autoSprintf( "%s/%s", rootName, entry->path ),
+            mChunkBytes, i, entry, inRehashAll );
+        }
+
+    delete [] rootName;
+
+    runJobs( mPool, jobs, numEntries );
+
+
+    int numBad = 0;
+    *outNumRehashed = 0;
+    *outNumRefreshed = 0;
+
+    for( int i=0; i<numEntries; i++ ) {
+        FileVerifyJob *job = (FileVerifyJob *)jobs[i];
+
+        if( ! job->mGood ) {
+            numBad++;
+            outBadPaths->push_back( stringDuplicate( job->mEntry->path ) );
+            }
+        if( job->mRehashed ) {
+            (*outNumRehashed)++;
+            }
+        if( job->mRefreshed ) {
+            (*outNumRefreshed)++;
+            }
+
+        delete job;
+        }
+
+    delete [] jobs;
+
+    return numBad;
+    }
@@ -0,0 +1,217 @@
+#ifndef FILE_HASHER_INCLUDED
+#define FILE_HASHER_INCLUDED
+
+
+
+#include "minorGems/crypto/hashes/sha1.h"
+#include "minorGems/io/file/File.h"
+#include "minorGems/system/ThreadPool.h"
+#include "minorGems/system/Time.h"
+#include "minorGems/util/SimpleVector.h"
+
+
+
+typedef struct FileHashEntry {
+        // relative to the hashed tree's root, with / separators
+        char *path;
+
+        long length;
+        timeSec_t modificationTime;
+
+        unsigned char digest[ SHA1_DIGEST_LENGTH ];
+    } FileHashEntry;
+
+
+
+/**
+ * A list of files under one directory, with the length, modification time
+ * and SHA-1 of each, as last seen.
+ *
+ * Stored as text, one file per line:
+ *
+ *   <hex SHA-1> <length> <modification time> <path>
+ *
+ * Paths may contain spaces, but not line breaks.
+ */
+class FileHashManifest {
+
+    public:
+
+        // constructs an empty manifest
+        FileHashManifest();
+
+        ~FileHashManifest();
+
+
+        /**
+         * Replaces this manifest's entries with those read from a file.
+         *
+         * @param inFile the file to read.  Destroyed by caller.
+         *
+         * @return true on success, or false if the file is missing or
+         *   any line is malformed (entries are left empty).
+         */
+        char readFromFile( File *inFile );
+
+
+        /**
+         * Writes this manifest's entries to a file, replacing it.
+         *
+         * @param inFile the file to write.  Destroyed by caller.
+         *
+         * @return true on success.
+         */
+        char writeToFile( File *inFile );
+
+
+        /**
+         * Adds an entry.
+         *
+         * @param inPath the path relative to the tree's root.
+         *   Copied internally.
+         */
+        void addEntry( const char *inPath, long inLength,
+                       timeSec_t inModificationTime,
+                       unsigned char *inDigest );
+
+
+        int getNumEntries();
+
+
+        // valid until this manifest is changed or destroyed
+        FileHashEntry *getEntry( int inIndex );
+
+
+        // sorts entries by path, so written manifests diff cleanly
+        void sortByPath();
+
+
+    protected:
+
+        void clear();
+
+        SimpleVector<FileHashEntry> mEntries;
+    };
+
+
+
+/**
+ * Hashes files with SHA-1, reading each in fixed-size chunks (with pread,
+ * or stdio on Windows) rather than loading it whole, and spreading files
+ * across worker threads.
+ *
+ * Large files are started first, so one big file at the end of a tree
+ * doesn't leave every other thread idle.  Each file is hashed on one
+ * thread, so a tree of one huge file is no faster than sha1sum.
+ *
+ * Not thread-safe:  use one hasher per calling thread.
+ */
+class FileHasher {
+
+    public:
+
+        /**
+         * Constructs a hasher.
+         *
+         * @param inNumThreads the number of worker threads, -1 for one
+         *   per CPU, or 1 to do all work on the calling thread.
+         *   Defaults to -1.
+         */
+        FileHasher( int inNumThreads = -1 );
+
+
+        ~FileHasher();
+
+
+        // bytes read per call, per thread.  Defaults to 1 MiB
+        void setChunkBytes( int inBytes );
+
+
+        /**
+         * Hashes files.
+         *
+         * @param inNumFiles the number of files.
+         * @param inPaths the file paths.  Destroyed by caller.
+         * @param outDigests where inNumFiles raw digests should be
+         *   returned, back to back.
+         * @param outSucceeded where inNumFiles flags should be returned,
+         *   false for files that could not be read.
+         */
+        void hashFiles( int inNumFiles, char **inPaths,
+                        unsigned char *outDigests, char *outSucceeded );
+
+
+        /**
+         * Hashes every file under a directory, at any depth.
+         *
+         * Files that can't be read are left out, and counted.
+         *
+         * @param inRoot the directory.  Destroyed by caller.
+         * @param outNumFailed where the number of unreadable files should
+         *   be returned.
+         *
+         * @return a manifest sorted by path, or NULL if inRoot is not a
+         *   directory.  Destroyed by caller.
+         */
+        FileHashManifest *hashTree( File *inRoot, int *outNumFailed );
+
+
+        /**
+         * Checks the files under a directory against a manifest.
+         *
+         * A file whose length and modification time match its entry is
+         * taken as unchanged without reading it, unless inRehashAll is
+         * set.  A file whose length differs is bad without reading it.
+         * Otherwise the file is re-hashed, and if its digest still
+         * matches, its entry's modification time is updated so that the
+         * next check can skip it (write the manifest back to keep this).
+         *
+         * Files under inRoot that are not in the manifest are ignored.
+         *
+         * @param inRoot the directory.  Destroyed by caller.
+         * @param inManifest the manifest to check against.  Destroyed by
+         *   caller.
+         * @param inRehashAll true to re-hash every file.
+         * @param outBadPaths vector to add the paths of missing, unreadable
+         *   or changed files to, relative to inRoot.  Paths must be
+         *   destroyed by caller.
+         * @param outNumRehashed where the number of files that were read
+         *   should be returned.
+         * @param outNumRefreshed where the number of entries with updated
+         *   modification times should be returned.
+         *
+         * @return the number of bad files.
+         */
+        int verifyTree( File *inRoot, FileHashManifest *inManifest,
+                        char inRehashAll,
+                        SimpleVector<char *> *outBadPaths,
+                        int *outNumRehashed, int *outNumRefreshed );
+
+
+        /**
+         * Hashes one file on the calling thread.
+         *
+         * @param inPath the file's path.  Destroyed by caller.
+         * @param inLengthHint the expected length, used to size the read
+         *   buffer for small files, or -1 if unknown.
+         * @param inChunkBytes the most bytes to read per call.
+         * @param outDigest where the raw digest should be returned.
+         *
+         * @return true on success, or false if the file can't be read.
+         */
+        static char hashFile( const char *inPath, long inLengthHint,
+                              int inChunkBytes,
+                              unsigned char *outDigest );
+
+
+    protected:
+
+        int mChunkBytes;
+
+        // NULL if all work is done on the calling thread
+        ThreadPool *mPool;
+    };
+
+
+
+#endif
@@ -0,0 +1,510 @@
+// Test and benchmark for FileHasher and FileHashManifest
+//
+// Usage:  fileHasherBench [megabytes [numThreads]]
+//
+// Builds a scratch tree (fileHasherBenchTree, in the current directory) of
+// many small files and a few large ones, and checks that:
+//    -hashFiles and hashTree match computeRawSHA1Digest on whole buffers,
+//     with chunks smaller than, equal to, and not dividing the files
+//    -manifests survive a write and read, paths with spaces included
+//    -verifyTree passes an untouched tree without reading any file
+//    -a touched but unchanged file is re-hashed once, then skipped
+//    -changed, resized and missing files are reported
+//
+// Then times the old sha1sum loop (5000-byte fread per call, one file at a
+// time) against hashTree, and a full verifyTree against a quick one.
+//
+// The tree is removed afterward.
+
+
+#include "minorGems/crypto/hashes/FileHasher.h"
+#include "minorGems/system/Time.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <utime.h>
+
+
+
+static int numFailed = 0;
+
+
+static void check( char inPassed, const char *inWhat ) {
+    if( ! inPassed ) {
+        printf( "FAILED:  %s\n", inWhat );
+        numFailed++;
+        }
+    }
+
+
+
+static unsigned int randState = 12345;
+
+static int randInt( int inMin, int inMax ) {
+    randState = randState * 1103515245 + 12345;
+    return inMin + (int)( ( randState >> 8 ) % ( inMax - inMin + 1 ) );
+    }
+
+
+
+static const char *treeName = "fileHasherBenchTree";
+
+
+
+static char *makePath( const char *inRelativePath ) {
+    char *path = new char[ strlen( treeName ) + strlen( inRelativePath ) + 2 ];
+    sprintf( path, "%s/%s", treeName, inRelativePath );
+    return path;
+    }
+
+
+
+static void writeBytes( const char *inRelativePath,
+                        unsigned char *inBytes, int inLength ) {
+    char *path = makePath( inRelativePath );
+    File file( NULL, path );
+    check( file.writeToFile( inBytes, inLength ), "scratch file written" );
+    delete [] path;
+    }
+
+
+
+// moves a file's modification time back, so a rewrite within the same
+// second still looks changed
+static void ageFile( const char *inRelativePath, time_t inTime ) {
+    char *path = makePath( inRelativePath );
+    struct utimbuf times;
+    times.actime = inTime;
+    times.modtime = inTime;
+    utime( path, &times );
+    delete [] path;
+    }
+
+
+
+static void makeDirectory( const char *inRelativePath ) {
+    char *path = makePath( inRelativePath );
+    File dir( NULL, path );
+    dir.makeDirectory();
+    delete [] path;
+    }
+
+
+
+static void removeTree() {
+    File root( NULL, treeName );
+
+    int numChildren;
+    File **children = root.getChildFilesRecursive( 64, &numChildren );
+
+    // children come after their directory
+    for( int i=numChildren-1; i>=0; i-- ) {
+        children[i]->remove();
+        delete children[i];
+        }
+    if( children != NULL ) {
+        delete [] children;
+        }
+
+    root.remove();
+    }
+
+
+
+static int numTreeFiles = 0;
+static char *treePaths[ 10000 ];
+static unsigned char treeDigests[ 10000 * SHA1_DIGEST_LENGTH ];
+static long treeBytes = 0;
+
+
+static void clearTree() {
+    removeTree();
+
+    for( int i=0; i<numTreeFiles; i++ ) {
+        delete [] treePaths[i];
+        }
+    numTreeFiles = 0;
+    treeBytes = 0;
+    }
+
+
+static void addTreeFile( const char *inRelativePath, int inLength ) {
+    unsigned char *bytes = new unsigned char[ inLength + 1 ];
+    for( int i=0; i<inLength; i++ ) {
+        bytes[i] = (unsigned char)randInt( 0, 255 );
+        }
+
+    writeBytes( inRelativePath, bytes, inLength );
+
+    unsigned char *digest = computeRawSHA1Digest( bytes, inLength );
+    memcpy( &( treeDigests[ numTreeFiles * SHA1_DIGEST_LENGTH ] ), digest,
+            SHA1_DIGEST_LENGTH );
+    delete [] digest;
+    delete [] bytes;
+
+    treePaths[ numTreeFiles ] = stringDuplicate( inRelativePath );
+    numTreeFiles++;
+
+    treeBytes += inLength;
+    }
+
+
+
+// many small files in nested directories, a few large ones
+static void makeTree( int inMegabytes ) {
+    clearTree();
+
+    File root( NULL, treeName );
+    root.makeDirectory();
+
+    makeDirectory( "sounds" );
+    makeDirectory( "graphics" );
+    makeDirectory( "graphics/sprites" );
+    makeDirectory( "with space" );
+
+    addTreeFile( "with space/a file.txt", 1000 );
+    addTreeFile( "empty", 0 );
+    addTreeFile( "one", 1 );
+
+    // a quarter in large files
+    long largeBytes = (long)inMegabytes * 1024 * 1024 / 4;
+    for( int i=0; i<4; i++ ) {
+        char name[100];
+        sprintf( name, "sounds/music%d.aiff", i );
+        addTreeFile( name, (int)( largeBytes / 4 ) + i );
+        }
+
+    long totalBytes = (long)inMegabytes * 1024 * 1024;
+
+    int i = 0;
+    while( treeBytes < totalBytes && numTreeFiles < 9999 ) {
+        char name[100];
+        sprintf( name, "graphics/sprites/sprite%d.tga", i++ );
+        addTreeFile( name, randInt( 1000, 200000 ) );
+        }
+    }
+
+
+
+static int findTreeFile( const char *inPath ) {
+    for( int i=0; i<numTreeFiles; i++ ) {
+        if( strcmp( treePaths[i], inPath ) == 0 ) {
+            return i;
+            }
+        }
+    return -1;
+    }
+
+
+
+static char manifestMatchesTree( FileHashManifest *inManifest ) {
+    if( inManifest->getNumEntries() != numTreeFiles ) {
+        return false;
+        }
+
+    for( int i=0; i<inManifest->getNumEntries(); i++ ) {
+        FileHashEntry *entry = inManifest->getEntry( i );
+
+        int index = findTreeFile( entry->path );
+
+        if( index == -1 ||
+            memcmp( entry->digest,
+                    &( treeDigests[ index * SHA1_DIGEST_LENGTH ] ),
+                    SHA1_DIGEST_LENGTH ) != 0 ) {
+            return false;
+            }
+        }
+    return true;
+    }
+
+
+
+static void checkHashFiles( FileHasher *inHasher ) {
+    int num = 20;
+
+    char **paths = new char *[ num ];
+    unsigned char *digests = new unsigned char[ num * SHA1_DIGEST_LENGTH ];
+    char *succeeded = new char[ num ];
+
+    for( int i=0; i<num; i++ ) {
+        paths[i] = makePath( treePaths[i] );
+        }
+
+    int chunkSizes[4] = { 64, 1000, 4096, 1024 * 1024 };
+
+    for( int c=0; c<4; c++ ) {
+        inHasher->setChunkBytes( chunkSizes[c] );
+
+        inHasher->hashFiles( num, paths, digests, succeeded );
+
+        char allGood = true;
+        for( int i=0; i<num; i++ ) {
+            if( ! succeeded[i] ||
+                memcmp( &( digests[ i * SHA1_DIGEST_LENGTH ] ),
+                        &( treeDigests[ i * SHA1_DIGEST_LENGTH ] ),
+                        SHA1_DIGEST_LENGTH ) != 0 ) {
+                allGood = false;
+                }
+            }
+        check( allGood, "hashFiles matches whole-buffer SHA-1" );
+        }
+
+    inHasher->setChunkBytes( 1024 * 1024 );
+
+    char *missing = makePath( "not there" );
+    inHasher->hashFiles( 1, &missing, digests, succeeded );
+    check( ! succeeded[0], "hashFiles reports missing file" );
+    delete [] missing;
+
+    for( int i=0; i<num; i++ ) {
+        delete [] paths[i];
+        }
+    delete [] paths;
+    delete [] digests;
+    delete [] succeeded;
+    }
+
+
+
+static int verify( FileHasher *inHasher, FileHashManifest *inManifest,
+                   char inRehashAll, int *outNumRehashed,
+                   int *outNumRefreshed,
+                   const char *inExpectedBadPath = NULL ) {
+    File root( NULL, treeName );
+
+    SimpleVector<char *> badPaths;
+
+    int numBad = inHasher->verifyTree( &root, inManifest, inRehashAll,
+                                       &badPaths, outNumRehashed,
+                                       outNumRefreshed );
+
+    check( badPaths.size() == numBad, "one bad path per bad file" );
+
+    if( inExpectedBadPath != NULL ) {
+        char found = false;
+        for( int i=0; i<badPaths.size(); i++ ) {
+            if( strcmp( badPaths.getElementDirect( i ),
+                        inExpectedBadPath ) == 0 ) {
+                found = true;
+                }
+            }
+        check( found, inExpectedBadPath );
+        }
+
+    for( int i=0; i<badPaths.size(); i++ ) {
+        delete [] badPaths.getElementDirect( i );
+        }
+
+    return numBad;
+    }
+
+
+
+static void checkManifest( FileHasher *inHasher ) {
+    File root( NULL, treeName );
+    File manifestFile( NULL, "fileHasherBench.sha1" );
+
+    int numFailedFiles;
+    FileHashManifest *manifest = inHasher->hashTree( &root,
+                                                     &numFailedFiles );
+
+    check( manifest != NULL && numFailedFiles == 0, "hashTree" );
+    if( manifest == NULL ) {
+        return;
+        }
+
+    check( manifestMatchesTree( manifest ),
+           "hashTree matches whole-buffer SHA-1" );
+
+    for( int i=1; i<manifest->getNumEntries(); i++ ) {
+        check( strcmp( manifest->getEntry( i - 1 )->path,
+                       manifest->getEntry( i )->path ) < 0,
+               "manifest sorted by path" );
+        }
+
+    check( manifest->writeToFile( &manifestFile ), "manifest written" );
+
+    FileHashManifest readBack;
+    check( readBack.readFromFile( &manifestFile ), "manifest read" );
+    check( manifestMatchesTree( &readBack ), "manifest round trip" );
+
+    char same = readBack.getNumEntries() == manifest->getNumEntries();
+    for( int i=0; i<readBack.getNumEntries() && same; i++ ) {
+        FileHashEntry *a = manifest->getEntry( i );
+        FileHashEntry *b = readBack.getEntry( i );
+        same = strcmp( a->path, b->path ) == 0 &&
+            a->length == b->length &&
+            a->modificationTime == b->modificationTime;
+        }
+    check( same, "manifest lengths and times round trip" );
+
+    File garbageFile( NULL, "fileHasherBenchGarbage.sha1" );
+    garbageFile.writeToFile( "not a manifest\n" );
+    FileHashManifest garbage;
+    check( ! garbage.readFromFile( &garbageFile ) &&
+           garbage.getNumEntries() == 0, "malformed manifest rejected" );
+    garbageFile.remove();
+
+    delete manifest;
+
+
+    int numRehashed, numRefreshed;
+
+    check( verify( inHasher, &readBack, false,
+                   &numRehashed, &numRefreshed ) == 0 &&
+           numRehashed == 0, "untouched tree passes without reading" );
+
+    check( verify( inHasher, &readBack, true,
+                   &numRehashed, &numRefreshed ) == 0 &&
+           numRehashed == numTreeFiles && numRefreshed == 0,
+           "full check reads every file" );
+
+    // touched, same contents
+    ageFile( treePaths[0], 1000000000 );
+    check( verify( inHasher, &readBack, false,
+                   &numRehashed, &numRefreshed ) == 0 &&
+           numRehashed == 1 && numRefreshed == 1,
+           "touched file re-hashed" );
+    check( verify( inHasher, &readBack, false,
+                   &numRehashed, &numRefreshed ) == 0 &&
+           numRehashed == 0,
+           "refreshed entry skipped next time" );
+
+    // same length, new contents
+    unsigned char bytes[1000];
+    memset( bytes, 'x', 1000 );
+    writeBytes( treePaths[0], bytes, 1000 );
+    ageFile( treePaths[0], 1000000100 );
+    check( verify( inHasher, &readBack, false,
+                   &numRehashed, &numRefreshed,
+                   treePaths[0] ) == 1 && numRehashed == 1,
+           "changed file reported" );
+
+    // new length, not read
+    writeBytes( treePaths[1], bytes, 10 );
+    check( verify( inHasher, &readBack, false,
+                   &numRehashed, &numRefreshed,
+                   treePaths[1] ) == 2 && numRehashed == 1,
+           "resized file reported without reading" );
+
+    char *path = makePath( treePaths[2] );
+    File gone( NULL, path );
+    gone.remove();
+    delete [] path;
+    check( verify( inHasher, &readBack, false,
+                   &numRehashed, &numRefreshed,
+                   treePaths[2] ) == 3,
+           "missing file reported" );
+
+    manifestFile.remove();
+    }
+
+
+
+static void timeOldLoop() {
+    double start = Time::getCurrentTime();
+
+    int bufferSize = 5000;
+    unsigned char *buffer = new unsigned char[ bufferSize ];
+
+    for( int i=0; i<numTreeFiles; i++ ) {
+        char *path = makePath( treePaths[i] );
+        FILE *file = fopen( path, "rb" );
+        delete [] path;
+
+        SHA_CTX context;
+        SHA1_Init( &context );
+
+        int numRead = bufferSize;
+        while( numRead == bufferSize ) {
+            numRead = fread( buffer, 1, bufferSize, file );
+            if( numRead > 0 ) {
+                SHA1_Update( &context, buffer, numRead );
+                }
+            }
+        fclose( file );
+
+        unsigned char digest[ SHA1_DIGEST_LENGTH ];
+        SHA1_Final( digest, &context );
+        }
+
+    delete [] buffer;
+
+    double seconds = Time::getCurrentTime() - start;
+    printf( "  sha1sum loop:      %7.1f ms  %6.0f MB/s\n", seconds * 1000,
+            treeBytes / seconds / 1e6 );
+    }
+
+
+
+int main( int inNumArgs, char **inArgs ) {
+
+    int megabytes = 64;
+    int numThreads = -1;
+
+    if( inNumArgs > 1 ) {
+        megabytes = atoi( inArgs[1] );
+        }
+    if( inNumArgs > 2 ) {
+        numThreads = atoi( inArgs[2] );
+        }
+
+    FileHasher hasher( numThreads );
+
+
+    // small tree for checks
+    makeTree( 2 );
+
+    checkHashFiles( &hasher );
+    checkManifest( &hasher );
+
+    FileHasher inlineHasher( 1 );
+    makeTree( 1 );
+    checkManifest( &inlineHasher );
+
+    if( numFailed > 0 ) {
+        clearTree();
+        printf( "%d checks failed\n", numFailed );
+        return 1;
+        }
+
+    printf( "All checks passed\n\n" );
+
+
+    makeTree( megabytes );
+
+    printf( "%d files, %.1f MB (warm cache):\n", numTreeFiles,
+            treeBytes / 1e6 );
+
+    // warm the cache for both
+    timeOldLoop();
+    timeOldLoop();
+
+    File root( NULL, treeName );
+
+    double start = Time::getCurrentTime();
+    int numFailedFiles;
+    FileHashManifest *manifest = hasher.hashTree( &root, &numFailedFiles );
+    double seconds = Time::getCurrentTime() - start;
+    printf( "  hashTree:          %7.1f ms  %6.0f MB/s\n", seconds * 1000,
+            treeBytes / seconds / 1e6 );
+
+    int numRehashed, numRefreshed;
+
+    start = Time::getCurrentTime();
+    verify( &hasher, manifest, true, &numRehashed, &numRefreshed );
+    printf( "  verifyTree, all:   %7.1f ms\n",
+            ( Time::getCurrentTime() - start ) * 1000 );
+
+    start = Time::getCurrentTime();
+    verify( &hasher, manifest, false, &numRehashed, &numRefreshed );
+    printf( "  verifyTree, quick: %7.1f ms\n",
+            ( Time::getCurrentTime() - start ) * 1000 );
+
+    delete manifest;
+
+    clearTree();
+
+    return 0;
+    }
@@ -57,6 +57,12 @@
 // for hex encoding
 #include "minorGems/formats/encodingUtils.h"
 
+#include "minorGems/system/cpuFeatures.h"
+
+#ifdef CPU_FEATURES_X86
+#include <immintrin.h>
+#endif
+
 
 
 #define rol(value, bits) (((value) << (bits)) | ((value) >> (32 - (bits))))
@@ -87,11 +93,14 @@ typedef union _BYTE64QUAD16 {
 } BYTE64QUAD16;
 
 /* Hash a single 512-bit block. This is the core of the algorithm. */
-void SHA1_Transform(sha1_quadbyte state[5], sha1_byte buffer[64]) {
+void SHA1_Transform(sha1_quadbyte state[5], const sha1_byte buffer[64]) {
 	sha1_quadbyte	a, b, c, d, e;
+	BYTE64QUAD16	blockCopy;
 	BYTE64QUAD16	*block;
 
-	block = (BYTE64QUAD16*)buffer;
+	/* expanded in place, so work on a copy */
+	memcpy(blockCopy.c, buffer, 64);
+	block = &blockCopy;
 	/* Copy context->state[] to working vars */
 	a = state[0];
 	b = state[1];
@@ -130,6 +139,420 @@ void SHA1_Transform(sha1_quadbyte state[5], sha1_byte buffer[64]) {
 }
 
 
+
+void SHA1_BlocksPortable( sha1_quadbyte state[5], const sha1_byte *data,
+                          unsigned int numBlocks ) {
+    for( unsigned int i=0; i<numBlocks; i++ ) {
+        SHA1_Transform( state, &data[ i * 64 ] );
+        }
+    }
+
+
+
+static const sha1_quadbyte roundConstants[4] = {
+    0x5A827999, 0x6ED9EBA1, 0x8F1BBCDC, 0xCA62C1D6 };
+
+
+
+static inline sha1_quadbyte readBigEndian( const sha1_byte *p ) {
+    return ( (sha1_quadbyte)p[0] << 24 ) | ( (sha1_quadbyte)p[1] << 16 ) |
+        ( (sha1_quadbyte)p[2] << 8 ) | p[3];
+    }
+
+
+
+#ifdef CPU_FEATURES_X86
+
+
+CPU_TARGET( "sse2" )
+static inline __m128i rol32x4( __m128i inX, int inBits ) {
+    return _mm_or_si128( _mm_slli_epi32( inX, inBits ),
+                         _mm_srli_epi32( inX, 32 - inBits ) );
+    }
+
+
+
+// following Intel's "New Instructions Supporting the Secure Hash
+// Algorithm on Intel Architecture Processors" (2013)
+CPU_TARGET( "sha,sse4.1,ssse3" )
+void SHA1_BlocksSHANI( sha1_quadbyte state[5], const sha1_byte *data,
+                       unsigned int numBlocks ) {
+    // whole register reversed, putting words in big-endian order with
+    // the first in the top lane, where sha1rnds4 expects A
+    const __m128i byteSwap = _mm_set_epi64x( 0x0001020304050607LL,
+                                             0x08090a0b0c0d0e0fLL );
+
+    __m128i abcd = _mm_shuffle_epi32(
+        _mm_loadu_si128( (const __m128i *)state ), 0x1B );
+    __m128i e0 = _mm_set_epi32( (int)state[4], 0, 0, 0 );
+    __m128i e1;
+
+    __m128i msg0, msg1, msg2, msg3;
+
+    const sha1_byte *p = data;
+
+    for( unsigned int blockIndex=0; blockIndex<numBlocks; blockIndex++ ) {
+        __m128i abcdSave = abcd;
+        __m128i eSave = e0;
+
+        // rounds 0 to 3
+        msg0 = _mm_shuffle_epi8( _mm_loadu_si128(
+            (const __m128i *)( p + 0 ) ), byteSwap );
+        e0 = _mm_add_epi32( e0, msg0 );
+        e1 = abcd;
+        abcd = _mm_sha1rnds4_epu32( abcd, e0, 0 );
+
+        // rounds 4 to 7
+        msg1 = _mm_shuffle_epi8( _mm_loadu_si128(
+            (const __m128i *)( p + 16 ) ), byteSwap );
+        e1 = _mm_sha1nexte_epu32( e1, msg1 );
+        e0 = abcd;
+        abcd = _mm_sha1rnds4_epu32( abcd, e1, 0 );
+        msg0 = _mm_sha1msg1_epu32( msg0, msg1 );
+
+        // rounds 8 to 11
+        msg2 = _mm_shuffle_epi8( _mm_loadu_si128(
+            (const __m128i *)( p + 32 ) ), byteSwap );
+        e0 = _mm_sha1nexte_epu32( e0, msg2 );
+        e1 = abcd;
+        abcd = _mm_sha1rnds4_epu32( abcd, e0, 0 );
+        msg1 = _mm_sha1msg1_epu32( msg1, msg2 );
+        msg0 = _mm_xor_si128( msg0, msg2 );
+
+        // rounds 12 to 15
+        msg3 = _mm_shuffle_epi8( _mm_loadu_si128(
+            (const __m128i *)( p + 48 ) ), byteSwap );
+        e1 = _mm_sha1nexte_epu32( e1, msg3 );
+        e0 = abcd;
+        msg0 = _mm_sha1msg2_epu32( msg0, msg3 );
+        abcd = _mm_sha1rnds4_epu32( abcd, e1, 0 );
+        msg2 = _mm_sha1msg1_epu32( msg2, msg3 );
+        msg1 = _mm_xor_si128( msg1, msg3 );
+
+        // rounds 16 to 19
+        e0 = _mm_sha1nexte_epu32( e0, msg0 );
+        e1 = abcd;
+        msg1 = _mm_sha1msg2_epu32( msg1, msg0 );
+        abcd = _mm_sha1rnds4_epu32( abcd, e0, 0 );
+        msg3 = _mm_sha1msg1_epu32( msg3, msg0 );
+        msg2 = _mm_xor_si128( msg2, msg0 );
+
+        // rounds 20 to 23
+        e1 = _mm_sha1nexte_epu32( e1, msg1 );
+        e0 = abcd;
+        msg2 = _mm_sha1msg2_epu32( msg2, msg1 );
+        abcd = _mm_sha1rnds4_epu32( abcd, e1, 1 );
+        msg0 = _mm_sha1msg1_epu32( msg0, msg1 );
+        msg3 = _mm_xor_si128( msg3, msg1 );
+
+        // rounds 24 to 27
+        e0 = _mm_sha1nexte_epu32( e0, msg2 );
+        e1 = abcd;
+        msg3 = _mm_sha1msg2_epu32( msg3, msg2 );
+        abcd = _mm_sha1rnds4_epu32( abcd, e0, 1 );
+        msg1 = _mm_sha1msg1_epu32( msg1, msg2 );
+        msg0 = _mm_xor_si128( msg0, msg2 );
+
+        // rounds 28 to 31
+        e1 = _mm_sha1nexte_epu32( e1, msg3 );
+        e0 = abcd;
+        msg0 = _mm_sha1msg2_epu32( msg0, msg3 );
+        abcd = _mm_sha1rnds4_epu32( abcd, e1, 1 );
+        msg2 = _mm_sha1msg1_epu32( msg2, msg3 );
+        msg1 = _mm_xor_si128( msg1, msg3 );
+
+        // rounds 32 to 35
+        e0 = _mm_sha1nexte_epu32( e0, msg0 );
+        e1 = abcd;
+        msg1 = _mm_sha1msg2_epu32( msg1, msg0 );
+        abcd = _mm_sha1rnds4_epu32( abcd, e0, 1 );
+        msg3 = _mm_sha1msg1_epu32( msg3, msg0 );
+        msg2 = _mm_xor_si128( msg2, msg0 );
+
+        // rounds 36 to 39
+        e1 = _mm_sha1nexte_epu32( e1, msg1 );
+        e0 = abcd;
+        msg2 = _mm_sha1msg2_epu32( msg2, msg1 );
+        abcd = _mm_sha1rnds4_epu32( abcd, e1, 1 );
+        msg0 = _mm_sha1msg1_epu32( msg0, msg1 );
+        msg3 = _mm_xor_si128( msg3, msg1 );
+
+        // rounds 40 to 43
+        e0 = _mm_sha1nexte_epu32( e0, msg2 );
+        e1 = abcd;
+        msg3 = _mm_sha1msg2_epu32( msg3, msg2 );
+        abcd = _mm_sha1rnds4_epu32( abcd, e0, 2 );
+        msg1 = _mm_sha1msg1_epu32( msg1, msg2 );
+        msg0 = _mm_xor_si128( msg0, msg2 );
+
+        // rounds 44 to 47
+        e1 = _mm_sha1nexte_epu32( e1, msg3 );
+        e0 = abcd;
+        msg0 = _mm_sha1msg2_epu32( msg0, msg3 );
+        abcd = _mm_sha1rnds4_epu32( abcd, e1, 2 );
+        msg2 = _mm_sha1msg1_epu32( msg2, msg3 );
+        msg1 = _mm_xor_si128( msg1, msg3 );
+
+        // rounds 48 to 51
+        e0 = _mm_sha1nexte_epu32( e0, msg0 );
+        e1 = abcd;
+        msg1 = _mm_sha1msg2_epu32( msg1, msg0 );
+        abcd = _mm_sha1rnds4_epu32( abcd, e0, 2 );
+        msg3 = _mm_sha1msg1_epu32( msg3, msg0 );
+        msg2 = _mm_xor_si128( msg2, msg0 );
+
+        // rounds 52 to 55
+        e1 = _mm_sha1nexte_epu32( e1, msg1 );
+        e0 = abcd;
+        msg2 = _mm_sha1msg2_epu32( msg2, msg1 );
+        abcd = _mm_sha1rnds4_epu32( abcd, e1, 2 );
+        msg0 = _mm_sha1msg1_epu32( msg0, msg1 );
+        msg3 = _mm_xor_si128( msg3, msg1 );
+
+        // rounds 56 to 59
+        e0 = _mm_sha1nexte_epu32( e0, msg2 );
+        e1 = abcd;
+        msg3 = _mm_sha1msg2_epu32( msg3, msg2 );
+        abcd = _mm_sha1rnds4_epu32( abcd, e0, 2 );
+        msg1 = _mm_sha1msg1_epu32( msg1, msg2 );
+        msg0 = _mm_xor_si128( msg0, msg2 );
+
+        // rounds 60 to 63
+        e1 = _mm_sha1nexte_epu32( e1, msg3 );
+        e0 = abcd;
+        msg0 = _mm_sha1msg2_epu32( msg0, msg3 );
+        abcd = _mm_sha1rnds4_epu32( abcd, e1, 3 );
+        msg2 = _mm_sha1msg1_epu32( msg2, msg3 );
+        msg1 = _mm_xor_si128( msg1, msg3 );
+
+        // rounds 64 to 67
+        e0 = _mm_sha1nexte_epu32( e0, msg0 );
+        e1 = abcd;
+        msg1 = _mm_sha1msg2_epu32( msg1, msg0 );
+        abcd = _mm_sha1rnds4_epu32( abcd, e0, 3 );
+        msg3 = _mm_sha1msg1_epu32( msg3, msg0 );
+        msg2 = _mm_xor_si128( msg2, msg0 );
+
+        // rounds 68 to 71
+        e1 = _mm_sha1nexte_epu32( e1, msg1 );
+        e0 = abcd;
+        msg2 = _mm_sha1msg2_epu32( msg2, msg1 );
+        abcd = _mm_sha1rnds4_epu32( abcd, e1, 3 );
+        msg3 = _mm_xor_si128( msg3, msg1 );
+
+        // rounds 72 to 75
+        e0 = _mm_sha1nexte_epu32( e0, msg2 );
+        e1 = abcd;
+        msg3 = _mm_sha1msg2_epu32( msg3, msg2 );
+        abcd = _mm_sha1rnds4_epu32( abcd, e0, 3 );
+
+        // rounds 76 to 79
+        e1 = _mm_sha1nexte_epu32( e1, msg3 );
+        e0 = abcd;
+        abcd = _mm_sha1rnds4_epu32( abcd, e1, 3 );
+        // add in the state from before this block
+        e0 = _mm_sha1nexte_epu32( e0, eSave );
+        abcd = _mm_add_epi32( abcd, abcdSave );
+
+        p += 64;
+        }
+
+    _mm_storeu_si128( (__m128i *)state, _mm_shuffle_epi32( abcd, 0x1B ) );
+    state[4] = (sha1_quadbyte)_mm_extract_epi32( e0, 3 );
+    }
+
+
+
+CPU_TARGET( "sse2" )
+static inline __m128i byteSwap32x4( __m128i inX ) {
+    // swap 16-bit halves, then bytes within them
+    __m128i x = _mm_shufflehi_epi16( _mm_shufflelo_epi16( inX, 0xB1 ), 0xB1 );
+    return _mm_or_si128( _mm_slli_epi16( x, 8 ), _mm_srli_epi16( x, 8 ) );
+    }
+
+
+
+CPU_TARGET( "sse2" )
+static inline __m128i laneF1( __m128i inB, __m128i inC, __m128i inD ) {
+    return _mm_xor_si128( _mm_and_si128( inB, _mm_xor_si128( inC, inD ) ),
+                          inD );
+    }
+
+CPU_TARGET( "sse2" )
+static inline __m128i laneF2( __m128i inB, __m128i inC, __m128i inD ) {
+    return _mm_xor_si128( _mm_xor_si128( inB, inC ), inD );
+    }
+
+CPU_TARGET( "sse2" )
+static inline __m128i laneF3( __m128i inB, __m128i inC, __m128i inD ) {
+    return _mm_or_si128( _mm_and_si128( _mm_or_si128( inB, inC ), inD ),
+                         _mm_and_si128( inB, inC ) );
+    }
+
+
+
+// word t of the schedule, expanding in place in a ring of 16
+CPU_TARGET( "sse2" )
+static inline __m128i laneW( __m128i *inW, int inT ) {
+    if( inT < 16 ) {
+        return inW[ inT ];
+        }
+    __m128i x = _mm_xor_si128( inW[ ( inT - 3 ) & 15 ],
+                               inW[ ( inT - 8 ) & 15 ] );
+    x = _mm_xor_si128( x, inW[ ( inT - 14 ) & 15 ] );
+    x = _mm_xor_si128( x, inW[ inT & 15 ] );
+    x = rol32x4( x, 1 );
+    inW[ inT & 15 ] = x;
+    return x;
+    }
+
+
+
+// hashes four messages at once, one in each 32-bit lane
+// all four advance by inNumBlocks blocks
+CPU_TARGET( "sse2" )
+static void blocksFourLanes( sha1_quadbyte *inStates[4],
+                             const sha1_byte *inData[4],
+                             unsigned int inNumBlocks ) {
+    __m128i v[5];
+
+    for( int i=0; i<5; i++ ) {
+        v[i] = _mm_set_epi32( (int)inStates[3][i], (int)inStates[2][i],
+                              (int)inStates[1][i], (int)inStates[0][i] );
+        }
+
+    __m128i k[4];
+    for( int i=0; i<4; i++ ) {
+        k[i] = _mm_set1_epi32( (int)roundConstants[i] );
+        }
+
+    __m128i w[16];
+
+    for( unsigned int blockIndex=0; blockIndex<inNumBlocks; blockIndex++ ) {
+        unsigned int offset = blockIndex * 64;
+
+        // four words from each lane, transposed so each register holds
+        // the same word of every lane
+        for( int q=0; q<4; q++ ) {
+            __m128i r[4];
+            for( int j=0; j<4; j++ ) {
+                r[j] = byteSwap32x4( _mm_loadu_si128(
+                    (const __m128i *)( inData[j] + offset + 16 * q ) ) );
+                }
+
+            __m128i t0 = _mm_unpacklo_epi32( r[0], r[1] );
+            __m128i t1 = _mm_unpacklo_epi32( r[2], r[3] );
+            __m128i t2 = _mm_unpackhi_epi32( r[0], r[1] );
+            __m128i t3 = _mm_unpackhi_epi32( r[2], r[3] );
+
+            w[ 4 * q ] = _mm_unpacklo_epi64( t0, t1 );
+            w[ 4 * q + 1 ] = _mm_unpackhi_epi64( t0, t1 );
+            w[ 4 * q + 2 ] = _mm_unpacklo_epi64( t2, t3 );
+            w[ 4 * q + 3 ] = _mm_unpackhi_epi64( t2, t3 );
+            }
+
+        __m128i a = v[0];
+        __m128i b = v[1];
+        __m128i c = v[2];
+        __m128i d = v[3];
+        __m128i e = v[4];
+
+        // five rounds at a time, renaming as in SHA1_Transform
+        #define LANE_ROUND( F, K, p, q, x, y, z, t ) \
+            z = _mm_add_epi32( \
+                z, _mm_add_epi32( \
+                    _mm_add_epi32( rol32x4( p, 5 ), F( q, x, y ) ), \
+                    _mm_add_epi32( K, laneW( w, t ) ) ) ); \
+            q = rol32x4( q, 30 );
+
+        #define LANE_FIVE( F, K, t ) \
+            LANE_ROUND( F, K, a, b, c, d, e, t ); \
+            LANE_ROUND( F, K, e, a, b, c, d, t + 1 ); \
+            LANE_ROUND( F, K, d, e, a, b, c, t + 2 ); \
+            LANE_ROUND( F, K, c, d, e, a, b, t + 3 ); \
+            LANE_ROUND( F, K, b, c, d, e, a, t + 4 );
+
+        for( int t=0; t<20; t += 5 ) {
+            LANE_FIVE( laneF1, k[0], t );
+            }
+        for( int t=20; t<40; t += 5 ) {
+            LANE_FIVE( laneF2, k[1], t );
+            }
+        for( int t=40; t<60; t += 5 ) {
+            LANE_FIVE( laneF3, k[2], t );
+            }
+        for( int t=60; t<80; t += 5 ) {
+            LANE_FIVE( laneF2, k[3], t );
+            }
+
+        #undef LANE_FIVE
+        #undef LANE_ROUND
+
+        v[0] = _mm_add_epi32( v[0], a );
+        v[1] = _mm_add_epi32( v[1], b );
+        v[2] = _mm_add_epi32( v[2], c );
+        v[3] = _mm_add_epi32( v[3], d );
+        v[4] = _mm_add_epi32( v[4], e );
+        }
+
+    for( int i=0; i<5; i++ ) {
+        sha1_quadbyte lanes[4];
+        _mm_storeu_si128( (__m128i *)lanes, v[i] );
+
+        for( int j=0; j<4; j++ ) {
+            inStates[j][i] = lanes[j];
+            }
+        }
+    }
+
+
+#else
+
+
+static void blocksFourLanes( sha1_quadbyte *inStates[4],
+                             const sha1_byte *inData[4],
+                             unsigned int inNumBlocks ) {
+    for( int j=0; j<4; j++ ) {
+        SHA1_BlocksPortable( inStates[j], inData[j], inNumBlocks );
+        }
+    }
+
+
+void SHA1_BlocksSHANI( sha1_quadbyte state[5], const sha1_byte *data,
+                       unsigned int numBlocks ) {
+    SHA1_BlocksPortable( state, data, numBlocks );
+    }
+
+
+#endif
+
+
+
+typedef void ( *SHA1BlocksFunction )( sha1_quadbyte state[5],
+                                      const sha1_byte *data,
+                                      unsigned int numBlocks );
+
+
+static SHA1BlocksFunction pickBlocksFunction() {
+    const CPUFeatures *cpu = getCPUFeatures();
+
+    if( cpu->sha && cpu->sse41 && cpu->ssse3 ) {
+        return SHA1_BlocksSHANI;
+        }
+    return SHA1_BlocksPortable;
+    }
+
+
+
+static void sha1Blocks( sha1_quadbyte state[5], const sha1_byte *data,
+                        unsigned int numBlocks ) {
+    static SHA1BlocksFunction function = pickBlocksFunction();
+
+    function( state, data, numBlocks );
+    }
+
+
+
 /* SHA1_Init - Initialize new context */
 void SHA1_Init(SHA_CTX* context) {
 	/* SHA1 initialization constants */
@@ -142,7 +565,7 @@ void SHA1_Init(SHA_CTX* context) {
 }
 
 /* Run your data through this. */
-void SHA1_Update(SHA_CTX *context, sha1_byte *data, unsigned int len) {
+void SHA1_Update(SHA_CTX *context, const sha1_byte *data, unsigned int len) {
 	unsigned int	i, j;
 
 	j = (context->count[0] >> 3) & 63;
@@ -151,8 +574,10 @@ void SHA1_Update(SHA_CTX *context, sha1_byte *data, unsigned int len) {
 	if ((j + len) > 63) {
 	    memcpy(&context->buffer[j], data, (i = 64-j));
 	    SHA1_Transform(context->state, context->buffer);
-	    for ( ; i + 63 < len; i += 64) {
-	        SHA1_Transform(context->state, &data[i]);
+	    if (i + 63 < len) {
+	        unsigned int numBlocks = (len - i) / 64;
+	        sha1Blocks(context->state, &data[i], numBlocks);
+	        i += numBlocks * 64;
 	    }
 	    j = 0;
 	}
@@ -197,15 +622,8 @@ unsigned char *computeRawSHA1Digest( unsigned char *inData,
 
     SHA1_Init( &context );
 
-    // copy into buffer, since this SHA1 implementation seems to overwrite
-    // parts of the data buffer.
-    unsigned char *buffer = new unsigned char[ inDataLength ];
-    memcpy( (void *)buffer, (void *)inData, inDataLength ); 
+    SHA1_Update( &context, inData, inDataLength );
 
-    SHA1_Update( &context, buffer, inDataLength );
-
-    delete [] buffer;
-    
     unsigned char *digest = new unsigned char[ SHA1_DIGEST_LENGTH ];
 
     SHA1_Final( digest, &context );
@@ -221,16 +639,8 @@ unsigned char *computeRawSHA1Digest( char *inString ) {
 
     SHA1_Init( &context );
 
-    // copy into buffer, since this SHA1 implementation seems to overwrite
-    // parts of the data buffer.
-    int dataLength = strlen( inString );
-    unsigned char *buffer = new unsigned char[ dataLength ];
-    memcpy( (void *)buffer, (void *)inString, dataLength ); 
-    
-    SHA1_Update( &context, buffer, strlen( inString ) );
+    SHA1_Update( &context, (sha1_byte *)inString, strlen( inString ) );
 
-    delete [] buffer;
-    
     unsigned char *digest = new unsigned char[ SHA1_DIGEST_LENGTH ];
 
     SHA1_Final( digest, &context );
@@ -268,6 +678,160 @@ char *computeSHA1Digest( unsigned char *inData, int inDataLength ) {
 
 
 
+// finishes a message whose first inNumBlocksDone blocks went into inState
+static void finishDigest( sha1_quadbyte inState[5],
+                          unsigned int inNumBlocksDone,
+                          const unsigned char *inData, int inDataLength,
+                          unsigned char *outDigest ) {
+    SHA_CTX context;
+
+    memcpy( context.state, inState, sizeof( context.state ) );
+
+    unsigned int numBytesDone = inNumBlocksDone * 64;
+
+    context.count[0] = numBytesDone << 3;
+    context.count[1] = numBytesDone >> 29;
+
+    SHA1_Update( &context, &inData[ numBytesDone ],
+                 inDataLength - numBytesDone );
+
+    SHA1_Final( outDigest, &context );
+    }
+
+
+
+void computeRawSHA1Digests( int inNumBuffers,
+                            unsigned char **inData, int *inDataLengths,
+                            unsigned char *outDigests ) {
+
+    // one buffer at a time with SHA-NI beats four lanes of SSE2, so the
+    // lanes are only used when SHA1_Update would fall back to portable
+    static char useFourLanes =
+        getCPUFeatures()->sse2 &&
+        pickBlocksFunction() == SHA1_BlocksPortable;
+
+    if( useFourLanes ) {
+        computeRawSHA1DigestsFourLanes( inNumBuffers, inData, inDataLengths,
+                                        outDigests );
+        return;
+        }
+
+    for( int i=0; i<inNumBuffers; i++ ) {
+        SHA_CTX context;
+        SHA1_Init( &context );
+        SHA1_Update( &context, inData[i], inDataLengths[i] );
+        SHA1_Final( &( outDigests[ i * SHA1_DIGEST_LENGTH ] ), &context );
+        }
+    }
+
+
+
+void computeRawSHA1DigestsFourLanes( int inNumBuffers,
+                                     unsigned char **inData,
+                                     int *inDataLengths,
+                                     unsigned char *outDigests ) {
+
+    sha1_quadbyte *states = new sha1_quadbyte[ inNumBuffers * 5 ];
+
+    const sha1_quadbyte initialState[5] = {
+        0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+
+
+    // buffer in each lane, or -1 if lane is free
+    int laneBuffer[4] = { -1, -1, -1, -1 };
+
+    // full blocks each lane's buffer has hashed so far
+    unsigned int laneBlocksDone[4] = { 0, 0, 0, 0 };
+
+    int nextBuffer = 0;
+
+    while( true ) {
+        // refill free lanes
+        int numActive = 0;
+
+        for( int j=0; j<4; j++ ) {
+            while( laneBuffer[j] == -1 && nextBuffer < inNumBuffers ) {
+                int i = nextBuffer++;
+
+                memcpy( &( states[ i * 5 ] ), initialState,
+                        sizeof( initialState ) );
+
+                if( inDataLengths[i] < 64 ) {
+                    // nothing for a lane to do
+                    finishDigest( &( states[ i * 5 ] ), 0,
+                                  inData[i], inDataLengths[i],
+                                  &( outDigests[ i * SHA1_DIGEST_LENGTH ] ) );
+                    }
+                else {
+                    laneBuffer[j] = i;
+                    laneBlocksDone[j] = 0;
+                    }
+                }
+
+            if( laneBuffer[j] != -1 ) {
+                numActive++;
+                }
+            }
+
+        if( numActive < 4 ) {
+            break;
+            }
+
+        // run all lanes until the shortest has no full blocks left
+        unsigned int numSteps = 0xFFFFFFFF;
+
+        sha1_quadbyte *laneStates[4];
+        const sha1_byte *laneData[4];
+
+        for( int j=0; j<4; j++ ) {
+            int i = laneBuffer[j];
+
+            unsigned int blocksLeft =
+                inDataLengths[i] / 64 - laneBlocksDone[j];
+
+            if( blocksLeft < numSteps ) {
+                numSteps = blocksLeft;
+                }
+
+            laneStates[j] = &( states[ i * 5 ] );
+            laneData[j] = &( inData[i][ laneBlocksDone[j] * 64 ] );
+            }
+
+        blocksFourLanes( laneStates, laneData, numSteps );
+
+        for( int j=0; j<4; j++ ) {
+            int i = laneBuffer[j];
+
+            laneBlocksDone[j] += numSteps;
+
+            unsigned int numBlocks = inDataLengths[i] / 64;
+
+            if( laneBlocksDone[j] == numBlocks ) {
+                finishDigest( &( states[ i * 5 ] ), laneBlocksDone[j],
+                              inData[i], inDataLengths[i],
+                              &( outDigests[ i * SHA1_DIGEST_LENGTH ] ) );
+                laneBuffer[j] = -1;
+                }
+            }
+        }
+
+    // too few left to fill the lanes
+    for( int j=0; j<4; j++ ) {
+        int i = laneBuffer[j];
+
+        if( i != -1 ) {
+            finishDigest( &( states[ i * 5 ] ), laneBlocksDone[j],
+                          inData[i], inDataLengths[i],
+                          &( outDigests[ i * SHA1_DIGEST_LENGTH ] ) );
+            }
+        }
+
+    delete [] states;
+    }
+
+
+
+
 // returns new data buffer of length inALength + inBLength
 static unsigned char *dataConcat( unsigned char *inA, int inALength,
                                   unsigned char *inB, int inBLength ) {
@@ -8,11 +8,13 @@
 
 
 #include "sha1.h"
+#include "FileHasher.h"
 #include "minorGems/formats/encodingUtils.h"
 
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 
 /**
@@ -24,70 +26,138 @@ void usage( char *inAppName );
 
 
 
-int main( int inNumArgs, char **inArgs ) {
+static int sumFiles( int inNumFiles, char **inPaths ) {
+    FileHasher hasher;
 
+    unsigned char *digests =
+        new unsigned char[ inNumFiles * SHA1_DIGEST_LENGTH ];
+    char *succeeded = new char[ inNumFiles ];
 
-    if( inNumArgs != 2 ) {
-        usage( inArgs[0] );
+    hasher.hashFiles( inNumFiles, inPaths, digests, succeeded );
+
+    int numFailed = 0;
+
+    for( int i=0; i<inNumFiles; i++ ) {
+        if( succeeded[i] ) {
+            char *digestHexString =
+                hexEncode( &( digests[ i * SHA1_DIGEST_LENGTH ] ),
+                           SHA1_DIGEST_LENGTH );
+
+            printf( "%s  %s\n", digestHexString, inPaths[i] );
+
+            delete [] digestHexString;
+            }
+        else {
+            printf( "Error reading from file %s\n", inPaths[i] );
+            numFailed++;
+            }
         }
 
+    delete [] digests;
+    delete [] succeeded;
 
-    FILE *file = fopen( inArgs[1], "rb" );
+    return ( numFailed > 0 );
+    }
 
-    if( file == NULL ) {
-        printf( "Failed to open file %s for reading\n\n", inArgs[1] );
 
-        usage( inArgs[0] );
+
+static int writeManifest( char *inRootPath, char *inManifestPath ) {
+    File root( NULL, inRootPath );
+    File manifestFile( NULL, inManifestPath );
+
+    FileHasher hasher;
+
+    int numFailed;
+    FileHashManifest *manifest = hasher.hashTree( &root, &numFailed );
+
+    if( manifest == NULL ) {
+        printf( "%s is not a directory\n", inRootPath );
+        return 1;
+        }
+
+    char written = manifest->writeToFile( &manifestFile );
+
+    printf( "Hashed %d files", manifest->getNumEntries() );
+    if( numFailed > 0 ) {
+        printf( ", %d unreadable files left out", numFailed );
         }
+    printf( "\n" );
 
-    
-    SHA_CTX shaContext;
+    delete manifest;
 
-    SHA1_Init( &shaContext );
+    if( ! written ) {
+        printf( "Failed to write manifest %s\n", inManifestPath );
+        return 1;
+        }
 
-               
-    int bufferSize = 5000;
-    unsigned char *buffer = new unsigned char[ bufferSize ];
+    return ( numFailed > 0 );
+    }
 
-    int numRead = bufferSize;
 
-    char error = false;
-    
-    // read bytes from file until we run out
-    while( numRead == bufferSize && !error ) {
 
-        numRead = fread( buffer, 1, bufferSize, file );
+static int checkManifest( char *inRootPath, char *inManifestPath,
+                          char inRehashAll ) {
+    File root( NULL, inRootPath );
+    File manifestFile( NULL, inManifestPath );
 
-        if( numRead > 0 ) {
-            SHA1_Update( &shaContext, buffer, numRead );
-            }
-        else{
-            error = true;
+    FileHashManifest manifest;
+
+    if( ! manifest.readFromFile( &manifestFile ) ) {
+        printf( "Failed to read manifest %s\n", inManifestPath );
+        return 1;
+        }
+
+    FileHasher hasher;
+
+    SimpleVector<char *> badPaths;
+    int numRehashed, numRefreshed;
+
+    int numBad = hasher.verifyTree( &root, &manifest, inRehashAll,
+                                    &badPaths, &numRehashed,
+                                    &numRefreshed );
+
+    for( int i=0; i<badPaths.size(); i++ ) {
+        printf( "FAILED  %s\n", badPaths.getElementDirect( i ) );
+        delete [] badPaths.getElementDirect( i );
+        }
+
+    printf( "Checked %d files, re-hashed %d, %d bad\n",
+            manifest.getNumEntries(), numRehashed, numBad );
+
+    if( numRefreshed > 0 ) {
+        // so unchanged but touched files aren't read next time
+        if( ! manifest.writeToFile( &manifestFile ) ) {
+            printf( "Failed to update manifest %s\n", inManifestPath );
             }
         }
 
-    fclose( file ); 
-    delete [] buffer;
+    return ( numBad > 0 );
+    }
+
 
 
-    if( error ) {
-        printf( "Error reading from file %s\n", inArgs[1] );
+int main( int inNumArgs, char **inArgs ) {
+
+    if( inNumArgs < 2 ) {
+        usage( inArgs[0] );
+        }
+
+    if( strcmp( inArgs[1], "-w" ) == 0 ) {
+        if( inNumArgs != 4 ) {
+            usage( inArgs[0] );
+            }
+        return writeManifest( inArgs[2], inArgs[3] );
         }
-    else {
-        unsigned char *rawDigest = new unsigned char[ SHA1_DIGEST_LENGTH ];
-        
-        SHA1_Final( rawDigest, &shaContext );
-        
-        // else hash is correct
-        char *digestHexString = hexEncode( rawDigest, SHA1_DIGEST_LENGTH );
-        
-        printf( "%s  %s\n", digestHexString, inArgs[1] );
-
-        delete [] rawDigest;
-        delete [] digestHexString;
+
+    if( strcmp( inArgs[1], "-c" ) == 0 || strcmp( inArgs[1], "-C" ) == 0 ) {
+        if( inNumArgs != 4 ) {
+            usage( inArgs[0] );
+            }
+        return checkManifest( inArgs[2], inArgs[3],
+                              strcmp( inArgs[1], "-C" ) == 0 );
         }
-    
-    return 0;
+
+    return sumFiles( inNumArgs - 1, &( inArgs[1] ) );
     }
 
 
@@ -95,11 +165,18 @@ int main( int inNumArgs, char **inArgs ) {
 void usage( char *inAppName ) {
 
     printf( "Usage:\n\n" );
-    printf( "\t%s file_to_sum\n", inAppName );
+    printf( "\t%s file_to_sum [more_files]\n", inAppName );
+    printf( "\t%s -w directory manifest_to_write\n", inAppName );
+    printf( "\t%s -c directory manifest_to_check\n\n", inAppName );
+
+    printf( "-c only reads files whose length or modification time differ\n"
+            "from the manifest.  -C reads every file.\n\n" );
 
     printf( "example:\n" );
 
     printf( "\t%s test.txt\n", inAppName );
+    printf( "\t%s -w gameData gameData.sha1\n", inAppName );
+    printf( "\t%s -c gameData gameData.sha1\n", inAppName );
 
     exit( 1 );
     }
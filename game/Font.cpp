@@ -2,6 +2,10 @@
 
 #include "minorGems/graphics/RGBAImage.h"
 #include "minorGems/util/log/AppLog.h"
+#include "minorGems/util/stringUtils.h"
+#include "minorGems/crypto/hashes/sha1.h"
+#include "minorGems/io/file/File.h"
+#include "minorGems/system/ThreadPool.h"
 
 #include <string.h>
 
@@ -35,18 +39,43 @@ const unsigned char inkA = 127;
 
 
 
+static char *kerningCacheFolder = stringDuplicate( "fontCache" );
+
+static int kerningThreads = -1;
+
+
+// bump when kerning computation or file layout changes
+#define KERNING_CACHE_VERSION 1
+
+// magic, version, inkA, sprite width and height, then a flag per character
+#define KERNING_CACHE_HEADER_LENGTH ( 4 + 1 + 1 + 2 + 2 + 256 )
+
+
+#define DEFAULT_MAX_GLYPH_RUNS 256
+
+
+
 Font::Font( const char *inFileName, int inCharSpacing, int inSpaceWidth,
             char inFixedWidth, double inScaleFactor, int inFixedCharWidth )
         : mScaleFactor( inScaleFactor ),
           mCharSpacing( inCharSpacing ), mSpaceWidth( inSpaceWidth ),
           mFixedWidth( inFixedWidth ), mEnableKerning( true ),
-          mMinimumPositionPrecision( 0 ) {
+          mMinimumPositionPrecision( 0 ),
+          mKerningCached( false ),
+          mMaxGlyphRuns( 0 ),
+          mGlyphRunBuckets( NULL ),
+          mNumGlyphRunBuckets( 0 ),
+          mGlyphRunClock( 0 ),
+          mGlyphRunHits( 0 ),
+          mGlyphRunMisses( 0 ) {
 
     for( int i=0; i<256; i++ ) {
         mSpriteMap[i] = NULL;
         mKerningTable[i] = NULL;
         }
     
+    setGlyphRunCacheSize( DEFAULT_MAX_GLYPH_RUNS );
+    
 
 
     Image *spriteImage = readTGAFile( inFileName );
@@ -228,157 +257,464 @@ Font::Font( const char *inFileName, int inCharSpacing, int inSpaceWidth,
         // now that we've read in all characters, we can do real kerning
         if( !mFixedWidth ) {
             
-            // first, compute left and right extremes for each pixel
-            // row of each character
-            int *rightExtremes[256];
-            int *leftExtremes[256];
+            // kerning depends only on ink, so hash alpha to find
+            // tables computed for this image before
+            unsigned char *alpha = new unsigned char[ numPixels ];
+            
+            for( int i=0; i<numPixels; i++ ) {
+                alpha[i] = spriteRGBA[i].comp.a;
+                }
             
-            for( int i=0; i<256; i++ ) {
-                rightExtremes[i] = new int[ mSpriteHeight ];
-                leftExtremes[i] = new int[ mSpriteHeight ];
+            char *imageHash = computeSHA1Digest( alpha, numPixels );
+            delete [] alpha;
+            
+            if( loadKerning( imageHash, savedCharacterRGBA ) ) {
+                mKerningCached = true;
+                }
+            else {
+                computeKerning( savedCharacterRGBA );
+                saveKerning( imageHash );
+                }
+            
+            delete [] imageHash;
+            }
+
+        for( int i=0; i<256; i++ ) {
+            if( savedCharacterRGBA[i] != NULL ) {
+                delete [] savedCharacterRGBA[i];
+                }
+            }
+        
+
+        delete [] spriteRGBA;
+        }
+    }
+
+
+
+Font::~Font() {
+    for( int i=0; i<256; i++ ) {
+        if( mSpriteMap[i] != NULL ) {
+            freeSprite( mSpriteMap[i] );
+            }
+        if( mKerningTable[i] != NULL ) {
+            delete mKerningTable[i];
+            }
+        }
+
+    clearGlyphRuns();
+    delete [] mGlyphRunBuckets;
+    }
+
+
+
+// shared by all threads computing one font's kerning
+typedef struct KerningScan {
+        rgbaColor **charRGBA;
+        
+        int spriteWidth;
+        int spriteHeight;
+        
+        int *charLeftEdgeOffset;
+        int *charWidth;
+
+        int *rightExtremes[256];
+        int *leftExtremes[256];
+        
+        KerningTable **kerningTable;
+    } KerningScan;
+
+
+
+// computes left and right extremes for each pixel row of character i
+static void scanExtremes( KerningScan *inScan, int i ) {
+    int mSpriteWidth = inScan->spriteWidth;
+    int mSpriteHeight = inScan->spriteHeight;
+    rgbaColor **savedCharacterRGBA = inScan->charRGBA;
+    
+    if( savedCharacterRGBA[i] != NULL ) {
+        for( int y=0; y<mSpriteHeight; y++ ) {
+            
+            int rightExtreme = 0;
+            int leftExtreme = mSpriteWidth;
+            
+            for( int x=0; x<mSpriteWidth; x++ ) {
+                int p = y * mSpriteWidth + x;
                 
-                if( savedCharacterRGBA[i] != NULL ) {
-                    for( int y=0; y<mSpriteHeight; y++ ) {
+                if( savedCharacterRGBA[i][p].comp.a > inkA ) {
+                    rightExtreme = x;
+                    }
+                if( x < leftExtreme &&
+                    savedCharacterRGBA[i][p].comp.a > inkA ) {
+                    
+                    leftExtreme = x;
+                    }
+                // also check pixel rows above and below
+                // for left character, to look for
+                // diagonal collisions (perfect nesting
+                // with no vertical gap)
+                if( y > 0 && x < leftExtreme ) {
+                    int pp = (y-1) * mSpriteWidth + x;
+                    if( savedCharacterRGBA[i][pp].comp.a 
+                        > inkA ) {
                         
-                        int rightExtreme = 0;
-                        int leftExtreme = mSpriteWidth;
-                            
-                        for( int x=0; x<mSpriteWidth; x++ ) {
-                            int p = y * mSpriteWidth + x;
-                                
-                            if( savedCharacterRGBA[i][p].comp.a > inkA ) {
-                                rightExtreme = x;
-                                }
-                            if( x < leftExtreme &&
-                                savedCharacterRGBA[i][p].comp.a > inkA ) {
-                                
-                                leftExtreme = x;
-                                }
-                            // also check pixel rows above and below
-                            // for left character, to look for
-                            // diagonal collisions (perfect nesting
-                            // with no vertical gap)
-                            if( y > 0 && x < leftExtreme ) {
-                                int pp = (y-1) * mSpriteWidth + x;
-                                if( savedCharacterRGBA[i][pp].comp.a 
-                                    > inkA ) {
-                                    
-                                    leftExtreme = x;
-                                    }
-                                }
-                            if( y < mSpriteHeight - 1 
-                                && x < leftExtreme ) {
-                                
-                                int pp = (y+1) * mSpriteWidth + x;
-                                if( savedCharacterRGBA[i][pp].comp.a 
-                                    > inkA ) {
-                                    
-                                    leftExtreme = x;
-                                    }
-                                }
-                            }
+                        leftExtreme = x;
+                        }
+                    }
+                if( y < mSpriteHeight - 1 
+                    && x < leftExtreme ) {
+                    
+                    int pp = (y+1) * mSpriteWidth + x;
+                    if( savedCharacterRGBA[i][pp].comp.a 
+                        > inkA ) {
                         
-                        rightExtremes[i][y] = rightExtreme;
-                        leftExtremes[i][y] = leftExtreme;
+                        leftExtreme = x;
                         }
                     }
                 }
             
+            inScan->rightExtremes[i][y] = rightExtreme;
+            inScan->leftExtremes[i][y] = leftExtreme;
+            }
+        }
+    }
 
 
-            for( int i=0; i<256; i++ ) {
-                if( savedCharacterRGBA[i] != NULL ) {
-                
-                    mKerningTable[i] = new KerningTable;
 
+// computes kerning table for character i followed by every character
+// needs extremes for all characters
+static void scanKerningTable( KerningScan *inScan, int i ) {
+    int mSpriteWidth = inScan->spriteWidth;
+    int mSpriteHeight = inScan->spriteHeight;
+    rgbaColor **savedCharacterRGBA = inScan->charRGBA;
+    int *mCharLeftEdgeOffset = inScan->charLeftEdgeOffset;
+    int *mCharWidth = inScan->charWidth;
+    KerningTable **mKerningTable = inScan->kerningTable;
+    
+    if( savedCharacterRGBA[i] == NULL ) {
+        return;
+        }
+    
+    mKerningTable[i] = new KerningTable;
 
-                    // for each character that could come after this character
-                    for( int j=0; j<256; j++ ) {
 
-                        mKerningTable[i]->offset[j] = 0;
+    // for each character that could come after this character
+    for( int j=0; j<256; j++ ) {
 
-                        // not a blank character
-                        if( savedCharacterRGBA[j] != NULL ) {
+        mKerningTable[i]->offset[j] = 0;
+
+        // not a blank character
+        if( savedCharacterRGBA[j] != NULL ) {
                         
-                            short minDistance = 2 * mSpriteWidth;
+            short minDistance = 2 * mSpriteWidth;
 
-                            // for each pixel row, find distance
-                            // between the right extreme of the first character
-                            // and the left extreme of the second
-                            for( int y=0; y<mSpriteHeight; y++ ) {
+            // for each pixel row, find distance
+            // between the right extreme of the first character
+            // and the left extreme of the second
+            for( int y=0; y<mSpriteHeight; y++ ) {
                             
-                                int rightExtreme = rightExtremes[i][y];
-                                int leftExtreme = leftExtremes[j][y];
+                int rightExtreme = inScan->rightExtremes[i][y];
+                int leftExtreme = inScan->leftExtremes[j][y];
                             
-                                int rowDistance =
-                                    ( mSpriteWidth - rightExtreme - 1 ) 
-                                    + leftExtreme;
+                int rowDistance =
+                    ( mSpriteWidth - rightExtreme - 1 ) 
+                    + leftExtreme;
 
-                                if( rowDistance < minDistance ) {
-                                    minDistance = rowDistance;
-                                    }
-                                }
+                if( rowDistance < minDistance ) {
+                    minDistance = rowDistance;
+                    }
+                }
                         
-                            // have min distance across all rows for 
-                            // this character pair
-
-                            // of course, we've already done pseudo-kerning
-                            // based on character width, so take that into 
-                            // account
-                            // 
-                            // true kerning is a tweak to that
+            // have min distance across all rows for 
+            // this character pair
+
+            // of course, we've already done pseudo-kerning
+            // based on character width, so take that into 
+            // account
+            // 
+            // true kerning is a tweak to that
                         
-                            // pseudo-kerning already accounts for
-                            // gap to left of second character
-                            minDistance -= mCharLeftEdgeOffset[j];
-                            // pseudo-kerning already accounts for gap to right
-                            // of first character
-                            minDistance -= 
-                                mSpriteWidth - 
-                                ( mCharLeftEdgeOffset[i] + mCharWidth[i] );
+            // pseudo-kerning already accounts for
+            // gap to left of second character
+            minDistance -= mCharLeftEdgeOffset[j];
+            // pseudo-kerning already accounts for gap to right
+            // of first character
+            minDistance -= 
+                mSpriteWidth - 
+                ( mCharLeftEdgeOffset[i] + mCharWidth[i] );
                         
-                            if( minDistance > 0 
-                                // make sure we don't have a full overhang
-                                // for characters that don't collide
-                                // horizontally at all
-                                && minDistance < mCharWidth[i] ) {
+            if( minDistance > 0 
+                // make sure we don't have a full overhang
+                // for characters that don't collide
+                // horizontally at all
+                && minDistance < mCharWidth[i] ) {
                             
-                                mKerningTable[i]->offset[j] = - minDistance;
-                                }
-                            }
-                        }
-                
-                    }
+                mKerningTable[i]->offset[j] = - minDistance;
                 }
+            }
+        }
+    }
+
+
+
+class KerningJob : public ThreadPoolJob {
+    public:
+        KerningScan *mScan;
+        
+        int mStart;
+        int mEnd;
+        
+        // false for extremes
+        char mTables;
+        
 
-            for( int i=0; i<256; i++ ) {
-                delete [] rightExtremes[i];
-                delete [] leftExtremes[i];
+        virtual void runJob() {
+            for( int i=mStart; i<mEnd; i++ ) {
+                if( mTables ) {
+                    scanKerningTable( mScan, i );
+                    }
+                else {
+                    scanExtremes( mScan, i );
+                    }
                 }
             }
+    };
 
+
+
+void Font::computeKerning( rgbaColor **inCharRGBA ) {
+    KerningScan scan;
+    
+    scan.charRGBA = inCharRGBA;
+    scan.spriteWidth = mSpriteWidth;
+    scan.spriteHeight = mSpriteHeight;
+    scan.charLeftEdgeOffset = mCharLeftEdgeOffset;
+    scan.charWidth = mCharWidth;
+    scan.kerningTable = mKerningTable;
+    
+    for( int i=0; i<256; i++ ) {
+        scan.rightExtremes[i] = new int[ mSpriteHeight ];
+        scan.leftExtremes[i] = new int[ mSpriteHeight ];
+        }
+    
+    int numThreads = kerningThreads;
+    
+    if( numThreads < 1 ) {
+        numThreads = ThreadPool::getNumCPUs();
+        }
+    
+    if( numThreads == 1 ) {
         for( int i=0; i<256; i++ ) {
-            if( savedCharacterRGBA[i] != NULL ) {
-                delete [] savedCharacterRGBA[i];
+            scanExtremes( &scan, i );
+            }
+        for( int i=0; i<256; i++ ) {
+            scanKerningTable( &scan, i );
+            }
+        }
+    else {
+        ThreadPool pool( numThreads );
+        
+        // several jobs per thread, since blank characters are free
+        int numJobs = numThreads * 4;
+        if( numJobs > 256 ) {
+            numJobs = 256;
+            }
+        
+        KerningJob *jobs = new KerningJob[ numJobs ];
+
+        for( int t=0; t<2; t++ ) {
+            // all extremes are needed before any table
+            for( int j=0; j<numJobs; j++ ) {
+                jobs[j].mScan = &scan;
+                jobs[j].mStart = ( j * 256 ) / numJobs;
+                jobs[j].mEnd = ( ( j + 1 ) * 256 ) / numJobs;
+                jobs[j].mTables = ( t == 1 );
+                
+                pool.addJob( &( jobs[j] ) );
                 }
+            pool.waitForAllJobs();
             }
         
+        delete [] jobs;
+        }
 
-        delete [] spriteRGBA;
+    for( int i=0; i<256; i++ ) {
+        delete [] scan.rightExtremes[i];
+        delete [] scan.leftExtremes[i];
         }
     }
 
 
 
-Font::~Font() {
+static File *getKerningCacheFile( const char *inImageHash ) {
+    char *fileName = autoSprintf( "%s.kern", inImageHash );
+    
+    File *file = new File( new Path( kerningCacheFolder ), fileName );
+    
+    delete [] fileName;
+    
+    return file;
+    }
+
+
+
+char Font::loadKerning( const char *inImageHash, rgbaColor **inCharRGBA ) {
+    if( kerningCacheFolder == NULL ) {
+        return false;
+        }
+    
+    File *file = getKerningCacheFile( inImageHash );
+    
+    if( ! file->exists() ) {
+        delete file;
+        return false;
+        }
+    
+    int length;
+    unsigned char *data = file->readFileContents( &length );
+    
+    delete file;
+    
+    if( data == NULL ) {
+        return false;
+        }
+    
+
+    char valid = false;
+    
+    if( length >= KERNING_CACHE_HEADER_LENGTH &&
+        memcmp( data, "KERN", 4 ) == 0 &&
+        data[4] == KERNING_CACHE_VERSION &&
+        data[5] == inkA &&
+        ( data[6] | data[7] << 8 ) == mSpriteWidth &&
+        ( data[8] | data[9] << 8 ) == mSpriteHeight ) {
+        
+        unsigned char *flags = &( data[10] );
+        
+        int numTables = 0;
+        valid = true;
+        
+        for( int i=0; i<256; i++ ) {
+            if( flags[i] != ( inCharRGBA[i] != NULL ) ) {
+                valid = false;
+                }
+            if( flags[i] ) {
+                numTables++;
+                }
+            }
+        
+        if( length != KERNING_CACHE_HEADER_LENGTH + numTables * 512 ) {
+            valid = false;
+            }
+        }
+    
+    if( valid ) {
+        unsigned char *next = &( data[ KERNING_CACHE_HEADER_LENGTH ] );
+        
+        for( int i=0; i<256; i++ ) {
+            if( inCharRGBA[i] != NULL ) {
+                mKerningTable[i] = new KerningTable;
+                
+                for( int j=0; j<256; j++ ) {
+                    mKerningTable[i]->offset[j] = 
+                        (short)( next[0] | next[1] << 8 );
+                    next += 2;
+                    }
+                }
+            }
+        }
+    else {
+        AppLog::infoF( "Ignoring stale font kerning cache file %s.kern",
+                       inImageHash );
+        }
+    
+    delete [] data;
+    
+    return valid;
+    }
+
+
+
+void Font::saveKerning( const char *inImageHash ) {
+    if( kerningCacheFolder == NULL ) {
+        return;
+        }
+    
+    File folder( NULL, kerningCacheFolder );
+    
+    if( ! folder.exists() ) {
+        folder.makeDirectory();
+        }
+    
+    int numTables = 0;
     for( int i=0; i<256; i++ ) {
-        if( mSpriteMap[i] != NULL ) {
-            freeSprite( mSpriteMap[i] );
+        if( mKerningTable[i] != NULL ) {
+            numTables++;
             }
+        }
+    
+    int length = KERNING_CACHE_HEADER_LENGTH + numTables * 512;
+    
+    unsigned char *data = new unsigned char[ length ];
+    
+    memcpy( data, "KERN", 4 );
+    data[4] = KERNING_CACHE_VERSION;
+    data[5] = inkA;
+    data[6] = mSpriteWidth & 0xFF;
+    data[7] = ( mSpriteWidth >> 8 ) & 0xFF;
+    data[8] = mSpriteHeight & 0xFF;
+    data[9] = ( mSpriteHeight >> 8 ) & 0xFF;
+    
+    unsigned char *next = &( data[ KERNING_CACHE_HEADER_LENGTH ] );
+    
+    for( int i=0; i<256; i++ ) {
+        data[ 10 + i ] = ( mKerningTable[i] != NULL );
+        
         if( mKerningTable[i] != NULL ) {
-            delete mKerningTable[i];
+            for( int j=0; j<256; j++ ) {
+                unsigned short offset = 
+                    (unsigned short)( mKerningTable[i]->offset[j] );
+                
+                next[0] = offset & 0xFF;
+                next[1] = offset >> 8;
+                next += 2;
+                }
             }
         }
+    
+    File *file = getKerningCacheFile( inImageHash );
+    
+    if( ! file->writeToFile( data, length ) ) {
+        AppLog::warningF( "Failed to save font kerning cache file %s.kern",
+                          inImageHash );
+        }
+    
+    delete file;
+    delete [] data;
+    }
+
+
+
+void Font::setKerningCacheFolder( const char *inFolderName ) {
+    if( kerningCacheFolder != NULL ) {
+        delete [] kerningCacheFolder;
+        kerningCacheFolder = NULL;
+        }
+    if( inFolderName != NULL ) {
+        kerningCacheFolder = stringDuplicate( inFolderName );
+        }
+    }
+
+
+
+void Font::setKerningThreads( int inNumThreads ) {
+    kerningThreads = inNumThreads;
+    }
+
+
+
+char Font::wasKerningCached() {
+    return mKerningCached;
     }
 
 
@@ -420,6 +756,8 @@ void Font::copySpacing( Font *inOtherFont ) {
         
 
     mCharBlockWidth = inOtherFont->mCharBlockWidth;
+    
+    clearGlyphRuns();
     }
 
 
@@ -447,30 +785,250 @@ std::string latin1ToUtf8(const char* latin1Str) {
 }
 
 
-double Font::getCharPos(SimpleVector<doublePair>* outPositions, const char* inString, doublePair inPosition, TextAlignment inAlign) {
+static unsigned int hashGlyphRunKey( const char *inString, 
+                                     double inScaleFactor,
+                                     int inCharSpacing ) {
+    // FNV-1a
+    unsigned int hash = 2166136261U;
+    
+    for( const char *c = inString; *c != '\0'; c++ ) {
+        hash ^= (unsigned char)( *c );
+        hash *= 16777619U;
+        }
+    
+    unsigned char scaleBytes[ sizeof( double ) ];
+    memcpy( scaleBytes, &inScaleFactor, sizeof( double ) );
+    
+    for( unsigned int b=0; b<sizeof( double ); b++ ) {
+        hash ^= scaleBytes[b];
+        hash *= 16777619U;
+        }
+    
+    hash ^= (unsigned int)inCharSpacing;
+    hash *= 16777619U;
+    
+    return hash;
+    }
+
+
+
+static void deleteGlyphRun( GlyphRun *inRun ) {
+    delete [] inRun->string;
+    delete [] inRun->chars;
+    delete [] inRun->drawShift;
+    delete [] inRun->advance;
+    delete [] inRun->kern;
+    delete [] inRun->positions;
+    delete inRun;
+    }
+
+
+
+void Font::setGlyphRunCacheSize( int inMaxRuns ) {
+    clearGlyphRuns();
+    
+    if( mGlyphRunBuckets != NULL ) {
+        delete [] mGlyphRunBuckets;
+        }
+    
+    mMaxGlyphRuns = inMaxRuns;
+    
+    // keep chains short
+    mNumGlyphRunBuckets = 16;
+    while( mNumGlyphRunBuckets < 2 * mMaxGlyphRuns ) {
+        mNumGlyphRunBuckets *= 2;
+        }
+    
+    mGlyphRunBuckets = new int[ mNumGlyphRunBuckets ];
+    
+    for( int b=0; b<mNumGlyphRunBuckets; b++ ) {
+        mGlyphRunBuckets[b] = -1;
+        }
+    }
+
+
+
+void Font::getGlyphRunCacheStats( int *outHits, int *outMisses ) {
+    *outHits = mGlyphRunHits;
+    *outMisses = mGlyphRunMisses;
+    }
+
+
+
+void Font::clearGlyphRuns() {
+    for( int i=0; i<mGlyphRuns.size(); i++ ) {
+        deleteGlyphRun( mGlyphRuns.getElementDirect( i ) );
+        }
+    mGlyphRuns.deleteAll();
+    
+    for( int b=0; b<mNumGlyphRunBuckets; b++ ) {
+        mGlyphRunBuckets[b] = -1;
+        }
+    }
+
+
+
+GlyphRun *Font::findGlyphRun( const char *inString, unsigned int inHash ) {
+    if( mMaxGlyphRuns <= 0 ) {
+        return NULL;
+        }
+    
+    int index = mGlyphRunBuckets[ inHash & ( mNumGlyphRunBuckets - 1 ) ];
+    
+    while( index != -1 ) {
+        GlyphRun *run = mGlyphRuns.getElementDirect( index );
+        
+        if( run->hash == inHash &&
+            run->scaleFactor == mScaleFactor &&
+            run->charSpacing == mCharSpacing &&
+            strcmp( run->string, inString ) == 0 ) {
+            
+            mGlyphRunHits++;
+            
+            mGlyphRunClock++;
+            run->lastUsed = mGlyphRunClock;
+            return run;
+            }
+        index = run->nextInBucket;
+        }
+    
+    return NULL;
+    }
+
+
+
+GlyphRun *Font::getGlyphRun( const char *inString ) {
+    unsigned int hash = 
+        hashGlyphRunKey( inString, mScaleFactor, mCharSpacing );
+    
+    GlyphRun *run = findGlyphRun( inString, hash );
+    
+    if( run != NULL ) {
+        return run;
+        }
+    
+    mGlyphRunMisses++;
+    
+
     double scale = scaleFactor * mScaleFactor;
 
-    std::string utf8String = latin1ToUtf8(inString);
+    std::string utf8String = latin1ToUtf8( inString );
     std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>> converter;
-    std::wstring wideString = converter.from_bytes(utf8String);
+    std::wstring wideString = converter.from_bytes( utf8String );
+
+    int numChars = wideString.length();
+
+    run = new GlyphRun;
+    
+    run->string = stringDuplicate( inString );
+    run->scaleFactor = mScaleFactor;
+    run->charSpacing = mCharSpacing;
+    run->hash = hash;
+    run->numChars = numChars;
+    run->chars = new unsigned char[ numChars ];
+    run->drawShift = new double[ numChars ];
+    run->advance = new double[ numChars ];
+    run->kern = new double[ numChars ];
+    run->positions = new doublePair[ numChars ];
+
+    for( int i=0; i<numChars; i++ ) {
+        run->chars[i] = (unsigned char)( wideString[i] );
+        }
+    
+    for( int i=0; i<numChars; i++ ) {
+        unsigned char c = run->chars[i];
+        
+        doublePair zeroPos = { 0, 0 };
+        doublePair drawPos;
+        
+        double charWidth = positionCharacter( c, zeroPos, &drawPos );
+        
+        run->drawShift[i] = - drawPos.x;
+        run->advance[i] = charWidth + mCharSpacing * scale;
+        run->kern[i] = 0;
+        
+        if( ! mFixedWidth && mEnableKerning && i < numChars - 1 &&
+            mKerningTable[ c ] != NULL ) {
+            // there's another character after this
+            // apply true kerning adjustment to the pair
+            int offset = mKerningTable[ c ]->offset[ run->chars[i + 1] ];
+            run->kern[i] = offset * scale;
+            }
+        }
+    
+    run->width = measureBytes( inString, -1 );
+    
+
+    // evict least recently used, reusing its slot
+    int slot;
+    
+    int maxRuns = mMaxGlyphRuns;
+    if( maxRuns < 1 ) {
+        // not reused, but still held until next call
+        maxRuns = 1;
+        }
+    
+    if( mGlyphRuns.size() < maxRuns ) {
+        slot = mGlyphRuns.size();
+        mGlyphRuns.push_back( run );
+        }
+    else {
+        slot = 0;
+        for( int i=1; i<mGlyphRuns.size(); i++ ) {
+            if( mGlyphRuns.getElementDirect( i )->lastUsed < 
+                mGlyphRuns.getElementDirect( slot )->lastUsed ) {
+                slot = i;
+                }
+            }
+        
+        GlyphRun *old = mGlyphRuns.getElementDirect( slot );
+        
+        // unlink from its chain
+        int *link = 
+            &( mGlyphRunBuckets[ old->hash & ( mNumGlyphRunBuckets - 1 ) ] );
+        
+        while( *link != slot ) {
+            link = &( mGlyphRuns.getElementDirect( *link )->nextInBucket );
+            }
+        *link = old->nextInBucket;
+        
+        deleteGlyphRun( old );
+        
+        *( mGlyphRuns.getElement( slot ) ) = run;
+        }
+    
+    int bucket = hash & ( mNumGlyphRunBuckets - 1 );
+    
+    run->nextInBucket = mGlyphRunBuckets[ bucket ];
+    mGlyphRunBuckets[ bucket ] = slot;
+
+    mGlyphRunClock++;
+    run->lastUsed = mGlyphRunClock;
+    
+    return run;
+    }
+
+
 
-    unsigned int numChars = wideString.length();
+double Font::layoutGlyphRun( GlyphRun *inRun, doublePair inPosition,
+                             TextAlignment inAlign ) {
+    double scale = scaleFactor * mScaleFactor;
 
     double x = inPosition.x;
     double y = inPosition.y;
 
     // compensate for extra headspace in accent-equipped font files
-    if (mAccentsPresent) {
+    if( mAccentsPresent ) {
         y += scale * mSpriteHeight / 4;
-    }
-
+        }
+    
     double stringWidth = 0;
-
-    if (inAlign != alignLeft) {
-        stringWidth = measureString(inString);
-    }
-
-    switch (inAlign) {
+    
+    if( inAlign != alignLeft ) {
+        stringWidth = inRun->width;
+        }
+    
+    switch( inAlign ) {
         case alignCenter:
             x -= stringWidth / 2;
             break;
@@ -478,71 +1036,73 @@ double Font::getCharPos(SimpleVector<doublePair>* outPositions, const char* inSt
             x -= stringWidth;
             break;
         default:
-            // left? do nothing
-            break;
-    }
-
+            // left?  do nothing
+            break;            
+        }
+    
     // character sprites are drawn on their centers, so the alignment
     // adjustments above aren't quite right.
     x += scale * mSpriteWidth / 2;
 
-    if (mMinimumPositionPrecision > 0) {
+
+    if( mMinimumPositionPrecision > 0 ) {
         x /= mMinimumPositionPrecision;
-        x = lrint(floor(x));
+        
+        x = lrint( floor( x ) );
+        
         x *= mMinimumPositionPrecision;
-    }
+        }
+    
+    for( int i=0; i<inRun->numChars; i++ ) {
+        inRun->positions[i].x = x - inRun->drawShift[i];
+        inRun->positions[i].y = y;
+        
+        x += inRun->advance[i];
+        x += inRun->kern[i];
+        }
 
-    for (unsigned int i = 0; i < numChars; i++) {
-        doublePair charPos = {x, y};
+    // no spacing after the last character
+    x -= mCharSpacing * scale;
 
-        doublePair drawPos;
+    return x;
+    }
 
-        // Use the wide character instead of the original char
-        double charWidth = positionCharacter(static_cast<unsigned char>(wideString[i]), charPos, &drawPos);
-        outPositions->push_back(drawPos);
 
-        x += charWidth + mCharSpacing * scale;
 
-        if (!mFixedWidth && mEnableKerning && i < numChars - 1 && mKerningTable[static_cast<unsigned char>(wideString[i])] != nullptr) {
-            // there's another character after this
-            // apply true kerning adjustment to the pair
-            int offset = mKerningTable[static_cast<unsigned char>(wideString[i])]->offset[static_cast<unsigned char>(wideString[i + 1])];
-            x += offset * scale;
-        }
+double Font::getCharPos( SimpleVector<doublePair> *outPositions,
+                         const char *inString, doublePair inPosition,
+                         TextAlignment inAlign ) {
+    
+    GlyphRun *run = getGlyphRun( inString );
+    
+    double returnVal = layoutGlyphRun( run, inPosition, inAlign );
+    
+    outPositions->appendArray( run->positions, run->numChars );
+    
+    return returnVal;
     }
-    // no spacing after the last character
-    x -= mCharSpacing * scale;
 
-    return x;
-}
 
 
-double Font::drawString( const char *inString, doublePair inPosition, TextAlignment inAlign ) {
+double Font::drawString( const char *inString, doublePair inPosition,
+                         TextAlignment inAlign ) {
     
-	std::string utf8String = latin1ToUtf8(inString);
-	std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>> converter;
-	std::wstring wideString = converter.from_bytes(utf8String);
-	
-	//SimpleVector<doublePair> pos( strlen( inString ) );
-	SimpleVector<doublePair> pos( wideString.length() );
+    GlyphRun *run = getGlyphRun( inString );
     
-	double returnVal = getCharPos( &pos, inString, inPosition, inAlign );
-    double scale = scaleFactor * mScaleFactor;
-	
-	int posIndex = 0;
-    for (wchar_t wchar : wideString) {
-        unsigned char codePointChar = static_cast<unsigned char>(wchar);
-
-        SpriteHandle spriteID = mSpriteMap[codePointChar];
+    double returnVal = layoutGlyphRun( run, inPosition, inAlign );
 
-        if (spriteID != NULL) {
-            drawSprite(spriteID, pos.getElementDirect(posIndex), scale);
+    double scale = scaleFactor * mScaleFactor;
+    
+    for( int i=0; i<run->numChars; i++ ) {
+        SpriteHandle spriteID = mSpriteMap[ run->chars[i] ];
+        
+        if( spriteID != NULL ) {
+            drawSprite( spriteID, run->positions[i], scale );
+            }
         }
-		posIndex++;
-    }
 
-	return returnVal;    
-}
+    return returnVal;
+    }
 
 
 
@@ -605,6 +1165,23 @@ void Font::drawCharacterSprite( unsigned char inC, doublePair inPosition ) {
 
 
 double Font::measureString( const char *inString, int inCharLimit ) {
+    if( inCharLimit == -1 ) {
+        // reuse width of a string that's being drawn, but don't lay out
+        // strings that are only measured
+        GlyphRun *run = findGlyphRun( 
+            inString, hashGlyphRunKey( inString, mScaleFactor, 
+                                       mCharSpacing ) );
+        if( run != NULL ) {
+            return run->width;
+            }
+        }
+    
+    return measureBytes( inString, inCharLimit );
+    }
+
+
+
+double Font::measureBytes( const char *inString, int inCharLimit ) {
     double scale = scaleFactor * mScaleFactor;
 	
     //AppLog::printOutNextMessage();
@@ -673,6 +1250,9 @@ double Font::getFontHeight() {
 
 
 void Font::enableKerning( char inKerningOn ) {
+    if( inKerningOn != mEnableKerning ) {
+        clearGlyphRuns();
+        }
     mEnableKerning = inKerningOn;
     }
 
@@ -23,6 +23,44 @@ typedef struct KerningTable {
 
 
 
+// a string laid out once, for reuse while it is drawn frame after frame
+// positions are relative, so the run can be drawn anywhere
+typedef struct GlyphRun {
+        // key
+        char *string;
+        double scaleFactor;
+        int charSpacing;
+        unsigned int hash;
+        
+        int numChars;
+
+        // glyph of each character
+        unsigned char *chars;
+        
+        // how far left of its pen position each character is drawn
+        double *drawShift;
+
+        // pen step after each character, spacing included
+        double *advance;
+        
+        // kerning adjustment to pen after each character
+        double *kern;
+
+        // measureString of whole string
+        double width;
+        
+        // positions from last layout
+        doublePair *positions;
+        
+        // for LRU eviction
+        unsigned int lastUsed;
+
+        // index of next run in same hash bucket, or -1
+        int nextInBucket;
+    } GlyphRun;
+
+
+
 class Font {
         
     public:
@@ -92,12 +130,69 @@ class Font {
         void setScaleFactor( double newScaleFactor );
         double getScaleFactor();
 
+
+        // how many laid-out strings drawString, getCharPos, and
+        // measureString keep for reuse, least recently used dropped first
+        // 0 disables reuse
+        // defaults to 256
+        void setGlyphRunCacheSize( int inMaxRuns );
+        
+        // lookups that found a laid-out string, and ones that didn't
+        void getGlyphRunCacheStats( int *outHits, int *outMisses );
+        
+
+        // folder where kerning tables are saved, keyed by a hash of
+        // the font image, so they are only computed the first time a 
+        // font image is seen
+        // NULL disables saving and loading
+        // defaults to "fontCache"
+        // copied internally
+        static void setKerningCacheFolder( const char *inFolderName );
+        
+        // threads used to compute kerning tables not found in the cache
+        // -1 for one per CPU (the default)
+        static void setKerningThreads( int inNumThreads );
+        
+
+        // true if this font's kerning was loaded from the cache
+        char wasKerningCached();
+        
+
     private:        
         
         // returns x coordinate to right of drawn character
         double positionCharacter( unsigned char inC, doublePair inTargetPos,
                                   doublePair *outActualPos );
 
+        // measures inString byte by byte
+        double measureBytes( const char *inString, int inCharLimit );
+        
+        
+        // loads kerning tables for characters with non-NULL inCharRGBA
+        // from cache, if present
+        // inImageHash is a hex string
+        char loadKerning( const char *inImageHash,
+                          union rgbaColor **inCharRGBA );
+        
+        void saveKerning( const char *inImageHash );
+        
+        // computes kerning tables for characters with non-NULL inCharRGBA
+        void computeKerning( union rgbaColor **inCharRGBA );
+        
+
+        // finds a cached run for inString, or NULL
+        GlyphRun *findGlyphRun( const char *inString, unsigned int inHash );
+        
+        // finds or makes a run for inString
+        GlyphRun *getGlyphRun( const char *inString );
+        
+        // lays out inRun at inPosition into inRun->positions
+        // returns x coordinate of string end
+        double layoutGlyphRun( GlyphRun *inRun, doublePair inPosition,
+                               TextAlignment inAlign );
+        
+        void clearGlyphRuns();
+
         
         double mScaleFactor;
         
@@ -132,6 +227,22 @@ class Font {
         char mEnableKerning;
 
         double mMinimumPositionPrecision;
+        
+
+        char mKerningCached;
+        
+        int mMaxGlyphRuns;
+        
+        SimpleVector<GlyphRun*> mGlyphRuns;
+        
+        // heads of hash bucket chains, indices into mGlyphRuns
+        int *mGlyphRunBuckets;
+        int mNumGlyphRunBuckets;
+        
+        unsigned int mGlyphRunClock;
+
+        int mGlyphRunHits;
+        int mGlyphRunMisses;
     };
 
 
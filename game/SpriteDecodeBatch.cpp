@@ -0,0 +1,347 @@
+#include "SpriteDecodeBatch.h"
+
+#include "minorGems/util/stringUtils.h"
+
+#include <string.h>
+
+
+
+class SpriteDecodeJob : public ThreadPoolJob {
+
+    public:
+
+        SpriteDecodeJob( SpriteDecodeBatch *inBatch )
+                : mBatch( inBatch ) {
+            }
+
+
+        virtual void runJob() {
+            while( mBatch->decodeNext() ) {
+                }
+            }
+
+
+    protected:
+        SpriteDecodeBatch *mBatch;
+    };
+
+
+
+SpriteDecodeBatch::SpriteDecodeBatch( int inNumFiles,
+                                      const char **inFileNames,
+                                      char inTransparentLowerLeftCorner,
+                                      char inFindColoredRadii,
+                                      RawRGBAImage *( *inReadFunction )(
+                                          const char *inFileName ),
+                                      int inNumThreads,
+                                      int inMaxWaiting )
+        : mTransparentLowerLeftCorner( inTransparentLowerLeftCorner ),
+          mFindColoredRadii( inFindColoredRadii ),
+          mReadFunction( inReadFunction ),
+          mNextIndex( 0 ), mNumTaken( 0 ),
+          mFreeSlots( inMaxWaiting ),
+          mNumWaiting( 0 ),
+          mStopping( false ) {
+
+    for( int i=0; i<inNumFiles; i++ ) {
+        mFileNames.push_back( stringDuplicate( inFileNames[i] ) );
+        }
+
+    mPool = new ThreadPool( inNumThreads );
+    mNumThreads = mPool->getNumThreads();
+
+    // no more workers than files
+    if( mNumThreads > inNumFiles ) {
+        mNumThreads = inNumFiles;
+        }
+
+    for( int i=0; i<mNumThreads; i++ ) {
+        ThreadPoolJob *job = new SpriteDecodeJob( this );
+        mJobs.push_back( job );
+        mPool->addJob( job );
+        }
+    }
+
+
+
+SpriteDecodeBatch::~SpriteDecodeBatch() {
+    mLock.lock();
+    mStopping = true;
+    mLock.unlock();
+
+    // wakes one worker waiting for a slot, which passes it on
+    mFreeSlots.signal();
+
+    // finishes jobs, which return as soon as they see mStopping
+    delete mPool;
+
+    for( int i=0; i<mJobs.size(); i++ ) {
+        delete mJobs.getElementDirect( i );
+        }
+
+    for( int i=0; i<mWaiting.size(); i++ ) {
+        freeDecodedSprite( mWaiting.getElementDirect( i ) );
+        }
+
+    for( int i=0; i<mFileNames.size(); i++ ) {
+        delete [] mFileNames.getElementDirect( i );
+        }
+    }
+
+
+
+int SpriteDecodeBatch::getNumFiles() {
+    return mFileNames.size();
+    }
+
+
+
+const char *SpriteDecodeBatch::getFileName( int inIndex ) {
+    return mFileNames.getElementDirect( inIndex );
+    }
+
+
+
+int SpriteDecodeBatch::getNumTaken() {
+    mLock.lock();
+    int numTaken = mNumTaken;
+    mLock.unlock();
+
+    return numTaken;
+    }
+
+
+
+char SpriteDecodeBatch::decodeNext() {
+    mFreeSlots.wait();
+
+    mLock.lock();
+
+    if( mStopping || mNextIndex >= mFileNames.size() ) {
+        mLock.unlock();
+
+        // pass slot on, so other workers waiting for one see this too
+        mFreeSlots.signal();
+        return false;
+        }
+
+    int index = mNextIndex++;
+    char *fileName = mFileNames.getElementDirect( index );
+
+    mLock.unlock();
+
+
+    DecodedSprite *sprite = new DecodedSprite;
+    sprite->index = index;
+
+    RawRGBAImage *image = mReadFunction( fileName );
+
+    if( image == NULL ) {
+        sprite->rgba = NULL;
+        sprite->width = 0;
+        sprite->height = 0;
+        for( int i=0; i<4; i++ ) {
+            sprite->coloredRadii[i] = 0.5;
+            }
+        }
+    else {
+        decode( image, mTransparentLowerLeftCorner, mFindColoredRadii,
+                sprite );
+        delete image;
+        }
+
+
+    mLock.lock();
+    mWaiting.push_back( sprite );
+    mLock.unlock();
+
+    mNumWaiting.signal();
+
+    return true;
+    }
+
+
+
+DecodedSprite *SpriteDecodeBatch::takeDecoded() {
+    mLock.lock();
+
+    if( mWaiting.size() == 0 ) {
+        mLock.unlock();
+        return NULL;
+        }
+
+    DecodedSprite *sprite = mWaiting.getElementDirect( 0 );
+    mWaiting.deleteElement( 0 );
+    mNumTaken++;
+
+    mLock.unlock();
+
+    // at most briefly blocked, if worker hasn't signaled yet
+    mNumWaiting.wait();
+
+    mFreeSlots.signal();
+
+    return sprite;
+    }
+
+
+
+DecodedSprite *SpriteDecodeBatch::waitForDecoded() {
+    mLock.lock();
+    char allTaken = ( mNumTaken >= mFileNames.size() );
+    mLock.unlock();
+
+    if( allTaken ) {
+        return NULL;
+        }
+
+    mNumWaiting.wait();
+
+    mLock.lock();
+
+    DecodedSprite *sprite = mWaiting.getElementDirect( 0 );
+    mWaiting.deleteElement( 0 );
+    mNumTaken++;
+
+    mLock.unlock();
+
+    mFreeSlots.signal();
+
+    return sprite;
+    }
+
+
+
+void SpriteDecodeBatch::freeDecodedSprite( DecodedSprite *inSprite ) {
+    if( inSprite->rgba != NULL ) {
+        delete [] inSprite->rgba;
+        }
+    delete inSprite;
+    }
+
+
+
+void SpriteDecodeBatch::decode( RawRGBAImage *inImage,
+                                char inTransparentLowerLeftCorner,
+                                char inFindColoredRadii,
+                                DecodedSprite *outSprite ) {
+
+    int w = inImage->mWidth;
+    int h = inImage->mHeight;
+    int numPixels = w * h;
+
+    outSprite->width = w;
+    outSprite->height = h;
+
+    for( int i=0; i<4; i++ ) {
+        outSprite->coloredRadii[i] = 0.5;
+        }
+
+    unsigned char *rgba = NULL;
+
+    // alpha that is solid everywhere can be replaced by corner transparency
+    char generateAlpha = inTransparentLowerLeftCorner;
+
+    if( inImage->mNumChannels == 4 ) {
+        rgba = inImage->mRGBABytes;
+        inImage->mRGBABytes = NULL;
+
+        for( int p=0; p<numPixels && generateAlpha; p++ ) {
+            if( rgba[ p * 4 + 3 ] != 255 ) {
+                generateAlpha = false;
+                }
+            }
+        }
+    else if( inImage->mNumChannels == 3 && inTransparentLowerLeftCorner ) {
+        unsigned char *rgb = inImage->mRGBABytes;
+
+        rgba = new unsigned char[ numPixels * 4 ];
+
+        for( int p=0; p<numPixels; p++ ) {
+            memcpy( &( rgba[ p * 4 ] ), &( rgb[ p * 3 ] ), 3 );
+            rgba[ p * 4 + 3 ] = 255;
+            }
+        }
+
+    outSprite->rgba = rgba;
+
+    if( rgba == NULL || numPixels == 0 ) {
+        return;
+        }
+
+
+    if( generateAlpha ) {
+        // same as Image::generateAlphaChannel, which compares doubles
+        // converted from these bytes
+        unsigned char *t = &( rgba[ w * ( h - 1 ) * 4 ] );
+
+        unsigned char tR = t[0];
+        unsigned char tG = t[1];
+        unsigned char tB = t[2];
+
+        for( int p=0; p<numPixels; p++ ) {
+            unsigned char *pixel = &( rgba[ p * 4 ] );
+
+            if( pixel[0] == tR && pixel[1] == tG && pixel[2] == tB ) {
+                pixel[3] = 0;
+                }
+            else {
+                pixel[3] = 255;
+                }
+            }
+        }
+
+    if( inFindColoredRadii ) {
+        findColoredRadii( rgba, w, h, outSprite->coloredRadii );
+        }
+    }
+
+
+
+void SpriteDecodeBatch::findColoredRadii( unsigned char *inRGBA,
+                                          int inWidth, int inHeight,
+                                          double outRadii[4] ) {
+    int w = inWidth;
+    int h = inHeight;
+
+    int minX = w;
+    int maxX = 0;
+    int minY = h;
+    int maxY = 0;
+
+    for( int y=0; y<h; y++ ) {
+        for( int x=0; x<w; x++ ) {
+            int index = y * w + x;
+
+            if( inRGBA[ index * 4 + 3 ] > 0 ) {
+
+                if( x < minX ) {
+                    minX = x;
+                    }
+                if( x > maxX ) {
+                    maxX = x;
+                    }
+                if( y < minY ) {
+                    minY = y;
+                    }
+                if( y > maxY ) {
+                    maxY = y;
+                    }
+                }
+            }
+        }
+
+    if( minX > 0 ) {
+        outRadii[0] = 0.5 - minX / (double)w;
+        }
+    if( maxX < w - 1 ) {
+        outRadii[1] = ( maxX + 1 ) / (double)w - 0.5;
+        }
+
+    if( minY > 0 ) {
+        outRadii[2] = 0.5 - minY / (double)h;
+        }
+    if( maxY < h - 1 ) {
+        outRadii[3] = ( maxY + 1 ) / (double)h - 0.5;
+        }
+    }
@@ -0,0 +1,176 @@
+#ifndef SPRITE_DECODE_BATCH_INCLUDED
+#define SPRITE_DECODE_BATCH_INCLUDED
+
+
+
+#include <stdlib.h>
+
+#include "minorGems/graphics/RawRGBAImage.h"
+#include "minorGems/system/ThreadPool.h"
+#include "minorGems/system/MutexLock.h"
+#include "minorGems/system/Semaphore.h"
+#include "minorGems/util/SimpleVector.h"
+
+
+
+typedef struct DecodedSprite {
+        // index of file in batch
+        int index;
+
+        // 4-channel RGBA, top row first
+        // NULL if file missing or unreadable, or if it has no alpha channel
+        // and the batch doesn't take transparency from the lower-left corner
+        unsigned char *rgba;
+
+        int width;
+        int height;
+
+        // left, right, top, bottom:  fraction of width or height from
+        // center to the edge of non-transparent pixels
+        // 0.5 unless batch finds colored radii
+        double coloredRadii[4];
+    } DecodedSprite;
+
+
+
+/**
+ * Reads and decodes a list of sprite images on worker threads, so the
+ * main thread is left with only the texture uploads.
+ *
+ * Each image is converted to the same RGBA bytes that loadSprite would
+ * upload, with alpha generated from the lower-left corner color if asked,
+ * and its colored radii found if asked (for transparent cropping).
+ *
+ * Decoded sprites wait to be taken in the order they finish.  Workers
+ * pause while the most allowed are waiting, so memory stays bounded when
+ * uploads fall behind.
+ *
+ * Sprites must be taken from only one thread.
+ */
+class SpriteDecodeBatch {
+
+    public:
+
+        /**
+         * Starts decoding.
+         *
+         * @param inNumFiles the number of files.
+         * @param inFileNames the file names, passed to inReadFunction.
+         *   Copied internally.  Destroyed by caller.
+         * @param inTransparentLowerLeftCorner true to make pixels matching
+         *   the lower-left corner transparent, unless the image already
+         *   has some transparency, as loadSprite does.
+         * @param inFindColoredRadii true to find colored radii.
+         * @param inReadFunction reads and decodes a TGA file, returning
+         *   NULL on failure.  Called on worker threads at once, so must be
+         *   thread-safe.
+         * @param inNumThreads the number of workers, or -1 for one per
+         *   CPU.  Defaults to -1.
+         * @param inMaxWaiting the most decoded sprites that can wait to be
+         *   taken.  Defaults to 64.
+         */
+        SpriteDecodeBatch( int inNumFiles, const char **inFileNames,
+                           char inTransparentLowerLeftCorner,
+                           char inFindColoredRadii,
+                           RawRGBAImage *( *inReadFunction )(
+                               const char *inFileName ),
+                           int inNumThreads = -1,
+                           int inMaxWaiting = 64 );
+
+
+        // stops workers, and frees decoded sprites not yet taken
+        ~SpriteDecodeBatch();
+
+
+        int getNumFiles();
+
+
+        // not destroyed by caller
+        const char *getFileName( int inIndex );
+
+
+        // number taken so far
+        int getNumTaken();
+
+
+        /**
+         * Takes the next decoded sprite, without blocking.
+         *
+         * @return a decoded sprite, or NULL if none waiting.  Destroyed
+         *   by caller with freeDecodedSprite.
+         */
+        DecodedSprite *takeDecoded();
+
+
+        // same, but blocks until one is waiting
+        // returns NULL once all have been taken
+        DecodedSprite *waitForDecoded();
+
+
+        static void freeDecodedSprite( DecodedSprite *inSprite );
+
+
+        /**
+         * Converts an image into sprite bytes, as workers do.
+         *
+         * @param inImage the image.  Its bytes are taken over, so it
+         *   should be destroyed by caller without using them.
+         * @param inTransparentLowerLeftCorner as in constructor.
+         * @param inFindColoredRadii as in constructor.
+         * @param outSprite the sprite to fill.
+         */
+        static void decode( RawRGBAImage *inImage,
+                            char inTransparentLowerLeftCorner,
+                            char inFindColoredRadii,
+                            DecodedSprite *outSprite );
+
+
+        // same as SpriteGL::findColoredRadii
+        static void findColoredRadii( unsigned char *inRGBA,
+                                      int inWidth, int inHeight,
+                                      double outRadii[4] );
+
+
+        // used by worker jobs
+        // returns false when there is nothing left to decode
+        char decodeNext();
+
+
+
+    protected:
+
+        SimpleVector<char *> mFileNames;
+
+        char mTransparentLowerLeftCorner;
+        char mFindColoredRadii;
+
+        RawRGBAImage *( *mReadFunction )( const char *inFileName );
+
+        MutexLock mLock;
+
+        // next file to start decoding
+        int mNextIndex;
+
+        int mNumTaken;
+
+        SimpleVector<DecodedSprite *> mWaiting;
+
+        // one per sprite that may still be decoded before more are taken
+        Semaphore mFreeSlots;
+
+        // one per waiting sprite
+        Semaphore mNumWaiting;
+
+        char mStopping;
+
+        int mNumThreads;
+
+        // jobs are the pool's workers, each looping until nothing is left
+        SimpleVector<ThreadPoolJob *> mJobs;
+
+        ThreadPool *mPool;
+    };
+
+
+
+#endif
@@ -0,0 +1,173 @@
+// Packs a game's data folders into one AssetArchive, which the game maps at
+// startup instead of opening each file.
+//
+// Usage:  assetPacker [-z] gameDir out.pack [folder ...]
+//
+// Folders default to graphics, sounds, and languages.  Entries are named
+// like "graphics/font.tga", with / separators on every platform.
+//
+// -z compresses entries that shrink by at least an eighth.  Compressed
+// entries must be copied when read, so leave it off if memory matters more
+// than disk space.  Compressed sounds are decoded when loaded, not
+// streamed.
+
+
+#include "minorGems/io/file/AssetArchive.h"
+#include "minorGems/util/SimpleVector.h"
+#include "minorGems/util/stringUtils.h"
+
+#include <stdio.h>
+#include <string.h>
+
+
+
+static void addFolder( File *inFolder, const char *inName, int inDepth,
+                       SimpleVector<char *> *inNames,
+                       SimpleVector<File *> *inFiles ) {
+
+    if( inDepth > 100 ) {
+        printf( "Skipping %s, too deep\n", inName );
+        return;
+        }
+
+    int numChildren;
+    File **children = inFolder->getChildFilesSorted( &numChildren );
+
+    if( children == NULL ) {
+        return;
+        }
+
+    for( int i=0; i<numChildren; i++ ) {
+        char *childName = children[i]->getFileName();
+
+        if( childName[0] == '.' ) {
+            // hidden, like .DS_Store or .git
+            delete children[i];
+            }
+        else {
+            char *entryName = autoSprintf( "%s/%s", inName, childName );
+
+            if( children[i]->isDirectory() ) {
+                addFolder( children[i], entryName, inDepth + 1,
+                           inNames, inFiles );
+                delete [] entryName;
+                delete children[i];
+                }
+            else {
+                inNames->push_back( entryName );
+                inFiles->push_back( children[i] );
+                }
+            }
+        delete [] childName;
+        }
+    delete [] children;
+    }
+
+
+
+int main( int inNumArgs, char **inArgs ) {
+
+    char compress = false;
+
+    int firstArg = 1;
+    if( inNumArgs > 1 && strcmp( inArgs[1], "-z" ) == 0 ) {
+        compress = true;
+        firstArg = 2;
+        }
+
+    if( inNumArgs - firstArg < 2 ) {
+        printf( "\nUsage:  assetPacker [-z] gameDir out.pack "
+                "[folder ...]\n\n" );
+        printf( "Folders default to graphics, sounds, and languages.\n" );
+        printf( "-z compresses entries where it saves space.\n\n" );
+        return 1;
+        }
+
+    File gameDir( NULL, inArgs[ firstArg ] );
+
+    if( ! gameDir.exists() || ! gameDir.isDirectory() ) {
+        printf( "Directory %s not found\n", inArgs[ firstArg ] );
+        return 1;
+        }
+
+    const char *defaultFolders[3] = { "graphics", "sounds", "languages" };
+
+    const char **folders = defaultFolders;
+    int numFolders = 3;
+
+    if( inNumArgs - firstArg > 2 ) {
+        folders = (const char **)&( inArgs[ firstArg + 2 ] );
+        numFolders = inNumArgs - firstArg - 2;
+        }
+
+
+    SimpleVector<char *> names;
+    SimpleVector<File *> files;
+
+    for( int f=0; f<numFolders; f++ ) {
+        File *folder = gameDir.getChildFile( folders[f] );
+
+        if( folder == NULL || ! folder->exists() ||
+            ! folder->isDirectory() ) {
+            printf( "Folder %s not found, skipping\n", folders[f] );
+            }
+        else {
+            int numBefore = names.size();
+            addFolder( folder, folders[f], 0, &names, &files );
+            printf( "%d files in %s\n", names.size() - numBefore,
+                    folders[f] );
+            }
+
+        if( folder != NULL ) {
+            delete folder;
+            }
+        }
+
+    int numEntries = names.size();
+
+    char **nameArray = names.getElementArray();
+    File **fileArray = files.getElementArray();
+
+    long rawBytes = 0;
+    for( int i=0; i<numEntries; i++ ) {
+        rawBytes += fileArray[i]->getLength();
+        }
+
+    File archiveFile( NULL, inArgs[ firstArg + 1 ] );
+
+    long storedBytes;
+    char written = AssetArchive::writeArchive( &archiveFile, numEntries,
+                                               (const char **)nameArray,
+                                               fileArray, compress,
+                                               &storedBytes );
+
+    int result = 0;
+
+    if( ! written ) {
+        printf( "Failed to write %s\n", inArgs[ firstArg + 1 ] );
+        result = 1;
+        }
+    else {
+        AssetArchive archive( &archiveFile );
+
+        if( ! archive.isOpen() || archive.verify() != 0 ) {
+            printf( "Archive %s failed to verify\n", inArgs[ firstArg + 1 ] );
+            result = 1;
+            }
+        else {
+            printf( "Packed %d files, %ld bytes stored as %ld, into %s "
+                    "(%ld bytes)\n",
+                    numEntries, rawBytes, storedBytes,
+                    inArgs[ firstArg + 1 ], archiveFile.getLength() );
+            }
+        }
+
+    for( int i=0; i<numEntries; i++ ) {
+        delete [] nameArray[i];
+        delete fileArray[i];
+        }
+    delete [] nameArray;
+    delete [] fileArray;
+
+    return result;
+    }
@@ -9,6 +9,13 @@
 #include "minorGems/util/log/AppLog.h"
 #include "minorGems/util/SimpleVector.h"
 
+#include "minorGems/system/Thread.h"
+#include "minorGems/system/MutexLock.h"
+#include "minorGems/system/Semaphore.h"
+
+#define MINIZ_NO_ZLIB_COMPATIBLE_NAMES
+#include "minorGems/formats/miniz.h"
+
 
 #include "minorGems/util/random/JenkinsRandomSource.h"
 
@@ -34,6 +41,12 @@
 #include <sys/stat.h>
 #include <stdlib.h>
 
+#ifdef WIN_32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
 
 static void copyPermissions( char *inSourceFile, char *inDestFile ) {
     struct stat sourceST;
@@ -60,8 +73,6 @@ char isUpdatePlatformSupported() {
 static int webHandle = -1;
 static int updateSize = -1;
 
-static int updateProgressCompleteSteps;
-
 static char *updateServerURL = NULL;
 static int oldVersionNumber;
 
@@ -165,7 +176,6 @@ char startUpdate( char *inUpdateServerURL, int inOldVersionNumber ) {
         }
 
     updateSize = -1;
-    updateProgressCompleteSteps = 0;
     
     updateServerURL = stringDuplicate( inUpdateServerURL );
     oldVersionNumber = inOldVersionNumber;
@@ -187,513 +197,1379 @@ static void dumpRawDataToFile( unsigned char *inRawBundleData,
 
 
 
-// returns 1 on success, -1 on failure
-static int applyUpdateFromWebResult() {
-    // process it, unzip, apply file changes, etc.
-            
-    int size;
-    unsigned char *result = getWebResult( webHandle, &size );
+// An update is applied while it downloads, in three overlapping stages:
+// the main thread takes body bytes from the web request as they arrive,
+// an inflater thread decompresses them and parses the bundle into file
+// operations, and a writer thread carries those out.  Only a few MiB are
+// queued between stages, however large the bundle.
+//
+// Each file is written to a temp file, synced, and renamed into place,
+// so a crash never leaves a half-written file under the real name.  Old
+// and removed files are kept as .bak until the whole update has been
+// written, and put back if any stage fails.  Removed directories are
+// only removed once the update is complete.
 
-    char *nextRawScanPointer = (char*)result;
-            
-    // don't use sscanf here because it scans the entire buffer
-    // (and this buffer has binary data at end)
-    int rawSize = scanIntAndSkip( &nextRawScanPointer );
-    int compSize = scanIntAndSkip( &nextRawScanPointer );
 
-    if( rawSize > 0 && compSize > 0 ) {
-                
-        unsigned char *compData = (unsigned char*)nextRawScanPointer;
-                
-        char *hash = computeSHA1Digest( compData, compSize );
+// queue between main thread and inflater, in compressed bytes
+// the main thread leaves bytes with the web request beyond this
+#define MAX_QUEUED_BODY_BYTES ( 4 * 1024 * 1024 )
+
+// queue between inflater and writer, in file bytes
+// the inflater waits beyond this
+#define MAX_QUEUED_FILE_BYTES ( 8 * 1024 * 1024 )
+
+#define INFLATE_BUFFER_SIZE ( 256 * 1024 )
+
+
+// update operation types
+#define OP_BODY 0
+#define OP_REMOVE_FILE 1
+#define OP_REMOVE_DIR 2
+#define OP_MAKE_DIR 3
+#define OP_BEGIN_FILE 4
+#define OP_FILE_DATA 5
+#define OP_END_FILE 6
+
+
+typedef struct UpdateOp {
+        int type;
+
+        // file or dir name, or NULL
+        char *name;
+
+        // bytes of OP_BODY or OP_FILE_DATA, or NULL
+        unsigned char *data;
+        int length;
+
+        // bundle bytes (uncompressed) parsed through this op
+        int rawEnd;
+    } UpdateOp;
+
+
+static void freeOp( UpdateOp *inOp ) {
+    if( inOp->name != NULL ) {
+        delete [] inOp->name;
+        }
+    if( inOp->data != NULL ) {
+        delete [] inOp->data;
+        }
+    }
+
+
+
+// ops passed from one stage thread to the next
+class UpdateOpQueue {
+    public:
+
+        UpdateOpQueue( int inMaxBytes )
+                : mMaxBytes( inMaxBytes ), mNumBytes( 0 ),
+                  mClosed( false ), mAborted( false ),
+                  mItems( 0 ), mSpace( 0 ) {
+            }
+
+        ~UpdateOpQueue() {
+            for( int i=0; i<mOps.size(); i++ ) {
+                freeOp( mOps.getElement( i ) );
+                }
+            }
+
+        // waits while queue is full, unless inNoWait is set
+        // op is freed instead if queue has been aborted
+        void push( UpdateOp inOp, char inNoWait = false ) {
+            while( true ) {
+                mLock.lock();
+
+                if( mAborted ) {
+                    mLock.unlock();
+                    freeOp( &inOp );
+                    return;
+                    }
+                if( mNumBytes < mMaxBytes || inNoWait ) {
+                    mOps.push_back( inOp );
+                    mNumBytes += inOp.length;
+                    mLock.unlock();
+                    mItems.signal();
+                    return;
+                    }
+
+                mLock.unlock();
+                mSpace.wait();
+                }
+            }
+
+        // true if push won't wait
+        char hasSpace() {
+            mLock.lock();
+            char space = ( mNumBytes < mMaxBytes );
+            mLock.unlock();
+            return space;
+            }
+
+        // waits for next op
+        // returns false once queue is closed and empty, or aborted
+        char pop( UpdateOp *outOp ) {
+            while( true ) {
+                mLock.lock();
+
+                if( mAborted ) {
+                    mLock.unlock();
+                    return false;
+                    }
+                if( mOps.size() > 0 ) {
+                    *outOp = mOps.getElementDirect( 0 );
+                    mOps.deleteElement( 0 );
+                    mNumBytes -= outOp->length;
+                    mLock.unlock();
+                    mSpace.signal();
+                    return true;
+                    }
+                if( mClosed ) {
+                    mLock.unlock();
+                    return false;
+                    }
+
+                mLock.unlock();
+                mItems.wait();
+                }
+            }
+
+        // no more ops will be pushed
+        void close() {
+            mLock.lock();
+            mClosed = true;
+            mLock.unlock();
+            mItems.signal();
+            }
+
+        // wakes both sides, dropping queued and future ops
+        void abort() {
+            mLock.lock();
+            mAborted = true;
+            mLock.unlock();
+            mItems.signal();
+            mSpace.signal();
+            }
+
+    protected:
+        int mMaxBytes;
+        int mNumBytes;
+        char mClosed;
+        char mAborted;
+
+        SimpleVector<UpdateOp> mOps;
+
+        MutexLock mLock;
+        Semaphore mItems;
+        Semaphore mSpace;
+    };
+
+
+
+// reads a decimal int that may arrive a byte at a time, in the form
+// written by diffBundle, and skips the one character after it, as
+// scanIntAndSkip does
+class IntScanner {
+    public:
+
+        IntScanner() {
+            reset();
+            }
+
+        void reset() {
+            mNumDigits = 0;
+            mValue = 0;
+            mNegative = false;
+            }
+
+        // returns 1 when int is complete (inByte skipped),
+        // 0 if more bytes needed, -1 on malformed input
+        int feed( unsigned char inByte ) {
+            if( inByte >= '0' && inByte <= '9' ) {
+                if( mNumDigits >= 10 ) {
+                    return -1;
+                    }
+                mValue = mValue * 10 + ( inByte - '0' );
+                mNumDigits++;
+                return 0;
+                }
+            if( mNumDigits > 0 ) {
+                return 1;
+                }
+            if( inByte == '-' && ! mNegative ) {
+                mNegative = true;
+                return 0;
+                }
+            if( ( inByte == ' ' || inByte == '\n' || inByte == '\r' ||
+                  inByte == '\t' ) && ! mNegative ) {
+                // leading space, as strtol allows
+                return 0;
+                }
+            return -1;
+            }
+
+        int getValue() {
+            if( mNegative ) {
+                return (int)-mValue;
+                }
+            return (int)mValue;
+            }
+
+    protected:
+        int mNumDigits;
+        long mValue;
+        char mNegative;
+    };
+
+
+
+// bundle parser states
+#define PARSE_COUNT 0
+#define PARSE_NAME_LENGTH 1
+#define PARSE_NAME 2
+#define PARSE_FILE_SIZE 3
+#define PARSE_FILE_DATA 4
+#define PARSE_DONE 5
+
+// bundle sections, in order
+#define SECTION_REMOVED_FILES 0
+#define SECTION_REMOVED_DIRS 1
+#define SECTION_DIRS 2
+#define SECTION_FILES 3
+
+
+
+// applies one update as it is fed body bytes
+class StreamedUpdate {
+    public:
+
+        StreamedUpdate( char inConvertTextLineEnds );
+
+        // cancels and rolls back, if not finished
+        ~StreamedUpdate();
+
+        // true if addBodyBytes should be called now
+        char wantsBodyBytes();
+
+        void addBodyBytes( unsigned char *inBytes, int inNumBytes );
+
+        // the whole body has been added
+        void finishBody();
+
+        // stops all stages and rolls back, blocking until done
+        void cancel();
+
+        // 1 if applied, -1 if failed and rolled back, 0 if still working
+        int getResult();
+
+        char wasWriteError();
+
+        // each from 0 to 1
+        void getStageProgress( float *outDecompressed, float *outWritten );
+
+        // stage thread bodies
+        void runInflater();
+        void runWriter();
+
+
+    protected:
+
+        char mConvertTextLineEnds;
+
+        UpdateOpQueue mBodyQueue;
+        UpdateOpQueue mFileQueue;
+
+        Thread *mInflaterThread;
+        Thread *mWriterThread;
+
+        MutexLock mLock;
+
+        // guarded by mLock
+        int mRawSize;
+        int mRawDecompressed;
+        int mRawWritten;
+        char mFailed;
+        char mWriteError;
+        char mCancelled;
+        char mDone;
+
+
+        void fail( char inWriteError );
+        char hasFailed();
+
+
+        // inflater state
+
+        IntScanner mScanner;
+        int mParseState;
+        int mSection;
+        int mNumLeftInSection;
+        int mNameLength;
+        SimpleVector<char> mName;
+        int mFileBytesLeft;
+        int mRawParsed;
+
+        void pushOp( int inType, char *inName,
+                     unsigned char *inData = NULL, int inLength = 0 );
+
+        // returns false on malformed bundle
+        char parse( unsigned char *inBytes, int inNumBytes );
+
+        void finishSection();
+
+
+        // writer state
+
+        // replaced and removed files, moved aside to name.bak
+        SimpleVector<char *> mBackups;
+
+        // removed only once the whole update has been written, since an
+        // emptied directory can't be put back
+        SimpleVector<char *> mRemovedDirs;
+
+        char *mFileName;
+        char *mTempName;
+        FILE *mFile;
+        // NULL unless converting this file's line ends
+        SimpleVector<char> *mTextContents;
+
+        // returns false on write error
+        char apply( UpdateOp *inOp );
+
+        char beginFile( char *inFileName );
+        char writeFileBytes( unsigned char *inBytes, int inNumBytes );
+        char endFile();
+        void abandonFile();
+
+        char backUpRemovedFile( char *inFileName );
+
+        void rollBack();
+        void removeBackups();
+        void removeDirs();
+    };
+
+
+
+class StreamedUpdateStageThread : public Thread {
+    public:
+
+        StreamedUpdateStageThread( StreamedUpdate *inUpdate,
+                                   char inInflater )
+                : mUpdate( inUpdate ), mInflater( inInflater ) {
+            }
+
+        ~StreamedUpdateStageThread() {
+            join();
+            }
+
+        void run() {
+            if( mInflater ) {
+                mUpdate->runInflater();
+                }
+            else {
+                mUpdate->runWriter();
+                }
+            }
+
+    protected:
+        StreamedUpdate *mUpdate;
+        char mInflater;
+    };
+
+
+
+StreamedUpdate::StreamedUpdate( char inConvertTextLineEnds )
+        : mConvertTextLineEnds( inConvertTextLineEnds ),
+          mBodyQueue( MAX_QUEUED_BODY_BYTES ),
+          mFileQueue( MAX_QUEUED_FILE_BYTES ),
+          mRawSize( -1 ), mRawDecompressed( 0 ), mRawWritten( 0 ),
+          mFailed( false ), mWriteError( false ), mCancelled( false ),
+          mDone( false ),
+          mParseState( PARSE_COUNT ), mSection( SECTION_REMOVED_FILES ),
+          mNumLeftInSection( 0 ), mNameLength( 0 ), mFileBytesLeft( 0 ),
+          mRawParsed( 0 ),
+          mFileName( NULL ), mTempName( NULL ), mFile( NULL ),
+          mTextContents( NULL ) {
+
+    mInflaterThread = new StreamedUpdateStageThread( this, true );
+    mWriterThread = new StreamedUpdateStageThread( this, false );
+
+    mInflaterThread->start();
+    mWriterThread->start();
+    }
+
+
+
+StreamedUpdate::~StreamedUpdate() {
+    cancel();
+    }
+
+
+
+char StreamedUpdate::wantsBodyBytes() {
+    return mBodyQueue.hasSpace();
+    }
+
+
+
+void StreamedUpdate::addBodyBytes( unsigned char *inBytes, int inNumBytes ) {
+    if( inNumBytes <= 0 ) {
+        return;
+        }
+
+    UpdateOp op;
+    op.type = OP_BODY;
+    op.name = NULL;
+    op.data = new unsigned char[ inNumBytes ];
+    memcpy( op.data, inBytes, inNumBytes );
+    op.length = inNumBytes;
+    op.rawEnd = 0;
+
+    // main thread never waits, wantsBodyBytes limits what it adds
+    mBodyQueue.push( op, true );
+    }
+
+
+
+void StreamedUpdate::finishBody() {
+    mBodyQueue.close();
+    }
+
+
+
+void StreamedUpdate::cancel() {
+    if( mInflaterThread == NULL ) {
+        return;
+        }
+
+    mLock.lock();
+    mCancelled = true;
+    mLock.unlock();
+
+    mBodyQueue.abort();
+    mFileQueue.abort();
+
+    // joins, writer rolling back if it hadn't finished
+    delete mInflaterThread;
+    delete mWriterThread;
+
+    mInflaterThread = NULL;
+    mWriterThread = NULL;
+    }
+
+
+
+int StreamedUpdate::getResult() {
+    mLock.lock();
+
+    int result = 0;
+    if( mDone ) {
+        result = mFailed ? -1 : 1;
+        }
+
+    mLock.unlock();
+
+    return result;
+    }
+
+
+
+char StreamedUpdate::wasWriteError() {
+    mLock.lock();
+    char error = mWriteError;
+    mLock.unlock();
+    return error;
+    }
+
+
+
+void StreamedUpdate::getStageProgress( float *outDecompressed,
+                                       float *outWritten ) {
+    mLock.lock();
+
+    *outDecompressed = 0;
+    *outWritten = 0;
+
+    if( mRawSize > 0 ) {
+        *outDecompressed = mRawDecompressed / (float)mRawSize;
+        *outWritten = mRawWritten / (float)mRawSize;
+        }
+    if( mDone && ! mFailed ) {
+        *outDecompressed = 1;
+        *outWritten = 1;
+        }
+
+    mLock.unlock();
+    }
+
+
+
+void StreamedUpdate::fail( char inWriteError ) {
+    mLock.lock();
+    mFailed = true;
+    if( inWriteError ) {
+        mWriteError = true;
+        }
+    mLock.unlock();
+
+    // stop other stages early
+    mBodyQueue.abort();
+    mFileQueue.abort();
+    }
+
+
+
+char StreamedUpdate::hasFailed() {
+    mLock.lock();
+    char failed = mFailed || mCancelled;
+    mLock.unlock();
+    return failed;
+    }
+
+
+
+void StreamedUpdate::runInflater() {
+    // body starts with uncompressed and compressed sizes, in text
+    IntScanner headerScanner;
+    int headerInts[2];
+    int numHeaderInts = 0;
+
+    int compSize = 0;
+    int compConsumed = 0;
+
+    mz_stream stream;
+    memset( &stream, 0, sizeof( stream ) );
+
+    char streamStarted = false;
+    int inflateStatus = MZ_OK;
+
+    SHA_CTX shaContext;
+    SHA1_Init( &shaContext );
+
+    unsigned char *outBuffer = new unsigned char[ INFLATE_BUFFER_SIZE ];
+
+    char malformed = false;
+
+    UpdateOp op;
+
+    while( ! malformed && inflateStatus != MZ_STREAM_END &&
+           mBodyQueue.pop( &op ) ) {
+
+        unsigned char *data = op.data;
+        int length = op.length;
+
+        while( numHeaderInts < 2 && length > 0 && ! malformed ) {
+            int scanned = headerScanner.feed( data[0] );
+            data++;
+            length--;
+
+            if( scanned == -1 ) {
+                malformed = true;
+                }
+            else if( scanned == 1 ) {
+                headerInts[ numHeaderInts++ ] = headerScanner.getValue();
+                headerScanner.reset();
+
+                if( numHeaderInts == 2 ) {
+                    if( headerInts[0] <= 0 || headerInts[1] <= 0 ) {
+                        malformed = true;
+                        }
+                    else {
+                        mLock.lock();
+                        mRawSize = headerInts[0];
+                        mLock.unlock();
+
+                        compSize = headerInts[1];
+
+                        printf( "Receiving update bundle, %d bytes "
+                                "compressed, %d bytes raw\n",
+                                compSize, headerInts[0] );
+
+                        streamStarted = ( mz_inflateInit( &stream ) ==
+                                          MZ_OK );
+                        if( ! streamStarted ) {
+                            malformed = true;
+                            }
+                        }
+                    }
+                }
+            }
+
+        if( length > compSize - compConsumed ) {
+            // trailing bytes after compressed data
+            length = compSize - compConsumed;
+            }
+
+        if( length > 0 && ! malformed ) {
+            SHA1_Update( &shaContext, data, length );
+            compConsumed += length;
+
+            stream.next_in = data;
+            stream.avail_in = length;
+
+            // also drain output left over when buffer filled last time
+            char outputFull = true;
+
+            while( ( stream.avail_in > 0 || outputFull ) &&
+                   inflateStatus != MZ_STREAM_END && ! malformed ) {
+
+                stream.next_out = outBuffer;
+                stream.avail_out = INFLATE_BUFFER_SIZE;
 
+                inflateStatus = mz_inflate( &stream, MZ_NO_FLUSH );
+
+                int numOut = INFLATE_BUFFER_SIZE - stream.avail_out;
+                outputFull = ( stream.avail_out == 0 );
+
+                if( inflateStatus != MZ_OK &&
+                    inflateStatus != MZ_STREAM_END &&
+                    inflateStatus != MZ_BUF_ERROR ) {
+                    printf( "Failed to decompress diff bundle\n" );
+                    malformed = true;
+                    }
+                else if( numOut > 0 ) {
+                    mLock.lock();
+                    mRawDecompressed += numOut;
+                    mLock.unlock();
+
+                    if( ! parse( outBuffer, numOut ) ) {
+                        printf( "Failed to parse diff bundle\n" );
+                        dumpRawDataToFile( outBuffer, numOut );
+                        malformed = true;
+                        }
+                    }
+                else if( inflateStatus == MZ_BUF_ERROR ) {
+                    // needs more input
+                    break;
+                    }
+                }
+            }
+
+        freeOp( &op );
+        }
+
+    delete [] outBuffer;
+
+    if( streamStarted ) {
+        mz_inflateEnd( &stream );
+        }
+
+    if( ! malformed && ! hasFailed() ) {
+        if( inflateStatus != MZ_STREAM_END ||
+            (int)stream.total_out != mRawSize ||
+            mParseState != PARSE_DONE ) {
+            printf( "Diff bundle ended early\n" );
+            malformed = true;
+            }
+        }
+
+    if( compConsumed > 0 ) {
+        unsigned char digest[ SHA1_DIGEST_LENGTH ];
+        SHA1_Final( digest, &shaContext );
+
+        char *hash = hexEncode( digest, SHA1_DIGEST_LENGTH );
         AppLog::infoF( "Received compressed data with SHA1 = %s\n",
                        hash );
         delete [] hash;
+        }
 
-        unsigned char *rawData = 
-            zipDecompress( compData,
-                           compSize,
-                           rawSize );
+    if( malformed ) {
+        fail( false );
+        }
 
-        delete [] result;
-                
+    // drop any bytes past the end of the compressed data
+    mBodyQueue.abort();
 
-        if( rawData == NULL ) {
-            printf( "Failed to decompress diff bundle\n" );
-            return -1;
+    mFileQueue.close();
+    }
+
+
+
+void StreamedUpdate::pushOp( int inType, char *inName,
+                             unsigned char *inData, int inLength ) {
+    UpdateOp op;
+    op.type = inType;
+    op.name = inName;
+    op.data = inData;
+    op.length = inLength;
+    op.rawEnd = mRawParsed;
+
+    mFileQueue.push( op );
+    }
+
+
+
+void StreamedUpdate::finishSection() {
+    while( mNumLeftInSection == 0 && mParseState != PARSE_DONE ) {
+        if( mSection == SECTION_FILES ) {
+            mParseState = PARSE_DONE;
+            }
+        else {
+            mSection++;
+            mParseState = PARSE_COUNT;
+            // count for next section not read yet
+            mNumLeftInSection = -1;
+            }
+        }
+    }
+
+
+
+char StreamedUpdate::parse( unsigned char *inBytes, int inNumBytes ) {
+    int i = 0;
+
+    while( i < inNumBytes ) {
+
+        switch( mParseState ) {
+
+            case PARSE_COUNT:
+            case PARSE_NAME_LENGTH:
+            case PARSE_FILE_SIZE: {
+                int scanned = mScanner.feed( inBytes[i] );
+                i++;
+                mRawParsed++;
+
+                if( scanned == -1 ) {
+                    return false;
+                    }
+                if( scanned == 0 ) {
+                    break;
+                    }
+
+                int value = mScanner.getValue();
+                mScanner.reset();
+
+                if( value < 0 ) {
+                    return false;
+                    }
+
+                if( mParseState == PARSE_COUNT ) {
+                    const char *sectionNames[4] =
+                        { "Removing %d files\n", "Removing %d dirs\n",
+                          "Creating %d new directories\n",
+                          "Updating %d files\n" };
+                    printf( sectionNames[ mSection ], value );
+
+                    mNumLeftInSection = value;
+                    mParseState = PARSE_NAME_LENGTH;
+                    finishSection();
+                    }
+                else if( mParseState == PARSE_NAME_LENGTH ) {
+                    mNameLength = value;
+                    mName.deleteAll();
+                    mParseState = PARSE_NAME;
+                    }
+                else {
+                    mFileBytesLeft = value;
+
+                    pushOp( OP_BEGIN_FILE, mName.getElementString() );
+
+                    mParseState = PARSE_FILE_DATA;
+
+                    if( mFileBytesLeft == 0 ) {
+                        pushOp( OP_END_FILE, NULL );
+                        mNumLeftInSection--;
+                        mParseState = PARSE_NAME_LENGTH;
+                        finishSection();
+                        }
+                    }
+                break;
+                }
+
+            case PARSE_NAME: {
+                // name, then one separator character
+                int numWanted = mNameLength + 1 - mName.size();
+                int numTaken = inNumBytes - i;
+                if( numTaken > numWanted ) {
+                    numTaken = numWanted;
+                    }
+
+                mName.appendArray( (char*)&( inBytes[i] ), numTaken );
+                i += numTaken;
+                mRawParsed += numTaken;
+
+                if( mName.size() < mNameLength + 1 ) {
+                    break;
+                    }
+
+                // drop separator
+                mName.deleteElement( mNameLength );
+
+                if( mSection == SECTION_FILES ) {
+                    mParseState = PARSE_FILE_SIZE;
+                    break;
+                    }
+
+                int types[3] = { OP_REMOVE_FILE, OP_REMOVE_DIR,
+                                 OP_MAKE_DIR };
+
+                pushOp( types[ mSection ], mName.getElementString() );
+
+                mNumLeftInSection--;
+                mParseState = PARSE_NAME_LENGTH;
+                finishSection();
+                break;
+                }
+
+            case PARSE_FILE_DATA: {
+                int numTaken = inNumBytes - i;
+                if( numTaken > mFileBytesLeft ) {
+                    numTaken = mFileBytesLeft;
+                    }
+
+                unsigned char *data = new unsigned char[ numTaken ];
+                memcpy( data, &( inBytes[i] ), numTaken );
+
+                i += numTaken;
+                mRawParsed += numTaken;
+                mFileBytesLeft -= numTaken;
+
+                pushOp( OP_FILE_DATA, NULL, data, numTaken );
+
+                if( mFileBytesLeft == 0 ) {
+                    pushOp( OP_END_FILE, NULL );
+                    mNumLeftInSection--;
+                    mParseState = PARSE_NAME_LENGTH;
+                    finishSection();
+                    }
+                break;
+                }
+
+            case PARSE_DONE:
+                // bytes after the last file, ignored as before
+                mRawParsed += inNumBytes - i;
+                i = inNumBytes;
+                break;
+            }
+        }
+
+    return true;
+    }
+
+
+
+void StreamedUpdate::runWriter() {
+    char ok = true;
+
+    UpdateOp op;
+
+    while( mFileQueue.pop( &op ) ) {
+        if( ok ) {
+            ok = apply( &op );
+
+            if( ! ok ) {
+                fail( true );
+                }
+            else {
+                mLock.lock();
+                mRawWritten = op.rawEnd;
+                mLock.unlock();
+                }
             }
+        freeOp( &op );
+        }
+
+    if( mFile != NULL ) {
+        // stopped part way through a file
+        abandonFile();
+        }
+
+    if( hasFailed() ) {
+        mLock.lock();
+        // a cancel counts as a failure
+        mFailed = true;
+        mLock.unlock();
+
+        rollBack();
+        printf( "Update failed, rolled back\n" );
+        }
+    else {
+        removeBackups();
+        removeDirs();
+        printf( "Update complete\n" );
+        }
+
+    mRemovedDirs.deallocateStringElements();
+
+    mLock.lock();
+    mDone = true;
+    mLock.unlock();
+    }
+
+
+
+char StreamedUpdate::apply( UpdateOp *inOp ) {
+    char *fileName = inOp->name;
+
+    switch( inOp->type ) {
+        case OP_REMOVE_FILE: {
+            printf( "   removing %s\n", fileName );
+
+            File fileToRemove( NULL, fileName );
 
-                                
-        char *nextScanPointer = (char*)rawData;
-        char success;
+            if( fileToRemove.exists() && ! fileToRemove.isDirectory() ) {
+                // kept until update is complete, in case it fails
+                return backUpRemovedFile( fileName );
+                }
+            return true;
+            }
+
+        case OP_REMOVE_DIR:
+            // dir name now belongs to writer
+            inOp->name = NULL;
+            mRemovedDirs.push_back( fileName );
+            return true;
+
+        case OP_MAKE_DIR: {
+            printf( "   creating %s\n", fileName );
+
+            File dirFile( NULL, fileName );
+
+            if( dirFile.exists() ) {
+                printf( "Directory exists %s\n", fileName );
+                }
+            else if( ! Directory::makeDirectory( &dirFile ) ) {
+                printf( "Failed to make directory %s\n", fileName );
+                return false;
+                }
+            return true;
+            }
+
+        case OP_BEGIN_FILE:
+            // file name now belongs to writer
+            inOp->name = NULL;
+            return beginFile( fileName );
+
+        case OP_FILE_DATA:
+            return writeFileBytes( inOp->data, inOp->length );
+
+        case OP_END_FILE:
+            return endFile();
+        }
+
+    return true;
+    }
+
+
+
+char StreamedUpdate::beginFile( char *inFileName ) {
+    printf( "   %s\n", inFileName );
+
+    mFileName = inFileName;
+    mTempName = autoSprintf( "%s.dbtmp", inFileName );
+
+    if( strstr( inFileName, "/" ) != NULL ) {
+        // file name contains a path
+        
+        // make sure the dir exists
+        char *dirName = stringDuplicate( inFileName );
+        
+        // find last / and terminate there to get dir name
+        int len = strlen( dirName );
+        for( int i=len-1; i>=0; i-- ) {
+            if( dirName[i] == '/' ) {
+                dirName[i] = '\0';
+                break;
+                }
+            }
+        File dirFile( NULL, dirName );
+        
+        if( ! dirFile.exists() ) {
+            printf( "Making necessary directory %s for "
+                    "new file %s\n",
+                    dirName, inFileName );
+            
+            if( ! Directory::makeDirectory( &dirFile ) ) {
+                printf( "Failed to make directory %s\n", dirName );
+                delete [] dirName;
+                return false;
+                }
+            }
+        delete [] dirName;
+        }
+
+    mFile = fopen( mTempName, "wb" );
+
+    if( mFile == NULL ) {
+        printf( "Failed to open file %s for writing\n", mTempName );
+        return false;
+        }
+
+    if( mConvertTextLineEnds && strstr( inFileName, ".txt" ) != NULL ) {
+        // whether to convert depends on the whole file
+        mTextContents = new SimpleVector<char>();
+        }
+
+    return true;
+    }
+
+
+
+char StreamedUpdate::writeFileBytes( unsigned char *inBytes,
+                                     int inNumBytes ) {
+    if( mTextContents != NULL ) {
+        mTextContents->appendArray( (char*)inBytes, inNumBytes );
+        return true;
+        }
+
+    int numWritten = fwrite( inBytes, 1, inNumBytes, mFile );
+
+    if( numWritten != inNumBytes ) {
+        printf( "Failed to write %d bytes to file  %s\n",
+                inNumBytes, mTempName );
+        return false;
+        }
+    return true;
+    }
+
+
+
+// moves inTempName into place as inFileName
+// an existing file is kept as a backup, added to ioBackups, unless a
+// backup already exists
+static char replaceFile( char *inFileName, char *inTempName,
+                         SimpleVector<char*> *ioBackups ) {
+    File targetFile( NULL, inFileName );
+
+    char *backupName = NULL;
+
+    if( targetFile.exists() ) {
+        backupName = autoSprintf( "%s.bak", inFileName );
+
+        File backFile( NULL, backupName );
+
+        if( backFile.exists() ) {
+            printf( "Backup file %s already exists, skipping backup\n",
+                    backupName );
+            delete [] backupName;
+            backupName = NULL;
+#ifdef WIN_32
+            // rename won't replace a file here
+            remove( inFileName );
+#endif
+            }
+        else {
+            char backedUp = false;
+
+#ifndef WIN_32
+            // a second name for the old file, so the rename below can
+            // replace it in one step
+            backedUp = ( link( inFileName, backupName ) == 0 );
+#endif
+            if( ! backedUp ) {
+                backedUp = ( rename( inFileName, backupName ) == 0 );
+                }
+
+            if( ! backedUp ) {
+                printf( "Moving backup to %s failed\n", backupName );
+                delete [] backupName;
+                return false;
+                }
+
+            ioBackups->push_back( backupName );
+            }
+        }
+
+    if( rename( inTempName, inFileName ) != 0 ) {
+        printf( "Moving %s into place failed\n", inTempName );
+        return false;
+        }
+
+    if( backupName != NULL ) {
+        copyPermissions( backupName, inFileName );
+        }
+    else {
+        // try to set permissions manually on mac for main app exe
+        if( strcmp( PLATFORM_CODE, "mac" ) == 0 ) {
+            if( strstr( inFileName, "Contents/MacOS/" ) != NULL ) {
+                const char *mode = "0755";
+                int modeInt = strtol( mode, 0, 8 );
+                chmod( inFileName, modeInt );
+                }
+            }
+        }
+
+    return true;
+    }
+
+
+
+char StreamedUpdate::endFile() {
+    char ok = true;
+
+    if( mTextContents != NULL ) {
+        char *contents = mTextContents->getElementString();
+        
+        delete mTextContents;
+        mTextContents = NULL;
+        
+        if( strstr( contents, "\n" ) != NULL &&
+            strstr( contents, "\r\n" ) == NULL ) {
+            // contains at least one unix-style line ending
+            // and no \r, which is part of windows \r\n
+            // and other platforms, or ill-formed, line endings
+
+            // replaceAll too slow in this case
+            // some files have 20k + newlines to replace
+            SimpleVector<char> newContents;
+            
+            int oldLen = strlen( contents );
+            
+            for( int i=0; i<oldLen; i++ ) {
+                if( contents[i] == '\n' ) {
+                    newContents.push_back( '\r' );
+                    newContents.push_back( '\n' );
+                    }
+                else {
+                    newContents.push_back( contents[i] );
+                    }
+                }
+            
+            delete [] contents;
+            contents = newContents.getElementString();
+            }
+
+        ok = writeFileBytes( (unsigned char*)contents, strlen( contents ) );
+        
+        delete [] contents;
+        }
+
+    if( ok && fflush( mFile ) != 0 ) {
+        ok = false;
+        }
+
+    if( ok ) {
+        // on disk before it replaces the old file
+#ifdef WIN_32
+        _commit( _fileno( mFile ) );
+#else
+        fsync( fileno( mFile ) );
+#endif
+        }
+
+    if( fclose( mFile ) != 0 ) {
+        ok = false;
+        }
+    mFile = NULL;
+
+    if( ok ) {
+        ok = replaceFile( mFileName, mTempName, &mBackups );
+        }
+
+    if( ! ok ) {
+        remove( mTempName );
+        }
 
+    delete [] mFileName;
+    delete [] mTempName;
+    mFileName = NULL;
+    mTempName = NULL;
 
+    return ok;
+    }
 
 
-        
-        int numRemovedFiles = scanIntAndSkip( &nextScanPointer, &success );
-                    
-        if( !success ) {
-            printf( "Failed to parse removed file count from diff bundle\n" );
-            dumpRawDataToFile( rawData, rawSize );
-            delete [] rawData;
-            return -1;
-            }
 
-        printf( "Removing %d files\n", numRemovedFiles );
-                
-        for( int d=0; d<numRemovedFiles; d++ ) {
-                    
-            int fileNameLength = 
-                scanIntAndSkip( &nextScanPointer, &success );
-                    
-            if( !success ) {
-                printf( "Failed to parse removed file name length "
-                        "from diff bundle\n" );
-                dumpRawDataToFile( rawData, rawSize );
-                delete [] rawData;
-                return -1;
-                }
-                    
-            char *fileName = new char[ fileNameLength + 1 ];
-                    
-            memcpy( fileName, nextScanPointer, fileNameLength );
-                    
-            fileName[ fileNameLength ] = '\0';
-                    
-            printf( "   %s\n", fileName );
-                    
+void StreamedUpdate::abandonFile() {
+    fclose( mFile );
+    mFile = NULL;
 
-            nextScanPointer = 
-                &( nextScanPointer[ fileNameLength + 1 ] );
-                    
-            File fileToRemove( NULL, fileName );
+    remove( mTempName );
 
-            if( fileToRemove.exists() && ! fileToRemove.isDirectory() ) {
-                
-                fileToRemove.remove();
-                }
-                    
-                    
-            delete [] fileName;
-            }
+    if( mTextContents != NULL ) {
+        delete mTextContents;
+        mTextContents = NULL;
+        }
 
+    delete [] mFileName;
+    delete [] mTempName;
+    mFileName = NULL;
+    mTempName = NULL;
+    }
 
 
-        int numRemovedDirs = scanIntAndSkip( &nextScanPointer, &success );
-                    
-        if( !success ) {
-            printf( "Failed to parse removed file count from diff bundle\n" );
-            dumpRawDataToFile( rawData, rawSize );
-            delete [] rawData;
-            return -1;
-            }
 
-        printf( "Removing %d dirs\n", numRemovedDirs );
-                
-        for( int d=0; d<numRemovedDirs; d++ ) {
-                    
-            int fileNameLength = 
-                scanIntAndSkip( &nextScanPointer, &success );
-                    
-            if( !success ) {
-                printf( "Failed to parse removed dir name length "
-                        "from diff bundle\n" );
-                dumpRawDataToFile( rawData, rawSize );
-                delete [] rawData;
-                return -1;
-                }
-                    
-            char *fileName = new char[ fileNameLength + 1 ];
-                    
-            memcpy( fileName, nextScanPointer, fileNameLength );
-                    
-            fileName[ fileNameLength ] = '\0';
-                    
-            printf( "   %s\n", fileName );
-                    
+char StreamedUpdate::backUpRemovedFile( char *inFileName ) {
+    char *backupName = autoSprintf( "%s.bak", inFileName );
 
-            nextScanPointer = 
-                &( nextScanPointer[ fileNameLength + 1 ] );
-                    
-            File dirToRemove( NULL, fileName );
+    File backFile( NULL, backupName );
 
-            if( dirToRemove.exists() && dirToRemove.isDirectory() ) {
-                
-                dirToRemove.remove();
-                }
-                    
-                    
-            delete [] fileName;
-            }
+    if( backFile.exists() ) {
+        // left by an earlier update that couldn't remove it
+        printf( "Replacing old backup file %s\n", backupName );
+        remove( backupName );
+        }
 
+    if( rename( inFileName, backupName ) != 0 ) {
+        printf( "Moving %s to %s failed\n", inFileName, backupName );
+        delete [] backupName;
+        return false;
+        }
 
+    mBackups.push_back( backupName );
 
+    return true;
+    }
 
 
 
+void StreamedUpdate::rollBack() {
+    // restore from backups if possible
+    
+    for( int i=0; i<mBackups.size(); i++ ) {
+        char *backName = mBackups.getElementDirect( i );
+        char *origName = stringDuplicate( backName );
+        
+        // drop .bak
+        origName[ strlen( origName ) - 4 ] = '\0';
+        
+        printf( "Trying to restore %s from %s\n",
+                origName, backName );
+        
+        File origFile( NULL, origName );
+        
+        // removed files have nothing in their place
+        if( origFile.exists() && remove( origName ) != 0 ) {
+            printf( "    Failed to remove %s\n", origName );
+            }
+        if( rename( backName, origName ) != 0 ) {
+            printf( "    Failed to move %s to %s\n", 
+                    backName, origName );
+            }
+        delete [] origName;
+        }
 
+    mBackups.deallocateStringElements();
+    }
 
 
 
-                
-        int numDirs = scanIntAndSkip( &nextScanPointer, &success );
-                    
-        if( !success ) {
-            printf( "Failed to parse dir count from diff bundle\n" );
-            dumpRawDataToFile( rawData, rawSize );
-            delete [] rawData;
-            return -1;
+void StreamedUpdate::removeBackups() {
+    // remove backup files if we can
+    
+    for( int i=0; i<mBackups.size(); i++ ) {
+        char *backName = mBackups.getElementDirect( i );
+        
+        if( remove( backName ) != 0 ) {
+            // can't remove
+            // save on list to remove later if postUpdate called
+            // (if postUpdate not call, just leave them)
+            FILE *postRemoveListFile =
+                fopen( "postRemoveList.txt", "a" );
+            if( postRemoveListFile != NULL ) {    
+                fprintf( postRemoveListFile, 
+                         "%s\n", backName );
+                fclose( postRemoveListFile );
+                }
             }
+        }
+    
+    mBackups.deallocateStringElements();
+    }
 
-        printf( "Creating %d new directories\n", numDirs );
-                
-        for( int d=0; d<numDirs; d++ ) {
-                    
-            int fileNameLength = 
-                scanIntAndSkip( &nextScanPointer, &success );
-                    
-            if( !success ) {
-                printf( "Failed to parse directory name length "
-                        "from diff bundle\n" );
-                dumpRawDataToFile( rawData, rawSize );
-                delete [] rawData;
-                return -1;
-                }
-                    
-            char *fileName = new char[ fileNameLength + 1 ];
-                    
-            memcpy( fileName, nextScanPointer, fileNameLength );
-                    
-            fileName[ fileNameLength ] = '\0';
-                    
-            printf( "   %s\n", fileName );
-                    
 
-            nextScanPointer = 
-                &( nextScanPointer[ fileNameLength + 1 ] );
-                    
-            File dirFile( NULL, fileName );
 
-            if( dirFile.exists() ) {
-                printf( "Directory exists %s\n",
-                        fileName );
-                }
-            else {
-                char made = Directory::makeDirectory( &dirFile );
-                    
-                if( !made ) {
-                    printf( "Failed to make directory %s\n",
-                            fileName );
-                            
-                    delete [] fileName;
-                            
-                    dumpRawDataToFile( rawData, rawSize );
-                    delete [] rawData;
-                    return -1;
-                    }
-                }
-                    
-                    
-            delete [] fileName;
-            }
-                
+void StreamedUpdate::removeDirs() {
+    // last first, so subdirectories go before their parents
+    for( int i=mRemovedDirs.size() - 1; i>=0; i-- ) {
+        char *dirName = mRemovedDirs.getElementDirect( i );
 
+        printf( "   removing %s\n", dirName );
 
-        int numFiles = scanIntAndSkip( &nextScanPointer, &success );
+        File dirToRemove( NULL, dirName );
 
-        if( !success ) {
-            printf( "Failed to parse file count from diff bundle\n" );
-                    
-            dumpRawDataToFile( rawData, rawSize );
-            delete [] rawData;
-            return -1;
-            }                
+        if( dirToRemove.exists() && dirToRemove.isDirectory() ) {
+            dirToRemove.remove();
+            }
+        }
+    }
 
-        printf( "Updating %d files\n", numFiles );
-        
-        char fileCreationFailed = false;
-        
-        SimpleVector<char*> backupList;
 
-        for( int f=0; f<numFiles; f++ ) {
-                    
-            int fileNameLength =
-                scanIntAndSkip( &nextScanPointer, &success );
-                    
-            if( !success ) {
-                printf( "Failed to parse file name length "
-                        "from diff bundle\n" );
-                        
-                dumpRawDataToFile( rawData, rawSize );
-                delete [] rawData;
-                return -1;
-                }
-                    
-            char *fileName = new char[ fileNameLength + 1 ];
-                    
-            memcpy( fileName, nextScanPointer, fileNameLength );
-                    
-            fileName[ fileNameLength ] = '\0';
-                    
-            printf( "   %s\n", fileName );
 
-            nextScanPointer = 
-                &( nextScanPointer[ fileNameLength + 1 ] );
+static StreamedUpdate *streamedUpdate = NULL;
 
-            // single # separates the file size from the file data
-            // this skips it
-            int fileSize = 
-                scanIntAndSkip( &nextScanPointer, &success );
-                    
-            if( !success ) {
-                printf( "Failed to parse file size "
-                        "from diff bundle\n" );
-                delete [] fileName;
-                        
-                dumpRawDataToFile( rawData, rawSize );
-                delete [] rawData;
-                return -1;
-                }
-                    
+// true once the whole body has been handed to streamedUpdate
+static char streamedBodyDone = false;
 
-            File targetFile( NULL, fileName );
+// 1 once the current update has been applied, -1 if it failed
+static int streamedResult = 0;
 
-            char *backupName = NULL;
-                    
-            if( targetFile.exists() ) {
-                backupName = autoSprintf( "%s.bak", fileName );
 
-                printf( "File %s exists, moving temporariliy to %s\n",
-                        fileName, backupName );
-                
-                File backFile( NULL, backupName );
-                
-                if( backFile.exists() ) {
-                    printf( "Backup file %s already exists, skipping move\n",
-                            backupName );
-                    }
-                else {
-                    int result = rename( fileName, backupName );
-                
-                    if( result != 0 ) {
-                        printf( "Moving backup to %s failed\n",
-                                backupName );
-                        fileCreationFailed = true;
-                        delete [] fileName;
-                        delete [] backupName;
-                        printf( "Ending update process\n" );
-                        break;
-                        }
-                    else {
-                        backupList.push_back( stringDuplicate( backupName ) );
-                        }
-                    }
-                }
-            else {
-                if( strstr( fileName, "/" ) != NULL ) {
-                    // file name contains a path
-                    
-                    // make sure the dir exists
-                    char *dirName = stringDuplicate( fileName );
-                    
-                    // find last / and terminate there to get dir name
-                    int len = strlen( dirName );
-                    for( int i=len-1; i>=0; i-- ) {
-                        if( dirName[i] == '/' ) {
-                            dirName[i] = '\0';
-                            break;
-                            }
-                        }
-                    File dirFile( NULL, dirName );
-                    
-                    if( ! dirFile.exists() ) {
-                        printf( "Making necessary directory %s for "
-                                "new file %s\n",
-                                dirName, fileName );
-                        
-                        char made = Directory::makeDirectory( &dirFile );
-                    
-                        if( !made ) {
-                            printf( "Failed to make directory %s\n",
-                                    dirName );
-                            
-                            delete [] dirName;
-                            printf( "Ending update process\n" );
-                            fileCreationFailed = true;
-                            break;
-                            }
-                        }
-                    delete [] dirName;
-                    }
-                
-                }
-            
+static void startStreamedUpdate() {
+    streamedUpdate = new StreamedUpdate( currentUpdateUniversal &&
+                                         WINDOWS_LINE_ENDS );
+    streamedBodyDone = false;
+    streamedResult = 0;
+    }
 
-            FILE *file = fopen( fileName, "wb" );
-                    
-                    
-            if( file == NULL ) {
-                printf( "Failed to open file %s for writing\n",
-                        fileName );
-                fileCreationFailed = true;
-                delete [] fileName;
-                if( backupName != NULL ) {
-                    delete [] backupName;
-                    }
-                printf( "Ending update process\n" );
-                break;
-                }
-            else {
-                int numWritten = 
-                    fwrite( (unsigned char *)nextScanPointer, 
-                            1, fileSize, file );
-                if( numWritten != fileSize ) {
-                    printf( "Failed to write %d bytes to file  %s\n",
-                            fileSize, fileName );
-                    }
-                        
-                fclose( file );
-                }
-                    
-                    
-            if( backupName != NULL ) {
-                copyPermissions( backupName, fileName );                        
-                        
-                delete [] backupName;
-                }
-            else {
-                // try to set permissions manually on mac for main app exe
-                if( strcmp( PLATFORM_CODE, "mac" ) == 0 ) {
-                    if( strstr( fileName, "Contents/MacOS/" ) != NULL ) {
-                        const char *mode = "0755";
-                        int modeInt = strtol( mode, 0, 8 );
-                        chmod( fileName, modeInt );
-                        }
-                    }
-                }
-            
 
-            if( currentUpdateUniversal &&
-                WINDOWS_LINE_ENDS &&
-                strstr( fileName, ".txt" ) != NULL ) {
-                char *contents = targetFile.readFileContents();
-                
-                if( contents != NULL ) {
-                    
-                    if( strstr( contents, "\n" ) != NULL &&
-                        strstr( contents, "\r\n" ) == NULL ) {
-                        // contains at least one unix-style line ending
-                        // and no \r, which is part of windows \r\n
-                        // and other platforms, or ill-formed, line endings
 
+static void endStreamedUpdate() {
+    if( streamedUpdate != NULL ) {
+        // rolls back if not finished
+        delete streamedUpdate;
+        streamedUpdate = NULL;
+        }
+    }
 
-                        // replaceAll too slow in this case
-                        // some files have 20k + newlines to replace
-                        SimpleVector<char> newContents;
-                        
-                        int oldLen = strlen( contents );
-                        
-                        for( int i=0; i<oldLen; i++ ) {
-                            if( contents[i] == '\n' ) {
-                                newContents.push_back( '\r' );
-                                newContents.push_back( '\n' );
-                                }
-                            else {
-                                newContents.push_back( contents[i] );
-                                }
-                            }
-                        
-                        char *convertedContents = 
-                            newContents.getElementString();
-                        
-                        targetFile.writeToFile( convertedContents );
-                        
-                        delete [] convertedContents;
-                        }
-                    delete [] contents;
-                    }
-                }
 
-            delete [] fileName;
 
-                
-            nextScanPointer = &( nextScanPointer[ fileSize ] );
-            }
-        
-        if( fileCreationFailed ) {
-            writeError = true;
-            
-            // restore from backups if possible
-            
-            
-            for( int i=0; i<backupList.size(); i++ ) {
-                char *backName = backupList.getElementDirect( i );
-                char *origName = stringDuplicate( backName );
-                
-                char *bakStart = strstr( origName, ".bak" );
-                
-                if( bakStart != NULL ) {
-                    bakStart[0] = '\0';
-                    }
-                
-                printf( "Trying to restore %s from %s\n",
-                        origName, backName );
-                       
-                if( remove( origName ) != 0 ) {
-                    printf( "    Failed to remove %s\n", origName );
-                    }
-                if( rename( backName, origName ) != 0 ) {
-                    printf( "    Failed to move %s to %s\n", 
-                            backName, origName );
-                    }
-                delete [] origName;
-                }
+// passes update body bytes along from webHandle
+// inWebResult is the latest stepWebRequest result, ignored once the whole
+// body has been passed
+// returns 1 if applied, -1 on failure (rolled back), 0 if in progress
+static int stepStreamedUpdate( int inWebResult ) {
+    if( streamedUpdate == NULL ) {
+        // already finished
+        return streamedResult;
+        }
 
-            backupList.deallocateStringElements();
-            
+    if( ! streamedBodyDone ) {
+        if( inWebResult == -1 ) {
+            endStreamedUpdate();
+            streamedResult = -1;
             return -1;
             }
-        
 
-        // success
-        // remove backup files if we can
-        
-        for( int i=0; i<backupList.size(); i++ ) {
-            char *backName = backupList.getElementDirect( i );
-            
-            if( remove( backName ) != 0 ) {
-                // can't remove
-                // save on list to remove later if postUpdate called
-                // (if postUpdate not call, just leave them)
-                FILE *postRemoveListFile =
-                    fopen( "postRemoveList.txt", "a" );
-                if( postRemoveListFile != NULL ) {    
-                    fprintf( postRemoveListFile, 
-                             "%s\n", backName );
-                    fclose( postRemoveListFile );
-                    }
+        unsigned char buffer[ 65536 ];
+
+        while( streamedUpdate->wantsBodyBytes() ) {
+            int numTaken = takeWebResultBytes( webHandle, buffer,
+                                               sizeof( buffer ) );
+            if( numTaken == 0 ) {
+                break;
                 }
+            streamedUpdate->addBodyBytes( buffer, numTaken );
             }
-        
-        backupList.deallocateStringElements();
 
+        if( inWebResult == 1 ) {
+            printf( "Update download complete\n" );
+
+            // whatever wasn't taken above
+            int size;
+            unsigned char *rest = getWebResult( webHandle, &size );
 
-                
-        delete [] rawData;
-        printf( "Update complete\n" );
-        return 1;
+            if( rest != NULL ) {
+                streamedUpdate->addBodyBytes( rest, size );
+                delete [] rest;
+                }
+
+            streamedUpdate->finishBody();
+            streamedBodyDone = true;
+            }
         }
-    else {
-        printf( "Failed to parse diff bundle\n" );
-        delete [] result;
-        return -1;
+
+    int result = streamedUpdate->getResult();
+
+    if( result != 0 ) {
+        writeError = streamedUpdate->wasWriteError();
+        endStreamedUpdate();
+        streamedResult = result;
         }
 
+    return result;
     }
 
-    
+
 
 
 static int batchMirrorStep() {
@@ -702,19 +1578,24 @@ static int batchMirrorStep() {
         
         if( webHandle != -1 ) {
             
-            int result = stepWebRequest( webHandle );
+            int result = 0;
+            
+            if( ! streamedBodyDone ) {
+                result = stepWebRequest( webHandle );
+                }
+
+            result = stepStreamedUpdate( result );
 
             if( result == 1 ) {
-                result = applyUpdateFromWebResult();
-                
                 clearWebRequest( webHandle );
                 webHandle = -1;
             
-                if( result == 1 ) {
-                    // start next step on next step() call
-                    batchStepsDone ++;
-                    return 0;
-                    }
+                // start next step on next step() call
+                batchStepsDone ++;
+
+                // now counted in batchStepsDone
+                streamedResult = 0;
+                return 0;
                 }
             
             if( result == -1 ) {
@@ -771,6 +1652,8 @@ static int batchMirrorStep() {
                         NULL );
                 
                 updateSize = list->size;
+
+                startStreamedUpdate();
                 return 0;
                 }
             else {
@@ -798,6 +1681,17 @@ int stepUpdate() {
         return batchMirrorStep();
         }
 
+    if( updateSize != -1 ) {
+        // fetching update itself, applying it as it arrives
+        int result = 0;
+
+        if( ! streamedBodyDone ) {
+            result = stepWebRequest( webHandle );
+            }
+        
+        return stepStreamedUpdate( result );
+        }
+
     int result = stepWebRequest( webHandle );
 
     if( result == 1 ) {
@@ -922,70 +1816,69 @@ int stepUpdate() {
                 webHandle = startWebRequest( "GET", fullURL, NULL );
                 
                 delete [] fullURL;
+
+                startStreamedUpdate();
             
                 return 0;
                 }
             }
-        else if( updateProgressCompleteSteps < 1 ) {
-            // don't process data this step, wait until next step
-            updateProgressCompleteSteps++;
-            return 0;
+        }
+    
+    return result;
+    }
+
+
+
+void getUpdateStageProgress( float *outDownloaded, float *outDecompressed,
+                             float *outWritten ) {
+    *outDownloaded = 0;
+    *outDecompressed = 0;
+    *outWritten = 0;
+
+    if( streamedUpdate == NULL ) {
+        if( streamedResult == 1 ) {
+            *outDownloaded = 1;
+            *outDecompressed = 1;
+            *outWritten = 1;
             }
-        else {
-            // have update itself AND we've let one step go
-            // by for our final update progress to post
+        return;
+        }
 
-            
-            printf( "Update download complete\n" );
-            
-            return applyUpdateFromWebResult();
+    if( streamedBodyDone ) {
+        *outDownloaded = 1;
+        }
+    else if( updateSize > 0 && webHandle != -1 ) {
+        *outDownloaded = 
+            getWebProgressSize( webHandle ) / (float)updateSize;
+        
+        if( *outDownloaded > 1 ) {
+            // getWebProgressSize includes headers
+            *outDownloaded = 1;
             }
         }
-    
-    return result;
+
+    streamedUpdate->getStageProgress( outDecompressed, outWritten );
     }
 
 
 
 float getUpdateProgress() {
+    float downloaded, decompressed, written;
+    
+    getUpdateStageProgress( &downloaded, &decompressed, &written );
+    
+    float progress = ( downloaded + decompressed + written ) / 3;
+    
     if( batchMirrorUpdate ) {
         
         float globalProgress = batchStepsDone / (float)mirrors.size();
         
-
-        if( updateSize > 0 ) {
-            float progress = 0;
-            
-            if( webHandle != -1 ) {
-                progress = getWebProgressSize( webHandle ) / (float)updateSize;
-                }
-            
-            if( progress > 1 ) {
-                // getWebProgressSize includes headers
-                progress = 1;
-                }
-            
-            globalProgress += progress * 1.0f / mirrors.size();
-            }
+        globalProgress += progress * 1.0f / mirrors.size();
         
         return globalProgress;
         }
     else {
-        
-        if( updateSize > 0 ) {
-            float progress = 
-                getWebProgressSize( webHandle ) / (float)updateSize;
-        
-            if( progress > 1 ) {
-                // getWebProgressSize includes headers
-                progress = 1;
-                }
-            
-            return progress;
-            }
-        else {
-            return 0;
-            }
+        return progress;
         }
     }
 
@@ -993,6 +1886,10 @@ float getUpdateProgress() {
 
 
 void clearUpdate() {
+    // rolls back a partly-applied update
+    endStreamedUpdate();
+    streamedResult = 0;
+    
     clearWebRequest( webHandle );
 
     if( updateServerURL != NULL ) {
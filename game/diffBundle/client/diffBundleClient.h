@@ -22,9 +22,17 @@ char wasUpdateWriteError();
 
 
 // return fraction of update completion from 0 to 1
+// in a batch update, this covers all steps in the batch
 float getUpdateProgress();
 
 
+// the update is applied while it downloads, so each stage has its own
+// fraction of the current update (or current batch step) from 0 to 1:
+// bytes downloaded, bytes decompressed, and bytes written to disk
+void getUpdateStageProgress( float *outDownloaded, float *outDecompressed,
+                             float *outWritten );
+
+
 // frees resources associated with an update
 // if update is not complete, this cancels it (possibly in a partial state)
 // if hostname lookup is not complete, this call might block.
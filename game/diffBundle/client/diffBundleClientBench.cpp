@@ -0,0 +1,726 @@
+// Test and benchmark for streamed update application in diffBundleClient
+//
+// Usage:  diffBundleClientBench [megabytes]
+//
+// Stands in for the platform's web request functions, serving an
+// is_update_available answer and then a .dbz bundle, built in memory the
+// way diffBundle builds one, a few KiB per step.  Checks that:
+//    -files are written, replaced, and created under new directories, and
+//     listed files and directories are removed
+//    -empty files, and bytes split at every point, come through intact
+//    -no .dbtmp or .bak files are left behind
+//    -a truncated, corrupt, or failed download rolls replaced and removed
+//     files back, and removes no directories
+//    -progress never goes backward, and no stage runs ahead of the one
+//     feeding it
+//
+// Then times applying a large update, delivered as fast as it is taken.
+//
+// Works in a scratch tree (diffBundleClientBenchTree, in the current
+// directory), removed afterward.  startUpdate refuses to run inside a git
+// or mercurial checkout, so run this from outside one.
+
+
+#include "minorGems/game/diffBundle/client/diffBundleClient.h"
+#include "minorGems/game/game.h"
+
+#include "minorGems/io/file/File.h"
+#include "minorGems/formats/encodingUtils.h"
+#include "minorGems/util/SimpleVector.h"
+#include "minorGems/util/stringUtils.h"
+#include "minorGems/system/Time.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+
+
+static int numFailed = 0;
+
+
+static void check( char inPassed, const char *inWhat ) {
+    if( ! inPassed ) {
+        printf( "FAILED:  %s\n", inWhat );
+        numFailed++;
+        }
+    }
+
+
+
+static unsigned int randState = 12345;
+
+static int randInt( int inMin, int inMax ) {
+    randState = randState * 1103515245 + 12345;
+    return inMin + (int)( ( randState >> 8 ) % ( inMax - inMin + 1 ) );
+    }
+
+
+
+// web request stand-ins
+
+#define FAIL_NONE 0
+// body stops half way, reported as complete
+#define FAIL_TRUNCATE 1
+// compressed bytes damaged half way
+#define FAIL_CORRUPT 2
+// request reports an error half way
+#define FAIL_WEB 3
+
+
+static unsigned char *servedBundle = NULL;
+static int servedBundleLength = 0;
+
+// length of sizes at start of bundle, and of bundle decompressed
+static int servedHeaderLength = 0;
+static int servedRawLength = 0;
+
+static int servedFailure = FAIL_NONE;
+
+// bytes released per stepWebRequest, -1 for all at once
+static int bytesPerStep = 4000;
+
+
+static int currentHandle = 0;
+static char currentIsBundle = false;
+
+// bytes of current response
+static unsigned char *response = NULL;
+static int responseLength = 0;
+
+// released so far by stepWebRequest
+static int responseReleased = 0;
+
+// taken so far by takeWebResultBytes
+static int responseTaken = 0;
+
+static char responseFailed = false;
+
+
+
+int startWebRequest( const char *inMethod, const char *inURL,
+                     const char *inBody ) {
+    if( response != NULL ) {
+        delete [] response;
+        }
+
+    currentHandle++;
+    responseReleased = 0;
+    responseTaken = 0;
+    responseFailed = false;
+
+    currentIsBundle = ( strstr( inURL, "get_update" ) != NULL );
+
+    if( currentIsBundle ) {
+        responseLength = servedBundleLength;
+        if( servedFailure == FAIL_TRUNCATE ) {
+            responseLength = servedBundleLength / 2;
+            }
+
+        response = new unsigned char[ responseLength ];
+        memcpy( response, servedBundle, responseLength );
+
+        if( servedFailure == FAIL_CORRUPT ) {
+            for( int i=0; i<64; i++ ) {
+                response[ responseLength / 2 + i ] ^= 0x5A;
+                }
+            }
+        }
+    else {
+        char *answer = autoSprintf( "%d", servedBundleLength );
+        responseLength = strlen( answer );
+        response = (unsigned char*)answer;
+        }
+
+    return currentHandle;
+    }
+
+
+
+int stepWebRequest( int inHandle ) {
+    if( responseFailed ) {
+        return -1;
+        }
+
+    if( bytesPerStep == -1 || ! currentIsBundle ) {
+        responseReleased = responseLength;
+        }
+    else {
+        responseReleased += randInt( 1, 2 * bytesPerStep );
+        if( responseReleased > responseLength ) {
+            responseReleased = responseLength;
+            }
+        }
+
+    if( currentIsBundle && servedFailure == FAIL_WEB &&
+        responseReleased >= responseLength / 2 ) {
+        responseFailed = true;
+        return -1;
+        }
+
+    if( responseReleased == responseLength ) {
+        return 1;
+        }
+    return 0;
+    }
+
+
+
+int getWebProgressSize( int inHandle ) {
+    return responseReleased;
+    }
+
+
+
+char *getWebResult( int inHandle ) {
+    int size;
+    return (char*)getWebResult( inHandle, &size );
+    }
+
+
+
+unsigned char *getWebResult( int inHandle, int *outSize ) {
+    if( responseReleased < responseLength ) {
+        return NULL;
+        }
+
+    int size = responseLength - responseTaken;
+
+    unsigned char *result = new unsigned char[ size + 1 ];
+    memcpy( result, &( response[ responseTaken ] ), size );
+    result[ size ] = '\0';
+
+    *outSize = size;
+    return result;
+    }
+
+
+
+int takeWebResultBytes( int inHandle, unsigned char *outBuffer,
+                        int inMaxBytes ) {
+    if( ! currentIsBundle ) {
+        return 0;
+        }
+
+    int numTaken = responseReleased - responseTaken;
+    if( numTaken > inMaxBytes ) {
+        numTaken = inMaxBytes;
+        }
+
+    memcpy( outBuffer, &( response[ responseTaken ] ), numTaken );
+    responseTaken += numTaken;
+
+    return numTaken;
+    }
+
+
+
+void clearWebRequest( int inHandle ) {
+    }
+
+
+
+// bundles, in diffBundle's format
+
+static void appendString( SimpleVector<unsigned char> *inBuffer,
+                          const char *inString ) {
+    inBuffer->appendArray( (unsigned char*)inString, strlen( inString ) );
+    }
+
+
+
+static void appendNameList( SimpleVector<unsigned char> *inBuffer,
+                            int inNumNames, const char **inNames ) {
+    char *count = autoSprintf( "%d ", inNumNames );
+    appendString( inBuffer, count );
+    delete [] count;
+
+    for( int i=0; i<inNumNames; i++ ) {
+        char *header = autoSprintf( "%d %s ", (int)strlen( inNames[i] ),
+                                    inNames[i] );
+        appendString( inBuffer, header );
+        delete [] header;
+        }
+    }
+
+
+
+typedef struct BundleFile {
+        const char *name;
+        unsigned char *data;
+        int length;
+    } BundleFile;
+
+
+
+static void makeBundle( int inNumRemovedFiles, const char **inRemovedFiles,
+                        int inNumRemovedDirs, const char **inRemovedDirs,
+                        int inNumDirs, const char **inDirs,
+                        int inNumFiles, BundleFile *inFiles ) {
+    SimpleVector<unsigned char> raw;
+
+    appendNameList( &raw, inNumRemovedFiles, inRemovedFiles );
+    appendNameList( &raw, inNumRemovedDirs, inRemovedDirs );
+    appendNameList( &raw, inNumDirs, inDirs );
+
+    char *count = autoSprintf( "%d ", inNumFiles );
+    appendString( &raw, count );
+    delete [] count;
+
+    for( int i=0; i<inNumFiles; i++ ) {
+        char *header = autoSprintf( "%d %s %d#",
+                                    (int)strlen( inFiles[i].name ),
+                                    inFiles[i].name, inFiles[i].length );
+        appendString( &raw, header );
+        delete [] header;
+
+        raw.appendArray( inFiles[i].data, inFiles[i].length );
+        }
+
+    int rawLength = raw.size();
+    unsigned char *rawBytes = raw.getElementArray();
+
+    int compLength;
+    unsigned char *compBytes = zipCompress( rawBytes, rawLength,
+                                            &compLength );
+    delete [] rawBytes;
+
+    char *sizes = autoSprintf( "%d %d ", rawLength, compLength );
+    int sizesLength = strlen( sizes );
+
+    if( servedBundle != NULL ) {
+        delete [] servedBundle;
+        }
+
+    servedHeaderLength = sizesLength;
+    servedRawLength = rawLength;
+    servedBundleLength = sizesLength + compLength;
+    servedBundle = new unsigned char[ servedBundleLength ];
+    memcpy( servedBundle, sizes, sizesLength );
+    memcpy( &( servedBundle[ sizesLength ] ), compBytes, compLength );
+
+    delete [] sizes;
+    delete [] compBytes;
+    }
+
+
+
+// scratch tree
+
+static const char *treeName = "diffBundleClientBenchTree";
+
+
+static void removeTree() {
+    File root( NULL, treeName );
+
+    int numChildren;
+    File **children = root.getChildFilesRecursive( 64, &numChildren );
+
+    // children come after their directory
+    for( int i=numChildren-1; i>=0; i-- ) {
+        children[i]->remove();
+        delete children[i];
+        }
+    if( children != NULL ) {
+        delete [] children;
+        }
+
+    root.remove();
+    }
+
+
+
+// paths below are relative to the tree, which is the current directory
+// while an update runs
+
+static void writeString( const char *inPath, const char *inContents ) {
+    File file( NULL, inPath );
+    check( file.writeToFile( (char*)inContents ), "scratch file written" );
+    }
+
+
+
+static void makeDirectory( const char *inPath ) {
+    File dir( NULL, inPath );
+    dir.makeDirectory();
+    }
+
+
+
+static char fileMatches( const char *inPath, unsigned char *inData,
+                         int inLength ) {
+    File file( NULL, inPath );
+
+    int length;
+    unsigned char *contents = file.readFileContents( &length );
+
+    if( contents == NULL ) {
+        return false;
+        }
+
+    char same = ( length == inLength &&
+                  memcmp( contents, inData, length ) == 0 );
+    delete [] contents;
+    return same;
+    }
+
+
+
+static char fileMatchesString( const char *inPath, const char *inContents ) {
+    return fileMatches( inPath, (unsigned char*)inContents,
+                        strlen( inContents ) );
+    }
+
+
+
+static char exists( const char *inPath ) {
+    File file( NULL, inPath );
+    return file.exists();
+    }
+
+
+
+// true if no file in the tree ends with inSuffix
+static char noneEndWith( const char *inSuffix ) {
+    File root( NULL, "." );
+
+    int numChildren;
+    File **children = root.getChildFilesRecursive( 64, &numChildren );
+
+    char none = true;
+
+    for( int i=0; i<numChildren; i++ ) {
+        char *name = children[i]->getFileName();
+
+        int nameLength = strlen( name );
+        int suffixLength = strlen( inSuffix );
+
+        if( nameLength >= suffixLength &&
+            strcmp( &( name[ nameLength - suffixLength ] ),
+                    inSuffix ) == 0 ) {
+            none = false;
+            }
+        delete [] name;
+        delete children[i];
+        }
+    if( children != NULL ) {
+        delete [] children;
+        }
+
+    return none;
+    }
+
+
+
+// runs one update to completion, returns stepUpdate's final result
+static int runUpdate( char *outProgressOK ) {
+    *outProgressOK = true;
+
+    if( ! startUpdate( (char*)"http://localhost/update.php", 1 ) ) {
+        printf( "startUpdate refused, inside a git or hg checkout?\n" );
+        return -1;
+        }
+
+    float lastProgress = 0;
+    float lastStages[3] = { 0, 0, 0 };
+
+    int result = 0;
+
+    while( result == 0 ) {
+        result = stepUpdate();
+
+        float stages[3];
+        getUpdateStageProgress( &( stages[0] ), &( stages[1] ),
+                                &( stages[2] ) );
+
+        float progress = getUpdateProgress();
+
+        if( progress < lastProgress ) {
+            *outProgressOK = false;
+            }
+        for( int s=0; s<3; s++ ) {
+            if( stages[s] < lastStages[s] || stages[s] > 1 ) {
+                *outProgressOK = false;
+                }
+            }
+        // written bytes can't pass decompressed ones
+        if( stages[2] > stages[1] ) {
+            *outProgressOK = false;
+            }
+
+        if( result == 1 && progress != 1 ) {
+            *outProgressOK = false;
+            }
+
+        lastProgress = progress;
+        memcpy( lastStages, stages, sizeof( stages ) );
+
+        if( result == 0 ) {
+            usleep( 100 );
+            }
+        }
+
+    clearUpdate();
+
+    return result;
+    }
+
+
+
+static void setUpOldTree() {
+    writeString( "keep.txt", "kept\n" );
+    writeString( "old.txt", "to be removed\n" );
+    writeString( "replace.bin", "old contents" );
+    makeDirectory( "graphics" );
+    writeString( "graphics/sprite.tga", "old sprite" );
+    makeDirectory( "oldDir" );
+    }
+
+
+
+static unsigned char *makeData( int inLength ) {
+    unsigned char *data = new unsigned char[ inLength ];
+
+    // runs of repeats with noise, so it compresses but not to nothing
+    for( int i=0; i<inLength; i++ ) {
+        if( randInt( 0, 7 ) == 0 ) {
+            data[i] = (unsigned char)randInt( 0, 255 );
+            }
+        else {
+            data[i] = (unsigned char)( i / 100 );
+            }
+        }
+    return data;
+    }
+
+
+
+static void checkUpdates() {
+    const char *removedFiles[1] = { "old.txt" };
+    const char *removedDirs[1] = { "oldDir" };
+    const char *dirs[2] = { "newDir", "graphics" };
+
+    int bigLength = 3 * 1024 * 1024 + 17;
+    unsigned char *big = makeData( bigLength );
+
+    const char *replacement = "new contents, longer than before";
+    const char *sprite = "#starts with separator";
+    const char *deep = "made its own directory\n";
+
+    // replaced files first, so failures half way have something to undo
+    BundleFile files[5] = {
+        { "replace.bin", (unsigned char*)replacement,
+          (int)strlen( replacement ) },
+        { "graphics/sprite.tga", (unsigned char*)sprite,
+          (int)strlen( sprite ) },
+        { "newDir/big.dat", big, bigLength },
+        { "empty.dat", NULL, 0 },
+        { "sub/deep.txt", (unsigned char*)deep,
+          (int)strlen( deep ) } };
+
+    makeBundle( 1, removedFiles, 1, removedDirs, 2, dirs, 5, files );
+
+
+    int stepSizes[4] = { 1, 4000, 300000, -1 };
+
+    for( int s=0; s<4; s++ ) {
+        bytesPerStep = stepSizes[s];
+
+        if( bytesPerStep == 1 ) {
+            // one byte per step is slow for the big file
+            // check every split point on a small update instead
+            BundleFile smallFiles[2] = { files[0], files[1] };
+            makeBundle( 1, removedFiles, 1, removedDirs, 2, dirs,
+                        2, smallFiles );
+            }
+        else {
+            makeBundle( 1, removedFiles, 1, removedDirs, 2, dirs,
+                        5, files );
+            }
+
+        setUpOldTree();
+        servedFailure = FAIL_NONE;
+
+        char progressOK;
+        int result = runUpdate( &progressOK );
+
+        check( result == 1, "update applied" );
+        check( progressOK, "progress moves forward, stages in order" );
+        check( ! wasUpdateWriteError(), "no write error" );
+
+        check( fileMatchesString( "replace.bin", replacement ),
+               "file replaced" );
+        check( fileMatchesString( "graphics/sprite.tga", sprite ),
+               "file starting with # replaced" );
+        check( fileMatchesString( "keep.txt", "kept\n" ),
+               "unlisted file kept" );
+        check( ! exists( "old.txt" ), "listed file removed" );
+        check( ! exists( "oldDir" ), "listed directory removed" );
+        check( exists( "newDir" ), "new directory made" );
+
+        if( bytesPerStep != 1 ) {
+            check( fileMatches( "newDir/big.dat", big, bigLength ),
+                   "large file written" );
+            check( fileMatches( "empty.dat", NULL, 0 ),
+                   "empty file written" );
+            check( fileMatchesString( "sub/deep.txt", deep ),
+                   "file written under missing directory" );
+            }
+
+        check( noneEndWith( ".dbtmp" ), "no temp files left" );
+        check( noneEndWith( ".bak" ), "no backups left" );
+        }
+
+
+    // failures roll back
+    bytesPerStep = 4000;
+    makeBundle( 1, removedFiles, 1, removedDirs, 2, dirs, 5, files );
+
+    int failures[3] = { FAIL_TRUNCATE, FAIL_CORRUPT, FAIL_WEB };
+    const char *failureNames[3] = { "truncated", "corrupt", "failed" };
+
+    for( int f=0; f<3; f++ ) {
+        setUpOldTree();
+        servedFailure = failures[f];
+
+        char progressOK;
+        int result = runUpdate( &progressOK );
+
+        char *what = autoSprintf( "%s download rejected",
+                                  failureNames[f] );
+        check( result == -1, what );
+        delete [] what;
+
+        what = autoSprintf( "%s download rolled back", failureNames[f] );
+        check( fileMatchesString( "replace.bin", "old contents" ) &&
+               fileMatchesString( "graphics/sprite.tga", "old sprite" ),
+               what );
+        delete [] what;
+
+        what = autoSprintf( "%s download keeps removed files and dirs",
+                            failureNames[f] );
+        check( fileMatchesString( "old.txt", "to be removed\n" ) &&
+               exists( "oldDir" ), what );
+        delete [] what;
+
+        check( ! wasUpdateWriteError(), "failed download not a write error" );
+        check( noneEndWith( ".dbtmp" ), "no temp files left on failure" );
+        check( noneEndWith( ".bak" ), "no backups left on failure" );
+        }
+    servedFailure = FAIL_NONE;
+
+    delete [] big;
+    }
+
+
+
+static void bench( int inMegabytes ) {
+    int numFiles = 16;
+    int fileLength = inMegabytes * 1024 * 1024 / numFiles;
+
+    BundleFile files[16];
+    char *names[16];
+
+    for( int i=0; i<numFiles; i++ ) {
+        names[i] = autoSprintf( "data/file%d.dat", i );
+        files[i].name = names[i];
+        files[i].data = makeData( fileLength );
+        files[i].length = fileLength;
+        }
+
+    makeBundle( 0, NULL, 0, NULL, 0, NULL, numFiles, files );
+
+    printf( "\n%d MiB update, %d files, %d bytes compressed:\n",
+            inMegabytes, numFiles, servedBundleLength );
+
+
+    // the old path, for comparison:  whole body, then whole bundle
+    // decompressed, then files written
+    double start = Time::getCurrentTime();
+
+    unsigned char *raw =
+        zipDecompress( &( servedBundle[ servedHeaderLength ] ),
+                       servedBundleLength - servedHeaderLength,
+                       servedRawLength );
+    if( raw != NULL ) {
+        delete [] raw;
+        }
+    for( int i=0; i<numFiles; i++ ) {
+        File file( NULL, files[i].name );
+        makeDirectory( "data" );
+        file.writeToFile( files[i].data, files[i].length );
+        }
+    double msWhole = 1000 * ( Time::getCurrentTime() - start );
+
+    printf( "  decompress whole, then write:  %7.1f ms\n", msWhole );
+
+
+    bytesPerStep = 1024 * 1024;
+
+    start = Time::getCurrentTime();
+
+    char progressOK;
+    int result = runUpdate( &progressOK );
+
+    double msStreamed = 1000 * ( Time::getCurrentTime() - start );
+
+    check( result == 1, "large update applied" );
+
+    printf( "  streamed, synced, renamed:     %7.1f ms\n", msStreamed );
+
+    for( int i=0; i<numFiles; i++ ) {
+        delete [] names[i];
+        delete [] files[i].data;
+        }
+    }
+
+
+
+int main( int inNumArgs, char **inArgs ) {
+
+    int megabytes = 64;
+
+    if( inNumArgs > 1 ) {
+        megabytes = atoi( inArgs[1] );
+        }
+
+    removeTree();
+
+    File root( NULL, treeName );
+    root.makeDirectory();
+
+    if( chdir( treeName ) != 0 ) {
+        printf( "Failed to enter %s\n", treeName );
+        return 1;
+        }
+
+    checkUpdates();
+
+    if( numFailed == 0 ) {
+        bench( megabytes );
+        }
+
+    if( chdir( ".." ) != 0 ) {
+        printf( "Failed to leave %s\n", treeName );
+        return 1;
+        }
+
+    removeTree();
+
+    if( servedBundle != NULL ) {
+        delete [] servedBundle;
+        }
+    if( response != NULL ) {
+        delete [] response;
+        }
+
+    if( numFailed > 0 ) {
+        printf( "%d checks failed\n", numFailed );
+        return 1;
+        }
+
+    printf( "All checks passed\n" );
+
+    return 0;
+    }
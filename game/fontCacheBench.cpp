@@ -0,0 +1,465 @@
+// Test and benchmark for Font's kerning cache and glyph run cache
+//
+// Usage:  fontCacheBench [threads] [labels] [frames]
+//
+// Writes a synthetic 16x16 font image with random glyphs, then loads it
+// with kerning computed on one thread, on several threads, and read back
+// from the kerning cache, and checks that all three kern every character
+// pair the same.  A stale cache file must be ignored.
+//
+// Then draws static labels through the null gameGraphics backend with and
+// without glyph run reuse, checks that both draw the same thing at the
+// same positions, checks LRU eviction, and times both.
+//
+// Leaves fontCacheBench.tga and fontCacheBenchCache/ behind.
+
+
+#include "Font.h"
+
+#include "minorGems/game/platforms/null/gameGraphicsNull.h"
+#include "minorGems/graphics/converters/TGAImageConverter.h"
+#include "minorGems/io/file/File.h"
+#include "minorGems/io/file/FileInputStream.h"
+#include "minorGems/io/file/FileOutputStream.h"
+#include "minorGems/system/Time.h"
+#include "minorGems/system/ThreadPool.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+
+static int numFailed = 0;
+
+
+static void check( char inPassed, const char *inWhat ) {
+    if( ! inPassed ) {
+        printf( "FAILED:  %s\n", inWhat );
+        numFailed++;
+        }
+    }
+
+
+
+// Font reads through gameGraphics, which gameSDL implements by looking
+// in the graphics folder
+// read from working directory instead
+Image *readTGAFile( const char *inTGAFileName ) {
+    File file( NULL, inTGAFileName );
+
+    if( ! file.exists() ) {
+        return NULL;
+        }
+
+    FileInputStream stream( &file );
+
+    TGAImageConverter converter;
+
+    return converter.deformatImage( &stream );
+    }
+
+
+
+static unsigned int randState = 12345;
+
+static int randInt( int inMin, int inMax ) {
+    randState = randState * 1103515245 + 12345;
+    return inMin + (int)( ( randState >> 8 ) % ( inMax - inMin + 1 ) );
+    }
+
+
+
+static const char *fontFileName = "fontCacheBench.tga";
+static const char *cacheFolderName = "fontCacheBenchCache";
+
+static const int cellSize = 32;
+
+
+
+// random blobby glyphs, ink in red channel, with some blank characters
+static void writeFontImage() {
+    int size = cellSize * 16;
+
+    Image image( size, size, 4, true );
+
+    double *red = image.getChannel( 0 );
+    double *alpha = image.getChannel( 3 );
+
+    for( int p=0; p<size * size; p++ ) {
+        alpha[p] = 1;
+        }
+
+    for( int c=0; c<256; c++ ) {
+        if( c < 33 || randInt( 0, 9 ) == 0 ) {
+            continue;
+            }
+
+        int cellX = ( c % 16 ) * cellSize;
+        int cellY = ( c / 16 ) * cellSize;
+
+        int numStrokes = randInt( 1, 4 );
+
+        for( int s=0; s<numStrokes; s++ ) {
+            int x0 = randInt( 4, cellSize - 12 );
+            int y0 = randInt( 4, cellSize - 12 );
+            int x1 = x0 + randInt( 2, 8 );
+            int y1 = y0 + randInt( 2, 8 );
+
+            for( int y=y0; y<y1; y++ ) {
+                for( int x=x0; x<x1; x++ ) {
+                    // soft edges, so some ink is below inkA
+                    double v = 1;
+                    if( x == x0 || y == y0 || x == x1 - 1 || y == y1 - 1 ) {
+                        v = 0.4;
+                        }
+
+                    double *p = &( red[ ( cellY + y ) * size + cellX + x ] );
+                    if( v > *p ) {
+                        *p = v;
+                        }
+                    }
+                }
+            }
+        }
+
+    File file( NULL, fontFileName );
+    FileOutputStream stream( &file );
+
+    TGAImageConverter converter;
+    converter.formatImage( &image, &stream );
+    }
+
+
+
+static double pairWidths[ 256 * 256 ];
+
+// widths of all printable character pairs, which include kerning
+static void measurePairs( Font *inFont, double *outWidths ) {
+    char pair[3] = { 0, 0, 0 };
+
+    for( int a=1; a<256; a++ ) {
+        for( int b=1; b<256; b++ ) {
+            pair[0] = (char)a;
+            pair[1] = (char)b;
+            outWidths[ a * 256 + b ] = inFont->measureString( pair );
+            }
+        }
+    }
+
+
+static char pairsMatch( Font *inFont ) {
+    double *widths = new double[ 256 * 256 ];
+
+    measurePairs( inFont, widths );
+
+    char match = true;
+    for( int a=1; a<256; a++ ) {
+        for( int b=1; b<256; b++ ) {
+            if( widths[ a * 256 + b ] != pairWidths[ a * 256 + b ] ) {
+                match = false;
+                }
+            }
+        }
+
+    delete [] widths;
+    return match;
+    }
+
+
+
+static Font *loadFont() {
+    return new Font( fontFileName, 2, 8, false, 1.0 );
+    }
+
+
+
+static void removeCacheFiles() {
+    File folder( NULL, cacheFolderName );
+
+    if( folder.exists() ) {
+        int numFiles;
+        File **files = folder.getChildFiles( &numFiles );
+
+        for( int i=0; i<numFiles; i++ ) {
+            files[i]->remove();
+            delete files[i];
+            }
+        delete [] files;
+        }
+    }
+
+
+
+static const char *labels[] = {
+    "HUNGER", "TEMPERATURE", "Press ENTER to say something",
+    "YUM", "Your name is Wyatt Avenue", "FAMILY TREE", "SETTINGS",
+    "To:  Everyone", "[PAUSED]", "12:45", "ESC - QUIT",
+    "Carrying:  BOWL OF GOOSEBERRIES", "WATCHING" };
+
+static const int numLabels = sizeof( labels ) / sizeof( labels[0] );
+
+
+
+// draws labels, returning hash of what was drawn
+static unsigned int drawLabels( Font *inFont, int inNumLabels,
+                                int inFrames ) {
+    resetDrawHash();
+
+    for( int f=0; f<inFrames; f++ ) {
+        for( int i=0; i<inNumLabels; i++ ) {
+            doublePair pos = { (double)( i % 7 ) * 31.3,
+                               (double)( i / 7 ) * 17.1 };
+
+            inFont->drawString( labels[ i % numLabels ], pos,
+                                (TextAlignment)( i % 3 ) );
+            }
+        }
+
+    return getDrawHash();
+    }
+
+
+
+static char positionsMatch( Font *inA, Font *inB ) {
+    char match = true;
+
+    double precisions[3] = { 0, 0.5, 2 };
+
+    for( int p=0; p<3; p++ ) {
+        inA->setMinimumPositionPrecision( precisions[p] );
+        inB->setMinimumPositionPrecision( precisions[p] );
+
+        for( int i=0; i<numLabels; i++ ) {
+            for( int a=0; a<3; a++ ) {
+                doublePair pos = { 10.37 * i - 40, -3.3 * i };
+
+                SimpleVector<doublePair> posA, posB;
+
+                double endA = inA->getCharPos( &posA, labels[i], pos,
+                                               (TextAlignment)a );
+                double endB = inB->getCharPos( &posB, labels[i], pos,
+                                               (TextAlignment)a );
+
+                if( endA != endB || posA.size() != posB.size() ) {
+                    match = false;
+                    continue;
+                    }
+                for( int c=0; c<posA.size(); c++ ) {
+                    doublePair pA = posA.getElementDirect( c );
+                    doublePair pB = posB.getElementDirect( c );
+
+                    if( pA.x != pB.x || pA.y != pB.y ) {
+                        match = false;
+                        }
+                    }
+                }
+            }
+        }
+
+    inA->setMinimumPositionPrecision( 0 );
+    inB->setMinimumPositionPrecision( 0 );
+
+    return match;
+    }
+
+
+
+int main( int inNumArgs, char **inArgs ) {
+
+    int numThreads = ThreadPool::getNumCPUs();
+    int numDrawLabels = 60;
+    int frames = 2000;
+
+    if( inNumArgs > 1 ) {
+        numThreads = atoi( inArgs[1] );
+        }
+    if( inNumArgs > 2 ) {
+        numDrawLabels = atoi( inArgs[2] );
+        }
+    if( inNumArgs > 3 ) {
+        frames = atoi( inArgs[3] );
+        }
+
+    if( numThreads < 1 || numDrawLabels < 1 || frames < 1 ) {
+        printf( "Usage:  fontCacheBench [threads] [labels] [frames]\n" );
+        return 1;
+        }
+
+
+    writeFontImage();
+
+    Font::setKerningCacheFolder( cacheFolderName );
+    removeCacheFiles();
+
+
+    // cold, one thread, fills cache
+    Font::setKerningThreads( 1 );
+
+    double start = Time::getCurrentTime();
+    Font *serialFont = loadFont();
+    double serialTime = Time::getCurrentTime() - start;
+
+    check( ! serialFont->wasKerningCached(), "first load computes kerning" );
+
+    measurePairs( serialFont, pairWidths );
+
+
+    // cold, several threads, cache off
+    Font::setKerningCacheFolder( NULL );
+    Font::setKerningThreads( numThreads );
+
+    start = Time::getCurrentTime();
+    Font *parallelFont = loadFont();
+    double parallelTime = Time::getCurrentTime() - start;
+
+    check( ! parallelFont->wasKerningCached(), "cache off computes kerning" );
+    check( pairsMatch( parallelFont ),
+           "parallel kerning matches serial kerning" );
+    delete parallelFont;
+
+
+    // warm
+    Font::setKerningCacheFolder( cacheFolderName );
+
+    start = Time::getCurrentTime();
+    Font *cachedFont = loadFont();
+    double cachedTime = Time::getCurrentTime() - start;
+
+    check( cachedFont->wasKerningCached(), "second load reads cache" );
+    check( pairsMatch( cachedFont ), "cached kerning matches" );
+    delete cachedFont;
+
+
+    // stale cache file, cut short
+    File folder( NULL, cacheFolderName );
+    int numFiles;
+    File **files = folder.getChildFiles( &numFiles );
+
+    check( numFiles == 1, "one cache file written" );
+
+    if( numFiles == 1 ) {
+        int length;
+        unsigned char *data = files[0]->readFileContents( &length );
+        files[0]->writeToFile( data, length / 2 );
+        delete [] data;
+
+        Font *staleFont = loadFont();
+        check( ! staleFont->wasKerningCached(), "stale cache ignored" );
+        check( pairsMatch( staleFont ), "kerning after stale cache matches" );
+        delete staleFont;
+
+        Font *rewrittenFont = loadFont();
+        check( rewrittenFont->wasKerningCached(), "stale cache replaced" );
+        delete rewrittenFont;
+        }
+    for( int i=0; i<numFiles; i++ ) {
+        delete files[i];
+        }
+    delete [] files;
+
+
+    printf( "Kerning for %dx%d glyphs:\n", cellSize, cellSize );
+    printf( "  computed on 1 thread:    %8.2f ms\n", 1000 * serialTime );
+    printf( "  computed on %d threads:  %8.2f ms\n", numThreads,
+            1000 * parallelTime );
+    printf( "  loaded from cache:       %8.2f ms\n\n", 1000 * cachedTime );
+
+
+    // glyph runs
+    Font *runFont = serialFont;
+    Font *plainFont = loadFont();
+    plainFont->setGlyphRunCacheSize( 0 );
+
+    check( positionsMatch( runFont, plainFont ),
+           "reused runs position like fresh layout" );
+
+    // sprite handles are hashed too, so compare one font against itself
+    unsigned int plainHash = drawLabels( plainFont, numDrawLabels, 2 );
+    plainFont->setGlyphRunCacheSize( 256 );
+    unsigned int runHash = drawLabels( plainFont, numDrawLabels, 2 );
+    plainFont->setGlyphRunCacheSize( 0 );
+
+    check( runHash == plainHash, "reused runs draw the same" );
+
+    drawLabels( runFont, numDrawLabels, 1 );
+
+
+    // same string at another scale is another run, but switching back
+    // reuses the first
+    int hits, misses, hits2, misses2;
+    runFont->getGlyphRunCacheStats( &hits, &misses );
+
+    double width1 = runFont->measureString( labels[0] );
+    runFont->setScaleFactor( 2.0 );
+
+    doublePair zero = { 0, 0 };
+    runFont->drawString( labels[0], zero );
+    double width2 = runFont->measureString( labels[0] );
+
+    runFont->setScaleFactor( 1.0 );
+    runFont->drawString( labels[0], zero );
+
+    runFont->getGlyphRunCacheStats( &hits2, &misses2 );
+
+    check( width2 == 2 * width1, "scaled run measured at new scale" );
+    check( misses2 == misses + 1 && hits2 == hits + 3,
+           "runs keyed by scale" );
+
+
+    // LRU:  4 slots, 5 strings cycling always miss, 4 always hit
+    Font *lruFont = loadFont();
+    lruFont->setGlyphRunCacheSize( 4 );
+
+    for( int r=0; r<3; r++ ) {
+        for( int i=0; i<5; i++ ) {
+            lruFont->drawString( labels[i], zero );
+            }
+        }
+    lruFont->getGlyphRunCacheStats( &hits, &misses );
+    check( hits == 0 && misses == 15, "cycling past capacity misses" );
+
+    for( int r=0; r<3; r++ ) {
+        for( int i=0; i<4; i++ ) {
+            lruFont->drawString( labels[i], zero );
+            }
+        }
+    lruFont->getGlyphRunCacheStats( &hits2, &misses2 );
+    check( hits2 == 8 && misses2 == 19, "runs within capacity reused" );
+
+    // recently used survives eviction
+    lruFont->drawString( labels[0], zero );
+    lruFont->drawString( labels[5], zero );
+    lruFont->drawString( labels[0], zero );
+    lruFont->getGlyphRunCacheStats( &hits, &misses );
+    check( hits == hits2 + 2 && misses == misses2 + 1,
+           "least recently used evicted" );
+    delete lruFont;
+
+
+    start = Time::getCurrentTime();
+    drawLabels( plainFont, numDrawLabels, frames );
+    double plainTime = Time::getCurrentTime() - start;
+
+    start = Time::getCurrentTime();
+    drawLabels( runFont, numDrawLabels, frames );
+    double runTime = Time::getCurrentTime() - start;
+
+    printf( "Drawing %d labels for %d frames:\n", numDrawLabels, frames );
+    printf( "  laid out every call:  %8.2f us/frame\n",
+            1000000 * plainTime / frames );
+    printf( "  reusing glyph runs:   %8.2f us/frame\n",
+            1000000 * runTime / frames );
+
+    delete plainFont;
+    delete runFont;
+
+
+    if( numFailed > 0 ) {
+        printf( "\n%d checks FAILED\n", numFailed );
+        return 1;
+        }
+
+    printf( "\nAll checks passed\n" );
+    return 0;
+    }
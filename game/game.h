@@ -378,6 +378,26 @@ SoundSpriteHandle loadSoundSprite( const char *inAIFFFileName );
 SoundSpriteHandle loadSoundSprite( const char *inFolderName, 
                                    const char *inAIFFFileName );
 
+// Loaded files are mapped, and their samples are decoded on first play.
+// Sounds longer than about 10 seconds are never decoded whole, but are
+// streamed from their files through small buffers each time they play.
+
+
+// limit on memory used by samples decoded from loaded files
+// least-recently played sprites that aren't playing are dropped as needed,
+// and decoded from their files again on their next play
+// defaults to 64 MiB
+void setSoundSpriteCacheLimit( int inBytes );
+
+
+// memory held by sound sprites, in bytes
+//   decoded:  samples decoded from files, plus those set with setSoundSprite
+//   streaming:  buffers of streamed sounds that are playing
+//   mapped:  total size of loaded files, which are resident only in part
+void getSoundSpriteMemoryUsage( int *outDecodedBytes, 
+                                int *outStreamingBytes,
+                                int *outMappedBytes );
+
 
 // if inNoVariance is true, sound ignores global rate and volume range
 // defaults to false
@@ -571,6 +591,20 @@ void wakeUpPauseFrameRate();
 char isGamePlayingBack();
 
 
+// sets functions that save and restore game state, so that recorded games
+// hold snapshots at keyframes (once a minute) and playback can seek
+// inSave returns a new[] snapshot destroyed by caller, and sets *outLength
+// inRestore returns true on success
+void setRecordingSnapshotFunctions( 
+    unsigned char *( *inSave )( int *outLength ),
+    char ( *inRestore )( unsigned char *inSnapshot, int inLength ) );
+
+// moves playback to the latest snapshot at or before a frame of the
+// recorded game
+// returns the frame moved to, or -1 if there is no such snapshot
+int seekGamePlayback( int inFrame );
+
+
 
 
 
@@ -625,6 +659,17 @@ char *getWebResult( int inHandle );
 unsigned char *getWebResult( int inHandle, int *outSize );
 
 
+// takes response bytes received so far, before the request is complete,
+// so large downloads can be handled as they arrive
+// bytes taken are not returned again by getWebResult
+// returns number of bytes taken, at most inMaxBytes, or 0 if none
+//
+// Always returns 0 while a game is being recorded or played back, where
+// the whole response comes from getWebResult instead.
+int takeWebResultBytes( int inHandle, unsigned char *outBuffer,
+                        int inMaxBytes );
+
+
 // frees resources associated with a web request
 // if request is not complete, this cancels it
 // if hostname lookup is not complete, this call might block.
@@ -653,7 +698,17 @@ void closeSocket( int inHandle );
 
 // returns int handle for this file read operation
 // inFilePath is platform-dependent path to file from current directory
-int startAsyncFileRead( const char *inFilePath );
+// reads with higher inPriority are started first, and reads with the same
+// priority are started in order
+int startAsyncFileRead( const char *inFilePath, int inPriority = 0 );
+
+
+// ignored if read has already started
+void setAsyncFileReadPriority( int inHandle, int inPriority );
+
+
+// this clears the handle, and discards the read whether or not it is done
+void cancelAsyncFileRead( int inHandle );
 
 
 char checkAsyncFileReadDone( int inHandle );
@@ -664,6 +719,14 @@ char checkAsyncFileReadDone( int inHandle );
 unsigned char *getAsyncFileData( int inHandle, int *outDataLength );
 
 
+// same, but large files are memory-mapped rather than copied
+// return array owned by platform, and valid until releaseAsyncFileData
+// is called, which clears the handle
+unsigned char *getAsyncFileDataNoCopy( int inHandle, int *outDataLength );
+
+void releaseAsyncFileData( int inHandle );
+
+
 
 
 // relaunches the game from scratch as a new process, and triggers exit
@@ -159,6 +159,13 @@ SpriteHandle fillSprite( unsigned char *inRGBA,
 // fails and returns NULL if inRawImage doesn't have 4 channels
 SpriteHandle fillSprite( RawRGBAImage *inRawImage );
 
+// same as fillSprite above, but with colored radii already found
+// (left, right, top, bottom, as SpriteDecodeBatch finds them)
+// radii only used if transparent cropping on
+SpriteHandle fillSprite( unsigned char *inRGBA, 
+                         unsigned int inWidth, unsigned int inHeight,
+                         double inColoredRadii[4] );
+
 
 
 // fill a one-channel (alpha-only) sprite
@@ -191,6 +198,41 @@ RawRGBAImage *readTGAFileRawFromBuffer( unsigned char *inBuffer,
 
 
 
+// loads a list of sprites from the graphics directory, decoding them on
+// worker threads and filling them on the main thread a few per frame
+//
+// called after each step with the number of sprites done so far
+typedef void (*SpriteLoadProgressCallback)( int inNumDone, int inNumTotal,
+                                            void *inExtraParam );
+
+// starts a batch, same as calling loadSprite on each file
+// file names destroyed by caller
+// returns a handle for the batch
+int startSpriteLoadBatch( int inNumFiles, const char **inTGAFileNames,
+                          char inTransparentLowerLeftCorner = true,
+                          SpriteLoadProgressCallback inCallback = NULL,
+                          void *inCallbackExtraParam = NULL );
+
+// fills decoded sprites until inBudgetSeconds have passed, always filling
+// at least one if any are left
+// blocks only when no sprite is decoded yet
+// call once per frame, from the main thread
+// returns true when all sprites in batch are done
+char stepSpriteLoadBatch( int inBatchHandle, double inBudgetSeconds );
+
+// number of sprites done so far, including ones that failed to load
+int getSpriteLoadBatchProgress( int inBatchHandle );
+
+// gets the sprite for a file, in the order passed to startSpriteLoadBatch
+// NULL if not done yet or load failed
+SpriteHandle getSpriteLoadBatchSprite( int inBatchHandle, int inIndex );
+
+// frees batch, canceling work not done yet
+// sprites already filled are not freed, and stay the caller's to free
+void freeSpriteLoadBatch( int inBatchHandle );
+
+
+
 // write a TGA file into main directory
 // Image destroyed by caller
 void writeTGAFile( const char *inTGAFileName, Image *inImage );
@@ -65,6 +65,7 @@ int main( int inArgCount, char **inArgs ) {
 #include "minorGems/util/log/FileLog.h"
 
 #include "minorGems/graphics/converters/TGAImageConverter.h"
+#include "minorGems/graphics/FrameCapture.h"
 
 #include "minorGems/io/file/FileInputStream.h"
 #include "minorGems/util/ByteBufferInputStream.h"
@@ -72,6 +73,10 @@ int main( int inArgCount, char **inArgs ) {
 
 #include "minorGems/sound/formats/aiff.h"
 #include "minorGems/sound/audioNoClip.h"
+#include "minorGems/sound/SoundSpriteMixer.h"
+#include "minorGems/sound/StreamedSound.h"
+
+#include "minorGems/io/file/MappedFile.h"
 
 
 
@@ -79,6 +84,13 @@ int main( int inArgCount, char **inArgs ) {
 #include "minorGems/game/gameGraphics.h"
 #include "minorGems/game/drawUtils.h"
 
+#ifdef HEADLESS_REPLAY
+#include "minorGems/game/platforms/null/gameGraphicsNull.h"
+#include "minorGems/crypto/hashes/sha1.h"
+#else
+#include "minorGems/game/platforms/openGL/SpriteGL.h"
+#endif
+
 #include "minorGems/game/diffBundle/client/diffBundleClient.h"
 
 
@@ -116,128 +128,63 @@ void freeWriteFailedPanel() {
 #endif
 
 
-static int nextAsyncFileHandle = 0;
+#include "minorGems/io/file/AsyncFileReader.h"
 
-typedef struct AsyncFileRecord {
-        int handle;
-        char *filePath;
-        
-        int dataLength;
-        unsigned char *data;
-        
-        char doneReading;
-        
-    } AsyncFileRecord;
+// created on first read, once settings can be read
+static AsyncFileReader *asyncFileReader = NULL;
 
 
+#include "minorGems/io/file/AssetArchive.h"
 
-#include "minorGems/system/StopSignalThread.h"
-#include "minorGems/system/MutexLock.h"
-#include "minorGems/system/BinarySemaphore.h"
+// game data packed by assetPacker, checked before loose files
+// NULL if there is no assets.pack
+static AssetArchive *assetArchive = NULL;
 
-static MutexLock asyncLock;
-static BinarySemaphore newFileToReadSem;
 
-static BinarySemaphore newFileDoneReadingSem;
+// gets a file from the asset archive
+// inFolderName can be NULL for files named from the game folder
+// returns NULL if no archive, or file not in it
+// outCopied set to true if result must be destroyed by caller
+static unsigned char *getArchivedFile( const char *inFolderName,
+                                       const char *inFileName,
+                                       int *outLength, char *outCopied ) {
+    if( assetArchive == NULL ) {
+        return NULL;
+        }
 
-static SimpleVector<AsyncFileRecord> asyncFiles;
+    if( inFolderName == NULL ) {
+        return assetArchive->getData( inFileName, outLength, outCopied );
+        }
 
+    char *assetName = autoSprintf( "%s/%s", inFolderName, inFileName );
 
-class AsyncFileThread : public StopSignalThread {
+    unsigned char *data = 
+        assetArchive->getData( assetName, outLength, outCopied );
     
-    public:
-        
-        AsyncFileThread() {
-            start();
-            }
-
-        ~AsyncFileThread() {
-            stop();
-            newFileToReadSem.signal();
-            join();
-
-            for( int i=0; i<asyncFiles.size(); i++ ) {
-        
-                AsyncFileRecord *r = asyncFiles.getElement( i );
-                
-                if( r->filePath != NULL ) {
-                    delete [] r->filePath;
-                    }
-                
-                if( r->data != NULL ) {
-                    delete [] r->data;
-                    }
-                }
-            asyncFiles.deleteAll();
-            }
-        
-
-        virtual void run() {
-            while( ! isStopped() ) {
-                
-                int handleToRead = -1;
-                char *pathToRead = NULL;
-                
-                asyncLock.lock();
-                
-                for( int i=0; i<asyncFiles.size(); i++ ) {
-                    AsyncFileRecord *r = asyncFiles.getElement( i );
-                    
-                    if( ! r->doneReading ) {
-                        // can't trust pointer to record in vector
-                        // outside of lock, because vector storage may
-                        // change
-                        handleToRead = r->handle;
-                        pathToRead = r->filePath;
-                        break;
-                        }
-                    }
+    delete [] assetName;
 
-                asyncLock.unlock();
-
-                if( handleToRead != -1 ) {
-                    // read file data
+    return data;
+    }
 
-                    File f( NULL, pathToRead );
-                    
-                    int dataLength;
-                    unsigned char *data = f.readFileContents( &dataLength );
 
-                    // re-lock vector, search for handle, and add it
-                    // cannot count on vector order or pointers to records
-                    // when we don't have it locked
 
-                    asyncLock.lock();
-                    
-                    for( int i=0; i<asyncFiles.size(); i++ ) {
-                        AsyncFileRecord *r = asyncFiles.getElement( i );
-                    
-                        if( r->handle == handleToRead ) {
-                            r->dataLength = dataLength;
-                            r->data = data;
-                            r->doneReading = true;
-                            break;
-                            }
-                        }
+#include "minorGems/game/SpriteDecodeBatch.h"
 
-                    asyncLock.unlock();
+typedef struct SpriteLoadBatch {
+        SpriteDecodeBatch *decoder;
+        
+        // NULL until filled, or if load failed
+        SpriteHandle *sprites;
+        
+        int numDone;
 
-                    // let anyone waiting for a new file to finish
-                    // reading (only matters in the case of playback, where
-                    // the file-done must happen on a specific frame)
-                    newFileDoneReadingSem.signal();
-                    }
-                else {
-                    // wait on binary semaphore until something else added
-                    // for us to read
-                    newFileToReadSem.wait();
-                    }
-                }
-            };
-    };
+        SpriteLoadProgressCallback callback;
+        void *callbackExtraParam;
+    } SpriteLoadBatch;
 
 
-static AsyncFileThread fileReadThread;
+// indexed by handle, NULL once freed
+static SimpleVector<SpriteLoadBatch *> spriteLoadBatches;
 
 
 
@@ -305,12 +252,25 @@ char blendOutputFramePairs = false;
 
 float blendOutputFrameFraction = 0;
 
+// output frames are encoded and written by worker threads
+// read from settings folder
+static int outputFrameWorkers = 2;
+static int outputFrameQueueLength = 8;
 
-char *webProxy = NULL;
+// drop frames instead of stalling the game when the workers fall behind
+static char outputFramesDropWhenBehind = false;
 
+// also write all output frames to screenShots/frames.y4m
+static char outputFramesY4M = false;
 
+// set while outputAllFrames is running
+static FrameCapture *frameCapture = NULL;
 
-static unsigned char *lastFrame_rgbaBytes = NULL;
+// finishes writing frames and reports stats
+static void stopFrameCapture();
+
+
+char *webProxy = NULL;
 
 
 static unsigned int frameNumber = 0;
@@ -362,7 +322,12 @@ char mouseWorldCoordinates = true;
     static const char *screenShotExtension = "jpg";
 #elif defined(USE_PNG)
     #include "minorGems/graphics/converters/PNGImageConverter.h"
+    #include "minorGems/graphics/converters/PNGWriter.h"
     static PNGImageConverter screenShotConverter;
+
+    // output frames come in bursts, so favor speed over size
+    // made while frames are being captured, for its worker threads
+    static PNGWriter *outputFrameWriter = NULL;
     static const char *screenShotExtension = "png";
 #else
     static TGAImageConverter screenShotConverter;
@@ -370,6 +335,29 @@ char mouseWorldCoordinates = true;
 #endif
 
 
+static Image *rgbBytesToImage( unsigned char *inRGBBytes, 
+                               int inWidth, int inHeight );
+
+
+// called from FrameCapture worker threads
+static void encodeOutputFrame( unsigned char *inRGBBytes,
+                               int inWidth, int inHeight,
+                               OutputStream *inStream ) {
+#ifdef USE_JPEG
+    // JPEG converter only takes Images
+    Image *image = rgbBytesToImage( inRGBBytes, inWidth, inHeight );
+    screenShotConverter.formatImage( image, inStream );
+    delete image;
+#elif defined(USE_PNG)
+    outputFrameWriter->formatBytes( inRGBBytes, inWidth, inHeight, 3, 
+                                    true, inStream );
+#else
+    screenShotConverter.formatBytes( inRGBBytes, inWidth, inHeight, 3, 
+                                     true, inStream );
+#endif
+    }
+
+
 // should screenshot be taken at end of next redraw?
 static char shouldTakeScreenshot = false;
 static char manualScreenShot = false;
@@ -378,6 +366,8 @@ static char *screenShotPrefix = NULL;
 
 static void takeScreenShot();
 
+static int nextShotNumber = -1;
+
 
 
 
@@ -499,18 +489,39 @@ typedef struct WebRequestRecord {
 
 SimpleVector<WebRequestRecord> webRequestRecords;
 
+// bytes taken early from a web result can't be replayed in step with the
+// rest of a recording, so recorded games only see whole results
+static char recordingGame = false;
+
 
 
 
 typedef struct SocketConnectionRecord {
         int handle;
         Socket *sock;
+        // a queued send failed during a per-frame flush
+        char sendFailed;
     } SocketConnectionRecord;
 
 SimpleVector<SocketConnectionRecord> socketConnectionRecords;
 
 
 
+// sends bytes queued by sendToSocket during this frame, one system call
+// per socket
+static void flushSocketSendQueues() {
+    for( int i=0; i<socketConnectionRecords.size(); i++ ) {
+        SocketConnectionRecord *r = socketConnectionRecords.getElement( i );
+        
+        if( r->sock->getNumQueuedBytes() > 0 &&
+            r->sock->flushSendQueue() == -1 ) {
+            r->sendFailed = true;
+            }
+        }
+    }
+
+
+
 void getScreenDimensions( int *outWidth, int *outHeight ) {
     *outWidth = screenWidth;
     *outHeight = screenHeight;
@@ -521,18 +532,33 @@ void getScreenDimensions( int *outWidth, int *outHeight ) {
 typedef struct SoundSprite {
         int handle;
         int numSamples;
-        int samplesPlayed;
 
         // true for sound sprites that are marked to never use
         // pitch and volume variance
         char noVariance;
-
-        // floating point position of next interpolated sameple to play
-        // (for variable rate playback)
-        double samplesPlayedF;
         
-        
-        Sint16 *samples;
+        // padded for the mixer, see SoundSpriteMixer::allocSamples
+        // NULL for sprites loaded from files until they are first played,
+        // and again after they are dropped from the decoded cache
+        int16_t *samples;
+
+        // file that sprite was loaded from, or NULL for sprites set from
+        // memory
+        MappedFile *file;
+        // byte offset of big-endian samples in file
+        int fileSampleOffset;
+
+        // long sprites stream from file for each play, and never have
+        // samples
+        char streamed;
+
+        // neighbors in the decoded cache's play order, for sprites
+        // loaded from files while they hold samples
+        struct SoundSprite *lessRecent;
+        struct SoundSprite *moreRecent;
+
+        // kept in the cache while a batch that includes it is prepared
+        char pinned;
     } SoundSprite;
 
 
@@ -543,36 +569,272 @@ typedef struct SoundSprite {
 //  without accessing this vector).
 static SimpleVector<SoundSprite*> soundSprites;
 
-// audio thread is locked every time we touch this vector
-// So, we want to avoid mallocs here
-// Can we imagine more than 100 sound sprites ever playing at the same time?
-static SimpleVector<SoundSprite> playingSoundSprites( 100 );
+// playing sound sprites, with their rates and volumes
+// audio thread is locked every time we touch this
+static SoundSpriteMixer soundSpriteMixer;
 
-static double *soundSpriteMixingBufferL = NULL;
-static double *soundSpriteMixingBufferR = NULL;
 
+// sprites longer than this are streamed (10 seconds at 44.1 kHz)
+#define STREAMED_SOUND_SPRITE_SAMPLES 441000
 
-// variable rate per sprite
-// these are also touched with audio thread locked, so avoid mallocs
-// we won't see more than 100 of these simultaneously either
-static SimpleVector<double> playingSoundSpriteRates( 100 );
-static SimpleVector<double> playingSoundSpriteVolumesR( 100 );
-static SimpleVector<double> playingSoundSpriteVolumesL( 100 );
+// buffered when a stream starts, before the reader thread takes over
+#define STREAMED_SOUND_SPRITE_PREFILL 16384
+
+static int soundSpriteCacheLimit = 64 * 1024 * 1024;
+
+// samples held by sprites, whether decoded from files or set from memory
+static int soundSpriteDecodedBytes = 0;
+
+static int soundSpriteMappedBytes = 0;
+
+// decoded sprites loaded from files, least recently played first
+static SoundSprite *leastRecentSoundSprite = NULL;
+static SoundSprite *mostRecentSoundSprite = NULL;
+
+// keeps streamed sprites buffered, started when first needed
+static SoundStreamReader *soundStreamReader = NULL;
+
+// streams started and not yet destroyed, whether still playing or not
+static SimpleVector<StreamedSound*> soundSpriteStreams;
 
 
 static SDL_Cursor *ourCursor = NULL;
 
 
+
+#ifdef HEADLESS_REPLAY
+
+// Headless replay plays a recorded game back as fast as possible, with
+// no window, no sound, and the null gameGraphics backend.
+//
+// Usage:
+//   gameApp [-replay file] [-checkpoint N]
+//           [-writeCheckpoints file | -compareCheckpoints file]
+//
+// Every N frames, a checkpoint hashes everything drawn since the last one,
+// along with the game's state snapshot (if the game has set snapshot
+// functions), and writes the hashes or compares them against those
+// written by an earlier replay.
+//
+// Exits with 0 when the recording plays out, 1 on the first checkpoint
+// that differs, or 2 if the recording can't be played back.
+
+
+static const char *headlessLogFileName = "log.txt";
+
+// 0 for no checkpoints
+static int checkpointInterval = 0;
+
+static FILE *checkpointOutFile = NULL;
+static FILE *checkpointCompareFile = NULL;
+
+static int headlessFramesPlayed = 0;
+static int checkpointsPassed = 0;
+
+static double headlessStartTime = 0;
+
+static unsigned char *( *headlessSaveSnapshot )( int *outLength ) = NULL;
+
+
+
+static char parseHeadlessReplayArgs( int inNumArgs, char **inArgs ) {
+    for( int i=1; i<inNumArgs; i++ ) {
+        const char *flag = inArgs[i];
+        
+        if( i + 1 >= inNumArgs ) {
+            printf( "Missing value for %s\n", flag );
+            return false;
+            }
+        const char *value = inArgs[ ++i ];
+        
+        if( strcmp( flag, "-replay" ) == 0 ) {
+            ScreenGL::setPlaybackFile( value );
+            headlessLogFileName = autoSprintf( "%s.log", value );
+            }
+        else if( strcmp( flag, "-checkpoint" ) == 0 ) {
+            checkpointInterval = atoi( value );
+            }
+        else if( strcmp( flag, "-writeCheckpoints" ) == 0 ) {
+            checkpointOutFile = fopen( value, "w" );
+            
+            if( checkpointOutFile == NULL ) {
+                printf( "Failed to open %s\n", value );
+                return false;
+                }
+            }
+        else if( strcmp( flag, "-compareCheckpoints" ) == 0 ) {
+            checkpointCompareFile = fopen( value, "r" );
+            
+            if( checkpointCompareFile == NULL ) {
+                printf( "Failed to open %s\n", value );
+                return false;
+                }
+            }
+        else {
+            printf( "Unknown option %s\n", flag );
+            printf( "Usage:  %s [-replay file] [-checkpoint N] "
+                    "[-writeCheckpoints file | -compareCheckpoints file]\n",
+                    inArgs[0] );
+            return false;
+            }
+        }
+
+    if( checkpointInterval <= 0 &&
+        ( checkpointOutFile != NULL || checkpointCompareFile != NULL ) ) {
+        // checkpoint once a minute at 60 fps by default
+        checkpointInterval = 3600;
+        }
+    
+    return true;
+    }
+
+
+
+static void printHeadlessReplayReport() {
+    double seconds = Time::getCurrentTime() - headlessStartTime;
+
+    if( seconds <= 0 ) {
+        seconds = 0.001;
+        }
+    
+    DrawCallCounts counts = getDrawCallCounts();
+    
+    printf( "Replayed %d frames in %.3f sec (%.1f fps)\n",
+            headlessFramesPlayed, seconds, headlessFramesPlayed / seconds );
+    printf( "Draw calls:  %u (%u sprites, %u quads, %u triangles), "
+            "%u state changes, %u sprites loaded\n",
+            counts.drawCalls, counts.spritesDrawn, counts.quadsDrawn,
+            counts.trianglesDrawn, counts.stateChanges, counts.liveSprites );
+
+    if( checkpointCompareFile != NULL ) {
+        printf( "%d checkpoints matched\n", checkpointsPassed );
+        }
+    else if( checkpointOutFile != NULL ) {
+        printf( "%d checkpoints written\n", checkpointsPassed );
+        }
+    
+    AppLog::infoF( "Headless replay of %d frames took %.3f sec",
+                   headlessFramesPlayed, seconds );
+    }
+
+
+
+// writes or compares a checkpoint for the current frame
+// exits on the first difference
+static void headlessCheckpoint() {
+    unsigned int drawHash = getDrawHash();
+    resetDrawHash();
+
+    char *stateDigest;
+    
+    if( headlessSaveSnapshot != NULL ) {
+        int length;
+        unsigned char *snapshot = headlessSaveSnapshot( &length );
+        
+        stateDigest = computeSHA1Digest( snapshot, length );
+        delete [] snapshot;
+        }
+    else {
+        stateDigest = stringDuplicate( "-" );
+        }
+    
+
+    if( checkpointOutFile != NULL ) {
+        fprintf( checkpointOutFile, "%d %08x %s\n", 
+                 headlessFramesPlayed, drawHash, stateDigest );
+        }
+    else if( checkpointCompareFile != NULL ) {
+        int refFrame;
+        unsigned int refDrawHash;
+        char refStateDigest[41];
+        
+        int numRead = fscanf( checkpointCompareFile, "%d %x %40s",
+                              &refFrame, &refDrawHash, refStateDigest );
+        
+        if( numRead != 3 || refFrame != headlessFramesPlayed ) {
+            printf( "Divergence at frame %d:  "
+                    "reference has no checkpoint here\n",
+                    headlessFramesPlayed );
+            delete [] stateDigest;
+            exit( 1 );
+            }
+        
+        char drawSame = ( refDrawHash == drawHash );
+        char stateSame = ( strcmp( refStateDigest, stateDigest ) == 0 );
+        
+        if( !drawSame || !stateSame ) {
+            printf( "Divergence between frames %d and %d:  %s differs\n",
+                    headlessFramesPlayed - checkpointInterval + 1,
+                    headlessFramesPlayed,
+                    drawSame ? "game state" : 
+                    ( stateSame ? "drawing" : "drawing and game state" ) );
+            delete [] stateDigest;
+            exit( 1 );
+            }
+        }
+
+    delete [] stateDigest;
+    checkpointsPassed++;
+    }
+
+
+
+// called at the end of each frame drawn
+static void headlessFrameDone() {
+    if( ! screen->isPlayingBack() ) {
+        // recording has played out
+
+        if( checkpointCompareFile != NULL ) {
+            int refFrame;
+            if( fscanf( checkpointCompareFile, "%d", &refFrame ) == 1 ) {
+                printf( "Divergence at frame %d:  recording ended, "
+                        "but reference goes on to frame %d\n",
+                        headlessFramesPlayed, refFrame );
+                exit( 1 );
+                }
+            }
+        exit( 0 );
+        }
+    
+    headlessFramesPlayed++;
+
+    if( checkpointInterval > 0 &&
+        headlessFramesPlayed % checkpointInterval == 0 &&
+        ( checkpointOutFile != NULL || checkpointCompareFile != NULL ) ) {
+        headlessCheckpoint();
+        }
+    }
+
+#endif
+
+
+
 // function that destroys object when exit is called.
 // exit is the only way to stop the loop in  ScreenGL
 void cleanUpAtExit() {
 
+#ifdef HEADLESS_REPLAY
+    printHeadlessReplayReport();
+    
+    if( checkpointOutFile != NULL ) {
+        fclose( checkpointOutFile );
+        checkpointOutFile = NULL;
+        }
+    if( checkpointCompareFile != NULL ) {
+        fclose( checkpointCompareFile );
+        checkpointCompareFile = NULL;
+        }
+#endif
+
     if( ourCursor != NULL ) {
         SDL_FreeCursor( ourCursor );
         }
     
     AppLog::info( "exiting...\n" );
 
+    // needs GL context for frames still being read back
+    stopFrameCapture();
+
     if( soundOpen ) {
         AppLog::info( "exiting: calling SDL_CloseAudio\n" );
         SDL_CloseAudio();
@@ -583,19 +845,49 @@ void cleanUpAtExit() {
     AppLog::info( "exiting: Deleting sceneHandler\n" );
     delete sceneHandler;
 
+    if( asyncFileReader != NULL ) {
+        // waits for reads in progress
+        delete asyncFileReader;
+        asyncFileReader = NULL;
+        }
+
+
 
+    int decodedBytes, streamingBytes, mappedBytes;
+    getSoundSpriteMemoryUsage( &decodedBytes, &streamingBytes, &mappedBytes );
+    AppLog::infoF( "Sound sprites hold %d KiB decoded, %d KiB streaming, "
+                   "%d KiB mapped\n", decodedBytes / 1024,
+                   streamingBytes / 1024, mappedBytes / 1024 );
 
     AppLog::info( "Freeing sound sprites\n" );
+
+    // audio thread closed above, no locking needed
+    soundSpriteMixer.removeAllVoices();
+    while( soundSpriteMixer.getStoppedStream() != NULL ) {
+        }
+    
+    if( soundStreamReader != NULL ) {
+        delete soundStreamReader;
+        soundStreamReader = NULL;
+        }
+    for( int i=0; i<soundSpriteStreams.size(); i++ ) {
+        delete soundSpriteStreams.getElementDirect( i );
+        }
+    soundSpriteStreams.deleteAll();
+
     for( int i=0; i<soundSprites.size(); i++ ) {
         SoundSprite *s = soundSprites.getElementDirect( i );
-        delete [] s->samples;
+        if( s->samples != NULL ) {
+            SoundSpriteMixer::freeSamples( s->samples );
+            }
+        if( s->file != NULL ) {
+            delete s->file;
+            }
         delete s;
         }
     soundSprites.deleteAll();
-    playingSoundSprites.deleteAll();
-    playingSoundSpriteRates.deleteAll();
-    playingSoundSpriteVolumesL.deleteAll();
-    playingSoundSpriteVolumesR.deleteAll();
+    soundSpriteDecodedBytes = 0;
+    soundSpriteMappedBytes = 0;
     
     if( bufferSizeHinted ) {
         freeHintedBuffers();
@@ -630,13 +922,6 @@ void cleanUpAtExit() {
         screenShotPrefix = NULL;
         }
 
-    if( lastFrame_rgbaBytes != NULL ) {
-        AppLog::info( "exiting: deleting lastFrame_rgbaBytes\n" ); 
-        
-        delete [] lastFrame_rgbaBytes;
-        lastFrame_rgbaBytes = NULL;
-        }
-
 
     if( recordAudio ) {
         AppLog::info( "exiting: closing audio output file\n" ); 
@@ -654,20 +939,29 @@ void cleanUpAtExit() {
         delete r->request;
         }
 
+    // closes kept-alive connections
+    WebConnectionPool::freeSharedPool();
+
+    for( int i=0; i<spriteLoadBatches.size(); i++ ) {
+        // workers may be reading from asset archive
+        freeSpriteLoadBatch( i );
+        }
+    spriteLoadBatches.deleteAll();
+
+    // after sound sprites, which may hold views of it
+    if( assetArchive != NULL ) {
+        SettingsManager::setAssetSource( NULL );
+        TranslationManager::setAssetSource( NULL );
+        
+        delete assetArchive;
+        assetArchive = NULL;
+        }
+
     if( webProxy != NULL ) {
         delete [] webProxy;
         webProxy = NULL;
         }
 
-    if( soundSpriteMixingBufferL != NULL ) {
-        delete [] soundSpriteMixingBufferL;
-        }
-    
-    if( soundSpriteMixingBufferR != NULL ) {
-        delete [] soundSpriteMixingBufferR;
-        }
-    
-    
     AppLog::info( "exiting: Done.\n" );
     }
 
@@ -746,42 +1040,122 @@ SoundSpriteHandle loadSoundSprite( const char *inAIFFFileName ) {
     }
 
 
+// sounds compressed in the asset archive can't be mapped, so they are
+// decoded now, like sprites set from memory
+static SoundSpriteHandle loadCompressedSoundSprite( 
+    const char *inFolderName,
+    const char *inAIFFFileName ) {
+    
+    int length;
+    char copied;
+    unsigned char *data = getArchivedFile( inFolderName, inAIFFFileName,
+                                           &length, &copied );
+    
+    if( data == NULL ) {
+        printf( "Failed to read sound file: %s\n", inAIFFFileName );
+        return NULL;
+        }
+    
+    SoundSpriteHandle result = NULL;
+
+    int numSamples;
+    int offset = findMono16AIFFSamples( data, length, &numSamples );
+    
+    if( offset == -1 ) {
+        printf( "Failed to parse AIFF sound file: %s\n", inAIFFFileName );
+        }
+    else {
+        int16_t *samples = new int16_t[ numSamples ];
+        convertBigEndian16( &( data[ offset ] ), numSamples, samples );
+        
+        result = setSoundSprite( samples, numSamples );
+
+        delete [] samples;
+        }
+    
+    if( copied ) {
+        delete [] data;
+        }
+    return result;
+    }
+
+
+
 SoundSpriteHandle loadSoundSprite( const char *inFolderName,
                                    const char *inAIFFFileName ) {
     
-    File aiffFile( new Path( inFolderName ), inAIFFFileName );
+    // samples are decoded straight from the mapping when first played
+    MappedFile *file = NULL;
+    
+    if( assetArchive != NULL ) {
+        char *assetName = autoSprintf( "%s/%s", inFolderName, 
+                                       inAIFFFileName );
+        
+        // view of archive's mapping
+        file = assetArchive->mapEntry( assetName );
+        
+        char compressed = ( file == NULL && 
+                            assetArchive->contains( assetName ) );
+        
+        delete [] assetName;
 
-    if( ! aiffFile.exists() ) {
-        printf( "File does not exist in sounds folder: %s\n", 
-                inAIFFFileName );
-        return NULL;
+        if( compressed ) {
+            return loadCompressedSoundSprite( inFolderName, 
+                                              inAIFFFileName );
+            }
         }
     
-    int numBytes;
-    unsigned char *data = aiffFile.readFileContents( &numBytes );
+    if( file == NULL ) {
+        File aiffFile( new Path( inFolderName ), inAIFFFileName );
+
+        if( ! aiffFile.exists() ) {
+            printf( "File does not exist in sounds folder: %s\n", 
+                    inAIFFFileName );
+            return NULL;
+            }
     
+        file = new MappedFile( &aiffFile );
+        }
 
-    if( data == NULL ) {
+    if( file->getData() == NULL ) {
         printf( "Failed to read sound file: %s\n", inAIFFFileName );
+        delete file;
         return NULL;
         }
 
 
     int numSamples;
-    int16_t *samples = readMono16AIFFData( data, numBytes, &numSamples );
+    int offset = findMono16AIFFSamples( file->getData(), file->getLength(),
+                                        &numSamples );
     
-    delete [] data;
-    
-    if( samples == NULL ) {
+    if( offset == -1 ) {
         printf( "Failed to parse AIFF sound file: %s\n", inAIFFFileName );
+        delete file;
         return NULL;
         }
 
-    SoundSpriteHandle s = setSoundSprite( samples, numSamples );
+    SoundSprite *s = new SoundSprite;
     
-    delete [] samples;
+    s->handle = nextSoundSpriteHandle ++;
+    s->numSamples = numSamples;
+    s->noVariance = false;
+    s->samples = NULL;
+    s->file = file;
+    s->fileSampleOffset = offset;
+    s->streamed = ( numSamples > STREAMED_SOUND_SPRITE_SAMPLES );
+    s->lessRecent = NULL;
+    s->moreRecent = NULL;
+    s->pinned = false;
+
+    if( s->streamed ) {
+        file->adviseSequential();
+        }
+
+    soundSpriteMappedBytes += file->getLength();
+
+    soundSprites.push_back( s );
     
-    return s;
+    return (SoundSpriteHandle)s;
     }
 
 
@@ -793,14 +1167,20 @@ SoundSpriteHandle setSoundSprite( int16_t *inSamples, int inNumSamples ) {
     s->numSamples = inNumSamples;
     
     s->noVariance = false;
-
-    s->samplesPlayed = 0;
-    s->samplesPlayedF = 0;
     
-    s->samples = new Sint16[ s->numSamples ];
+    s->samples = SoundSpriteMixer::allocSamples( s->numSamples );
     
     memcpy( s->samples, inSamples, inNumSamples * sizeof( int16_t ) );
 
+    s->file = NULL;
+    s->fileSampleOffset = 0;
+    s->streamed = false;
+    s->lessRecent = NULL;
+    s->moreRecent = NULL;
+    s->pinned = false;
+
+    soundSpriteDecodedBytes += inNumSamples * (int)sizeof( int16_t );
+
     soundSprites.push_back( s );
     
     return (SoundSpriteHandle)s;
@@ -815,6 +1195,208 @@ void toggleVariance( SoundSpriteHandle inHandle, char inNoVariance ) {
 
 
 
+// removes a decoded sprite from the cache's play order
+static void unlinkSoundSprite( SoundSprite *inSprite ) {
+    if( inSprite->lessRecent != NULL ) {
+        inSprite->lessRecent->moreRecent = inSprite->moreRecent;
+        }
+    else if( leastRecentSoundSprite == inSprite ) {
+        leastRecentSoundSprite = inSprite->moreRecent;
+        }
+    else {
+        // not in the list
+        return;
+        }
+    
+    if( inSprite->moreRecent != NULL ) {
+        inSprite->moreRecent->lessRecent = inSprite->lessRecent;
+        }
+    else {
+        mostRecentSoundSprite = inSprite->lessRecent;
+        }
+    
+    inSprite->lessRecent = NULL;
+    inSprite->moreRecent = NULL;
+    }
+
+
+
+// makes a decoded sprite the most recently played
+static void touchSoundSprite( SoundSprite *inSprite ) {
+    if( mostRecentSoundSprite == inSprite ) {
+        return;
+        }
+    unlinkSoundSprite( inSprite );
+    
+    inSprite->lessRecent = mostRecentSoundSprite;
+    if( mostRecentSoundSprite != NULL ) {
+        mostRecentSoundSprite->moreRecent = inSprite;
+        }
+    else {
+        leastRecentSoundSprite = inSprite;
+        }
+    mostRecentSoundSprite = inSprite;
+    }
+
+
+
+// drops decoded samples of sprites loaded from files, least recently
+// played first, until inBytesNeeded more fit under the cache limit
+// sprites that are playing or pinned are kept
+// must not be called with audio locked
+static void dropDecodedSoundSprites( int inBytesNeeded ) {
+    if( soundSpriteDecodedBytes + inBytesNeeded <= soundSpriteCacheLimit ||
+        leastRecentSoundSprite == NULL ) {
+        return;
+        }
+    
+    SimpleVector<int16_t*> dropped;
+    
+    // isPlaying needs lock, and voices can't start while we drop
+    lockAudio();
+    
+    SoundSprite *s = leastRecentSoundSprite;
+    
+    while( s != NULL && 
+           soundSpriteDecodedBytes + inBytesNeeded > soundSpriteCacheLimit ) {
+
+        SoundSprite *next = s->moreRecent;
+        
+        if( ! s->pinned && ! soundSpriteMixer.isPlaying( s->handle ) ) {
+            unlinkSoundSprite( s );
+            dropped.push_back( s->samples );
+            s->samples = NULL;
+            soundSpriteDecodedBytes -= s->numSamples * (int)sizeof( int16_t );
+            }
+        s = next;
+        }
+    
+    unlockAudio();
+    
+    for( int i=0; i<dropped.size(); i++ ) {
+        SoundSpriteMixer::freeSamples( dropped.getElementDirect( i ) );
+        }
+    }
+
+
+
+void setSoundSpriteCacheLimit( int inBytes ) {
+    soundSpriteCacheLimit = inBytes;
+    dropDecodedSoundSprites( 0 );
+    }
+
+
+
+void getSoundSpriteMemoryUsage( int *outDecodedBytes, 
+                                int *outStreamingBytes,
+                                int *outMappedBytes ) {
+    *outDecodedBytes = soundSpriteDecodedBytes;
+
+    *outStreamingBytes = 0;
+    for( int i=0; i<soundSpriteStreams.size(); i++ ) {
+        *outStreamingBytes += 
+            soundSpriteStreams.getElementDirect( i )->getBufferBytes();
+        }
+    
+    *outMappedBytes = soundSpriteMappedBytes;
+    }
+
+
+
+// destroys streams whose voices have finished or been removed
+// must not be called with audio locked
+static void destroyStoppedSoundStreams() {
+    if( soundSpriteStreams.size() == 0 ) {
+        return;
+        }
+    
+    SimpleVector<MixerStream*> stopped;
+    
+    lockAudio();
+    MixerStream *m = soundSpriteMixer.getStoppedStream();
+    while( m != NULL ) {
+        stopped.push_back( m );
+        m = soundSpriteMixer.getStoppedStream();
+        }
+    unlockAudio();
+    
+    for( int i=0; i<stopped.size(); i++ ) {
+        StreamedSound *stream = (StreamedSound*)stopped.getElementDirect( i );
+        
+        soundStreamReader->removeStream( stream );
+        soundSpriteStreams.deleteElementEqualTo( stream );
+        delete stream;
+        }
+    }
+
+
+
+// gets a sprite ready to play, decoding its samples if needed
+// for streamed sprites, returns a new stream with its first samples
+// buffered, or NULL for others
+// decoding happens here, on the main thread, the first time a sprite
+// plays (and after it is dropped from the cache), which costs about half
+// a millisecond per two seconds of sound when its pages are cached
+// must not be called with audio locked
+static StreamedSound *prepareSoundSprite( SoundSprite *inSprite ) {
+    
+    if( inSprite->streamed ) {
+        StreamedSound *stream = new StreamedSound( inSprite->file, 
+                                                   inSprite->fileSampleOffset,
+                                                   inSprite->numSamples );
+        stream->fill( STREAMED_SOUND_SPRITE_PREFILL );
+        return stream;
+        }
+    
+    if( inSprite->samples == NULL ) {
+        int numBytes = inSprite->numSamples * (int)sizeof( int16_t );
+        
+        dropDecodedSoundSprites( numBytes );
+        
+        inSprite->samples = 
+            SoundSpriteMixer::allocSamples( inSprite->numSamples );
+        
+        convertBigEndian16( 
+            &( inSprite->file->getData()[ inSprite->fileSampleOffset ] ),
+            inSprite->numSamples, inSprite->samples );
+
+        // decoded copy replaces the file's pages
+        inSprite->file->releaseRange( inSprite->fileSampleOffset, numBytes );
+        
+        soundSpriteDecodedBytes += numBytes;
+        }
+    
+    if( inSprite->file != NULL ) {
+        touchSoundSprite( inSprite );
+        }
+    
+    return NULL;
+    }
+
+
+
+// hands a stream whose voice started to the reader thread, or
+// destroys it if its voice didn't start
+static void startSoundStream( StreamedSound *inStream, char inStarted ) {
+    if( inStream == NULL ) {
+        return;
+        }
+    
+    if( ! inStarted ) {
+        delete inStream;
+        return;
+        }
+
+    if( soundStreamReader == NULL ) {
+        soundStreamReader = new SoundStreamReader();
+        }
+    
+    soundSpriteStreams.push_back( inStream );
+    soundStreamReader->addStream( inStream );
+    }
+
+
+
 
 static double maxTotalSoundSpriteVolume = 1.0;
 
@@ -887,8 +1469,11 @@ static double pickRandomVolume() {
 
 
 // no locking
-static void playSoundSpriteInternal( 
-    SoundSpriteHandle inHandle, double inVolumeTweak,
+// inStream from prepareSoundSprite
+// returns true if sprite started playing
+static char playSoundSpriteInternal( 
+    SoundSpriteHandle inHandle, StreamedSound *inStream,
+    double inVolumeTweak,
     double inStereoPosition, 
     double inForceVolume = -1,
     double inForceRate = -1 ) {    
@@ -896,21 +1481,21 @@ static void playSoundSpriteInternal(
 
     if( soundSpritesFading && soundSpriteGlobalLoudness == 0.0f ) {
         // don't play any new sound sprites
-        return;
+        return false;
         }
 
     if( maxSimultaneousSoundSprites != -1 &&
-        playingSoundSpriteVolumesR.size() >= maxSimultaneousSoundSprites ) {
+        soundSpriteMixer.getNumVoices() >= maxSimultaneousSoundSprites ) {
         // cap would be exceeded
         // don't play this sound sprite at all
-        return;
+        return false;
         }
 
 
     double volume = inVolumeTweak;
     
     SoundSprite *s = (SoundSprite*)inHandle;
-    
+
     if( ! s->noVariance ) {
         
         if( inForceVolume == -1 ) {
@@ -933,31 +1518,27 @@ static void playSoundSpriteInternal(
     double leftVolume = volume * cos( p );
 
 
-    s->samplesPlayed = 0;
-    s->samplesPlayedF = 0;
-
-
-
+    double rate = 1.0;
     
-    playingSoundSprites.push_back( *s );
-
-    if( s->noVariance ) {
-        playingSoundSpriteRates.push_back( 1.0 );
-        }
-    else {
+    if( ! s->noVariance ) {
         
         if( inForceRate != -1 ) {
-            playingSoundSpriteRates.push_back( inForceRate );
+            rate = inForceRate;
             }
         else { 
-            playingSoundSpriteRates.push_back(  pickRandomRate() );
+            rate = pickRandomRate();
             }
         }
     
-    
-    
-    playingSoundSpriteVolumesR.push_back( rightVolume );
-    playingSoundSpriteVolumesL.push_back( leftVolume );
+    if( inStream != NULL ) {
+        soundSpriteMixer.addStreamVoice( inStream, s->numSamples, rate,
+                                         leftVolume, rightVolume, s->handle );
+        }
+    else {
+        soundSpriteMixer.addVoice( s->samples, s->numSamples, rate,
+                                   leftVolume, rightVolume, s->handle );
+        }
+    return true;
     }
 
 
@@ -965,9 +1546,16 @@ static void playSoundSpriteInternal(
 void playSoundSprite( SoundSpriteHandle inHandle, double inVolumeTweak,
                       double inStereoPosition ) {
     
+    destroyStoppedSoundStreams();
+    
+    StreamedSound *stream = prepareSoundSprite( (SoundSprite*)inHandle );
+    
     lockAudio();
-    playSoundSpriteInternal( inHandle, inVolumeTweak, inStereoPosition );
+    char started = playSoundSpriteInternal( inHandle, stream, inVolumeTweak, 
+                                            inStereoPosition );
     unlockAudio();
+
+    startSoundStream( stream, started );
     }
 
 
@@ -976,6 +1564,21 @@ void playSoundSprite( SoundSpriteHandle inHandle, double inVolumeTweak,
 void playSoundSprite( int inNumSprites, SoundSpriteHandle *inHandles, 
                       double *inVolumeTweaks,
                       double *inStereoPositions ) {
+    
+    destroyStoppedSoundStreams();
+
+    StreamedSound **streams = new StreamedSound*[ inNumSprites ];
+    char *started = new char[ inNumSprites ];
+    
+    // decoding a later sprite must not drop an earlier one from the cache
+    for( int i=0; i<inNumSprites; i++ ) {
+        ( (SoundSprite*)( inHandles[i] ) )->pinned = true;
+        }
+
+    for( int i=0; i<inNumSprites; i++ ) {
+        streams[i] = prepareSoundSprite( (SoundSprite*)( inHandles[i] ) );
+        }
+
     lockAudio();
 
     // one random volume and rate for whole batch
@@ -983,10 +1586,24 @@ void playSoundSprite( int inNumSprites, SoundSpriteHandle *inHandles,
     double rate = pickRandomRate();
 
     for( int i=0; i<inNumSprites; i++ ) {
-        playSoundSpriteInternal( inHandles[i], inVolumeTweaks[i], 
-                                 inStereoPositions[i], volume, rate );
+        started[i] = playSoundSpriteInternal( inHandles[i], streams[i],
+                                              inVolumeTweaks[i], 
+                                              inStereoPositions[i], 
+                                              volume, rate );
         }
     unlockAudio();
+
+    // playing ones are kept by the mixer from here on
+    for( int i=0; i<inNumSprites; i++ ) {
+        ( (SoundSprite*)( inHandles[i] ) )->pinned = false;
+        }
+
+    for( int i=0; i<inNumSprites; i++ ) {
+        startSoundStream( streams[i], started[i] );
+        }
+    
+    delete [] streams;
+    delete [] started;
     }
 
 
@@ -999,198 +1616,55 @@ void freeSoundSprite( SoundSpriteHandle inHandle ) {
     
     SoundSprite *s = (SoundSprite*)inHandle;
 
-    // find it in vector to remove it
-    for( int i=playingSoundSprites.size()-1; i>=0; i-- ) {
-        SoundSprite *s2 = playingSoundSprites.getElement( i );
-        if( s2->handle == s->handle ) {
-            // stop it abruptly
-            playingSoundSprites.deleteElement( i );
-            playingSoundSpriteRates.deleteElement( i );
-            playingSoundSpriteVolumesL.deleteElement( i );
-            playingSoundSpriteVolumesR.deleteElement( i );
-            }
-        }
+    // stop it abruptly
+    soundSpriteMixer.removeVoices( s->handle );
     
     unlockAudio();
 
+    // its streams read from its file
+    destroyStoppedSoundStreams();
+
 
     for( int i=0; i<soundSprites.size(); i++ ) {
         SoundSprite *s2 = soundSprites.getElementDirect( i );
         if( s2->handle == s->handle ) {
-            delete [] s2->samples;
-            soundSprites.deleteElement( i );
-            delete s2;
-            }
-        }
-    }
-
-
-
-
-void audioCallback( void *inUserData, Uint8 *inStream, int inLengthToFill ) {
-    getSoundSamples( inStream, inLengthToFill );
-    
-    int numSamples = inLengthToFill / 4;
-
-    
-    if( playingSoundSprites.size() > 0 ) {
-        
-        for( int i=0; i<numSamples; i++ ) {
-            soundSpriteMixingBufferL[ i ] = 0.0;
-            soundSpriteMixingBufferR[ i ] = 0.0;
-            }
-
-        for( int i=0; i<playingSoundSprites.size(); i++ ) {
-            SoundSprite *s = playingSoundSprites.getElement( i );
-
-            double rate = playingSoundSpriteRates.getElementDirect( i );
-            double volumeL = playingSoundSpriteVolumesL.getElementDirect( i );
-            double volumeR = playingSoundSpriteVolumesR.getElementDirect( i );
-            
-            int filled = 0;
-            
-            //int filledBytes = 0;
-
-            if( rate == 1 ) {
-                
-                int samplesPlayed = s->samplesPlayed;
-                int spriteNumSamples = s->numSamples;
-                
-                while( filled < numSamples &&
-                       samplesPlayed < spriteNumSamples  ) {
-                    
-                    Sint16 sample = s->samples[ samplesPlayed ];
-                    
-                    soundSpriteMixingBufferL[ filled ] 
-                        += volumeL * sample;
-                    
-                    soundSpriteMixingBufferR[ filled ]
-                        += volumeR * sample;
-
-                    filled ++;
-                    samplesPlayed ++;
-                    }
-                s->samplesPlayed = samplesPlayed;
-                }
-            else {
-                double samplesPlayedF = s->samplesPlayedF;
-                int spriteNumSamples = s->numSamples;
-                
-                while( filled < numSamples &&
-                       samplesPlayedF < spriteNumSamples - 1  ) {
-                    
-                    int aIndex = (int)floor( samplesPlayedF );
-                    int bIndex = (int)ceil( samplesPlayedF );
-                    
-                    Sint16 sampleA = s->samples[ aIndex ];
-                    Sint16 sampleB = s->samples[ bIndex ];
-                    
-                    double bWeight = samplesPlayedF - aIndex;
-                    double aWeight = 1 - bWeight;
-
-                    double sampleBlend = sampleA * aWeight + sampleB * bWeight;
-
-                    soundSpriteMixingBufferL[ filled ] 
-                        += volumeL * sampleBlend;
-                    
-                    soundSpriteMixingBufferR[ filled ]
-                        += volumeR * sampleBlend;
-
-                    filled ++;
-                    samplesPlayedF += rate;
-                    }
-                s->samplesPlayedF = samplesPlayedF;
-                }
-            }
-
-
-        // respect their collective volume cap
-        audioNoClip( &soundSpriteNoClip,
-                     soundSpriteMixingBufferL, soundSpriteMixingBufferR,
-                     numSamples );
-
-        // and normalize to compensate for any compression below that cap
-        if( totalSoundSpriteNormalizeFactor != 1.0 ) {
-            for( int i=0; i<numSamples; i++ ) {
-                soundSpriteMixingBufferL[i] *= totalSoundSpriteNormalizeFactor;
-                soundSpriteMixingBufferR[i] *= totalSoundSpriteNormalizeFactor;
-                }
-            }
-        
-
-        // now mix them in
-        int filledBytes = 0;
-        
-
-        // next, do final mix, then
-        //  apply global no-clip, for mix of sound sprites and
-        // music or other sounds created by getSoundSamples
-        
-        for( int i=0; i<numSamples; i++ ) {
-            Sint16 lSample = 
-                (Sint16)( (inStream[filledBytes+1] << 8) | 
-                          inStream[filledBytes] );
-            Sint16 rSample = 
-                (Sint16)( (inStream[filledBytes+3] << 8) | 
-                          inStream[filledBytes+2] );
-            
-            filledBytes += 4;
+            unlinkSoundSprite( s2 );
             
-            // apply global loudness to sound sprites as part of this mx
-            soundSpriteMixingBufferL[i] *= soundSpriteGlobalLoudness;
-            soundSpriteMixingBufferR[i] *= soundSpriteGlobalLoudness;
-            
-            if( soundSpritesFading ) {
-                soundSpriteGlobalLoudness -= soundSpriteFadeIncrementPerSample;
-                
-                if( soundSpriteGlobalLoudness < 0.0f ) {
-                    soundSpriteGlobalLoudness = 0.0f;
-                    }
+            if( s2->samples != NULL ) {
+                SoundSpriteMixer::freeSamples( s2->samples );
+                soundSpriteDecodedBytes -= 
+                    s2->numSamples * (int)sizeof( int16_t );
                 }
-
-
-            soundSpriteMixingBufferL[i] += lSample;
-            soundSpriteMixingBufferR[i] += rSample;
+            if( s2->file != NULL ) {
+                soundSpriteMappedBytes -= s2->file->getLength();
+                delete s2->file;
+                }
+            soundSprites.deleteElement( i );
+            delete s2;
             }
+        }
+    }
 
 
-        
-        // we have our final mix, make sure it never clips
-        audioNoClip( &totalAudioMixNoClip,
-                     soundSpriteMixingBufferL, soundSpriteMixingBufferR,
-                     numSamples );
-
-        
-        // now convert back to integers
-        filledBytes = 0;
-        for( int i=0; i<numSamples; i++ ) {
-            Sint16 lSample = lrint( soundSpriteMixingBufferL[i] );
-            Sint16 rSample = lrint( soundSpriteMixingBufferR[i] );
 
 
-            inStream[filledBytes++] = (Uint8)( lSample & 0xFF );
-            inStream[filledBytes++] = 
-                (Uint8)( ( lSample >> 8 ) & 0xFF );
-            inStream[filledBytes++] = (Uint8)( rSample & 0xFF );
-            inStream[filledBytes++] = 
-                (Uint8)( ( rSample >> 8 ) & 0xFF );
-            }
+void audioCallback( void *inUserData, Uint8 *inStream, int inLengthToFill ) {
+    getSoundSamples( inStream, inLengthToFill );
+    
+    int numSamples = inLengthToFill / 4;
 
-        // walk backward, removing any that are done
-        // OR remove all if sound sprites are completely faded out
-        for( int i=playingSoundSprites.size()-1; i>=0; i-- ) {
-            SoundSprite *s = playingSoundSprites.getElement( i );
-            
-            if( soundSpriteGlobalLoudness == 0 ||
-                s->samplesPlayed >= s->numSamples ||
-                s->samplesPlayedF >= s->numSamples - 1 ) {
-                
-                playingSoundSprites.deleteElement( i );
-                playingSoundSpriteRates.deleteElement( i );
-                playingSoundSpriteVolumesL.deleteElement( i );
-                playingSoundSpriteVolumesR.deleteElement( i );
-                }
-            }
+    
+    if( soundSpriteMixer.getNumVoices() > 0 ) {
+        
+        // sprites, their volume cap and normalization, global loudness,
+        // and the final no-clip mix with inStream, in one pass
+        soundSpriteMixer.mix( inStream, numSamples,
+                              &soundSpriteNoClip,
+                              totalSoundSpriteNormalizeFactor,
+                              &soundSpriteGlobalLoudness,
+                              soundSpritesFading ? 
+                                  soundSpriteFadeIncrementPerSample : 0,
+                              &totalAudioMixNoClip );
         }
     
     // now apply global loudness fade for pause
@@ -1511,11 +1985,20 @@ int mainFunction( int inNumArgs, char **inArgs ) {
 #endif
 
 
+#ifdef HEADLESS_REPLAY
+    if( ! parseHeadlessReplayArgs( inNumArgs, inArgs ) ) {
+        return 1;
+        }
+
+    // no window or sound device
+    Uint32 flags = SDL_INIT_NOPARACHUTE;
+#else
     // check result below, after opening log, so we can log failure
     Uint32 flags = SDL_INIT_VIDEO | SDL_INIT_NOPARACHUTE;
     if( getUsesSound() ) {
         flags |= SDL_INIT_AUDIO;
         }
+#endif
     
     int sdlResult = SDL_Init( flags );
 
@@ -1659,7 +2142,12 @@ int mainFunction( int inNumArgs, char **inArgs ) {
 
         
 
+#ifdef HEADLESS_REPLAY
+    // parallel replays each log beside their own recording
+    AppLog::setLog( new FileLog( headlessLogFileName ) );
+#else
     AppLog::setLog( new FileLog( "log.txt" ) );
+#endif
     AppLog::setLoggingLevel( Log::DETAIL_LEVEL );
     
     AppLog::info( "New game starting up" );
@@ -1683,6 +2171,28 @@ int mainFunction( int inNumArgs, char **inArgs ) {
         gameWidth, gameHeight );
 
 
+    // packed game data, checked before loose files from here on
+    File assetArchiveFile( NULL, "assets.pack" );
+    
+    if( assetArchiveFile.exists() ) {
+        assetArchive = new AssetArchive( &assetArchiveFile );
+        
+        if( assetArchive->isOpen() ) {
+            AppLog::infoF( "Using asset archive with %d files",
+                           assetArchive->getNumEntries() );
+            
+            SettingsManager::setAssetSource( assetArchive );
+            TranslationManager::setAssetSource( assetArchive );
+            }
+        else {
+            AppLog::error( "Failed to open assets.pack, "
+                           "using loose files" );
+            delete assetArchive;
+            assetArchive = NULL;
+            }
+        }
+
+
     // read screen size from settings
     char widthFound = false;
     int readWidth = SettingsManager::getIntSetting( "screenWidth", 
@@ -1751,6 +2261,10 @@ int mainFunction( int inNumArgs, char **inArgs ) {
         }
 
 
+#ifndef HEADLESS_REPLAY
+    // no screen to fit to for headless replay, and recordings specify
+    // their own window size anyway
+    
     if( !fullscreen && useLargestWindow ) {
         AppLog::info( "Want to use largest window that fits on screen." );
 
@@ -1879,6 +2393,7 @@ int mainFunction( int inNumArgs, char **inArgs ) {
                            screenWidth, screenHeight );
             }
         }
+#endif
     
     
 
@@ -1973,6 +2488,29 @@ int mainFunction( int inNumArgs, char **inArgs ) {
     blendOutputFrameFraction = 
         SettingsManager::getFloatSetting( "blendOutputFrameFraction", 0.0f );
 
+    outputFrameWorkers = 
+        SettingsManager::getIntSetting( "outputFrameWorkers", 2 );
+    outputFrameQueueLength = 
+        SettingsManager::getIntSetting( "outputFrameQueueLength", 8 );
+
+    if( outputFrameQueueLength < 1 ) {
+        outputFrameQueueLength = 1;
+        }
+
+    int outputFramesDropWhenBehindFlag = 
+        SettingsManager::getIntSetting( "outputFramesDropWhenBehind", 0 );
+    
+    if( outputFramesDropWhenBehindFlag == 1 ) {
+        outputFramesDropWhenBehind = true;
+        }
+
+    int outputFramesY4MFlag = 
+        SettingsManager::getIntSetting( "outputFramesY4M", 0 );
+    
+    if( outputFramesY4MFlag == 1 ) {
+        outputFramesY4M = true;
+        }
+
     webProxy = SettingsManager::getStringSetting( "webProxy" );
     
     if( webProxy != NULL && 
@@ -2018,6 +2556,8 @@ int mainFunction( int inNumArgs, char **inArgs ) {
                    "fullscreen(%d)",
                    screenWidth, screenHeight, targetFrameRate, fullscreen );
 
+    recordingGame = recordGame;
+
     screen =
         new ScreenGL( screenWidth, screenHeight, fullscreen, 
                       shouldNativeScreenResolutionBeUsed(),
@@ -2040,6 +2580,14 @@ int mainFunction( int inNumArgs, char **inArgs ) {
     AppLog::infoF( "ScreenGL gave us %dx%d, %d fps",
                    screenWidth, screenHeight, targetFrameRate );
 
+#ifdef HEADLESS_REPLAY
+    if( ! screen->isPlayingBack() ) {
+        printf( "No recorded game to play back, see log file %s\n",
+                headlessLogFileName );
+        return 2;
+        }
+#endif
+
 
     // call this again here, because screenWidth or screenHeight might
     // have changed from what we requested
@@ -2056,6 +2604,8 @@ int mainFunction( int inNumArgs, char **inArgs ) {
     // watch out for huge resolutions that make default SDL cursor
     // too small
 
+#ifndef HEADLESS_REPLAY
+    // no pointer to show for headless replay
     int forceBigPointer = SettingsManager::getIntSetting( "forceBigPointer",
                                                           0 );
     if( forceBigPointer ||
@@ -2122,6 +2672,7 @@ int mainFunction( int inNumArgs, char **inArgs ) {
             AppLog::error( "Failed to read bigPointer.tga" );
             }
         }
+#endif
 
 
 
@@ -2332,7 +2883,13 @@ int mainFunction( int inNumArgs, char **inArgs ) {
         int openResult = 0;
         
         if( ! recordAudioFlag ) {
+#ifdef HEADLESS_REPLAY
+            // no sound device for headless replay
+            SDL_SetError( "Headless replay" );
+            openResult = -1;
+#else
             openResult = SDL_OpenAudio( &audioFormat, &actualFormat );
+#endif
             }
         
 
@@ -2413,11 +2970,6 @@ int mainFunction( int inNumArgs, char **inArgs ) {
 
                 if( !recordAudioFlag ) {
                     soundSampleRate = actualFormat.freq;
-                    
-                    soundSpriteMixingBufferL = 
-                        new double[ actualFormat.samples ];
-                    soundSpriteMixingBufferR = 
-                        new double[ actualFormat.samples ];
                     }
                 
                 
@@ -2465,6 +3017,17 @@ int mainFunction( int inNumArgs, char **inArgs ) {
     if( ! writeFailed ) {    
         demoMode = isDemoMode();
         }
+
+#ifdef HEADLESS_REPLAY
+    // no one to enter a demo code
+    demoMode = false;
+#else
+    // before any sprites are loaded
+    SpriteGL::toggleAtlasPacking(
+        SettingsManager::getIntSetting( "spriteAtlas", 1 ) );
+    SpriteGL::toggleBatching(
+        SettingsManager::getIntSetting( "spriteBatching", 1 ) );
+#endif
     
 
     
@@ -2523,8 +3086,12 @@ int mainFunction( int inNumArgs, char **inArgs ) {
         }
     
 
+#ifdef HEADLESS_REPLAY
+    headlessStartTime = Time::getCurrentTime();
+#else
     // default texture mode
     glTexEnvf( GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE );
+#endif
 
     
     screen->start();
@@ -2551,10 +3118,12 @@ GameSceneHandler::GameSceneHandler( ScreenGL *inScreen )
       mBackgroundColor( 0, 0, 0, 1 ) { 
     
     
+#ifndef HEADLESS_REPLAY
     glClearColor( mBackgroundColor.r,
                   mBackgroundColor.g,
                   mBackgroundColor.b,
                   mBackgroundColor.a );
+#endif
     
 
     // set external pointer so it can be used in calls below
@@ -2608,6 +3177,10 @@ static float visibleHeight = -1;
 
 
 static void redoDrawMatrix() {
+#ifndef HEADLESS_REPLAY
+    // queued sprites go out with the old projection
+    SpriteGL::flushBatch();
+    
     // viewport square centered on screen (even if screen is rectangle)
     float hRadius = viewSize / 2;
     
@@ -2650,6 +3223,7 @@ static void redoDrawMatrix() {
         }
     
     glMatrixMode(GL_MODELVIEW);
+#endif
     }
 
 
@@ -2695,6 +3269,26 @@ char isGamePlayingBack() {
 
 
 
+void setRecordingSnapshotFunctions( 
+    unsigned char *( *inSave )( int *outLength ),
+    char ( *inRestore )( unsigned char *inSnapshot, int inLength ) ) {
+    
+    screen->setSnapshotFunctions( inSave, inRestore );
+
+#ifdef HEADLESS_REPLAY
+    // for checkpoints
+    headlessSaveSnapshot = inSave;
+#endif
+    }
+
+
+
+int seekGamePlayback( int inFrame ) {
+    return screen->seekPlayback( inFrame );
+    }
+
+
+
 
 
 
@@ -2894,6 +3488,32 @@ void saveFrameRateSettings() {
 
 
 
+#ifndef HEADLESS_REPLAY
+
+static SpriteBatchStats lastPrintedBatchStats = { 0, 0, 0, 0, 0, 0, 0 };
+
+// prints batching since the last call, along with frame rate
+static void printSpriteBatchStats() {
+    SpriteBatchStats total = SpriteGL::getTotalBatchStats();
+    
+    int frames = total.frames - lastPrintedBatchStats.frames;
+    int batches = total.batches - lastPrintedBatchStats.batches;
+    int quads = total.quads - lastPrintedBatchStats.quads;
+    
+    if( frames > 0 && batches > 0 ) {
+        printf( "Sprite batches = %.1f per frame (%.1f sprites each, "
+                "%d atlas pages)\n",
+                batches / (double)frames, quads / (double)batches,
+                SpriteGL::getNumAtlasPages() );
+        }
+    
+    lastPrintedBatchStats = total;
+    }
+
+#endif
+
+
+
 void GameSceneHandler::drawScene() {
     numPixelsDrawn = 0;
     /*
@@ -2929,6 +3549,10 @@ void GameSceneHandler::drawScene() {
             //    Log::DETAIL_LEVEL,
             printf(
                 "Frame rate = %f frames/second\n", actualFrameRate );
+
+#ifndef HEADLESS_REPLAY
+            printSpriteBatchStats();
+#endif
             
             mFrameBatchStartTimeSeconds = game_getCurrentTime();
 
@@ -2953,8 +3577,10 @@ void GameSceneHandler::drawScene() {
     redoDrawMatrix();
 
 
+#ifndef HEADLESS_REPLAY
 	glDisable( GL_CULL_FACE );
     glDisable( GL_DEPTH_TEST );
+#endif
 
 
     if( demoMode ) {
@@ -3147,6 +3773,7 @@ void GameSceneHandler::drawScene() {
             // check if we are ultrawidescreen
             char ultraWide = false;
             
+#ifndef HEADLESS_REPLAY
             const SDL_VideoInfo* currentScreenInfo = SDL_GetVideoInfo();
         
             int currentW = currentScreenInfo->current_w;
@@ -3159,6 +3786,7 @@ void GameSceneHandler::drawScene() {
             if( aspectRatio > 18.0 / 9.0 ) {
                 ultraWide = true;
                 }
+#endif
 
             // we no longer do this, because ultrawide cursor placement
             // issues have been fixed, allowing ultrawide monitors to use
@@ -3217,6 +3845,10 @@ void GameSceneHandler::drawScene() {
         char update = !mPaused;
         
         drawFrame( update );
+
+        flushSocketSendQueues();
+
+        destroyStoppedSoundStreams();
         
         if( cursorMode > 0 ) {
             // draw emulated cursor
@@ -3306,9 +3938,6 @@ void GameSceneHandler::drawScene() {
             if( !bufferSizeHinted ) {
                 hintBufferSize( numSampleBytes );
 
-                soundSpriteMixingBufferL = new double[ samplesPerFrame ];
-                soundSpriteMixingBufferR = new double[ samplesPerFrame ];
-
                 bufferSizeHinted = true;
                 }
 
@@ -3380,6 +4009,9 @@ void GameSceneHandler::drawScene() {
             
             
             // mouse coordinates in screen space
+#ifndef HEADLESS_REPLAY
+            SpriteGL::flushBatch();
+            
             glMatrixMode(GL_PROJECTION);
             glLoadIdentity();
             
@@ -3405,6 +4037,7 @@ void GameSceneHandler::drawScene() {
                         bigDimension );
 
             glMatrixMode(GL_MODELVIEW);
+#endif
 
 
             double verts[8] = 
@@ -3488,6 +4121,9 @@ void GameSceneHandler::drawScene() {
         // thus, to be safe, we keep glScissor off and manually draw letterboxes
         // just in case glViewport doesn't clip the image.
     
+#ifndef HEADLESS_REPLAY
+        SpriteGL::flushBatch();
+        
         glMatrixMode(GL_PROJECTION);
         glLoadIdentity();
             
@@ -3513,6 +4149,7 @@ void GameSceneHandler::drawScene() {
                     bigDimension );
     
         glMatrixMode(GL_MODELVIEW);
+#endif
 
         setDrawColor( 0, 0, 0, 1.00 );
 
@@ -3562,6 +4199,10 @@ void GameSceneHandler::drawScene() {
         }
     
 
+#ifndef HEADLESS_REPLAY
+    SpriteGL::endBatchFrame();
+#endif
+
     if( shouldTakeScreenshot ) {
         takeScreenShot();
 
@@ -3572,6 +4213,10 @@ void GameSceneHandler::drawScene() {
         manualScreenShot = false;
         }
 
+#ifdef HEADLESS_REPLAY
+    headlessFrameDone();
+#endif
+
     frameNumber ++;
     //printf( "%d pixels drawn (%.2F MB textures resident)\n", 
     //        numPixelsDrawn, totalLoadedTextureBytes / ( 1024.0 * 1024.0 ) );
@@ -4119,20 +4764,58 @@ static Image *readTGAFile( File *inFile ) {
 
 
 
-Image *readTGAFile( const char *inTGAFileName ) {
+// checks asset archive, then loose files
+// inFolderName can be NULL for files named from the game folder
+static Image *readTGAFile( const char *inFolderName, 
+                           const char *inTGAFileName ) {
+    int length;
+    char copied;
+    unsigned char *data = getArchivedFile( inFolderName, inTGAFileName,
+                                           &length, &copied );
+    
+    if( data == NULL ) {
+        Path *path = NULL;
+        if( inFolderName != NULL ) {
+            path = new Path( inFolderName );
+            }
+        File tgaFile( path, inTGAFileName );
+    
+        return readTGAFile( &tgaFile );
+        }
+    
+    ByteBufferInputStream tgaStream( data, length );
+    
+    TGAImageConverter converter;
+    
+    Image *result = converter.deformatImage( &tgaStream );
+
+    if( copied ) {
+        delete [] data;
+        }
 
-    File tgaFile( new Path( "graphics" ), inTGAFileName );
+    if( result == NULL ) {
+        char *logString = autoSprintf( 
+            "CRITICAL ERROR:  could not read TGA file %s from asset "
+            "archive, wrong format?",
+            inTGAFileName );
+        
+        AppLog::criticalError( logString );
+        delete [] logString;
+        }
     
-    return readTGAFile( &tgaFile );
+    return result;
     }
 
 
 
-Image *readTGAFileBase( const char *inTGAFileName ) {
+Image *readTGAFile( const char *inTGAFileName ) {
+    return readTGAFile( "graphics", inTGAFileName );
+    }
 
-    File tgaFile( NULL, inTGAFileName );
-    
-    return readTGAFile( &tgaFile );
+
+
+Image *readTGAFileBase( const char *inTGAFileName ) {
+    return readTGAFile( NULL, inTGAFileName );
     }
 
 
@@ -4189,20 +4872,55 @@ static RawRGBAImage *readTGAFileRaw( File *inFile ) {
 
 
 
-RawRGBAImage *readTGAFileRaw( const char *inTGAFileName ) {
+// checks asset archive, then loose files
+// inFolderName can be NULL for files named from the game folder
+static RawRGBAImage *readTGAFileRaw( const char *inFolderName, 
+                                     const char *inTGAFileName ) {
+    int length;
+    char copied;
+    unsigned char *data = getArchivedFile( inFolderName, inTGAFileName,
+                                           &length, &copied );
+    
+    if( data == NULL ) {
+        Path *path = NULL;
+        if( inFolderName != NULL ) {
+            path = new Path( inFolderName );
+            }
+        File tgaFile( path, inTGAFileName );
+    
+        return readTGAFileRaw( &tgaFile );
+        }
+    
+    // straight from archive's bytes
+    RawRGBAImage *result = TGAImageConverter::deformatBytes( data, length );
+
+    if( copied ) {
+        delete [] data;
+        }
 
-    File tgaFile( new Path( "graphics" ), inTGAFileName );
+    if( result == NULL ) {
+        char *logString = autoSprintf( 
+            "CRITICAL ERROR:  could not read TGA file %s from asset "
+            "archive, wrong format?",
+            inTGAFileName );
+        
+        AppLog::criticalError( logString );
+        delete [] logString;
+        }
     
-    return readTGAFileRaw( &tgaFile );
+    return result;
     }
 
 
 
-RawRGBAImage *readTGAFileRawBase( const char *inTGAFileName ) {
+RawRGBAImage *readTGAFileRaw( const char *inTGAFileName ) {
+    return readTGAFileRaw( "graphics", inTGAFileName );
+    }
 
-    File tgaFile( NULL, inTGAFileName );
-    
-    return readTGAFileRaw( &tgaFile );
+
+
+RawRGBAImage *readTGAFileRawBase( const char *inTGAFileName ) {
+    return readTGAFileRaw( NULL, inTGAFileName );
     }
 
 
@@ -4211,9 +4929,7 @@ RawRGBAImage *readTGAFileRawBase( const char *inTGAFileName ) {
 RawRGBAImage *readTGAFileRawFromBuffer( unsigned char *inBuffer, 
                                         int inLength ) {
     
-    ByteBufferInputStream tgaStream( inBuffer, inLength );
-    
-    return readTGAFileRaw( &tgaStream );
+    return TGAImageConverter::deformatBytes( inBuffer, inLength );
     }
 
 
@@ -4246,88 +4962,232 @@ SpriteHandle fillSprite( RawRGBAImage *inRawImage ) {
 
 
 
+// corner transparency found from bytes, the same as fillSprite( Image* )
+// finds it from doubles
+static SpriteHandle fillSpriteFromRaw( RawRGBAImage *inRawImage,
+                                       char inTransparentLowerLeftCorner ) {
+    if( !inTransparentLowerLeftCorner ) {
+        return fillSprite( inRawImage );
+        }
+    
+    DecodedSprite decoded;
+    SpriteDecodeBatch::decode( inRawImage, true, false, &decoded );
+
+    if( decoded.rgba == NULL ) {
+        printf( "Sprite not a 3- or 4-channel image, "
+                "failed to load.\n" );
+        return NULL;
+        }
+    
+    SpriteHandle sprite = fillSprite( decoded.rgba, 
+                                      decoded.width, decoded.height );
+    
+    delete [] decoded.rgba;
+
+    return sprite;
+    }
+
+
+
 SpriteHandle loadSprite( const char *inTGAFileName,
                          char inTransparentLowerLeftCorner ) {
     
-    if( !inTransparentLowerLeftCorner ) {
-        // faster to load raw, avoid double conversion
-        RawRGBAImage *spriteImage = readTGAFileRaw( inTGAFileName );
+    // load raw, and avoid double conversion even with trans corner
+    RawRGBAImage *spriteImage = readTGAFileRaw( inTGAFileName );
         
-        if( spriteImage != NULL ) {
+    if( spriteImage == NULL ) {
+        printf( "Failed to load sprite from graphics/%s\n",
+                inTGAFileName );
+        return NULL;
+        }
+    
+    SpriteHandle result = fillSpriteFromRaw( spriteImage, 
+                                             inTransparentLowerLeftCorner );
+            
+    delete spriteImage;
             
-            SpriteHandle result = fillSprite( spriteImage );
+    return result;
+    }
+
+
+
+SpriteHandle loadSpriteBase( const char *inTGAFileName,
+                             char inTransparentLowerLeftCorner ) {
+    
+    RawRGBAImage *spriteImage = readTGAFileRawBase( inTGAFileName );
+        
+    if( spriteImage == NULL ) {
+        printf( "Failed to load sprite from %s\n",
+                inTGAFileName );
+        return NULL;
+        }
+    
+    SpriteHandle result = fillSpriteFromRaw( spriteImage, 
+                                             inTransparentLowerLeftCorner );
             
-            delete spriteImage;
+    delete spriteImage;
             
-            return result;
-            }
-        else {
-            printf( "Failed to load sprite from graphics/%s\n",
-                    inTGAFileName );
-            return NULL;
-            }
+    return result;
+    }
+
+
+
+
+// reads on worker threads
+static RawRGBAImage *readSpriteFileRaw( const char *inTGAFileName ) {
+    return readTGAFileRaw( "graphics", inTGAFileName );
+    }
+
+
+
+int startSpriteLoadBatch( int inNumFiles, const char **inTGAFileNames,
+                          char inTransparentLowerLeftCorner,
+                          SpriteLoadProgressCallback inCallback,
+                          void *inCallbackExtraParam ) {
+    
+    SpriteLoadBatch *b = new SpriteLoadBatch;
+    
+    // radii found on workers even if cropping is off, because fillSprite
+    // knows whether to use them
+    b->decoder = new SpriteDecodeBatch( 
+        inNumFiles, inTGAFileNames, inTransparentLowerLeftCorner, true,
+        readSpriteFileRaw,
+        SettingsManager::getIntSetting( "spriteDecodeThreads", -1 ) );
+    
+    b->sprites = new SpriteHandle[ inNumFiles ];
+    for( int i=0; i<inNumFiles; i++ ) {
+        b->sprites[i] = NULL;
         }
+    
+    b->numDone = 0;
+    b->callback = inCallback;
+    b->callbackExtraParam = inCallbackExtraParam;
+    
+    spriteLoadBatches.push_back( b );
+    
+    return spriteLoadBatches.size() - 1;
+    }
 
-    // or if trans corner, load converted to doubles for processing
 
-    Image *result = readTGAFile( inTGAFileName );
-        
-    if( result == NULL ) {
+
+static SpriteLoadBatch *getSpriteLoadBatch( int inBatchHandle ) {
+    if( inBatchHandle < 0 || inBatchHandle >= spriteLoadBatches.size() ) {
         return NULL;
         }
-    else {
-        
-        SpriteHandle sprite = fillSprite( result, 
-                                          inTransparentLowerLeftCorner );
+    return spriteLoadBatches.getElementDirect( inBatchHandle );
+    }
+
 
-        delete result;
-        return sprite;
+
+static void fillDecodedSprite( SpriteLoadBatch *inBatch, 
+                               DecodedSprite *inDecoded ) {
+    if( inDecoded->rgba != NULL ) {
+        inBatch->sprites[ inDecoded->index ] = 
+            fillSprite( inDecoded->rgba, 
+                        inDecoded->width, inDecoded->height,
+                        inDecoded->coloredRadii );
+        }
+    else if( inDecoded->width == 0 ) {
+        printf( "Failed to load sprite from graphics/%s\n",
+                inBatch->decoder->getFileName( inDecoded->index ) );
         }
+    else {
+        printf( "Sprite not a 4-channel image, "
+                "failed to load.\n" );
+        }
+    
+    SpriteDecodeBatch::freeDecodedSprite( inDecoded );
+    
+    inBatch->numDone++;
     }
 
 
 
-SpriteHandle loadSpriteBase( const char *inTGAFileName,
-                             char inTransparentLowerLeftCorner ) {
-    if( !inTransparentLowerLeftCorner ) {
-        // faster to load raw, avoid double conversion
-        RawRGBAImage *spriteImage = readTGAFileRawBase( inTGAFileName );
+char stepSpriteLoadBatch( int inBatchHandle, double inBudgetSeconds ) {
+    SpriteLoadBatch *b = getSpriteLoadBatch( inBatchHandle );
+    
+    if( b == NULL ) {
+        return true;
+        }
+
+    int numTotal = b->decoder->getNumFiles();
+    
+    if( b->numDone == numTotal ) {
+        return true;
+        }
+    
+    double startTime = Time::getCurrentTime();
+    int numDoneAtStart = b->numDone;
+    
+    while( b->numDone < numTotal ) {
+        DecodedSprite *decoded;
         
-        if( spriteImage != NULL ) {
-            
-            SpriteHandle result = fillSprite( spriteImage );
-            
-            delete spriteImage;
-            
-            return result;
+        if( b->numDone == numDoneAtStart ) {
+            // always make progress, even if workers are behind
+            decoded = b->decoder->waitForDecoded();
             }
         else {
-            printf( "Failed to load sprite from %s\n",
-                    inTGAFileName );
-            return NULL;
+            if( Time::getCurrentTime() - startTime >= inBudgetSeconds ) {
+                break;
+                }
+            decoded = b->decoder->takeDecoded();
+            
+            if( decoded == NULL ) {
+                // don't wait on workers for rest of budget
+                break;
+                }
             }
+        
+        fillDecodedSprite( b, decoded );
+        }
+    
+    if( b->callback != NULL ) {
+        b->callback( b->numDone, numTotal, b->callbackExtraParam );
         }
     
-    // or if trans corner, load converted to doubles for processing
+    return ( b->numDone == numTotal );
+    }
 
-    Image *result = readTGAFileBase( inTGAFileName );
-        
-    if( result == NULL ) {
+
+
+int getSpriteLoadBatchProgress( int inBatchHandle ) {
+    SpriteLoadBatch *b = getSpriteLoadBatch( inBatchHandle );
+    
+    if( b == NULL ) {
+        return 0;
+        }
+    return b->numDone;
+    }
+
+
+
+SpriteHandle getSpriteLoadBatchSprite( int inBatchHandle, int inIndex ) {
+    SpriteLoadBatch *b = getSpriteLoadBatch( inBatchHandle );
+    
+    if( b == NULL ) {
         return NULL;
         }
-    else {
-        
-        SpriteHandle sprite = fillSprite( result, 
-                                          inTransparentLowerLeftCorner );
+    return b->sprites[ inIndex ];
+    }
 
-        delete result;
-        return sprite;
+
+
+void freeSpriteLoadBatch( int inBatchHandle ) {
+    SpriteLoadBatch *b = getSpriteLoadBatch( inBatchHandle );
+    
+    if( b == NULL ) {
+        return;
         }
+    
+    delete b->decoder;
+    delete [] b->sprites;
+    delete b;
+    
+    *( spriteLoadBatches.getElement( inBatchHandle ) ) = NULL;
     }
 
 
 
-
 const char *translate( const char *inTranslationKey ) {
     return TranslationManager::translate( inTranslationKey );
     }
@@ -4364,124 +5224,375 @@ void startOutputAllFrames() {
 void stopOutputAllFrames() {
     outputAllFrames = false;
     shouldTakeScreenshot = false;
-    }
 
+    stopFrameCapture();
+    }
 
 
 
 
-// if manualScreenShot false, then any blend settings (for saving blended 
-// double-frames) are applied
-// can return NULL in this case (when this frame should not be output
-// according to blending settings)
-//
-// Region in screen pixels
-static Image *getScreenRegionInternal( 
-    int inStartX, int inStartY, int inWidth, int inHeight,
-    char inForceManual = false ) {    
-        
+// reads back a region of the screen as RGB bytes, bottom row first
+static unsigned char *readScreenBytes( int inStartX, int inStartY,
+                                       int inWidth, int inHeight ) {
     int numBytes = inWidth * inHeight * 3;
-    
-    unsigned char *rgbBytes = 
+
+    unsigned char *rgbBytes =
         new unsigned char[ numBytes ];
 
+#ifdef HEADLESS_REPLAY
+    // nothing drawn
+    memset( rgbBytes, 0, numBytes );
+#else
+    SpriteGL::flushBatch();
+    
     // w and h might not be multiples of 4
     GLint oldAlignment;
     glGetIntegerv( GL_PACK_ALIGNMENT, &oldAlignment );
-                
+
     glPixelStorei( GL_PACK_ALIGNMENT, 1 );
-    
-    glReadPixels( inStartX, inStartY, inWidth, inHeight, 
+
+    glReadPixels( inStartX, inStartY, inWidth, inHeight,
                   GL_RGB, GL_UNSIGNED_BYTE, rgbBytes );
-    
+
     glPixelStorei( GL_PACK_ALIGNMENT, oldAlignment );
+#endif
+
+    return rgbBytes;
+    }
 
 
-    if( ! inForceManual &&
-        ! manualScreenShot && 
-        blendOutputFramePairs && 
-        frameNumber % 2 != 0 && 
-        lastFrame_rgbaBytes != NULL ) {
-        
-        // save blended frames on odd frames
-        if( blendOutputFrameFraction > 0 ) {
-            float blendA = 1 - blendOutputFrameFraction;
-            float blendB = blendOutputFrameFraction;
-            
-            for( int i=0; i<numBytes; i++ ) {
-                rgbBytes[i] = 
-                    (unsigned char)(
-                        blendA * rgbBytes[i] + 
-                        blendB * lastFrame_rgbaBytes[i] );
-                }
+
+// output frames are read into pixel pack buffers, alternating between two,
+// so glReadPixels returns right away and each frame is copied out one
+// frame later, after the GPU is done with it
+//
+// Buffer functions are GL 1.5, so they are looked up at runtime, and
+// we fall back to plain glReadPixels without them.
+#if !defined(HEADLESS_REPLAY) && !defined(RASPBIAN)
+    #define FRAME_CAPTURE_PBO
+#endif
+
+
+#ifdef FRAME_CAPTURE_PBO
+
+#ifndef APIENTRY
+    #define APIENTRY
+#endif
+
+#define CAPTURE_PIXEL_PACK_BUFFER  0x88EB
+#define CAPTURE_STREAM_READ        0x88E1
+#define CAPTURE_READ_ONLY          0x88B8
+
+typedef void (APIENTRY *GenBuffersFunc)( GLsizei, GLuint * );
+typedef void (APIENTRY *DeleteBuffersFunc)( GLsizei, const GLuint * );
+typedef void (APIENTRY *BindBufferFunc)( GLenum, GLuint );
+typedef void (APIENTRY *BufferDataFunc)( GLenum, ptrdiff_t, const GLvoid *,
+                                         GLenum );
+typedef void *(APIENTRY *MapBufferFunc)( GLenum, GLenum );
+typedef GLboolean (APIENTRY *UnmapBufferFunc)( GLenum );
+
+static GenBuffersFunc captureGenBuffers = NULL;
+static DeleteBuffersFunc captureDeleteBuffers = NULL;
+static BindBufferFunc captureBindBuffer = NULL;
+static BufferDataFunc captureBufferData = NULL;
+static MapBufferFunc captureMapBuffer = NULL;
+static UnmapBufferFunc captureUnmapBuffer = NULL;
+
+static char pboFunctionsChecked = false;
+
+static GLuint framePBOs[2];
+static char framePBOsMade = false;
+static int framePBOWidth = 0;
+static int framePBOHeight = 0;
+
+// which buffer the next frame is read into
+static int nextFramePBO = 0;
+
+// does each buffer hold a frame not copied out yet?
+static char framePBOFull[2] = { false, false };
+
+
+
+static char loadPBOFunctions() {
+    if( ! pboFunctionsChecked ) {
+        pboFunctionsChecked = true;
+
+        captureGenBuffers =
+            (GenBuffersFunc)SDL_GL_GetProcAddress( "glGenBuffers" );
+        captureDeleteBuffers =
+            (DeleteBuffersFunc)SDL_GL_GetProcAddress( "glDeleteBuffers" );
+        captureBindBuffer =
+            (BindBufferFunc)SDL_GL_GetProcAddress( "glBindBuffer" );
+        captureBufferData =
+            (BufferDataFunc)SDL_GL_GetProcAddress( "glBufferData" );
+        captureMapBuffer =
+            (MapBufferFunc)SDL_GL_GetProcAddress( "glMapBuffer" );
+        captureUnmapBuffer =
+            (UnmapBufferFunc)SDL_GL_GetProcAddress( "glUnmapBuffer" );
+
+        if( captureGenBuffers == NULL || captureDeleteBuffers == NULL ||
+            captureBindBuffer == NULL || captureBufferData == NULL ||
+            captureMapBuffer == NULL || captureUnmapBuffer == NULL ) {
+
+            AppLog::info(
+                "No pixel pack buffers, output frames read back "
+                "synchronously\n" );
+            captureGenBuffers = NULL;
             }
-        
         }
-    else if( ! inForceManual &&
-             ! manualScreenShot &&
-             blendOutputFramePairs &&
-             frameNumber % 2 == 0 ) {
-        
-        // skip even frames, but save them for next blending
-        
-        if( lastFrame_rgbaBytes != NULL ) {
-            delete [] lastFrame_rgbaBytes;
-            lastFrame_rgbaBytes = NULL;
+
+    return ( captureGenBuffers != NULL );
+    }
+
+
+
+// copies out a full buffer, leaves no buffer bound
+static unsigned char *copyFramePBO( int inIndex ) {
+    framePBOFull[ inIndex ] = false;
+
+    captureBindBuffer( CAPTURE_PIXEL_PACK_BUFFER, framePBOs[ inIndex ] );
+
+    unsigned char *mapped =
+        (unsigned char*)captureMapBuffer( CAPTURE_PIXEL_PACK_BUFFER,
+                                          CAPTURE_READ_ONLY );
+
+    unsigned char *rgbBytes = NULL;
+
+    if( mapped != NULL ) {
+        int numBytes = framePBOWidth * framePBOHeight * 3;
+
+        rgbBytes = new unsigned char[ numBytes ];
+        memcpy( rgbBytes, mapped, numBytes );
+
+        captureUnmapBuffer( CAPTURE_PIXEL_PACK_BUFFER );
+        }
+
+    captureBindBuffer( CAPTURE_PIXEL_PACK_BUFFER, 0 );
+
+    return rgbBytes;
+    }
+
+
+
+static void freeFramePBOs() {
+    if( framePBOsMade ) {
+        captureDeleteBuffers( 2, framePBOs );
+        framePBOsMade = false;
+        }
+    framePBOFull[0] = false;
+    framePBOFull[1] = false;
+    }
+
+#endif
+
+
+
+// reads back this frame, returns the bytes of this frame, or of an earlier
+// one if reads are delayed, or NULL
+static unsigned char *readOutputFrame( int inWidth, int inHeight ) {
+#ifdef FRAME_CAPTURE_PBO
+    if( loadPBOFunctions() ) {
+
+        if( framePBOsMade &&
+            ( framePBOWidth != inWidth || framePBOHeight != inHeight ) ) {
+            // screen resized, frame in flight is lost
+            freeFramePBOs();
             }
 
-        lastFrame_rgbaBytes = rgbBytes;
-        
+        if( ! framePBOsMade ) {
+            framePBOWidth = inWidth;
+            framePBOHeight = inHeight;
+
+            captureGenBuffers( 2, framePBOs );
+
+            for( int i=0; i<2; i++ ) {
+                captureBindBuffer( CAPTURE_PIXEL_PACK_BUFFER, framePBOs[i] );
+                captureBufferData( CAPTURE_PIXEL_PACK_BUFFER,
+                                   inWidth * inHeight * 3, NULL,
+                                   CAPTURE_STREAM_READ );
+                }
+            captureBindBuffer( CAPTURE_PIXEL_PACK_BUFFER, 0 );
+
+            framePBOsMade = true;
+            nextFramePBO = 0;
+            }
+
+        GLint oldAlignment;
+        glGetIntegerv( GL_PACK_ALIGNMENT, &oldAlignment );
+        glPixelStorei( GL_PACK_ALIGNMENT, 1 );
+
+        captureBindBuffer( CAPTURE_PIXEL_PACK_BUFFER,
+                           framePBOs[ nextFramePBO ] );
+
+        // into buffer, returns without waiting
+        glReadPixels( 0, 0, inWidth, inHeight,
+                      GL_RGB, GL_UNSIGNED_BYTE, NULL );
+
+        captureBindBuffer( CAPTURE_PIXEL_PACK_BUFFER, 0 );
+        glPixelStorei( GL_PACK_ALIGNMENT, oldAlignment );
+
+        framePBOFull[ nextFramePBO ] = true;
+
+        // last frame's buffer is ready by now
+        nextFramePBO = 1 - nextFramePBO;
+
+        if( framePBOFull[ nextFramePBO ] ) {
+            return copyFramePBO( nextFramePBO );
+            }
         return NULL;
         }
-    
+#endif
+
+    return readScreenBytes( 0, 0, inWidth, inHeight );
+    }
+
+
+
+static void startFrameCapture( File *inShotDir ) {
+#ifdef USE_PNG
+    outputFrameWriter = new PNGWriter( false );
+#endif
+
+    frameCapture = new FrameCapture( outputFrameWorkers,
+                                     outputFrameQueueLength,
+                                     outputFramesDropWhenBehind );
+
+    frameCapture->setImageOutput( inShotDir, screenShotPrefix,
+                                  screenShotExtension, nextShotNumber,
+                                  encodeOutputFrame );
+
+    if( blendOutputFramePairs ) {
+        frameCapture->setBlendPairs( blendOutputFrameFraction );
+        }
+
+    if( outputFramesY4M ) {
+        File *y4mFile = inShotDir->getChildFile( "frames.y4m" );
+        char *y4mName = y4mFile->getFullFileName();
+
+        int y4mRate = targetFrameRate;
+        if( blendOutputFramePairs ) {
+            y4mRate /= 2;
+            }
+
+        if( ! frameCapture->setY4MOutput( y4mName, y4mRate ) ) {
+            AppLog::errorF( "Failed to open %s for output frames\n",
+                            y4mName );
+            }
+        delete [] y4mName;
+        delete y4mFile;
+        }
+    }
+
+
+
+static void stopFrameCapture() {
+    if( frameCapture == NULL ) {
+        return;
+        }
+
+#ifdef FRAME_CAPTURE_PBO
+    if( framePBOsMade ) {
+        // last frame read is still in its buffer
+        int lastPBO = 1 - nextFramePBO;
+
+        if( framePBOFull[ lastPBO ] ) {
+            unsigned char *rgbBytes = copyFramePBO( lastPBO );
+
+            if( rgbBytes != NULL ) {
+                frameCapture->submitFrame( rgbBytes,
+                                           framePBOWidth, framePBOHeight );
+                }
+            }
+        freeFramePBOs();
+        }
+#endif
+
+    frameCapture->flush();
+
+    FrameCaptureStats stats = frameCapture->getStats();
+
+    AppLog::infoF( "Output frames:  %d captured, %d written, "
+                   "%d held for blending, %d dropped, %d failed, "
+                   "%d waited on workers (%.2f sec)\n",
+                   stats.submitted, stats.written, stats.held,
+                   stats.dropped, stats.failed, stats.backpressured,
+                   stats.backpressureSeconds );
+
+    nextShotNumber = frameCapture->getNextFileNumber();
+
+    delete frameCapture;
+    frameCapture = NULL;
+
+#ifdef USE_PNG
+    delete outputFrameWriter;
+    outputFrameWriter = NULL;
+#endif
+    }
+
+
+
+static Image *rgbBytesToImage( unsigned char *inRGBBytes,
+                               int inWidth, int inHeight ) {
 
     Image *screenImage = new Image( inWidth, inHeight, 3, false );
 
     double *channelOne = screenImage->getChannel( 0 );
     double *channelTwo = screenImage->getChannel( 1 );
     double *channelThree = screenImage->getChannel( 2 );
-        
+
     // image of screen is upside down
     int outputRow = 0;
     for( int y=inHeight - 1; y>=0; y-- ) {
         for( int x=0; x<inWidth; x++ ) {
-                        
+
             int outputPixelIndex = outputRow * inWidth + x;
-            
-            
+
+
             int regionPixelIndex = y * inWidth + x;
             int byteIndex = regionPixelIndex * 3;
-                
+
             // optimization found:  should unroll this loop over 3 channels
             // divide by 255, with a multiply
-            channelOne[outputPixelIndex] = 
-                rgbBytes[ byteIndex++ ] * 0.003921569;
-            channelTwo[outputPixelIndex] = 
-                rgbBytes[ byteIndex++ ] * 0.003921569;
-            channelThree[outputPixelIndex] = 
-                rgbBytes[ byteIndex++ ] * 0.003921569;
+            channelOne[outputPixelIndex] =
+                inRGBBytes[ byteIndex++ ] * 0.003921569;
+            channelTwo[outputPixelIndex] =
+                inRGBBytes[ byteIndex++ ] * 0.003921569;
+            channelThree[outputPixelIndex] =
+                inRGBBytes[ byteIndex++ ] * 0.003921569;
             }
         outputRow++;
         }
-    
+
+    return screenImage;
+    }
+
+
+
+// Region in screen pixels
+static Image *getScreenRegionInternal(
+    int inStartX, int inStartY, int inWidth, int inHeight ) {
+
+    unsigned char *rgbBytes =
+        readScreenBytes( inStartX, inStartY, inWidth, inHeight );
+
+    Image *screenImage = rgbBytesToImage( rgbBytes, inWidth, inHeight );
+
     delete [] rgbBytes;
 
     return screenImage;
     }
 
 
-Image *getScreenRegionRaw( 
+Image *getScreenRegionRaw(
     int inStartX, int inStartY, int inWidth, int inHeight ) {
 
-    return getScreenRegionInternal( inStartX, inStartY, inWidth, inHeight,
-                                    true );
+    return getScreenRegionInternal( inStartX, inStartY, inWidth, inHeight );
     }
 
 
 
 
 
-static int nextShotNumber = -1;
 static char shotDirExists = false;
 
 static int outputFrameCount = 0;
@@ -4538,6 +5649,27 @@ void takeScreenShot() {
         return;
         }
     
+    if( outputAllFrames && ! manualScreenShot ) {
+        printf( "Output Frame %d (%.2f sec)\n", outputFrameCount, 
+                outputFrameCount / (double) targetFrameRate );
+        outputFrameCount ++;
+        
+        if( frameCapture == NULL ) {
+            startFrameCapture( &shotDir );
+            }
+
+        unsigned char *rgbBytes = 
+            readOutputFrame( screenWidth, screenHeight );
+
+        if( rgbBytes != NULL ) {
+            // blending and file numbering happen in frameCapture
+            frameCapture->submitFrame( rgbBytes, 
+                                       screenWidth, screenHeight );
+            }
+        return;
+        }
+    
+
     char *fileName = autoSprintf( "%s%05d.%s", 
                                   screenShotPrefix, nextShotNumber,
                                   screenShotExtension );
@@ -4549,24 +5681,9 @@ void takeScreenShot() {
     delete [] fileName;
 
     
-    if( outputAllFrames ) {    
-        printf( "Output Frame %d (%.2f sec)\n", outputFrameCount, 
-                outputFrameCount / (double) targetFrameRate );
-        outputFrameCount ++;
-        }
-    
-
     Image *screenImage = 
         getScreenRegionInternal( 0, 0, screenWidth, screenHeight );
 
-    if( screenImage == NULL ) {
-        // a skipped frame due to blending settings
-        delete file;
-        
-        return;
-        }
-    
-
 
     
     
@@ -4596,6 +5713,14 @@ Image *getScreenRegion( double inX, double inY,
     
     // rectangle specified in integer screen coordinates
 
+#ifdef HEADLESS_REPLAY
+    // no GL matrices to project with, but a blank image of the
+    // right size is all that can be read back anyway
+    double winStartX = 0;
+    double winStartY = 0;
+    double winEndX = ( endX - inX ) * screenWidth / viewSize;
+    double winEndY = ( endY - inY ) * screenWidth / viewSize;
+#else
     GLint viewport[4];
     GLdouble modelview[16];
     GLdouble projection[16];
@@ -4614,21 +5739,16 @@ Image *getScreenRegion( double inX, double inY,
     gluProject( endX, endY, 0, 
                 modelview, projection, viewport, 
                 &winEndX, &winEndY, &winEndZ );
+#endif
 
 
 
 
-    char oldManual = manualScreenShot;
-    manualScreenShot = true;
-
-    
     Image *result = 
             getScreenRegionInternal( 
                 lrint( winStartX ), lrint( winStartY ), 
                 lrint( winEndX - winStartX ), lrint( winEndY - winStartY ) );
 
-    manualScreenShot = oldManual;
-    
     return result;
     }
 
@@ -4804,6 +5924,23 @@ unsigned char *getWebResult( int inHandle, int *outSize ) {
 
 
 
+int takeWebResultBytes( int inHandle, unsigned char *outBuffer,
+                        int inMaxBytes ) {
+    if( recordingGame || screen->isPlayingBack() ) {
+        return 0;
+        }
+
+    WebRequest *r = getRequestByHandle( inHandle );
+    
+    if( r != NULL ) {
+        return r->takeResultBytes( outBuffer, inMaxBytes );
+        }
+    
+    return 0;
+    }
+
+
+
 int getWebProgressSize( int inHandle ) {
     if( screen->isPlayingBack() ) {
         // return a recorded server result
@@ -4889,6 +6026,7 @@ int openSocketConnection( const char *inNumericalAddress, int inPort ) {
     SocketConnectionRecord r;
     
     r.handle = nextSocketConnectionHandle;
+    r.sendFailed = false;
     nextSocketConnectionHandle++;
 
 
@@ -4906,6 +6044,14 @@ int openSocketConnection( const char *inNumericalAddress, int inPort ) {
     r.sock = SocketClient::connectToServer( &address, 0, &timedOut );
     
     if( r.sock != NULL ) {
+        // no per-call mode switching, and sends coalesce until the
+        // end of the frame
+        if( ! r.sock->setPersistentNonBlocking() ) {
+            // queueSend needs this mode
+            delete r.sock;
+            return -1;
+            }
+        
         socketConnectionRecords.push_back( r );
         
         return r.handle;
@@ -4917,12 +6063,12 @@ int openSocketConnection( const char *inNumericalAddress, int inPort ) {
 
 
 
-static Socket *getSocketByHandle( int inHandle ) {
+static SocketConnectionRecord *getSocketRecordByHandle( int inHandle ) {
     for( int i=0; i<socketConnectionRecords.size(); i++ ) {
         SocketConnectionRecord *r = socketConnectionRecords.getElement( i );
         
         if( r->handle == inHandle ) {
-            return r->sock;
+            return r;
             }
         }
 
@@ -4932,6 +6078,17 @@ static Socket *getSocketByHandle( int inHandle ) {
     return NULL;
     }
 
+
+
+static Socket *getSocketByHandle( int inHandle ) {
+    SocketConnectionRecord *r = getSocketRecordByHandle( inHandle );
+    
+    if( r != NULL ) {
+        return r->sock;
+        }
+    return NULL;
+    }
+
     
 
 
@@ -4964,16 +6121,23 @@ int sendToSocket( int inHandle, unsigned char *inData, int inDataLength ) {
         }
     
 
-    Socket *sock = getSocketByHandle( inHandle );
+    SocketConnectionRecord *r = getSocketRecordByHandle( inHandle );
     
-    if( sock != NULL ) {
+    if( r != NULL ) {
+        Socket *sock = r->sock;
         
         int numSent = 0;
         
 
-        if( sock->isConnected() ) {
+        int connected = sock->isConnected();
+
+        if( r->sendFailed || connected == -1 ) {
+            numSent = -1;
+            }
+        else if( connected == 1 ) {
             
-            numSent = sock->send( inData, inDataLength, false, false );
+            // goes out with the rest of this frame's sends
+            numSent = sock->queueSend( inData, inDataLength );
             
             if( numSent == -2 ) {
                 // would block
@@ -5087,6 +6251,9 @@ void closeSocket( int inHandle ) {
         SocketConnectionRecord *r = socketConnectionRecords.getElement( i );
         
         if( r->handle == inHandle ) {
+            // last chance for anything queued this frame
+            r->sock->flushSendQueue();
+            
             delete r->sock;
             
             socketConnectionRecords.deleteElement( i );
@@ -5109,46 +6276,47 @@ void closeSocket( int inHandle ) {
 
 
 
-int startAsyncFileRead( const char *inFilePath ) {
-    
-    int handle = nextAsyncFileHandle;
-    nextAsyncFileHandle ++;
-    
-    AsyncFileRecord r = {
-        handle,
-        stringDuplicate( inFilePath ),
-        -1,
-        NULL,
-        false };
+static AsyncFileReader *getAsyncFileReader() {
+    if( asyncFileReader == NULL ) {
+        // a large file no longer holds up small ones queued behind it
+        int numThreads = 
+            SettingsManager::getIntSetting( "asyncFileReadThreads", 4 );
+        
+        // files this large are mapped instead of copied
+        int mapMinBytes = 
+            SettingsManager::getIntSetting( "asyncFileMapMinBytes",
+                                            1048576 );
+        
+        asyncFileReader = new AsyncFileReader( numThreads, mapMinBytes );
+        }
+    return asyncFileReader;
+    }
 
-    asyncLock.lock();
-    asyncFiles.push_back( r );
-    asyncLock.unlock();
-    
-    newFileToReadSem.signal();
-    
-    return handle;
+
+
+int startAsyncFileRead( const char *inFilePath, int inPriority ) {
+    return getAsyncFileReader()->startRead( inFilePath, inPriority );
     }
 
 
 
-char checkAsyncFileReadDone( int inHandle ) {
+void setAsyncFileReadPriority( int inHandle, int inPriority ) {
+    getAsyncFileReader()->setPriority( inHandle, inPriority );
+    }
 
-    char ready = false;
 
-    asyncLock.lock();
 
-    for( int i=0; i<asyncFiles.size(); i++ ) {
-        AsyncFileRecord *r = asyncFiles.getElement( i );
-                    
-        if( r->handle == inHandle &&
-            r->doneReading ) {
-            
-            ready = true;
-            break;
-            }
-        }
-    asyncLock.unlock();
+void cancelAsyncFileRead( int inHandle ) {
+    getAsyncFileReader()->cancel( inHandle );
+    }
+
+
+
+char checkAsyncFileReadDone( int inHandle ) {
+
+    AsyncFileReader *reader = getAsyncFileReader();
+    
+    char ready = reader->isDone( inHandle );
 
 
     if( screen->isPlayingBack() ) {
@@ -5165,23 +6333,7 @@ char checkAsyncFileReadDone( int inHandle ) {
             // so behavior matches recording behavior
             
             // wait for read to finish, synchronously
-            while( !ready ) {                
-                newFileDoneReadingSem.wait();
-
-                asyncLock.lock();
-                
-                for( int i=0; i<asyncFiles.size(); i++ ) {
-                    AsyncFileRecord *r = asyncFiles.getElement( i );
-                    
-                    if( r->handle == inHandle &&
-                        r->doneReading ) {
-                        
-                        ready = true;
-                        break;
-                        }
-                    }
-                asyncLock.unlock();
-                }
+            reader->waitUntilDone( inHandle );
             
             return true;
             }
@@ -5199,30 +6351,19 @@ char checkAsyncFileReadDone( int inHandle ) {
 
 
 unsigned char *getAsyncFileData( int inHandle, int *outDataLength ) {
+    return getAsyncFileReader()->takeData( inHandle, outDataLength );
+    }
 
-    unsigned char *data = NULL;
-    
-    asyncLock.lock();
 
-    for( int i=0; i<asyncFiles.size(); i++ ) {
-        AsyncFileRecord *r = asyncFiles.getElement( i );
-                    
-        if( r->handle == inHandle ) {
-            
-            data = r->data;
-            *outDataLength = r->dataLength;
-            
-            if( r->filePath != NULL ) {
-                delete [] r->filePath;
-                }
 
-            asyncFiles.deleteElement( i );
-            break;
-            }
-        }
-    asyncLock.unlock();
+unsigned char *getAsyncFileDataNoCopy( int inHandle, int *outDataLength ) {
+    return getAsyncFileReader()->getData( inHandle, outDataLength );
+    }
 
-    return data;
+
+
+void releaseAsyncFileData( int inHandle ) {
+    getAsyncFileReader()->release( inHandle );
     }
 
 
@@ -0,0 +1,273 @@
+// Replays many recorded games through a headless replay build of a game
+// (built with HEADLESS_REPLAY = yes), several processes at a time, for
+// regression sweeps.
+//
+// Usage:
+//   replaySweep [-jobs N] [-checkpoint N] [-write | -compare]
+//               ./gameApp recording1 recording2 ...
+//
+// Run from the game's folder.  Each recording R is replayed with
+//   ./gameApp -replay R [-checkpoint N] [-writeCheckpoints R.chk |
+//                                        -compareCheckpoints R.chk]
+// with output going to R.out (and the game's log to R.log).
+//
+// -write records checkpoints from a known-good build, and -compare checks
+// a later build against them.
+//
+// Exits with 0 if every replay finished cleanly.
+
+
+#include "minorGems/util/stringUtils.h"
+#include "minorGems/util/SimpleVector.h"
+#include "minorGems/system/Time.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+
+
+typedef struct Replay {
+        const char *recording;
+
+        pid_t pid;
+        double startTime;
+        double seconds;
+
+        // raw waitpid status, -1 if never started
+        int status;
+    } Replay;
+
+
+
+static pid_t startReplay( const char *inApp, Replay *inReplay,
+                          const char *inCheckpointInterval,
+                          const char *inCheckpointFlag ) {
+
+    char *outName = autoSprintf( "%s.out", inReplay->recording );
+    char *checkpointName = autoSprintf( "%s.chk", inReplay->recording );
+
+    SimpleVector<const char*> args;
+    args.push_back( inApp );
+    args.push_back( "-replay" );
+    args.push_back( inReplay->recording );
+
+    if( inCheckpointInterval != NULL ) {
+        args.push_back( "-checkpoint" );
+        args.push_back( inCheckpointInterval );
+        }
+    if( inCheckpointFlag != NULL ) {
+        args.push_back( inCheckpointFlag );
+        args.push_back( checkpointName );
+        }
+    args.push_back( NULL );
+
+    // so the child doesn't inherit and repeat our buffered output
+    fflush( stdout );
+
+    pid_t pid = fork();
+
+    if( pid == 0 ) {
+        // child
+        if( freopen( outName, "w", stdout ) == NULL ) {
+            _exit( 127 );
+            }
+        dup2( fileno( stdout ), fileno( stderr ) );
+
+        execv( inApp, (char **)args.getElementArray() );
+
+        // only returns on failure
+        printf( "Failed to run %s\n", inApp );
+        _exit( 127 );
+        }
+
+    delete [] outName;
+    delete [] checkpointName;
+
+    return pid;
+    }
+
+
+
+static const char *describeStatus( int inStatus ) {
+    if( inStatus == -1 ) {
+        return "NOT RUN";
+        }
+    if( WIFSIGNALED( inStatus ) ) {
+        return "CRASHED";
+        }
+    switch( WEXITSTATUS( inStatus ) ) {
+        case 0:
+            return "ok";
+        case 1:
+            return "DIVERGED";
+        case 2:
+            return "NO PLAYBACK";
+        default:
+            return "FAILED";
+        }
+    }
+
+
+
+static void usage() {
+    printf( "Usage:  replaySweep [-jobs N] [-checkpoint N] "
+            "[-write | -compare] ./gameApp recording1 recording2 ...\n" );
+    }
+
+
+
+int main( int inNumArgs, char **inArgs ) {
+
+    int numJobs = (int)sysconf( _SC_NPROCESSORS_ONLN );
+    const char *checkpointInterval = NULL;
+    const char *checkpointFlag = NULL;
+
+    int a = 1;
+    while( a < inNumArgs && inArgs[a][0] == '-' ) {
+        if( strcmp( inArgs[a], "-jobs" ) == 0 && a + 1 < inNumArgs ) {
+            numJobs = atoi( inArgs[ a + 1 ] );
+            a += 2;
+            }
+        else if( strcmp( inArgs[a], "-checkpoint" ) == 0 &&
+                 a + 1 < inNumArgs ) {
+            checkpointInterval = inArgs[ a + 1 ];
+            a += 2;
+            }
+        else if( strcmp( inArgs[a], "-write" ) == 0 ) {
+            checkpointFlag = "-writeCheckpoints";
+            a++;
+            }
+        else if( strcmp( inArgs[a], "-compare" ) == 0 ) {
+            checkpointFlag = "-compareCheckpoints";
+            a++;
+            }
+        else {
+            usage();
+            return 1;
+            }
+        }
+
+    if( a + 2 > inNumArgs ) {
+        usage();
+        return 1;
+        }
+    if( numJobs < 1 ) {
+        numJobs = 1;
+        }
+
+    const char *app = inArgs[a];
+    a++;
+
+    int numReplays = inNumArgs - a;
+    Replay *replays = new Replay[ numReplays ];
+
+    for( int i=0; i<numReplays; i++ ) {
+        replays[i].recording = inArgs[ a + i ];
+        replays[i].pid = -1;
+        replays[i].seconds = 0;
+        replays[i].status = -1;
+        }
+
+
+    double startTime = Time::getCurrentTime();
+
+    int nextToStart = 0;
+    int numRunning = 0;
+    int numDone = 0;
+
+    while( numDone < numReplays ) {
+
+        while( numRunning < numJobs && nextToStart < numReplays ) {
+            Replay *r = &( replays[ nextToStart ] );
+            nextToStart++;
+
+            r->startTime = Time::getCurrentTime();
+            r->pid = startReplay( app, r, checkpointInterval,
+                                  checkpointFlag );
+
+            if( r->pid < 0 ) {
+                printf( "Failed to start replay of %s\n", r->recording );
+                numDone++;
+                }
+            else {
+                numRunning++;
+                }
+            }
+
+        if( numRunning == 0 ) {
+            break;
+            }
+
+        int status;
+        pid_t pid = waitpid( -1, &status, 0 );
+
+        if( pid < 0 ) {
+            break;
+            }
+
+        for( int i=0; i<numReplays; i++ ) {
+            Replay *r = &( replays[i] );
+
+            if( r->pid == pid && r->status == -1 ) {
+                r->status = status;
+                r->seconds = Time::getCurrentTime() - r->startTime;
+
+                printf( "[%d/%d] %-12s %8.1f sec  %s\n",
+                        numDone + 1, numReplays,
+                        describeStatus( status ), r->seconds,
+                        r->recording );
+                fflush( stdout );
+
+                numRunning--;
+                numDone++;
+                break;
+                }
+            }
+        }
+
+    double totalSeconds = Time::getCurrentTime() - startTime;
+
+
+    int numFailed = 0;
+    double replaySeconds = 0;
+
+    for( int i=0; i<numReplays; i++ ) {
+        replaySeconds += replays[i].seconds;
+
+        if( replays[i].status == -1 ||
+            WIFSIGNALED( replays[i].status ) ||
+            WEXITSTATUS( replays[i].status ) != 0 ) {
+            numFailed++;
+            }
+        }
+
+    printf( "\n%d of %d replays ok, %d jobs, %.1f sec "
+            "(%.1f sec of replay)\n",
+            numReplays - numFailed, numReplays, numJobs,
+            totalSeconds, replaySeconds );
+
+    if( numFailed > 0 ) {
+        printf( "Failed:\n" );
+
+        for( int i=0; i<numReplays; i++ ) {
+            if( replays[i].status == -1 ||
+                WIFSIGNALED( replays[i].status ) ||
+                WEXITSTATUS( replays[i].status ) != 0 ) {
+                printf( "  %-12s %s  (see %s.out)\n",
+                        describeStatus( replays[i].status ),
+                        replays[i].recording, replays[i].recording );
+                }
+            }
+        }
+
+    delete [] replays;
+
+    if( numFailed > 0 ) {
+        return 1;
+        }
+    return 0;
+    }
@@ -0,0 +1,591 @@
+#include "gameGraphicsNull.h"
+
+#include "minorGems/game/gameGraphics.h"
+
+#include "minorGems/util/SimpleVector.h"
+
+#include <stdio.h>
+
+
+
+static DrawCallCounts counts = { 0, 0, 0, 0, 0, 0 };
+
+
+// FNV-1a
+static unsigned int drawHash = 2166136261U;
+
+
+static void hashBytes( const void *inBytes, int inLength ) {
+    const unsigned char *bytes = (const unsigned char *)inBytes;
+
+    for( int i=0; i<inLength; i++ ) {
+        drawHash ^= bytes[i];
+        drawHash *= 16777619U;
+        }
+    }
+
+
+static void hashInt( int inValue ) {
+    hashBytes( &inValue, sizeof( inValue ) );
+    }
+
+
+
+DrawCallCounts getDrawCallCounts() {
+    return counts;
+    }
+
+
+
+unsigned int getDrawHash() {
+    return drawHash;
+    }
+
+
+
+void resetDrawHash() {
+    drawHash = 2166136261U;
+    }
+
+
+
+
+static float lastR, lastG, lastB, lastA;
+
+
+static char additiveTextureColorMode = false;
+
+
+
+typedef struct GlobalFade {
+        int handle;
+        float fade;
+    } GlobalFade;
+
+
+static int nextFadeHandle = 0;
+
+static SimpleVector<GlobalFade> globalFades;
+
+static float globalFadeTotal = 1.0f;
+
+
+static void recalcGlobalFade() {
+    globalFadeTotal = 1.0f;
+
+    for( int i=0; i<globalFades.size(); i++ ) {
+        globalFadeTotal *=
+            globalFades.getElementDirect( i ).fade;
+        }
+    }
+
+
+
+int addGlobalFade( float inA ) {
+    int h = nextFadeHandle;
+
+    GlobalFade f = { h, inA };
+
+    globalFades.push_back( f );
+
+    nextFadeHandle++;
+
+    recalcGlobalFade();
+
+    return h;
+    }
+
+
+
+void removeGlobalFade( int inHandle ) {
+    for( int i=0; i<globalFades.size(); i++ ) {
+        if( globalFades.getElementDirect( i ).handle == inHandle ) {
+            globalFades.deleteElement( i );
+            break;
+            }
+        }
+
+    recalcGlobalFade();
+    }
+
+
+
+float getTotalGlobalFade() {
+    return globalFadeTotal;
+    }
+
+
+
+// color that drawing would use, with fades applied
+static float drawColor[4] = { 1, 1, 1, 1 };
+
+
+void setDrawColor( float inR, float inG, float inB, float inA ) {
+    lastR = inR;
+    lastG = inG;
+    lastB = inB;
+    lastA = inA;
+
+    if( additiveTextureColorMode &&
+        globalFadeTotal < 1.0f ) {
+
+        // same fade math as the GL backend
+        inR = 1.0f - ( 1.0f - inR ) * globalFadeTotal;
+        inG = 1.0f - ( 1.0f - inG ) * globalFadeTotal;
+        inB = 1.0f - ( 1.0f - inB ) * globalFadeTotal;
+        }
+    else {
+        inA *= globalFadeTotal;
+        }
+
+    drawColor[0] = inR;
+    drawColor[1] = inG;
+    drawColor[2] = inB;
+    drawColor[3] = inA;
+    }
+
+
+
+void setDrawColor( FloatColor inColor ) {
+    setDrawColor( inColor.r, inColor.g, inColor.b, inColor.a );
+    }
+
+
+
+FloatColor getDrawColor() {
+    FloatColor c;
+    c.r = lastR;
+    c.g = lastG;
+    c.b = lastB;
+    c.a = lastA;
+
+    return c;
+    }
+
+
+void setDrawFade( float inA ) {
+    lastA = inA;
+
+    drawColor[0] = lastR;
+    drawColor[1] = lastG;
+    drawColor[2] = lastB;
+    drawColor[3] = inA * globalFadeTotal;
+    }
+
+
+
+
+FloatColor getFloatColor( const char *inHexString ) {
+    int r = 0;
+    int g = 0;
+    int b = 0;
+    sscanf( inHexString, "#%02x%02x%02x", &r, &g, &b );
+
+    FloatColor f = { r / 255.0f,
+                     g / 255.0f,
+                     b / 255.0f,
+                     1.0f };
+
+    return f;
+    }
+
+
+
+
+// state changes are hashed with a tag, so that the same draw calls under
+// different blending hash differently
+enum NullStateTag {
+    NULL_NORMAL_BLEND = 1,
+    NULL_ADDITIVE_BLEND,
+    NULL_MULTIPLICATIVE_BLEND,
+    NULL_ADDITIVE_TEXTURE,
+    NULL_MODULATE_TEXTURE,
+    NULL_SCISSOR_ON,
+    NULL_SCISSOR_OFF,
+    NULL_STENCIL_ADD,
+    NULL_STENCIL_THROUGH,
+    NULL_STENCIL_OFF
+    };
+
+
+static void changeState( NullStateTag inTag ) {
+    counts.stateChanges++;
+    hashInt( inTag );
+    }
+
+
+
+void toggleAdditiveBlend( char inAdditive ) {
+    if( inAdditive ) {
+        changeState( NULL_ADDITIVE_BLEND );
+        }
+    else {
+        changeState( NULL_NORMAL_BLEND );
+        }
+    }
+
+
+
+void toggleMultiplicativeBlend( char inMultiplicative ) {
+    if( inMultiplicative ) {
+        changeState( NULL_MULTIPLICATIVE_BLEND );
+        }
+    else {
+        changeState( NULL_NORMAL_BLEND );
+        }
+    }
+
+
+
+void toggleAdditiveTextureColoring( char inAdditive ) {
+    if( inAdditive ) {
+        changeState( NULL_ADDITIVE_TEXTURE );
+        }
+    else {
+        changeState( NULL_MODULATE_TEXTURE );
+        }
+
+    additiveTextureColorMode = inAdditive;
+    }
+
+
+
+
+static char linearTextureFilterOn = false;
+
+void toggleLinearMagFilter( char inLinearFilterOn ) {
+    linearTextureFilterOn = inLinearFilterOn;
+    }
+
+
+
+char getLinearMagFilterOn() {
+    return linearTextureFilterOn;
+    }
+
+
+
+void toggleMipMapGeneration( char inGenerateMipMaps ) {
+    }
+
+
+
+void toggleMipMapMinFilter( char inMipMapFilterOn ) {
+    }
+
+
+void toggleTransparentCropping( char inCrop ) {
+    }
+
+
+
+
+static void hashDraw( int inNumCoords, double inVertices[],
+                      int inNumColors, float inVertexColors[] ) {
+    counts.drawCalls++;
+
+    hashBytes( inVertices, inNumCoords * sizeof( double ) );
+
+    if( inVertexColors != NULL ) {
+        hashBytes( inVertexColors, inNumColors * sizeof( float ) );
+        }
+    else {
+        hashBytes( drawColor, sizeof( drawColor ) );
+        }
+    }
+
+
+
+void drawQuads( int inNumQuads, double inVertices[] ) {
+    counts.quadsDrawn += inNumQuads;
+    hashDraw( inNumQuads * 8, inVertices, 0, NULL );
+    }
+
+
+
+void drawQuads( int inNumQuads, double inVertices[],
+                float inVertexColors[] ) {
+    counts.quadsDrawn += inNumQuads;
+    hashDraw( inNumQuads * 8, inVertices, inNumQuads * 16, inVertexColors );
+    }
+
+
+
+static int getNumTriangleVerts( int inNumTriangles,
+                                char inStrip, char inFan ) {
+    if( inStrip || inFan ) {
+        return inNumTriangles + 2;
+        }
+    return inNumTriangles * 3;
+    }
+
+
+
+void drawTriangles( int inNumTriangles, double inVertices[],
+                    char inStrip, char inFan ) {
+    counts.trianglesDrawn += inNumTriangles;
+
+    int numVerts = getNumTriangleVerts( inNumTriangles, inStrip, inFan );
+    hashDraw( numVerts * 2, inVertices, 0, NULL );
+    }
+
+
+
+void drawTrianglesColor( int inNumTriangles, double inVertices[],
+                         float inVertexColors[], char inStrip, char inFan ) {
+    counts.trianglesDrawn += inNumTriangles;
+
+    int numVerts = getNumTriangleVerts( inNumTriangles, inStrip, inFan );
+    hashDraw( numVerts * 2, inVertices, numVerts * 4, inVertexColors );
+    }
+
+
+
+void enableScissor( double inX, double inY, double inWidth, double inHeight ) {
+    changeState( NULL_SCISSOR_ON );
+
+    double rect[4] = { inX, inY, inWidth, inHeight };
+    hashBytes( rect, sizeof( rect ) );
+    }
+
+
+
+void disableScissor() {
+    changeState( NULL_SCISSOR_OFF );
+    }
+
+
+
+void startAddingToStencil( char inDrawColorToo, char inAdd,
+                           float inMinAlpha ) {
+    changeState( NULL_STENCIL_ADD );
+    hashInt( inDrawColorToo );
+    hashInt( inAdd );
+    }
+
+
+
+void startDrawingThroughStencil( char inInvertStencil ) {
+    changeState( NULL_STENCIL_THROUGH );
+    hashInt( inInvertStencil );
+    }
+
+
+
+void stopStencil() {
+    disableStencil();
+    }
+
+
+
+void disableStencil() {
+    changeState( NULL_STENCIL_OFF );
+    }
+
+
+
+
+typedef struct NullSprite {
+        // in order of creation, so the same across replays,
+        // unlike sprite addresses
+        int id;
+
+        int width;
+        int height;
+
+        doublePair centerOffset;
+    } NullSprite;
+
+
+static int nextSpriteID = 0;
+
+
+int totalLoadedTextureBytes = 0;
+
+
+static SpriteHandle newSprite( int inWidth, int inHeight,
+                               char inCountBytes ) {
+    NullSprite *s = new NullSprite;
+    s->id = nextSpriteID++;
+    s->width = inWidth;
+    s->height = inHeight;
+    s->centerOffset.x = 0;
+    s->centerOffset.y = 0;
+
+    if( inCountBytes ) {
+        totalLoadedTextureBytes += inWidth * inHeight * 4;
+        }
+    counts.liveSprites++;
+
+    return s;
+    }
+
+
+
+SpriteHandle fillSprite( Image *inImage,
+                         char inTransparentLowerLeftCorner ) {
+    return newSprite( inImage->getWidth(), inImage->getHeight(), true );
+    }
+
+
+
+SpriteHandle fillSprite( unsigned char *inRGBA,
+                         unsigned int inWidth, unsigned int inHeight ) {
+    return newSprite( inWidth, inHeight, true );
+    }
+
+
+
+SpriteHandle fillSprite( unsigned char *inRGBA,
+                         unsigned int inWidth, unsigned int inHeight,
+                         double inColoredRadii[4] ) {
+    return newSprite( inWidth, inHeight, true );
+    }
+
+
+
+SpriteHandle fillSpriteAlphaOnly( unsigned char *inA,
+                                  unsigned int inWidth,
+                                  unsigned int inHeight ) {
+    // the GL backend doesn't count these either
+    return newSprite( inWidth, inHeight, false );
+    }
+
+
+
+void freeSprite( SpriteHandle inSprite ) {
+    NullSprite *s = (NullSprite *)inSprite;
+    totalLoadedTextureBytes -= s->width * s->height * 4;
+    counts.liveSprites--;
+    delete s;
+    }
+
+
+
+int getSpriteWidth( SpriteHandle inSprite ) {
+    return ( (NullSprite *)inSprite )->width;
+    }
+
+
+
+int getSpriteHeight( SpriteHandle inSprite ) {
+    return ( (NullSprite *)inSprite )->height;
+    }
+
+
+
+void setSpriteCenterOffset( SpriteHandle inSprite, doublePair inOffset ) {
+    ( (NullSprite *)inSprite )->centerOffset = inOffset;
+    }
+
+
+
+void setSpriteWrapping( SpriteHandle inSprite,
+                        char inHorizontal, char inVertical ) {
+    }
+
+
+
+
+static char countingPixels = false;
+static double pixelsDrawn = 0;
+
+
+void startCountingSpritePixelsDrawn() {
+    countingPixels = true;
+    pixelsDrawn = 0;
+    }
+
+
+
+double endCountingSpritePixelsDrawn() {
+    countingPixels = false;
+    return pixelsDrawn;
+    }
+
+
+
+// like the GL backend, always count, and zero when asked to start counting
+static double numSpritesDrawn = 0;
+
+
+void startCountingSpritesDrawn() {
+    numSpritesDrawn = 0;
+    }
+
+
+
+double endCountingSpritesDrawn() {
+    return numSpritesDrawn;
+    }
+
+
+
+static void spriteDrawn( SpriteHandle inSprite, double inZoom ) {
+    NullSprite *s = (NullSprite *)inSprite;
+
+    numSpritesDrawn++;
+    counts.spritesDrawn++;
+    counts.drawCalls++;
+
+    if( countingPixels ) {
+        pixelsDrawn += inZoom * s->width * inZoom * s->height;
+        }
+
+    hashInt( s->id );
+    hashBytes( &( s->centerOffset ), sizeof( doublePair ) );
+    }
+
+
+
+void drawSprite( SpriteHandle inSprite, doublePair inCenter,
+                 double inZoom, double inRotation, char inFlipH ) {
+    spriteDrawn( inSprite, inZoom );
+
+    double pos[4] = { inCenter.x, inCenter.y, inZoom, inRotation };
+    hashBytes( pos, sizeof( pos ) );
+    hashInt( inFlipH );
+    hashBytes( drawColor, sizeof( drawColor ) );
+    }
+
+
+
+void drawSprite( SpriteHandle inSprite, doublePair inCenter,
+                 FloatColor inCornerColors[4],
+                 double inZoom, double inRotation, char inFlipH ) {
+    spriteDrawn( inSprite, inZoom );
+
+    double pos[4] = { inCenter.x, inCenter.y, inZoom, inRotation };
+    hashBytes( pos, sizeof( pos ) );
+    hashInt( inFlipH );
+    hashBytes( inCornerColors, 4 * sizeof( FloatColor ) );
+    }
+
+
+
+void drawSprite( SpriteHandle inSprite, doublePair inCornerPos[4],
+                 FloatColor inCornerColors[4] ) {
+    spriteDrawn( inSprite, 1.0 );
+
+    hashBytes( inCornerPos, 4 * sizeof( doublePair ) );
+    hashBytes( inCornerColors, 4 * sizeof( FloatColor ) );
+    }
+
+
+
+void drawSprite( SpriteHandle inSprite, doublePair inCornerPos[4],
+                 doublePair inTexCoords[4] ) {
+    spriteDrawn( inSprite, 1.0 );
+
+    hashBytes( inCornerPos, 4 * sizeof( doublePair ) );
+    hashBytes( inTexCoords, 4 * sizeof( doublePair ) );
+    hashBytes( drawColor, sizeof( drawColor ) );
+    }
+
+
+
+void drawSpriteAlphaOnly( SpriteHandle inSprite, doublePair inCenter,
+                          double inZoom, double inRotation, char inFlipH ) {
+    hashInt( -1 );
+    drawSprite( inSprite, inCenter, inZoom, inRotation, inFlipH );
+    }
@@ -0,0 +1,42 @@
+#ifndef GAME_GRAPHICS_NULL_INCLUDED
+#define GAME_GRAPHICS_NULL_INCLUDED
+
+
+// The null gameGraphics backend implements gameGraphics.h without drawing
+// anything, for headless replay.
+//
+// It counts draw calls and hashes what would have been drawn (positions,
+// colors, sprite sizes, and blend/scissor/stencil state), so that replays
+// can be compared without rendering.
+
+
+
+typedef struct DrawCallCounts {
+        // calls to drawSprite, drawQuads, and drawTriangles functions
+        unsigned int drawCalls;
+
+        unsigned int spritesDrawn;
+        unsigned int quadsDrawn;
+        unsigned int trianglesDrawn;
+
+        // blend, scissor, and stencil changes
+        unsigned int stateChanges;
+
+        // sprites currently loaded
+        unsigned int liveSprites;
+    } DrawCallCounts;
+
+
+
+// totals since the program started
+DrawCallCounts getDrawCallCounts();
+
+
+// hash of everything drawn since the last call to resetDrawHash
+unsigned int getDrawHash();
+
+void resetDrawHash();
+
+
+
+#endif
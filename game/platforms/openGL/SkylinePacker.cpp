@@ -0,0 +1,150 @@
+#include "SkylinePacker.h"
+
+
+
+SkylinePacker::SkylinePacker( int inWidth, int inHeight )
+        : mWidth( inWidth ), mHeight( inHeight ), mUsedArea( 0 ) {
+    reset();
+    }
+
+
+
+void SkylinePacker::reset() {
+    mSkyline.deleteAll();
+
+    SkylineSegment s = { 0, 0, mWidth };
+    mSkyline.push_back( s );
+
+    mUsedArea = 0;
+    }
+
+
+
+int SkylinePacker::fit( int inIndex, int inWidth, int inHeight ) {
+    int numSegments = mSkyline.size();
+
+    int x = mSkyline.getElement( inIndex )->x;
+
+    if( x + inWidth > mWidth ) {
+        return -1;
+        }
+
+    // rectangle rests on the highest segment under it
+    int y = 0;
+    int widthLeft = inWidth;
+    int i = inIndex;
+
+    while( widthLeft > 0 && i < numSegments ) {
+        SkylineSegment *s = mSkyline.getElement( i );
+
+        if( s->y > y ) {
+            y = s->y;
+            }
+        widthLeft -= s->width;
+        i++;
+        }
+
+    if( y + inHeight > mHeight ) {
+        return -1;
+        }
+    return y;
+    }
+
+
+
+void SkylinePacker::place( int inIndex, int inX, int inY,
+                           int inWidth, int inHeight ) {
+
+    SkylineSegment top = { inX, inY + inHeight, inWidth };
+
+    mSkyline.push_middle( top, inIndex );
+
+
+    // trim segments now under the new one
+    int end = inX + inWidth;
+
+    int i = inIndex + 1;
+    while( i < mSkyline.size() ) {
+        SkylineSegment *s = mSkyline.getElement( i );
+
+        if( s->x >= end ) {
+            break;
+            }
+
+        int overlap = end - s->x;
+
+        if( overlap >= s->width ) {
+            mSkyline.deleteElement( i );
+            }
+        else {
+            s->x += overlap;
+            s->width -= overlap;
+            break;
+            }
+        }
+
+
+    // merge neighbors at the same height
+    i = 0;
+    while( i < mSkyline.size() - 1 ) {
+        SkylineSegment *a = mSkyline.getElement( i );
+        SkylineSegment *b = mSkyline.getElement( i + 1 );
+
+        if( a->y == b->y ) {
+            a->width += b->width;
+            mSkyline.deleteElement( i + 1 );
+            }
+        else {
+            i++;
+            }
+        }
+    }
+
+
+
+char SkylinePacker::pack( int inWidth, int inHeight, int *outX, int *outY ) {
+    if( inWidth <= 0 || inHeight <= 0 ||
+        inWidth > mWidth || inHeight > mHeight ) {
+        return false;
+        }
+
+    int bestIndex = -1;
+    int bestTop = mHeight + 1;
+    int bestSegmentWidth = mWidth + 1;
+    int bestY = 0;
+
+    int numSegments = mSkyline.size();
+
+    for( int i=0; i<numSegments; i++ ) {
+        int y = fit( i, inWidth, inHeight );
+
+        if( y < 0 ) {
+            continue;
+            }
+
+        int top = y + inHeight;
+        int segmentWidth = mSkyline.getElementDirect( i ).width;
+
+        if( top < bestTop ||
+            ( top == bestTop && segmentWidth < bestSegmentWidth ) ) {
+            bestIndex = i;
+            bestTop = top;
+            bestSegmentWidth = segmentWidth;
+            bestY = y;
+            }
+        }
+
+    if( bestIndex == -1 ) {
+        return false;
+        }
+
+    int x = mSkyline.getElementDirect( bestIndex ).x;
+
+    place( bestIndex, x, bestY, inWidth, inHeight );
+
+    mUsedArea += inWidth * inHeight;
+
+    *outX = x;
+    *outY = bestY;
+    return true;
+    }
@@ -0,0 +1,91 @@
+#ifndef SKYLINE_PACKER_INCLUDED
+#define SKYLINE_PACKER_INCLUDED
+
+
+#include "minorGems/util/SimpleVector.h"
+
+
+
+// Packs rectangles into a fixed-size bin, for laying out texture atlases.
+//
+// Keeps the skyline, the top edge of everything placed so far, as a list
+// of horizontal segments, and puts each rectangle where its top ends up
+// lowest (bottom-left rule), breaking ties toward the narrower segment.
+//
+// Space is never given back, so the whole bin is reset at once.
+
+
+
+typedef struct SkylineSegment {
+        int x;
+        int y;
+        int width;
+    } SkylineSegment;
+
+
+
+class SkylinePacker {
+    public:
+
+        SkylinePacker( int inWidth, int inHeight );
+
+
+        /**
+         * Finds a place for a rectangle and marks it as used.
+         *
+         * @param inWidth, inHeight the rectangle's size.
+         * @param outX, outY set to the rectangle's corner closest to 0,0.
+         *
+         * @return true if the rectangle fit.
+         */
+        char pack( int inWidth, int inHeight, int *outX, int *outY );
+
+
+        // frees the whole bin
+        void reset();
+
+
+        int getWidth() {
+            return mWidth;
+            }
+
+        int getHeight() {
+            return mHeight;
+            }
+
+
+        // area of rectangles packed since the last reset
+        int getUsedArea() {
+            return mUsedArea;
+            }
+
+        // fraction of the bin covered by packed rectangles
+        double getOccupancy() {
+            return mUsedArea / (double)( mWidth * mHeight );
+            }
+
+
+    protected:
+
+        int mWidth;
+        int mHeight;
+
+        int mUsedArea;
+
+        // left to right, covering the full width
+        SimpleVector<SkylineSegment> mSkyline;
+
+
+        // y where a rectangle starting at segment inIndex would sit,
+        // or -1 if it doesn't fit there
+        int fit( int inIndex, int inWidth, int inHeight );
+
+        // raises the skyline under a rectangle placed at segment inIndex
+        void place( int inIndex, int inX, int inY,
+                    int inWidth, int inHeight );
+
+    };
+
+
+
+#endif
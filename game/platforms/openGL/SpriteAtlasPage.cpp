@@ -0,0 +1,98 @@
+#include "SpriteAtlasPage.h"
+
+#include <string.h>
+
+
+
+SpriteAtlasPage::SpriteAtlasPage( int inWidth, int inHeight, int inGutter )
+        : mWidth( inWidth ), mHeight( inHeight ), mGutter( inGutter ),
+          mRGBA( new unsigned char[ inWidth * inHeight * 4 ] ),
+          mPacker( inWidth, inHeight ),
+          mNumSprites( 0 ) {
+
+    memset( mRGBA, 0, mWidth * mHeight * 4 );
+    }
+
+
+
+SpriteAtlasPage::~SpriteAtlasPage() {
+    delete [] mRGBA;
+    }
+
+
+
+char SpriteAtlasPage::addSprite( unsigned char *inRGBA,
+                                 int inWidth, int inHeight,
+                                 int *outX, int *outY ) {
+
+    int paddedW = inWidth + 2 * mGutter;
+    int paddedH = inHeight + 2 * mGutter;
+
+    int padX, padY;
+
+    if( ! mPacker.pack( paddedW, paddedH, &padX, &padY ) ) {
+        return false;
+        }
+
+    int spriteRowBytes = inWidth * 4;
+    int pageRowBytes = mWidth * 4;
+
+    for( int y=0; y<paddedH; y++ ) {
+        // gutter rows repeat the sprite's first or last row
+        int sourceY = y - mGutter;
+        if( sourceY < 0 ) {
+            sourceY = 0;
+            }
+        else if( sourceY >= inHeight ) {
+            sourceY = inHeight - 1;
+            }
+
+        unsigned char *source = &( inRGBA[ sourceY * spriteRowBytes ] );
+        unsigned char *dest =
+            &( mRGBA[ ( padY + y ) * pageRowBytes + padX * 4 ] );
+
+        // gutter columns repeat the row's first or last pixel
+        for( int g=0; g<mGutter; g++ ) {
+            memcpy( &( dest[ g * 4 ] ), source, 4 );
+            memcpy( &( dest[ ( mGutter + inWidth + g ) * 4 ] ),
+                    &( source[ spriteRowBytes - 4 ] ), 4 );
+            }
+
+        memcpy( &( dest[ mGutter * 4 ] ), source, spriteRowBytes );
+        }
+
+    mNumSprites++;
+
+    *outX = padX + mGutter;
+    *outY = padY + mGutter;
+    return true;
+    }
+
+
+
+void SpriteAtlasPage::removeSprite() {
+    mNumSprites--;
+
+    if( mNumSprites <= 0 ) {
+        mNumSprites = 0;
+
+        mPacker.reset();
+        memset( mRGBA, 0, mWidth * mHeight * 4 );
+        }
+    }
+
+
+
+unsigned char *SpriteAtlasPage::getRegion( int inX, int inY,
+                                           int inWidth, int inHeight ) {
+
+    unsigned char *region = new unsigned char[ inWidth * inHeight * 4 ];
+
+    for( int y=0; y<inHeight; y++ ) {
+        memcpy( &( region[ y * inWidth * 4 ] ),
+                &( mRGBA[ ( ( inY + y ) * mWidth + inX ) * 4 ] ),
+                inWidth * 4 );
+        }
+
+    return region;
+    }
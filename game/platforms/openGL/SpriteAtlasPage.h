@@ -0,0 +1,101 @@
+#ifndef SPRITE_ATLAS_PAGE_INCLUDED
+#define SPRITE_ATLAS_PAGE_INCLUDED
+
+
+#include "SkylinePacker.h"
+
+
+
+// One page of a sprite texture atlas:  RGBA bytes that many small sprites
+// are copied into, laid out by a SkylinePacker.
+//
+// Each sprite is surrounded by a gutter of its own edge texels repeated
+// outward, so linear filtering at a sprite's edge samples what
+// GL_CLAMP_TO_EDGE would have, not its neighbors.
+//
+// No GL here.  SpriteGL keeps a texture in step with the page bytes.
+
+
+
+class SpriteAtlasPage {
+    public:
+
+        // page starts fully transparent
+        SpriteAtlasPage( int inWidth, int inHeight, int inGutter = 2 );
+
+        ~SpriteAtlasPage();
+
+
+        /**
+         * Copies a sprite into the page.
+         *
+         * @param inRGBA the sprite's bytes, top row first.
+         *   Destroyed by caller.
+         * @param inWidth, inHeight the sprite's size.
+         * @param outX, outY set to the sprite's corner in the page,
+         *   not counting the gutter.
+         *
+         * @return true if the sprite fit.
+         */
+        char addSprite( unsigned char *inRGBA, int inWidth, int inHeight,
+                        int *outX, int *outY );
+
+
+        // a sprite copied in earlier is no longer used
+        // when none are left, the page is cleared for reuse
+        void removeSprite();
+
+
+        int getNumSprites() {
+            return mNumSprites;
+            }
+
+
+        /**
+         * Copies a region out of the page.
+         *
+         * @return inWidth * inHeight RGBA bytes, destroyed by caller.
+         */
+        unsigned char *getRegion( int inX, int inY,
+                                  int inWidth, int inHeight );
+
+
+        // all page bytes, owned by page
+        unsigned char *getRGBA() {
+            return mRGBA;
+            }
+
+        int getWidth() {
+            return mWidth;
+            }
+
+        int getHeight() {
+            return mHeight;
+            }
+
+        int getGutter() {
+            return mGutter;
+            }
+
+        double getOccupancy() {
+            return mPacker.getOccupancy();
+            }
+
+
+    protected:
+
+        int mWidth;
+        int mHeight;
+        int mGutter;
+
+        unsigned char *mRGBA;
+
+        SkylinePacker mPacker;
+
+        int mNumSprites;
+
+    };
+
+
+
+#endif
@@ -0,0 +1,139 @@
+#include "SpriteBatch.h"
+
+#include <string.h>
+
+
+
+static void clearStats( SpriteBatchStats *inStats ) {
+    memset( inStats, 0, sizeof( SpriteBatchStats ) );
+    }
+
+
+
+SpriteBatch::SpriteBatch( SpriteBatchBackend *inBackend, int inMaxQuads )
+        : mBackend( inBackend ), mMaxQuads( inMaxQuads ),
+          mBatching( true ),
+          mNumQuads( 0 ),
+          mXY( new float[ inMaxQuads * 8 ] ),
+          mUV( new float[ inMaxQuads * 8 ] ),
+          mRGBA( new float[ inMaxQuads * 16 ] ) {
+
+    memset( &mState, 0, sizeof( mState ) );
+
+    clearStats( &mFrameStats );
+    clearStats( &mLastFrameStats );
+    clearStats( &mTotalStats );
+    }
+
+
+
+SpriteBatch::~SpriteBatch() {
+    delete [] mXY;
+    delete [] mUV;
+    delete [] mRGBA;
+    }
+
+
+
+void SpriteBatch::draw() {
+    mBackend->drawQuads( &mState, mNumQuads, mXY, mUV, mRGBA );
+
+    mFrameStats.batches++;
+    mFrameStats.quads += mNumQuads;
+
+    mNumQuads = 0;
+    }
+
+
+
+void SpriteBatch::prepareQuad( SpriteBatchState *inState ) {
+    if( mNumQuads > 0 ) {
+
+        if( mState.texture != inState->texture ||
+            mState.minFilter != inState->minFilter ||
+            mState.magFilter != inState->magFilter ) {
+
+            mFrameStats.stateBreaks++;
+            draw();
+            }
+        else if( mNumQuads == mMaxQuads ) {
+            mFrameStats.fullBreaks++;
+            draw();
+            }
+        }
+
+    if( mNumQuads == 0 ) {
+        mState = *inState;
+        }
+    }
+
+
+
+void SpriteBatch::addQuad( SpriteBatchState *inState,
+                           const float inXY[8], const float inUV[8],
+                           const float inRGBA[16] ) {
+    prepareQuad( inState );
+
+    memcpy( &( mXY[ mNumQuads * 8 ] ), inXY, 8 * sizeof( float ) );
+    memcpy( &( mUV[ mNumQuads * 8 ] ), inUV, 8 * sizeof( float ) );
+    memcpy( &( mRGBA[ mNumQuads * 16 ] ), inRGBA, 16 * sizeof( float ) );
+
+    mNumQuads++;
+
+    if( ! mBatching ) {
+        draw();
+        }
+    }
+
+
+
+void SpriteBatch::addQuadSolid( SpriteBatchState *inState,
+                                const float inXY[8], const float inUV[8],
+                                const float inRGBA[4] ) {
+    prepareQuad( inState );
+
+    memcpy( &( mXY[ mNumQuads * 8 ] ), inXY, 8 * sizeof( float ) );
+    memcpy( &( mUV[ mNumQuads * 8 ] ), inUV, 8 * sizeof( float ) );
+
+    float *rgba = &( mRGBA[ mNumQuads * 16 ] );
+    for( int v=0; v<4; v++ ) {
+        memcpy( &( rgba[ v * 4 ] ), inRGBA, 4 * sizeof( float ) );
+        }
+
+    mNumQuads++;
+
+    if( ! mBatching ) {
+        draw();
+        }
+    }
+
+
+
+void SpriteBatch::flush() {
+    if( mNumQuads > 0 ) {
+        mFrameStats.flushBreaks++;
+        draw();
+        }
+    }
+
+
+
+void SpriteBatch::endFrame() {
+    mFrameStats.frames = 1;
+
+    mLastFrameStats = mFrameStats;
+
+    mTotalStats.frames++;
+    mTotalStats.batches += mFrameStats.batches;
+    mTotalStats.quads += mFrameStats.quads;
+    mTotalStats.stateBreaks += mFrameStats.stateBreaks;
+    mTotalStats.fullBreaks += mFrameStats.fullBreaks;
+    mTotalStats.flushBreaks += mFrameStats.flushBreaks;
+
+    if( mFrameStats.batches > mTotalStats.maxFrameBatches ) {
+        mTotalStats.maxFrameBatches = mFrameStats.batches;
+        }
+    mLastFrameStats.maxFrameBatches = mFrameStats.batches;
+
+    clearStats( &mFrameStats );
+    }
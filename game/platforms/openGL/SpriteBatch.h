@@ -0,0 +1,187 @@
+#ifndef SPRITE_BATCH_INCLUDED
+#define SPRITE_BATCH_INCLUDED
+
+
+
+// Collects textured quads into one vertex stream, so many sprites that
+// share a texture go out in one draw call instead of one call each.
+//
+// A batch is drawn when a quad arrives with a different texture or filter,
+// when it is full, or when flush is called.  Anything else that changes
+// how quads are drawn (blend mode, stencil, scissor, texture environment,
+// projection) must call flush before it changes.
+//
+// Batches are handed to a SpriteBatchBackend, which does the drawing.  No
+// GL here, so batching can be checked on the CPU with a backend that
+// records what it is given.
+
+
+
+// what must match for quads to share a batch
+typedef struct SpriteBatchState {
+        // compared by pointer only
+        void *texture;
+
+        // 0 for nearest, 1 for linear, 2 for mipmap
+        char minFilter;
+
+        // 0 for nearest, 1 for linear
+        char magFilter;
+    } SpriteBatchState;
+
+
+
+typedef struct SpriteBatchStats {
+        // frames ended with endFrame
+        int frames;
+
+        // batches drawn, which is draw calls
+        int batches;
+
+        int quads;
+
+        // batches ended by a quad with a different texture or filter
+        int stateBreaks;
+
+        // batches ended because no more quads fit
+        int fullBreaks;
+
+        // batches ended by flush
+        int flushBreaks;
+
+        // most batches drawn in one frame
+        int maxFrameBatches;
+    } SpriteBatchStats;
+
+
+
+class SpriteBatchBackend {
+    public:
+
+        virtual ~SpriteBatchBackend() {
+            }
+
+
+        /**
+         * Draws a batch of quads.
+         *
+         * Each quad has 4 vertices in triangle strip order, lower-left,
+         * lower-right, upper-left, upper-right, so quad q is triangles
+         * (4q, 4q+1, 4q+2) and (4q+2, 4q+1, 4q+3).
+         *
+         * @param inState the state all quads share.
+         * @param inNumQuads the number of quads.
+         * @param inXY 2 floats per vertex.
+         * @param inUV 2 floats per vertex.
+         * @param inRGBA 4 floats per vertex.
+         *
+         * Arrays are owned by the batch and only valid during the call.
+         */
+        virtual void drawQuads( SpriteBatchState *inState, int inNumQuads,
+                                float *inXY, float *inUV,
+                                float *inRGBA ) = 0;
+    };
+
+
+
+class SpriteBatch {
+    public:
+
+        /**
+         * @param inBackend draws batches.  Destroyed by caller after
+         *   this batch is destroyed.
+         * @param inMaxQuads the most quads in one batch.
+         */
+        SpriteBatch( SpriteBatchBackend *inBackend, int inMaxQuads = 4096 );
+
+        // pending quads are dropped, not drawn
+        ~SpriteBatch();
+
+
+        /**
+         * Adds a quad, drawing the pending batch first if it can't join.
+         *
+         * @param inState the quad's state, copied.
+         * @param inXY, inUV 4 vertices in triangle strip order, 2 floats
+         *   each.
+         * @param inRGBA 4 floats per vertex.
+         */
+        void addQuad( SpriteBatchState *inState,
+                      const float inXY[8], const float inUV[8],
+                      const float inRGBA[16] );
+
+
+        // same, with one color for all 4 vertices
+        void addQuadSolid( SpriteBatchState *inState,
+                           const float inXY[8], const float inUV[8],
+                           const float inRGBA[4] );
+
+
+        // draws pending quads
+        void flush();
+
+
+        int getNumPendingQuads() {
+            return mNumQuads;
+            }
+
+
+        // when off, each quad is drawn as soon as it's added, as if
+        // every quad had different state
+        // defaults to on
+        void toggleBatching( char inBatching ) {
+            if( ! inBatching ) {
+                flush();
+                }
+            mBatching = inBatching;
+            }
+
+
+        // counts a frame for stats, after its quads are flushed
+        void endFrame();
+
+
+        // stats for the last frame ended, with frames set to 1
+        SpriteBatchStats getLastFrameStats() {
+            return mLastFrameStats;
+            }
+
+        // stats for all frames ended so far
+        SpriteBatchStats getTotalStats() {
+            return mTotalStats;
+            }
+
+
+    protected:
+
+        SpriteBatchBackend *mBackend;
+
+        int mMaxQuads;
+
+        char mBatching;
+
+        SpriteBatchState mState;
+
+        int mNumQuads;
+
+        float *mXY;
+        float *mUV;
+        float *mRGBA;
+
+        // for frame in progress
+        SpriteBatchStats mFrameStats;
+
+        SpriteBatchStats mLastFrameStats;
+        SpriteBatchStats mTotalStats;
+
+
+        void draw();
+
+        // makes room for one more quad with inState
+        void prepareQuad( SpriteBatchState *inState );
+
+    };
+
+
+
+#endif
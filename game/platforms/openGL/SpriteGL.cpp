@@ -13,9 +13,173 @@ char SpriteGL::sStateSet = false;
 
 char SpriteGL::sGenerateMipMaps = false;
 
+char SpriteGL::sAtlasPacking = true;
+
 char SpriteGL::sCountingPixels = false;
 double SpriteGL::sPixelsDrawn = 0;
 
+float SpriteGL::sDrawColor[4] = { 1, 1, 1, 1 };
+
+SimpleVector<SpriteAtlasPageGL *> SpriteGL::sAtlasPages;
+
+
+
+// sprites no bigger than this in either dimension go into atlas pages
+#define ATLAS_MAX_SPRITE_SIZE 128
+
+#define ATLAS_PAGE_SIZE 1024
+
+#define ATLAS_GUTTER 2
+
+
+// fits in GL_UNSIGNED_SHORT indices
+#define BATCH_MAX_QUADS 4096
+
+
+
+static void setTextureFilters( SpriteTextureGL *inTexture,
+                               int inMinFilter, int inMagFilter ) {
+    
+    if( inTexture->lastSetMinFilter != inMinFilter ) {
+        GLint filter = GL_NEAREST;
+        if( inMinFilter == 1 ) {
+            filter = GL_LINEAR;
+            }
+        else if( inMinFilter == 2 ) {
+            filter = GL_LINEAR_MIPMAP_LINEAR;
+            }
+        glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter );
+        inTexture->lastSetMinFilter = inMinFilter;
+        }
+    
+    if( inTexture->lastSetMagFilter != inMagFilter ) {
+        GLint filter = GL_NEAREST;
+        if( inMagFilter == 1 ) {
+            filter = GL_LINEAR;
+            }
+        glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter );
+        inTexture->lastSetMagFilter = inMagFilter;
+        }
+    }
+
+
+
+class SpriteGLBatchBackend : public SpriteBatchBackend {
+    public:
+        
+        SpriteGLBatchBackend() {
+            int i = 0;
+            for( int q=0; q<BATCH_MAX_QUADS; q++ ) {
+                GLushort v = (GLushort)( q * 4 );
+                
+                mIndices[ i++ ] = v;
+                mIndices[ i++ ] = v + 1;
+                mIndices[ i++ ] = v + 2;
+
+                mIndices[ i++ ] = v + 2;
+                mIndices[ i++ ] = v + 1;
+                mIndices[ i++ ] = v + 3;
+                }
+            }
+        
+
+        virtual void drawQuads( SpriteBatchState *inState, int inNumQuads,
+                                float *inXY, float *inUV,
+                                float *inRGBA ) {
+
+            SpriteTextureGL *t = (SpriteTextureGL *)( inState->texture );
+            
+            t->texture->enable();
+            
+            setTextureFilters( t, inState->minFilter, inState->magFilter );
+
+            glVertexPointer( 2, GL_FLOAT, 0, inXY );
+            glTexCoordPointer( 2, GL_FLOAT, 0, inUV );
+    
+            if( !SpriteGL::sStateSet ) {    
+                glEnableClientState( GL_VERTEX_ARRAY );
+                glEnableClientState( GL_TEXTURE_COORD_ARRAY );
+                SpriteGL::sStateSet = true;
+                }
+            
+            glColorPointer( 4, GL_FLOAT, 0, inRGBA );
+            glEnableClientState( GL_COLOR_ARRAY );
+
+            glDrawElements( GL_TRIANGLES, inNumQuads * 6, GL_UNSIGNED_SHORT,
+                            mIndices );
+            
+            glDisableClientState( GL_COLOR_ARRAY );
+            
+            // current color is undefined after drawing with a color array
+            glColor4fv( SpriteGL::sDrawColor );
+            }
+
+    protected:
+        GLushort mIndices[ BATCH_MAX_QUADS * 6 ];
+    };
+
+
+static SpriteGLBatchBackend batchBackend;
+
+static SpriteBatch spriteBatch( &batchBackend, BATCH_MAX_QUADS );
+
+
+
+void SpriteGL::toggleBatching( char inBatching ) {
+    spriteBatch.toggleBatching( inBatching );
+    }
+
+
+
+void SpriteGL::flushBatch() {
+    spriteBatch.flush();
+    }
+
+
+
+void SpriteGL::endBatchFrame() {
+    spriteBatch.flush();
+    spriteBatch.endFrame();
+    }
+
+
+
+SpriteBatchStats SpriteGL::getLastFrameBatchStats() {
+    return spriteBatch.getLastFrameStats();
+    }
+
+
+
+SpriteBatchStats SpriteGL::getTotalBatchStats() {
+    return spriteBatch.getTotalStats();
+    }
+
+
+
+static SpriteTextureGL *newSpriteTexture( SingleTextureGL *inTexture ) {
+    SpriteTextureGL *t = new SpriteTextureGL;
+    
+    t->texture = inTexture;
+    t->lastSetMinFilter = -1;
+    t->lastSetMagFilter = -1;
+
+    return t;
+    }
+
+
+
+void SpriteGL::releaseAtlasSpace( SpriteAtlasPageGL *inPage ) {
+    inPage->page->removeSprite();
+    
+    if( inPage->page->getNumSprites() == 0 ) {
+        delete inPage->texture.texture;
+        delete inPage->page;
+        
+        sAtlasPages.deleteElementEqualTo( inPage );
+        delete inPage;
+        }
+    }
+
 
 
 void SpriteGL::findColoredRadii( Image *inImage ) {
@@ -190,14 +354,131 @@ SpriteGL::SpriteGL( Image *inImage,
  
 
 
+void SpriteGL::makeTexture( unsigned char *inRGBA, 
+                            unsigned int inWidth, unsigned int inHeight ) {
+    mAtlasPage = NULL;
+    
+    mTexOffsetX = 0;
+    mTexOffsetY = 0;
+    mTexScaleX = 1;
+    mTexScaleY = 1;
+    
+    if( ! sAtlasPacking || sGenerateMipMaps ||
+        inWidth > ATLAS_MAX_SPRITE_SIZE || 
+        inHeight > ATLAS_MAX_SPRITE_SIZE ) {
+        
+        mTexture = newSpriteTexture( new SingleTextureGL( inRGBA, 
+                                                          inWidth, inHeight,
+                                                          // no wrap
+                                                          false,
+                                                          sGenerateMipMaps ) );
+        return;
+        }
+    
+
+    // same as what SingleTextureGL does for its own textures
+    SingleTextureGL::expandEdges( inRGBA, inWidth, inHeight );
+
+    int x, y;
+    
+    SpriteAtlasPageGL *page = NULL;
+    
+    // newest page first, older pages can still fill gaps
+    for( int i=sAtlasPages.size() - 1; i >= 0; i-- ) {
+        SpriteAtlasPageGL *p = sAtlasPages.getElementDirect( i );
+        
+        if( p->page->addSprite( inRGBA, inWidth, inHeight, &x, &y ) ) {
+            page = p;
+            break;
+            }
+        }
+    
+    if( page == NULL ) {
+        page = new SpriteAtlasPageGL;
+        
+        page->page = new SpriteAtlasPage( ATLAS_PAGE_SIZE, ATLAS_PAGE_SIZE,
+                                          ATLAS_GUTTER );
+        
+        page->texture.texture = 
+            new SingleTextureGL( page->page->getRGBA(), 
+                                 ATLAS_PAGE_SIZE, ATLAS_PAGE_SIZE,
+                                 false, false );
+        page->texture.lastSetMinFilter = -1;
+        page->texture.lastSetMagFilter = -1;
+        
+        sAtlasPages.push_back( page );
+
+        page->page->addSprite( inRGBA, inWidth, inHeight, &x, &y );
+        }
+    
+
+    // upload sprite and gutter
+    // quads waiting in the batch never sample this unused region
+    int g = page->page->getGutter();
+    
+    unsigned char *region = 
+        page->page->getRegion( x - g, y - g, 
+                               inWidth + 2 * g, inHeight + 2 * g );
+    
+    page->texture.texture->replaceTextureRegion( region, x - g, y - g, 
+                                                 inWidth + 2 * g, 
+                                                 inHeight + 2 * g );
+    delete [] region;
+    
+    
+    mAtlasPage = page;
+    mTexture = &( page->texture );
+    
+    int pageW = page->page->getWidth();
+    int pageH = page->page->getHeight();
+    
+    mTexOffsetX = x / (float)pageW;
+    mTexOffsetY = y / (float)pageH;
+    mTexScaleX = inWidth / (float)pageW;
+    mTexScaleY = inHeight / (float)pageH;
+    }
+
+
+
+void SpriteGL::leaveAtlas() {
+    flushBatch();
+    
+    SpriteAtlasPage *page = mAtlasPage->page;
+    
+    int x = lrint( mTexOffsetX * page->getWidth() );
+    int y = lrint( mTexOffsetY * page->getHeight() );
+    
+    unsigned char *rgba = page->getRegion( x, y, mWidth, mHeight );
+
+    SingleTextureGL *texture = new SingleTextureGL( rgba, mWidth, mHeight,
+                                                    false, false );
+    delete [] rgba;
+    
+    // page bytes already have edges expanded, but constructor 
+    // expanded them again
+    rgba = page->getRegion( x, y, mWidth, mHeight );
+    texture->setTextureData( rgba, false, mWidth, mHeight, false );
+    delete [] rgba;
+    
+
+    releaseAtlasSpace( mAtlasPage );
+    mAtlasPage = NULL;
+    
+    mTexture = newSpriteTexture( texture );
+    
+    mTexOffsetX = 0;
+    mTexOffsetY = 0;
+    mTexScaleX = 1;
+    mTexScaleY = 1;
+    }
+
+
+
 void SpriteGL::initTexture( Image *inImage,
                             char inTransparentLowerLeftCorner,
                             int inNumFrames,
                             int inNumPages, char inSetColoredRadii ) {
     
-    mLastSetMinFilter = -1;
-    mLastSetMagFilter = -1;
-    
     mColoredRadiusLeftX = 0.5;
     mColoredRadiusRightX = 0.5;
     mColoredRadiusTopY = 0.5;
@@ -251,14 +532,15 @@ void SpriteGL::initTexture( Image *inImage,
         }
     
 
-    mTexture = new SingleTextureGL( spriteImage,
-                                    // no wrap
-                                    false,
-                                    sGenerateMipMaps );
-
-
     mWidth = spriteImage->getWidth();
     mHeight = spriteImage->getHeight();
+
+    unsigned char *rgba = RGBAImage::getRGBABytes( spriteImage );
+
+    makeTexture( rgba, mWidth, mHeight );
+    
+    delete [] rgba;
+    
     
     mBaseScaleX =  mWidth / mNumPages;
     mBaseScaleY = mHeight / mNumFrames;
@@ -282,9 +564,6 @@ SpriteGL::SpriteGL( unsigned char *inRGBA,
                     int inNumPages,
                     char inSetColoredRadii ) {
 
-    mLastSetMinFilter = -1;
-    mLastSetMagFilter = -1;
-    
     mColoredRadiusLeftX = 0.5;
     mColoredRadiusRightX = 0.5;
     mColoredRadiusTopY = 0.5;
@@ -297,10 +576,7 @@ SpriteGL::SpriteGL( unsigned char *inRGBA,
         findColoredRadii( inRGBA, inWidth, inHeight );
         }
     
-    mTexture = new SingleTextureGL( inRGBA, inWidth, inHeight,
-                                    // no wrap
-                                    false,
-                                    sGenerateMipMaps );    
+    makeTexture( inRGBA, inWidth, inHeight );
 
     mWidth = inWidth;
     mHeight = inHeight;
@@ -325,9 +601,6 @@ SpriteGL::SpriteGL( char inAlphaOnly,
                     int inNumPages,
                     char inSetColoredRadii ) {
 
-    mLastSetMinFilter = -1;
-    mLastSetMagFilter = -1;
-    
     mColoredRadiusLeftX = 0.5;
     mColoredRadiusRightX = 0.5;
     mColoredRadiusTopY = 0.5;
@@ -340,11 +613,18 @@ SpriteGL::SpriteGL( char inAlphaOnly,
         findColoredRadiiAlpha( inA, inWidth, inHeight );
         }
 
-    mTexture = new SingleTextureGL( inAlphaOnly,
-                                    inA, inWidth, inHeight,
-                                    // no wrap
-                                    false,
-                                    sGenerateMipMaps );
+    // own texture, since atlas pages are RGBA
+    mTexture = newSpriteTexture( new SingleTextureGL( inAlphaOnly,
+                                                      inA, inWidth, inHeight,
+                                                      // no wrap
+                                                      false,
+                                                      sGenerateMipMaps ) );
+    mAtlasPage = NULL;
+    
+    mTexOffsetX = 0;
+    mTexOffsetY = 0;
+    mTexScaleX = 1;
+    mTexScaleY = 1;
 
     mWidth = inWidth;
     mHeight = inHeight;
@@ -364,7 +644,16 @@ SpriteGL::SpriteGL( char inAlphaOnly,
 
 
 SpriteGL::~SpriteGL() {
-    delete mTexture;
+    // batch might be holding quads that use our texture
+    flushBatch();
+    
+    if( mAtlasPage != NULL ) {
+        releaseAtlasSpace( mAtlasPage );
+        }
+    else {
+        delete mTexture->texture;
+        delete mTexture;
+        }
     }
 
 
@@ -372,7 +661,18 @@ SpriteGL::~SpriteGL() {
 // FOVMOD NOTE:  Change 1/4 - Take these lines during the merge process
 void SpriteGL::setWrapping( char inHorizontal,
                             char inVertical ) {
-    mTexture->setWrapping( inHorizontal, inVertical );
+    if( mAtlasPage != NULL ) {
+        if( !inHorizontal && !inVertical ) {
+            // gutter in atlas already clamps
+            return;
+            }
+        // can't repeat part of a page
+        leaveAtlas();
+        }
+    
+    flushBatch();
+    
+    mTexture->texture->setWrapping( inHorizontal, inVertical );
     }
 
 
@@ -473,43 +773,43 @@ void SpriteGL::prepareDraw( int inFrame,
         }
 
 
-    mTexture->enable();
+    mTexture->texture->enable();
     
     if( inMipMapFilter ) {
-        if( mLastSetMinFilter != 2 ) {
+        if( mTexture->lastSetMinFilter != 2 ) {
             glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, 
                              GL_LINEAR_MIPMAP_LINEAR );
-            mLastSetMinFilter = 2;
+            mTexture->lastSetMinFilter = 2;
             }
         }
     else {
         
         if( inLinearMagFilter ) {
-            if( mLastSetMinFilter != 1 ) {
+            if( mTexture->lastSetMinFilter != 1 ) {
                 glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, 
                                  GL_LINEAR );
-                mLastSetMinFilter = 1;
+                mTexture->lastSetMinFilter = 1;
                 }
             }
         else {
-            if( mLastSetMinFilter != 0 ) {
+            if( mTexture->lastSetMinFilter != 0 ) {
                 glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, 
                                  GL_NEAREST );
-                mLastSetMinFilter = 0;
+                mTexture->lastSetMinFilter = 0;
                 }
             }
         }
     
     if( inLinearMagFilter ) {
-        if( mLastSetMagFilter != 1 ) {
+        if( mTexture->lastSetMagFilter != 1 ) {
             glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
-            mLastSetMagFilter = 1;
+            mTexture->lastSetMagFilter = 1;
             }
         }
     else {
-        if( mLastSetMagFilter != 0 ) {
+        if( mTexture->lastSetMagFilter != 0 ) {
             glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
-            mLastSetMagFilter = 0;
+            mTexture->lastSetMagFilter = 0;
             }
         }
     
@@ -785,47 +1085,8 @@ void SpriteGL::prepareDraw( int inFrame,
         glColor4f( 1, 1, 1, inFadeFactor );
         }
     */          
-    mTexture->enable();
-    
-
-    if( inMipMapFilter ) {
-        if( mLastSetMinFilter != 2 ) {
-            glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, 
-                             GL_LINEAR_MIPMAP_LINEAR );
-            mLastSetMinFilter = 2;
-            }
-        }
-    else {
-        
-        if( inLinearMagFilter ) {
-            if( mLastSetMinFilter != 1 ) {
-                glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, 
-                                 GL_LINEAR );
-                mLastSetMinFilter = 1;
-                }
-            }
-        else {
-            if( mLastSetMinFilter != 0 ) {
-                glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, 
-                                 GL_NEAREST );
-                mLastSetMinFilter = 0;
-                }
-            }
-        }
     
-    if( inLinearMagFilter ) {
-        if( mLastSetMagFilter != 1 ) {
-            glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
-            mLastSetMagFilter = 1;
-            }
-        }
-    else {
-        if( mLastSetMagFilter != 0 ) {
-            glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
-            mLastSetMagFilter = 0;
-            }
-        }
-
+    // texture and filters are set when batch is drawn
     
     
     // FOVMOD NOTE:  Change 3/4 - Take these lines during the merge process
@@ -859,6 +1120,69 @@ void SpriteGL::prepareDraw( int inFrame,
 
 
         
+void SpriteGL::batchQuad( char inLinearMagFilter,
+                          char inMipMapFilter,
+                          float *inCornerColors ) {
+    SpriteBatchState state;
+    
+    state.texture = mTexture;
+    state.magFilter = inLinearMagFilter ? 1 : 0;
+    state.minFilter = state.magFilter;
+
+    if( inMipMapFilter ) {
+        if( mAtlasPage == NULL ) {
+            state.minFilter = 2;
+            }
+        // else atlas pages have no mipmaps, and a mipmap filter would
+        // leave them incomplete (not drawn at all)
+        // linear is closest
+        else {
+            state.minFilter = 1;
+            }
+        }
+    
+
+    // from sprite's texture space into its region of texture
+    float uv[8];
+    
+    for( int i=0; i<8; i+=2 ) {
+        uv[i] = mTexOffsetX + squareTextureCoords[i] * mTexScaleX;
+        uv[i+1] = mTexOffsetY + squareTextureCoords[i+1] * mTexScaleY;
+        }
+    
+    if( inCornerColors != NULL ) {
+        spriteBatch.addQuad( &state, squareVertices, uv, inCornerColors );
+        }
+    else {
+        spriteBatch.addQuadSolid( &state, squareVertices, uv, sDrawColor );
+        }
+    }
+
+
+
+// corner colors come in BL, BR, TR, TL order, and vertices are in strip
+// order, BL, BR, TL, TR
+static void setStripColors( FloatColor inCornerColors[4] ) {
+    for( int c=0; c<4; c++ ) {
+        
+        int cDest = c;
+        if( c == 2 ) {
+            cDest = 3;
+            }
+        else if( c == 3 ) {
+            cDest = 2;
+            }
+
+        int start = cDest * 4;
+        squareColors[ start ] = inCornerColors[c].r;
+        squareColors[ start + 1 ] = inCornerColors[c].g;
+        squareColors[ start + 2 ] = inCornerColors[c].b;
+        squareColors[ start + 3 ] = inCornerColors[c].a;
+        }
+    }
+
+
+
 extern int numPixelsDrawn;
 
 
@@ -878,43 +1202,7 @@ void SpriteGL::draw( int inFrame,
                  inMipMapFilter,
                  inRotation, inFlipH );
 
-
-    glVertexPointer( 2, GL_FLOAT, 0, squareVertices );
-    
-    
-    glTexCoordPointer( 2, GL_FLOAT, 0, squareTextureCoords );
-    
-    if( !sStateSet ) {    
-        glEnableClientState( GL_VERTEX_ARRAY );
-        glEnableClientState( GL_TEXTURE_COORD_ARRAY );
-        sStateSet = true;
-        }
-    
-    glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
-
-
-    /*
-      // for debugging
-      // show red square around each sprite
-    
-    SingleTextureGL::disableTexturing();
-    
-    FloatColor oldColor = getDrawColor();
-    setDrawColor( 1, 0, 0, 0.75 );
-
-    GLfloat temp = squareVertices[4];
-    squareVertices[4] = squareVertices[6];
-    squareVertices[6] = temp;
-    
-    temp = squareVertices[5];
-    squareVertices[5] = squareVertices[7];
-    squareVertices[7] = temp;
-    //glVertexPointer( 2, GL_FLOAT, 0, squareVertices );
-    
-    glDrawArrays( GL_LINE_LOOP, 0, 4 );
-    
-    setDrawColor( oldColor );
-    */
+    batchQuad( inLinearMagFilter, inMipMapFilter, NULL );
     }
 
 
@@ -932,42 +1220,9 @@ void SpriteGL::draw( int inFrame,
                  inMipMapFilter,
                  inRotation, inFlipH );
 
-
-    glVertexPointer( 2, GL_FLOAT, 0, squareVertices );
-    glTexCoordPointer( 2, GL_FLOAT, 0, squareTextureCoords );
+    setStripColors( inCornerColors );
     
-    if( !sStateSet ) {    
-        glEnableClientState( GL_VERTEX_ARRAY );
-        glEnableClientState( GL_TEXTURE_COORD_ARRAY );
-        sStateSet = true;
-        }
-
-    for( int c=0; c<4; c++ ) {
-        
-        int cDest = c;
-        if( c == 2 ) {
-            cDest = 3;
-            }
-        else if( c == 3 ) {
-            cDest = 2;
-            }
-
-        int start = cDest * 4;
-        squareColors[ start ] = inCornerColors[c].r;
-        squareColors[ start + 1 ] = inCornerColors[c].g;
-        squareColors[ start + 2 ] = inCornerColors[c].b;
-        squareColors[ start + 3 ] = inCornerColors[c].a;
-        }
-    
-    
-    glColorPointer( 4, GL_FLOAT, 0, squareColors );
-    glEnableClientState( GL_COLOR_ARRAY );
-
-
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-
-    
-    glDisableClientState( GL_COLOR_ARRAY );
+    batchQuad( inLinearMagFilter, inMipMapFilter, squareColors );
     }
 
 
@@ -1001,42 +1256,9 @@ void SpriteGL::draw( int inFrame,
     squareVertices[6] = inCornerPos[2].x;
     squareVertices[7] = inCornerPos[2].y;
     
+    setStripColors( inCornerColors );
     
-    glVertexPointer( 2, GL_FLOAT, 0, squareVertices );
-    glTexCoordPointer( 2, GL_FLOAT, 0, squareTextureCoords );
-    
-    if( !sStateSet ) {    
-        glEnableClientState( GL_VERTEX_ARRAY );
-        glEnableClientState( GL_TEXTURE_COORD_ARRAY );
-        sStateSet = true;
-        }
-
-    for( int c=0; c<4; c++ ) {
-        
-        int cDest = c;
-        if( c == 2 ) {
-            cDest = 3;
-            }
-        else if( c == 3 ) {
-            cDest = 2;
-            }
-
-        int start = cDest * 4;
-        squareColors[ start ] = inCornerColors[c].r;
-        squareColors[ start + 1 ] = inCornerColors[c].g;
-        squareColors[ start + 2 ] = inCornerColors[c].b;
-        squareColors[ start + 3 ] = inCornerColors[c].a;
-        }
-    
-    
-    glColorPointer( 4, GL_FLOAT, 0, squareColors );
-    glEnableClientState( GL_COLOR_ARRAY );
-
-
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-
-    
-    glDisableClientState( GL_COLOR_ARRAY );
+    batchQuad( inLinearMagFilter, inMipMapFilter, squareColors );
     }
 
 
@@ -1079,17 +1301,7 @@ void SpriteGL::draw( int inFrame,
     squareTextureCoords[6] = inTexCoords[2].x;
     squareTextureCoords[7] = inTexCoords[2].y;
 
-
-    glVertexPointer( 2, GL_FLOAT, 0, squareVertices );
-    glTexCoordPointer( 2, GL_FLOAT, 0, squareTextureCoords );
-    
-    if( !sStateSet ) {    
-        glEnableClientState( GL_VERTEX_ARRAY );
-        glEnableClientState( GL_TEXTURE_COORD_ARRAY );
-        sStateSet = true;
-        }
-    
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    batchQuad( inLinearMagFilter, inMipMapFilter, NULL );
     }
 
 
@@ -9,10 +9,34 @@
 
 #include "minorGems/math/geometry/Vector3D.h"
 
+#include "SpriteBatch.h"
+#include "SpriteAtlasPage.h"
+
 #include <stdlib.h>
 
 
 
+// a texture that sprites draw from, with the filters last set on it
+typedef struct SpriteTextureGL {
+        SingleTextureGL *texture;
+
+        // -1 for unset, 0 for nearest, 1 for linear, 2 for mipmap
+        int lastSetMinFilter;
+        
+        // -1 for unset, 0 for nearest, 1 for linear
+        int lastSetMagFilter;
+    } SpriteTextureGL;
+
+
+
+typedef struct SpriteAtlasPageGL {
+        SpriteAtlasPage *page;
+        SpriteTextureGL texture;
+    } SpriteAtlasPageGL;
+
+
+
+
 class SpriteGL{
     public:
         
@@ -20,7 +44,46 @@ class SpriteGL{
         static void toggleMipMapGeneration( char inGenerateMipMaps ) {
             sGenerateMipMaps = inGenerateMipMaps;
             }
+        
+        // small RGBA sprites without mipmaps are packed into shared
+        // atlas textures, so they can be drawn in one batch
+        // defaults to on
+        static void toggleAtlasPacking( char inPack ) {
+            sAtlasPacking = inPack;
+            }
             
+
+
+        // sprites are queued and drawn in batches that share a texture
+        // when off, each sprite is drawn right away
+        // defaults to on
+        static void toggleBatching( char inBatching );
+
+        // draws queued sprites
+        // must be called before GL state that affects sprite drawing
+        // changes, and before anything else is drawn
+        static void flushBatch();
+
+        // flushes and counts a frame in batch stats
+        static void endBatchFrame();
+        
+        static SpriteBatchStats getLastFrameBatchStats();
+        static SpriteBatchStats getTotalBatchStats();
+        
+        static int getNumAtlasPages() {
+            return sAtlasPages.size();
+            }
+
+
+        // color for sprites drawn without corner colors, already faded
+        static void setDrawColor( float inR, float inG, float inB, 
+                                  float inA ) {
+            sDrawColor[0] = inR;
+            sDrawColor[1] = inG;
+            sDrawColor[2] = inB;
+            sDrawColor[3] = inA;
+            }
+        
         
 
         // transparent color for RGB images can be taken from lower-left
@@ -149,6 +212,16 @@ class SpriteGL{
             }
 
 
+        // sets colored radii found elsewhere (left, right, top, bottom),
+        // in place of computing them at construction
+        void setColoredRadii( double inRadii[4] ) {
+            mColoredRadiusLeftX = inRadii[0];
+            mColoredRadiusRightX = inRadii[1];
+            mColoredRadiusTopY = inRadii[2];
+            mColoredRadiusBottomY = inRadii[3];
+            }
+
+
         // FOVMOD NOTE:  Change 2/3 - Take these lines during the merge process
         void setWrapping( char inHorizontal,
                           char invertical );
@@ -167,6 +240,8 @@ class SpriteGL{
         
         
         static void setTexturingDisabled() {
+            flushBatch();
+            
             // need to renable client states later
             sStateSet = false;
             SingleTextureGL::disableTexturing();
@@ -177,23 +252,36 @@ class SpriteGL{
 
     protected:
 
+        friend class SpriteGLBatchBackend;
+        
+
         static char sGenerateMipMaps;
         
+        static char sAtlasPacking;
+        
         static char sCountingPixels;
         static double sPixelsDrawn;
-
-        // -1 for unset, 0 for nearest, 1 for linear, 2 for mipmap
-        int mLastSetMinFilter;
-        
-        // -1 for unset, 0 for nearest, 1 for linear
-        int mLastSetMagFilter;
         
         static char sWrapSet;
 
         static char sStateSet;
         
+        static float sDrawColor[4];
+        
+        static SimpleVector<SpriteAtlasPageGL *> sAtlasPages;
+        
 
-        SingleTextureGL *mTexture;
+        // either owned by this sprite, or an atlas page's texture
+        SpriteTextureGL *mTexture;
+        
+        // NULL if this sprite has its own texture
+        SpriteAtlasPageGL *mAtlasPage;
+        
+        // where the sprite sits in its texture
+        // texture coordinates in the sprite's own 0..1 range are scaled,
+        // then offset into this region
+        float mTexOffsetX, mTexOffsetY;
+        float mTexScaleX, mTexScaleY;
         
         int mNumFrames;
         int mNumPages;
@@ -221,6 +309,18 @@ class SpriteGL{
         int mCurrentPage;
         
 
+        // makes this sprite's texture, in an atlas page if it fits
+        // expands edges of inRGBA in place
+        void makeTexture( unsigned char *inRGBA, 
+                          unsigned int inWidth, unsigned int inHeight );
+        
+        // moves an atlas sprite into its own texture
+        void leaveAtlas();
+        
+        // frees page when its last sprite is gone
+        static void releaseAtlasSpace( SpriteAtlasPageGL *inPage );
+        
+
         void initTexture( Image *inImage,
                           char inTransparentLowerLeftCorner = false,
                           int inNumFrames = 1,
@@ -241,6 +341,12 @@ class SpriteGL{
                           // FOVMOD NOTE:  Change 3/3 - Take these lines during the merge process
                           char inComputeTexCoords = true );
         
+        // queues the quad set up by prepareDraw, with inCornerColors
+        // in strip order, or NULL to use the draw color
+        void batchQuad( char inLinearMagFilter,
+                        char inMipMapFilter,
+                        float *inCornerColors );
+        
 
 
 
@@ -102,6 +102,9 @@ void setDrawColor( float inR, float inG, float inB, float inA ) {
         }
         
     glColor4f( inR, inG, inB, inA );
+    
+    // sprites are batched with their color
+    SpriteGL::setDrawColor( inR, inG, inB, inA );
     }
 
 
@@ -127,6 +130,8 @@ void setDrawFade( float inA ) {
     lastA = inA;
     
     glColor4f( lastR, lastG, lastB, inA * globalFadeTotal );
+    
+    SpriteGL::setDrawColor( lastR, lastG, lastB, inA * globalFadeTotal );
     }
 
 
@@ -150,7 +155,22 @@ FloatColor getFloatColor( const char *inHexString ) {
 
 
 
+// 0 for normal, 1 for additive, 2 for multiplicative
+static int blendMode = 0;
+
+
+// queued sprites are drawn with the old blend mode
+static void flushForBlend( int inNewMode ) {
+    if( inNewMode != blendMode ) {
+        SpriteGL::flushBatch();
+        blendMode = inNewMode;
+        }
+    }
+
+
+
 static void setNormalBlend() {
+    flushForBlend( 0 );
     glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
     }
 
@@ -158,6 +178,7 @@ static void setNormalBlend() {
 
 void toggleAdditiveBlend( char inAdditive ) {
     if( inAdditive ) {
+        flushForBlend( 1 );
         glBlendFunc( GL_SRC_ALPHA, GL_ONE );
         }
     else {
@@ -169,6 +190,7 @@ void toggleAdditiveBlend( char inAdditive ) {
 
 void toggleMultiplicativeBlend( char inMultiplicative ) {
     if( inMultiplicative ) {
+        flushForBlend( 2 );
         glBlendFunc( GL_DST_COLOR, GL_ZERO );
         }
     else {
@@ -179,6 +201,10 @@ void toggleMultiplicativeBlend( char inMultiplicative ) {
 
 
 void toggleAdditiveTextureColoring( char inAdditive ) {
+    if( inAdditive != additiveTextureColorMode ) {
+        SpriteGL::flushBatch();
+        }
+    
     if( inAdditive ) {
         glTexEnvf( GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_ADD );
         }
@@ -539,6 +565,8 @@ void enableScissor( double inX, double inY, double inWidth, double inHeight ) {
                 &winEndX, &winEndY, &winEndZ );
 
 
+    SpriteGL::flushBatch();
+    
     glScissor( lrint( winStartX ), lrint( winStartY ), 
                lrint( winEndX - winStartX ), lrint( winEndY - winStartY ) );
     glEnable( GL_SCISSOR_TEST );
@@ -547,6 +575,8 @@ void enableScissor( double inX, double inY, double inWidth, double inHeight ) {
 
 
 void disableScissor() {
+    SpriteGL::flushBatch();
+    
     glDisable( GL_SCISSOR_TEST );
     }
 
@@ -554,6 +584,8 @@ void disableScissor() {
 
 void startAddingToStencil( char inDrawColorToo, char inAdd,
                            float inMinAlpha ) {
+    SpriteGL::flushBatch();
+    
     if( !inDrawColorToo ) {
         
         // stop updating color
@@ -586,6 +618,8 @@ void startAddingToStencil( char inDrawColorToo, char inAdd,
 
 
 void startDrawingThroughStencil( char inInvertStencil ) {
+    SpriteGL::flushBatch();
+    
     // Re-enable update of color
     glColorMask( GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE );
     glDisable( GL_ALPHA_TEST );
@@ -614,6 +648,8 @@ void stopStencil() {
 
 
 void disableStencil() {
+    SpriteGL::flushBatch();
+    
     // Re-enable update of color (just in case stencil drawing was not started)
     glColorMask( GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE );
     glDisable( GL_ALPHA_TEST );
@@ -643,6 +679,20 @@ SpriteHandle fillSprite( unsigned char *inRGBA,
 
 
 
+SpriteHandle fillSprite( unsigned char *inRGBA, 
+                         unsigned int inWidth, unsigned int inHeight,
+                         double inColoredRadii[4] ) {
+    totalLoadedTextureBytes += inWidth * inHeight * 4;
+    SpriteGL *s = new SpriteGL( inRGBA, inWidth, inHeight, 1, 1, false );
+
+    if( transparentCroppingOn ) {
+        s->setColoredRadii( inColoredRadii );
+        }
+    return s;
+    }
+
+
+
 SpriteHandle fillSpriteAlphaOnly( unsigned char *inA, 
                                   unsigned int inWidth, 
                                   unsigned int inHeight ) {
@@ -801,6 +851,8 @@ void drawSpriteAlphaOnly( SpriteHandle inSprite, doublePair inCenter,
     // http://stackoverflow.com/questions/2485370/
     //      use-only-alpha-channel-of-texture-in-opengl
 
+    SpriteGL::flushBatch();
+    
     glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_COMBINE);
     glTexEnvi(GL_TEXTURE_ENV, GL_COMBINE_RGB, GL_REPLACE);
     glTexEnvi(GL_TEXTURE_ENV, GL_SOURCE0_RGB, GL_PREVIOUS);
@@ -812,6 +864,8 @@ void drawSpriteAlphaOnly( SpriteHandle inSprite, doublePair inCenter,
 
     drawSprite( inSprite, inCenter, inZoom, inRotation, inFlipH );
 
+    SpriteGL::flushBatch();
+    
     // restore texture mode
     glTexEnvf( GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE );
     }
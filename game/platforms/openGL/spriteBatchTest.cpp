@@ -0,0 +1,580 @@
+// Test and benchmark for SpriteGL's atlas packing and batching, on the CPU
+//
+// Usage:  spriteBatchTest [numSprites] [numDraws] [frames]
+//
+// Checks SkylinePacker placements (in bounds, no overlaps), SpriteAtlasPage
+// copies and gutters, and SpriteBatch breaks, flushes, and stats, drawing
+// through a backend that records what it is given instead of calling GL.
+//
+// Then loads a set of sprites of mixed sizes into atlas pages the way
+// SpriteGL does, draws frames of sprites in random order, and compares the
+// draw calls made with one texture per sprite against atlas pages.
+
+
+#include "SkylinePacker.h"
+#include "SpriteAtlasPage.h"
+#include "SpriteBatch.h"
+
+#include "minorGems/system/Time.h"
+#include "minorGems/util/SimpleVector.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+
+static int numFailed = 0;
+
+
+static void check( char inPassed, const char *inWhat ) {
+    if( ! inPassed ) {
+        printf( "FAILED:  %s\n", inWhat );
+        numFailed++;
+        }
+    }
+
+
+
+typedef struct RecordedBatch {
+        SpriteBatchState state;
+        int numQuads;
+        // index of batch's first quad in recorded arrays
+        int firstQuad;
+    } RecordedBatch;
+
+
+
+// keeps everything it is asked to draw
+class RecordingBackend : public SpriteBatchBackend {
+    public:
+
+        SimpleVector<RecordedBatch> mBatches;
+
+        SimpleVector<float> mXY;
+        SimpleVector<float> mUV;
+        SimpleVector<float> mRGBA;
+
+
+        virtual void drawQuads( SpriteBatchState *inState, int inNumQuads,
+                                float *inXY, float *inUV,
+                                float *inRGBA ) {
+            RecordedBatch b = { *inState, inNumQuads, mXY.size() / 8 };
+            mBatches.push_back( b );
+
+            mXY.appendArray( inXY, inNumQuads * 8 );
+            mUV.appendArray( inUV, inNumQuads * 8 );
+            mRGBA.appendArray( inRGBA, inNumQuads * 16 );
+            }
+
+
+        void clear() {
+            mBatches.deleteAll();
+            mXY.deleteAll();
+            mUV.deleteAll();
+            mRGBA.deleteAll();
+            }
+    };
+
+
+
+// only counts, for timing the batch itself
+class CountingBackend : public SpriteBatchBackend {
+    public:
+        int mBatches;
+
+        CountingBackend()
+                : mBatches( 0 ) {
+            }
+
+        virtual void drawQuads( SpriteBatchState *inState, int inNumQuads,
+                                float *inXY, float *inUV,
+                                float *inRGBA ) {
+            mBatches++;
+            }
+    };
+
+
+
+static unsigned int randState = 12345;
+
+static int randInt( int inMin, int inMax ) {
+    randState = randState * 1103515245 + 12345;
+    return inMin + (int)( ( randState >> 8 ) % ( inMax - inMin + 1 ) );
+    }
+
+
+
+static void checkPacker() {
+    SkylinePacker packer( 256, 256 );
+
+    SimpleVector<int> rects;
+
+    int numPacked = 0;
+    int numTries = 0;
+
+    // until packer is mostly full
+    while( numTries < 2000 ) {
+        int w = randInt( 1, 40 );
+        int h = randInt( 1, 40 );
+        int x, y;
+
+        numTries++;
+
+        if( packer.pack( w, h, &x, &y ) ) {
+            numPacked++;
+
+            check( x >= 0 && y >= 0 && x + w <= 256 && y + h <= 256,
+                   "packed rectangle in bounds" );
+
+            for( int i=0; i<rects.size(); i+=4 ) {
+                int *r = rects.getElement( i );
+                if( x < r[0] + r[2] && r[0] < x + w &&
+                    y < r[1] + r[3] && r[1] < y + h ) {
+                    check( false, "packed rectangles don't overlap" );
+                    i = rects.size();
+                    }
+                }
+            rects.push_back( x );
+            rects.push_back( y );
+            rects.push_back( w );
+            rects.push_back( h );
+            }
+        }
+
+    printf( "Packer:  %d of %d rectangles in 256x256, %.1f%% covered\n",
+            numPacked, numTries, 100 * packer.getOccupancy() );
+
+    check( packer.getOccupancy() > 0.75, "packer fills most of bin" );
+
+    int x, y;
+    check( ! packer.pack( 257, 1, &x, &y ), "too wide doesn't fit" );
+
+    // exact fill
+    SkylinePacker exact( 64, 64 );
+    char allFit = true;
+    for( int i=0; i<16; i++ ) {
+        if( ! exact.pack( 16, 16, &x, &y ) ) {
+            allFit = false;
+            }
+        }
+    check( allFit, "16 16x16 tiles fill 64x64" );
+    check( exact.getOccupancy() == 1.0, "exact fill fully covered" );
+    check( ! exact.pack( 1, 1, &x, &y ), "nothing fits in full bin" );
+
+    exact.reset();
+    check( exact.pack( 64, 64, &x, &y ) && x == 0 && y == 0,
+           "reset frees whole bin" );
+
+    // skyline steps up and back down:  tall, short, then wide fits
+    // on the short step
+    SkylinePacker steps( 64, 64 );
+    steps.pack( 32, 48, &x, &y );
+    steps.pack( 32, 16, &x, &y );
+    check( x == 32 && y == 0, "second rect beside first" );
+    check( steps.pack( 32, 48, &x, &y ) && x == 32 && y == 16,
+           "third rect on lower step" );
+    check( steps.pack( 32, 16, &x, &y ) && x == 0 && y == 48,
+           "fourth rect on top of first" );
+    }
+
+
+
+static void checkAtlasPage() {
+    SpriteAtlasPage page( 64, 64, 2 );
+
+    // 3x2 sprite with distinct pixels
+    unsigned char sprite[ 3 * 2 * 4 ];
+    for( int i=0; i<3 * 2; i++ ) {
+        sprite[ i * 4 ] = (unsigned char)( 10 * i );
+        sprite[ i * 4 + 1 ] = (unsigned char)( 10 * i + 1 );
+        sprite[ i * 4 + 2 ] = (unsigned char)( 10 * i + 2 );
+        sprite[ i * 4 + 3 ] = 255;
+        }
+
+    int x, y;
+    check( page.addSprite( sprite, 3, 2, &x, &y ), "sprite added to page" );
+    check( x == 2 && y == 2, "sprite placed after gutter" );
+    check( page.getNumSprites() == 1, "page counts sprite" );
+
+    unsigned char *region = page.getRegion( x, y, 3, 2 );
+    check( memcmp( region, sprite, sizeof( sprite ) ) == 0,
+           "sprite bytes copied into page" );
+    delete [] region;
+
+    // whole padded area, 7x6
+    unsigned char *padded = page.getRegion( x - 2, y - 2, 7, 6 );
+
+    // corners of gutter repeat sprite corners
+    check( memcmp( &( padded[ 0 ] ), &( sprite[ 0 ] ), 4 ) == 0,
+           "top-left gutter repeats corner" );
+    check( memcmp( &( padded[ ( 0 * 7 + 6 ) * 4 ] ), &( sprite[ 2 * 4 ] ),
+                   4 ) == 0,
+           "top-right gutter repeats corner" );
+    check( memcmp( &( padded[ ( 5 * 7 + 0 ) * 4 ] ), &( sprite[ 3 * 4 ] ),
+                   4 ) == 0,
+           "bottom-left gutter repeats corner" );
+    check( memcmp( &( padded[ ( 5 * 7 + 6 ) * 4 ] ), &( sprite[ 5 * 4 ] ),
+                   4 ) == 0,
+           "bottom-right gutter repeats corner" );
+
+    // edges
+    check( memcmp( &( padded[ ( 0 * 7 + 3 ) * 4 ] ), &( sprite[ 1 * 4 ] ),
+                   4 ) == 0,
+           "top gutter repeats top row" );
+    check( memcmp( &( padded[ ( 3 * 7 + 1 ) * 4 ] ), &( sprite[ 3 * 4 ] ),
+                   4 ) == 0,
+           "left gutter repeats left column" );
+    delete [] padded;
+
+    // second sprite lands beside the first, gutters don't touch it
+    int x2, y2;
+    check( page.addSprite( sprite, 3, 2, &x2, &y2 ), "second sprite added" );
+    check( x2 >= x + 3 + 4 || y2 >= y + 2 + 4, "gutters don't overlap" );
+
+    // page full
+    unsigned char big[ 64 * 64 * 4 ];
+    memset( big, 255, sizeof( big ) );
+    check( ! page.addSprite( big, 61, 61, &x, &y ),
+           "too big with gutter doesn't fit" );
+
+    page.removeSprite();
+    page.removeSprite();
+    check( page.getNumSprites() == 0, "sprites removed" );
+    check( page.addSprite( big, 60, 60, &x, &y ), "empty page reused" );
+    }
+
+
+
+static void addTestQuad( SpriteBatch *inBatch, void *inTexture,
+                         char inMin, char inMag, float inID ) {
+    SpriteBatchState state = { inTexture, inMin, inMag };
+
+    float xy[8];
+    float uv[8];
+    for( int i=0; i<8; i++ ) {
+        xy[i] = inID;
+        uv[i] = inID + i;
+        }
+    float rgba[16];
+    for( int i=0; i<16; i++ ) {
+        rgba[i] = inID + i * 0.01f;
+        }
+
+    inBatch->addQuad( &state, xy, uv, rgba );
+    }
+
+
+
+static void checkBatch() {
+    RecordingBackend backend;
+    SpriteBatch batch( &backend, 8 );
+
+    int texA, texB;
+
+
+    // same state joins
+    for( int i=0; i<5; i++ ) {
+        addTestQuad( &batch, &texA, 0, 0, i );
+        }
+    check( backend.mBatches.size() == 0, "nothing drawn before flush" );
+    check( batch.getNumPendingQuads() == 5, "quads pending" );
+
+    batch.flush();
+    check( backend.mBatches.size() == 1 &&
+           backend.mBatches.getElementDirect( 0 ).numQuads == 5,
+           "one batch of 5 quads" );
+
+    // order and data preserved
+    char dataMatches = true;
+    for( int q=0; q<5; q++ ) {
+        if( backend.mXY.getElementDirect( q * 8 ) != q ||
+            backend.mUV.getElementDirect( q * 8 + 7 ) != q + 7 ||
+            backend.mRGBA.getElementDirect( q * 16 + 15 ) !=
+            q + 15 * 0.01f ) {
+            dataMatches = false;
+            }
+        }
+    check( dataMatches, "quad data in order" );
+
+    batch.flush();
+    check( backend.mBatches.size() == 1, "empty flush draws nothing" );
+
+    batch.endFrame();
+    SpriteBatchStats frame = batch.getLastFrameStats();
+    check( frame.batches == 1 && frame.quads == 5 && frame.flushBreaks == 1,
+           "frame stats after flush" );
+    backend.clear();
+
+
+    // texture and filter changes break
+    addTestQuad( &batch, &texA, 0, 0, 0 );
+    addTestQuad( &batch, &texB, 0, 0, 1 );
+    addTestQuad( &batch, &texB, 1, 1, 2 );
+    addTestQuad( &batch, &texB, 2, 1, 3 );
+    addTestQuad( &batch, &texB, 2, 1, 4 );
+    addTestQuad( &batch, &texA, 2, 1, 5 );
+    batch.flush();
+
+    check( backend.mBatches.size() == 5, "state changes make 5 batches" );
+    if( backend.mBatches.size() == 5 ) {
+        RecordedBatch b = backend.mBatches.getElementDirect( 3 );
+        check( b.state.texture == &texB && b.state.minFilter == 2 &&
+               b.state.magFilter == 1 && b.numQuads == 2,
+               "batch carries its state" );
+        }
+
+    batch.endFrame();
+    frame = batch.getLastFrameStats();
+    check( frame.stateBreaks == 4 && frame.flushBreaks == 1,
+           "state break stats" );
+    backend.clear();
+
+
+    // full batch breaks
+    for( int i=0; i<20; i++ ) {
+        addTestQuad( &batch, &texA, 0, 0, i );
+        }
+    batch.flush();
+    check( backend.mBatches.size() == 3 &&
+           backend.mBatches.getElementDirect( 0 ).numQuads == 8 &&
+           backend.mBatches.getElementDirect( 2 ).numQuads == 4,
+           "20 quads in batches of 8, 8, 4" );
+
+    batch.endFrame();
+    frame = batch.getLastFrameStats();
+    check( frame.fullBreaks == 2, "full break stats" );
+    backend.clear();
+
+
+    // solid color fills all corners
+    SpriteBatchState state = { &texA, 0, 0 };
+    float xy[8] = { 0, 0, 1, 0, 0, 1, 1, 1 };
+    float uv[8] = { 0, 0, 1, 0, 0, 1, 1, 1 };
+    float color[4] = { 0.25f, 0.5f, 0.75f, 1.0f };
+    batch.addQuadSolid( &state, xy, uv, color );
+    batch.flush();
+
+    char colorsMatch = ( backend.mRGBA.size() == 16 );
+    for( int i=0; i<backend.mRGBA.size(); i++ ) {
+        if( backend.mRGBA.getElementDirect( i ) != color[ i % 4 ] ) {
+            colorsMatch = false;
+            }
+        }
+    check( colorsMatch, "solid color on all 4 vertices" );
+    backend.clear();
+
+
+    // batching off draws each quad
+    batch.toggleBatching( false );
+    for( int i=0; i<3; i++ ) {
+        addTestQuad( &batch, &texA, 0, 0, i );
+        }
+    check( backend.mBatches.size() == 3 &&
+           batch.getNumPendingQuads() == 0,
+           "unbatched quads drawn right away" );
+    batch.toggleBatching( true );
+    batch.endFrame();
+    backend.clear();
+
+
+    SpriteBatchStats total = batch.getTotalStats();
+    check( total.frames == 4, "frames counted" );
+    check( total.batches == 1 + 5 + 3 + 1 + 3, "batches totaled" );
+    check( total.maxFrameBatches == 5, "max batches per frame" );
+    }
+
+
+
+typedef struct BenchSprite {
+        // for own-texture case
+        int ownTexture;
+
+        // for atlas case
+        int page;
+    } BenchSprite;
+
+
+
+int main( int inNumArgs, char **inArgs ) {
+
+    int numSprites = 400;
+    int numDraws = 5000;
+    int frames = 200;
+
+    if( inNumArgs > 1 ) {
+        numSprites = atoi( inArgs[1] );
+        }
+    if( inNumArgs > 2 ) {
+        numDraws = atoi( inArgs[2] );
+        }
+    if( inNumArgs > 3 ) {
+        frames = atoi( inArgs[3] );
+        }
+
+    if( numSprites < 1 || numDraws < 1 || frames < 1 ) {
+        printf( "Usage:  spriteBatchTest [numSprites] [numDraws] "
+                "[frames]\n" );
+        return 1;
+        }
+
+
+    checkPacker();
+    checkAtlasPage();
+    checkBatch();
+
+    if( numFailed == 0 ) {
+        printf( "Packer, page, and batch checks passed\n\n" );
+        }
+
+
+    // load sprites the way SpriteGL does:  up to 128x128 in 1024x1024
+    // pages, newest page first
+    SimpleVector<SpriteAtlasPage *> pages;
+    BenchSprite *sprites = new BenchSprite[ numSprites ];
+
+    unsigned char *spriteBytes = new unsigned char[ 128 * 128 * 4 ];
+    memset( spriteBytes, 128, 128 * 128 * 4 );
+
+    double start = Time::getCurrentTime();
+
+    for( int s=0; s<numSprites; s++ ) {
+        int w = randInt( 8, 128 );
+        int h = randInt( 8, 128 );
+        int x, y;
+
+        sprites[s].ownTexture = s;
+        sprites[s].page = -1;
+
+        for( int p=pages.size() - 1; p >= 0; p-- ) {
+            if( pages.getElementDirect( p )->addSprite( spriteBytes, w, h,
+                                                        &x, &y ) ) {
+                sprites[s].page = p;
+                break;
+                }
+            }
+        if( sprites[s].page == -1 ) {
+            SpriteAtlasPage *page = new SpriteAtlasPage( 1024, 1024, 2 );
+            page->addSprite( spriteBytes, w, h, &x, &y );
+            pages.push_back( page );
+            sprites[s].page = pages.size() - 1;
+            }
+        }
+    double packSeconds = Time::getCurrentTime() - start;
+
+    double occupancy = 0;
+    for( int p=0; p<pages.size(); p++ ) {
+        occupancy += pages.getElementDirect( p )->getOccupancy();
+        }
+
+    printf( "%d sprites packed into %d pages (%.1f%% full) in %.2f ms\n\n",
+            numSprites, pages.size(), 100 * occupancy / pages.size(),
+            1000 * packSeconds );
+
+    delete [] spriteBytes;
+
+
+    // same random draw order for both
+    int *drawOrder = new int[ numDraws ];
+    for( int d=0; d<numDraws; d++ ) {
+        drawOrder[d] = randInt( 0, numSprites - 1 );
+        }
+
+    float xy[8] = { 0, 0, 1, 0, 0, 1, 1, 1 };
+    float uv[8] = { 0, 0, 1, 0, 0, 1, 1, 1 };
+    float color[4] = { 1, 1, 1, 1 };
+
+    printf( "%-20s %14s %16s %14s\n",
+            "textures", "draws/frame", "sprites/draw", "us/frame" );
+
+    for( int atlas=0; atlas<2; atlas++ ) {
+        CountingBackend backend;
+        SpriteBatch batch( &backend );
+
+        start = Time::getCurrentTime();
+
+        for( int f=0; f<frames; f++ ) {
+            for( int d=0; d<numDraws; d++ ) {
+                BenchSprite *s = &( sprites[ drawOrder[d] ] );
+
+                // any distinct pointers do
+                SpriteBatchState state;
+                if( atlas ) {
+                    state.texture = pages.getElementDirect( s->page );
+                    }
+                else {
+                    state.texture = s;
+                    }
+                state.minFilter = 1;
+                state.magFilter = 1;
+
+                batch.addQuadSolid( &state, xy, uv, color );
+                }
+            batch.flush();
+            batch.endFrame();
+            }
+
+        double seconds = Time::getCurrentTime() - start;
+
+        SpriteBatchStats total = batch.getTotalStats();
+
+        printf( "%-20s %14.1f %16.1f %14.1f\n",
+                atlas ? "atlas pages" : "one per sprite",
+                total.batches / (double)total.frames,
+                total.quads / (double)total.batches,
+                1000000 * seconds / frames );
+
+        if( ! atlas ) {
+            check( total.batches >= total.frames * numDraws / 2,
+                   "own textures in random order barely batch" );
+            }
+        else {
+            check( total.batches <= total.frames * numDraws,
+                   "atlas batches no worse" );
+            }
+        }
+
+
+    // a game tends to draw a page's sprites together (same object,
+    // same layer), modeled here by sorting draws by page
+    {
+        CountingBackend backend;
+        SpriteBatch batch( &backend );
+
+        for( int p=0; p<pages.size(); p++ ) {
+            for( int d=0; d<numDraws; d++ ) {
+                BenchSprite *s = &( sprites[ drawOrder[d] ] );
+                if( s->page == p ) {
+                    SpriteBatchState state =
+                        { pages.getElementDirect( p ), 1, 1 };
+                    batch.addQuadSolid( &state, xy, uv, color );
+                    }
+                }
+            }
+        batch.flush();
+        batch.endFrame();
+
+        SpriteBatchStats frame = batch.getLastFrameStats();
+
+        printf( "%-20s %14d %16.1f\n", "atlas, page order",
+                frame.batches, frame.quads / (double)frame.batches );
+
+        check( frame.batches <= pages.size() + numDraws / 4096 + 1,
+               "one batch per page in page order" );
+        }
+
+
+    for( int p=0; p<pages.size(); p++ ) {
+        delete pages.getElementDirect( p );
+        }
+    delete [] sprites;
+    delete [] drawOrder;
+
+    if( numFailed > 0 ) {
+        printf( "\n%d checks FAILED\n", numFailed );
+        return 1;
+        }
+
+    printf( "\nAll checks passed\n" );
+    return 0;
+    }
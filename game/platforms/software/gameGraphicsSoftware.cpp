@@ -0,0 +1,2108 @@
+#include "gameGraphicsSoftware.h"
+
+#include "minorGems/game/gameGraphics.h"
+
+#include "minorGems/graphics/RGBAImage.h"
+#include "minorGems/system/Thread.h"
+#include "minorGems/system/MutexLock.h"
+#include "minorGems/system/Semaphore.h"
+#include "minorGems/util/SimpleVector.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__GNUC__) && defined(__SSE2__)
+#include <emmintrin.h>
+#define SOFT_SSE2
+#endif
+
+
+
+// one pixel's RGBA as floats
+// with the GCC/clang vector extension, math on a whole pixel compiles
+// to single SSE or NEON instructions, and with SSE2, pixels are converted
+// to and from bytes four channels at a time
+#if defined(__GNUC__)
+
+typedef float SoftColor __attribute__ (( vector_size( 16 ) ));
+
+// result of comparing two SoftColors, all bits set where true
+typedef int SoftMask __attribute__ (( vector_size( 16 ) ));
+
+#else
+
+typedef struct SoftColor {
+        float v[4];
+
+        float &operator[]( int inI ) {
+            return v[inI];
+            }
+        float operator[]( int inI ) const {
+            return v[inI];
+            }
+    } SoftColor;
+
+
+inline SoftColor operator+( SoftColor inA, SoftColor inB ) {
+    for( int i=0; i<4; i++ ) {
+        inA.v[i] += inB.v[i];
+        }
+    return inA;
+    }
+
+inline SoftColor operator-( SoftColor inA, SoftColor inB ) {
+    for( int i=0; i<4; i++ ) {
+        inA.v[i] -= inB.v[i];
+        }
+    return inA;
+    }
+
+inline SoftColor operator*( SoftColor inA, SoftColor inB ) {
+    for( int i=0; i<4; i++ ) {
+        inA.v[i] *= inB.v[i];
+        }
+    return inA;
+    }
+
+#endif
+
+
+
+static inline SoftColor softColor( float inR, float inG, float inB,
+                                   float inA ) {
+    SoftColor c = { inR, inG, inB, inA };
+    return c;
+    }
+
+
+static inline SoftColor splat( float inF ) {
+    return softColor( inF, inF, inF, inF );
+    }
+
+
+static inline SoftColor loadPixel( const unsigned char *inBytes ) {
+#ifdef SOFT_SSE2
+    // widen 4 bytes to 4 ints in registers, then convert all at once
+    int packed;
+    memcpy( &packed, inBytes, 4 );
+
+    __m128i zero = _mm_setzero_si128();
+    __m128i ints =
+        _mm_unpacklo_epi16(
+            _mm_unpacklo_epi8( _mm_cvtsi32_si128( packed ), zero ), zero );
+
+    return (SoftColor)_mm_cvtepi32_ps( ints ) * splat( 1.0f / 255 );
+#else
+    return softColor( inBytes[0], inBytes[1], inBytes[2], inBytes[3] ) *
+        splat( 1.0f / 255 );
+#endif
+    }
+
+
+static inline SoftColor clampColor( SoftColor inC ) {
+#if defined(__GNUC__)
+    // without branches, 0 bits where below 0, and bits of 1 where above 1
+    SoftMask low = inC < splat( 0 );
+    SoftMask high = inC > splat( 1 );
+
+    SoftMask bits = ( (SoftMask)inC & ~( low | high ) ) |
+        ( (SoftMask)splat( 1 ) & high );
+
+    return (SoftColor)bits;
+#else
+    for( int i=0; i<4; i++ ) {
+        if( inC[i] < 0 ) {
+            inC[i] = 0;
+            }
+        else if( inC[i] > 1 ) {
+            inC[i] = 1;
+            }
+        }
+    return inC;
+#endif
+    }
+
+
+static inline void storePixel( SoftColor inC, unsigned char *outBytes ) {
+    inC = clampColor( inC ) * splat( 255 ) + splat( 0.5f );
+
+#ifdef SOFT_SSE2
+    // truncate to ints, then narrow to bytes (all in 0..255 already)
+    __m128i ints = _mm_cvttps_epi32( (__m128)inC );
+    __m128i bytes = _mm_packus_epi16( _mm_packs_epi32( ints, ints ), ints );
+
+    int packed = _mm_cvtsi128_si32( bytes );
+    memcpy( outBytes, &packed, 4 );
+#else
+    for( int i=0; i<4; i++ ) {
+        outBytes[i] = (unsigned char)( inC[i] );
+        }
+#endif
+    }
+
+
+
+
+// tiles are 64x64 pixels
+#define TILE_SHIFT 6
+#define TILE_SIZE ( 1 << TILE_SHIFT )
+
+// vertex positions have 8 bits of subpixel precision
+#define SUBPIXEL_SHIFT 8
+#define SUBPIXELS ( 1 << SUBPIXEL_SHIFT )
+
+// vertices are clamped to this, in subpixels, so that edge function
+// products fit in 64 bits
+#define MAX_SUBPIXEL_COORD ( 1 << 26 )
+
+// commands recorded before drawing is forced, to bound memory
+#define MAX_PENDING_COMMANDS 65536
+
+
+
+static int fbWidth = 0;
+static int fbHeight = 0;
+
+// RGBA, top row first
+static unsigned char *framebuffer = NULL;
+
+// one byte per pixel
+static unsigned char *stencilBuffer = NULL;
+
+
+static double viewLeft = 0;
+static double viewTop = 0;
+static double viewScaleX = 1;
+static double viewScaleY = 1;
+
+
+static SoftwareGraphicsStats stats = { 0, 0, 0, 0 };
+
+
+
+
+static float lastR, lastG, lastB, lastA;
+
+
+static char additiveTextureColorMode = false;
+
+
+
+typedef struct GlobalFade {
+        int handle;
+        float fade;
+    } GlobalFade;
+
+
+static int nextFadeHandle = 0;
+
+static SimpleVector<GlobalFade> globalFades;
+
+static float globalFadeTotal = 1.0f;
+
+
+static void recalcGlobalFade() {
+    globalFadeTotal = 1.0f;
+
+    for( int i=0; i<globalFades.size(); i++ ) {
+        globalFadeTotal *=
+            globalFades.getElementDirect( i ).fade;
+        }
+    }
+
+
+
+int addGlobalFade( float inA ) {
+    int h = nextFadeHandle;
+
+    GlobalFade f = { h, inA };
+
+    globalFades.push_back( f );
+
+    nextFadeHandle++;
+
+    recalcGlobalFade();
+
+    return h;
+    }
+
+
+
+void removeGlobalFade( int inHandle ) {
+    for( int i=0; i<globalFades.size(); i++ ) {
+        if( globalFades.getElementDirect( i ).handle == inHandle ) {
+            globalFades.deleteElement( i );
+            break;
+            }
+        }
+
+    recalcGlobalFade();
+    }
+
+
+
+float getTotalGlobalFade() {
+    return globalFadeTotal;
+    }
+
+
+
+// color that vertices get, with fades applied
+static float drawColor[4] = { 1, 1, 1, 1 };
+
+
+void setDrawColor( float inR, float inG, float inB, float inA ) {
+    lastR = inR;
+    lastG = inG;
+    lastB = inB;
+    lastA = inA;
+
+    if( additiveTextureColorMode &&
+        globalFadeTotal < 1.0f ) {
+
+        // same fade math as the GL backend
+        inR = 1.0f - ( 1.0f - inR ) * globalFadeTotal;
+        inG = 1.0f - ( 1.0f - inG ) * globalFadeTotal;
+        inB = 1.0f - ( 1.0f - inB ) * globalFadeTotal;
+        }
+    else {
+        inA *= globalFadeTotal;
+        }
+
+    drawColor[0] = inR;
+    drawColor[1] = inG;
+    drawColor[2] = inB;
+    drawColor[3] = inA;
+    }
+
+
+
+void setDrawColor( FloatColor inColor ) {
+    setDrawColor( inColor.r, inColor.g, inColor.b, inColor.a );
+    }
+
+
+
+FloatColor getDrawColor() {
+    FloatColor c;
+    c.r = lastR;
+    c.g = lastG;
+    c.b = lastB;
+    c.a = lastA;
+
+    return c;
+    }
+
+
+void setDrawFade( float inA ) {
+    lastA = inA;
+
+    drawColor[0] = lastR;
+    drawColor[1] = lastG;
+    drawColor[2] = lastB;
+    drawColor[3] = inA * globalFadeTotal;
+    }
+
+
+
+
+FloatColor getFloatColor( const char *inHexString ) {
+    int r = 0;
+    int g = 0;
+    int b = 0;
+    sscanf( inHexString, "#%02x%02x%02x", &r, &g, &b );
+
+    FloatColor f = { r / 255.0f,
+                     g / 255.0f,
+                     b / 255.0f,
+                     1.0f };
+
+    return f;
+    }
+
+
+
+
+// src * srcAlpha + dst * ( 1 - srcAlpha ), src * srcAlpha + dst,
+// and src * dst, like the GL backend's glBlendFunc settings
+enum SoftBlend {
+    SOFT_BLEND_NORMAL = 0,
+    SOFT_BLEND_ADDITIVE,
+    SOFT_BLEND_MULTIPLICATIVE
+    };
+
+
+// how vertex color and texel combine:  GL_MODULATE, GL_ADD,
+// and the combiner that drawSpriteAlphaOnly sets up (vertex RGB,
+// vertex alpha times texel alpha)
+enum SoftTextureMode {
+    SOFT_TEXTURE_MODULATE = 0,
+    SOFT_TEXTURE_ADD,
+    SOFT_TEXTURE_ALPHA_ONLY
+    };
+
+
+enum SoftStencilMode {
+    SOFT_STENCIL_OFF = 0,
+    SOFT_STENCIL_WRITE,
+    SOFT_STENCIL_TEST
+    };
+
+
+
+static SoftBlend blendMode = SOFT_BLEND_NORMAL;
+
+static SoftStencilMode stencilMode = SOFT_STENCIL_OFF;
+static unsigned char stencilValue = 0;
+static char colorWriteOn = true;
+static char alphaTestOn = false;
+static float alphaTestMin = 0;
+
+static char scissorOn = false;
+// x0, y0, x1, y1 in pixels, top row 0, ends exclusive
+static int scissorRect[4] = { 0, 0, 0, 0 };
+
+
+
+void toggleAdditiveBlend( char inAdditive ) {
+    if( inAdditive ) {
+        blendMode = SOFT_BLEND_ADDITIVE;
+        }
+    else {
+        blendMode = SOFT_BLEND_NORMAL;
+        }
+    }
+
+
+
+void toggleMultiplicativeBlend( char inMultiplicative ) {
+    if( inMultiplicative ) {
+        blendMode = SOFT_BLEND_MULTIPLICATIVE;
+        }
+    else {
+        blendMode = SOFT_BLEND_NORMAL;
+        }
+    }
+
+
+
+void toggleAdditiveTextureColoring( char inAdditive ) {
+    additiveTextureColorMode = inAdditive;
+    }
+
+
+
+
+static char linearTextureFilterOn = false;
+
+void toggleLinearMagFilter( char inLinearFilterOn ) {
+    linearTextureFilterOn = inLinearFilterOn;
+    }
+
+
+
+char getLinearMagFilterOn() {
+    return linearTextureFilterOn;
+    }
+
+
+
+void toggleMipMapGeneration( char inGenerateMipMaps ) {
+    }
+
+
+
+// no mipmaps are built, so a mipmap min filter samples the base level
+// linearly when a texture is shrunk
+static char mipMapTextureFilterOn = false;
+
+void toggleMipMapMinFilter( char inMipMapFilterOn ) {
+    mipMapTextureFilterOn = inMipMapFilterOn;
+    }
+
+
+static char transparentCroppingOn = false;
+
+void toggleTransparentCropping( char inCrop ) {
+    transparentCroppingOn = inCrop;
+    }
+
+
+
+
+typedef struct SoftSprite {
+        // RGBA, top row first
+        // alpha-only sprites have black RGB
+        unsigned char *rgba;
+
+        int width;
+        int height;
+
+        char alphaOnly;
+
+        // fraction of width or height from center to the edge of
+        // non-transparent pixels, 0.5 unless cropped
+        double coloredRadiusLeftX;
+        double coloredRadiusRightX;
+        double coloredRadiusTopY;
+        double coloredRadiusBottomY;
+
+        doublePair centerOffset;
+
+        char wrapH;
+        char wrapV;
+    } SoftSprite;
+
+
+
+// everything about how a primitive draws, other than its vertices
+// compared with memcmp, so always cleared before filling
+typedef struct SoftDrawState {
+        // NULL if untextured
+        SoftSprite *sprite;
+        char wrapH;
+        char wrapV;
+
+        char textureMode;
+        char blend;
+
+        char stencil;
+        unsigned char stencilValue;
+        char colorWrite;
+        char alphaTest;
+        float minAlpha;
+
+        // framebuffer clipped to scissor, x0, y0, x1, y1
+        int clip[4];
+    } SoftDrawState;
+
+
+
+enum SoftCommandType {
+    SOFT_TRIANGLE = 0,
+    SOFT_CLEAR_COLOR,
+    SOFT_CLEAR_STENCIL
+    };
+
+
+typedef struct SoftCommand {
+        char type;
+
+        // all vertex colors the same
+        char flat;
+
+        char linearFilter;
+
+        int state;
+
+        // pixels touched, clipped, x0, y0, x1, y1
+        int bounds[4];
+
+        // vertex positions in subpixels, y down, counter-clockwise on screen
+        int x[3];
+        int y[3];
+
+        // 1 / twice the area, in subpixels squared
+        double invArea;
+
+        // clear color in color[0]
+        float color[3][4];
+
+        float u[3];
+        float v[3];
+    } SoftCommand;
+
+
+
+typedef struct SoftVertex {
+        // view space
+        double x, y;
+
+        float color[4];
+
+        float u, v;
+    } SoftVertex;
+
+
+
+static SimpleVector<SoftDrawState> states;
+
+static SimpleVector<SoftCommand> commands;
+
+static int tilesWide = 0;
+static int tilesHigh = 0;
+
+// command indices for each tile, in submission order
+static SimpleVector<int> *tileBins = NULL;
+
+
+
+
+static void getClipRect( int outClip[4] ) {
+    outClip[0] = 0;
+    outClip[1] = 0;
+    outClip[2] = fbWidth;
+    outClip[3] = fbHeight;
+
+    if( scissorOn ) {
+        for( int i=0; i<2; i++ ) {
+            if( scissorRect[i] > outClip[i] ) {
+                outClip[i] = scissorRect[i];
+                }
+            if( scissorRect[ i + 2 ] < outClip[ i + 2 ] ) {
+                outClip[ i + 2 ] = scissorRect[ i + 2 ];
+                }
+            }
+        }
+    }
+
+
+
+// index of current state, reusing the last one if nothing changed
+static int getDrawState( SoftSprite *inSprite, SoftTextureMode inMode ) {
+    if( commands.size() == 0 ) {
+        // nothing pending uses old states
+        // (not cleared when drawing, since a draw call holding a state
+        //  index can force drawing partway through)
+        states.deleteAll();
+        }
+
+    SoftDrawState s;
+    memset( &s, 0, sizeof( s ) );
+
+    s.sprite = inSprite;
+    if( inSprite != NULL ) {
+        s.wrapH = inSprite->wrapH;
+        s.wrapV = inSprite->wrapV;
+        s.textureMode = inMode;
+        }
+    s.blend = blendMode;
+
+    s.stencil = stencilMode;
+    s.stencilValue = stencilValue;
+    s.colorWrite = colorWriteOn;
+    s.alphaTest = alphaTestOn;
+    if( alphaTestOn ) {
+        s.minAlpha = alphaTestMin;
+        }
+
+    getClipRect( s.clip );
+
+    int last = states.size() - 1;
+
+    if( last < 0 ||
+        memcmp( states.getElement( last ), &s, sizeof( s ) ) != 0 ) {
+        states.push_back( s );
+        last++;
+        }
+    return last;
+    }
+
+
+
+static void flushCommands();
+
+
+static void addCommand( SoftCommand *inCommand ) {
+    int index = commands.size();
+    commands.push_back( *inCommand );
+
+    int *b = inCommand->bounds;
+
+    for( int ty = b[1] >> TILE_SHIFT;
+         ty <= ( b[3] - 1 ) >> TILE_SHIFT; ty++ ) {
+
+        for( int tx = b[0] >> TILE_SHIFT;
+             tx <= ( b[2] - 1 ) >> TILE_SHIFT; tx++ ) {
+
+            tileBins[ ty * tilesWide + tx ].push_back( index );
+            stats.binnedCommands++;
+            }
+        }
+
+    if( commands.size() >= MAX_PENDING_COMMANDS ) {
+        flushCommands();
+        }
+    }
+
+
+
+static int toSubpixels( double inPixels ) {
+    double s = inPixels * SUBPIXELS;
+
+    if( s > MAX_SUBPIXEL_COORD ) {
+        s = MAX_SUBPIXEL_COORD;
+        }
+    else if( s < -MAX_SUBPIXEL_COORD ) {
+        s = -MAX_SUBPIXEL_COORD;
+        }
+    return (int)lrint( s );
+    }
+
+
+
+static void addTriangle( int inState,
+                         SoftVertex *inA, SoftVertex *inB, SoftVertex *inC ) {
+
+    SoftDrawState *state = states.getElement( inState );
+
+    SoftVertex *verts[3] = { inA, inB, inC };
+
+    SoftCommand c;
+    c.type = SOFT_TRIANGLE;
+    c.state = inState;
+
+    for( int i=0; i<3; i++ ) {
+        c.x[i] = toSubpixels( ( verts[i]->x - viewLeft ) * viewScaleX );
+        c.y[i] = toSubpixels( ( viewTop - verts[i]->y ) * viewScaleY );
+        }
+
+    long long area =
+        (long long)( c.x[1] - c.x[0] ) * ( c.y[2] - c.y[0] ) -
+        (long long)( c.y[1] - c.y[0] ) * ( c.x[2] - c.x[0] );
+
+    if( area == 0 ) {
+        return;
+        }
+    if( area < 0 ) {
+        // same winding for all, so shared edges are filled once
+        int t = c.x[1];
+        c.x[1] = c.x[2];
+        c.x[2] = t;
+        t = c.y[1];
+        c.y[1] = c.y[2];
+        c.y[2] = t;
+
+        SoftVertex *v = verts[1];
+        verts[1] = verts[2];
+        verts[2] = v;
+
+        area = -area;
+        }
+    c.invArea = 1.0 / (double)area;
+
+
+    int minX = c.x[0];
+    int maxX = c.x[0];
+    int minY = c.y[0];
+    int maxY = c.y[0];
+
+    for( int i=1; i<3; i++ ) {
+        if( c.x[i] < minX ) {
+            minX = c.x[i];
+            }
+        if( c.x[i] > maxX ) {
+            maxX = c.x[i];
+            }
+        if( c.y[i] < minY ) {
+            minY = c.y[i];
+            }
+        if( c.y[i] > maxY ) {
+            maxY = c.y[i];
+            }
+        }
+
+    c.bounds[0] = minX >> SUBPIXEL_SHIFT;
+    c.bounds[1] = minY >> SUBPIXEL_SHIFT;
+    c.bounds[2] = ( maxX >> SUBPIXEL_SHIFT ) + 1;
+    c.bounds[3] = ( maxY >> SUBPIXEL_SHIFT ) + 1;
+
+    for( int i=0; i<2; i++ ) {
+        if( state->clip[i] > c.bounds[i] ) {
+            c.bounds[i] = state->clip[i];
+            }
+        if( state->clip[ i + 2 ] < c.bounds[ i + 2 ] ) {
+            c.bounds[ i + 2 ] = state->clip[ i + 2 ];
+            }
+        }
+
+    if( c.bounds[0] >= c.bounds[2] || c.bounds[1] >= c.bounds[3] ) {
+        return;
+        }
+
+
+    for( int i=0; i<3; i++ ) {
+        memcpy( c.color[i], verts[i]->color, 4 * sizeof( float ) );
+        c.u[i] = verts[i]->u;
+        c.v[i] = verts[i]->v;
+        }
+
+    c.flat =
+        memcmp( c.color[0], c.color[1], 4 * sizeof( float ) ) == 0 &&
+        memcmp( c.color[0], c.color[2], 4 * sizeof( float ) ) == 0;
+
+
+    c.linearFilter = linearTextureFilterOn;
+
+    if( state->sprite != NULL &&
+        mipMapTextureFilterOn && ! linearTextureFilterOn ) {
+
+        // texels per pixel, along x and y, to tell if this is shrunk
+        double e1x = ( c.x[1] - c.x[0] ) / (double)SUBPIXELS;
+        double e1y = ( c.y[1] - c.y[0] ) / (double)SUBPIXELS;
+        double e2x = ( c.x[2] - c.x[0] ) / (double)SUBPIXELS;
+        double e2y = ( c.y[2] - c.y[0] ) / (double)SUBPIXELS;
+
+        double du1 = ( c.u[1] - c.u[0] ) * state->sprite->width;
+        double du2 = ( c.u[2] - c.u[0] ) * state->sprite->width;
+        double dv1 = ( c.v[1] - c.v[0] ) * state->sprite->height;
+        double dv2 = ( c.v[2] - c.v[0] ) * state->sprite->height;
+
+        double det = e1x * e2y - e2x * e1y;
+
+        double dudx = ( du1 * e2y - du2 * e1y ) / det;
+        double dvdx = ( dv1 * e2y - dv2 * e1y ) / det;
+        double dudy = ( du2 * e1x - du1 * e2x ) / det;
+        double dvdy = ( dv2 * e1x - dv1 * e2x ) / det;
+
+        if( dudx * dudx + dvdx * dvdx > 1 ||
+            dudy * dudy + dvdy * dvdy > 1 ) {
+            c.linearFilter = true;
+            }
+        }
+
+    stats.triangles++;
+
+    addCommand( &c );
+    }
+
+
+
+static void addClear( SoftCommandType inType, float inColor[4] ) {
+    SoftCommand c;
+    memset( &c, 0, sizeof( c ) );
+
+    c.type = inType;
+
+    // glClear respects the scissor box
+    getClipRect( c.bounds );
+
+    if( c.bounds[0] >= c.bounds[2] || c.bounds[1] >= c.bounds[3] ) {
+        return;
+        }
+
+    if( inColor != NULL ) {
+        memcpy( c.color[0], inColor, 4 * sizeof( float ) );
+        }
+
+    addCommand( &c );
+    }
+
+
+
+
+static inline int wrapTexel( int inI, int inSize, char inRepeat ) {
+    if( inRepeat ) {
+        inI %= inSize;
+        if( inI < 0 ) {
+            inI += inSize;
+            }
+        return inI;
+        }
+
+    if( inI < 0 ) {
+        return 0;
+        }
+    if( inI >= inSize ) {
+        return inSize - 1;
+        }
+    return inI;
+    }
+
+
+
+// sprite fields used while sampling, copied to the stack before drawing,
+// since writes through framebuffer pointers could alias the sprite
+typedef struct SoftTexture {
+        const unsigned char *rgba;
+        int width;
+        int height;
+        char wrapH;
+        char wrapV;
+    } SoftTexture;
+
+
+
+static inline SoftColor getTexel( const SoftTexture *inT, int inX, int inY ) {
+    inX = wrapTexel( inX, inT->width, inT->wrapH );
+    inY = wrapTexel( inY, inT->height, inT->wrapV );
+
+    return loadPixel( &( inT->rgba[ ( inY * inT->width + inX ) * 4 ] ) );
+    }
+
+
+
+static inline SoftColor sampleTexture( const SoftTexture *inT,
+                                       char inLinear, float inU, float inV ) {
+    if( ! inLinear ) {
+        return getTexel( inT,
+                         (int)floorf( inU * inT->width ),
+                         (int)floorf( inV * inT->height ) );
+        }
+
+    float fx = inU * inT->width - 0.5f;
+    float fy = inV * inT->height - 0.5f;
+
+    float x0 = floorf( fx );
+    float y0 = floorf( fy );
+
+    SoftColor ax = splat( fx - x0 );
+    SoftColor ay = splat( fy - y0 );
+
+    int ix = (int)x0;
+    int iy = (int)y0;
+
+    SoftColor t00 = getTexel( inT, ix, iy );
+    SoftColor t10 = getTexel( inT, ix + 1, iy );
+    SoftColor t01 = getTexel( inT, ix, iy + 1 );
+    SoftColor t11 = getTexel( inT, ix + 1, iy + 1 );
+
+    SoftColor top = t00 + ax * ( t10 - t00 );
+    SoftColor bottom = t01 + ax * ( t11 - t01 );
+
+    return top + ay * ( bottom - top );
+    }
+
+
+
+
+static void drawTriangle( SoftCommand *inC, int inBounds[4] ) {
+    SoftDrawState *s = states.getElement( inC->state );
+
+    // edge e runs between the two vertices other than e
+    // it is >= 0 inside, and its value at a pixel is vertex e's weight
+    long long stepX[3];
+    long long stepY[3];
+    long long row[3];
+
+    long long startX = (long long)inBounds[0] * SUBPIXELS + SUBPIXELS / 2;
+    long long startY = (long long)inBounds[1] * SUBPIXELS + SUBPIXELS / 2;
+
+    for( int e=0; e<3; e++ ) {
+        int a = ( e + 1 ) % 3;
+        int b = ( e + 2 ) % 3;
+
+        long long dx = inC->x[b] - inC->x[a];
+        long long dy = inC->y[b] - inC->y[a];
+
+        long long offset = dy * inC->x[a] - dx * inC->y[a];
+
+        // top-left rule:  pixels centered exactly on an edge belong to
+        // only one of the two triangles sharing it
+        if( ! ( dy < 0 || ( dy == 0 && dx > 0 ) ) ) {
+            offset -= 1;
+            }
+
+        row[e] = -dy * startX + dx * startY + offset;
+        stepX[e] = -dy * SUBPIXELS;
+        stepY[e] = dx * SUBPIXELS;
+        }
+
+
+    SoftColor c0 = softColor( inC->color[0][0], inC->color[0][1],
+                              inC->color[0][2], inC->color[0][3] );
+    SoftColor d1 = softColor( inC->color[1][0], inC->color[1][1],
+                              inC->color[1][2], inC->color[1][3] ) - c0;
+    SoftColor d2 = softColor( inC->color[2][0], inC->color[2][1],
+                              inC->color[2][2], inC->color[2][3] ) - c0;
+
+    float u0 = inC->u[0];
+    float du1 = inC->u[1] - u0;
+    float du2 = inC->u[2] - u0;
+    float v0 = inC->v[0];
+    float dv1 = inC->v[1] - v0;
+    float dv2 = inC->v[2] - v0;
+
+    double invArea = inC->invArea;
+    char flat = inC->flat;
+    char linear = inC->linearFilter;
+
+    char textured = ( s->sprite != NULL );
+
+    SoftTexture texture = { NULL, 1, 1, false, false };
+    if( textured ) {
+        texture.rgba = s->sprite->rgba;
+        texture.width = s->sprite->width;
+        texture.height = s->sprite->height;
+        texture.wrapH = s->wrapH;
+        texture.wrapV = s->wrapV;
+        }
+    char textureMode = s->textureMode;
+    char blend = s->blend;
+    char stencil = s->stencil;
+    unsigned char stencilRef = s->stencilValue;
+    char colorWrite = s->colorWrite;
+    char alphaTest = s->alphaTest;
+    float minAlpha = s->minAlpha;
+
+
+    for( int y=inBounds[1]; y<inBounds[3]; y++ ) {
+
+        // narrow row to the span inside all three edges
+        long long spanStart = inBounds[0];
+        long long spanEnd = inBounds[2];
+
+        for( int e=0; e<3; e++ ) {
+            long long w = row[e];
+            long long step = stepX[e];
+
+            if( step > 0 ) {
+                if( w < 0 ) {
+                    long long start = inBounds[0] + ( -w + step - 1 ) / step;
+                    if( start > spanStart ) {
+                        spanStart = start;
+                        }
+                    }
+                }
+            else if( w < 0 ) {
+                spanEnd = spanStart;
+                }
+            else if( step < 0 ) {
+                long long end = inBounds[0] + w / -step + 1;
+                if( end < spanEnd ) {
+                    spanEnd = end;
+                    }
+                }
+            }
+
+        if( spanStart >= spanEnd ) {
+            for( int e=0; e<3; e++ ) {
+                row[e] += stepY[e];
+                }
+            continue;
+            }
+
+        long long skip = spanStart - inBounds[0];
+
+        long long w1 = row[1] + skip * stepX[1];
+        long long w2 = row[2] + skip * stepX[2];
+
+        int pixel = y * fbWidth + (int)spanStart;
+
+        unsigned char *dest = &( framebuffer[ pixel * 4 ] );
+        unsigned char *stencilDest = &( stencilBuffer[ pixel ] );
+
+        for( int x=(int)spanStart; x<spanEnd;
+             x++, dest += 4, stencilDest++,
+                 w1 += stepX[1], w2 += stepX[2] ) {
+
+            float l1 = 0;
+            float l2 = 0;
+
+            if( ! flat || textured ) {
+                l1 = (float)( w1 * invArea );
+                l2 = (float)( w2 * invArea );
+                }
+
+            SoftColor color = c0;
+
+            if( ! flat ) {
+                color = c0 + splat( l1 ) * d1 + splat( l2 ) * d2;
+                }
+
+            if( textured ) {
+                SoftColor t = sampleTexture( &texture, linear,
+                                             u0 + l1 * du1 + l2 * du2,
+                                             v0 + l1 * dv1 + l2 * dv2 );
+
+                float a;
+
+                switch( textureMode ) {
+                    case SOFT_TEXTURE_MODULATE:
+                        color = color * t;
+                        break;
+                    case SOFT_TEXTURE_ADD:
+                        a = color[3] * t[3];
+                        color = color + t;
+                        color[3] = a;
+                        break;
+                    default:
+                        color[3] *= t[3];
+                        break;
+                    }
+                }
+
+            color = clampColor( color );
+
+            if( alphaTest && ! ( color[3] > minAlpha ) ) {
+                continue;
+                }
+
+            if( stencil == SOFT_STENCIL_TEST ) {
+                if( *stencilDest != stencilRef ) {
+                    continue;
+                    }
+                }
+            else if( stencil == SOFT_STENCIL_WRITE ) {
+                *stencilDest = stencilRef;
+                }
+
+            if( ! colorWrite ) {
+                continue;
+                }
+
+            SoftColor a = splat( color[3] );
+
+            if( blend == SOFT_BLEND_NORMAL ) {
+                if( color[3] <= 0 ) {
+                    continue;
+                    }
+                SoftColor d = loadPixel( dest );
+                storePixel( color * a + d * ( splat( 1 ) - a ), dest );
+                }
+            else if( blend == SOFT_BLEND_ADDITIVE ) {
+                if( color[3] <= 0 ) {
+                    continue;
+                    }
+                storePixel( color * a + loadPixel( dest ), dest );
+                }
+            else {
+                storePixel( color * loadPixel( dest ), dest );
+                }
+            }
+
+        for( int e=0; e<3; e++ ) {
+            row[e] += stepY[e];
+            }
+        }
+    }
+
+
+
+static void drawClear( SoftCommand *inC, int inBounds[4] ) {
+    int width = inBounds[2] - inBounds[0];
+
+    if( inC->type == SOFT_CLEAR_STENCIL ) {
+        for( int y=inBounds[1]; y<inBounds[3]; y++ ) {
+            memset( &( stencilBuffer[ y * fbWidth + inBounds[0] ] ), 0,
+                    width );
+            }
+        return;
+        }
+
+    unsigned char bytes[4];
+    storePixel( softColor( inC->color[0][0], inC->color[0][1],
+                           inC->color[0][2], inC->color[0][3] ),
+                bytes );
+
+    for( int y=inBounds[1]; y<inBounds[3]; y++ ) {
+        unsigned char *dest =
+            &( framebuffer[ ( y * fbWidth + inBounds[0] ) * 4 ] );
+
+        for( int x=0; x<width; x++ ) {
+            memcpy( dest, bytes, 4 );
+            dest += 4;
+            }
+        }
+    }
+
+
+
+static void rasterizeTile( int inTile ) {
+    int tileX = ( inTile % tilesWide ) * TILE_SIZE;
+    int tileY = ( inTile / tilesWide ) * TILE_SIZE;
+
+    int tileBounds[4] = { tileX, tileY,
+                          tileX + TILE_SIZE, tileY + TILE_SIZE };
+
+    SimpleVector<int> *bin = &( tileBins[ inTile ] );
+
+    int numInBin = bin->size();
+
+    for( int i=0; i<numInBin; i++ ) {
+        SoftCommand *c = commands.getElement( bin->getElementDirect( i ) );
+
+        int b[4];
+        for( int j=0; j<2; j++ ) {
+            b[j] = c->bounds[j];
+            if( tileBounds[j] > b[j] ) {
+                b[j] = tileBounds[j];
+                }
+            b[ j + 2 ] = c->bounds[ j + 2 ];
+            if( tileBounds[ j + 2 ] < b[ j + 2 ] ) {
+                b[ j + 2 ] = tileBounds[ j + 2 ];
+                }
+            }
+
+        if( c->type == SOFT_TRIANGLE ) {
+            drawTriangle( c, b );
+            }
+        else {
+            drawClear( c, b );
+            }
+        }
+    }
+
+
+
+
+// tiles with something to draw in this flush
+static SimpleVector<int> activeTiles;
+
+static MutexLock tileLock;
+static int nextActiveTile = 0;
+
+
+// called by all rasterizing threads until tiles run out
+static void rasterizeActiveTiles() {
+    int numActive = activeTiles.size();
+
+    while( true ) {
+        tileLock.lock();
+        int i = nextActiveTile;
+        nextActiveTile++;
+        tileLock.unlock();
+
+        if( i >= numActive ) {
+            return;
+            }
+        rasterizeTile( activeTiles.getElementDirect( i ) );
+        }
+    }
+
+
+
+static Semaphore workStart;
+static Semaphore workDone;
+static char workersStopping = false;
+
+
+class SoftRasterThread : public Thread {
+
+    public:
+
+        // starts the thread
+        SoftRasterThread() {
+            start();
+            }
+
+        virtual void run() {
+            while( true ) {
+                workStart.wait();
+
+                if( workersStopping ) {
+                    return;
+                    }
+
+                rasterizeActiveTiles();
+
+                workDone.signal();
+                }
+            }
+    };
+
+
+// threads besides the one that calls gameGraphics functions
+static SimpleVector<SoftRasterThread *> workers;
+
+
+
+static void flushCommands() {
+    if( commands.size() == 0 ) {
+        return;
+        }
+
+    int numTiles = tilesWide * tilesHigh;
+
+    activeTiles.deleteAll();
+    for( int t=0; t<numTiles; t++ ) {
+        if( tileBins[t].size() > 0 ) {
+            activeTiles.push_back( t );
+            }
+        }
+
+    nextActiveTile = 0;
+
+    int numWorkers = workers.size();
+
+    if( activeTiles.size() < numWorkers ) {
+        numWorkers = activeTiles.size();
+        }
+
+    for( int i=0; i<numWorkers; i++ ) {
+        workStart.signal();
+        }
+
+    rasterizeActiveTiles();
+
+    for( int i=0; i<numWorkers; i++ ) {
+        workDone.wait();
+        }
+
+    for( int t=0; t<numTiles; t++ ) {
+        tileBins[t].deleteAll();
+        }
+    commands.deleteAll();
+
+    stats.flushes++;
+    }
+
+
+
+
+void initSoftwareGraphics( int inWidth, int inHeight, int inNumThreads ) {
+    fbWidth = inWidth;
+    fbHeight = inHeight;
+
+    framebuffer = new unsigned char[ fbWidth * fbHeight * 4 ];
+    memset( framebuffer, 0, fbWidth * fbHeight * 4 );
+
+    stencilBuffer = new unsigned char[ fbWidth * fbHeight ];
+    memset( stencilBuffer, 0, fbWidth * fbHeight );
+
+    tilesWide = ( fbWidth + TILE_SIZE - 1 ) / TILE_SIZE;
+    tilesHigh = ( fbHeight + TILE_SIZE - 1 ) / TILE_SIZE;
+
+    tileBins = new SimpleVector<int>[ tilesWide * tilesHigh ];
+
+    stats.triangles = 0;
+    stats.binnedCommands = 0;
+    stats.flushes = 0;
+
+    setSoftwareGraphicsView( 0, fbWidth, 0, fbHeight );
+
+    workersStopping = false;
+
+    for( int i=1; i<inNumThreads; i++ ) {
+        workers.push_back( new SoftRasterThread() );
+        }
+    }
+
+
+
+void freeSoftwareGraphics() {
+    flushCommands();
+
+    workersStopping = true;
+
+    for( int i=0; i<workers.size(); i++ ) {
+        workStart.signal();
+        }
+    for( int i=0; i<workers.size(); i++ ) {
+        SoftRasterThread *thread = workers.getElementDirect( i );
+        thread->join();
+        delete thread;
+        }
+    workers.deleteAll();
+
+    delete [] framebuffer;
+    framebuffer = NULL;
+
+    delete [] stencilBuffer;
+    stencilBuffer = NULL;
+
+    delete [] tileBins;
+    tileBins = NULL;
+    }
+
+
+
+void setSoftwareGraphicsView( double inLeft, double inRight,
+                              double inBottom, double inTop ) {
+    viewLeft = inLeft;
+    viewTop = inTop;
+    viewScaleX = fbWidth / ( inRight - inLeft );
+    viewScaleY = fbHeight / ( inTop - inBottom );
+    }
+
+
+
+void clearSoftwareFramebuffer( float inR, float inG, float inB, float inA ) {
+    float color[4] = { inR, inG, inB, inA };
+    addClear( SOFT_CLEAR_COLOR, color );
+    }
+
+
+
+void finishSoftwareFrame() {
+    flushCommands();
+    }
+
+
+
+unsigned char *getSoftwareFramebuffer() {
+    flushCommands();
+    return framebuffer;
+    }
+
+
+
+RawRGBAImage *getSoftwareFramebufferImage() {
+    flushCommands();
+
+    int numBytes = fbWidth * fbHeight * 4;
+
+    unsigned char *bytes = new unsigned char[ numBytes ];
+    memcpy( bytes, framebuffer, numBytes );
+
+    return new RawRGBAImage( bytes, fbWidth, fbHeight, 4 );
+    }
+
+
+
+int getSoftwareFramebufferWidth() {
+    return fbWidth;
+    }
+
+
+
+int getSoftwareFramebufferHeight() {
+    return fbHeight;
+    }
+
+
+
+SoftwareGraphicsStats getSoftwareGraphicsStats() {
+    return stats;
+    }
+
+
+
+
+static void setVertex( SoftVertex *outV, double inX, double inY,
+                       float *inColor ) {
+    outV->x = inX;
+    outV->y = inY;
+    memcpy( outV->color, inColor, 4 * sizeof( float ) );
+    outV->u = 0;
+    outV->v = 0;
+    }
+
+
+
+static void addQuads( int inNumQuads, double inVertices[],
+                      float inVertexColors[] ) {
+    int state = getDrawState( NULL, SOFT_TEXTURE_MODULATE );
+
+    SoftVertex v[4];
+
+    for( int q=0; q<inNumQuads; q++ ) {
+        for( int i=0; i<4; i++ ) {
+            int vert = q * 4 + i;
+
+            float *color = drawColor;
+            if( inVertexColors != NULL ) {
+                color = &( inVertexColors[ vert * 4 ] );
+                }
+            setVertex( &( v[i] ), inVertices[ vert * 2 ],
+                       inVertices[ vert * 2 + 1 ], color );
+            }
+
+        // split like GL_QUADS
+        addTriangle( state, &( v[0] ), &( v[1] ), &( v[2] ) );
+        addTriangle( state, &( v[0] ), &( v[2] ), &( v[3] ) );
+        }
+    }
+
+
+
+void drawQuads( int inNumQuads, double inVertices[] ) {
+    addQuads( inNumQuads, inVertices, NULL );
+    }
+
+
+
+void drawQuads( int inNumQuads, double inVertices[],
+                float inVertexColors[] ) {
+    addQuads( inNumQuads, inVertices, inVertexColors );
+    }
+
+
+
+static void addTriangles( int inNumTriangles, double inVertices[],
+                          float inVertexColors[],
+                          char inStrip, char inFan ) {
+    int state = getDrawState( NULL, SOFT_TEXTURE_MODULATE );
+
+    SoftVertex v[3];
+
+    for( int t=0; t<inNumTriangles; t++ ) {
+        int verts[3];
+
+        if( inStrip ) {
+            verts[0] = t;
+            verts[1] = t + 1;
+            verts[2] = t + 2;
+            }
+        else if( inFan ) {
+            verts[0] = 0;
+            verts[1] = t + 1;
+            verts[2] = t + 2;
+            }
+        else {
+            verts[0] = t * 3;
+            verts[1] = t * 3 + 1;
+            verts[2] = t * 3 + 2;
+            }
+
+        for( int i=0; i<3; i++ ) {
+            float *color = drawColor;
+            if( inVertexColors != NULL ) {
+                color = &( inVertexColors[ verts[i] * 4 ] );
+                }
+            setVertex( &( v[i] ), inVertices[ verts[i] * 2 ],
+                       inVertices[ verts[i] * 2 + 1 ], color );
+            }
+
+        addTriangle( state, &( v[0] ), &( v[1] ), &( v[2] ) );
+        }
+    }
+
+
+
+void drawTriangles( int inNumTriangles, double inVertices[],
+                    char inStrip, char inFan ) {
+    addTriangles( inNumTriangles, inVertices, NULL, inStrip, inFan );
+    }
+
+
+
+void drawTrianglesColor( int inNumTriangles, double inVertices[],
+                         float inVertexColors[], char inStrip, char inFan ) {
+    addTriangles( inNumTriangles, inVertices, inVertexColors,
+                  inStrip, inFan );
+    }
+
+
+
+void enableScissor( double inX, double inY, double inWidth, double inHeight ) {
+    // rounded to whole pixels like the GL backend, in window coordinates
+    // with y up
+    double startX = ( inX - viewLeft ) * viewScaleX;
+    double startY = fbHeight - ( viewTop - inY ) * viewScaleY;
+    double endX = startX + inWidth * viewScaleX;
+    double endY = startY + inHeight * viewScaleY;
+
+    int x = lrint( startX );
+    int y = lrint( startY );
+    int w = lrint( endX - startX );
+    int h = lrint( endY - startY );
+
+    if( w < 0 ) {
+        w = 0;
+        }
+    if( h < 0 ) {
+        h = 0;
+        }
+
+    scissorRect[0] = x;
+    scissorRect[1] = fbHeight - ( y + h );
+    scissorRect[2] = x + w;
+    scissorRect[3] = fbHeight - y;
+
+    scissorOn = true;
+    }
+
+
+
+void disableScissor() {
+    scissorOn = false;
+    }
+
+
+
+void startAddingToStencil( char inDrawColorToo, char inAdd,
+                           float inMinAlpha ) {
+    colorWriteOn = inDrawColorToo;
+
+    // skip fully-transparent areas when not drawing color
+    alphaTestOn = ! inDrawColorToo;
+    alphaTestMin = inMinAlpha;
+
+    stencilMode = SOFT_STENCIL_WRITE;
+
+    if( inAdd ) {
+        stencilValue = 1;
+        }
+    else {
+        stencilValue = 0;
+        }
+    }
+
+
+
+void startDrawingThroughStencil( char inInvertStencil ) {
+    colorWriteOn = true;
+    alphaTestOn = false;
+
+    stencilMode = SOFT_STENCIL_TEST;
+
+    if( inInvertStencil ) {
+        stencilValue = 0;
+        }
+    else {
+        stencilValue = 1;
+        }
+    }
+
+
+
+void stopStencil() {
+    disableStencil();
+
+    addClear( SOFT_CLEAR_STENCIL, NULL );
+    }
+
+
+
+void disableStencil() {
+    colorWriteOn = true;
+    alphaTestOn = false;
+
+    stencilMode = SOFT_STENCIL_OFF;
+    }
+
+
+
+
+int totalLoadedTextureBytes = 0;
+
+
+
+// same as SpriteGL::findColoredRadii
+static void findColoredRadii( SoftSprite *inSprite ) {
+    int w = inSprite->width;
+    int h = inSprite->height;
+
+    int minX = w;
+    int maxX = 0;
+    int minY = h;
+    int maxY = 0;
+
+    for( int y=0; y<h; y++ ) {
+        for( int x=0; x<w; x++ ) {
+            if( inSprite->rgba[ ( y * w + x ) * 4 + 3 ] > 0 ) {
+                if( x < minX ) {
+                    minX = x;
+                    }
+                if( x > maxX ) {
+                    maxX = x;
+                    }
+                if( y < minY ) {
+                    minY = y;
+                    }
+                if( y > maxY ) {
+                    maxY = y;
+                    }
+                }
+            }
+        }
+
+    if( minX > 0 ) {
+        inSprite->coloredRadiusLeftX = 0.5 - minX / (double)w;
+        }
+    if( maxX < w - 1 ) {
+        inSprite->coloredRadiusRightX = ( maxX + 1 ) / (double)w - 0.5;
+        }
+
+    if( minY > 0 ) {
+        inSprite->coloredRadiusTopY = 0.5 - minY / (double)h;
+        }
+    if( maxY < h - 1 ) {
+        inSprite->coloredRadiusBottomY = ( maxY + 1 ) / (double)h - 0.5;
+        }
+    }
+
+
+
+// same as SingleTextureGL's edge expansion:  hard edges of the
+// non-transparent area are copied one pixel outward, so filtering doesn't
+// fade them into the transparent border
+static void expandEdges( unsigned char *inBytes, int inWidth, int inHeight ) {
+    int maxY = 0;
+    int minY = inHeight - 1;
+    int maxX = 0;
+    int minX = inWidth - 1;
+
+    int aIndex = 3;
+    for( int y=0; y<inHeight; y++ ) {
+        for( int x=0; x<inWidth; x++ ) {
+            if( inBytes[ aIndex ] > 0 ) {
+                if( x > maxX ) {
+                    maxX = x;
+                    }
+                if( x < minX ) {
+                    minX = x;
+                    }
+                if( y > maxY ) {
+                    maxY = y;
+                    }
+                if( y < minY ) {
+                    minY = y;
+                    }
+                }
+            aIndex += 4;
+            }
+        }
+
+    if( ! ( minY < maxY && minX < maxX &&
+            minY > 0 && maxY < inHeight - 1 &&
+            minX > 0 && maxX < inWidth - 1 ) ) {
+        return;
+        }
+
+    int rowBytes = inWidth * 4;
+
+    // rows only if they have some fully-opaque pixels, so soft edges
+    // of feathered sprites and fonts aren't expanded
+    int edgeRows[2] = { minY, maxY };
+    int destRows[2] = { minY - 1, maxY + 1 };
+
+    for( int r=0; r<2; r++ ) {
+        int rowStart = edgeRows[r] * rowBytes;
+
+        for( int i=rowStart + 3; i<rowStart + rowBytes; i+=4 ) {
+            if( inBytes[i] == 255 ) {
+                memcpy( &( inBytes[ destRows[r] * rowBytes ] ),
+                        &( inBytes[ rowStart ] ), rowBytes );
+                break;
+                }
+            }
+        }
+
+    int edgeColumns[2] = { minX, maxX };
+    int destOffsets[2] = { -4, 4 };
+
+    for( int c=0; c<2; c++ ) {
+        char solidPresent = false;
+
+        for( int y=minY; y<=maxY; y++ ) {
+            if( inBytes[ ( y * inWidth + edgeColumns[c] ) * 4 + 3 ] == 255 ) {
+                solidPresent = true;
+                break;
+                }
+            }
+
+        if( solidPresent ) {
+            for( int y=minY; y<=maxY; y++ ) {
+                int i = ( y * inWidth + edgeColumns[c] ) * 4;
+                memcpy( &( inBytes[ i + destOffsets[c] ] ),
+                        &( inBytes[ i ] ), 4 );
+                }
+            }
+        }
+    }
+
+
+
+// takes ownership of inRGBA
+// inColoredRadii, if not NULL, are used in place of finding them
+static SpriteHandle newSprite( unsigned char *inRGBA,
+                               int inWidth, int inHeight,
+                               char inAlphaOnly,
+                               double *inColoredRadii = NULL ) {
+    SoftSprite *s = new SoftSprite;
+
+    s->rgba = inRGBA;
+    s->width = inWidth;
+    s->height = inHeight;
+    s->alphaOnly = inAlphaOnly;
+
+    s->coloredRadiusLeftX = 0.5;
+    s->coloredRadiusRightX = 0.5;
+    s->coloredRadiusTopY = 0.5;
+    s->coloredRadiusBottomY = 0.5;
+
+    if( transparentCroppingOn ) {
+        if( inColoredRadii != NULL ) {
+            s->coloredRadiusLeftX = inColoredRadii[0];
+            s->coloredRadiusRightX = inColoredRadii[1];
+            s->coloredRadiusTopY = inColoredRadii[2];
+            s->coloredRadiusBottomY = inColoredRadii[3];
+            }
+        else {
+            findColoredRadii( s );
+            }
+        }
+    if( ! inAlphaOnly ) {
+        expandEdges( inRGBA, inWidth, inHeight );
+        }
+
+    s->centerOffset.x = 0;
+    s->centerOffset.y = 0;
+    s->wrapH = false;
+    s->wrapV = false;
+
+    stats.liveSprites++;
+
+    return s;
+    }
+
+
+
+SpriteHandle fillSprite( Image *inImage,
+                         char inTransparentLowerLeftCorner ) {
+    totalLoadedTextureBytes += inImage->getWidth() * inImage->getHeight() * 4;
+
+    Image *spriteImage = inImage;
+    Image *imageToDelete = NULL;
+
+    if( inTransparentLowerLeftCorner ) {
+        // as in SpriteGL, unless the image already has some transparency
+        char generateAlpha = true;
+
+        if( spriteImage->getNumChannels() >= 4 ) {
+            int numPixels =
+                spriteImage->getWidth() * spriteImage->getHeight();
+
+            double *alpha = spriteImage->getChannel( 3 );
+
+            for( int i=0; i<numPixels; i++ ) {
+                if( alpha[i] != 1.0 ) {
+                    generateAlpha = false;
+                    break;
+                    }
+                }
+            }
+
+        if( generateAlpha ) {
+            spriteImage = spriteImage->generateAlphaChannel();
+            imageToDelete = spriteImage;
+            }
+        }
+
+    SpriteHandle s = newSprite( RGBAImage::getRGBABytes( spriteImage ),
+                                spriteImage->getWidth(),
+                                spriteImage->getHeight(), false );
+
+    if( imageToDelete != NULL ) {
+        delete imageToDelete;
+        }
+
+    return s;
+    }
+
+
+
+SpriteHandle fillSprite( unsigned char *inRGBA,
+                         unsigned int inWidth, unsigned int inHeight ) {
+    totalLoadedTextureBytes += inWidth * inHeight * 4;
+
+    int numBytes = inWidth * inHeight * 4;
+
+    unsigned char *bytes = new unsigned char[ numBytes ];
+    memcpy( bytes, inRGBA, numBytes );
+
+    return newSprite( bytes, inWidth, inHeight, false );
+    }
+
+
+
+SpriteHandle fillSprite( unsigned char *inRGBA,
+                         unsigned int inWidth, unsigned int inHeight,
+                         double inColoredRadii[4] ) {
+    totalLoadedTextureBytes += inWidth * inHeight * 4;
+
+    int numBytes = inWidth * inHeight * 4;
+
+    unsigned char *bytes = new unsigned char[ numBytes ];
+    memcpy( bytes, inRGBA, numBytes );
+
+    return newSprite( bytes, inWidth, inHeight, false, inColoredRadii );
+    }
+
+
+
+SpriteHandle fillSpriteAlphaOnly( unsigned char *inA,
+                                  unsigned int inWidth,
+                                  unsigned int inHeight ) {
+    // the GL backend doesn't count these
+    int numPixels = inWidth * inHeight;
+
+    unsigned char *bytes = new unsigned char[ numPixels * 4 ];
+    memset( bytes, 0, numPixels * 4 );
+
+    for( int i=0; i<numPixels; i++ ) {
+        bytes[ i * 4 + 3 ] = inA[i];
+        }
+
+    return newSprite( bytes, inWidth, inHeight, true );
+    }
+
+
+
+void freeSprite( SpriteHandle inSprite ) {
+    // recorded draws may still use it
+    flushCommands();
+
+    SoftSprite *s = (SoftSprite *)inSprite;
+    totalLoadedTextureBytes -= s->width * s->height * 4;
+    stats.liveSprites--;
+
+    delete [] s->rgba;
+    delete s;
+    }
+
+
+
+int getSpriteWidth( SpriteHandle inSprite ) {
+    return ( (SoftSprite *)inSprite )->width;
+    }
+
+
+
+int getSpriteHeight( SpriteHandle inSprite ) {
+    return ( (SoftSprite *)inSprite )->height;
+    }
+
+
+
+void setSpriteCenterOffset( SpriteHandle inSprite, doublePair inOffset ) {
+    ( (SoftSprite *)inSprite )->centerOffset = inOffset;
+    }
+
+
+
+void setSpriteWrapping( SpriteHandle inSprite,
+                        char inHorizontal, char inVertical ) {
+    SoftSprite *s = (SoftSprite *)inSprite;
+    s->wrapH = inHorizontal;
+    s->wrapV = inVertical;
+    }
+
+
+
+
+static char countingPixels = false;
+static double pixelsDrawn = 0;
+
+
+void startCountingSpritePixelsDrawn() {
+    countingPixels = true;
+    pixelsDrawn = 0;
+    }
+
+
+
+double endCountingSpritePixelsDrawn() {
+    countingPixels = false;
+    return pixelsDrawn;
+    }
+
+
+
+// like the GL backend, always count, and zero when asked to start counting
+static double numSpritesDrawn = 0;
+
+
+void startCountingSpritesDrawn() {
+    numSpritesDrawn = 0;
+    }
+
+
+
+double endCountingSpritesDrawn() {
+    return numSpritesDrawn;
+    }
+
+
+
+
+// corners in triangle strip order (BL, BR, TL, TR), with texture
+// coordinates covering the sprite's colored area, as in SpriteGL
+static void setSpriteTexCoords( SoftSprite *inSprite,
+                                SoftVertex outCorners[4] ) {
+    float textXA = (float)( 0.5 - inSprite->coloredRadiusLeftX );
+    float textXB = (float)( 1 - ( 0.5 - inSprite->coloredRadiusRightX ) );
+    float textYB = (float)( 0.5 - inSprite->coloredRadiusTopY );
+    float textYA = (float)( 1 - ( 0.5 - inSprite->coloredRadiusBottomY ) );
+
+    outCorners[0].u = textXA;
+    outCorners[0].v = textYA;
+    outCorners[1].u = textXB;
+    outCorners[1].v = textYA;
+    outCorners[2].u = textXA;
+    outCorners[2].v = textYB;
+    outCorners[3].u = textXB;
+    outCorners[3].v = textYB;
+    }
+
+
+
+static void setSpriteCorners( SoftSprite *inSprite, doublePair inCenter,
+                              double inZoom, double inRotation,
+                              char inFlipH, SoftVertex outCorners[4] ) {
+
+    double xLeftRadius = inZoom * inSprite->width *
+        inSprite->coloredRadiusLeftX;
+    double xRightRadius = inZoom * inSprite->width *
+        inSprite->coloredRadiusRightX;
+    double yTopRadius = inZoom * inSprite->height *
+        inSprite->coloredRadiusTopY;
+    double yBottomRadius = inZoom * inSprite->height *
+        inSprite->coloredRadiusBottomY;
+
+    doublePair centerOffset = mult( inSprite->centerOffset, inZoom );
+
+    if( countingPixels ) {
+        // pre-flip and pre-rotation
+        pixelsDrawn +=
+            ( xLeftRadius + xRightRadius ) *
+            ( yTopRadius + yBottomRadius );
+        }
+
+    if( inFlipH ) {
+        xLeftRadius = -xLeftRadius;
+        xRightRadius = -xRightRadius;
+        centerOffset.x = -centerOffset.x;
+        }
+
+    double xs[4] = { -xLeftRadius, xRightRadius, -xLeftRadius, xRightRadius };
+    double ys[4] = { -yBottomRadius, -yBottomRadius, yTopRadius, yTopRadius };
+
+    if( inRotation == 0 ) {
+        for( int i=0; i<4; i++ ) {
+            outCorners[i].x = inCenter.x - centerOffset.x + xs[i];
+            outCorners[i].y = inCenter.y + centerOffset.y + ys[i];
+            }
+        }
+    else {
+        double cosAngle = cos( - 2 * M_PI * inRotation );
+        double sinAngle = sin( - 2 * M_PI * inRotation );
+
+        for( int i=0; i<4; i++ ) {
+            double x = xs[i] - centerOffset.x;
+            double y = ys[i] + centerOffset.y;
+
+            outCorners[i].x = x * cosAngle - y * sinAngle + inCenter.x;
+            outCorners[i].y = x * sinAngle + y * cosAngle + inCenter.y;
+            }
+        }
+
+    setSpriteTexCoords( inSprite, outCorners );
+    }
+
+
+
+// corner colors in BL, BR, TR, TL order, or NULL for draw color
+static void setCornerColors( FloatColor *inCornerColors,
+                             SoftVertex outCorners[4] ) {
+    // strip order swaps the top two
+    int sourceCorner[4] = { 0, 1, 3, 2 };
+
+    for( int i=0; i<4; i++ ) {
+        if( inCornerColors == NULL ) {
+            memcpy( outCorners[i].color, drawColor, 4 * sizeof( float ) );
+            }
+        else {
+            FloatColor c = inCornerColors[ sourceCorner[i] ];
+            outCorners[i].color[0] = c.r;
+            outCorners[i].color[1] = c.g;
+            outCorners[i].color[2] = c.b;
+            outCorners[i].color[3] = c.a;
+            }
+        }
+    }
+
+
+
+static void addSprite( SoftSprite *inSprite, char inAlphaOnly,
+                       SoftVertex inCorners[4] ) {
+    SoftTextureMode mode = SOFT_TEXTURE_MODULATE;
+
+    if( inAlphaOnly || inSprite->alphaOnly ) {
+        // GL_ALPHA textures leave vertex RGB alone in both
+        // GL_MODULATE and GL_ADD
+        mode = SOFT_TEXTURE_ALPHA_ONLY;
+        }
+    else if( additiveTextureColorMode ) {
+        mode = SOFT_TEXTURE_ADD;
+        }
+
+    int state = getDrawState( inSprite, mode );
+
+    addTriangle( state, &( inCorners[0] ), &( inCorners[1] ),
+                 &( inCorners[2] ) );
+    addTriangle( state, &( inCorners[1] ), &( inCorners[2] ),
+                 &( inCorners[3] ) );
+
+    numSpritesDrawn++;
+    }
+
+
+
+void drawSprite( SpriteHandle inSprite, doublePair inCenter,
+                 double inZoom, double inRotation, char inFlipH ) {
+    SoftSprite *s = (SoftSprite *)inSprite;
+
+    SoftVertex corners[4];
+    setSpriteCorners( s, inCenter, inZoom, inRotation, inFlipH, corners );
+    setCornerColors( NULL, corners );
+
+    addSprite( s, false, corners );
+    }
+
+
+
+void drawSprite( SpriteHandle inSprite, doublePair inCenter,
+                 FloatColor inCornerColors[4],
+                 double inZoom, double inRotation, char inFlipH ) {
+    SoftSprite *s = (SoftSprite *)inSprite;
+
+    SoftVertex corners[4];
+    setSpriteCorners( s, inCenter, inZoom, inRotation, inFlipH, corners );
+    setCornerColors( inCornerColors, corners );
+
+    addSprite( s, false, corners );
+    }
+
+
+
+// corner positions in BL, BR, TR, TL order, into strip order
+static void setCornerPositions( doublePair inCornerPos[4],
+                                SoftVertex outCorners[4] ) {
+    int sourceCorner[4] = { 0, 1, 3, 2 };
+
+    for( int i=0; i<4; i++ ) {
+        outCorners[i].x = inCornerPos[ sourceCorner[i] ].x;
+        outCorners[i].y = inCornerPos[ sourceCorner[i] ].y;
+        }
+    }
+
+
+
+void drawSprite( SpriteHandle inSprite, doublePair inCornerPos[4],
+                 FloatColor inCornerColors[4] ) {
+    SoftSprite *s = (SoftSprite *)inSprite;
+
+    SoftVertex corners[4];
+    setCornerPositions( inCornerPos, corners );
+    setSpriteTexCoords( s, corners );
+    setCornerColors( inCornerColors, corners );
+
+    addSprite( s, false, corners );
+    }
+
+
+
+void drawSprite( SpriteHandle inSprite, doublePair inCornerPos[4],
+                 doublePair inTexCoords[4] ) {
+    SoftSprite *s = (SoftSprite *)inSprite;
+
+    SoftVertex corners[4];
+    setCornerPositions( inCornerPos, corners );
+    setCornerColors( NULL, corners );
+
+    int sourceCorner[4] = { 0, 1, 3, 2 };
+
+    for( int i=0; i<4; i++ ) {
+        corners[i].u = (float)inTexCoords[ sourceCorner[i] ].x;
+        corners[i].v = (float)inTexCoords[ sourceCorner[i] ].y;
+        }
+
+    addSprite( s, false, corners );
+    }
+
+
+
+void drawSpriteAlphaOnly( SpriteHandle inSprite, doublePair inCenter,
+                          double inZoom, double inRotation, char inFlipH ) {
+    SoftSprite *s = (SoftSprite *)inSprite;
+
+    SoftVertex corners[4];
+    setSpriteCorners( s, inCenter, inZoom, inRotation, inFlipH, corners );
+    setCornerColors( NULL, corners );
+
+    addSprite( s, true, corners );
+    }
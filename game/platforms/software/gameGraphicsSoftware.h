@@ -0,0 +1,100 @@
+#ifndef GAME_GRAPHICS_SOFTWARE_INCLUDED
+#define GAME_GRAPHICS_SOFTWARE_INCLUDED
+
+
+#include <stddef.h>
+
+#include "minorGems/graphics/RawRGBAImage.h"
+
+
+// The software gameGraphics backend implements gameGraphics.h on the CPU,
+// drawing into an RGBA framebuffer in memory, for rendering without a GPU
+// or a window (screenshots on render farms, thumbnails on servers, and
+// pixel-exact regression tests).
+//
+// Draw calls are recorded and binned into 64x64 screen tiles, and the
+// tiles are rasterized in parallel when the frame is read back.  Each tile
+// draws its primitives in the order they were submitted, so the output is
+// the same for any number of threads.
+//
+// Blending, texture combining, stencil, and scissor follow what the GL
+// backend asks of GL.  Textures are sampled from their base level only
+// (no mipmaps are built).
+
+
+
+typedef struct SoftwareGraphicsStats {
+        // triangles recorded, after dropping empty and off-screen ones
+        unsigned int triangles;
+
+        // triangle and clear entries across all tile bins
+        unsigned int binnedCommands;
+
+        // times recorded commands were rasterized
+        unsigned int flushes;
+
+        // sprites currently loaded
+        unsigned int liveSprites;
+    } SoftwareGraphicsStats;
+
+
+
+/**
+ * Makes the framebuffer and starts rasterizer threads.
+ *
+ * Must be called before any other gameGraphics function.
+ *
+ * @param inWidth, inHeight the framebuffer size in pixels.
+ * @param inNumThreads the number of threads that rasterize, including
+ *   the calling thread.
+ */
+void initSoftwareGraphics( int inWidth, int inHeight, int inNumThreads );
+
+
+// stops threads and frees the framebuffer
+// sprites must be freed separately
+void freeSoftwareGraphics();
+
+
+
+// maps a view-space rectangle onto the whole framebuffer, like glOrtho
+// y is up
+// defaults to 0,0 in the lower left and 1 unit per pixel
+void setSoftwareGraphicsView( double inLeft, double inRight,
+                              double inBottom, double inTop );
+
+
+// fills the framebuffer (or the scissor rectangle, if enabled) with a color
+void clearSoftwareFramebuffer( float inR, float inG, float inB, float inA );
+
+
+
+// rasterizes everything drawn so far
+void finishSoftwareFrame();
+
+
+/**
+ * Gets the framebuffer contents, after finishing the frame.
+ *
+ * @return width * height RGBA bytes, top row first.  Owned by the
+ *   backend, and valid until the next drawing call.
+ */
+unsigned char *getSoftwareFramebuffer();
+
+
+// same, but copied into a new image that is destroyed by caller
+RawRGBAImage *getSoftwareFramebufferImage();
+
+
+int getSoftwareFramebufferWidth();
+
+int getSoftwareFramebufferHeight();
+
+
+
+// totals since initSoftwareGraphics
+SoftwareGraphicsStats getSoftwareGraphicsStats();
+
+
+
+#endif
@@ -0,0 +1,430 @@
+// Test and benchmark for the software gameGraphics backend
+//
+// Usage:  softwareRasterBench [width] [height] [threads] [frames]
+//
+// First draws small scenes and checks exact pixels (shared triangle edges,
+// blend modes, scissor, stencil, sprite texels and orientation).  Then
+// draws a busy scene of rotated, tinted, filtered sprites, quads, and
+// triangle fans with one thread and with several, checks that the
+// framebuffers are identical, and times both.
+//
+// Writes the busy scene to softwareRasterBench.tga.
+
+
+#include "gameGraphicsSoftware.h"
+
+#include "minorGems/game/gameGraphics.h"
+#include "minorGems/graphics/converters/TGAImageConverter.h"
+#include "minorGems/io/file/FileOutputStream.h"
+#include "minorGems/system/Time.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+
+static int numFailed = 0;
+
+
+static void check( char inPassed, const char *inWhat ) {
+    if( ! inPassed ) {
+        printf( "FAILED:  %s\n", inWhat );
+        numFailed++;
+        }
+    }
+
+
+
+// pixel at x, y with y up from the bottom, like view space
+static unsigned char *pixelAt( int inX, int inY ) {
+    unsigned char *bytes = getSoftwareFramebuffer();
+    int w = getSoftwareFramebufferWidth();
+    int h = getSoftwareFramebufferHeight();
+
+    return &( bytes[ ( ( h - 1 - inY ) * w + inX ) * 4 ] );
+    }
+
+
+static char pixelIs( int inX, int inY, int inR, int inG, int inB ) {
+    unsigned char *p = pixelAt( inX, inY );
+    return p[0] == inR && p[1] == inG && p[2] == inB;
+    }
+
+
+
+static void drawRect( double inX0, double inY0, double inX1, double inY1 ) {
+    double v[8] = { inX0, inY0, inX1, inY0, inX1, inY1, inX0, inY1 };
+    drawQuads( 1, v );
+    }
+
+
+
+static void runPixelChecks() {
+    initSoftwareGraphics( 64, 64, 1 );
+
+    // 1 unit per pixel, 0,0 in lower left
+    clearSoftwareFramebuffer( 0, 0, 0, 1 );
+
+
+    // half-transparent white over black, split into two triangles
+    // each pixel gets exactly one blend, even along the diagonal
+    setDrawColor( 1, 1, 1, 0.5f );
+    drawRect( 0, 0, 32, 32 );
+
+    char uniform = true;
+    for( int y=0; y<32; y++ ) {
+        for( int x=0; x<32; x++ ) {
+            if( ! pixelIs( x, y, 128, 128, 128 ) ) {
+                uniform = false;
+                }
+            }
+        }
+    check( uniform, "half-alpha quad blended once per pixel" );
+    check( pixelIs( 32, 0, 0, 0, 0 ) && pixelIs( 0, 32, 0, 0, 0 ),
+           "quad doesn't spill past its right and top edges" );
+
+
+    // additive red onto green, multiplicative gray onto that
+    clearSoftwareFramebuffer( 0, 1, 0, 1 );
+    toggleAdditiveBlend( true );
+    setDrawColor( 1, 0, 0, 1 );
+    drawRect( 0, 0, 64, 64 );
+    toggleAdditiveBlend( false );
+    check( pixelIs( 10, 10, 255, 255, 0 ), "additive blend" );
+
+    toggleMultiplicativeBlend( true );
+    setDrawColor( 0.5f, 0.5f, 0.5f, 1 );
+    drawRect( 0, 0, 32, 64 );
+    toggleMultiplicativeBlend( false );
+    check( pixelIs( 10, 10, 128, 128, 0 ) && pixelIs( 40, 10, 255, 255, 0 ),
+           "multiplicative blend" );
+
+
+    // scissor to the left half, in view space
+    clearSoftwareFramebuffer( 0, 0, 0, 1 );
+    enableScissor( 0, 0, 32, 64 );
+    setDrawColor( 0, 1, 0, 1 );
+    drawRect( 0, 0, 64, 64 );
+    disableScissor();
+    check( pixelIs( 31, 5, 0, 255, 0 ) && pixelIs( 32, 5, 0, 0, 0 ),
+           "scissor" );
+
+
+    // stencil a square in the middle, draw blue through it, then red
+    // through the inverse
+    clearSoftwareFramebuffer( 0, 0, 0, 1 );
+    startAddingToStencil( false, true );
+    setDrawColor( 1, 1, 1, 1 );
+    drawRect( 16, 16, 48, 48 );
+    startDrawingThroughStencil();
+    setDrawColor( 0, 0, 1, 1 );
+    drawRect( 0, 0, 64, 64 );
+    startDrawingThroughStencil( true );
+    setDrawColor( 1, 0, 0, 1 );
+    drawRect( 0, 0, 64, 64 );
+    stopStencil();
+    check( pixelIs( 32, 32, 0, 0, 255 ) && pixelIs( 5, 5, 255, 0, 0 ),
+           "stencil" );
+
+    // cleared by stopStencil, so all of it draws now
+    startDrawingThroughStencil( true );
+    setDrawColor( 0, 1, 0, 1 );
+    drawRect( 0, 0, 64, 64 );
+    disableStencil();
+    check( pixelIs( 32, 32, 0, 255, 0 ), "stencil cleared" );
+
+
+    // 2x2 sprite, red and green on top row, blue and white on bottom,
+    // drawn 16x bigger
+    unsigned char texels[16] = { 255, 0, 0, 255,    0, 255, 0, 255,
+                                 0, 0, 255, 255,    255, 255, 255, 255 };
+    SpriteHandle sprite = fillSprite( texels, 2, 2 );
+
+    clearSoftwareFramebuffer( 0, 0, 0, 1 );
+    setDrawColor( 1, 1, 1, 1 );
+    doublePair center = { 32, 32 };
+    drawSprite( sprite, center, 16 );
+    check( pixelIs( 20, 40, 255, 0, 0 ) && pixelIs( 40, 40, 0, 255, 0 ) &&
+           pixelIs( 20, 20, 0, 0, 255 ) && pixelIs( 40, 20, 255, 255, 255 ),
+           "sprite texels, top row at top" );
+    check( pixelIs( 15, 40, 0, 0, 0 ) && pixelIs( 16, 40, 255, 0, 0 ) &&
+           pixelIs( 47, 40, 0, 255, 0 ) && pixelIs( 48, 40, 0, 0, 0 ) &&
+           pixelIs( 20, 15, 0, 0, 0 ) && pixelIs( 20, 16, 0, 0, 255 ) &&
+           pixelIs( 20, 47, 255, 0, 0 ) && pixelIs( 20, 48, 0, 0, 0 ),
+           "sprite edges" );
+
+    // flipped and tinted
+    clearSoftwareFramebuffer( 0, 0, 0, 1 );
+    setDrawColor( 0.5f, 0.5f, 0.5f, 1 );
+    drawSprite( sprite, center, 16, 0, true );
+    check( pixelIs( 20, 40, 0, 128, 0 ) && pixelIs( 40, 40, 128, 0, 0 ),
+           "flipped, tinted sprite" );
+
+    // quarter turn clockwise puts the top-left texel top-right
+    clearSoftwareFramebuffer( 0, 0, 0, 1 );
+    setDrawColor( 1, 1, 1, 1 );
+    drawSprite( sprite, center, 16, 0.25 );
+    check( pixelIs( 40, 40, 255, 0, 0 ) && pixelIs( 40, 20, 0, 255, 0 ),
+           "rotated sprite" );
+
+    // alpha-only sprites take color from the draw color
+    unsigned char alpha[4] = { 255, 0, 0, 255 };
+    SpriteHandle shadow = fillSpriteAlphaOnly( alpha, 2, 2 );
+
+    clearSoftwareFramebuffer( 1, 1, 1, 1 );
+    setDrawColor( 0, 0, 1, 1 );
+    drawSprite( shadow, center, 16 );
+    check( pixelIs( 20, 40, 0, 0, 255 ) && pixelIs( 40, 40, 255, 255, 255 ),
+           "alpha-only sprite" );
+
+    freeSprite( shadow );
+    freeSprite( sprite );
+
+    freeSoftwareGraphics();
+    }
+
+
+
+static SimpleVector<SpriteHandle> sceneSprites;
+
+
+static void makeSceneSprites() {
+    for( int s=0; s<8; s++ ) {
+        int size = 16 << ( s % 4 );
+
+        unsigned char *texels = new unsigned char[ size * size * 4 ];
+
+        int i = 0;
+        for( int y=0; y<size; y++ ) {
+            for( int x=0; x<size; x++ ) {
+                int dx = 2 * x - size;
+                int dy = 2 * y - size;
+
+                // soft-edged disc with rings
+                int d = dx * dx + dy * dy;
+                int edge = size * size;
+
+                texels[i++] = (unsigned char)( x * 255 / size );
+                texels[i++] = (unsigned char)( y * 255 / size );
+                texels[i++] = (unsigned char)( ( d >> s ) & 0xFF );
+
+                if( d < edge * 3 / 4 ) {
+                    texels[i++] = 255;
+                    }
+                else if( d < edge ) {
+                    texels[i++] = 128;
+                    }
+                else {
+                    texels[i++] = 0;
+                    }
+                }
+            }
+
+        sceneSprites.push_back( fillSprite( texels, size, size ) );
+        delete [] texels;
+        }
+    }
+
+
+
+// a busy frame, the same each time for the same frame number
+static void drawScene( int inFrame, int inWidth, int inHeight ) {
+    unsigned int seed = 12345;
+
+    clearSoftwareFramebuffer( 0.1f, 0.1f, 0.2f, 1 );
+
+    // background gradient quads
+    for( int q=0; q<16; q++ ) {
+        double y0 = q * inHeight / 16.0;
+        double y1 = ( q + 1 ) * inHeight / 16.0;
+        double v[8] = { 0, y0, (double)inWidth, y0,
+                        (double)inWidth, y1, 0, y1 };
+        float c[16];
+        for( int i=0; i<16; i++ ) {
+            c[i] = ( ( i * 7 + q * 3 ) % 16 ) / 16.0f;
+            }
+        c[3] = c[7] = c[11] = c[15] = 0.5f;
+        drawQuads( 1, v, c );
+        }
+
+    for( int i=0; i<600; i++ ) {
+        seed = seed * 1103515245 + 12345;
+        int r = ( seed >> 8 );
+
+        SpriteHandle s =
+            sceneSprites.getElementDirect( r % sceneSprites.size() );
+
+        doublePair pos = { (double)( ( r >> 3 ) % inWidth ),
+                           (double)( ( r >> 11 ) % inHeight ) };
+        pos.x += ( inFrame * ( i % 5 ) ) % 40;
+
+        double zoom = 0.5 + ( r % 4 ) * 0.25;
+        double rotation = ( i % 3 == 0 ) ? ( ( r % 100 ) / 100.0 ) : 0;
+
+        toggleLinearMagFilter( i % 2 == 0 );
+        toggleAdditiveBlend( i % 11 == 0 );
+        toggleAdditiveTextureColoring( i % 13 == 0 );
+
+        if( i % 4 == 0 ) {
+            FloatColor corners[4] = { { 1, 0, 0, 1 }, { 0, 1, 0, 1 },
+                                      { 0, 0, 1, 0.5f },
+                                      { 1, 1, 1, 0.8f } };
+            drawSprite( s, pos, corners, zoom, rotation, i % 2 );
+            }
+        else {
+            setDrawColor( ( r % 10 ) / 10.0f, 1, 1, 0.9f );
+            drawSprite( s, pos, zoom, rotation, i % 2 );
+            }
+        }
+    toggleLinearMagFilter( false );
+    toggleAdditiveBlend( false );
+    toggleAdditiveTextureColoring( false );
+
+    // a stenciled window with a triangle fan through it
+    startAddingToStencil( false, true, 0.5f );
+    doublePair center = { inWidth / 2.0, inHeight / 2.0 };
+    drawSprite( sceneSprites.getElementDirect( 3 ), center, 2 );
+    startDrawingThroughStencil();
+
+    double fan[ 2 * 34 ];
+    fan[0] = center.x;
+    fan[1] = center.y;
+    for( int i=0; i<33; i++ ) {
+        double a = i * 2 * M_PI / 32 + inFrame * 0.01;
+        fan[ 2 + i * 2 ] = center.x + cos( a ) * 200;
+        fan[ 3 + i * 2 ] = center.y + sin( a ) * 200;
+        }
+    setDrawColor( 1, 0.5f, 0, 0.7f );
+    drawTriangles( 32, fan, false, true );
+    stopStencil();
+
+    toggleMultiplicativeBlend( true );
+    setDrawColor( 0.8f, 0.9f, 1, 1 );
+    drawRect( 0, 0, inWidth / 3.0, inHeight );
+    toggleMultiplicativeBlend( false );
+    }
+
+
+
+static unsigned int hashFramebuffer() {
+    unsigned char *bytes = getSoftwareFramebuffer();
+    int numBytes =
+        getSoftwareFramebufferWidth() * getSoftwareFramebufferHeight() * 4;
+
+    // FNV-1a
+    unsigned int hash = 2166136261U;
+    for( int i=0; i<numBytes; i++ ) {
+        hash ^= bytes[i];
+        hash *= 16777619U;
+        }
+    return hash;
+    }
+
+
+
+// renders frames, returns seconds, sets hash of last frame
+static double renderFrames( int inWidth, int inHeight, int inThreads,
+                            int inFrames, unsigned int *outHash,
+                            SoftwareGraphicsStats *outStats ) {
+    initSoftwareGraphics( inWidth, inHeight, inThreads );
+
+    double start = Time::getCurrentTime();
+
+    for( int f=0; f<inFrames; f++ ) {
+        drawScene( f, inWidth, inHeight );
+        finishSoftwareFrame();
+        }
+
+    double seconds = Time::getCurrentTime() - start;
+
+    *outHash = hashFramebuffer();
+    *outStats = getSoftwareGraphicsStats();
+
+    return seconds;
+    }
+
+
+
+int main( int inNumArgs, char **inArgs ) {
+    int width = 1280;
+    int height = 720;
+    int threads = 4;
+    int frames = 30;
+
+    if( inNumArgs > 2 ) {
+        width = atoi( inArgs[1] );
+        height = atoi( inArgs[2] );
+        }
+    if( inNumArgs > 3 ) {
+        threads = atoi( inArgs[3] );
+        }
+    if( inNumArgs > 4 ) {
+        frames = atoi( inArgs[4] );
+        }
+
+    if( width < 64 || height < 64 || threads < 1 || frames < 1 ) {
+        printf( "Usage:  softwareRasterBench [width] [height] [threads] "
+                "[frames]\n" );
+        return 1;
+        }
+
+
+    runPixelChecks();
+
+    if( numFailed == 0 ) {
+        printf( "Pixel checks passed\n\n" );
+        }
+
+
+    makeSceneSprites();
+
+    unsigned int hashOne, hashMany;
+    SoftwareGraphicsStats statsOne, statsMany;
+
+    double secondsOne = renderFrames( width, height, 1, frames,
+                                      &hashOne, &statsOne );
+    freeSoftwareGraphics();
+
+    double secondsMany = renderFrames( width, height, threads, frames,
+                                       &hashMany, &statsMany );
+
+    RawRGBAImage *image = getSoftwareFramebufferImage();
+
+    File tgaFile( NULL, "softwareRasterBench.tga" );
+    FileOutputStream tgaStream( &tgaFile );
+    TGAImageConverter converter;
+    converter.formatBytes( image->mRGBABytes, width, height, 4, false,
+                           &tgaStream );
+    delete image;
+
+    freeSoftwareGraphics();
+
+    check( hashOne == hashMany,
+           "same framebuffer with one thread and many" );
+
+    unsigned int trisPerFrame = statsOne.triangles / frames;
+
+    printf( "%d frames of %dx%d, %u triangles and %u tile bin entries "
+            "per frame\n\n", frames, width, height, trisPerFrame,
+            statsOne.binnedCommands / frames );
+
+    printf( "%-12s %10s %10s %12s %10s\n",
+            "threads", "sec", "fps", "ms/frame", "hash" );
+    printf( "%-12d %10.3f %10.1f %12.2f %10x\n", 1, secondsOne,
+            frames / secondsOne, 1000 * secondsOne / frames, hashOne );
+    printf( "%-12d %10.3f %10.1f %12.2f %10x\n", threads, secondsMany,
+            frames / secondsMany, 1000 * secondsMany / frames, hashMany );
+
+    for( int i=0; i<sceneSprites.size(); i++ ) {
+        freeSprite( sceneSprites.getElementDirect( i ) );
+        }
+
+    if( numFailed > 0 ) {
+        printf( "\n%d checks FAILED\n", numFailed );
+        return 1;
+        }
+
+    printf( "\nAll checks passed\n" );
+    return 0;
+    }
@@ -0,0 +1,520 @@
+// Test and benchmark for SpriteDecodeBatch
+//
+// Usage:  spriteDecodeBench [threads] [files] [size]
+//
+// Writes random sprite images, with and without alpha channels, and checks
+// that decoding them from bytes gives the same RGBA and colored radii that
+// loadSprite's path through Image and SpriteGL gives, with and without
+// transparency from the lower-left corner.
+//
+// Then checks that a batch hands back every file exactly once with the
+// same bytes, that missing files come back empty, and that deleting a
+// batch part way through doesn't hang, and times loadSprite's decode path
+// against a batch on one thread and on several.
+//
+// Leaves spriteDecodeBenchFiles/ behind.
+
+
+#include "SpriteDecodeBatch.h"
+
+#include "minorGems/graphics/converters/TGAImageConverter.h"
+#include "minorGems/graphics/RGBAImage.h"
+#include "minorGems/io/file/File.h"
+#include "minorGems/io/file/FileInputStream.h"
+#include "minorGems/io/file/FileOutputStream.h"
+#include "minorGems/system/Time.h"
+#include "minorGems/util/stringUtils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+
+static int numFailed = 0;
+
+
+static void check( char inPassed, const char *inWhat ) {
+    if( ! inPassed ) {
+        printf( "FAILED:  %s\n", inWhat );
+        numFailed++;
+        }
+    }
+
+
+
+static unsigned int randState = 12345;
+
+static int randInt( int inMin, int inMax ) {
+    randState = randState * 1103515245 + 12345;
+    return inMin + (int)( ( randState >> 8 ) % ( inMax - inMin + 1 ) );
+    }
+
+
+
+static const char *folderName = "spriteDecodeBenchFiles";
+
+
+
+// kinds of test images
+enum SpriteKind {
+    // 3 channels, background color in lower-left corner
+    noAlpha = 0,
+    // 4 channels, all solid, background color in lower-left corner
+    solidAlpha,
+    // 4 channels, real transparency around a blob
+    realAlpha,
+    numKinds
+    };
+
+
+
+static Image *makeImage( int inSize, int inKind ) {
+    Image *image = new Image( inSize, inSize,
+                              ( inKind == noAlpha ) ? 3 : 4, true );
+
+    double back[3];
+    for( int c=0; c<3; c++ ) {
+        back[c] = randInt( 0, 255 ) / 255.0;
+        }
+
+    // blob somewhere inside, not touching edges so radii are found
+    int cx = randInt( inSize / 4, 3 * inSize / 4 );
+    int cy = randInt( inSize / 4, 3 * inSize / 4 );
+    int r = randInt( 2, inSize / 4 - 1 );
+
+    for( int y=0; y<inSize; y++ ) {
+        for( int x=0; x<inSize; x++ ) {
+            int i = y * inSize + x;
+
+            int dx = x - cx;
+            int dy = y - cy;
+
+            char inBlob = ( dx * dx + dy * dy <= r * r );
+
+            for( int c=0; c<3; c++ ) {
+                if( inBlob ) {
+                    // never quite the background color
+                    int v = randInt( 0, 254 );
+                    if( v >= (int)( back[c] * 255 + 0.5 ) ) {
+                        v++;
+                        }
+                    image->getChannel( c )[i] = v / 255.0;
+                    }
+                else {
+                    image->getChannel( c )[i] = back[c];
+                    }
+                }
+
+            if( inKind == solidAlpha ) {
+                image->getChannel( 3 )[i] = 1.0;
+                }
+            else if( inKind == realAlpha ) {
+                image->getChannel( 3 )[i] =
+                    inBlob ? randInt( 1, 255 ) / 255.0 : 0;
+                }
+            }
+        }
+
+    return image;
+    }
+
+
+
+static char *getPath( const char *inFileName ) {
+    return autoSprintf( "%s/%s", folderName, inFileName );
+    }
+
+
+
+static RawRGBAImage *readRaw( const char *inFileName ) {
+    char *path = getPath( inFileName );
+    File file( NULL, path );
+    delete [] path;
+
+    if( ! file.exists() ) {
+        return NULL;
+        }
+
+    FileInputStream stream( &file );
+
+    TGAImageConverter converter;
+
+    return converter.deformatImageRaw( &stream );
+    }
+
+
+
+// loadSprite's path, through doubles, ending where SpriteGL uploads
+// returns NULL where loadSprite fails
+static unsigned char *decodeAsLoadSprite( const char *inFileName,
+                                          char inTransparentLowerLeftCorner,
+                                          int *outWidth, int *outHeight,
+                                          double outRadii[4] ) {
+    for( int i=0; i<4; i++ ) {
+        outRadii[i] = 0.5;
+        }
+
+    if( ! inTransparentLowerLeftCorner ) {
+        RawRGBAImage *raw = readRaw( inFileName );
+
+        if( raw == NULL ) {
+            return NULL;
+            }
+        if( raw->mNumChannels != 4 ) {
+            delete raw;
+            return NULL;
+            }
+
+        *outWidth = raw->mWidth;
+        *outHeight = raw->mHeight;
+
+        int numBytes = raw->mWidth * raw->mHeight * 4;
+        unsigned char *rgba = new unsigned char[ numBytes ];
+        memcpy( rgba, raw->mRGBABytes, numBytes );
+        delete raw;
+
+        SpriteDecodeBatch::findColoredRadii( rgba, *outWidth, *outHeight,
+                                             outRadii );
+        return rgba;
+        }
+
+    char *path = getPath( inFileName );
+    File file( NULL, path );
+    delete [] path;
+
+    if( ! file.exists() ) {
+        return NULL;
+        }
+
+    FileInputStream stream( &file );
+    TGAImageConverter converter;
+    Image *image = converter.deformatImage( &stream );
+
+    if( image == NULL ) {
+        return NULL;
+        }
+
+    int w = image->getWidth();
+    int h = image->getHeight();
+    int numPixels = w * h;
+
+    // as in SpriteGL::initTexture
+    char generateAlpha = true;
+
+    if( image->getNumChannels() >= 4 ) {
+        double *alpha = image->getChannel( 3 );
+        for( int i=0; i<numPixels; i++ ) {
+            if( alpha[i] != 1.0 ) {
+                generateAlpha = false;
+                break;
+                }
+            }
+        }
+
+    if( generateAlpha ) {
+        Image *alphaImage = image->generateAlphaChannel();
+        delete image;
+        image = alphaImage;
+        }
+
+    // radii from doubles, as SpriteGL finds them
+    double *alpha = image->getChannel( 3 );
+    int minX = w, maxX = 0, minY = h, maxY = 0;
+    for( int y=0; y<h; y++ ) {
+        for( int x=0; x<w; x++ ) {
+            if( alpha[ y * w + x ] > 0 ) {
+                if( x < minX ) {
+                    minX = x;
+                    }
+                if( x > maxX ) {
+                    maxX = x;
+                    }
+                if( y < minY ) {
+                    minY = y;
+                    }
+                if( y > maxY ) {
+                    maxY = y;
+                    }
+                }
+            }
+        }
+    if( minX > 0 ) {
+        outRadii[0] = 0.5 - minX / (double)w;
+        }
+    if( maxX < w - 1 ) {
+        outRadii[1] = ( maxX + 1 ) / (double)w - 0.5;
+        }
+    if( minY > 0 ) {
+        outRadii[2] = 0.5 - minY / (double)h;
+        }
+    if( maxY < h - 1 ) {
+        outRadii[3] = ( maxY + 1 ) / (double)h - 0.5;
+        }
+
+    unsigned char *rgba = RGBAImage::getRGBABytes( image );
+    delete image;
+
+    *outWidth = w;
+    *outHeight = h;
+
+    return rgba;
+    }
+
+
+
+static char sameAsReference( DecodedSprite *inSprite,
+                             const char *inFileName,
+                             char inTransparentLowerLeftCorner ) {
+    int w = 0;
+    int h = 0;
+    double radii[4];
+
+    unsigned char *ref = decodeAsLoadSprite( inFileName,
+                                             inTransparentLowerLeftCorner,
+                                             &w, &h, radii );
+
+    if( ref == NULL || inSprite->rgba == NULL ) {
+        char same = ( ref == inSprite->rgba );
+        if( ref != NULL ) {
+            delete [] ref;
+            }
+        return same;
+        }
+
+    char same =
+        inSprite->width == w && inSprite->height == h &&
+        memcmp( ref, inSprite->rgba, w * h * 4 ) == 0 &&
+        memcmp( radii, inSprite->coloredRadii, sizeof( radii ) ) == 0;
+
+    delete [] ref;
+    return same;
+    }
+
+
+
+// decodes all files with a batch, checking each comes back once
+// returns seconds taken
+static double runBatch( int inNumFiles, const char **inNames,
+                        char inTransparentLowerLeftCorner,
+                        int inNumThreads,
+                        unsigned char **outRGBA ) {
+    char *seen = new char[ inNumFiles ];
+    memset( seen, false, inNumFiles );
+
+    double startTime = Time::getCurrentTime();
+
+    SpriteDecodeBatch batch( inNumFiles, inNames,
+                             inTransparentLowerLeftCorner, true,
+                             readRaw, inNumThreads );
+
+    char allOnce = true;
+
+    DecodedSprite *sprite;
+    while( ( sprite = batch.waitForDecoded() ) != NULL ) {
+        if( seen[ sprite->index ] ) {
+            allOnce = false;
+            }
+        seen[ sprite->index ] = true;
+
+        if( outRGBA != NULL ) {
+            outRGBA[ sprite->index ] = sprite->rgba;
+            sprite->rgba = NULL;
+            }
+        SpriteDecodeBatch::freeDecodedSprite( sprite );
+        }
+
+    double seconds = Time::getCurrentTime() - startTime;
+
+    for( int i=0; i<inNumFiles; i++ ) {
+        if( ! seen[i] ) {
+            allOnce = false;
+            }
+        }
+    check( allOnce, "batch hands back each file once" );
+    check( batch.getNumTaken() == inNumFiles, "batch counts taken" );
+    check( batch.takeDecoded() == NULL, "nothing left after last" );
+
+    delete [] seen;
+
+    return seconds;
+    }
+
+
+
+int main( int inNumArgs, char **inArgs ) {
+    int numThreads = ThreadPool::getNumCPUs();
+    int numFiles = 600;
+    int size = 128;
+
+    if( inNumArgs > 1 ) {
+        numThreads = atoi( inArgs[1] );
+        }
+    if( inNumArgs > 2 ) {
+        numFiles = atoi( inArgs[2] );
+        }
+    if( inNumArgs > 3 ) {
+        size = atoi( inArgs[3] );
+        }
+
+
+    File folder( NULL, folderName );
+    if( ! folder.exists() ) {
+        folder.makeDirectory();
+        }
+    if( ! folder.isDirectory() ) {
+        printf( "FAILED:  %s is not a directory\n", folderName );
+        return 1;
+        }
+
+    // last name is never written
+    int numNames = numFiles + 1;
+    char **names = new char*[ numNames ];
+
+    TGAImageConverter converter;
+
+    for( int i=0; i<numFiles; i++ ) {
+        names[i] = autoSprintf( "sprite%04d.tga", i );
+
+        Image *image = makeImage( size, i % numKinds );
+
+        char *path = getPath( names[i] );
+        File file( NULL, path );
+        delete [] path;
+
+        FileOutputStream stream( &file );
+        converter.formatImage( image, &stream );
+
+        delete image;
+        }
+    names[ numFiles ] = stringDuplicate( "missing.tga" );
+
+    const char **constNames = (const char **)names;
+
+
+    // one of each kind, both corner settings, against loadSprite's path
+    for( int corner=0; corner<2; corner++ ) {
+        for( int i=0; i<numKinds; i++ ) {
+            RawRGBAImage *raw = readRaw( names[i] );
+            check( raw != NULL, "read test image" );
+
+            if( raw == NULL ) {
+                continue;
+                }
+
+            DecodedSprite sprite;
+            SpriteDecodeBatch::decode( raw, corner, true, &sprite );
+            delete raw;
+
+            char *what = autoSprintf( "kind %d corner %d matches "
+                                      "loadSprite", i, corner );
+            check( sameAsReference( &sprite, names[i], corner ), what );
+            delete [] what;
+
+            if( i == noAlpha ) {
+                check( ( sprite.rgba == NULL ) == ( corner == 0 ),
+                       "no-alpha sprite fails only without corner" );
+                }
+            else if( corner || i == realAlpha ) {
+                check( sprite.coloredRadii[0] < 0.5 &&
+                       sprite.coloredRadii[3] < 0.5,
+                       "blob radii found" );
+                }
+
+            if( sprite.rgba != NULL ) {
+                delete [] sprite.rgba;
+                }
+            }
+        }
+
+
+    // whole batch, including missing file
+    unsigned char **rgba = new unsigned char*[ numNames ];
+    runBatch( numNames, constNames, true, numThreads, rgba );
+
+    check( rgba[ numFiles ] == NULL, "missing file comes back empty" );
+
+    int numMismatched = 0;
+    for( int i=0; i<numFiles; i++ ) {
+        RawRGBAImage *raw = readRaw( names[i] );
+
+        if( raw == NULL ) {
+            printf( "FAILED:  read %s\n", names[i] );
+            numMismatched++;
+
+            if( rgba[i] != NULL ) {
+                delete [] rgba[i];
+                }
+            continue;
+            }
+
+        DecodedSprite sprite;
+        SpriteDecodeBatch::decode( raw, true, true, &sprite );
+        delete raw;
+
+        if( rgba[i] == NULL ||
+            memcmp( rgba[i], sprite.rgba, size * size * 4 ) != 0 ) {
+            numMismatched++;
+            }
+        delete [] sprite.rgba;
+
+        if( rgba[i] != NULL ) {
+            delete [] rgba[i];
+            }
+        }
+    delete [] rgba;
+    check( numMismatched == 0, "batch matches decoding one at a time" );
+
+
+    // deleting with work left and workers blocked on slots
+    // hangs here if workers aren't woken
+    {
+        SpriteDecodeBatch batch( numFiles, constNames, true, true, readRaw,
+                                 numThreads, 4 );
+        for( int i=0; i<2; i++ ) {
+            SpriteDecodeBatch::freeDecodedSprite( batch.waitForDecoded() );
+            }
+    }
+
+
+    // timing, warm cache
+    runBatch( numFiles, constNames, true, 1, NULL );
+
+    double startTime = Time::getCurrentTime();
+    for( int i=0; i<numFiles; i++ ) {
+        int w, h;
+        double radii[4];
+        unsigned char *bytes =
+            decodeAsLoadSprite( names[i], true, &w, &h, radii );
+        if( bytes != NULL ) {
+            delete [] bytes;
+            }
+        }
+    double loadSpriteSeconds = Time::getCurrentTime() - startTime;
+
+    double oneSeconds = runBatch( numFiles, constNames, true, 1, NULL );
+    double manySeconds =
+        runBatch( numFiles, constNames, true, numThreads, NULL );
+
+    printf( "%d sprites, %dx%d:\n", numFiles, size, size );
+    printf( "  loadSprite path, main thread:  %.1f ms\n",
+            loadSpriteSeconds * 1000 );
+    printf( "  batch, 1 thread:               %.1f ms\n",
+            oneSeconds * 1000 );
+    printf( "  batch, %2d threads:             %.1f ms\n",
+            numThreads, manySeconds * 1000 );
+
+
+    for( int i=0; i<numNames; i++ ) {
+        delete [] names[i];
+        }
+    delete [] names;
+
+    if( numFailed > 0 ) {
+        printf( "%d checks failed\n", numFailed );
+        return 1;
+        }
+
+    printf( "All checks passed\n" );
+    return 0;
+    }
@@ -0,0 +1,500 @@
+#include "FrameCapture.h"
+
+#include "minorGems/io/file/FileOutputStream.h"
+#include "minorGems/system/Time.h"
+#include "minorGems/util/stringUtils.h"
+
+#include <string.h>
+#include <math.h>
+
+
+
+FrameCaptureWorker::FrameCaptureWorker( FrameCapture *inCapture )
+        : mCapture( inCapture ) {
+    start();
+    }
+
+
+
+void FrameCaptureWorker::run() {
+    mCapture->runWorker();
+    }
+
+
+
+
+FrameCapture::FrameCapture( int inNumWorkers, int inQueueLength,
+                            char inDropWhenBehind )
+        : mJobsWaiting( 0 ),
+          mSlotsFree( inQueueLength ),
+          mQueueLength( inQueueLength ),
+          mDropWhenBehind( inDropWhenBehind ),
+          mDirectory( NULL ), mPrefix( NULL ), mExtension( NULL ),
+          mNextFileNumber( 1 ), mEncoder( NULL ),
+          mBlendPairs( false ), mHeldWeight( 0 ),
+          mHeldBytes( NULL ), mHeldWidth( 0 ), mHeldHeight( 0 ),
+          mNumSeen( 0 ), mNextSequence( 0 ),
+          mY4MFile( NULL ), mY4MFrameRate( 60 ),
+          mY4MWidth( 0 ), mY4MHeight( 0 ),
+          mNextSequenceToWrite( 0 ) {
+
+    memset( &mStats, 0, sizeof( mStats ) );
+
+    if( inNumWorkers < 1 ) {
+        inNumWorkers = 1;
+        }
+
+    for( int i=0; i<inNumWorkers; i++ ) {
+        mWorkers.push_back( new FrameCaptureWorker( this ) );
+        }
+    }
+
+
+
+FrameCapture::~FrameCapture() {
+    // stop requests go behind any queued frames
+    for( int i=0; i<mWorkers.size(); i++ ) {
+        mJobsWaiting.signal();
+        }
+    for( int i=0; i<mWorkers.size(); i++ ) {
+        FrameCaptureWorker *worker = *( mWorkers.getElement( i ) );
+        worker->join();
+        delete worker;
+        }
+
+    if( mHeldBytes != NULL ) {
+        delete [] mHeldBytes;
+        }
+
+    for( int i=0; i<mY4MPending.size(); i++ ) {
+        // only left if a frame was never written, which shouldn't happen
+        delete [] mY4MPending.getElement( i )->yuvBytes;
+        }
+
+    if( mY4MFile != NULL ) {
+        fclose( mY4MFile );
+        }
+
+    if( mDirectory != NULL ) {
+        delete mDirectory;
+        }
+    if( mPrefix != NULL ) {
+        delete [] mPrefix;
+        }
+    if( mExtension != NULL ) {
+        delete [] mExtension;
+        }
+    }
+
+
+
+void FrameCapture::setImageOutput( File *inDirectory,
+                                   const char *inPrefix,
+                                   const char *inExtension,
+                                   int inFirstNumber,
+                                   FrameEncoder inEncoder ) {
+    mDirectory = inDirectory->copy();
+    mPrefix = stringDuplicate( inPrefix );
+    mExtension = stringDuplicate( inExtension );
+    mNextFileNumber = inFirstNumber;
+    mEncoder = inEncoder;
+    }
+
+
+
+char FrameCapture::setY4MOutput( const char *inFileName, int inFrameRate ) {
+    mY4MFile = fopen( inFileName, "wb" );
+    mY4MFrameRate = inFrameRate;
+
+    return ( mY4MFile != NULL );
+    }
+
+
+
+void FrameCapture::setBlendPairs( double inFraction ) {
+    mBlendPairs = true;
+    mHeldWeight = lrint( inFraction * 256 );
+
+    if( mHeldWeight < 0 ) {
+        mHeldWeight = 0;
+        }
+    if( mHeldWeight > 256 ) {
+        mHeldWeight = 256;
+        }
+    }
+
+
+
+char FrameCapture::submitFrame( unsigned char *inRGBBytes,
+                                int inWidth, int inHeight ) {
+    mNumSeen++;
+
+    mLock.lock();
+    mStats.submitted++;
+    mLock.unlock();
+
+
+    if( mBlendPairs && mNumSeen % 2 == 1 ) {
+        // hold first frame of each pair until the second arrives
+        if( mHeldBytes != NULL ) {
+            delete [] mHeldBytes;
+            }
+        mHeldBytes = inRGBBytes;
+        mHeldWidth = inWidth;
+        mHeldHeight = inHeight;
+
+        mLock.lock();
+        mStats.held++;
+        mLock.unlock();
+
+        return true;
+        }
+
+
+    unsigned char *heldBytes = NULL;
+
+    if( mHeldBytes != NULL ) {
+        if( mHeldWidth == inWidth && mHeldHeight == inHeight ) {
+            heldBytes = mHeldBytes;
+            }
+        else {
+            // window resized between the two frames of a pair
+            delete [] mHeldBytes;
+            }
+        mHeldBytes = NULL;
+        }
+
+
+    // only this thread takes slots, so if it won't block now, it won't
+    if( mSlotsFree.willBlock() ) {
+
+        if( mDropWhenBehind ) {
+            delete [] inRGBBytes;
+            if( heldBytes != NULL ) {
+                delete [] heldBytes;
+                }
+
+            mLock.lock();
+            mStats.dropped++;
+            mLock.unlock();
+
+            return false;
+            }
+
+        double startTime = Time::getCurrentTime();
+
+        mSlotsFree.wait();
+
+        double waitTime = Time::getCurrentTime() - startTime;
+
+        mLock.lock();
+        mStats.backpressured++;
+        mStats.backpressureSeconds += waitTime;
+        mLock.unlock();
+        }
+    else {
+        mSlotsFree.wait();
+        }
+
+
+    CaptureJob job;
+    job.rgbBytes = inRGBBytes;
+    job.heldBytes = heldBytes;
+    job.width = inWidth;
+    job.height = inHeight;
+
+    job.fileNumber = -1;
+    if( mEncoder != NULL ) {
+        job.fileNumber = mNextFileNumber;
+        mNextFileNumber++;
+        }
+
+    job.sequence = -1;
+    if( mY4MFile != NULL ) {
+        if( mY4MWidth == 0 ) {
+            // first frame sets stream size
+            // workers only look at it after taking a later job
+            mY4MWidth = inWidth;
+            mY4MHeight = inHeight;
+            }
+
+        if( inWidth == mY4MWidth && inHeight == mY4MHeight ) {
+            job.sequence = mNextSequence;
+            mNextSequence++;
+            }
+        }
+
+
+    mLock.lock();
+    mQueue.push_back( job );
+    mLock.unlock();
+
+    mJobsWaiting.signal();
+
+    return true;
+    }
+
+
+
+void FrameCapture::flush() {
+    // each slot is held until its frame is written, so holding all of them
+    // means everything is done
+    for( int i=0; i<mQueueLength; i++ ) {
+        mSlotsFree.wait();
+        }
+    for( int i=0; i<mQueueLength; i++ ) {
+        mSlotsFree.signal();
+        }
+    }
+
+
+
+FrameCaptureStats FrameCapture::getStats() {
+    mLock.lock();
+    FrameCaptureStats stats = mStats;
+    mLock.unlock();
+
+    return stats;
+    }
+
+
+
+int FrameCapture::getNextFileNumber() {
+    return mNextFileNumber;
+    }
+
+
+
+void FrameCapture::runWorker() {
+    while( true ) {
+        mJobsWaiting.wait();
+
+        mLock.lock();
+
+        if( mQueue.size() == 0 ) {
+            // a stop request
+            mLock.unlock();
+            return;
+            }
+
+        CaptureJob job = *( mQueue.getElement( 0 ) );
+        mQueue.deleteElement( 0 );
+
+        mLock.unlock();
+
+
+        processJob( &job );
+
+        mSlotsFree.signal();
+        }
+    }
+
+
+
+void FrameCapture::processJob( CaptureJob *inJob ) {
+    int numBytes = inJob->width * inJob->height * 3;
+
+    unsigned char *bytes = inJob->rgbBytes;
+
+    if( inJob->heldBytes != NULL ) {
+        if( mHeldWeight > 0 ) {
+            unsigned char *held = inJob->heldBytes;
+
+            int weightA = 256 - mHeldWeight;
+            int weightB = mHeldWeight;
+
+            for( int i=0; i<numBytes; i++ ) {
+                bytes[i] =
+                    (unsigned char)(
+                        ( weightA * bytes[i] + weightB * held[i] + 128 )
+                        >> 8 );
+                }
+            }
+        delete [] inJob->heldBytes;
+        }
+
+
+    char failed = false;
+
+    if( inJob->fileNumber >= 0 ) {
+        char *fileName = autoSprintf( "%s%05d.%s", mPrefix,
+                                      inJob->fileNumber, mExtension );
+
+        File *file = mDirectory->getChildFile( fileName );
+        delete [] fileName;
+
+        FileOutputStream stream( file );
+
+        char *error = stream.getLastError();
+
+        if( error != NULL ) {
+            printf( "Frame capture:  %s\n", error );
+            delete [] error;
+            failed = true;
+            }
+        else {
+            mEncoder( bytes, inJob->width, inJob->height, &stream );
+            }
+
+        delete file;
+        }
+
+
+    if( inJob->sequence >= 0 ) {
+        writeY4M( inJob->sequence, bytes, inJob->width, inJob->height );
+        }
+
+    delete [] bytes;
+
+
+    mLock.lock();
+    if( failed ) {
+        mStats.failed++;
+        }
+    else {
+        mStats.written++;
+        }
+    mLock.unlock();
+    }
+
+
+
+void FrameCapture::writeY4M( int inSequence, unsigned char *inRGBBytes,
+                             int inWidth, int inHeight ) {
+
+    int chromaBytes = ( ( inWidth + 1 ) / 2 ) * ( ( inHeight + 1 ) / 2 );
+    int frameBytes = inWidth * inHeight + 2 * chromaBytes;
+
+    // convert outside of the lock, in parallel with other workers
+    Y4MFrame frame;
+    frame.sequence = inSequence;
+    frame.yuvBytes = new unsigned char[ frameBytes ];
+
+    rgbToYUV420( inRGBBytes, inWidth, inHeight, frame.yuvBytes );
+
+
+    mY4MLock.lock();
+
+    mY4MPending.push_back( frame );
+
+    if( mNextSequenceToWrite == 0 && inSequence == 0 ) {
+        fprintf( mY4MFile, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n",
+                 mY4MWidth, mY4MHeight, mY4MFrameRate );
+        }
+
+    // write out whatever is now next in line, which might include frames
+    // finished earlier by other workers
+    char found = true;
+
+    while( found ) {
+        found = false;
+
+        for( int i=0; i<mY4MPending.size(); i++ ) {
+            Y4MFrame *f = mY4MPending.getElement( i );
+
+            if( f->sequence == mNextSequenceToWrite ) {
+                fputs( "FRAME\n", mY4MFile );
+                fwrite( f->yuvBytes, 1, frameBytes, mY4MFile );
+
+                delete [] f->yuvBytes;
+                mY4MPending.deleteElement( i );
+
+                mNextSequenceToWrite++;
+                found = true;
+                break;
+                }
+            }
+        }
+
+    mY4MLock.unlock();
+    }
+
+
+
+
+static unsigned char clampByte( int inValue ) {
+    if( inValue < 0 ) {
+        return 0;
+        }
+    if( inValue > 255 ) {
+        return 255;
+        }
+    return (unsigned char)inValue;
+    }
+
+
+
+void rgbToYUV420( unsigned char *inRGBBytes, int inWidth, int inHeight,
+                  unsigned char *outYUVBytes ) {
+
+    int chromaWidth = ( inWidth + 1 ) / 2;
+    int chromaHeight = ( inHeight + 1 ) / 2;
+
+    unsigned char *yPlane = outYUVBytes;
+    unsigned char *uPlane = &( yPlane[ inWidth * inHeight ] );
+    unsigned char *vPlane = &( uPlane[ chromaWidth * chromaHeight ] );
+
+    int rowBytes = inWidth * 3;
+
+    // 16-bit fixed point coefficients, BT.601 full range
+    for( int y=0; y<inHeight; y++ ) {
+        unsigned char *source =
+            &( inRGBBytes[ ( inHeight - 1 - y ) * rowBytes ] );
+
+        unsigned char *dest = &( yPlane[ y * inWidth ] );
+
+        for( int x=0; x<inWidth; x++ ) {
+            int r = source[0];
+            int g = source[1];
+            int b = source[2];
+            source += 3;
+
+            dest[x] = (unsigned char)(
+                ( 19595 * r + 38470 * g + 7471 * b + 32768 ) >> 16 );
+            }
+        }
+
+
+    for( int cy=0; cy<chromaHeight; cy++ ) {
+        for( int cx=0; cx<chromaWidth; cx++ ) {
+
+            int sumR = 0;
+            int sumG = 0;
+            int sumB = 0;
+            int count = 0;
+
+            for( int dy=0; dy<2; dy++ ) {
+                int y = cy * 2 + dy;
+                if( y >= inHeight ) {
+                    break;
+                    }
+                unsigned char *row =
+                    &( inRGBBytes[ ( inHeight - 1 - y ) * rowBytes ] );
+
+                for( int dx=0; dx<2; dx++ ) {
+                    int x = cx * 2 + dx;
+                    if( x >= inWidth ) {
+                        break;
+                        }
+                    sumR += row[ x * 3 ];
+                    sumG += row[ x * 3 + 1 ];
+                    sumB += row[ x * 3 + 2 ];
+                    count++;
+                    }
+                }
+
+            int r = ( sumR + count / 2 ) / count;
+            int g = ( sumG + count / 2 ) / count;
+            int b = ( sumB + count / 2 ) / count;
+
+            int index = cy * chromaWidth + cx;
+
+            uPlane[index] = clampByte(
+                ( -11058 * r - 21710 * g + 32768 * b +
+                  ( 128 << 16 ) + 32768 ) >> 16 );
+            vPlane[index] = clampByte(
+                ( 32768 * r - 27439 * g - 5329 * b +
+                  ( 128 << 16 ) + 32768 ) >> 16 );
+            }
+        }
+    }
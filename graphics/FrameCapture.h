@@ -0,0 +1,266 @@
+#ifndef FRAME_CAPTURE_INCLUDED
+#define FRAME_CAPTURE_INCLUDED
+
+
+#include "minorGems/io/OutputStream.h"
+#include "minorGems/io/file/File.h"
+#include "minorGems/system/Thread.h"
+#include "minorGems/system/MutexLock.h"
+#include "minorGems/system/Semaphore.h"
+#include "minorGems/util/SimpleVector.h"
+
+#include <stdio.h>
+
+
+
+// Writes a stream of captured frames to disk from worker threads, so the
+// thread that reads frames back (usually the GL thread) only copies bytes
+// and moves on.
+//
+// Frames are 8-bit RGB bytes with the bottom row first, as glReadPixels
+// returns them.  They go through a bounded queue to a pool of workers that
+// blend frame pairs, encode image files straight from the bytes, and
+// convert frames for an optional .y4m video stream.
+//
+// Nothing here touches GL, so frames can be fed in from anywhere.
+
+
+
+// encodes one frame, RGB bytes with bottom row first, to inStream
+// called from worker threads, so must be thread-safe
+typedef void (*FrameEncoder)( unsigned char *inRGBBytes,
+                              int inWidth, int inHeight,
+                              OutputStream *inStream );
+
+
+
+typedef struct FrameCaptureStats {
+        // frames passed to submitFrame
+        int submitted;
+
+        // frames held back to blend into the next frame
+        int held;
+
+        // frames encoded and written
+        int written;
+
+        // frames thrown away because the queue was full
+        int dropped;
+
+        // frames that waited for room in the queue, and total wait
+        int backpressured;
+        double backpressureSeconds;
+
+        // frames whose image file could not be opened
+        int failed;
+    } FrameCaptureStats;
+
+
+
+class FrameCapture;
+
+
+
+class FrameCaptureWorker : public Thread {
+
+    public:
+
+        // starts the thread
+        FrameCaptureWorker( FrameCapture *inCapture );
+
+        virtual void run();
+
+    protected:
+        FrameCapture *mCapture;
+    };
+
+
+
+typedef struct CaptureJob {
+        unsigned char *rgbBytes;
+
+        // earlier frame to blend in, or NULL
+        unsigned char *heldBytes;
+
+        int width;
+        int height;
+
+        // number in image file name
+        int fileNumber;
+
+        // order in y4m stream
+        int sequence;
+    } CaptureJob;
+
+
+
+typedef struct Y4MFrame {
+        int sequence;
+        unsigned char *yuvBytes;
+    } Y4MFrame;
+
+
+
+class FrameCapture {
+
+    public:
+
+        /**
+         * Starts the worker threads.
+         *
+         * @param inNumWorkers the number of encoding threads.
+         * @param inQueueLength the maximum number of frames queued or
+         *   being encoded at once.
+         * @param inDropWhenBehind true to drop frames that arrive when the
+         *   queue is full, or false to make submitFrame wait for room.
+         */
+        FrameCapture( int inNumWorkers, int inQueueLength,
+                      char inDropWhenBehind );
+
+        // finishes all submitted frames, then stops the workers
+        ~FrameCapture();
+
+
+        // the set functions must be called before the first submitFrame
+
+
+        /**
+         * Writes each frame to its own image file.
+         *
+         * @param inDirectory the directory to put files in.
+         *   Destroyed by caller.
+         * @param inPrefix, inExtension name files as
+         *   prefix00001.extension.  Copied internally.
+         * @param inFirstNumber the number of the first file.
+         * @param inEncoder the encoder to use.
+         */
+        void setImageOutput( File *inDirectory,
+                             const char *inPrefix, const char *inExtension,
+                             int inFirstNumber, FrameEncoder inEncoder );
+
+
+        /**
+         * Also writes frames, in order, to a raw YUV 4:2:0 .y4m stream.
+         *
+         * @param inFileName the file to write.
+         * @param inFrameRate the frame rate in the stream header.
+         *
+         * @return true if the file was opened.
+         */
+        char setY4MOutput( const char *inFileName, int inFrameRate );
+
+
+        /**
+         * Outputs only every other frame, blending each output frame with
+         * the frame held back before it.
+         *
+         * @param inFraction the weight of the held frame, or 0 to just
+         *   skip it.
+         */
+        void setBlendPairs( double inFraction );
+
+
+
+        /**
+         * Queues a frame.
+         *
+         * @param inRGBBytes the frame, width * height * 3 bytes with
+         *   the bottom row first.  Destroyed by this class, even if the
+         *   frame is dropped.
+         *
+         * @return false if the frame was dropped.
+         */
+        char submitFrame( unsigned char *inRGBBytes,
+                          int inWidth, int inHeight );
+
+
+        // waits until all submitted frames have been written
+        void flush();
+
+
+        FrameCaptureStats getStats();
+
+        // number of the next image file that would be written
+        int getNextFileNumber();
+
+
+        // called by workers
+        void runWorker();
+
+
+    protected:
+
+        // guards mQueue and mStats
+        MutexLock mLock;
+
+        SimpleVector<CaptureJob> mQueue;
+
+        // counts jobs in mQueue, and stop requests
+        Semaphore mJobsWaiting;
+
+        // counts free queue slots, held by a job until it is written
+        Semaphore mSlotsFree;
+
+        int mQueueLength;
+        char mDropWhenBehind;
+
+        SimpleVector<FrameCaptureWorker *> mWorkers;
+
+        FrameCaptureStats mStats;
+
+
+        File *mDirectory;
+        char *mPrefix;
+        char *mExtension;
+        int mNextFileNumber;
+        FrameEncoder mEncoder;
+
+
+        char mBlendPairs;
+        int mHeldWeight;
+        unsigned char *mHeldBytes;
+        int mHeldWidth;
+        int mHeldHeight;
+        int mNumSeen;
+
+        // next y4m sequence number, only used by submitFrame
+        int mNextSequence;
+
+
+        // guards the y4m fields below
+        MutexLock mY4MLock;
+
+        FILE *mY4MFile;
+        int mY4MFrameRate;
+
+        // set by first frame written, 0 before that
+        int mY4MWidth;
+        int mY4MHeight;
+
+        int mNextSequenceToWrite;
+
+        // converted frames waiting for earlier frames to be written
+        SimpleVector<Y4MFrame> mY4MPending;
+
+
+        void processJob( CaptureJob *inJob );
+
+        void writeY4M( int inSequence, unsigned char *inRGBBytes,
+                       int inWidth, int inHeight );
+    };
+
+
+
+/**
+ * Converts bottom-up RGB bytes to planar YUV 4:2:0 (JPEG/full-range
+ * BT.601 coefficients, chroma centered in each 2x2 block), top row first.
+ *
+ * @param outYUVBytes must hold w * h + 2 * ((w + 1) / 2) * ((h + 1) / 2)
+ *   bytes.
+ */
+void rgbToYUV420( unsigned char *inRGBBytes, int inWidth, int inHeight,
+                  unsigned char *outYUVBytes );
+
+
+
+#endif
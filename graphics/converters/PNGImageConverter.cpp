@@ -159,27 +159,20 @@ void libpngFlushCallback( png_structp png_ptr ) {
 
 
 
-void PNGImageConverter::formatImage( Image *inImage, 
-	OutputStream *inStream ) {
+void PNGImageConverter::formatBytes( unsigned char *inBytes,
+                                     int inWidth, int inHeight,
+                                     int inNumChannels, char inBottomUp,
+                                     OutputStream *inStream ) {
 
-	int numChannels = inImage->getNumChannels();
-	
-	// make sure the image is in the right format
-	if( numChannels != 3 &&
-		numChannels != 4 ) {
+	if( inNumChannels != 3 &&
+		inNumChannels != 4 ) {
 		printf( "Only 3- and 4-channel images can be converted to " );
 		printf( "the PNG format.\n" );
 		return;
 		}
 
-	int w = inImage->getWidth();
-	int h = inImage->getHeight();
-	
-    //RGBAImage rgbaImage( inImage );
-    
-    unsigned char *imageBytes = RGBAImage::getRGBABytes( inImage );
-
-    
+    int w = inWidth;
+    int h = inHeight;
 
     // libpng implementation
 
@@ -190,8 +183,14 @@ void PNGImageConverter::formatImage( Image *inImage,
     // get pointers to rows
     unsigned char **rows = new unsigned char *[h];
     
+    int rowLength = w * inNumChannels;
+
     for( int y=0; y<h; y++ ) {
-        rows[y] = &( imageBytes[ y * (w * 4) ] );
+        int sourceRow = y;
+        if( inBottomUp ) {
+            sourceRow = h - 1 - y;
+            }
+        rows[y] = &( inBytes[ sourceRow * rowLength ] );
         }
 
 
@@ -202,7 +201,6 @@ void PNGImageConverter::formatImage( Image *inImage,
 	png_ptr = png_create_write_struct( PNG_LIBPNG_VER_STRING, 
                                        NULL, NULL, NULL );
 	if( !png_ptr ) {
-        delete [] imageBytes;
         delete [] rows;
         printf( "PNG Writing:  png_create_write_struct failed\n" );
         return;
@@ -214,7 +212,6 @@ void PNGImageConverter::formatImage( Image *inImage,
 	info_ptr = png_create_info_struct( png_ptr );
 	
     if( !info_ptr ) {
-        delete [] imageBytes;
         delete [] rows;
         png_destroy_write_struct( &png_ptr, NULL );
 
@@ -224,7 +221,6 @@ void PNGImageConverter::formatImage( Image *inImage,
     
     // weird way that libpng handles errors with a jump
 	if( setjmp( png_jmpbuf( png_ptr ) ) ) {
-        delete [] imageBytes;
         delete [] rows;
         png_destroy_write_struct( &png_ptr, &info_ptr );
 
@@ -246,7 +242,6 @@ void PNGImageConverter::formatImage( Image *inImage,
 
 	// write header
 	if( setjmp( png_jmpbuf( png_ptr ) ) ) {
-        delete [] imageBytes;
         delete [] rows;
         png_destroy_write_struct( &png_ptr, &info_ptr );
 
@@ -254,8 +249,13 @@ void PNGImageConverter::formatImage( Image *inImage,
         return;
         }
 
+	int colorType = PNG_COLOR_TYPE_RGB_ALPHA;
+    if( inNumChannels == 3 ) {
+        colorType = PNG_COLOR_TYPE_RGB;
+        }
+
 	png_set_IHDR( png_ptr, info_ptr, w, h,
-                  8, PNG_COLOR_TYPE_RGB_ALPHA, PNG_INTERLACE_NONE,
+                  8, colorType, PNG_INTERLACE_NONE,
                   PNG_COMPRESSION_TYPE_BASE, PNG_FILTER_TYPE_BASE );
 
 	png_write_info( png_ptr, info_ptr );
@@ -264,7 +264,6 @@ void PNGImageConverter::formatImage( Image *inImage,
 	// write bytes
     // write header
 	if( setjmp( png_jmpbuf( png_ptr ) ) ) {
-        delete [] imageBytes;
         delete [] rows;
         png_destroy_write_struct( &png_ptr, &info_ptr );
 
@@ -277,7 +276,6 @@ void PNGImageConverter::formatImage( Image *inImage,
 
 	// end write
     if( setjmp( png_jmpbuf( png_ptr ) ) ) {
-        delete [] imageBytes;
         delete [] rows;
         png_destroy_write_struct( &png_ptr, &info_ptr );
 
@@ -290,8 +288,36 @@ void PNGImageConverter::formatImage( Image *inImage,
 
     png_destroy_write_struct( &png_ptr, &info_ptr );
     
-    delete [] imageBytes;
     delete [] rows;
+    }
+
+
+
+void PNGImageConverter::formatImage( Image *inImage, 
+	OutputStream *inStream ) {
+
+	int numChannels = inImage->getNumChannels();
+	
+	// make sure the image is in the right format
+	if( numChannels != 3 &&
+		numChannels != 4 ) {
+		printf( "Only 3- and 4-channel images can be converted to " );
+		printf( "the PNG format.\n" );
+		return;
+		}
+
+	int w = inImage->getWidth();
+	int h = inImage->getHeight();
+	
+    //RGBAImage rgbaImage( inImage );
+    
+    unsigned char *imageBytes = RGBAImage::getRGBABytes( inImage );
+
+    
+
+    formatBytes( imageBytes, w, h, 4, false, inStream );
+
+    delete [] imageBytes;
     
 
     if( true ) {
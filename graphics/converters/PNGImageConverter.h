@@ -48,6 +48,23 @@ class PNGImageConverter : public BigEndianImageConverter {
 		virtual Image *deformatImage( InputStream *inStream );		
 
 
+        /**
+         * Encodes raw 8-bit-per-channel bytes directly, skipping the
+         * conversion to and from an Image.
+         *
+         * @param inBytes the pixel bytes, RGB or RGBA interleaved.
+         *   Destroyed by caller.
+         * @param inNumChannels 3 for an RGB PNG, or 4 for RGBA.
+         * @param inBottomUp true if the bottom row comes first in inBytes
+         *   (as read back from OpenGL).
+         * @param inStream the stream to write to.  Destroyed by caller.
+         */
+        void formatBytes( unsigned char *inBytes,
+                          int inWidth, int inHeight,
+                          int inNumChannels, char inBottomUp,
+                          OutputStream *inStream );
+
+
     protected:
         
         int mCompressionLevel;
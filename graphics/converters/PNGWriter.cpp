@@ -0,0 +1,610 @@
+#include "PNGWriter.h"
+
+#include "minorGems/util/crc32.h"
+#include "minorGems/util/adler32.h"
+#include "minorGems/system/Semaphore.h"
+#include "minorGems/util/SimpleVector.h"
+
+// miniz's zlib-compatible names would rename our crc32
+#define MINIZ_NO_ZLIB_COMPATIBLE_NAMES
+#include "minorGems/formats/miniz.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+
+
+static void writeUInt32( unsigned int inValue, unsigned char *outBytes ) {
+    outBytes[0] = (unsigned char)( inValue >> 24 );
+    outBytes[1] = (unsigned char)( inValue >> 16 );
+    outBytes[2] = (unsigned char)( inValue >> 8 );
+    outBytes[3] = (unsigned char)( inValue );
+    }
+
+
+
+// inChunk holds the 4-byte type followed by the data
+static void writeChunk( unsigned char *inChunk, int inDataLength,
+                        unsigned int inCRC, OutputStream *inStream ) {
+    unsigned char lengthBytes[4];
+    unsigned char crcBytes[4];
+
+    writeUInt32( inDataLength, lengthBytes );
+    writeUInt32( inCRC, crcBytes );
+
+    inStream->write( lengthBytes, 4 );
+    inStream->write( inChunk, inDataLength + 4 );
+    inStream->write( crcBytes, 4 );
+    }
+
+
+
+static void writeChunk( const char inType[4],
+                        unsigned char *inData, int inDataLength,
+                        OutputStream *inStream ) {
+    unsigned char *chunk = new unsigned char[ inDataLength + 4 ];
+
+    memcpy( chunk, inType, 4 );
+    if( inDataLength > 0 ) {
+        memcpy( &( chunk[4] ), inData, inDataLength );
+        }
+
+    writeChunk( chunk, inDataLength,
+                crc32( chunk, inDataLength + 4 ), inStream );
+
+    delete [] chunk;
+    }
+
+
+
+// filters and deflates a run of rows into the data of one IDAT chunk
+class PNGStripJob : public ThreadPoolJob {
+
+    public:
+
+        PNGStripJob( unsigned char *inFirstRow, unsigned char *inPrevRow,
+                     long inRowStride, int inNumRows,
+                     int inRowLength, int inBytesPerPixel,
+                     int inCompressionLevel,
+                     char inFirst, char inLast )
+                : mFirstRow( inFirstRow ), mPrevRow( inPrevRow ),
+                  mRowStride( inRowStride ), mNumRows( inNumRows ),
+                  mRowLength( inRowLength ),
+                  mBytesPerPixel( inBytesPerPixel ),
+                  mCompressionLevel( inCompressionLevel ),
+                  mFirst( inFirst ), mLast( inLast ),
+                  mChunk( NULL ), mDataLength( 0 ), mCRC( 0 ),
+                  mAdler( 1 ), mFilteredLength( 0 ) {
+            }
+
+
+        virtual ~PNGStripJob() {
+            if( mChunk != NULL ) {
+                delete [] mChunk;
+                }
+            }
+
+
+        virtual void runJob();
+
+
+        unsigned char *mFirstRow;
+
+        // NULL for the image's first row
+        unsigned char *mPrevRow;
+
+        // negative for bottom-up bytes
+        long mRowStride;
+
+        int mNumRows;
+        int mRowLength;
+        int mBytesPerPixel;
+        int mCompressionLevel;
+
+        // first strip carries the zlib header
+        char mFirst;
+
+        // last strip finishes the deflate stream and has room after
+        // mDataLength for the combined Adler-32, which only the writing
+        // thread knows
+        char mLast;
+
+
+        // results
+
+        // 4-byte IDAT type followed by mDataLength bytes
+        unsigned char *mChunk;
+        int mDataLength;
+
+        // unset for last strip
+        unsigned int mCRC;
+
+        // of this strip's filtered bytes alone
+        unsigned int mAdler;
+        unsigned long mFilteredLength;
+
+        Semaphore mDone;
+    };
+
+
+
+void PNGStripJob::runJob() {
+    int filteredRowLength = mRowLength + 1;
+    mFilteredLength = (unsigned long)mNumRows * filteredRowLength;
+
+    unsigned char *filtered = new unsigned char[ mFilteredLength ];
+    unsigned char *scratch = new unsigned char[ 4 * mRowLength ];
+
+    unsigned char *zeroRow = NULL;
+    unsigned char *prevRow = mPrevRow;
+
+    if( prevRow == NULL ) {
+        zeroRow = new unsigned char[ mRowLength ];
+        memset( zeroRow, 0, mRowLength );
+        prevRow = zeroRow;
+        }
+
+    unsigned char *row = mFirstRow;
+
+    for( int r=0; r<mNumRows; r++ ) {
+        PNGWriter::filterRow( row, prevRow, mRowLength, mBytesPerPixel,
+                              &( filtered[ r * filteredRowLength ] ),
+                              scratch );
+        prevRow = row;
+        row += mRowStride;
+        }
+
+    delete [] scratch;
+    if( zeroRow != NULL ) {
+        delete [] zeroRow;
+        }
+
+    mAdler = adler32Update( 1, filtered, mFilteredLength );
+
+
+    // raw deflate, no zlib header or trailer
+    mz_stream stream;
+    memset( &stream, 0, sizeof( stream ) );
+
+    mz_deflateInit2( &stream, mCompressionLevel, MZ_DEFLATED,
+                     -MZ_DEFAULT_WINDOW_BITS, 9, MZ_DEFAULT_STRATEGY );
+
+    // room for the sync flush's empty stored block too
+    unsigned long maxLength =
+        mz_deflateBound( &stream, mFilteredLength ) + 16;
+
+    int headerLength = 4;
+    if( mFirst ) {
+        headerLength += 2;
+        }
+
+    mChunk = new unsigned char[ headerLength + maxLength + 4 ];
+
+    memcpy( mChunk, "IDAT", 4 );
+
+    if( mFirst ) {
+        // 32K window, with level hint
+        int levelHint = 3;
+        if( mCompressionLevel <= 1 ) {
+            levelHint = 0;
+            }
+        else if( mCompressionLevel <= 5 ) {
+            levelHint = 1;
+            }
+        else if( mCompressionLevel == 6 ) {
+            levelHint = 2;
+            }
+
+        int cmf = 0x78;
+        int flg = levelHint << 6;
+        flg += 31 - ( cmf * 256 + flg ) % 31;
+
+        mChunk[4] = (unsigned char)cmf;
+        mChunk[5] = (unsigned char)flg;
+        }
+
+    stream.next_in = filtered;
+    stream.avail_in = mFilteredLength;
+    stream.next_out = &( mChunk[ headerLength ] );
+    stream.avail_out = maxLength;
+
+    // sync flush ends on a byte boundary with no final block, so the next
+    // strip's blocks can follow straight on
+    int result = mz_deflate( &stream, mLast ? MZ_FINISH : MZ_SYNC_FLUSH );
+
+    if( result < 0 || stream.avail_in != 0 ) {
+        printf( "PNGWriter:  deflate failed with %d\n", result );
+        }
+
+    mDataLength = headerLength - 4 + stream.total_out;
+
+    mz_deflateEnd( &stream );
+
+    delete [] filtered;
+
+    if( ! mLast ) {
+        mCRC = crc32( mChunk, mDataLength + 4 );
+        }
+
+    // writing thread may destroy us now
+    mDone.signal();
+    }
+
+
+
+PNGWriter::PNGWriter( char inMaxCompression, int inNumThreads )
+        : mCompressionLevel( 3 ), mStripBytes( 256 * 1024 ),
+          mPool( NULL ) {
+
+    if( inMaxCompression ) {
+        mCompressionLevel = MZ_UBER_COMPRESSION;
+        mStripBytes = 1024 * 1024;
+        }
+
+    if( inNumThreads != 1 ) {
+        mPool = new ThreadPool( inNumThreads );
+        }
+    }
+
+
+
+PNGWriter::~PNGWriter() {
+    if( mPool != NULL ) {
+        delete mPool;
+        }
+    }
+
+
+
+void PNGWriter::setCompressionLevel( int inLevel ) {
+    mCompressionLevel = inLevel;
+    }
+
+
+
+void PNGWriter::setStripBytes( int inBytes ) {
+    mStripBytes = inBytes;
+    }
+
+
+
+void PNGWriter::formatBytes( unsigned char *inBytes,
+                             int inWidth, int inHeight,
+                             int inNumChannels, char inBottomUp,
+                             OutputStream *inStream ) {
+
+    if( inNumChannels != 3 &&
+        inNumChannels != 4 ) {
+        printf( "Only 3- and 4-channel images can be converted to " );
+        printf( "the PNG format.\n" );
+        return;
+        }
+
+    if( inWidth <= 0 || inHeight <= 0 ) {
+        printf( "PNGWriter:  can't write an empty image.\n" );
+        return;
+        }
+
+    int w = inWidth;
+    int h = inHeight;
+
+    int rowLength = w * inNumChannels;
+
+    unsigned char *topRow = inBytes;
+    long rowStride = rowLength;
+
+    if( inBottomUp ) {
+        topRow = &( inBytes[ (long)( h - 1 ) * rowLength ] );
+        rowStride = -rowLength;
+        }
+
+    int rowsPerStrip = mStripBytes / rowLength;
+    if( rowsPerStrip < 1 ) {
+        rowsPerStrip = 1;
+        }
+
+    int numStrips = ( h + rowsPerStrip - 1 ) / rowsPerStrip;
+
+
+    SimpleVector<PNGStripJob *> jobs;
+
+    for( int s=0; s<numStrips; s++ ) {
+        int firstRow = s * rowsPerStrip;
+
+        int numRows = rowsPerStrip;
+        if( firstRow + numRows > h ) {
+            numRows = h - firstRow;
+            }
+
+        unsigned char *prevRow = NULL;
+        if( firstRow > 0 ) {
+            prevRow = topRow + ( firstRow - 1 ) * rowStride;
+            }
+
+        PNGStripJob *job =
+            new PNGStripJob( topRow + firstRow * rowStride, prevRow,
+                             rowStride, numRows,
+                             rowLength, inNumChannels,
+                             mCompressionLevel,
+                             ( s == 0 ), ( s == numStrips - 1 ) );
+        jobs.push_back( job );
+
+        if( mPool != NULL ) {
+            mPool->addJob( job );
+            }
+        }
+
+
+    // header while workers start
+
+    unsigned char signature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+    inStream->write( signature, 8 );
+
+    unsigned char header[13];
+    writeUInt32( w, &( header[0] ) );
+    writeUInt32( h, &( header[4] ) );
+
+    // 8 bits per channel
+    header[8] = 8;
+
+    // RGB or RGBA
+    if( inNumChannels == 3 ) {
+        header[9] = 2;
+        }
+    else {
+        header[9] = 6;
+        }
+
+    // deflate, adaptive filtering, not interlaced
+    header[10] = 0;
+    header[11] = 0;
+    header[12] = 0;
+
+    writeChunk( "IHDR", header, 13, inStream );
+
+
+    // write each strip as soon as it and those before it are done
+
+    unsigned int adler = 1;
+
+    for( int s=0; s<numStrips; s++ ) {
+        PNGStripJob *job = jobs.getElementDirect( s );
+
+        if( mPool == NULL ) {
+            job->runJob();
+            }
+
+        job->mDone.wait();
+
+        if( s == 0 ) {
+            adler = job->mAdler;
+            }
+        else {
+            adler = adler32Combine( adler, job->mAdler,
+                                    job->mFilteredLength );
+            }
+
+        if( job->mLast ) {
+            writeUInt32( adler, &( job->mChunk[ job->mDataLength + 4 ] ) );
+            job->mDataLength += 4;
+
+            job->mCRC = crc32( job->mChunk, job->mDataLength + 4 );
+            }
+
+        writeChunk( job->mChunk, job->mDataLength, job->mCRC, inStream );
+
+        delete job;
+        }
+
+    writeChunk( "IEND", NULL, 0, inStream );
+    }
+
+
+
+static inline int absSigned( unsigned char inByte ) {
+    int value = (signed char)inByte;
+    if( value < 0 ) {
+        return -value;
+        }
+    return value;
+    }
+
+
+
+static inline unsigned char paethPredictor( int inA, int inB, int inC ) {
+    int p = inA + inB - inC;
+    int pa = p - inA;
+    int pb = p - inB;
+    int pc = p - inC;
+
+    if( pa < 0 ) pa = -pa;
+    if( pb < 0 ) pb = -pb;
+    if( pc < 0 ) pc = -pc;
+
+    if( pa <= pb && pa <= pc ) {
+        return (unsigned char)inA;
+        }
+    else if( pb <= pc ) {
+        return (unsigned char)inB;
+        }
+    return (unsigned char)inC;
+    }
+
+
+
+#ifdef __SSE2__
+
+// absolute values of bytes taken as signed, as unsigned bytes
+static inline __m128i absSignedBytes( __m128i inX ) {
+    __m128i negX = _mm_sub_epi8( _mm_setzero_si128(), inX );
+    return _mm_min_epu8( inX, negX );
+    }
+
+
+static inline __m128i abs16( __m128i inX ) {
+    return _mm_max_epi16( inX,
+                          _mm_sub_epi16( _mm_setzero_si128(), inX ) );
+    }
+
+
+// byte lanes where inMask is set come from inA, the rest from inB
+static inline __m128i selectBytes( __m128i inMask,
+                                   __m128i inA, __m128i inB ) {
+    return _mm_or_si128( _mm_and_si128( inMask, inA ),
+                         _mm_andnot_si128( inMask, inB ) );
+    }
+
+#endif
+
+
+
+void PNGWriter::filterRow( unsigned char *inRow, unsigned char *inPrevRow,
+                           int inRowLength, int inBytesPerPixel,
+                           unsigned char *outFiltered,
+                           unsigned char *inScratch ) {
+
+    unsigned char *x = inRow;
+    unsigned char *b = inPrevRow;
+    int n = inRowLength;
+    int bpp = inBytesPerPixel;
+
+    unsigned char *sub = inScratch;
+    unsigned char *up = &( inScratch[ n ] );
+    unsigned char *avg = &( inScratch[ 2 * n ] );
+    unsigned char *paeth = &( inScratch[ 3 * n ] );
+
+    // none, sub, up, average, paeth
+    unsigned long scores[5] = { 0, 0, 0, 0, 0 };
+
+    int i = 0;
+
+    // first pixel has nothing to its left
+    for( ; i<bpp && i<n; i++ ) {
+        sub[i] = x[i];
+        up[i] = x[i] - b[i];
+        avg[i] = x[i] - ( b[i] >> 1 );
+        paeth[i] = x[i] - b[i];
+
+        scores[0] += absSigned( x[i] );
+        scores[1] += absSigned( sub[i] );
+        scores[2] += absSigned( up[i] );
+        scores[3] += absSigned( avg[i] );
+        scores[4] += absSigned( paeth[i] );
+        }
+
+#ifdef __SSE2__
+    __m128i zero = _mm_setzero_si128();
+    __m128i one = _mm_set1_epi8( 1 );
+
+    __m128i sums[5];
+    for( int f=0; f<5; f++ ) {
+        sums[f] = zero;
+        }
+
+    for( ; i + 16 <= n; i += 16 ) {
+        __m128i vx = _mm_loadu_si128( (__m128i *)&( x[i] ) );
+        __m128i va = _mm_loadu_si128( (__m128i *)&( x[ i - bpp ] ) );
+        __m128i vb = _mm_loadu_si128( (__m128i *)&( b[i] ) );
+        __m128i vc = _mm_loadu_si128( (__m128i *)&( b[ i - bpp ] ) );
+
+        __m128i vSub = _mm_sub_epi8( vx, va );
+        __m128i vUp = _mm_sub_epi8( vx, vb );
+
+        // rounding average, less the rounding
+        __m128i vAvgPred =
+            _mm_sub_epi8( _mm_avg_epu8( va, vb ),
+                          _mm_and_si128( _mm_xor_si128( va, vb ), one ) );
+        __m128i vAvg = _mm_sub_epi8( vx, vAvgPred );
+
+        // paeth distances need 9 bits
+        __m128i aLo = _mm_unpacklo_epi8( va, zero );
+        __m128i aHi = _mm_unpackhi_epi8( va, zero );
+        __m128i bLo = _mm_unpacklo_epi8( vb, zero );
+        __m128i bHi = _mm_unpackhi_epi8( vb, zero );
+        __m128i cLo = _mm_unpacklo_epi8( vc, zero );
+        __m128i cHi = _mm_unpackhi_epi8( vc, zero );
+
+        __m128i paLo = abs16( _mm_sub_epi16( bLo, cLo ) );
+        __m128i paHi = abs16( _mm_sub_epi16( bHi, cHi ) );
+        __m128i pbLo = abs16( _mm_sub_epi16( aLo, cLo ) );
+        __m128i pbHi = abs16( _mm_sub_epi16( aHi, cHi ) );
+        __m128i pcLo = abs16( _mm_sub_epi16( _mm_add_epi16( aLo, bLo ),
+                                             _mm_add_epi16( cLo, cLo ) ) );
+        __m128i pcHi = abs16( _mm_sub_epi16( _mm_add_epi16( aHi, bHi ),
+                                             _mm_add_epi16( cHi, cHi ) ) );
+
+        __m128i notA = _mm_packs_epi16(
+            _mm_or_si128( _mm_cmpgt_epi16( paLo, pbLo ),
+                          _mm_cmpgt_epi16( paLo, pcLo ) ),
+            _mm_or_si128( _mm_cmpgt_epi16( paHi, pbHi ),
+                          _mm_cmpgt_epi16( paHi, pcHi ) ) );
+        __m128i notB = _mm_packs_epi16( _mm_cmpgt_epi16( pbLo, pcLo ),
+                                        _mm_cmpgt_epi16( pbHi, pcHi ) );
+
+        __m128i vPaethPred =
+            selectBytes( notA, selectBytes( notB, vc, vb ), va );
+        __m128i vPaeth = _mm_sub_epi8( vx, vPaethPred );
+
+        _mm_storeu_si128( (__m128i *)&( sub[i] ), vSub );
+        _mm_storeu_si128( (__m128i *)&( up[i] ), vUp );
+        _mm_storeu_si128( (__m128i *)&( avg[i] ), vAvg );
+        _mm_storeu_si128( (__m128i *)&( paeth[i] ), vPaeth );
+
+        sums[0] = _mm_add_epi64(
+            sums[0], _mm_sad_epu8( absSignedBytes( vx ), zero ) );
+        sums[1] = _mm_add_epi64(
+            sums[1], _mm_sad_epu8( absSignedBytes( vSub ), zero ) );
+        sums[2] = _mm_add_epi64(
+            sums[2], _mm_sad_epu8( absSignedBytes( vUp ), zero ) );
+        sums[3] = _mm_add_epi64(
+            sums[3], _mm_sad_epu8( absSignedBytes( vAvg ), zero ) );
+        sums[4] = _mm_add_epi64(
+            sums[4], _mm_sad_epu8( absSignedBytes( vPaeth ), zero ) );
+        }
+
+    for( int f=0; f<5; f++ ) {
+        // one sum in each 64-bit half
+        scores[f] +=
+            _mm_cvtsi128_si32( sums[f] ) +
+            _mm_cvtsi128_si32( _mm_srli_si128( sums[f], 8 ) );
+        }
+#endif
+
+    for( ; i<n; i++ ) {
+        unsigned char a = x[ i - bpp ];
+        unsigned char c = b[ i - bpp ];
+
+        sub[i] = x[i] - a;
+        up[i] = x[i] - b[i];
+        avg[i] = x[i] - ( ( a + b[i] ) >> 1 );
+        paeth[i] = x[i] - paethPredictor( a, b[i], c );
+
+        scores[0] += absSigned( x[i] );
+        scores[1] += absSigned( sub[i] );
+        scores[2] += absSigned( up[i] );
+        scores[3] += absSigned( avg[i] );
+        scores[4] += absSigned( paeth[i] );
+        }
+
+
+    // ties go to the simpler filter
+    int best = 0;
+    for( int f=1; f<5; f++ ) {
+        if( scores[f] < scores[best] ) {
+            best = f;
+            }
+        }
+
+    outFiltered[0] = (unsigned char)best;
+
+    if( best == 0 ) {
+        memcpy( &( outFiltered[1] ), x, n );
+        }
+    else {
+        memcpy( &( outFiltered[1] ), &( inScratch[ ( best - 1 ) * n ] ), n );
+        }
+    }
@@ -0,0 +1,102 @@
+#ifndef PNG_WRITER_INCLUDED
+#define PNG_WRITER_INCLUDED
+
+
+#include "minorGems/io/OutputStream.h"
+#include "minorGems/system/ThreadPool.h"
+
+
+
+/**
+ * Writes 8-bit RGB or RGBA PNG files from raw bytes, without libpng,
+ * spreading the work over worker threads.
+ *
+ * Rows are cut into strips that are filtered and deflated independently,
+ * each strip ending on a byte boundary with a sync flush, so that the
+ * strips concatenate into one zlib stream.  The stream's Adler-32 is
+ * combined from the strips' checksums, and each strip becomes one IDAT
+ * chunk.  Each row gets the filter with the smallest sum of absolute
+ * differences, as libpng picks, scored with SSE2 where available.
+ *
+ * One writer can be used from several threads at once.
+ */
+class PNGWriter {
+
+    public:
+
+        /**
+         * Constructs a writer.
+         *
+         * @param inMaxCompression false for fast writing, such as for
+         *   screenshots (zlib level 3, small strips), or true for the
+         *   smallest files, such as for shipping assets (slowest level,
+         *   large strips).  Defaults to false.
+         * @param inNumThreads the number of worker threads, -1 for one
+         *   per CPU, or 1 to do all work on the calling thread.
+         *   Defaults to -1.
+         */
+        PNGWriter( char inMaxCompression = false, int inNumThreads = -1 );
+
+
+        ~PNGWriter();
+
+
+        // overrides the mode's level, from 0 (stored) to 9, or 10 for
+        // miniz's slowest, smallest setting
+        void setCompressionLevel( int inLevel );
+
+
+        // overrides the mode's strip size, in bytes of row data
+        // smaller strips spread work over more threads, but cost a few
+        // bytes each and can't match data across strip boundaries
+        void setStripBytes( int inBytes );
+
+
+        /**
+         * Encodes raw 8-bit-per-channel bytes.
+         *
+         * Blocks until the whole file is written.
+         *
+         * @param inBytes the pixel bytes, RGB or RGBA interleaved.
+         *   Destroyed by caller.
+         * @param inNumChannels 3 for an RGB PNG, or 4 for RGBA.
+         * @param inBottomUp true if the bottom row comes first in inBytes
+         *   (as read back from OpenGL).
+         * @param inStream the stream to write to.  Destroyed by caller.
+         */
+        void formatBytes( unsigned char *inBytes,
+                          int inWidth, int inHeight,
+                          int inNumChannels, char inBottomUp,
+                          OutputStream *inStream );
+
+
+        /**
+         * Filters one row with the filter that scores best.
+         *
+         * @param inRow the row's bytes.
+         * @param inPrevRow the row above, or all zeros for the first row.
+         * @param inRowLength the number of bytes in each row.
+         * @param inBytesPerPixel 3 or 4.
+         * @param outFiltered inRowLength + 1 bytes, filled with the filter
+         *   type followed by the filtered row.
+         * @param inScratch 4 * inRowLength bytes of scratch space.
+         */
+        static void filterRow( unsigned char *inRow, unsigned char *inPrevRow,
+                               int inRowLength, int inBytesPerPixel,
+                               unsigned char *outFiltered,
+                               unsigned char *inScratch );
+
+
+
+    protected:
+
+        int mCompressionLevel;
+        int mStripBytes;
+
+        // NULL if all work is done on the calling thread
+        ThreadPool *mPool;
+    };
+
+
+
+#endif
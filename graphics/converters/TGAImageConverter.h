@@ -21,6 +21,14 @@
 
 
 #include <math.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
 
 
 #include "LittleEndianImageConverter.h"
@@ -28,11 +36,23 @@
 #include "minorGems/graphics/RawRGBAImage.h"
 
 
+// fields of the 18-byte TGA header that decoding needs
+typedef struct TGAHeaderInfo {
+        int idLength;
+        int width;
+        int height;
+        int numChannels;
+        char runLengthEncoded;
+        char originAtTop;
+    } TGAHeaderInfo;
+
+
+
 /**
  * TGA (Targa) implementation of the image conversion interface.
  *
  * Note that it only supports 24- and 32-bit TGA files
- * (and thus only 3- and 4-channel Images).
+ * (and thus only 3- and 4-channel Images), raw or run-length encoded.
  *
  * TGA format information taken from:
  * http://www.cubic.org/source/archive/fileform/graphic/tga/targa.txt
@@ -51,6 +71,82 @@ class TGAImageConverter : public LittleEndianImageConverter {
 
 		virtual RawRGBAImage *deformatImageRaw( InputStream *inStream );
 
+
+        /**
+         * Encodes raw 8-bit-per-channel bytes directly, skipping the
+         * conversion to and from an Image.
+         *
+         * @param inBytes the pixel bytes, RGB or RGBA interleaved.
+         *   Destroyed by caller.
+         * @param inNumChannels 3 or 4.
+         * @param inBottomUp true if the bottom row comes first in inBytes
+         *   (as read back from OpenGL).  Rows are written as-is either way,
+         *   with the origin bit in the header set to match.
+         * @param inStream the stream to write to.  Destroyed by caller.
+         */
+        void formatBytes( unsigned char *inBytes,
+                          int inWidth, int inHeight,
+                          int inNumChannels, char inBottomUp,
+                          OutputStream *inStream,
+                          char inRunLengthEncode = false );
+
+
+        /**
+         * Decodes a whole TGA file held in memory, such as a mapped file
+         * or an asset archive view, converting rows straight from the
+         * buffer into the result.
+         *
+         * @param inData the file contents.  Destroyed by caller.
+         * @param inLength the length of inData.
+         *
+         * @return the image, in RGB(A) order with the top row first, or
+         *   NULL if the file is unsupported or truncated.
+         */
+        static RawRGBAImage *deformatBytes( unsigned char *inData,
+                                            int inLength );
+
+
+        /**
+         * Swaps the first and third byte of each pixel, converting
+         * between BGR(A) and RGB(A).
+         *
+         * @param inSource the pixels to convert.
+         * @param outDest where converted pixels go.  Can be inSource.
+         * @param inNumPixels the number of pixels.
+         * @param inNumChannels 3 or 4.
+         */
+        static void swapRedBlue( unsigned char *inSource,
+                                 unsigned char *outDest,
+                                 int inNumPixels, int inNumChannels );
+
+
+    protected:
+
+        // returns false and prints why if file can't be read
+        static char parseHeader( unsigned char *inHeader,
+                                 TGAHeaderInfo *outInfo );
+
+        // decodes run-length packets into BGR(A) pixels in file row order,
+        // starting at pixel *ioNumDone and stopping at the first packet
+        // not wholly in inData
+        // returns number of bytes of inData used, or -1 if malformed
+        static int decodeRunLength( unsigned char *inData, int inLength,
+                                    unsigned char *outRaster,
+                                    int inNumPixels, int inNumChannels,
+                                    int *ioNumDone );
+
+        // converts decoded BGR(A) rows to RGB(A) in place, flipping them
+        // if needed
+        static void finishRaster( unsigned char *ioRaster,
+                                  int inWidth, int inHeight,
+                                  int inNumChannels, char inFlip );
+
+        // appends one row, already in BGR(A) order, as run-length packets
+        // returns number of bytes added to outPackets
+        static int encodeRunLength( unsigned char *inRow, int inWidth,
+                                    int inNumChannels,
+                                    unsigned char *outPackets );
+
 	};
 
 
@@ -196,140 +292,489 @@ inline void TGAImageConverter::formatImage( Image *inImage,
 
 
 
-inline RawRGBAImage *TGAImageConverter::deformatImageRaw( 
-    InputStream *inStream ) {
+inline void TGAImageConverter::formatBytes( unsigned char *inBytes,
+                                            int inWidth, int inHeight,
+                                            int inNumChannels,
+                                            char inBottomUp,
+                                            OutputStream *inStream,
+                                            char inRunLengthEncode ) {
+
+	if( inNumChannels != 3 &&
+		inNumChannels != 4 ) {
+		printf( "Only 3- and 4-channel images can be converted to " );
+		printf( "the TGA format.\n" );
+		return;
+		}
+
+    // same header that formatImage writes, all at once
+    unsigned char header[18];
+    memset( header, 0, 18 );
+
+    // unmapped RGB image, or same run-length encoded
+    if( inRunLengthEncode ) {
+        header[2] = 10;
+        }
+    else {
+        header[2] = 2;
+        }
+
+    header[12] = inWidth & 0xFF;
+    header[13] = ( inWidth >> 8 ) & 0xFF;
+    header[14] = inHeight & 0xFF;
+    header[15] = ( inHeight >> 8 ) & 0xFF;
+
+    if( inNumChannels == 3 ) {
+        header[16] = 24;
+        header[17] = 0;
+        }
+    else {
+        header[16] = 32;
+        // 8 alpha bits per pixel
+        header[17] = 8;
+        }
+
+    if( ! inBottomUp ) {
+        // bit 5 for screen origin in upper left corner
+        header[17] = header[17] | ( 1 << 5 );
+        }
+
+    inStream->write( header, 18 );
+
+
+    // swap to BGR(A) order a row at a time
+    int rowLength = inWidth * inNumChannels;
     
-    // a buffer for reading single bytes
-	unsigned char *byteBuffer = new unsigned char[1];
+    unsigned char *row = new unsigned char[ rowLength ];
+
+    // at worst, a packet header for every pixel
+    unsigned char *packets = NULL;
+    if( inRunLengthEncode ) {
+        packets = new unsigned char[ rowLength + inWidth ];
+        }
 
-	// read the identification field size
-	inStream->read( byteBuffer, 1 );
+    for( int y=0; y<inHeight; y++ ) {
+        swapRedBlue( &( inBytes[ y * rowLength ] ), row, 
+                     inWidth, inNumChannels );
 
-	int identificationFieldSize = byteBuffer[0];
-		
-	// read the color map type
-	// (only 0, or no color map, is supported)
-	inStream->read( byteBuffer, 1 );
-	if( byteBuffer[0] != 0 ) {
+        if( inRunLengthEncode ) {
+            // packets don't cross rows, as the format asks
+            int numPacketBytes = 
+                encodeRunLength( row, inWidth, inNumChannels, packets );
+            
+            inStream->write( packets, numPacketBytes );
+            }
+        else {
+            inStream->write( row, rowLength );
+            }
+        }
+    
+    delete [] row;
+
+    if( packets != NULL ) {
+        delete [] packets;
+        }
+    }
+
+
+
+inline int TGAImageConverter::encodeRunLength( unsigned char *inRow, 
+                                               int inWidth,
+                                               int inNumChannels,
+                                               unsigned char *outPackets ) {
+    int c = inNumChannels;
+    int numBytes = 0;
+
+    int x = 0;
+    
+    while( x < inWidth ) {
+        
+        int runLength = 1;
+        while( x + runLength < inWidth && runLength < 128 &&
+               memcmp( &( inRow[ x * c ] ), 
+                       &( inRow[ ( x + runLength ) * c ] ), c ) == 0 ) {
+            runLength++;
+            }
+
+        if( runLength > 1 ) {
+            outPackets[ numBytes++ ] = 
+                (unsigned char)( 0x80 | ( runLength - 1 ) );
+            memcpy( &( outPackets[ numBytes ] ), &( inRow[ x * c ] ), c );
+            numBytes += c;
+            
+            x += runLength;
+            }
+        else {
+            // raw pixels, up to where next run starts
+            int start = x;
+            int count = 0;
+            
+            while( x < inWidth && count < 128 ) {
+                if( x + 1 < inWidth &&
+                    memcmp( &( inRow[ x * c ] ), 
+                            &( inRow[ ( x + 1 ) * c ] ), c ) == 0 ) {
+                    break;
+                    }
+                x++;
+                count++;
+                }
+
+            outPackets[ numBytes++ ] = (unsigned char)( count - 1 );
+            memcpy( &( outPackets[ numBytes ] ), &( inRow[ start * c ] ),
+                    count * c );
+            numBytes += count * c;
+            }
+        }
+    
+    return numBytes;
+    }
+
+
+
+inline void TGAImageConverter::swapRedBlue( unsigned char *inSource,
+                                            unsigned char *outDest,
+                                            int inNumPixels, 
+                                            int inNumChannels ) {
+    int numBytes = inNumPixels * inNumChannels;
+    
+    int i = 0;
+
+#ifdef __SSE2__
+    if( inNumChannels == 4 ) {
+        // 4 pixels at a time, moving red and blue within each 32-bit pixel
+        __m128i redBlueMask = _mm_set1_epi32( 0x00FF00FF );
+
+        for( ; i + 16 <= numBytes; i += 16 ) {
+            __m128i v = _mm_loadu_si128( (__m128i *)&( inSource[i] ) );
+
+            __m128i redBlue = _mm_and_si128( v, redBlueMask );
+            __m128i greenAlpha = _mm_andnot_si128( redBlueMask, v );
+            
+            redBlue = _mm_or_si128( _mm_slli_epi32( redBlue, 16 ),
+                                    _mm_srli_epi32( redBlue, 16 ) );
+            
+            _mm_storeu_si128( (__m128i *)&( outDest[i] ),
+                              _mm_or_si128( greenAlpha, redBlue ) );
+            }
+        }
+#endif
+#ifdef __SSSE3__
+    if( inNumChannels == 3 ) {
+        // 5 pixels per 16 bytes, with 16th byte written back unchanged,
+        // and then rewritten as first byte of the next 5
+        __m128i shuffle = _mm_setr_epi8( 2, 1, 0,  5, 4, 3,  8, 7, 6,
+                                         11, 10, 9,  14, 13, 12,  15 );
+
+        for( ; i + 16 <= numBytes; i += 15 ) {
+            __m128i v = _mm_loadu_si128( (__m128i *)&( inSource[i] ) );
+            
+            _mm_storeu_si128( (__m128i *)&( outDest[i] ),
+                              _mm_shuffle_epi8( v, shuffle ) );
+            }
+        }
+#endif
+
+    for( ; i < numBytes; i += inNumChannels ) {
+        unsigned char blue = inSource[i];
+        
+        outDest[i] = inSource[ i + 2 ];
+        outDest[ i + 1 ] = inSource[ i + 1 ];
+        outDest[ i + 2 ] = blue;
+
+        if( inNumChannels == 4 ) {
+            outDest[ i + 3 ] = inSource[ i + 3 ];
+            }
+        }
+    }
+
+
+
+inline char TGAImageConverter::parseHeader( unsigned char *inHeader,
+                                            TGAHeaderInfo *outInfo ) {
+    outInfo->idLength = inHeader[0];
+
+	// only 0, or no color map, is supported
+    if( inHeader[1] != 0 ) {
 		printf( "Only TGA files without colormaps can be read.\n" );
-		delete [] byteBuffer;
-		return NULL;
+		return false;
 		}
 	
-	// read the image type code
-	// (only type 2, unmapped RGB image, is supported)
-	inStream->read( byteBuffer, 1 );
-	if( byteBuffer[0] != 2 ) {
+	// only type 2, unmapped RGB image, or type 10, the same run-length 
+    // encoded, is supported
+	if( inHeader[2] != 2 && inHeader[2] != 10 ) {
 		printf(
 			"Only TGA files containing unmapped RGB images can be read.\n" );
-		delete [] byteBuffer;
-		return NULL;
+		return false;
 		}
-	
-	
-	// ignore color map spec
-	// (skip all 5 bytes of it)
-	unsigned char *colorMapSpec = new unsigned char[5];
-	inStream->read( colorMapSpec, 5 );
-	delete [] colorMapSpec;
+    outInfo->runLengthEncoded = ( inHeader[2] == 10 );
 
+    // skip color map spec and x, y origin
+    outInfo->width = inHeader[12] | ( inHeader[13] << 8 );
+    outInfo->height = inHeader[14] | ( inHeader[15] << 8 );
+    
+	if( inHeader[16] != 24 && inHeader[16] != 32 ) {
+		printf( "Only 24- and 32-bit TGA files can be read.\n" );
+		return false;
+		}
+    outInfo->numChannels = inHeader[16] / 8;
 
-	// now for the image specification
+	// bit 5 of image descriptor set for screen origin in upper left corner
+    outInfo->originAtTop = ( ( inHeader[17] & ( 1 << 5 ) ) != 0 );
 
-    // don't need either of these
-    // don't set to a variable for now to avoid unused variable warnings
-	// x origin coordinate
-	readLittleEndianShort( inStream );
-	// y origin coordinate
-	readLittleEndianShort( inStream );
-	
-	long width = readLittleEndianShort( inStream );
-	long height = readLittleEndianShort( inStream );
+    return true;
+    }
 
-	long numPixels = width * height;
 
-	
-	// number of bits in pixels
-	// only 24 bits per pixel supported
-	
-	inStream->read( byteBuffer, 1 );
-	if( byteBuffer[0] != 24 && byteBuffer[0] != 32 ) {
-		printf( "Only 24- and 32-bit TGA files can be read.\n" );
-		delete [] byteBuffer;
-		return NULL;
-		}
 
-	int numChannels = 0;
-	if( byteBuffer[0] == 24 ) {
-		numChannels = 3;
-		}
-	else {
-		numChannels = 4;
-		}
-	
-	
-	// image descriptor byte
-	// setting to 0 specifies:
-	// -- no attributes per pixel (for 24-bit)
-	// -- screen origin in lower left corner
-	// -- non-interleaved data storage
-	// set bit 5 to 1 to specify screen origin in upper left corner
-	inStream->read( byteBuffer, 1 );
-	char originAtTop = byteBuffer[0] & ( 1 << 5 );
+inline int TGAImageConverter::decodeRunLength( unsigned char *inData,
+                                               int inLength,
+                                               unsigned char *outRaster,
+                                               int inNumPixels,
+                                               int inNumChannels,
+                                               int *ioNumDone ) {
+    int c = inNumChannels;
 
-	
-	if( identificationFieldSize > 0 ) {
+    int pos = 0;
+    int p = *ioNumDone;
+    
+    while( p < inNumPixels && pos < inLength ) {
+        int packet = inData[ pos ];
+        int count = ( packet & 0x7F ) + 1;
+
+        if( count > inNumPixels - p ) {
+            return -1;
+            }
+        
+        unsigned char *dest = &( outRaster[ p * c ] );
+
+        if( packet & 0x80 ) {
+            // one pixel repeated
+            if( pos + 1 + c > inLength ) {
+                break;
+                }
+            unsigned char *pixel = &( inData[ pos + 1 ] );
+            
+            for( int i=0; i<count; i++ ) {
+                memcpy( dest, pixel, c );
+                dest += c;
+                }
+            pos += 1 + c;
+            }
+        else {
+            int numBytes = count * c;
+            
+            if( pos + 1 + numBytes > inLength ) {
+                break;
+                }
+            memcpy( dest, &( inData[ pos + 1 ] ), numBytes );
+            pos += 1 + numBytes;
+            }
+        
+        p += count;
+        }
+
+    *ioNumDone = p;
+    
+    return pos;
+    }
+
+
+
+inline void TGAImageConverter::finishRaster( unsigned char *ioRaster,
+                                             int inWidth, int inHeight,
+                                             int inNumChannels, 
+                                             char inFlip ) {
+    if( ! inFlip ) {
+        swapRedBlue( ioRaster, ioRaster, inWidth * inHeight, 
+                     inNumChannels );
+        return;
+        }
+
+    // swap and convert rows in pairs, in one pass
+    int lineBytes = inWidth * inNumChannels;
+
+    unsigned char *temp = new unsigned char[ lineBytes ];
+    
+    for( int y=0; y < inHeight / 2; y++ ) {
+        unsigned char *top = &( ioRaster[ y * lineBytes ] );
+        unsigned char *bottom = 
+            &( ioRaster[ ( inHeight - y - 1 ) * lineBytes ] );
+        
+        swapRedBlue( top, temp, inWidth, inNumChannels );
+        swapRedBlue( bottom, top, inWidth, inNumChannels );
+        memcpy( bottom, temp, lineBytes );
+        }
+    
+    if( inHeight % 2 == 1 ) {
+        unsigned char *middle = &( ioRaster[ ( inHeight / 2 ) * lineBytes ] );
+        swapRedBlue( middle, middle, inWidth, inNumChannels );
+        }
+    
+    delete [] temp;
+    }
+
+
+
+inline RawRGBAImage *TGAImageConverter::deformatBytes( unsigned char *inData,
+                                                       int inLength ) {
+    TGAHeaderInfo info;
+    
+    if( inLength < 18 ) {
+        printf( "TGA file too short for header.\n" );
+        return NULL;
+        }
+    if( ! parseHeader( inData, &info ) ) {
+        return NULL;
+        }
+
+    int w = info.width;
+    int h = info.height;
+    int c = info.numChannels;
+    int numPixels = w * h;
+    int lineBytes = w * c;
+
+    // skip identification field, and color map, which we don't have
+    int pos = 18 + info.idLength;
+    
+    unsigned char *data = &( inData[ pos ] );
+    int dataLength = inLength - pos;
+    
+    if( dataLength < 0 ) {
+        dataLength = 0;
+        }
+
+
+    unsigned char *raster = new unsigned char[ numPixels * c ];
+
+    if( ! info.runLengthEncoded ) {
+        if( dataLength < numPixels * c ) {
+            printf( "TGA file truncated.\n" );
+            delete [] raster;
+            return NULL;
+            }
+        
+        // convert each row straight to where it belongs
+        for( int y=0; y<h; y++ ) {
+            int destY = y;
+            if( ! info.originAtTop ) {
+                destY = h - y - 1;
+                }
+            swapRedBlue( &( data[ y * lineBytes ] ), 
+                         &( raster[ destY * lineBytes ] ), w, c );
+            }
+        }
+    else {
+        int numDone = 0;
+        
+        if( decodeRunLength( data, dataLength, raster, numPixels, c,
+                             &numDone ) < 0 ||
+            numDone < numPixels ) {
+            printf( "TGA run-length data truncated or malformed.\n" );
+            delete [] raster;
+            return NULL;
+            }
+        
+        finishRaster( raster, w, h, c, ! info.originAtTop );
+        }
+
+    return new RawRGBAImage( raster, w, h, c );
+    }
+
+
+
+
+inline RawRGBAImage *TGAImageConverter::deformatImageRaw( 
+    InputStream *inStream ) {
+    
+    // whole header at once
+    unsigned char header[18];
+
+    if( inStream->read( header, 18 ) != 18 ) {
+        printf( "TGA file too short for header.\n" );
+        return NULL;
+        }
+
+    TGAHeaderInfo info;
+    
+    if( ! parseHeader( header, &info ) ) {
+        return NULL;
+        }
+    
+	if( info.idLength > 0 ) {
 		// We skip the image identification field
-		unsigned char *identificationField =
-			new unsigned char[ identificationFieldSize ];
-		inStream->read( identificationField, identificationFieldSize );
-		delete [] identificationField;
+		unsigned char identificationField[ 255 ];
+		inStream->read( identificationField, info.idLength );
 		}
 	
-	
 	// We also skip the color map data,
 	// since we have none (as specified above).
 
+    int w = info.width;
+    int h = info.height;
+    int c = info.numChannels;
+    int numPixels = w * h;
+    int lineBytes = w * c;
 
-	
-	
-	// now we read the pixels, in BGR(A) order
-	unsigned char *raster = new unsigned char[ numPixels * numChannels ];
-	inStream->read( raster, numPixels * numChannels );
-
-    if( !originAtTop ) {
 
-        // flip it
-        unsigned char *flippedRaster = 
-            new unsigned char[ numPixels * numChannels ];
-        
-
-        int lineBytes = width * numChannels;
+	// now we read the pixels, in BGR(A) order
+	unsigned char *raster = new unsigned char[ numPixels * c ];
 
-        for( int y=0; y<height; y++ ) {
-            memcpy( &( flippedRaster[lineBytes * y] ),
-                    &( raster[ lineBytes * ( height - y - 1 ) ] ),
-                    lineBytes );
+    if( ! info.runLengthEncoded ) {
+        if( info.originAtTop ) {
+            inStream->read( raster, numPixels * c );
+            }
+        else {
+            // read each row straight to where it belongs, instead of
+            // flipping a second copy
+            for( int y=0; y<h; y++ ) {
+                inStream->read( &( raster[ ( h - y - 1 ) * lineBytes ] ),
+                                lineBytes );
+                }
             }
         
-        delete [] raster;
-        raster = flippedRaster;
+        swapRedBlue( raster, raster, numPixels, c );
         }
-    
-    // convert to RGB(A) order
-    int numBytes = numPixels * numChannels;
-    int r = 2;
-    for( int b=0; b<numBytes; b+= numChannels ) {
-        unsigned char temp = raster[b];
+    else {
+        // compressed length unknown, so decode through a buffer, keeping
+        // any partial packet at the end for the next read
+        int bufferSize = 65536;
+        unsigned char *buffer = new unsigned char[ bufferSize ];
         
-        raster[b] = raster[r];
-        raster[r] = temp;
+        int numBuffered = 0;
+        int numDone = 0;
+        char failed = false;
         
-        r += numChannels;
+        while( numDone < numPixels ) {
+            int numRead = (int)inStream->read( &( buffer[ numBuffered ] ),
+                                               bufferSize - numBuffered );
+            if( numRead <= 0 ) {
+                failed = true;
+                break;
+                }
+            numBuffered += numRead;
+
+            int numUsed = decodeRunLength( buffer, numBuffered, raster,
+                                           numPixels, c, &numDone );
+            if( numUsed < 0 ) {
+                failed = true;
+                break;
+                }
+            
+            numBuffered -= numUsed;
+            memmove( buffer, &( buffer[ numUsed ] ), numBuffered );
+            }
+        
+        delete [] buffer;
+
+        if( failed ) {
+            printf( "TGA run-length data truncated or malformed.\n" );
+            delete [] raster;
+            return NULL;
+            }
+
+        finishRaster( raster, w, h, c, ! info.originAtTop );
         }
 
-    delete [] byteBuffer;
-    return new RawRGBAImage( raster, width, height, numChannels );
+    return new RawRGBAImage( raster, w, h, c );
     }
 
 
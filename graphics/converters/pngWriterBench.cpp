@@ -0,0 +1,353 @@
+// Test and benchmark for the multi-threaded PNGWriter
+//
+// Usage:  pngWriterBench [numThreads]
+//
+// Checks that PNGWriter's files decode (through libpng) to the bytes they
+// were written from, for 3- and 4-channel images, top-down and bottom-up,
+// widths that don't fill a whole SIMD register, one-row strips, and the
+// fast, max and level-0 settings.  Checks combined Adler-32 values against
+// zlib.
+//
+// Then times and sizes the current libpng path (PNGImageConverter) against
+// PNGWriter's fast and max modes, on a screenshot-like and a sprite-like
+// image.
+
+
+#include "minorGems/graphics/converters/PNGWriter.h"
+#include "minorGems/graphics/converters/PNGImageConverter.h"
+#include "minorGems/util/adler32.h"
+#include "minorGems/system/Time.h"
+
+#include <png.h>
+#include <zlib.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+
+static int numFailed = 0;
+
+
+static void check( char inPassed, const char *inWhat ) {
+    if( ! inPassed ) {
+        printf( "FAILED:  %s\n", inWhat );
+        numFailed++;
+        }
+    }
+
+
+
+// appends whole buffers, so stream overhead doesn't swamp the timings
+class MemoryOutputStream : public OutputStream {
+    public:
+
+        MemoryOutputStream()
+                : mBytes( NULL ), mLength( 0 ), mAllocated( 0 ) {
+            }
+
+        ~MemoryOutputStream() {
+            if( mBytes != NULL ) {
+                free( mBytes );
+                }
+            }
+
+        long write( unsigned char *inBuffer, long inNumBytes ) {
+            if( mLength + inNumBytes > mAllocated ) {
+                mAllocated = 2 * ( mLength + inNumBytes );
+                mBytes = (unsigned char *)realloc( mBytes, mAllocated );
+                }
+            memcpy( &( mBytes[ mLength ] ), inBuffer, inNumBytes );
+            mLength += inNumBytes;
+            return inNumBytes;
+            }
+
+        // destroyed by caller
+        unsigned char *getBytes( int *outNumBytes ) {
+            unsigned char *bytes = new unsigned char[ mLength ];
+            memcpy( bytes, mBytes, mLength );
+            *outNumBytes = (int)mLength;
+            return bytes;
+            }
+
+    protected:
+        unsigned char *mBytes;
+        long mLength;
+        long mAllocated;
+    };
+
+
+
+static unsigned int randState = 12345;
+
+static int randInt( int inMin, int inMax ) {
+    randState = randState * 1103515245 + 12345;
+    return inMin + (int)( ( randState >> 8 ) % ( inMax - inMin + 1 ) );
+    }
+
+
+
+// smooth gradients with flat panels and a little noise, like a game screen
+// alpha, if any, is solid inside blobs and clear outside, like a sprite
+static unsigned char *makeBytes( int inWidth, int inHeight,
+                                 int inNumChannels ) {
+    unsigned char *bytes =
+        new unsigned char[ inWidth * inHeight * inNumChannels ];
+
+    for( int y=0; y<inHeight; y++ ) {
+        for( int x=0; x<inWidth; x++ ) {
+            unsigned char *p =
+                &( bytes[ ( y * inWidth + x ) * inNumChannels ] );
+
+            if( ( x / 64 + y / 48 ) % 5 == 0 ) {
+                // flat panel
+                p[0] = 40;
+                p[1] = 60;
+                p[2] = 90;
+                }
+            else {
+                int noise = randInt( 0, 3 );
+                p[0] = (unsigned char)( x * 255 / inWidth + noise );
+                p[1] = (unsigned char)( y * 255 / inHeight + noise );
+                p[2] = (unsigned char)( ( x + y ) / 4 + noise );
+                }
+
+            if( inNumChannels == 4 ) {
+                int dx = x % 128 - 64;
+                int dy = y % 128 - 64;
+                if( dx * dx + dy * dy < 50 * 50 ) {
+                    p[3] = 255;
+                    }
+                else {
+                    p[3] = 0;
+                    }
+                }
+            }
+        }
+
+    return bytes;
+    }
+
+
+
+// returns decoded bytes, top row first, or NULL on failure
+static unsigned char *decodePNG( unsigned char *inData, int inLength,
+                                 int inWidth, int inHeight,
+                                 int inNumChannels ) {
+    png_image image;
+    memset( &image, 0, sizeof( image ) );
+    image.version = PNG_IMAGE_VERSION;
+
+    if( ! png_image_begin_read_from_memory( &image, inData, inLength ) ) {
+        return NULL;
+        }
+
+    if( (int)image.width != inWidth || (int)image.height != inHeight ) {
+        png_image_free( &image );
+        return NULL;
+        }
+
+    if( inNumChannels == 3 ) {
+        image.format = PNG_FORMAT_RGB;
+        }
+    else {
+        image.format = PNG_FORMAT_RGBA;
+        }
+
+    unsigned char *bytes =
+        new unsigned char[ inWidth * inHeight * inNumChannels ];
+
+    if( ! png_image_finish_read( &image, NULL, bytes, 0, NULL ) ) {
+        delete [] bytes;
+        return NULL;
+        }
+
+    return bytes;
+    }
+
+
+
+static unsigned char *writeWith( PNGWriter *inWriter, unsigned char *inBytes,
+                                 int inWidth, int inHeight,
+                                 int inNumChannels, char inBottomUp,
+                                 int *outLength ) {
+    MemoryOutputStream stream;
+    inWriter->formatBytes( inBytes, inWidth, inHeight, inNumChannels,
+                           inBottomUp, &stream );
+    return stream.getBytes( outLength );
+    }
+
+
+
+static void checkRoundTrip( PNGWriter *inWriter,
+                            int inWidth, int inHeight,
+                            int inNumChannels, char inBottomUp,
+                            const char *inWhat ) {
+    unsigned char *bytes = makeBytes( inWidth, inHeight, inNumChannels );
+
+    int length;
+    unsigned char *png = writeWith( inWriter, bytes, inWidth, inHeight,
+                                    inNumChannels, inBottomUp, &length );
+
+    unsigned char *decoded = decodePNG( png, length, inWidth, inHeight,
+                                        inNumChannels );
+
+    char same = ( decoded != NULL );
+
+    int rowLength = inWidth * inNumChannels;
+
+    for( int y=0; y<inHeight && same; y++ ) {
+        int sourceRow = y;
+        if( inBottomUp ) {
+            sourceRow = inHeight - 1 - y;
+            }
+        if( memcmp( &( decoded[ y * rowLength ] ),
+                    &( bytes[ sourceRow * rowLength ] ), rowLength ) != 0 ) {
+            same = false;
+            }
+        }
+
+    check( same, inWhat );
+
+    if( decoded != NULL ) {
+        delete [] decoded;
+        }
+    delete [] png;
+    delete [] bytes;
+    }
+
+
+
+static void checkAdler() {
+    int length = 100000;
+    unsigned char *data = new unsigned char[ length ];
+    for( int i=0; i<length; i++ ) {
+        data[i] = (unsigned char)randInt( 0, 255 );
+        }
+
+    unsigned int whole = adler32( 1, data, length );
+
+    int splits[4] = { 0, 1, 65521, 99999 };
+
+    for( int s=0; s<4; s++ ) {
+        int split = splits[s];
+
+        unsigned int a = adler32( 1, data, split );
+        unsigned int b = adler32( 1, &( data[ split ] ), length - split );
+
+        check( adler32Combine( a, b, length - split ) == whole,
+               "adler32Combine matches zlib" );
+        }
+
+    delete [] data;
+    }
+
+
+
+static void bench( const char *inName, int inWidth, int inHeight,
+                   int inNumChannels, int inNumThreads ) {
+    unsigned char *bytes = makeBytes( inWidth, inHeight, inNumChannels );
+
+    int reps = 5;
+
+    printf( "\n%s, %dx%d, %d channels:\n",
+            inName, inWidth, inHeight, inNumChannels );
+
+    int levels[2] = { 5, 9 };
+
+    for( int l=0; l<2; l++ ) {
+        PNGImageConverter converter( levels[l] );
+
+        int length = 0;
+        double start = Time::getCurrentTime();
+        for( int r=0; r<reps; r++ ) {
+            MemoryOutputStream stream;
+            converter.formatBytes( bytes, inWidth, inHeight, inNumChannels,
+                                   true, &stream );
+            unsigned char *png = stream.getBytes( &length );
+            delete [] png;
+            }
+        double msPer = 1000 * ( Time::getCurrentTime() - start ) / reps;
+
+        printf( "  libpng level %d:     %7.1f ms  %9d bytes\n",
+                levels[l], msPer, length );
+        }
+
+    for( int m=0; m<2; m++ ) {
+        PNGWriter writer( m, inNumThreads );
+
+        int length = 0;
+        double start = Time::getCurrentTime();
+        for( int r=0; r<reps; r++ ) {
+            unsigned char *png = writeWith( &writer, bytes,
+                                            inWidth, inHeight,
+                                            inNumChannels, true, &length );
+            delete [] png;
+            }
+        double msPer = 1000 * ( Time::getCurrentTime() - start ) / reps;
+
+        const char *modeName = "fast";
+        if( m ) {
+            modeName = "max ";
+            }
+
+        printf( "  PNGWriter %s:     %7.1f ms  %9d bytes\n",
+                modeName, msPer, length );
+        }
+
+    delete [] bytes;
+    }
+
+
+
+int main( int inNumArgs, char **inArgs ) {
+
+    int numThreads = -1;
+
+    if( inNumArgs > 1 ) {
+        numThreads = atoi( inArgs[1] );
+        }
+
+
+    checkAdler();
+
+    PNGWriter fastWriter( false, numThreads );
+    PNGWriter maxWriter( true, numThreads );
+    PNGWriter inlineWriter( false, 1 );
+
+    PNGWriter tinyStripWriter( false, numThreads );
+    tinyStripWriter.setStripBytes( 1 );
+
+    PNGWriter storedWriter( false, numThreads );
+    storedWriter.setCompressionLevel( 0 );
+
+    for( int c=3; c<=4; c++ ) {
+        checkRoundTrip( &fastWriter, 640, 480, c, false, "fast round trip" );
+        checkRoundTrip( &fastWriter, 640, 480, c, true,
+                        "fast bottom-up round trip" );
+        checkRoundTrip( &maxWriter, 640, 480, c, true, "max round trip" );
+        checkRoundTrip( &inlineWriter, 333, 207, c, true,
+                        "single-thread round trip" );
+        checkRoundTrip( &tinyStripWriter, 37, 29, c, false,
+                        "one-row strips round trip" );
+        checkRoundTrip( &storedWriter, 129, 65, c, true,
+                        "stored round trip" );
+        checkRoundTrip( &fastWriter, 1, 1, c, false, "1x1 round trip" );
+        checkRoundTrip( &fastWriter, 5, 300, c, false,
+                        "narrow round trip" );
+        }
+
+    if( numFailed > 0 ) {
+        printf( "%d checks failed\n", numFailed );
+        return 1;
+        }
+
+    printf( "All checks passed\n" );
+
+
+    bench( "Screenshot", 1920, 1080, 3, numThreads );
+    bench( "Sprite sheet", 1024, 1024, 4, numThreads );
+
+    return 0;
+    }
@@ -0,0 +1,521 @@
+// Test and benchmark for byte-native TGA and JRI conversion
+//
+// Usage:  tgaJriBench [size]
+//
+// Checks that TGA files written raw and run-length encoded, top-down and
+// bottom-up, 3- and 4-channel, decode to the bytes they were written from,
+// through a stream, from a buffer, and through the old Image path, and
+// that truncated files are refused.  Checks SSE red/blue swapping against
+// a plain loop, and JRI round trips.
+//
+// Then times decoding through an Image against decoding bytes, and
+// encoding.
+//
+// Leaves tgaJriBench_*.tga behind.
+
+
+#include "minorGems/graphics/converters/TGAImageConverter.h"
+#include "minorGems/graphics/formats/jri/jri.h"
+#include "minorGems/graphics/RGBAImage.h"
+#include "minorGems/io/file/File.h"
+#include "minorGems/io/file/FileInputStream.h"
+#include "minorGems/io/file/FileOutputStream.h"
+#include "minorGems/system/Time.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+
+static int numFailed = 0;
+
+
+static void check( char inPassed, const char *inWhat ) {
+    if( ! inPassed ) {
+        printf( "FAILED:  %s\n", inWhat );
+        numFailed++;
+        }
+    }
+
+
+
+static unsigned int randState = 12345;
+
+static int randInt( int inMin, int inMax ) {
+    randState = randState * 1103515245 + 12345;
+    return inMin + (int)( ( randState >> 8 ) % ( inMax - inMin + 1 ) );
+    }
+
+
+
+// flat patches, so run-length encoding has runs, and noisy rows between
+// if inNumColors > 0, colors come from a palette of that size
+static unsigned char *makeBytes( int inWidth, int inHeight,
+                                 int inNumChannels, int inNumColors ) {
+    int numBytes = inWidth * inHeight * inNumChannels;
+    unsigned char *bytes = new unsigned char[ numBytes ];
+
+    unsigned char palette[ 256 * 4 ];
+    for( int i=0; i<256 * 4; i++ ) {
+        palette[i] = (unsigned char)randInt( 0, 255 );
+        }
+
+    unsigned char pixel[4];
+
+    for( int p=0; p<inWidth * inHeight; p++ ) {
+        if( p % 37 == 0 || randInt( 0, 9 ) == 0 ) {
+            if( inNumColors > 0 ) {
+                memcpy( pixel, &( palette[ randInt( 0, inNumColors - 1 )
+                                           * 4 ] ), 4 );
+                }
+            else {
+                for( int c=0; c<4; c++ ) {
+                    pixel[c] = (unsigned char)randInt( 0, 255 );
+                    }
+                }
+            }
+        memcpy( &( bytes[ p * inNumChannels ] ), pixel, inNumChannels );
+        }
+
+    return bytes;
+    }
+
+
+
+static char *getFileName( int inNumChannels, char inBottomUp, char inRLE ) {
+    return autoSprintf( "tgaJriBench_%d%s%s.tga", inNumChannels,
+                        inBottomUp ? "_up" : "", inRLE ? "_rle" : "" );
+    }
+
+
+
+static void writeTGA( unsigned char *inBytes, int inWidth, int inHeight,
+                      int inNumChannels, char inBottomUp, char inRLE,
+                      const char *inFileName ) {
+    File file( NULL, inFileName );
+    FileOutputStream stream( &file );
+
+    TGAImageConverter converter;
+    converter.formatBytes( inBytes, inWidth, inHeight, inNumChannels,
+                           inBottomUp, &stream, inRLE );
+    }
+
+
+
+static RawRGBAImage *readStream( const char *inFileName ) {
+    File file( NULL, inFileName );
+    FileInputStream stream( &file );
+
+    TGAImageConverter converter;
+    return converter.deformatImageRaw( &stream );
+    }
+
+
+
+static RawRGBAImage *readBuffer( const char *inFileName ) {
+    File file( NULL, inFileName );
+
+    int length;
+    unsigned char *data = file.readFileContents( &length );
+
+    if( data == NULL ) {
+        return NULL;
+        }
+
+    RawRGBAImage *image = TGAImageConverter::deformatBytes( data, length );
+    delete [] data;
+
+    return image;
+    }
+
+
+
+// old path, through doubles
+static unsigned char *readThroughImage( const char *inFileName,
+                                        int *outNumChannels ) {
+    File file( NULL, inFileName );
+    FileInputStream stream( &file );
+
+    TGAImageConverter converter;
+    Image *image = converter.deformatImage( &stream );
+
+    if( image == NULL ) {
+        return NULL;
+        }
+
+    *outNumChannels = image->getNumChannels();
+
+    // always 4 channels
+    unsigned char *bytes = RGBAImage::getRGBABytes( image );
+    delete image;
+
+    return bytes;
+    }
+
+
+
+static char sameAs( RawRGBAImage *inImage, unsigned char *inBytes,
+                    int inWidth, int inHeight, int inNumChannels ) {
+    return inImage != NULL &&
+        (int)inImage->mWidth == inWidth &&
+        (int)inImage->mHeight == inHeight &&
+        (int)inImage->mNumChannels == inNumChannels &&
+        memcmp( inImage->mRGBABytes, inBytes,
+                inWidth * inHeight * inNumChannels ) == 0;
+    }
+
+
+
+static void checkFormats( int inWidth, int inHeight ) {
+    for( int c=3; c<=4; c++ ) {
+        unsigned char *bytes = makeBytes( inWidth, inHeight, c, 0 );
+
+        for( int bottomUp=0; bottomUp<2; bottomUp++ ) {
+            for( int rle=0; rle<2; rle++ ) {
+                char *fileName = getFileName( c, bottomUp, rle );
+
+                // bottom-up writes bottom row first, so give it flipped
+                // rows to get same image back
+                unsigned char *source = bytes;
+                if( bottomUp ) {
+                    int lineBytes = inWidth * c;
+                    source = new unsigned char[ inHeight * lineBytes ];
+                    for( int y=0; y<inHeight; y++ ) {
+                        memcpy( &( source[ y * lineBytes ] ),
+                                &( bytes[ ( inHeight - y - 1 ) *
+                                          lineBytes ] ),
+                                lineBytes );
+                        }
+                    }
+
+                writeTGA( source, inWidth, inHeight, c, bottomUp, rle,
+                          fileName );
+
+                if( source != bytes ) {
+                    delete [] source;
+                    }
+
+                RawRGBAImage *image = readStream( fileName );
+                char *what = autoSprintf( "%s from stream", fileName );
+                check( sameAs( image, bytes, inWidth, inHeight, c ), what );
+                delete [] what;
+                if( image != NULL ) {
+                    delete image;
+                    }
+
+                image = readBuffer( fileName );
+                what = autoSprintf( "%s from buffer", fileName );
+                check( sameAs( image, bytes, inWidth, inHeight, c ), what );
+                delete [] what;
+                if( image != NULL ) {
+                    delete image;
+                    }
+
+                int imageChannels = 0;
+                unsigned char *imageBytes =
+                    readThroughImage( fileName, &imageChannels );
+
+                char same = ( imageBytes != NULL && imageChannels == c );
+                for( int p=0; same && p<inWidth * inHeight; p++ ) {
+                    if( memcmp( &( imageBytes[ p * 4 ] ),
+                                &( bytes[ p * c ] ), c ) != 0 ) {
+                        same = false;
+                        }
+                    }
+                what = autoSprintf( "%s through Image", fileName );
+                check( same, what );
+                delete [] what;
+                if( imageBytes != NULL ) {
+                    delete [] imageBytes;
+                    }
+
+
+                // truncated by one byte
+                File file( NULL, fileName );
+                int length = 0;
+                unsigned char *data = file.readFileContents( &length );
+
+                what = autoSprintf( "%s read back", fileName );
+                check( data != NULL, what );
+                delete [] what;
+
+                if( data != NULL ) {
+                    image = TGAImageConverter::deformatBytes( data,
+                                                              length - 1 );
+                    what = autoSprintf( "%s truncated refused", fileName );
+                    check( image == NULL, what );
+                    delete [] what;
+                    if( image != NULL ) {
+                        delete image;
+                        }
+
+                    if( rle ) {
+                        check( length < inWidth * inHeight * c,
+                               "run-length encoding shrinks patchy image" );
+
+                        // stream path too
+                        File shortFile( NULL, "tgaJriBench_short.tga" );
+                        shortFile.writeToFile( data, length - 1 );
+
+                        image = readStream( "tgaJriBench_short.tga" );
+                        check( image == NULL,
+                               "truncated run-length stream refused" );
+                        if( image != NULL ) {
+                            delete image;
+                            }
+                        shortFile.remove();
+                        }
+
+                    delete [] data;
+                    }
+                delete [] fileName;
+                }
+            }
+
+        delete [] bytes;
+        }
+    }
+
+
+
+static void checkSwap() {
+    char allSame = true;
+
+    for( int c=3; c<=4; c++ ) {
+        for( int n=0; n<70; n++ ) {
+            int numBytes = n * c;
+            unsigned char *source = new unsigned char[ numBytes + 1 ];
+            unsigned char *dest = new unsigned char[ numBytes + 1 ];
+            unsigned char *expected = new unsigned char[ numBytes + 1 ];
+
+            for( int i=0; i<numBytes; i++ ) {
+                source[i] = (unsigned char)randInt( 0, 255 );
+                }
+            for( int i=0; i<numBytes; i += c ) {
+                memcpy( &( expected[i] ), &( source[i] ), c );
+                expected[i] = source[ i + 2 ];
+                expected[ i + 2 ] = source[i];
+                }
+
+            // guard byte past end
+            dest[ numBytes ] = 77;
+
+            TGAImageConverter::swapRedBlue( source, dest, n, c );
+
+            if( memcmp( dest, expected, numBytes ) != 0 ||
+                dest[ numBytes ] != 77 ) {
+                allSame = false;
+                }
+
+            TGAImageConverter::swapRedBlue( source, source, n, c );
+
+            if( memcmp( source, expected, numBytes ) != 0 ) {
+                allSame = false;
+                }
+
+            delete [] source;
+            delete [] dest;
+            delete [] expected;
+            }
+        }
+
+    check( allSame, "red/blue swap matches plain loop" );
+    }
+
+
+
+static void checkJRI( int inWidth, int inHeight ) {
+    unsigned char *rgb = makeBytes( inWidth, inHeight, 3, 200 );
+
+    int numPixels = inWidth * inHeight;
+
+    rgbaColor *rgba = new rgbaColor[ numPixels ];
+    for( int p=0; p<numPixels; p++ ) {
+        rgba[p].r = rgb[ p * 3 ];
+        rgba[p].g = rgb[ p * 3 + 1 ];
+        rgba[p].b = rgb[ p * 3 + 2 ];
+        rgba[p].a = 255;
+        }
+
+    int lengthA, lengthB;
+    unsigned char *jriA = generateJRI( rgb, 3, inWidth, inHeight, &lengthA );
+    unsigned char *jriB = generateJRI( rgba, inWidth, inHeight, &lengthB );
+
+    check( jriA != NULL && jriB != NULL && lengthA == lengthB &&
+           memcmp( jriA, jriB, lengthA ) == 0,
+           "JRI same from RGB bytes and rgbaColors" );
+
+    if( jriA != NULL ) {
+        int w, h;
+        rgbaColor *back = extractJRI( jriA, lengthA, &w, &h );
+
+        check( back != NULL && w == inWidth && h == inHeight &&
+               memcmp( back, rgba, numPixels * 4 ) == 0,
+               "JRI round trip" );
+        if( back != NULL ) {
+            delete [] back;
+            }
+
+        back = extractJRI( jriA, lengthA - 1, &w, &h );
+        check( back == NULL, "truncated JRI refused" );
+        if( back != NULL ) {
+            delete [] back;
+            }
+        }
+
+    if( jriA != NULL ) {
+        delete [] jriA;
+        }
+    if( jriB != NULL ) {
+        delete [] jriB;
+        }
+
+    // more than 256 colors
+    unsigned char *manyColors = new unsigned char[ 300 * 3 ];
+    for( int i=0; i<300; i++ ) {
+        manyColors[ i * 3 ] = (unsigned char)i;
+        manyColors[ i * 3 + 1 ] = (unsigned char)( i >> 8 );
+        manyColors[ i * 3 + 2 ] = 0;
+        }
+    int length;
+    unsigned char *jri = generateJRI( manyColors, 3, 300, 1, &length );
+    check( jri == NULL, "JRI refuses 257 colors" );
+    if( jri != NULL ) {
+        delete [] jri;
+        }
+    delete [] manyColors;
+
+    delete [] rgba;
+    delete [] rgb;
+    }
+
+
+
+class NullOutputStream : public OutputStream {
+    public:
+        virtual long write( unsigned char *inBuffer, long inNumBytes ) {
+            return inNumBytes;
+            }
+    };
+
+
+
+int main( int inNumArgs, char **inArgs ) {
+    int size = 1024;
+
+    if( inNumArgs > 1 ) {
+        size = atoi( inArgs[1] );
+        }
+
+    // odd sizes, so SIMD loops have tails
+    checkFormats( 317, 201 );
+    checkSwap();
+    checkJRI( 253, 97 );
+
+
+    // timing
+    int numRuns = 10;
+
+    unsigned char *bytes = makeBytes( size, size, 4, 0 );
+    writeTGA( bytes, size, size, 4, true, false, "tgaJriBench_time.tga" );
+    writeTGA( bytes, size, size, 4, true, true, "tgaJriBench_timeRLE.tga" );
+
+    double imageSeconds = 0;
+    double streamSeconds = 0;
+    double bufferSeconds = 0;
+    double rleSeconds = 0;
+
+    for( int r=0; r<numRuns; r++ ) {
+        int c;
+        double startTime = Time::getCurrentTime();
+        delete [] readThroughImage( "tgaJriBench_time.tga", &c );
+        imageSeconds += Time::getCurrentTime() - startTime;
+
+        startTime = Time::getCurrentTime();
+        delete readStream( "tgaJriBench_time.tga" );
+        streamSeconds += Time::getCurrentTime() - startTime;
+
+        startTime = Time::getCurrentTime();
+        delete readBuffer( "tgaJriBench_time.tga" );
+        bufferSeconds += Time::getCurrentTime() - startTime;
+
+        startTime = Time::getCurrentTime();
+        delete readStream( "tgaJriBench_timeRLE.tga" );
+        rleSeconds += Time::getCurrentTime() - startTime;
+        }
+
+
+    Image image( size, size, 4, false );
+    for( int c=0; c<4; c++ ) {
+        double *channel = image.getChannel( c );
+        for( int p=0; p<size * size; p++ ) {
+            channel[p] = bytes[ p * 4 + c ] / 255.0;
+            }
+        }
+
+    NullOutputStream nullStream;
+    TGAImageConverter converter;
+
+    double formatImageSeconds = 0;
+    double formatBytesSeconds = 0;
+    double formatRLESeconds = 0;
+
+    for( int r=0; r<numRuns; r++ ) {
+        double startTime = Time::getCurrentTime();
+        converter.formatImage( &image, &nullStream );
+        formatImageSeconds += Time::getCurrentTime() - startTime;
+
+        startTime = Time::getCurrentTime();
+        converter.formatBytes( bytes, size, size, 4, false, &nullStream );
+        formatBytesSeconds += Time::getCurrentTime() - startTime;
+
+        startTime = Time::getCurrentTime();
+        converter.formatBytes( bytes, size, size, 4, false, &nullStream,
+                               true );
+        formatRLESeconds += Time::getCurrentTime() - startTime;
+        }
+
+    unsigned char *rgb = makeBytes( size, size, 3, 200 );
+    double startTime = Time::getCurrentTime();
+    int jriLength;
+    unsigned char *jri = generateJRI( rgb, 3, size, size, &jriLength );
+    double jriEncodeSeconds = Time::getCurrentTime() - startTime;
+
+    startTime = Time::getCurrentTime();
+    int w, h;
+    rgbaColor *back = extractJRI( jri, jriLength, &w, &h );
+    double jriDecodeSeconds = Time::getCurrentTime() - startTime;
+
+    delete [] back;
+    delete [] jri;
+    delete [] rgb;
+    delete [] bytes;
+
+    printf( "%dx%d RGBA, bottom-up, ms per image:\n", size, size );
+    printf( "  decode through Image:     %6.2f  (holds %d MiB)\n",
+            1000 * imageSeconds / numRuns, size * size * 4 * 9 >> 20 );
+    printf( "  decode bytes, stream:     %6.2f  (holds %d MiB)\n",
+            1000 * streamSeconds / numRuns, size * size * 4 >> 20 );
+    printf( "  decode bytes, buffer:     %6.2f\n",
+            1000 * bufferSeconds / numRuns );
+    printf( "  decode RLE, stream:       %6.2f\n",
+            1000 * rleSeconds / numRuns );
+    printf( "  encode from Image:        %6.2f\n",
+            1000 * formatImageSeconds / numRuns );
+    printf( "  encode bytes:             %6.2f\n",
+            1000 * formatBytesSeconds / numRuns );
+    printf( "  encode bytes, RLE:        %6.2f\n",
+            1000 * formatRLESeconds / numRuns );
+    printf( "  JRI encode, 200 colors:   %6.2f\n", 1000 * jriEncodeSeconds );
+    printf( "  JRI decode:               %6.2f\n", 1000 * jriDecodeSeconds );
+
+
+    if( numFailed > 0 ) {
+        printf( "%d checks failed\n", numFailed );
+        return 1;
+        }
+
+    printf( "All checks passed\n" );
+    return 0;
+    }
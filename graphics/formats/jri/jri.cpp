@@ -9,11 +9,31 @@
 rgbaColor *extractJRI( unsigned char *inData, int inNumBytes,
                        int *outWidth, int *outHeight ) {
     
-    int version, w, h, numColors;
+    // find end of header by looking for '#'
+
+    int index = 0;
+
+    while( index < inNumBytes ) {    
+        if( inData[index++] == '#' ) {
+            break;
+            }
+        }
+
+    //printf( "Index of first data byte = %d\n", index );
     
+    if( index >= inNumBytes || index > 100 ) {
+        return NULL;
+        }
+    
+    // data isn't \0-terminated, so scan a copy of the header
+    char header[ 101 ];
+    memcpy( header, inData, index );
+    header[ index ] = '\0';
 
+    int version, w, h, numColors;
+    
     int numRead =
-        sscanf( (char *)inData, "%d %d %d %d", &version, &w, &h, &numColors );
+        sscanf( header, "%d %d %d %d", &version, &w, &h, &numColors );
     
     
     if( numRead != 4 ) {
@@ -23,26 +43,13 @@ rgbaColor *extractJRI( unsigned char *inData, int inNumBytes,
     if( version != JRI_VERSION ) {
         return NULL;
         }
-    
-    //printf( "JRI data for %dx%d image with %d colors\n", w, h, numColors );
-
-
-    // skip header by looking for '#'
-
-    int index = 0;
-
-    while( index < inNumBytes ) {    
-        if( inData[index++] == '#' ) {
-            break;
-            }
-        }
 
-    //printf( "Index of first data byte = %d\n", index );
-    
-    if( index >= inNumBytes ) {
+    if( w <= 0 || h <= 0 || numColors < 1 || numColors > 256 ) {
         return NULL;
         }
     
+    //printf( "JRI data for %dx%d image with %d colors\n", w, h, numColors );
+
 
     int numDataBytes = inNumBytes - index;
     
@@ -54,8 +61,9 @@ rgbaColor *extractJRI( unsigned char *inData, int inNumBytes,
         return NULL;
         }
     
-    rgbaColor *colors = new rgbaColor[ numColors ];
-    
+    // full 256 so that any index byte is safe to look up
+    rgbaColor colors[ 256 ];
+    memset( colors, 0, sizeof( colors ) );
 
     int b = 0;
     
@@ -64,8 +72,6 @@ rgbaColor *extractJRI( unsigned char *inData, int inNumBytes,
         colors[c].g = inData[b++];
         colors[c].b = inData[b++];
         colors[c].a = 255;
-
-        //printf( "Color %d,%d,%d\n", colors[c].r, colors[c].g, colors[c].b );
         }
 
     // skip palette
@@ -81,40 +87,54 @@ rgbaColor *extractJRI( unsigned char *inData, int inNumBytes,
 
     
     b = 0;
-    while( b < numDataBytes ) {
+    while( b + 2 <= numDataBytes ) {
     
         // a new run or non-run
 
         int runType = inData[b++];
         int runLength = inData[b++];
         
+        if( runLength > numPixels - p ) {
+            break;
+            }
 
         if( runType == 1 ) {
             // run
+            if( b >= numDataBytes ) {
+                break;
+                }
+            
+            rgbaColor runColor = colors[ inData[b++] ];
 
-            int runByte = inData[b++];
-
-            //printf( "Length %d run of byte %d\n", runLength, runByte );
-
+            rgbaColor *dest = &( pixels[p] );
+            
             for( int r=0; r<runLength; r++ ) {
-                pixels[p++] = colors[ runByte ];
+                dest[r] = runColor;
                 }
             }
         else {
             // non-run
-            
-            //printf( "Length %d non-run\n", runLength );
+            if( b + runLength > numDataBytes ) {
+                break;
+                }
 
+            unsigned char *indices = &( inData[b] );
+            rgbaColor *dest = &( pixels[p] );
+            
             for( int r=0; r<runLength; r++ ) {
-                pixels[p++] = colors[ inData[b++] ];
+                dest[r] = colors[ indices[r] ];
                 }
+            b += runLength;
             }
+        
+        p += runLength;
         }
     
-
-
-    delete [] colors;
-    
+    if( p < numPixels ) {
+        // truncated or malformed
+        delete [] pixels;
+        return NULL;
+        }
         
 
     *outWidth = w;
@@ -152,7 +172,12 @@ static void outputNonRunBytes( SimpleVector<unsigned char> *dataVector,
 
 
 
-unsigned char *generateJRI( rgbaColor *inRGBA, int inWidth, int inHeight,
+// number of slots in palette hash table, a power of 2 well over 256
+#define JRI_HASH_SLOTS  1024
+
+
+unsigned char *generateJRI( unsigned char *inBytes, int inNumChannels,
+                            int inWidth, int inHeight,
                             int *outNumBytes ) {
 
     int numPixels = inWidth * inHeight;
@@ -163,45 +188,55 @@ unsigned char *generateJRI( rgbaColor *inRGBA, int inWidth, int inHeight,
     
     unsigned char *pixelIndices = new unsigned char[ numPixels ];
     
+    // RGB of each palette entry plus one, so 0 means empty,
+    // and that entry's index
+    unsigned int slotColors[ JRI_HASH_SLOTS ];
+    unsigned char slotIndices[ JRI_HASH_SLOTS ];
+    memset( slotColors, 0, sizeof( slotColors ) );
+
+    // runs are common, so check previous pixel's color first
+    unsigned int lastKey = 0;
+    unsigned char lastIndex = 0;
+
     // build palette and indices into palette for each pixel
+    // palette in order colors are first seen
     for( int p=0; p<numPixels; p++ ) {
-        unsigned char r, g, b;
+        unsigned char *pixel = &( inBytes[ p * inNumChannels ] );
         
-        r = inRGBA[p].r;
-        g = inRGBA[p].g;
-        b = inRGBA[p].b;
+        unsigned int key = 
+            ( (unsigned int)pixel[0] << 16 | pixel[1] << 8 | pixel[2] ) + 1;
 
-        int foundIndex = -1;
-
-        int numColors = colors.size();
-        for( int c=0; c<numColors; c++ ) {
-            rgbaColor color = *( colors.getElement( c ) );
-
-            if( color.r == r && 
-                color.g == g && 
-                color.b == b ) {
-                foundIndex = c;
-                
-                break;
-                }
+        if( key == lastKey ) {
+            pixelIndices[p] = lastIndex;
+            continue;
             }
-
-        if( foundIndex != -1 ) {
-            pixelIndices[p] = (unsigned char)foundIndex;
+        
+        unsigned int slot = ( key * 2654435761U ) >> 22;
+        
+        while( slotColors[ slot ] != 0 && slotColors[ slot ] != key ) {
+            slot = ( slot + 1 ) & ( JRI_HASH_SLOTS - 1 );
             }
-        else {
+
+        if( slotColors[ slot ] == 0 ) {
             // new color
             if( colors.size() < 256 ) {
-                colors.push_back( inRGBA[p] );
+                rgbaColor color = { pixel[0], pixel[1], pixel[2], 255 };
+                colors.push_back( color );
                 
-                pixelIndices[p] = (unsigned char)( colors.size() - 1 );
+                slotColors[ slot ] = key;
+                slotIndices[ slot ] = (unsigned char)( colors.size() - 1 );
                 }
             else {
                 // palette is full
-                pixelIndices[p] = 0;
                 colorOverflow = true;
+                break;
                 }
             }
+
+        lastKey = key;
+        lastIndex = slotIndices[ slot ];
+        
+        pixelIndices[p] = lastIndex;
         }        
 
     if( colorOverflow ) {
@@ -345,3 +380,10 @@ unsigned char *generateJRI( rgbaColor *inRGBA, int inWidth, int inHeight,
     return dataVector.getElementArray();
     }
 
+
+
+unsigned char *generateJRI( rgbaColor *inRGBA, int inWidth, int inHeight,
+                            int *outNumBytes ) {
+    return generateJRI( (unsigned char *)inRGBA, 4, inWidth, inHeight,
+                        outNumBytes );
+    }
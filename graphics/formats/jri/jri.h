@@ -1,6 +1,7 @@
 #include "minorGems/graphics/rgbaColor.h"
 
 
+// returns NULL if data malformed or truncated
 rgbaColor *extractJRI( unsigned char *inData, int inNumBytes,
                        int *outWidth, int *outHeight );
 
@@ -9,3 +10,11 @@ rgbaColor *extractJRI( unsigned char *inData, int inNumBytes,
 // returns NULL if inRGBA contains more than 256 colors
 unsigned char *generateJRI( rgbaColor *inRGBA, int inWidth, int inHeight,
                             int *outNumBytes );
+
+
+// same, but from RGB or RGBA bytes with inNumChannels (3 or 4) per pixel,
+// such as TGAImageConverter::deformatImageRaw returns
+// alpha ignored
+unsigned char *generateJRI( unsigned char *inBytes, int inNumChannels,
+                            int inWidth, int inHeight,
+                            int *outNumBytes );
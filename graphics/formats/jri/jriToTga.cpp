@@ -1,6 +1,5 @@
 #include "jri.h"
 #include "minorGems/graphics/converters/TGAImageConverter.h"
-#include "minorGems/graphics/RGBAImage.h"
 #include "minorGems/io/file/File.h"
 #include "minorGems/io/file/FileOutputStream.h"
 
@@ -26,23 +25,17 @@ int main( int inNumArgs, char**inArgs  ) {
         
         if( rgba != NULL ) {
             
-            Image image( w, h, 3, false );
-            
-
+            // 3-channel, as JRI has no alpha
             int numPixels = w * h;
             
-            double *channels[3];
-            
-            for( int c=0; c<3; c++ ) {
-                channels[c] = image.getChannel( c );
-                }
+            unsigned char *rgb = new unsigned char[ numPixels * 3 ];
             
             for( int p=0; p<numPixels; p++ ) {
                 rgbaColor color = rgba[p];
                 
-                channels[0][p] = color.r / 255.0;
-                channels[1][p] = color.g / 255.0;
-                channels[2][p] = color.b / 255.0;
+                rgb[ p * 3 ] = color.r;
+                rgb[ p * 3 + 1 ] = color.g;
+                rgb[ p * 3 + 2 ] = color.b;
                 }
             
             File f2( NULL, inArgs[2] );
@@ -50,9 +43,9 @@ int main( int inNumArgs, char**inArgs  ) {
             FileOutputStream fOut( &f2 );
             TGAImageConverter converter;
             
+            converter.formatBytes( rgb, w, h, 3, false, &fOut );
 
-            converter.formatImage( &image, &fOut );
-
+            delete [] rgb;
             delete [] rgba;
             }
         else {
@@ -1,6 +1,5 @@
 #include "jri.h"
 #include "minorGems/graphics/converters/TGAImageConverter.h"
-#include "minorGems/graphics/RGBAImage.h"
 #include "minorGems/io/file/File.h"
 #include "minorGems/io/file/FileInputStream.h"
 
@@ -22,20 +21,17 @@ int main( int inNumArgs, char**inArgs  ) {
     TGAImageConverter converter;
     
 
-    Image *image = converter.deformatImage( &fIn );	
+    // bytes straight from file, without converting through an Image
+    RawRGBAImage *image = converter.deformatImageRaw( &fIn );
     
     if( image != NULL ) {
         
-        unsigned char *rgbaBytes = RGBAImage::getRGBABytes( image );
-
         int jriSize;
         
         unsigned char *jriBytes = 
-            generateJRI( (rgbaColor*)rgbaBytes, 
-                         image->getWidth(), image->getHeight(),
+            generateJRI( image->mRGBABytes, image->mNumChannels,
+                         image->mWidth, image->mHeight,
                          &jriSize );
-        
-        delete [] rgbaBytes;
 
         if( jriBytes != NULL ) {
             FILE *outFile = fopen( inArgs[2], "wb" );
@@ -0,0 +1,369 @@
+// Benchmark for FrameCapture
+//
+// Usage:  frameCaptureBench [numFrames] [width] [height] [workers]
+//                           [queueLength]
+//
+// Feeds synthetic frames, bottom row first as glReadPixels returns them,
+// through the old outputAllFrames path (blend in floats, convert to a
+// double-per-channel Image, encode TGA, all on one thread), and then
+// through FrameCapture with TGA files and a .y4m stream.  Checks that both
+// paths wrote the same pixels, and prints FrameCapture's stats, including
+// a run that drops frames when the queue is full.
+//
+// Writes files into frameCaptureBenchOld and frameCaptureBenchNew.
+
+
+#include "FrameCapture.h"
+
+#include "minorGems/graphics/Image.h"
+#include "minorGems/graphics/converters/TGAImageConverter.h"
+#include "minorGems/io/file/FileInputStream.h"
+#include "minorGems/io/file/FileOutputStream.h"
+#include "minorGems/system/Time.h"
+#include "minorGems/util/stringUtils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+
+static TGAImageConverter converter;
+
+
+
+static void encodeTGA( unsigned char *inRGBBytes, int inWidth, int inHeight,
+                       OutputStream *inStream ) {
+    converter.formatBytes( inRGBBytes, inWidth, inHeight, 3, true,
+                           inStream );
+    }
+
+
+
+// moving gradients with some noise, so frames differ
+static unsigned char *makeFrame( int inFrame, int inWidth, int inHeight ) {
+    unsigned char *bytes = new unsigned char[ inWidth * inHeight * 3 ];
+
+    unsigned int seed = inFrame * 7919;
+
+    int i = 0;
+    for( int y=0; y<inHeight; y++ ) {
+        for( int x=0; x<inWidth; x++ ) {
+            seed = seed * 1103515245 + 12345;
+
+            bytes[i++] = (unsigned char)( x + inFrame * 3 );
+            bytes[i++] = (unsigned char)( y + inFrame );
+            bytes[i++] = (unsigned char)( ( x ^ y ) + ( seed >> 28 ) );
+            }
+        }
+    return bytes;
+    }
+
+
+
+// the old path, from gameSDL's getScreenRegionInternal and takeScreenShot
+static void writeOld( File *inDir, int inNumber,
+                      unsigned char *inRGBBytes, unsigned char *inHeldBytes,
+                      float inBlendFraction, int inWidth, int inHeight ) {
+
+    int numBytes = inWidth * inHeight * 3;
+
+    if( inHeldBytes != NULL && inBlendFraction > 0 ) {
+        float blendA = 1 - inBlendFraction;
+        float blendB = inBlendFraction;
+
+        for( int i=0; i<numBytes; i++ ) {
+            inRGBBytes[i] =
+                (unsigned char)(
+                    blendA * inRGBBytes[i] +
+                    blendB * inHeldBytes[i] );
+            }
+        }
+
+    Image *screenImage = new Image( inWidth, inHeight, 3, false );
+
+    double *channelOne = screenImage->getChannel( 0 );
+    double *channelTwo = screenImage->getChannel( 1 );
+    double *channelThree = screenImage->getChannel( 2 );
+
+    int outputRow = 0;
+    for( int y=inHeight - 1; y>=0; y-- ) {
+        for( int x=0; x<inWidth; x++ ) {
+            int outputPixelIndex = outputRow * inWidth + x;
+            int byteIndex = ( y * inWidth + x ) * 3;
+
+            channelOne[outputPixelIndex] =
+                inRGBBytes[ byteIndex++ ] * 0.003921569;
+            channelTwo[outputPixelIndex] =
+                inRGBBytes[ byteIndex++ ] * 0.003921569;
+            channelThree[outputPixelIndex] =
+                inRGBBytes[ byteIndex++ ] * 0.003921569;
+            }
+        outputRow++;
+        }
+
+    char *fileName = autoSprintf( "frame%05d.tga", inNumber );
+    File *file = inDir->getChildFile( fileName );
+    delete [] fileName;
+
+    FileOutputStream stream( file );
+    converter.formatImage( screenImage, &stream );
+
+    delete file;
+    delete screenImage;
+    }
+
+
+
+static RawRGBAImage *readFrame( File *inDir, int inNumber ) {
+    char *fileName = autoSprintf( "frame%05d.tga", inNumber );
+    File *file = inDir->getChildFile( fileName );
+    delete [] fileName;
+
+    RawRGBAImage *image = NULL;
+
+    if( file->exists() ) {
+        FileInputStream stream( file );
+        image = converter.deformatImageRaw( &stream );
+        }
+    delete file;
+
+    return image;
+    }
+
+
+
+static void printStats( const char *inLabel, FrameCaptureStats inStats ) {
+    printf( "  %s:  %d submitted, %d held, %d written, %d dropped, "
+            "%d failed, %d backpressured (%.3f sec)\n",
+            inLabel, inStats.submitted, inStats.held, inStats.written,
+            inStats.dropped, inStats.failed, inStats.backpressured,
+            inStats.backpressureSeconds );
+    }
+
+
+
+// runs frames through a FrameCapture, returns seconds taken
+static double runNew( File *inDir, const char *inY4MName,
+                      int inNumFrames, int inWidth, int inHeight,
+                      int inWorkers, int inQueueLength, char inDrop,
+                      double inBlendFraction, char inBlend,
+                      FrameCaptureStats *outStats ) {
+
+    double start = Time::getCurrentTime();
+
+    FrameCapture *capture =
+        new FrameCapture( inWorkers, inQueueLength, inDrop );
+
+    capture->setImageOutput( inDir, "frame", "tga", 1, encodeTGA );
+
+    if( inY4MName != NULL ) {
+        capture->setY4MOutput( inY4MName, 60 );
+        }
+    if( inBlend ) {
+        capture->setBlendPairs( inBlendFraction );
+        }
+
+    for( int f=0; f<inNumFrames; f++ ) {
+        capture->submitFrame( makeFrame( f, inWidth, inHeight ),
+                              inWidth, inHeight );
+        }
+
+    capture->flush();
+    *outStats = capture->getStats();
+
+    delete capture;
+
+    return Time::getCurrentTime() - start;
+    }
+
+
+
+int main( int inNumArgs, char **inArgs ) {
+
+    int numFrames = 120;
+    int width = 1280;
+    int height = 720;
+    int workers = 4;
+    int queueLength = 8;
+
+    if( inNumArgs > 1 ) {
+        numFrames = atoi( inArgs[1] );
+        }
+    if( inNumArgs > 3 ) {
+        width = atoi( inArgs[2] );
+        height = atoi( inArgs[3] );
+        }
+    if( inNumArgs > 4 ) {
+        workers = atoi( inArgs[4] );
+        }
+    if( inNumArgs > 5 ) {
+        queueLength = atoi( inArgs[5] );
+        }
+
+    if( numFrames < 2 || width < 1 || height < 1 || queueLength < 1 ) {
+        printf( "Usage:  frameCaptureBench [numFrames] [width] [height] "
+                "[workers] [queueLength]\n" );
+        return 1;
+        }
+
+    File oldDir( NULL, "frameCaptureBenchOld" );
+    File newDir( NULL, "frameCaptureBenchNew" );
+
+    if( ! oldDir.exists() ) {
+        oldDir.makeDirectory();
+        }
+    if( ! newDir.exists() ) {
+        newDir.makeDirectory();
+        }
+
+    printf( "%d frames of %dx%d, %d workers, queue of %d\n\n",
+            numFrames, width, height, workers, queueLength );
+
+
+    // old path, every frame
+    double start = Time::getCurrentTime();
+
+    for( int f=0; f<numFrames; f++ ) {
+        unsigned char *bytes = makeFrame( f, width, height );
+        writeOld( &oldDir, f + 1, bytes, NULL, 0, width, height );
+        delete [] bytes;
+        }
+    double oldSeconds = Time::getCurrentTime() - start;
+
+
+    FrameCaptureStats stats;
+
+    double newSeconds = runNew( &newDir, "frameCaptureBenchNew/frames.y4m",
+                                numFrames, width, height,
+                                workers, queueLength, false, 0, false,
+                                &stats );
+
+    printf( "%-24s %10s %10s\n", "path", "sec", "fps" );
+    printf( "%-24s %10.3f %10.1f\n", "Image + formatImage",
+            oldSeconds, numFrames / oldSeconds );
+    printf( "%-24s %10.3f %10.1f\n", "FrameCapture + y4m",
+            newSeconds, numFrames / newSeconds );
+    printf( "\n" );
+    printStats( "FrameCapture", stats );
+
+
+    int numMismatched = 0;
+
+    if( stats.written != numFrames ) {
+        printf( "Expected %d frames written\n", numFrames );
+        numMismatched++;
+        }
+
+    for( int f=1; f<=numFrames; f++ ) {
+        RawRGBAImage *a = readFrame( &oldDir, f );
+        RawRGBAImage *b = readFrame( &newDir, f );
+
+        if( a == NULL || b == NULL ||
+            a->mWidth != b->mWidth || a->mHeight != b->mHeight ||
+            a->mNumChannels != b->mNumChannels ||
+            memcmp( a->mRGBABytes, b->mRGBABytes,
+                    a->mWidth * a->mHeight * a->mNumChannels ) != 0 ) {
+            if( numMismatched < 10 ) {
+                printf( "Frame %d differs\n", f );
+                }
+            numMismatched++;
+            }
+        if( a != NULL ) {
+            delete a;
+            }
+        if( b != NULL ) {
+            delete b;
+            }
+        }
+
+
+    // y4m is header, then FRAME line and Y, U, V planes per frame
+    char *header = autoSprintf( "YUV4MPEG2 W%d H%d F60:1 Ip A1:1 C420jpeg\n",
+                                width, height );
+    long frameBytes = width * height +
+        2 * ( ( width + 1 ) / 2 ) * ( ( height + 1 ) / 2 );
+    long expectedLength =
+        strlen( header ) + numFrames * ( 6 + frameBytes );
+    delete [] header;
+
+    FILE *y4mFile = fopen( "frameCaptureBenchNew/frames.y4m", "rb" );
+    long y4mLength = -1;
+    if( y4mFile != NULL ) {
+        fseek( y4mFile, 0, SEEK_END );
+        y4mLength = ftell( y4mFile );
+        fclose( y4mFile );
+        }
+    if( y4mLength != expectedLength ) {
+        printf( "y4m stream is %ld bytes, expected %ld\n",
+                y4mLength, expectedLength );
+        numMismatched++;
+        }
+
+
+    // blended pairs, old and new
+    for( int f=0; f<numFrames; f += 2 ) {
+        unsigned char *held = makeFrame( f, width, height );
+        if( f + 1 < numFrames ) {
+            unsigned char *bytes = makeFrame( f + 1, width, height );
+            writeOld( &oldDir, f / 2 + 1, bytes, held, 0.5f,
+                      width, height );
+            delete [] bytes;
+            }
+        delete [] held;
+        }
+
+    runNew( &newDir, NULL, numFrames, width, height,
+            workers, queueLength, false, 0.5, true, &stats );
+    printStats( "blended pairs", stats );
+
+    // float blend truncates, fixed point rounds, so allow off-by-one
+    int numBlendMismatched = 0;
+    for( int f=1; f<=numFrames / 2; f++ ) {
+        RawRGBAImage *a = readFrame( &oldDir, f );
+        RawRGBAImage *b = readFrame( &newDir, f );
+
+        if( a == NULL || b == NULL ) {
+            numBlendMismatched++;
+            }
+        else {
+            int numBytes = a->mWidth * a->mHeight * a->mNumChannels;
+            for( int i=0; i<numBytes; i++ ) {
+                if( abs( a->mRGBABytes[i] - b->mRGBABytes[i] ) > 1 ) {
+                    numBlendMismatched++;
+                    break;
+                    }
+                }
+            }
+        if( a != NULL ) {
+            delete a;
+            }
+        if( b != NULL ) {
+            delete b;
+            }
+        }
+    if( numBlendMismatched > 0 ) {
+        printf( "%d blended frames differ\n", numBlendMismatched );
+        numMismatched += numBlendMismatched;
+        }
+
+
+    // one worker and a short queue, dropping instead of waiting
+    runNew( &newDir, NULL, numFrames, width, height,
+            1, 2, true, 0, false, &stats );
+    printStats( "dropping, 1 worker", stats );
+
+    if( stats.written + stats.dropped != numFrames ) {
+        printf( "Dropped and written frames don't add up\n" );
+        numMismatched++;
+        }
+
+
+    if( numMismatched > 0 ) {
+        printf( "FAILED:  %d mismatches\n", numMismatched );
+        return 1;
+        }
+
+    printf( "\nOutputs match\n" );
+    return 0;
+    }
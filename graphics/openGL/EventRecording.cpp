@@ -0,0 +1,1267 @@
+#include "EventRecording.h"
+
+#include "minorGems/formats/encodingUtils.h"
+#include "minorGems/util/log/AppLog.h"
+#include "minorGems/util/stringUtils.h"
+#include "minorGems/system/Time.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+
+
+// first line of binary recordings, followed by the same header line that
+// text recordings start with
+#define BINARY_RECORDING_MAGIC "MGREC1\n"
+
+// blocks end after this many frames or raw bytes, whichever comes first
+#define RECORDING_BLOCK_FRAMES 64
+#define RECORDING_BLOCK_BYTES 65536
+
+// a block open longer than this is written even if not full, so a crash
+// loses at most this much recording at low frame rates
+#define RECORDING_BLOCK_SECONDS 0.5
+
+// blocks claiming more bytes than this are treated as corrupt when read,
+// and the writer leaves out snapshots that would make one
+#define RECORDING_MAX_BLOCK_BYTES ( 256 * 1024 * 1024 )
+#define RECORDING_MAX_SNAPSHOT_BYTES ( 128 * 1024 * 1024 )
+
+// rawLength, storedLength, firstFrame, numFrames, flags
+#define RECORDING_BLOCK_HEADER_BYTES 17
+
+#define BLOCK_KEYFRAME 0x01
+#define BLOCK_COMPRESSED 0x02
+#define BLOCK_SNAPSHOT 0x04
+
+
+
+static void clearKeyframe( RecordingKeyframe *outKeyframe ) {
+    outKeyframe->frame = 0;
+    outKeyframe->hasTime = false;
+    outKeyframe->time = 0;
+    outKeyframe->hasCurrentTime = false;
+    outKeyframe->currentTime = 0;
+    outKeyframe->hasFrameRate = false;
+    outKeyframe->frameRate = 0;
+    outKeyframe->lastAsyncFileDone = -1;
+    outKeyframe->lastWebHandle = -1;
+    outKeyframe->snapshot = NULL;
+    outKeyframe->snapshotLength = 0;
+    }
+
+
+
+// merges state seen in a later batch
+static void updateKeyframe( RecordingKeyframe *ioKeyframe,
+                            RecordingKeyframe *inLater ) {
+    if( inLater->hasTime ) {
+        ioKeyframe->hasTime = true;
+        ioKeyframe->time = inLater->time;
+        }
+    if( inLater->hasCurrentTime ) {
+        ioKeyframe->hasCurrentTime = true;
+        ioKeyframe->currentTime = inLater->currentTime;
+        }
+    if( inLater->hasFrameRate ) {
+        ioKeyframe->hasFrameRate = true;
+        ioKeyframe->frameRate = inLater->frameRate;
+        }
+    if( inLater->lastAsyncFileDone > ioKeyframe->lastAsyncFileDone ) {
+        ioKeyframe->lastAsyncFileDone = inLater->lastAsyncFileDone;
+        }
+    if( inLater->lastWebHandle > ioKeyframe->lastWebHandle ) {
+        ioKeyframe->lastWebHandle = inLater->lastWebHandle;
+        }
+    }
+
+
+
+
+static void putUnsigned( SimpleVector<unsigned char> *outBytes,
+                         uint32_t inValue ) {
+    while( inValue >= 0x80 ) {
+        outBytes->push_back( (unsigned char)( inValue | 0x80 ) );
+        inValue >>= 7;
+        }
+    outBytes->push_back( (unsigned char)inValue );
+    }
+
+
+
+// zig-zag, so small negative values stay short
+static void putSigned( SimpleVector<unsigned char> *outBytes, int inValue ) {
+    putUnsigned( outBytes,
+                 ( (uint32_t)inValue << 1 ) ^ (uint32_t)( inValue >> 31 ) );
+    }
+
+
+
+static void putDouble( SimpleVector<unsigned char> *outBytes,
+                       double inValue ) {
+    uint64_t bits;
+    memcpy( &bits, &inValue, 8 );
+    for( int i=0; i<8; i++ ) {
+        outBytes->push_back( (unsigned char)( bits >> ( 8 * i ) ) );
+        }
+    }
+
+
+
+static void putUInt32( unsigned char *outBytes, uint32_t inValue ) {
+    for( int i=0; i<4; i++ ) {
+        outBytes[i] = (unsigned char)( inValue >> ( 8 * i ) );
+        }
+    }
+
+
+
+static uint32_t getUInt32( unsigned char *inBytes ) {
+    return (uint32_t)inBytes[0] |
+        ( (uint32_t)inBytes[1] << 8 ) |
+        ( (uint32_t)inBytes[2] << 16 ) |
+        ( (uint32_t)inBytes[3] << 24 );
+    }
+
+
+
+// bounds-checked reads from a decoded block
+// once a read runs past the end, all further reads fail
+typedef struct ByteCursor {
+        unsigned char *bytes;
+        int length;
+        int pos;
+        char failed;
+    } ByteCursor;
+
+
+
+static uint32_t getUnsigned( ByteCursor *inC ) {
+    uint32_t value = 0;
+    int shift = 0;
+
+    while( inC->pos < inC->length && shift < 35 ) {
+        unsigned char b = inC->bytes[ inC->pos++ ];
+        value |= (uint32_t)( b & 0x7F ) << shift;
+        if( ( b & 0x80 ) == 0 ) {
+            return value;
+            }
+        shift += 7;
+        }
+
+    inC->failed = true;
+    return 0;
+    }
+
+
+
+static int getSigned( ByteCursor *inC ) {
+    uint32_t v = getUnsigned( inC );
+    return (int)( v >> 1 ) ^ -(int)( v & 1 );
+    }
+
+
+
+static double getDouble( ByteCursor *inC ) {
+    if( inC->pos + 8 > inC->length ) {
+        inC->failed = true;
+        return 0;
+        }
+
+    uint64_t bits = 0;
+    for( int i=0; i<8; i++ ) {
+        bits |= (uint64_t)inC->bytes[ inC->pos++ ] << ( 8 * i );
+        }
+    double value;
+    memcpy( &value, &bits, 8 );
+    return value;
+    }
+
+
+
+// returns pointer into cursor's bytes
+static unsigned char *getBytes( ByteCursor *inC, int inLength ) {
+    if( inLength < 0 || inC->pos + inLength > inC->length ) {
+        inC->failed = true;
+        return NULL;
+        }
+    unsigned char *p = &( inC->bytes[ inC->pos ] );
+    inC->pos += inLength;
+    return p;
+    }
+
+
+
+// number of integer fields for each event type
+static int getNumValues( RecordedEventType inType ) {
+    switch( inType ) {
+        case RECORDED_MOUSE_MOVE:
+        case RECORDED_MOUSE_DRAG:
+        case RECORDED_WEB:
+            return 2;
+        case RECORDED_MOUSE_BUTTON:
+            return 4;
+        case RECORDED_KEY_DOWN:
+        case RECORDED_KEY_UP:
+        case RECORDED_SPECIAL_KEY_DOWN:
+        case RECORDED_SPECIAL_KEY_UP:
+        case RECORDED_SOCKET:
+            return 3;
+        case RECORDED_ASYNC_FILE_DONE:
+            return 1;
+        default:
+            return 0;
+        }
+    }
+
+
+
+static char hasTimeValue( RecordedEventType inType ) {
+    return ( inType == RECORDED_TIME ||
+             inType == RECORDED_CURRENT_TIME ||
+             inType == RECORDED_FRAME_RATE );
+    }
+
+
+
+// web result-fetch steps and socket reads with data carry bodies
+static char hasBody( RecordedEventType inType, int *inValues ) {
+    if( inType == RECORDED_WEB ) {
+        return ( inValues[1] == 2 );
+        }
+    if( inType == RECORDED_SOCKET ) {
+        return ( inValues[1] == 2 && inValues[2] != 0 );
+        }
+    return false;
+    }
+
+
+
+static char decodeEvent( ByteCursor *inC, RecordedEvent *outEvent ) {
+    int type = getUnsigned( inC );
+
+    if( type < RECORDED_MOUSE_MOVE || type >= RECORDED_NUM_TYPES ) {
+        inC->failed = true;
+        return false;
+        }
+
+    outEvent->type = (RecordedEventType)type;
+    outEvent->time = 0;
+    outEvent->body = NULL;
+    outEvent->bodyLength = 0;
+
+    int numValues = getNumValues( outEvent->type );
+    for( int i=0; i<4; i++ ) {
+        outEvent->values[i] = 0;
+        if( i < numValues ) {
+            outEvent->values[i] = getSigned( inC );
+            }
+        }
+
+    if( hasTimeValue( outEvent->type ) ) {
+        outEvent->time = getDouble( inC );
+        }
+
+    if( hasBody( outEvent->type, outEvent->values ) ) {
+        outEvent->bodyLength = getUnsigned( inC );
+        outEvent->body = getBytes( inC, outEvent->bodyLength );
+        }
+
+    return ! inC->failed;
+    }
+
+
+
+
+RecordedEventBatch::RecordedEventBatch()
+    : mNumEvents( 0 ) {
+    clearKeyframe( &mState );
+    }
+
+
+
+void RecordedEventBatch::addEvent( RecordedEvent *inEvent ) {
+    putUnsigned( &mBytes, inEvent->type );
+
+    int numValues = getNumValues( inEvent->type );
+    for( int i=0; i<numValues; i++ ) {
+        putSigned( &mBytes, inEvent->values[i] );
+        }
+
+    if( hasTimeValue( inEvent->type ) ) {
+        putDouble( &mBytes, inEvent->time );
+        }
+
+    if( hasBody( inEvent->type, inEvent->values ) ) {
+        putUnsigned( &mBytes, inEvent->bodyLength );
+        if( inEvent->bodyLength > 0 ) {
+            mBytes.push_back( inEvent->body, inEvent->bodyLength );
+            }
+        }
+
+    switch( inEvent->type ) {
+        case RECORDED_TIME:
+            mState.hasTime = true;
+            mState.time = inEvent->time;
+            break;
+        case RECORDED_CURRENT_TIME:
+            mState.hasCurrentTime = true;
+            mState.currentTime = inEvent->time;
+            break;
+        case RECORDED_FRAME_RATE:
+            mState.hasFrameRate = true;
+            mState.frameRate = inEvent->time;
+            break;
+        case RECORDED_ASYNC_FILE_DONE:
+            if( inEvent->values[0] > mState.lastAsyncFileDone ) {
+                mState.lastAsyncFileDone = inEvent->values[0];
+                }
+            break;
+        case RECORDED_WEB:
+            if( inEvent->values[0] > mState.lastWebHandle ) {
+                mState.lastWebHandle = inEvent->values[0];
+                }
+            break;
+        default:
+            break;
+        }
+
+    mNumEvents++;
+    }
+
+
+
+void RecordedEventBatch::addEvent( RecordedEventType inType,
+                                   int inA, int inB, int inC, int inD ) {
+    RecordedEvent e;
+    e.type = inType;
+    e.values[0] = inA;
+    e.values[1] = inB;
+    e.values[2] = inC;
+    e.values[3] = inD;
+    e.time = 0;
+    e.body = NULL;
+    e.bodyLength = 0;
+
+    addEvent( &e );
+    }
+
+
+
+void RecordedEventBatch::addTimeEvent( RecordedEventType inType,
+                                       double inTime ) {
+    RecordedEvent e;
+    e.type = inType;
+    memset( e.values, 0, sizeof( e.values ) );
+    e.time = inTime;
+    e.body = NULL;
+    e.bodyLength = 0;
+
+    addEvent( &e );
+    }
+
+
+
+void RecordedEventBatch::addBodyEvent( RecordedEventType inType,
+                                       int inA, int inB, int inC,
+                                       unsigned char *inBody,
+                                       int inBodyLength ) {
+    RecordedEvent e;
+    e.type = inType;
+    e.values[0] = inA;
+    e.values[1] = inB;
+    e.values[2] = inC;
+    e.values[3] = 0;
+    e.time = 0;
+    e.body = inBody;
+    e.bodyLength = inBodyLength;
+
+    addEvent( &e );
+    }
+
+
+
+int RecordedEventBatch::getNumEvents() {
+    return mNumEvents;
+    }
+
+
+
+void RecordedEventBatch::clear() {
+    // keep capacity, batches are refilled every frame
+    mBytes.shrink( 0 );
+    mNumEvents = 0;
+    clearKeyframe( &mState );
+    }
+
+
+
+
+RecordingWriter::RecordingWriter( FILE *inFile, const char *inHeaderLine,
+                                  int inKeyframeInterval )
+    : mFile( inFile ), mKeyframeInterval( inKeyframeInterval ),
+      mNumFrames( 0 ),
+      mBlockFirstFrame( 0 ), mBlockNumFrames( 0 ),
+      mBlockIsKeyframe( false ), mBlockStartTime( 0 ) {
+
+    if( mKeyframeInterval < 1 ) {
+        mKeyframeInterval = 1;
+        }
+
+    clearKeyframe( &mState );
+
+    fputs( BINARY_RECORDING_MAGIC, mFile );
+    fputs( inHeaderLine, mFile );
+    fflush( mFile );
+    }
+
+
+
+RecordingWriter::~RecordingWriter() {
+    flush();
+    }
+
+
+
+char RecordingWriter::isKeyframeNext() {
+    return ( mNumFrames % mKeyframeInterval == 0 );
+    }
+
+
+
+void RecordingWriter::writeFrame( RecordedEventBatch *inFirst,
+                                  RecordedEventBatch *inSecond,
+                                  unsigned char *inSnapshot,
+                                  int inSnapshotLength ) {
+
+    char keyframe = isKeyframeNext();
+
+    if( keyframe ||
+        mBlockNumFrames >= RECORDING_BLOCK_FRAMES ||
+        mBlock.size() >= RECORDING_BLOCK_BYTES ) {
+        flush();
+        }
+
+    if( mBlockNumFrames == 0 ) {
+        mBlockFirstFrame = mNumFrames;
+        mBlockIsKeyframe = keyframe;
+        mBlockStartTime = Time::getCurrentTime();
+
+        if( keyframe ) {
+            // state before this frame's events
+            unsigned char flags = 0;
+            if( mState.hasTime ) {
+                flags |= 1;
+                }
+            if( mState.hasCurrentTime ) {
+                flags |= 2;
+                }
+            if( mState.hasFrameRate ) {
+                flags |= 4;
+                }
+            mBlock.push_back( flags );
+            putDouble( &mBlock, mState.time );
+            putDouble( &mBlock, mState.currentTime );
+            putDouble( &mBlock, mState.frameRate );
+            putSigned( &mBlock, mState.lastAsyncFileDone );
+            putSigned( &mBlock, mState.lastWebHandle );
+
+            if( inSnapshotLength > RECORDING_MAX_SNAPSHOT_BYTES ) {
+                AppLog::errorF( "Leaving %d-byte snapshot out of recording "
+                                "keyframe", inSnapshotLength );
+                inSnapshot = NULL;
+                }
+            if( inSnapshot == NULL ) {
+                inSnapshotLength = 0;
+                }
+            putUnsigned( &mBlock, inSnapshotLength );
+            if( inSnapshotLength > 0 ) {
+                mBlock.push_back( inSnapshot, inSnapshotLength );
+                }
+            }
+        }
+
+    putUnsigned( &mBlock,
+                 inFirst->getNumEvents() + inSecond->getNumEvents() );
+
+    if( inFirst->mBytes.size() > 0 ) {
+        mBlock.push_back( inFirst->mBytes.getElement( 0 ),
+                          inFirst->mBytes.size() );
+        }
+    if( inSecond->mBytes.size() > 0 ) {
+        mBlock.push_back( inSecond->mBytes.getElement( 0 ),
+                          inSecond->mBytes.size() );
+        }
+
+    updateKeyframe( &mState, &( inFirst->mState ) );
+    updateKeyframe( &mState, &( inSecond->mState ) );
+
+    inFirst->clear();
+    inSecond->clear();
+
+    mBlockNumFrames++;
+    mNumFrames++;
+
+    if( Time::getCurrentTime() - mBlockStartTime >= RECORDING_BLOCK_SECONDS ) {
+        flush();
+        }
+    }
+
+
+
+void RecordingWriter::flush() {
+    if( mBlockNumFrames == 0 ) {
+        return;
+        }
+
+    unsigned char *raw = mBlock.getElement( 0 );
+    int rawLength = mBlock.size();
+
+    int storedLength;
+    unsigned char *stored = zipCompress( raw, rawLength, &storedLength );
+
+    unsigned char flags = 0;
+    if( mBlockIsKeyframe ) {
+        flags |= BLOCK_KEYFRAME;
+
+        // snapshot length follows flags, 3 doubles, and 2 varints
+        ByteCursor c = { raw, rawLength, 25, false };
+        getSigned( &c );
+        getSigned( &c );
+        if( getUnsigned( &c ) > 0 ) {
+            flags |= BLOCK_SNAPSHOT;
+            }
+        }
+
+    if( stored != NULL && storedLength < rawLength ) {
+        flags |= BLOCK_COMPRESSED;
+        }
+    else {
+        if( stored != NULL ) {
+            delete [] stored;
+            }
+        stored = NULL;
+        storedLength = rawLength;
+        }
+
+    unsigned char header[ RECORDING_BLOCK_HEADER_BYTES ];
+    putUInt32( &( header[0] ), rawLength );
+    putUInt32( &( header[4] ), storedLength );
+    putUInt32( &( header[8] ), mBlockFirstFrame );
+    putUInt32( &( header[12] ), mBlockNumFrames );
+    header[16] = flags;
+
+    fwrite( header, 1, RECORDING_BLOCK_HEADER_BYTES, mFile );
+
+    int numWritten;
+    if( stored != NULL ) {
+        numWritten = fwrite( stored, 1, storedLength, mFile );
+        delete [] stored;
+        }
+    else {
+        numWritten = fwrite( raw, 1, rawLength, mFile );
+        }
+
+    if( numWritten != storedLength ) {
+        AppLog::errorF( "Failed to write %d-frame block to recording file",
+                        mBlockNumFrames );
+        }
+
+    // one flush per block instead of per frame, so a crash loses at
+    // most the block still being buffered (up to RECORDING_BLOCK_FRAMES
+    // frames or RECORDING_BLOCK_SECONDS)
+    fflush( mFile );
+
+    mBlock.shrink( 0 );
+    mBlockNumFrames = 0;
+    }
+
+
+
+
+RecordingReader::RecordingReader( FILE *inFile )
+    : mFile( inFile ), mHeaderLine( NULL ), mNumFrames( 0 ) {
+    }
+
+
+
+RecordingReader::~RecordingReader() {
+    if( mHeaderLine != NULL ) {
+        delete [] mHeaderLine;
+        }
+    }
+
+
+
+const char *RecordingReader::getHeaderLine() {
+    return mHeaderLine;
+    }
+
+
+
+int RecordingReader::getNumFrames() {
+    return mNumFrames;
+    }
+
+
+
+char RecordingReader::seekToKeyframe( int, char, RecordingKeyframe * ) {
+    return false;
+    }
+
+
+
+
+// reads a line, including its newline, returns NULL at end of file
+static char *readLine( FILE *inFile ) {
+    SimpleVector<char> line;
+
+    int c = fgetc( inFile );
+    while( c != EOF ) {
+        line.push_back( (char)c );
+        if( c == '\n' ) {
+            break;
+            }
+        c = fgetc( inFile );
+        }
+
+    if( line.size() == 0 ) {
+        return NULL;
+        }
+    return line.getElementString();
+    }
+
+
+
+
+typedef struct RecordingBlockInfo {
+        long offset;
+        int firstFrame;
+        int numFrames;
+        unsigned char flags;
+    } RecordingBlockInfo;
+
+
+
+class BinaryRecordingReader : public RecordingReader {
+
+    public:
+
+        BinaryRecordingReader( FILE *inFile, char *inHeaderLine );
+
+        virtual ~BinaryRecordingReader();
+
+        virtual char readFrame( SimpleVector<RecordedEvent> *outEvents );
+
+        virtual char seekToKeyframe( int inFrame, char inNeedSnapshot,
+                                     RecordingKeyframe *outKeyframe );
+
+    protected:
+
+        // found by scanning block headers when opened
+        SimpleVector<RecordingBlockInfo> mBlocks;
+
+        // index of next block to load
+        int mNextBlock;
+
+        unsigned char *mBlockData;
+        ByteCursor mCursor;
+        int mFramesLeftInBlock;
+
+        // loads a block, leaving cursor at its first frame
+        char loadBlock( int inIndex, RecordingKeyframe *outKeyframe );
+    };
+
+
+
+BinaryRecordingReader::BinaryRecordingReader( FILE *inFile,
+                                              char *inHeaderLine )
+    : RecordingReader( inFile ),
+      mNextBlock( 0 ), mBlockData( NULL ), mFramesLeftInBlock( 0 ) {
+
+    mHeaderLine = inHeaderLine;
+
+    mCursor.bytes = NULL;
+    mCursor.length = 0;
+    mCursor.pos = 0;
+    mCursor.failed = false;
+
+    long start = ftell( mFile );
+    fseek( mFile, 0, SEEK_END );
+    long fileLength = ftell( mFile );
+
+    // index from block headers alone, skipping over block data
+    // a block cut short by a crash ends the index
+    long offset = start;
+
+    while( offset + RECORDING_BLOCK_HEADER_BYTES <= fileLength ) {
+        unsigned char header[ RECORDING_BLOCK_HEADER_BYTES ];
+
+        fseek( mFile, offset, SEEK_SET );
+        if( fread( header, 1, RECORDING_BLOCK_HEADER_BYTES, mFile ) !=
+            RECORDING_BLOCK_HEADER_BYTES ) {
+            break;
+            }
+
+        long rawLength = getUInt32( &( header[0] ) );
+        long storedLength = getUInt32( &( header[4] ) );
+
+        if( rawLength <= 0 || rawLength > RECORDING_MAX_BLOCK_BYTES ||
+            storedLength <= 0 || storedLength > RECORDING_MAX_BLOCK_BYTES ) {
+            // corrupt header, nothing after it can be trusted
+            AppLog::errorF( "Recording block at offset %ld has bad lengths "
+                            "(%ld raw, %ld stored), ignoring rest of file",
+                            offset, rawLength, storedLength );
+            break;
+            }
+
+        if( offset + RECORDING_BLOCK_HEADER_BYTES + storedLength >
+            fileLength ) {
+            break;
+            }
+
+        RecordingBlockInfo b;
+        b.offset = offset;
+        b.firstFrame = getUInt32( &( header[8] ) );
+        b.numFrames = getUInt32( &( header[12] ) );
+        b.flags = header[16];
+
+        mBlocks.push_back( b );
+        mNumFrames = b.firstFrame + b.numFrames;
+
+        offset += RECORDING_BLOCK_HEADER_BYTES + storedLength;
+        }
+
+    fseek( mFile, start, SEEK_SET );
+    }
+
+
+
+BinaryRecordingReader::~BinaryRecordingReader() {
+    if( mBlockData != NULL ) {
+        delete [] mBlockData;
+        }
+    }
+
+
+
+char BinaryRecordingReader::loadBlock( int inIndex,
+                                       RecordingKeyframe *outKeyframe ) {
+    if( mBlockData != NULL ) {
+        delete [] mBlockData;
+        mBlockData = NULL;
+        }
+    mFramesLeftInBlock = 0;
+
+    RecordingBlockInfo *b = mBlocks.getElement( inIndex );
+
+    unsigned char header[ RECORDING_BLOCK_HEADER_BYTES ];
+
+    fseek( mFile, b->offset, SEEK_SET );
+    if( fread( header, 1, RECORDING_BLOCK_HEADER_BYTES, mFile ) !=
+        RECORDING_BLOCK_HEADER_BYTES ) {
+        return false;
+        }
+
+    uint32_t rawHeaderLength = getUInt32( &( header[0] ) );
+    uint32_t storedHeaderLength = getUInt32( &( header[4] ) );
+
+    // same bounds as the index pass, in case the file changed since
+    if( rawHeaderLength == 0 ||
+        rawHeaderLength > RECORDING_MAX_BLOCK_BYTES ||
+        storedHeaderLength == 0 ||
+        storedHeaderLength > RECORDING_MAX_BLOCK_BYTES ) {
+        return false;
+        }
+
+    int rawLength = (int)rawHeaderLength;
+    int storedLength = (int)storedHeaderLength;
+
+    unsigned char *stored = new unsigned char[ storedLength ];
+    if( (int)fread( stored, 1, storedLength, mFile ) != storedLength ) {
+        delete [] stored;
+        return false;
+        }
+
+    if( b->flags & BLOCK_COMPRESSED ) {
+        mBlockData = zipDecompress( stored, storedLength, rawLength );
+        delete [] stored;
+        if( mBlockData == NULL ) {
+            return false;
+            }
+        }
+    else {
+        mBlockData = stored;
+        rawLength = storedLength;
+        }
+
+    mCursor.bytes = mBlockData;
+    mCursor.length = rawLength;
+    mCursor.pos = 0;
+    mCursor.failed = false;
+
+    if( b->flags & BLOCK_KEYFRAME ) {
+        RecordingKeyframe k;
+        clearKeyframe( &k );
+        k.frame = b->firstFrame;
+
+        unsigned char *flags = getBytes( &mCursor, 1 );
+        k.time = getDouble( &mCursor );
+        k.currentTime = getDouble( &mCursor );
+        k.frameRate = getDouble( &mCursor );
+        k.lastAsyncFileDone = getSigned( &mCursor );
+        k.lastWebHandle = getSigned( &mCursor );
+        k.snapshotLength = getUnsigned( &mCursor );
+        k.snapshot = getBytes( &mCursor, k.snapshotLength );
+
+        if( mCursor.failed ) {
+            return false;
+            }
+        k.hasTime = ( ( flags[0] & 1 ) != 0 );
+        k.hasCurrentTime = ( ( flags[0] & 2 ) != 0 );
+        k.hasFrameRate = ( ( flags[0] & 4 ) != 0 );
+
+        if( k.snapshotLength == 0 ) {
+            k.snapshot = NULL;
+            }
+
+        if( outKeyframe != NULL ) {
+            *outKeyframe = k;
+            }
+        }
+
+    mFramesLeftInBlock = b->numFrames;
+    mNextBlock = inIndex + 1;
+    return true;
+    }
+
+
+
+char BinaryRecordingReader::readFrame(
+    SimpleVector<RecordedEvent> *outEvents ) {
+
+    while( mFramesLeftInBlock == 0 ) {
+        if( mNextBlock >= mBlocks.size() ) {
+            return false;
+            }
+        if( ! loadBlock( mNextBlock, NULL ) ) {
+            AppLog::error( "Failed to read block from recording file" );
+            mNextBlock = mBlocks.size();
+            return false;
+            }
+        }
+
+    int numEvents = getUnsigned( &mCursor );
+
+    for( int i=0; i<numEvents && ! mCursor.failed; i++ ) {
+        RecordedEvent e;
+        if( decodeEvent( &mCursor, &e ) ) {
+            outEvents->push_back( e );
+            }
+        }
+
+    if( mCursor.failed ) {
+        AppLog::error( "Corrupt frame in recording file" );
+        mFramesLeftInBlock = 0;
+        mNextBlock = mBlocks.size();
+        return false;
+        }
+
+    mFramesLeftInBlock--;
+    return true;
+    }
+
+
+
+char BinaryRecordingReader::seekToKeyframe( int inFrame,
+                                            char inNeedSnapshot,
+                                            RecordingKeyframe *outKeyframe ) {
+    int found = -1;
+
+    for( int i=0; i<mBlocks.size(); i++ ) {
+        RecordingBlockInfo *b = mBlocks.getElement( i );
+        if( b->firstFrame > inFrame ) {
+            break;
+            }
+        if( ( b->flags & BLOCK_KEYFRAME ) &&
+            ( ! inNeedSnapshot || ( b->flags & BLOCK_SNAPSHOT ) ) ) {
+            found = i;
+            }
+        }
+
+    if( found == -1 ) {
+        return false;
+        }
+
+    return loadBlock( found, outKeyframe );
+    }
+
+
+
+
+#define TEXT_READ_BUFFER 65536
+
+
+class TextRecordingReader : public RecordingReader {
+
+    public:
+
+        TextRecordingReader( FILE *inFile, char *inHeaderLine );
+
+        virtual ~TextRecordingReader();
+
+        virtual char readFrame( SimpleVector<RecordedEvent> *outEvents );
+
+    protected:
+
+        unsigned char mBuffer[ TEXT_READ_BUFFER ];
+        int mBufferPos;
+        int mBufferEnd;
+
+        // bodies from the last frame
+        SimpleVector<unsigned char *> mBodies;
+
+        // -1 at end of file
+        int nextChar();
+
+        // skips whitespace, then reads up to inMaxLength
+        // non-whitespace characters
+        // returns number read
+        int readToken( char *outToken, int inMaxLength );
+
+        int readInt();
+        double readDouble();
+
+        // reads inLength raw bytes into a new body
+        unsigned char *readBody( int inLength );
+
+        // reads 2 * inNumBytes hex digits into a new body
+        unsigned char *readHexBody( int inNumBytes );
+    };
+
+
+
+TextRecordingReader::TextRecordingReader( FILE *inFile, char *inHeaderLine )
+    : RecordingReader( inFile ), mBufferPos( 0 ), mBufferEnd( 0 ) {
+
+    mHeaderLine = inHeaderLine;
+
+    // one batch per line
+    long start = ftell( mFile );
+
+    int numRead = fread( mBuffer, 1, TEXT_READ_BUFFER, mFile );
+    while( numRead > 0 ) {
+        for( int i=0; i<numRead; i++ ) {
+            if( mBuffer[i] == '\n' ) {
+                mNumFrames++;
+                }
+            }
+        numRead = fread( mBuffer, 1, TEXT_READ_BUFFER, mFile );
+        }
+
+    fseek( mFile, start, SEEK_SET );
+    }
+
+
+
+TextRecordingReader::~TextRecordingReader() {
+    for( int i=0; i<mBodies.size(); i++ ) {
+        delete [] mBodies.getElementDirect( i );
+        }
+    }
+
+
+
+int TextRecordingReader::nextChar() {
+    if( mBufferPos == mBufferEnd ) {
+        mBufferEnd = fread( mBuffer, 1, TEXT_READ_BUFFER, mFile );
+        mBufferPos = 0;
+        if( mBufferEnd <= 0 ) {
+            mBufferEnd = 0;
+            return -1;
+            }
+        }
+    return mBuffer[ mBufferPos++ ];
+    }
+
+
+
+int TextRecordingReader::readToken( char *outToken, int inMaxLength ) {
+    int c = nextChar();
+    while( c == ' ' || c == '\n' || c == '\r' || c == '\t' ) {
+        c = nextChar();
+        }
+
+    int length = 0;
+    while( c != -1 && c != ' ' && c != '\n' && c != '\r' && c != '\t' ) {
+        outToken[ length++ ] = (char)c;
+        if( length == inMaxLength ) {
+            break;
+            }
+        c = nextChar();
+        }
+    outToken[ length ] = '\0';
+
+    if( c == ' ' || c == '\n' || c == '\r' || c == '\t' ) {
+        // leave whitespace that ended token, since bodies start after
+        // exactly one separator
+        mBufferPos--;
+        }
+    return length;
+    }
+
+
+
+int TextRecordingReader::readInt() {
+    char token[32];
+    readToken( token, 31 );
+    return (int)strtol( token, NULL, 10 );
+    }
+
+
+
+double TextRecordingReader::readDouble() {
+    char token[64];
+    readToken( token, 63 );
+    return strtod( token, NULL );
+    }
+
+
+
+unsigned char *TextRecordingReader::readBody( int inLength ) {
+    unsigned char *body = new unsigned char[ inLength + 1 ];
+    mBodies.push_back( body );
+
+    for( int i=0; i<inLength; i++ ) {
+        int c = nextChar();
+        if( c == -1 ) {
+            return NULL;
+            }
+        body[i] = (unsigned char)c;
+        }
+    body[ inLength ] = '\0';
+    return body;
+    }
+
+
+
+static int hexValue( int inC ) {
+    if( inC >= '0' && inC <= '9' ) {
+        return inC - '0';
+        }
+    if( inC >= 'A' && inC <= 'F' ) {
+        return inC - 'A' + 10;
+        }
+    if( inC >= 'a' && inC <= 'f' ) {
+        return inC - 'a' + 10;
+        }
+    return -1;
+    }
+
+
+
+unsigned char *TextRecordingReader::readHexBody( int inNumBytes ) {
+    unsigned char *body = new unsigned char[ inNumBytes + 1 ];
+    mBodies.push_back( body );
+
+    for( int i=0; i<inNumBytes; i++ ) {
+        int high = hexValue( nextChar() );
+        int low = hexValue( nextChar() );
+        if( high == -1 || low == -1 ) {
+            return NULL;
+            }
+        body[i] = (unsigned char)( ( high << 4 ) | low );
+        }
+    body[ inNumBytes ] = '\0';
+    return body;
+    }
+
+
+
+char TextRecordingReader::readFrame( SimpleVector<RecordedEvent> *outEvents ) {
+    for( int i=0; i<mBodies.size(); i++ ) {
+        delete [] mBodies.getElementDirect( i );
+        }
+    mBodies.deleteAll();
+
+    char token[32];
+    if( readToken( token, 31 ) == 0 ) {
+        return false;
+        }
+    int batchSize = atoi( token );
+
+    for( int i=0; i<batchSize; i++ ) {
+        char code[3];
+        if( readToken( code, 2 ) == 0 ) {
+            return false;
+            }
+
+        RecordedEvent e;
+        memset( e.values, 0, sizeof( e.values ) );
+        e.time = 0;
+        e.body = NULL;
+        e.bodyLength = 0;
+
+        switch( code[0] ) {
+            case 'm':
+                switch( code[1] ) {
+                    case 'm':
+                        e.type = RECORDED_MOUSE_MOVE;
+                        break;
+                    case 'd':
+                        e.type = RECORDED_MOUSE_DRAG;
+                        break;
+                    default:
+                        e.type = RECORDED_MOUSE_BUTTON;
+                        break;
+                    }
+                break;
+            case 'k':
+                e.type = ( code[1] == 'u' ) ?
+                    RECORDED_KEY_UP : RECORDED_KEY_DOWN;
+                break;
+            case 's':
+                e.type = ( code[1] == 'u' ) ?
+                    RECORDED_SPECIAL_KEY_UP : RECORDED_SPECIAL_KEY_DOWN;
+                break;
+            case 't':
+                e.type = RECORDED_TIME;
+                break;
+            case 'r':
+                e.type = RECORDED_TIME_REPEAT;
+                break;
+            case 'T':
+                e.type = RECORDED_CURRENT_TIME;
+                break;
+            case 'R':
+                e.type = RECORDED_CURRENT_TIME_REPEAT;
+                break;
+            case 'F':
+                e.type = RECORDED_FRAME_RATE;
+                break;
+            case 'v':
+                e.type = RECORDED_MINIMIZED;
+                break;
+            case 'w':
+                e.type = RECORDED_WEB;
+                break;
+            case 'x':
+                e.type = RECORDED_SOCKET;
+                break;
+            case 'a':
+                e.type = RECORDED_ASYNC_FILE_DONE;
+                break;
+            default:
+                AppLog::errorF( "Unknown code '%s' in playback file\n",
+                                code );
+                continue;
+            }
+
+        int numValues = getNumValues( e.type );
+        for( int v=0; v<numValues; v++ ) {
+            e.values[v] = readInt();
+            }
+
+        if( hasTimeValue( e.type ) ) {
+            e.time = readDouble();
+            }
+
+        if( e.type == RECORDED_WEB && e.values[1] == 2 ) {
+            int length = readInt();
+
+            // skip the space after length
+            nextChar();
+
+            if( code[1] == 'x' ) {
+                e.bodyLength = length / 2;
+                e.body = readHexBody( e.bodyLength );
+                }
+            else {
+                e.bodyLength = length;
+                e.body = readBody( length );
+                }
+
+            if( e.body == NULL ) {
+                AppLog::error( "Failed to read web event body from "
+                               "playback file" );
+                e.bodyLength = 0;
+                }
+            }
+        else if( e.type == RECORDED_SOCKET && hasBody( e.type, e.values ) ) {
+            // skip the space after numBodyBytes
+            nextChar();
+
+            e.bodyLength = e.values[2];
+            e.body = readHexBody( e.bodyLength );
+
+            if( e.body == NULL ) {
+                AppLog::error( "Failed to read socket event body from "
+                               "playback file" );
+                e.bodyLength = 0;
+                }
+            }
+
+        outEvents->push_back( e );
+        }
+
+    return true;
+    }
+
+
+
+
+RecordingReader *RecordingReader::open( FILE *inFile ) {
+    char *line = readLine( inFile );
+
+    if( line == NULL ) {
+        return NULL;
+        }
+
+    if( strcmp( line, BINARY_RECORDING_MAGIC ) == 0 ) {
+        delete [] line;
+
+        line = readLine( inFile );
+        if( line == NULL ) {
+            return NULL;
+            }
+        return new BinaryRecordingReader( inFile, line );
+        }
+
+    return new TextRecordingReader( inFile, line );
+    }
+
+
+
+
+int convertTextRecording( FILE *inText, FILE *outBinary,
+                          int inKeyframeInterval ) {
+    RecordingReader *reader = RecordingReader::open( inText );
+
+    if( reader == NULL ) {
+        return -1;
+        }
+
+    RecordingWriter writer( outBinary, reader->getHeaderLine(),
+                            inKeyframeInterval );
+
+    RecordedEventBatch batch;
+    RecordedEventBatch empty;
+    SimpleVector<RecordedEvent> events;
+
+    int numFrames = 0;
+
+    while( reader->readFrame( &events ) ) {
+        for( int i=0; i<events.size(); i++ ) {
+            batch.addEvent( events.getElement( i ) );
+            }
+        events.shrink( 0 );
+
+        writer.writeFrame( &batch, &empty );
+        numFrames++;
+        }
+
+    delete reader;
+
+    return numFrames;
+    }
@@ -0,0 +1,276 @@
+#ifndef EVENT_RECORDING_INCLUDED
+#define EVENT_RECORDING_INCLUDED
+
+
+#include "minorGems/util/SimpleVector.h"
+
+#include <stdio.h>
+
+
+
+// events in a ScreenGL game recording
+// (text format codes in comments)
+enum RecordedEventType {
+    RECORDED_MOUSE_MOVE = 1,        // mm x y
+    RECORDED_MOUSE_DRAG,            // md x y
+    RECORDED_MOUSE_BUTTON,          // mb button state x y
+    RECORDED_KEY_DOWN,              // kd key x y
+    RECORDED_KEY_UP,                // ku key x y
+    RECORDED_SPECIAL_KEY_DOWN,      // sd key x y
+    RECORDED_SPECIAL_KEY_UP,        // su key x y
+    RECORDED_TIME,                  // t seconds
+    RECORDED_TIME_REPEAT,           // r
+    RECORDED_CURRENT_TIME,          // T seconds
+    RECORDED_CURRENT_TIME_REPEAT,   // R
+    RECORDED_FRAME_RATE,            // F fps
+    RECORDED_MINIMIZED,             // v
+    RECORDED_WEB,                   // wb/wx handle type [length body]
+    RECORDED_SOCKET,                // xs handle type numBytes [hexBody]
+    RECORDED_ASYNC_FILE_DONE,       // af handle
+    RECORDED_NUM_TYPES
+    };
+
+
+
+typedef struct RecordedEvent {
+        RecordedEventType type;
+
+        // integer fields, in text format order
+        int values[4];
+
+        // for time and frame rate events
+        double time;
+
+        // body of web and socket events, or NULL
+        // owned by the batch or reader that produced the event
+        unsigned char *body;
+        int bodyLength;
+    } RecordedEvent;
+
+
+
+// playback state at a keyframe, enough to resume playback there along with
+// the game's own snapshot
+typedef struct RecordingKeyframe {
+        int frame;
+
+        char hasTime;
+        double time;
+
+        char hasCurrentTime;
+        double currentTime;
+
+        char hasFrameRate;
+        double frameRate;
+
+        int lastAsyncFileDone;
+        int lastWebHandle;
+
+        // game state, or NULL
+        // owned by the writer or reader that holds the keyframe
+        unsigned char *snapshot;
+        int snapshotLength;
+    } RecordingKeyframe;
+
+
+
+/**
+ * One frame's worth of events, encoded compactly as they are added.
+ */
+class RecordedEventBatch {
+
+    public:
+
+        RecordedEventBatch();
+
+
+        void addEvent( RecordedEvent *inEvent );
+
+
+        // for events with only integer fields
+        void addEvent( RecordedEventType inType,
+                       int inA = 0, int inB = 0, int inC = 0, int inD = 0 );
+
+        // for time and frame rate events
+        void addTimeEvent( RecordedEventType inType, double inTime );
+
+        // for web and socket events, inBody copied
+        void addBodyEvent( RecordedEventType inType,
+                           int inA, int inB, int inC,
+                           unsigned char *inBody, int inBodyLength );
+
+
+        int getNumEvents();
+
+        void clear();
+
+
+        // encoded events
+        SimpleVector<unsigned char> mBytes;
+
+        // latest keyframe state seen in this batch
+        RecordingKeyframe mState;
+
+
+    protected:
+
+        int mNumEvents;
+    };
+
+
+
+/**
+ * Writes a binary recording.
+ *
+ * Frames are collected into blocks that are compressed and written a
+ * block at a time, once a block is full or has been open for half a
+ * second.  Every inKeyframeInterval frames, a block starts with a
+ * keyframe holding the playback state (and optional game snapshot) needed
+ * to start playback there.
+ */
+class RecordingWriter {
+
+    public:
+
+        /**
+         * Starts a recording.
+         *
+         * @param inFile the file to write to.  Closed by caller after
+         *   this writer is destroyed.
+         * @param inHeaderLine the recording header, including the trailing
+         *   newline.  Copied.
+         * @param inKeyframeInterval frames between keyframes.
+         */
+        RecordingWriter( FILE *inFile, const char *inHeaderLine,
+                         int inKeyframeInterval = 1800 );
+
+        // writes the last block
+        ~RecordingWriter();
+
+
+        // true if the next frame written starts a keyframe, so its game
+        // snapshot should be passed to writeFrame
+        char isKeyframeNext();
+
+
+        /**
+         * Adds a frame.  Batches are written in order and cleared.
+         *
+         * @param inSnapshot game state for a keyframe, or NULL.  Copied.
+         */
+        void writeFrame( RecordedEventBatch *inFirst,
+                         RecordedEventBatch *inSecond,
+                         unsigned char *inSnapshot = NULL,
+                         int inSnapshotLength = 0 );
+
+
+        // writes the frames so far
+        void flush();
+
+
+    protected:
+
+        FILE *mFile;
+        int mKeyframeInterval;
+
+        int mNumFrames;
+
+        // current block
+        SimpleVector<unsigned char> mBlock;
+        int mBlockFirstFrame;
+        int mBlockNumFrames;
+        char mBlockIsKeyframe;
+        double mBlockStartTime;
+
+        // playback state as of the last frame written
+        RecordingKeyframe mState;
+    };
+
+
+
+/**
+ * Reads a recording, in either the binary format or the older text
+ * format.
+ */
+class RecordingReader {
+
+    public:
+
+        /**
+         * Opens a recording, detecting its format.
+         *
+         * @param inFile the file, positioned at the start.  Closed by
+         *   caller after the reader is destroyed.
+         *
+         * @return a reader, or NULL if the file is empty.  Destroyed by
+         *   caller.
+         */
+        static RecordingReader *open( FILE *inFile );
+
+
+        virtual ~RecordingReader();
+
+
+        // header line, including trailing newline
+        // not destroyed by caller
+        const char *getHeaderLine();
+
+
+        // number of frames, approximate for text recordings
+        int getNumFrames();
+
+
+        /**
+         * Reads the next frame.
+         *
+         * @param outEvents vector to add the frame's events to.  Event
+         *   bodies are valid until the next call.
+         *
+         * @return true on success, false at end of recording.
+         */
+        virtual char readFrame( SimpleVector<RecordedEvent> *outEvents ) = 0;
+
+
+        /**
+         * Moves to the latest keyframe at or before a frame.
+         *
+         * @param inFrame the frame.
+         * @param inNeedSnapshot true to only consider keyframes with game
+         *   snapshots.
+         * @param outKeyframe set to the keyframe's state.  Snapshot valid
+         *   until the next call to readFrame or seekToKeyframe.
+         *
+         * @return true if found, in which case readFrame returns frames
+         *   from the keyframe on, or false if not found (or not
+         *   supported by this format), in which case position is unchanged.
+         */
+        virtual char seekToKeyframe( int inFrame, char inNeedSnapshot,
+                                     RecordingKeyframe *outKeyframe );
+
+
+    protected:
+
+        RecordingReader( FILE *inFile );
+
+        FILE *mFile;
+        char *mHeaderLine;
+        int mNumFrames;
+    };
+
+
+
+/**
+ * Converts a text recording to the binary format.
+ *
+ * @param inText a text recording, positioned at the start.
+ * @param outBinary the file to write.
+ * @param inKeyframeInterval frames between keyframes.
+ *
+ * @return number of frames converted, or -1 on failure.
+ */
+int convertTextRecording( FILE *inText, FILE *outBinary,
+                          int inKeyframeInterval = 1800 );
+
+
+
+#endif
@@ -131,6 +131,8 @@
 
 #include "minorGems/system/Time.h"
 
+#include "EventRecording.h"
+
 
 // prototypes
 void callbackResize( int inW, int inH );
@@ -161,7 +163,7 @@ typedef struct SocketEvent {
         int numBodyBytes;
         // can be NULL even if numBodyBytes not 0 (in case of
         // recorded send, where we don't need to record what was sent)
-        char *bodyBytesHex;
+        unsigned char *bodyBytes;
     } SocketEvent;
 
 
@@ -203,7 +205,8 @@ class ScreenGL {
          *
          * SDL implementation:
          * Must call SDL_Init() with at least SDL_INIT_VIDEO
-         * as a parameter.
+         * as a parameter (except in HEADLESS_REPLAY builds, which open
+         * no window).
 		 *
 		 * @param inWide width of screen.
 		 * @param inHigh height of screen.
@@ -250,6 +253,18 @@ class ScreenGL {
 		~ScreenGL();	
 		
 
+        /**
+         * Sets a recorded game file to play back, instead of the first
+         * file found in the playbackGame folder.
+         *
+         * Must be called before a ScreenGL is constructed.
+         *
+         * @param inFileName the file path, or NULL to use the folder.
+         *   Copied internally.
+         */
+        static void setPlaybackFile( const char *inFileName );
+		
+
 
         /**
          * Gets data read from a recorded game file.
@@ -271,6 +286,30 @@ class ScreenGL {
         float getPlaybackDoneFraction();
         
 
+        /**
+         * Sets functions that save and restore game state, so that
+         * recordings can hold snapshots at keyframes and playback can
+         * seek between them.
+         *
+         * @param inSave returns a new[] snapshot of the game's state,
+         *   destroyed by caller, and sets *outLength.
+         * @param inRestore restores a snapshot, returns true on success.
+         */
+        void setSnapshotFunctions( 
+            unsigned char *( *inSave )( int *outLength ),
+            char ( *inRestore )( unsigned char *inSnapshot, int inLength ) );
+        
+
+        /**
+         * Moves playback to the latest keyframe with a game snapshot at or
+         * before a frame.  Takes effect before the next frame is played.
+         *
+         * @return the frame moved to, or -1 if there is no such keyframe
+         *   (or not playing back, or the recording has no keyframes).
+         */
+        int seekPlayback( int inFrame );
+        
+
         /**
          * Returns whether playback display is on or off.
          */
@@ -782,13 +821,25 @@ class ScreenGL {
         
 
         // for event recording
-        SimpleVector<char*> mUserEventBatch;
+        RecordedEventBatch mUserEventBatch;
         // these are written to file before user events
         // so that they can be played back first
-        SimpleVector<char*> mEventBatch;
+        RecordedEventBatch mEventBatch;
         char mRecordingEvents;
         char mPlaybackEvents;
         FILE *mEventFile;
+        
+        RecordingWriter *mRecordingWriter;
+        RecordingReader *mRecordingReader;
+        SimpleVector<RecordedEvent> mPlaybackFrameEvents;
+        
+        unsigned char *( *mSaveSnapshot )( int *outLength );
+        char ( *mRestoreSnapshot )( unsigned char *inSnapshot, int inLength );
+
+        // keyframe found by seekPlayback, applied before the next frame
+        char mSeekPending;
+        RecordingKeyframe mPendingKeyframe;
+        void applyPendingSeek();
 
         char mObscureRecordedNumericTyping;
         char mCharToRecordInstead;
@@ -810,9 +861,9 @@ class ScreenGL {
         
 
         void writeEventBatchToFile();
-        void writeEventBatchToFile( SimpleVector<char*> *inBatch );
 
         void playNextEventBatch();
+        void playRecordedEvent( RecordedEvent *inEvent );
         
 
         // recording file may contain gaps between web event sequence
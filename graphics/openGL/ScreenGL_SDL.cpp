@@ -202,6 +202,10 @@ static unsigned char keyMap[256];
 static char keyMapOn = true;
 
 
+// set by setPlaybackFile, or NULL to use the playbackGame folder
+static char *playbackFile = NULL;
+
+
 // FOVMOD NOTE:  Change 1/3 - Take these lines during the merge process
 long timeSinceLastFrameMS = 0;
 
@@ -217,6 +221,18 @@ void callbackDisplay();
 void callbackIdle();
 */
 
+void ScreenGL::setPlaybackFile( const char *inFileName ) {
+    if( playbackFile != NULL ) {
+        delete [] playbackFile;
+        playbackFile = NULL;
+        }
+    if( inFileName != NULL ) {
+        playbackFile = stringDuplicate( inFileName );
+        }
+    }
+
+
+
 ScreenGL::ScreenGL( int inWide, int inHigh, char inFullScreen,
                     char inDoNotChangeNativeResolution,
                     unsigned int inMaxFrameRate,
@@ -303,6 +319,11 @@ ScreenGL::ScreenGL( int inWide, int inHigh, char inFullScreen,
     mRecordingEvents = inRecordEvents;
     mPlaybackEvents = false;
     mEventFile = NULL;
+    mRecordingWriter = NULL;
+    mRecordingReader = NULL;
+    mSaveSnapshot = NULL;
+    mRestoreSnapshot = NULL;
+    mSeekPending = false;
     mEventFileNumBatches = 0;
     mNumBatchesPlayed = 0;
     
@@ -311,172 +332,164 @@ ScreenGL::ScreenGL( int inWide, int inHigh, char inFullScreen,
     // playback overrides recording, check for it first
     // do this before setting up surface
     
-    File playbackDir( NULL, "playbackGame" );
-    
-    if( !playbackDir.exists() ) {
-        playbackDir.makeDirectory();
+    char *fullFileName = NULL;
+
+    if( playbackFile != NULL ) {
+        fullFileName = stringDuplicate( playbackFile );
         }
+    else {
+        File playbackDir( NULL, "playbackGame" );
     
-    int numChildren;
-    File **childFiles = playbackDir.getChildFiles( &numChildren );
+        if( !playbackDir.exists() ) {
+            playbackDir.makeDirectory();
+            }
+    
+        int numChildren;
+        File **childFiles = playbackDir.getChildFiles( &numChildren );
 
-    if( numChildren > 0 ) {
+        if( numChildren > 0 ) {
 
-        // take first
-        char *fullFileName = childFiles[0]->getFullFileName();
-        char *partialFileName = childFiles[0]->getFileName();
+            // take first
+            fullFileName = childFiles[0]->getFullFileName();
+            char *partialFileName = childFiles[0]->getFileName();
         
-        // skip hidden files
-        int i = 0;
-        while( partialFileName != NULL &&
-               partialFileName[i] == '.' ) {
+            // skip hidden files
+            int i = 0;
+            while( partialFileName != NULL &&
+                   partialFileName[i] == '.' ) {
+
+                delete [] fullFileName;
+                fullFileName = NULL;
 
-            delete [] fullFileName;
-            fullFileName = NULL;
+                delete [] partialFileName;
+                partialFileName = NULL;
 
+                i++;
+                if( i < numChildren ) {
+                    fullFileName = childFiles[i]->getFullFileName();
+                    partialFileName = childFiles[i]->getFileName();
+                    }
+                }
+
+            // NULL if none found
             delete [] partialFileName;
-            partialFileName = NULL;
 
-            i++;
-            if( i < numChildren ) {
-                fullFileName = childFiles[i]->getFullFileName();
-                partialFileName = childFiles[i]->getFileName();
+            for( int i=0; i<numChildren; i++ ) {
+                delete childFiles[i];
                 }
             }
+        delete [] childFiles;
+        }
 
 
-        if( fullFileName != NULL ) {
-            delete [] partialFileName;
-            
-            
+    if( fullFileName != NULL ) {
+        mEventFile = fopen( fullFileName, "rb" );
 
-            mEventFile = fopen( fullFileName, "r" );
+        if( mEventFile != NULL ) {
+            // binary or older text recording
+            mRecordingReader = RecordingReader::open( mEventFile );
+            }
+        
+        if( mEventFile == NULL || mRecordingReader == NULL ) {
+            AppLog::error( "Failed to open event playback file" );
+            }
+        else {
 
-            if( mEventFile == NULL ) {
-                AppLog::error( "Failed to open event playback file" );
-                }
-            else {
+            // number of frames (close to the number
+            // of batches in text files)
+            mEventFileNumBatches = mRecordingReader->getNumFrames();
+            
 
-                // count number of newlines in file (close to the number
-                // of batches in the file)
-                char *fileContents = childFiles[i]->readFileContents();
-                
-                int fileLength = strlen( fileContents );
-                
-                for( int j=0; j<fileLength; j++ ) {
-                    if( fileContents[j] == '\n' ) {
-                        mEventFileNumBatches ++;
-                        }
-                    }
-                delete [] fileContents;
-                
+            AppLog::getLog()->logPrintf( 
+                Log::INFO_LEVEL,
+                "Playing back game from file %s", fullFileName );
+        
+            const char *headerLine = mRecordingReader->getHeaderLine();
+            
+            // custom data can be no longer than header line
+            int maxCustomLength = strlen( headerLine ) + 1;
+            
+            char *readCustomGameData = new char[ maxCustomLength ];
 
-                AppLog::getLog()->logPrintf( 
-                    Log::INFO_LEVEL,
-                    "Playing back game from file %s", fullFileName );
+            char hashString[41];
+
+            
+            
+            int fullScreenFlag;
+            unsigned int readRandSeed;
+            unsigned int readMaxFrameRate;
+            int readWide;
+            int readHigh;
+            
+            int numScanned =
+                sscanf( 
+                    headerLine, 
+                    "%u seed, %u fps, %dx%d, fullScreen=%d, %s %40s\n",
+                    &readRandSeed,
+                    &readMaxFrameRate,
+                    &readWide, &readHigh, &fullScreenFlag, 
+                    readCustomGameData,
+                    hashString );
             
+            if( numScanned == 7 ) {
 
-                // first, determine max possible length of custom data
-                int maxCustomLength = 0;
-                
-                int readChar = fgetc( mEventFile );
-                
-                while( readChar != EOF && readChar != '\n' ) {
-                    maxCustomLength++;
-                    readChar = fgetc( mEventFile );
-                    }
-                
-                // back to start
-                rewind( mEventFile );
-                
-                char *readCustomGameData = new char[ maxCustomLength ];
+                char *stringToHash = autoSprintf( "%s%s",
+                                                  readCustomGameData,
+                                                  mHashSalt );
 
-                char hashString[41];
+                char *correctHash = computeSHA1Digest( stringToHash );
 
+                delete [] stringToHash;
                 
+                int difference = strcmp( correctHash, hashString );
                 
-                int fullScreenFlag;
-                unsigned int readRandSeed;
-                unsigned int readMaxFrameRate;
-                int readWide;
-                int readHigh;
-                
-                int numScanned =
-                    fscanf( 
-                        mEventFile, 
-                        "%u seed, %u fps, %dx%d, fullScreen=%d, %s %40s\n",
-                        &readRandSeed,
-                        &readMaxFrameRate,
-                        &readWide, &readHigh, &fullScreenFlag, 
-                        readCustomGameData,
-                        hashString );
-                
-                if( numScanned == 7 ) {
+                delete [] correctHash;
 
-                    char *stringToHash = autoSprintf( "%s%s",
-                                                      readCustomGameData,
-                                                      mHashSalt );
+                if( difference == 0 ) {
 
-                    char *correctHash = computeSHA1Digest( stringToHash );
-
-                    delete [] stringToHash;
+                    mRecordingEvents = false;
+                    mPlaybackEvents = true;
                     
-                    int difference = strcmp( correctHash, hashString );
+                    mRandSeed = readRandSeed;
+                    mMaxFrameRate = readMaxFrameRate;
+                    mWide = readWide;
+                    mHigh = readHigh,
                     
-                    delete [] correctHash;
-
-                    if( difference == 0 ) {
-
-                        mRecordingEvents = false;
-                        mPlaybackEvents = true;
-                        
-                        mRandSeed = readRandSeed;
-                        mMaxFrameRate = readMaxFrameRate;
-                        mWide = readWide;
-                        mHigh = readHigh,
-                        
-                        mFullFrameRate = mMaxFrameRate;
+                    mFullFrameRate = mMaxFrameRate;
+                
+                    mImageWide = mWide;
+                    mImageHigh = mHigh;
                     
-                        mImageWide = mWide;
-                        mImageHigh = mHigh;
-                        
-                        AppLog::info( 
-                          "Forcing dimensions specified in playback file" );
-                        mForceSpecifiedDimensions = true;
-                        
-                        
-                        if( fullScreenFlag ) {
-                            mFullScreen = true;
-                            }
-                        else {
-                            mFullScreen = false;
-                            }
-
-                        delete [] mCustomRecordedGameData;
-                        mCustomRecordedGameData = 
-                            stringDuplicate( readCustomGameData );
+                    AppLog::info( 
+                      "Forcing dimensions specified in playback file" );
+                    mForceSpecifiedDimensions = true;
+                    
+                    
+                    if( fullScreenFlag ) {
+                        mFullScreen = true;
                         }
                     else {
-                        AppLog::error( 
-                        "Hash check failed for custom data in playback file" );
+                        mFullScreen = false;
                         }
+
+                    delete [] mCustomRecordedGameData;
+                    mCustomRecordedGameData = 
+                        stringDuplicate( readCustomGameData );
                     }
                 else {
                     AppLog::error( 
-                        "Failed to parse playback header data" );
-
+                    "Hash check failed for custom data in playback file" );
                     }
-                delete [] readCustomGameData;                
                 }
-            delete [] fullFileName;
-            }
-        
+            else {
+                AppLog::error( 
+                    "Failed to parse playback header data" );
 
-        for( int i=0; i<numChildren; i++ ) {
-            delete childFiles[i];
+                }
+            delete [] readCustomGameData;                
             }
+        delete [] fullFileName;
         }
-    delete [] childFiles;
 
 
 
@@ -484,6 +497,9 @@ ScreenGL::ScreenGL( int inWide, int inHigh, char inFullScreen,
 
     mStartedFullScreen = mFullScreen;
 
+#ifndef HEADLESS_REPLAY
+    // headless replay opens no window and no GL context
+
     setupSurface();
     
 
@@ -494,6 +510,7 @@ ScreenGL::ScreenGL( int inWide, int inHigh, char inFullScreen,
     SDL_EnableKeyRepeat( 0, 0 );
 
     SDL_EnableUNICODE( true );
+#endif
     
     
     
@@ -525,6 +542,16 @@ ScreenGL::~ScreenGL() {
         writeEventBatchToFile();
         }
     
+    if( mRecordingWriter != NULL ) {
+        // writes last block
+        delete mRecordingWriter;
+        mRecordingWriter = NULL;
+        }
+    if( mRecordingReader != NULL ) {
+        delete mRecordingReader;
+        mRecordingReader = NULL;
+        }
+
     if( mEventFile != NULL ) {
         fclose( mEventFile );
         mEventFile = NULL;
@@ -549,11 +576,11 @@ ScreenGL::~ScreenGL() {
     for( int i=0; i<mPendingSocketEvents.size(); i++ ) {
         SocketEvent *e = mPendingSocketEvents.getElement( i );
         
-        if( e->bodyBytesHex != NULL ) {
+        if( e->bodyBytes != NULL ) {
             
-            delete [] e->bodyBytesHex;
+            delete [] e->bodyBytes;
         
-            e->bodyBytesHex = NULL;
+            e->bodyBytes = NULL;
             }
         
         }
@@ -596,7 +623,7 @@ void ScreenGL::startRecordingOrPlayback() {
         // next file number in sequence, after max found
         fileNumber++;
 
-        char *fileName = autoSprintf( "recordedGame%06d.txt", 
+        char *fileName = autoSprintf( "recordedGame%06d.rec", 
                                       fileNumber );
         File *file = recordedGameDir.getChildFile( fileName );
         
@@ -604,7 +631,7 @@ void ScreenGL::startRecordingOrPlayback() {
             
         char *fullFileName = file->getFullFileName();
                 
-        mEventFile = fopen( fullFileName, "w" );
+        mEventFile = fopen( fullFileName, "wb" );
         
         if( mEventFile == NULL ) {
             AppLog::error( "Failed to open event recording file" );
@@ -628,15 +655,21 @@ void ScreenGL::startRecordingOrPlayback() {
             delete [] stringToHash;
             
             
-            fprintf( mEventFile, 
-                     "%u seed, %u fps, %dx%d, fullScreen=%d, %s %s\n",
-                     mRandSeed,
-                     mMaxFrameRate, mWide, mHigh, fullScreenFlag,
-                     mCustomRecordedGameData,
-                     correctHash );
+            char *headerLine = 
+                autoSprintf( 
+                    "%u seed, %u fps, %dx%d, fullScreen=%d, %s %s\n",
+                    mRandSeed,
+                    mMaxFrameRate, mWide, mHigh, fullScreenFlag,
+                    mCustomRecordedGameData,
+                    correctHash );
             
             delete [] correctHash;
             
+            // keyframe once a minute at full frame rate
+            mRecordingWriter = new RecordingWriter( mEventFile, headerLine,
+                                                    60 * mFullFrameRate );
+            delete [] headerLine;
+            
         
             delete [] fullFileName;                
             }
@@ -656,30 +689,25 @@ void ScreenGL::startRecordingOrPlayback() {
             
             int numRemoved = 0;
             
-            for( int f=1; f<cutOffNumber; f++ ) {
-                // handle removing both old 5-digit format and new 6-digit 
-                // format
-                char *fileName = autoSprintf( "recordedGame%05d.txt", f );
-                File *file = recordedGameDir.getChildFile( fileName );
-                
-                delete [] fileName;
-                
-                if( file->exists() ) {
-                    file->remove();
-                    numRemoved++;
-                    }
-                delete file;
-                
-                fileName = autoSprintf( "recordedGame%06d.txt", f );
-                file = recordedGameDir.getChildFile( fileName );
+            const char *formats[3] = { "recordedGame%05d.txt",
+                                       "recordedGame%06d.txt",
+                                       "recordedGame%06d.rec" };
             
-                delete [] fileName;
-            
-                if( file->exists() ) {
-                    file->remove();
-                    numRemoved++;
+            for( int f=1; f<cutOffNumber; f++ ) {
+                // handle removing old 5-digit and 6-digit text formats
+                // along with binary format
+                for( int j=0; j<3; j++ ) {
+                    char *fileName = autoSprintf( formats[j], f );
+                    File *file = recordedGameDir.getChildFile( fileName );
+                    
+                    delete [] fileName;
+                    
+                    if( file->exists() ) {
+                        file->remove();
+                        numRemoved++;
+                        }
+                    delete file;
                     }
-                delete file;
                 }
             AppLog::getLog()->logPrintf( 
                 Log::INFO_LEVEL,
@@ -1069,35 +1097,20 @@ void ScreenGL::registerWebEvent( int inHandle,
         return;
         }
     
-        
-    char *eventString;
-
+    
     // only event type 2 has a body text payload
     if( inType == 2 ) {
         if( inBodyLength == -1 ) {
-            
-            eventString = autoSprintf( "wb %u %d %u %s", inHandle, 
-                                       inType, 
-                                       strlen( inBodyString ), inBodyString );
+            inBodyLength = strlen( inBodyString );
             }
-        else {
-
-            char *bodyHex = hexEncode( (unsigned char*)inBodyString, 
-                                       inBodyLength );
 
-            eventString = autoSprintf( "wx %u %d %u %s", inHandle, 
-                                       inType, 
-                                       strlen( bodyHex ), bodyHex );
-            
-            delete [] bodyHex;
-            }
+        mEventBatch.addBodyEvent( RECORDED_WEB, inHandle, inType, 0,
+                                  (unsigned char*)inBodyString, 
+                                  inBodyLength );
         }
     else {
-        eventString = autoSprintf( "wb %u %d", inHandle, inType );
+        mEventBatch.addEvent( RECORDED_WEB, inHandle, inType );
         }
-
-    
-    mEventBatch.push_back( eventString );
     }
 
 
@@ -1162,26 +1175,17 @@ void ScreenGL::registerSocketEvent( int inHandle,
         return;
         }
     
-        
-    char *eventString;
     
     // only event type 2 has a body byte payload
     if( inType == 2 && inNumBodyBytes != 0 ) {
-
-        char *bodyHex = hexEncode( inBodyBytes, inNumBodyBytes );
-
-        eventString = autoSprintf( "xs %u %d %u %s", inHandle, 
-                                   inType, 
-                                   inNumBodyBytes, bodyHex );
-        delete [] bodyHex;
+        mEventBatch.addBodyEvent( RECORDED_SOCKET, inHandle, inType,
+                                  inNumBodyBytes, 
+                                  inBodyBytes, inNumBodyBytes );
         }
     else {
-        eventString = autoSprintf( "xs %u %d %d", inHandle, inType,
-                                   inNumBodyBytes );
+        mEventBatch.addEvent( RECORDED_SOCKET, inHandle, inType,
+                              inNumBodyBytes );
         }
-
-    
-    mEventBatch.push_back( eventString );
     }
 
 
@@ -1220,13 +1224,8 @@ unsigned char *ScreenGL::getSocketEventBodyBytes( int inHandle ) {
         if( e->handle == inHandle ) {
             
             
-            unsigned char *returnValue = NULL;
-
-            if( e->bodyBytesHex != NULL ) {
-                returnValue = hexDecode( e->bodyBytesHex );
-            
-                delete [] e->bodyBytesHex;
-                }
+            // caller destroys
+            unsigned char *returnValue = e->bodyBytes;
             
             mPendingSocketEvents.deleteElement( i );
 
@@ -1249,10 +1248,8 @@ void ScreenGL::registerAsyncFileDone( int inHandle ) {
         return;
         }
     
-        
-    char *eventString = autoSprintf( "af %d", inHandle );
     
-    mEventBatch.push_back( eventString );
+    mEventBatch.addEvent( RECORDED_ASYNC_FILE_DONE, inHandle );
     }
 
 
@@ -1264,55 +1261,114 @@ char ScreenGL::getAsyncFileDone( int inHandle ) {
 
 
 
-void ScreenGL::writeEventBatchToFile( SimpleVector<char*> *inBatch ) {
-    int numInBatch = inBatch->size();
-        
-    if( mEventFile != NULL ) {
-        if( numInBatch > 0 ) {
-            
-            char **allEvents = inBatch->getElementArray();
-            char *eventString = join( allEvents, numInBatch, " " );
-            
-        
-            int eventStringLength = strlen( eventString );
-            
-            int numWritten = fwrite( eventString, 1, eventStringLength, 
-                                     mEventFile );
-            
-            if( numWritten != eventStringLength ) {
-                printf( "Failed to write %d-event batch of length %d "
-                        "to recording file\n", numInBatch, eventStringLength );
-                }
-
-            delete [] allEvents;
-            delete [] eventString;
-            }
-        
+void ScreenGL::writeEventBatchToFile() {
+    if( mRecordingWriter == NULL ) {
+        mEventBatch.clear();
+        mUserEventBatch.clear();
+        return;
         }
-            
-    for( int i=0; i<numInBatch; i++ ) {
-        delete [] *( inBatch->getElement( i ) );
+    
+    unsigned char *snapshot = NULL;
+    int snapshotLength = 0;
+    
+    if( mSaveSnapshot != NULL && mRecordingWriter->isKeyframeNext() ) {
+        snapshot = mSaveSnapshot( &snapshotLength );
+        }
+
+    // written a block at a time
+    mRecordingWriter->writeFrame( &mEventBatch, &mUserEventBatch,
+                                  snapshot, snapshotLength );
+
+    if( snapshot != NULL ) {
+        delete [] snapshot;
         }
-    inBatch->deleteAll();
     }
 
 
 
+void ScreenGL::setSnapshotFunctions( 
+    unsigned char *( *inSave )( int *outLength ),
+    char ( *inRestore )( unsigned char *inSnapshot, int inLength ) ) {
 
-void ScreenGL::writeEventBatchToFile() {
-    int num = mEventBatch.size() + mUserEventBatch.size();
+    mSaveSnapshot = inSave;
+    mRestoreSnapshot = inRestore;
+    }
+
+
+
+int ScreenGL::seekPlayback( int inFrame ) {
+    if( ! mPlaybackEvents || mRecordingReader == NULL ||
+        mRestoreSnapshot == NULL ) {
+        return -1;
+        }
     
-    fprintf( mEventFile, "%d ", num );
+    if( inFrame < 0 ) {
+        inFrame = 0;
+        }
+
+    if( ! mRecordingReader->seekToKeyframe( inFrame, true, 
+                                            &mPendingKeyframe ) ) {
+        return -1;
+        }
+    
+    // snapshot is valid until the next frame is read, restore it then
+    mSeekPending = true;
+
+    return mPendingKeyframe.frame;
+    }
+
+
 
-    writeEventBatchToFile( &mEventBatch );
+void ScreenGL::applyPendingSeek() {
+    mSeekPending = false;
+    
+    if( ! mRestoreSnapshot( mPendingKeyframe.snapshot,
+                            mPendingKeyframe.snapshotLength ) ) {
+        AppLog::error( "Failed to restore game snapshot from playback file" );
+        }
+    
+    if( mPendingKeyframe.hasTime ) {
+        mLastTimeValue = mPendingKeyframe.time;
+        mTimeValuePlayedBack = true;
+        }
+    if( mPendingKeyframe.hasCurrentTime ) {
+        mLastCurrentTimeValue = mPendingKeyframe.currentTime;
+        mTimeValuePlayedBack = true;
+        }
+    if( mPendingKeyframe.hasFrameRate ) {
+        mLastActualFrameRate = mPendingKeyframe.frameRate;
+        }
+    
+    mLastAsyncFileHandleDone = mPendingKeyframe.lastAsyncFileDone;
+    
+    if( mPendingKeyframe.lastWebHandle > mLastReadWebEventHandle ) {
+        // skipped ahead, new handles start fresh
+        mCurrentWebEventHandle = mNextUnusedWebEventHandle;
+        mNextUnusedWebEventHandle++;
+        }
+    mLastReadWebEventHandle = mPendingKeyframe.lastWebHandle;
     
-    fprintf( mEventFile, " " );
 
-    writeEventBatchToFile( &mUserEventBatch );
+    // results in flight belong to the abandoned timeline
+    for( int i=0; i<mPendingWebEvents.size(); i++ ) {
+        WebEvent *e = mPendingWebEvents.getElement( i );
+        if( e->bodyText != NULL ) {
+            delete [] e->bodyText;
+            }
+        }
+    mPendingWebEvents.deleteAll();
     
-    fprintf( mEventFile, "\n" );
+    for( int i=0; i<mPendingSocketEvents.size(); i++ ) {
+        SocketEvent *e = mPendingSocketEvents.getElement( i );
+        if( e->bodyBytes != NULL ) {
+            delete [] e->bodyBytes;
+            }
+        }
+    mPendingSocketEvents.deleteAll();
 
-    fflush( mEventFile );
+    mNumBatchesPlayed = mPendingKeyframe.frame;
+    
+    AppLog::infoF( "Playback moved to frame %d", mNumBatchesPlayed );
     }
 
 
@@ -1324,270 +1380,157 @@ void ScreenGL::playNextEventBatch() {
     mLastTimeValueStack.deleteAll();
     mLastCurrentTimeValueStack.deleteAll();
     
+    if( mSeekPending ) {
+        applyPendingSeek();
+        }
 
     // read and playback next batch
-    int batchSize = 0;
-    int numRead = fscanf( mEventFile, "%d", &batchSize );
-            
-    if( numRead == 0 || numRead == EOF ) {
+    mPlaybackFrameEvents.shrink( 0 );
+    
+    if( ! mRecordingReader->readFrame( &mPlaybackFrameEvents ) ) {
         printf( "Reached end of recorded event file during playback\n" );
         // stop playback
         mPlaybackEvents = false;
         }
     
+    int batchSize = mPlaybackFrameEvents.size();
 
     for( int i=0; i<batchSize; i++ ) {
-                
-        char code[3];
-        code[0] = '\0';
-                
-        fscanf( mEventFile, "%2s", code );
-                
-        switch( code[0] ) {
-            case 'm':
-                switch( code[1] ) {
-                    case 'm': {
-                        int x, y;
-                        fscanf( mEventFile, "%d %d", &x, &y );
-                                
-                        callbackPassiveMotion( x, y );
-                        }
-                        break;
-                    case 'd': {
-                        int x, y;
-                        fscanf( mEventFile, "%d %d", &x, &y );
-                                
-                        callbackMotion( x, y );
-                        }
-                        break;
-                    case 'b': {
-                        int button, state, x, y;
-                        fscanf( mEventFile, "%d %d %d %d", 
-                                &button, &state, &x, &y );
-                                
-                        if( state == 1 ) {
-                            state = SDL_PRESSED;
-                            }
-                        else {
-                            state = SDL_RELEASED;
-                            }
-                        
-                        callbackMouse( button, state, x, y );
-                        }
-                        break;
-                    }
-                break;
-            case 'k': {
-                int c, x, y;
-                fscanf( mEventFile, "%d %d %d", &c, &x, &y );
-
-                switch( code[1] ) {
-                    case 'd':          
-                        callbackKeyboard( c, x, y );
-                        break;
-                    case 'u':
-                        callbackKeyboardUp( c, x, y );                        
-                        break;
-                    }
-                }
-                break;
-            case 's': {
-                int c, x, y;
-                fscanf( mEventFile, "%d %d %d", &c, &x, &y );
-
-                switch( code[1] ) {
-                    case 'd':          
-                        callbackSpecialKeyboard( c, x, y );
-                        break;
-                    case 'u':
-                        callbackSpecialKeyboardUp( c, x, y );
-                        break;
-                    }
-                }
-                break;
-            case 't': {
-                fscanf( mEventFile, "%lf", &mLastTimeValue );
-                mLastTimeValueStack.push_back( mLastTimeValue );
-                mTimeValuePlayedBack = true;
-                }
-                break;
-            case 'r': {
-                // repeat last time value
-                mLastTimeValueStack.push_back( mLastTimeValue );
-                mTimeValuePlayedBack = true;
-                }
-                break;
-            case 'T': {
-                double t;
-                fscanf( mEventFile, "%lf", &t );
-                mLastCurrentTimeValue = t;
-                mLastCurrentTimeValueStack.push_back( mLastCurrentTimeValue );
-                mTimeValuePlayedBack = true;
-                }
-                break;
-            case 'R': {
-                // repeat last time value
-                mLastCurrentTimeValueStack.push_back( mLastCurrentTimeValue );
-                mTimeValuePlayedBack = true;
-                }
-                break;
-            case 'F': {
-                double fps;
-                fscanf( mEventFile, "%lf", &fps );
-                mLastActualFrameRate = fps;
-                }
-                break;
-            case 'v': {
-                mLastMinimizedStatus = true;
-                }
-                break;
-            case 'w': {
-                // special case:  incoming web event
-                // (simulating response from a web server during playback)
-                
-                WebEvent e;
-                fscanf( mEventFile, "%d %d", &( e.handle ), &( e.type ) );
-                
-                if( e.handle > mLastReadWebEventHandle ) {
-                    mLastReadWebEventHandle = e.handle;
-                    e.handle = mNextUnusedWebEventHandle;
-                    mCurrentWebEventHandle = e.handle;
-                    
-                    mNextUnusedWebEventHandle++;
-                    }
-                else {
-                    e.handle = mCurrentWebEventHandle;
-                    }
-
-                e.bodyText = NULL;
-                e.bodyLength = 0;
-                
-                if( e.type == 2 ) {
-                    // includes a body payload
+        playRecordedEvent( mPlaybackFrameEvents.getElement( i ) );
+        }
 
-                    unsigned int length;
-                    
-                    fscanf( mEventFile, "%u", &length );
 
-                    // skip the space after length
-                    fgetc( mEventFile );
-                
-                
-                    if( code[1] == 'b' ) {
-                        // plain text body
-                        e.bodyLength = length;
-                        e.bodyText = new char[ length + 1 ];
-                
-                        unsigned int numRead = 
-                            fread( e.bodyText, 1, length, mEventFile );
-                
-                        e.bodyText[ length ] = '\0';
-
-                        if( numRead != length ) {
-                            AppLog::error( 
-                                "Failed to read web event body text from "
-                                "playback file" );
-                            delete [] e.bodyText;
-                            e.bodyText = NULL;
-                            e.bodyLength = 0;
-                            }
-                        }
-                    else if( code[1] == 'x' ) {
-                        // hex-encoded body
-                        char *bodyHex = new char[ length + 1 ];
-                        
-                        unsigned int numRead = 
-                            fread( bodyHex, 1, length, mEventFile );
-                
-                        bodyHex[ length ] = '\0';
-
-                        if( numRead != length ) {
-                            AppLog::error( 
-                                "Failed to read web event body hex from "
-                                "playback file" );
-                            e.bodyText = NULL;
-                            e.bodyLength = 0;
-                            }
-                        else {
-                            unsigned char *bodyDecoded 
-                                = hexDecode( bodyHex );
-                            
-                            e.bodyLength = length / 2;
-                            e.bodyText = new char[ e.bodyLength + 1 ];
-                            
-                            memcpy( e.bodyText, bodyDecoded, e.bodyLength );
-                            
-                            e.bodyText[ e.bodyLength ] = '\0';
-                            
-                            delete [] bodyDecoded;
-                            }
-                        delete [] bodyHex;
-                        }
-                    }
-                
-                mPendingWebEvents.push_back( e );
-                break;
-                }
-            case 'x': {
-                // special case:  incoming socket event
-                // (simulating response from a socket server during playback)
-                
-                SocketEvent e;
-                fscanf( mEventFile, "%d %d %d", 
-                        &( e.handle ), &( e.type ), &( e.numBodyBytes ) );
+    mNumBatchesPlayed++;
+    }
 
-                e.bodyBytesHex = NULL;
 
-                if( e.type == 2 && e.numBodyBytes != 0 ) {
-                    // includes a body payload
 
-                    // skip the space after numBodyBytes
-                    fgetc( mEventFile );
+void ScreenGL::playRecordedEvent( RecordedEvent *inEvent ) {
+    int *v = inEvent->values;
+    
+    switch( inEvent->type ) {
+        case RECORDED_MOUSE_MOVE:
+            callbackPassiveMotion( v[0], v[1] );
+            break;
+        case RECORDED_MOUSE_DRAG:
+            callbackMotion( v[0], v[1] );
+            break;
+        case RECORDED_MOUSE_BUTTON: {
+            int state;
+            if( v[1] == 1 ) {
+                state = SDL_PRESSED;
+                }
+            else {
+                state = SDL_RELEASED;
+                }
+            
+            callbackMouse( v[0], state, v[2], v[3] );
+            }
+            break;
+        case RECORDED_KEY_DOWN:
+            callbackKeyboard( v[0], v[1], v[2] );
+            break;
+        case RECORDED_KEY_UP:
+            callbackKeyboardUp( v[0], v[1], v[2] );
+            break;
+        case RECORDED_SPECIAL_KEY_DOWN:
+            callbackSpecialKeyboard( v[0], v[1], v[2] );
+            break;
+        case RECORDED_SPECIAL_KEY_UP:
+            callbackSpecialKeyboardUp( v[0], v[1], v[2] );
+            break;
+        case RECORDED_TIME:
+            mLastTimeValue = inEvent->time;
+            mLastTimeValueStack.push_back( mLastTimeValue );
+            mTimeValuePlayedBack = true;
+            break;
+        case RECORDED_TIME_REPEAT:
+            // repeat last time value
+            mLastTimeValueStack.push_back( mLastTimeValue );
+            mTimeValuePlayedBack = true;
+            break;
+        case RECORDED_CURRENT_TIME:
+            mLastCurrentTimeValue = inEvent->time;
+            mLastCurrentTimeValueStack.push_back( mLastCurrentTimeValue );
+            mTimeValuePlayedBack = true;
+            break;
+        case RECORDED_CURRENT_TIME_REPEAT:
+            // repeat last time value
+            mLastCurrentTimeValueStack.push_back( mLastCurrentTimeValue );
+            mTimeValuePlayedBack = true;
+            break;
+        case RECORDED_FRAME_RATE:
+            mLastActualFrameRate = inEvent->time;
+            break;
+        case RECORDED_MINIMIZED:
+            mLastMinimizedStatus = true;
+            break;
+        case RECORDED_WEB: {
+            // special case:  incoming web event
+            // (simulating response from a web server during playback)
                 
-                    unsigned int hexLength = e.numBodyBytes * 2;
-                    
+            WebEvent e;
+            e.handle = v[0];
+            e.type = v[1];
+            
+            if( e.handle > mLastReadWebEventHandle ) {
+                mLastReadWebEventHandle = e.handle;
+                e.handle = mNextUnusedWebEventHandle;
+                mCurrentWebEventHandle = e.handle;
+                
+                mNextUnusedWebEventHandle++;
+                }
+            else {
+                e.handle = mCurrentWebEventHandle;
+                }
 
-                    e.bodyBytesHex = new char[ hexLength + 1 ];
+            e.bodyText = NULL;
+            e.bodyLength = 0;
                 
-                    unsigned int numRead = 
-                        fread( e.bodyBytesHex, 1, hexLength, mEventFile );
+            if( e.type == 2 && inEvent->body != NULL ) {
+                // includes a body payload
+                e.bodyLength = inEvent->bodyLength;
+                e.bodyText = new char[ e.bodyLength + 1 ];
                 
-                    e.bodyBytesHex[ hexLength ] = '\0';
-
-                    if( numRead != hexLength ) {
-                        AppLog::error( 
-                            "Failed to read socket event body hex from "
-                            "playback file" );
-                        delete [] e.bodyBytesHex;
-                        e.bodyBytesHex = NULL;
-                        }
-                    }
+                memcpy( e.bodyText, inEvent->body, e.bodyLength );
                 
-                mPendingSocketEvents.push_back( e );
-                break;
+                e.bodyText[ e.bodyLength ] = '\0';
                 }
-            case 'a': {
-                int nextHandle;
-                fscanf( mEventFile, "%d", &nextHandle );
                 
-                if( nextHandle > mLastAsyncFileHandleDone ) {
-                    // track the largest handle seen done so far
-                    // (async files are ready in handle order)
-                    mLastAsyncFileHandleDone = nextHandle;
-                    }
+            mPendingWebEvents.push_back( e );
+            }
+            break;
+        case RECORDED_SOCKET: {
+            // special case:  incoming socket event
+            // (simulating response from a socket server during playback)
+
+            SocketEvent e;
+            e.handle = v[0];
+            e.type = v[1];
+            e.numBodyBytes = v[2];
+            e.bodyBytes = NULL;
+            
+            if( inEvent->body != NULL ) {
+                e.bodyBytes = new unsigned char[ inEvent->bodyLength ];
+                memcpy( e.bodyBytes, inEvent->body, inEvent->bodyLength );
                 }
-                break;
-            default:
-                AppLog::getLog()->logPrintf( 
-                    Log::ERROR_LEVEL, 
-                    "Unknown code '%s' in playback file\n",
-                    code );
-            }            
-        
+            
+            mPendingSocketEvents.push_back( e );
+            }
+            break;
+        case RECORDED_ASYNC_FILE_DONE:
+            if( v[0] > mLastAsyncFileHandleDone ) {
+                // track the largest handle seen done so far
+                // (async files are ready in handle order)
+                mLastAsyncFileHandleDone = v[0];
+                }
+            break;
+        default:
+            AppLog::getLog()->logPrintf( 
+                Log::ERROR_LEVEL, 
+                "Unknown event type %d in playback file\n",
+                inEvent->type );
         }
-
-
-    mNumBatchesPlayed++;
     }
 
 
@@ -1649,9 +1592,7 @@ char ScreenGL::isMinimized() {
         
         // record it 
         
-        char *eventString = stringDuplicate( "v" );
-        
-        mEventBatch.push_back( eventString );
+        mEventBatch.addEvent( RECORDED_MINIMIZED );
         }
     
 
@@ -1759,10 +1700,8 @@ void ScreenGL::start() {
         
                     int mouseX, mouseY;
                     SDL_GetMouseState( &mouseX, &mouseY );
-                    char *eventString = autoSprintf( "kd %d %d %d", 
-                                                     9, mouseX, mouseY );
-        
-                    mUserEventBatch.push_back( eventString );
+                    mUserEventBatch.addEvent( RECORDED_KEY_DOWN,
+                                              9, mouseX, mouseY );
                     }
                 }
             // handle alt-tab to minimize out of full-screen mode
@@ -1801,10 +1740,8 @@ void ScreenGL::start() {
                     
                     int mouseX, mouseY;
                     SDL_GetMouseState( &mouseX, &mouseY );
-                    char *eventString = autoSprintf( "kd %d %d %d", 
-                                                     9, mouseX, mouseY );
-        
-                    mUserEventBatch.push_back( eventString );
+                    mUserEventBatch.addEvent( RECORDED_KEY_DOWN,
+                                              9, mouseX, mouseY );
                     }
                 }
             // active event after minimizing from windowed mode
@@ -2087,6 +2024,21 @@ void ScreenGL::start() {
                                     // fast fast fast forward
                                     setMaxFrameRate( mFullFrameRate * 8 );
                                     }
+                                else if( asciiKey == '<' ) {
+                                    // back a minute, to a keyframe
+                                    seekPlayback( mNumBatchesPlayed -
+                                                  60 * mFullFrameRate );
+                                    }
+                                else if( asciiKey == '>' ) {
+                                    // ahead a minute, if recording
+                                    // goes that far
+                                    int target = mNumBatchesPlayed +
+                                        60 * mFullFrameRate;
+
+                                    if( target < mEventFileNumBatches ) {
+                                        seekPlayback( target );
+                                        }
+                                    }
                                 }
                             }
                         }                    
@@ -2155,6 +2107,8 @@ void ScreenGL::start() {
             }
         
         
+#ifndef HEADLESS_REPLAY
+        // headless replay plays frames back as fast as it can
         if( mUseFrameSleep ) {    
             // lock down to mMaxFrameRate frames per second
             int minFrameTime = 1000 / mMaxFrameRate;
@@ -2178,6 +2132,7 @@ void ScreenGL::start() {
                 oversleepMSec = 0;
                 }
             }
+#endif
         
         
         }
@@ -2244,17 +2199,13 @@ timeSec_t ScreenGL::getTimeSec() {
 
         if( currentTime != mLastRecordedTimeValue ) {
             
-            char *eventString = autoSprintf( "t %.f", currentTime );
-            
-            mEventBatch.push_back( eventString );
+            mEventBatch.addTimeEvent( RECORDED_TIME, currentTime );
             
             mLastRecordedTimeValue = currentTime;
             }
         else {
             // repeat, record short string to indicate this
-            char *eventString = stringDuplicate( "r" );
-            
-            mEventBatch.push_back( eventString );
+            mEventBatch.addEvent( RECORDED_TIME_REPEAT );
             }
         }
     
@@ -2294,17 +2245,13 @@ double ScreenGL::getCurrentTime() {
 
         if( currentTime != mLastRecordedCurrentTimeValue ) {
             
-            char *eventString = autoSprintf( "T %f", currentTime );
-            
-            mEventBatch.push_back( eventString );
+            mEventBatch.addTimeEvent( RECORDED_CURRENT_TIME, currentTime );
             
             mLastRecordedCurrentTimeValue = currentTime;
             }
         else {
             // repeat, record short string to indicate this
-            char *eventString = stringDuplicate( "R" );
-            
-            mEventBatch.push_back( eventString );
+            mEventBatch.addEvent( RECORDED_CURRENT_TIME_REPEAT );
             }
         }
     
@@ -2318,9 +2265,7 @@ void ScreenGL::registerActualFrameRate( double inFrameRate ) {
     if( mRecordingEvents && 
         mRecordingOrPlaybackStarted ) {
         
-        char *eventString = autoSprintf( "F %lf", inFrameRate );
-            
-        mEventBatch.push_back( eventString );
+        mEventBatch.addTimeEvent( RECORDED_FRAME_RATE, inFrameRate );
         }
     }
 
@@ -2464,10 +2409,12 @@ void callbackResize( int inW, int inH ) {
     int excessH = s->mHigh - bigDimension;
     
     // viewport is square of biggest image dimension, centered on screen
+#ifndef HEADLESS_REPLAY
     glViewport( excessW / 2,
                 excessH / 2, 
                 bigDimension,
                 bigDimension );
+#endif
     }
 
 
@@ -2491,10 +2438,8 @@ void callbackKeyboard( unsigned char inKey, int inX, int inY ) {
             keyToRecord = currentScreenGL->mCharToRecordInstead;
             }
 
-        char *eventString = autoSprintf( "kd %d %d %d", 
-                                         keyToRecord, inX, inY );
-        
-        currentScreenGL->mUserEventBatch.push_back( eventString );
+        currentScreenGL->mUserEventBatch.addEvent( RECORDED_KEY_DOWN,
+                                                   keyToRecord, inX, inY );
         }
 
 
@@ -2563,10 +2508,8 @@ void callbackKeyboardUp( unsigned char inKey, int inX, int inY ) {
             keyToRecord = currentScreenGL->mCharToRecordInstead;
             }
 
-        char *eventString = autoSprintf( "ku %d %d %d", 
-                                         keyToRecord, inX, inY );
-        
-        currentScreenGL->mUserEventBatch.push_back( eventString );
+        currentScreenGL->mUserEventBatch.addEvent( RECORDED_KEY_UP,
+                                                   keyToRecord, inX, inY );
         }
 
 	char someFocused = currentScreenGL->isKeyboardHandlerFocused();
@@ -2620,9 +2563,8 @@ void callbackSpecialKeyboard( int inKey, int inX, int inY ) {
     if( currentScreenGL->mRecordingEvents &&
         currentScreenGL->mRecordingOrPlaybackStarted ) {
 
-        char *eventString = autoSprintf( "sd %d %d %d", inKey, inX, inY );
-        
-        currentScreenGL->mUserEventBatch.push_back( eventString );
+        currentScreenGL->mUserEventBatch.addEvent( RECORDED_SPECIAL_KEY_DOWN,
+                                                   inKey, inX, inY );
         }
 
 
@@ -2676,9 +2618,8 @@ void callbackSpecialKeyboardUp( int inKey, int inX, int inY ) {
     if( currentScreenGL->mRecordingEvents &&
         currentScreenGL->mRecordingOrPlaybackStarted ) {
 
-        char *eventString = autoSprintf( "su %d %d %d", inKey, inX, inY );
-        
-        currentScreenGL->mUserEventBatch.push_back( eventString );
+        currentScreenGL->mUserEventBatch.addEvent( RECORDED_SPECIAL_KEY_UP,
+                                                   inKey, inX, inY );
         }
 
 
@@ -2732,9 +2673,8 @@ void callbackMotion( int inX, int inY ) {
     if( currentScreenGL->mRecordingEvents && 
         currentScreenGL->mRecordingOrPlaybackStarted ) {
 
-        char *eventString = autoSprintf( "md %d %d", inX, inY );
-        
-        currentScreenGL->mUserEventBatch.push_back( eventString );
+        currentScreenGL->mUserEventBatch.addEvent( RECORDED_MOUSE_DRAG,
+                                                   inX, inY );
         }
 
 	// fire to all handlers
@@ -2773,9 +2713,8 @@ void callbackPassiveMotion( int inX, int inY ) {
     if( currentScreenGL->mRecordingEvents &&
         currentScreenGL->mRecordingOrPlaybackStarted ) {
 
-        char *eventString = autoSprintf( "mm %d %d", inX, inY );
-        
-        currentScreenGL->mUserEventBatch.push_back( eventString );
+        currentScreenGL->mUserEventBatch.addEvent( RECORDED_MOUSE_MOVE,
+                                                   inX, inY );
         }
 
 	// fire to all handlers
@@ -2846,10 +2785,9 @@ void callbackMouse( int inButton, int inState, int inX, int inY ) {
             stateEncoding = 1;
             }
         
-        char *eventString = autoSprintf( "mb %d %d %d %d",
-                                         inButton, stateEncoding, inX, inY );
-        
-        currentScreenGL->mUserEventBatch.push_back( eventString );
+        currentScreenGL->mUserEventBatch.addEvent( RECORDED_MOUSE_BUTTON,
+                                                   inButton, stateEncoding,
+                                                   inX, inY );
         }
     
 
@@ -2900,7 +2838,9 @@ void callbackMouse( int inButton, int inState, int inX, int inY ) {
 void callbackPreDisplay() {
 	ScreenGL *s = currentScreenGL;
 	
+#ifndef HEADLESS_REPLAY
 	glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
+#endif
 
 
     // fire to all redraw listeners
@@ -2937,7 +2877,9 @@ void callbackDisplay() {
 		listener->postRedraw();
 		}
 
-#ifdef RASPBIAN
+#ifdef HEADLESS_REPLAY
+    // nothing to show
+#elif defined( RASPBIAN )
     raspbianSwapBuffers();
 #else
 	SDL_GL_SwapBuffers();
@@ -2947,7 +2889,9 @@ void callbackDisplay() {
     // the next redraw (for pretty minimization)
     if( s->mWantToMimimize ) {
         s->mWantToMimimize = false;
+#ifndef HEADLESS_REPLAY
         SDL_WM_IconifyWindow();
+#endif
         s->mMinimized = true;
         }
     }
@@ -160,6 +160,11 @@ SingleTextureGL::~SingleTextureGL() {
 	sAllLoadedTextures.deleteElementEqualTo( this );
     
     glDeleteTextures( 1, &mTextureID );
+
+    if( sLastBoundTextureID == mTextureID ) {
+        // GL reverts to default texture, and ID can be reused
+        sLastBoundTextureID = 0;
+        }
 	
     if( mBackupBytes != NULL ) {
         delete [] mBackupBytes;
@@ -218,151 +223,158 @@ void SingleTextureGL::replaceBackupData( unsigned char *inBytes,
 
 
 
-void SingleTextureGL::setTextureData( unsigned char *inBytes,
-                                      char inAlphaOnly,
-                                      unsigned int inWidth, 
-                                      unsigned int inHeight,
-                                      char inExpandEdge ) {
+void SingleTextureGL::expandEdges( unsigned char *inBytes,
+                                   unsigned int inWidth,
+                                   unsigned int inHeight ) {
     
-    if( inExpandEdge && !inAlphaOnly ) {
-        
-        unsigned int maxY = 0;
-        unsigned int minY = inHeight - 1;
-        
-        unsigned int maxX = 0;
-        unsigned int minX = inWidth - 1;
-        
-        int aIndex = 3;
-        for( unsigned int y=0; y<inHeight; y++ ) {
-            for( unsigned int x=0; x<inWidth; x++ ) {
-                
-                if( inBytes[ aIndex ] > 0 ) {    
-                    if( x > maxX ) {
-                        maxX = x;
-                        }
-                    if( x < minX ) {
-                        minX = x;
-                        }
-                    if( y > maxY ) {
-                        maxY = y;
-                        }
-                    if( y < minY ) {
-                        minY = y;
-                        }
+    unsigned int maxY = 0;
+    unsigned int minY = inHeight - 1;
+    
+    unsigned int maxX = 0;
+    unsigned int minX = inWidth - 1;
+    
+    int aIndex = 3;
+    for( unsigned int y=0; y<inHeight; y++ ) {
+        for( unsigned int x=0; x<inWidth; x++ ) {
+            
+            if( inBytes[ aIndex ] > 0 ) {    
+                if( x > maxX ) {
+                    maxX = x;
+                    }
+                if( x < minX ) {
+                    minX = x;
+                    }
+                if( y > maxY ) {
+                    maxY = y;
+                    }
+                if( y < minY ) {
+                    minY = y;
                     }
-
-                aIndex += 4;
                 }
+
+            aIndex += 4;
             }
+        }
 
-        if( minY < maxY &&
-            minX < maxX &&
-            minY > 0 &&
-            maxY < inHeight - 1 &&  
-            minX > 0 &&
-            maxX < inWidth - 1 ) {
+    if( minY < maxY &&
+        minX < maxX &&
+        minY > 0 &&
+        maxY < inHeight - 1 &&  
+        minX > 0 &&
+        maxX < inWidth - 1 ) {
 
-            // found edges away from image edge
+        // found edges away from image edge
 
-            // duplicate them
-            
-            // row edges
+        // duplicate them
 
-            int rowBytes = inWidth * 4;
+        // row edges
 
-            int rowStart = minY * rowBytes;
-            int rowDestStart = rowStart - rowBytes;
+        int rowBytes = inWidth * 4;
 
-            // don't duplicate row unless it has some fully-opaque
-            // pixels in it (it's something of a hard edge)
-            // thus, we don't accidentally expand the soft edges
-            // of feathered sprites, fonts, etc
-            char solidPresent = false;
-            
-            for( int i=rowStart + 3; i<rowStart + rowBytes; i+=4 ) {
-                if( inBytes[i] == 255 ) {
-                    solidPresent = true;
-                    break;
-                    }
-                }
+        int rowStart = minY * rowBytes;
+        int rowDestStart = rowStart - rowBytes;
 
-            if( solidPresent ) {
-                memcpy( &( inBytes[ rowDestStart ] ), 
-                        &( inBytes[ rowStart ] ), 
-                        inWidth * 4 );
+        // don't duplicate row unless it has some fully-opaque
+        // pixels in it (it's something of a hard edge)
+        // thus, we don't accidentally expand the soft edges
+        // of feathered sprites, fonts, etc
+        char solidPresent = false;
+        
+        for( int i=rowStart + 3; i<rowStart + rowBytes; i+=4 ) {
+            if( inBytes[i] == 255 ) {
+                solidPresent = true;
+                break;
                 }
-            
-            rowStart = maxY * inWidth * 4;
-            rowDestStart = rowStart + inWidth * 4;
+            }
 
-            solidPresent = false;
+        if( solidPresent ) {
+            memcpy( &( inBytes[ rowDestStart ] ), 
+                    &( inBytes[ rowStart ] ), 
+                    inWidth * 4 );
+            }
+        
+        rowStart = maxY * inWidth * 4;
+        rowDestStart = rowStart + inWidth * 4;
 
-            for( int i=rowStart + 3; i<rowStart + rowBytes; i+=4 ) {
-                if( inBytes[i] == 255 ) {
-                    solidPresent = true;
-                    break;
-                    }
-                }
+        solidPresent = false;
 
-            if( solidPresent ) {
-                memcpy( &( inBytes[ rowDestStart ] ), 
-                        &( inBytes[ rowStart ] ), 
-                        inWidth * 4 );
+        for( int i=rowStart + 3; i<rowStart + rowBytes; i+=4 ) {
+            if( inBytes[i] == 255 ) {
+                solidPresent = true;
+                break;
                 }
-            
+            }
 
-            // now column edges
+        if( solidPresent ) {
+            memcpy( &( inBytes[ rowDestStart ] ), 
+                    &( inBytes[ rowStart ] ), 
+                    inWidth * 4 );
+            }
+        
 
-            char solidPresentLeft = false;
-            char solidPresentRight = false;
-            
-            for( unsigned int y=minY; y<=maxY; y++ ) {
+        // now column edges
 
-                int iL = (y * inWidth + minX) * 4;
+        char solidPresentLeft = false;
+        char solidPresentRight = false;
+        
+        for( unsigned int y=minY; y<=maxY; y++ ) {
 
-                if( inBytes[ iL + 3 ] == 255 ) {
-                    solidPresentLeft = true;
-                    break;
-                    }
+            int iL = (y * inWidth + minX) * 4;
+
+            if( inBytes[ iL + 3 ] == 255 ) {
+                solidPresentLeft = true;
+                break;
                 }
-            
-            for( unsigned int y=minY; y<=maxY; y++ ) {
+            }
+        
+        for( unsigned int y=minY; y<=maxY; y++ ) {
 
-                int iR = (y * inWidth + maxX) * 4;
+            int iR = (y * inWidth + maxX) * 4;
 
-                if( inBytes[ iR + 3 ] == 255 ) {
-                    solidPresentRight = true;
-                    break;
-                    }
+            if( inBytes[ iR + 3 ] == 255 ) {
+                solidPresentRight = true;
+                break;
                 }
-            
+            }
+        
 
-            if( solidPresentLeft ) {    
-                for( unsigned int y=minY; y<=maxY; y++ ) {
-                    int iL = (y * inWidth + minX) * 4;
-                    
-                    inBytes[iL - 4] = inBytes[ iL ];
-                    inBytes[iL - 3] = inBytes[ iL + 1 ];
-                    inBytes[iL - 2] = inBytes[ iL + 2 ];
-                    inBytes[iL - 1] = inBytes[ iL + 3 ];
-                    }
+        if( solidPresentLeft ) {    
+            for( unsigned int y=minY; y<=maxY; y++ ) {
+                int iL = (y * inWidth + minX) * 4;
+                
+                inBytes[iL - 4] = inBytes[ iL ];
+                inBytes[iL - 3] = inBytes[ iL + 1 ];
+                inBytes[iL - 2] = inBytes[ iL + 2 ];
+                inBytes[iL - 1] = inBytes[ iL + 3 ];
                 }
+            }
+        
             
-                
 
-            if( solidPresentRight ) {
-                for( unsigned int y=minY; y<=maxY; y++ ) {
-                    int iR = (y * inWidth + maxX) * 4;
-                    inBytes[iR + 4] = inBytes[ iR ];
-                    inBytes[iR + 5] = inBytes[ iR + 1 ];
-                    inBytes[iR + 6] = inBytes[ iR + 2 ];
-                    inBytes[iR + 7] = inBytes[ iR + 3 ];
-                    }
+        if( solidPresentRight ) {
+            for( unsigned int y=minY; y<=maxY; y++ ) {
+                int iR = (y * inWidth + maxX) * 4;
+                inBytes[iR + 4] = inBytes[ iR ];
+                inBytes[iR + 5] = inBytes[ iR + 1 ];
+                inBytes[iR + 6] = inBytes[ iR + 2 ];
+                inBytes[iR + 7] = inBytes[ iR + 3 ];
                 }
-            
             }
         
         }
+    }
+
+
+
+void SingleTextureGL::setTextureData( unsigned char *inBytes,
+                                      char inAlphaOnly,
+                                      unsigned int inWidth, 
+                                      unsigned int inHeight,
+                                      char inExpandEdge ) {
+    
+    if( inExpandEdge && !inAlphaOnly ) {
+        expandEdges( inBytes, inWidth, inHeight );
+        }
     
 
     replaceBackupData( inBytes, inAlphaOnly, inWidth, inHeight );
@@ -381,6 +393,7 @@ void SingleTextureGL::setTextureData( unsigned char *inBytes,
     
 
 	glBindTexture( GL_TEXTURE_2D, mTextureID );
+    sLastBoundTextureID = mTextureID;
 
     error = glGetError();
 	if( error != GL_NO_ERROR ) {		// error
@@ -441,6 +454,7 @@ void SingleTextureGL::setWrapping( char inHorizontal,
                                    char inVertical ) {
 
     glBindTexture( GL_TEXTURE_2D, mTextureID );
+    sLastBoundTextureID = mTextureID;
 
     int error = glGetError();
     if( error != GL_NO_ERROR ) {
@@ -474,6 +488,7 @@ void SingleTextureGL::replaceTextureData( unsigned char *inBytes,
 
 
     glBindTexture( GL_TEXTURE_2D, mTextureID );
+    sLastBoundTextureID = mTextureID;
     
     error = glGetError();
 	if( error != GL_NO_ERROR ) {		// error
@@ -502,3 +517,49 @@ void SingleTextureGL::replaceTextureData( unsigned char *inBytes,
     }
 
         
+
+
+
+void SingleTextureGL::replaceTextureRegion( unsigned char *inRGBA,
+                                            unsigned int inX,
+                                            unsigned int inY,
+                                            unsigned int inWidth, 
+                                            unsigned int inHeight ) {
+
+    if( mBackupBytes != NULL && !mAlphaOnly ) {
+        for( unsigned int y=0; y<inHeight; y++ ) {
+            memcpy( &( mBackupBytes[ ( ( inY + y ) * mWidthBackup + inX ) 
+                                     * 4 ] ),
+                    &( inRGBA[ y * inWidth * 4 ] ),
+                    inWidth * 4 );
+            }
+        }
+    
+
+    int error;
+
+    glBindTexture( GL_TEXTURE_2D, mTextureID );
+    sLastBoundTextureID = mTextureID;
+    
+    error = glGetError();
+	if( error != GL_NO_ERROR ) {		// error
+		printf( "Error binding to texture id %d, error = %d\n",
+                (int)mTextureID,
+                error );
+		}
+
+	glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+    
+    glTexSubImage2D( GL_TEXTURE_2D, 0,
+                     inX, inY,
+                     inWidth, inHeight, 
+                     GL_RGBA,
+                     GL_UNSIGNED_BYTE, inRGBA );
+
+	error = glGetError();
+	if( error != GL_NO_ERROR ) {		// error
+		printf( "Error replacing texture region for id %d, error = %d, "
+                "\"%s\"\n",
+                (int)mTextureID, error, glGetString( error ) );
+		}
+    }
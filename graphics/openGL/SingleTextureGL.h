@@ -123,6 +123,19 @@ class SingleTextureGL {
                                  unsigned int inHeight );
         
 
+        /**
+         * Replaces a rectangle of RGBA data in a texture that's already
+         * been set with RGBA data.
+         *
+         * @param inRGBA inWidth * inHeight bytes, top row first.
+         * @param inX, inY the rectangle's corner in the texture.
+         */
+        void replaceTextureRegion( unsigned char *inRGBA,
+                                   unsigned int inX, unsigned int inY,
+                                   unsigned int inWidth, 
+                                   unsigned int inHeight );
+        
+
 		
 		/**
 		 * Sets the data for this texture.
@@ -160,6 +173,17 @@ class SingleTextureGL {
                              unsigned int inHeight,
                              char inExpandEdge = false );        
 
+
+        /**
+         * Repeats the edge pixels of the non-transparent area of RGBA bytes
+         * one row/column outward, as described for setTextureData.
+         *
+         * Modifies inRGBA in place.
+         */
+        static void expandEdges( unsigned char *inRGBA,
+                                 unsigned int inWidth, 
+                                 unsigned int inHeight );
+
 		
         // FOVMOD NOTE:  Change 1/1 - Take these lines during the merge process
         void setWrapping ( char inHorizontal,
@@ -0,0 +1,257 @@
+// Converts a text game recording to the binary recording format
+//
+// Usage:  convertRecording in.txt out.rec [keyframeInterval]
+//
+// After converting, reads every frame back from both files, timing each
+// pass, and checks that the binary file holds the same events.  Then
+// checks that a copy with a corrupt block length (out.rec.bad, removed
+// afterward) reads as empty instead of allocating the bogus length.
+
+
+#include "EventRecording.h"
+
+#include "minorGems/system/Time.h"
+#include "minorGems/util/stringUtils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+
+static long getFileLength( FILE *inFile ) {
+    fseek( inFile, 0, SEEK_END );
+    long length = ftell( inFile );
+    rewind( inFile );
+    return length;
+    }
+
+
+
+static char sameEvent( RecordedEvent *inA, RecordedEvent *inB ) {
+    if( inA->type != inB->type ||
+        memcmp( inA->values, inB->values, sizeof( inA->values ) ) != 0 ||
+        inA->time != inB->time ||
+        inA->bodyLength != inB->bodyLength ) {
+        return false;
+        }
+    if( inA->bodyLength > 0 &&
+        memcmp( inA->body, inB->body, inA->bodyLength ) != 0 ) {
+        return false;
+        }
+    return true;
+    }
+
+
+
+// reads all frames, returns total events, or -1 if not readable
+static int readAll( FILE *inFile, double *outSeconds ) {
+    double start = Time::getCurrentTime();
+
+    RecordingReader *reader = RecordingReader::open( inFile );
+    if( reader == NULL ) {
+        return -1;
+        }
+
+    SimpleVector<RecordedEvent> events;
+    int numEvents = 0;
+
+    while( reader->readFrame( &events ) ) {
+        numEvents += events.size();
+        events.shrink( 0 );
+        }
+    delete reader;
+
+    *outSeconds = Time::getCurrentTime() - start;
+    return numEvents;
+    }
+
+
+
+// writes a copy of a binary recording with its first block claiming a
+// 4 GiB raw length, returns false on failure
+static char writeCorruptCopy( const char *inFileName,
+                              const char *inCopyFileName ) {
+    FILE *file = fopen( inFileName, "rb" );
+    if( file == NULL ) {
+        return false;
+        }
+    long length = getFileLength( file );
+    unsigned char *bytes = new unsigned char[ length ];
+    int numRead = fread( bytes, 1, length, file );
+    fclose( file );
+
+    // first block header follows the magic line and the header line
+    int numLines = 0;
+    long offset = 0;
+    while( offset < numRead && numLines < 2 ) {
+        if( bytes[ offset ] == '\n' ) {
+            numLines++;
+            }
+        offset++;
+        }
+
+    char ok = false;
+
+    if( numLines == 2 && offset + 4 <= numRead ) {
+        memset( &( bytes[ offset ] ), 0xFF, 4 );
+
+        FILE *copy = fopen( inCopyFileName, "wb" );
+        if( copy != NULL ) {
+            ok = ( (int)fwrite( bytes, 1, numRead, copy ) == numRead );
+            fclose( copy );
+            }
+        }
+
+    delete [] bytes;
+    return ok;
+    }
+
+
+
+int main( int inNumArgs, char **inArgs ) {
+    if( inNumArgs < 3 ) {
+        printf( "Usage:  convertRecording in.txt out.rec "
+                "[keyframeInterval]\n" );
+        return 1;
+        }
+
+    int keyframeInterval = 1800;
+    if( inNumArgs > 3 ) {
+        keyframeInterval = atoi( inArgs[3] );
+        }
+
+    FILE *textFile = fopen( inArgs[1], "rb" );
+    if( textFile == NULL ) {
+        printf( "Failed to open %s\n", inArgs[1] );
+        return 1;
+        }
+
+    FILE *binaryFile = fopen( inArgs[2], "wb" );
+    if( binaryFile == NULL ) {
+        printf( "Failed to open %s\n", inArgs[2] );
+        fclose( textFile );
+        return 1;
+        }
+
+    double start = Time::getCurrentTime();
+    int numFrames = convertTextRecording( textFile, binaryFile,
+                                          keyframeInterval );
+    double convertSeconds = Time::getCurrentTime() - start;
+    fclose( binaryFile );
+
+    if( numFrames < 0 ) {
+        printf( "Failed to read %s\n", inArgs[1] );
+        fclose( textFile );
+        return 1;
+        }
+
+    printf( "Converted %d frames in %.3f sec\n", numFrames, convertSeconds );
+
+
+    binaryFile = fopen( inArgs[2], "rb" );
+    if( binaryFile == NULL ) {
+        printf( "Failed to reopen %s\n", inArgs[2] );
+        fclose( textFile );
+        return 1;
+        }
+
+    long textLength = getFileLength( textFile );
+    long binaryLength = getFileLength( binaryFile );
+
+    double textSeconds, binarySeconds;
+    int textEvents = readAll( textFile, &textSeconds );
+    int binaryEvents = readAll( binaryFile, &binarySeconds );
+
+    printf( "%-8s %12s %10s %12s\n", "format", "bytes", "events",
+            "read (sec)" );
+    printf( "%-8s %12ld %10d %12.3f\n", "text", textLength, textEvents,
+            textSeconds );
+    printf( "%-8s %12ld %10d %12.3f\n", "binary", binaryLength, binaryEvents,
+            binarySeconds );
+
+
+    // compare event by event
+    rewind( textFile );
+    rewind( binaryFile );
+
+    RecordingReader *textReader = RecordingReader::open( textFile );
+    RecordingReader *binaryReader = RecordingReader::open( binaryFile );
+
+    SimpleVector<RecordedEvent> textFrame;
+    SimpleVector<RecordedEvent> binaryFrame;
+
+    int numMismatched = 0;
+    int frame = 0;
+
+    while( textReader->readFrame( &textFrame ) ) {
+        if( ! binaryReader->readFrame( &binaryFrame ) ) {
+            printf( "Binary recording ends early, at frame %d\n", frame );
+            numMismatched++;
+            break;
+            }
+
+        char same = ( textFrame.size() == binaryFrame.size() );
+
+        for( int i=0; i<textFrame.size() && same; i++ ) {
+            same = sameEvent( textFrame.getElement( i ),
+                              binaryFrame.getElement( i ) );
+            }
+        if( ! same ) {
+            if( numMismatched < 10 ) {
+                printf( "Frame %d differs\n", frame );
+                }
+            numMismatched++;
+            }
+
+        textFrame.shrink( 0 );
+        binaryFrame.shrink( 0 );
+        frame++;
+        }
+
+    if( strcmp( textReader->getHeaderLine(),
+                binaryReader->getHeaderLine() ) != 0 ) {
+        printf( "Header lines differ\n" );
+        numMismatched++;
+        }
+
+    delete textReader;
+    delete binaryReader;
+
+    fclose( textFile );
+    fclose( binaryFile );
+
+
+    char *badFileName = autoSprintf( "%s.bad", inArgs[2] );
+
+    if( frame > 0 ) {
+        if( ! writeCorruptCopy( inArgs[2], badFileName ) ) {
+            printf( "Failed to write %s\n", badFileName );
+            numMismatched++;
+            }
+        else {
+            FILE *badFile = fopen( badFileName, "rb" );
+            double badSeconds;
+            int badEvents = -1;
+            if( badFile != NULL ) {
+                badEvents = readAll( badFile, &badSeconds );
+                fclose( badFile );
+                }
+            if( badEvents != 0 ) {
+                printf( "Corrupt block length not refused (%d events)\n",
+                        badEvents );
+                numMismatched++;
+                }
+            remove( badFileName );
+            }
+        }
+    delete [] badFileName;
+
+    if( numMismatched > 0 ) {
+        printf( "FAILED:  %d mismatches\n", numMismatched );
+        return 1;
+        }
+
+    printf( "Verified %d frames\n", frame );
+    return 0;
+    }
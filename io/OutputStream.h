@@ -80,6 +80,26 @@ class OutputStream : public Stream {
         long writeString( const char *inString );
 
 
+
+        /**
+         * Writes several buffers, in order, as one write where the
+         * stream supports it.
+         *
+         * The default implementation writes each buffer in turn.
+         *
+         * @param inBuffers the buffers to write.
+         *   Must be destroyed by caller.
+         * @param inLengths the number of bytes in each buffer.
+         *   Must be destroyed by caller.
+         * @param inNumBuffers the number of buffers.
+         *
+         * @return the number of bytes written successfully,
+         *   or -1 for a stream error.
+         */
+        virtual long writeVector( unsigned char **inBuffers,
+                                  long *inLengths, int inNumBuffers );
+
+
         
 		/**
 		 * Writes a double to the stream in a platform-independent way.
@@ -152,6 +172,29 @@ inline long OutputStream::writeString( const char *inString ) {
 
 
 
+inline long OutputStream::writeVector( unsigned char **inBuffers,
+                                       long *inLengths, int inNumBuffers ) {
+    long numTotalWritten = 0;
+
+    for( int i=0; i<inNumBuffers; i++ ) {
+        long numWritten = write( inBuffers[i], inLengths[i] );
+
+        if( numWritten == -1 ) {
+            return -1;
+            }
+
+        numTotalWritten += numWritten;
+
+        if( numWritten < inLengths[i] ) {
+            break;
+            }
+        }
+
+    return numTotalWritten;
+    }
+
+
+
 inline long OutputStream::writeDouble( double inDouble ) {
 	TypeIO::doubleToBytes( inDouble, mDoubleBuffer );
 	
@@ -126,15 +126,8 @@ inline void Stream::setNewLastError( char *inString ) {
 
 inline void Stream::setNewLastErrorConst( const char *inString ) {
 	
-	int length = 0;
-	char lastChar = 'a';
-	while( lastChar != '\0' ) {
-		lastChar = inString[length];
-		length++;
-		}
-	
-	// add one more to length to accommodate '\0' terminination
-	length++;
+	// include '\0' termination
+	int length = strlen( inString ) + 1;
 	
 	if( mLastError != NULL ) {
 		delete [] mLastError;
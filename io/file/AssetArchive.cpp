@@ -0,0 +1,627 @@
+#include "AssetArchive.h"
+
+#include "minorGems/formats/encodingUtils.h"
+#include "minorGems/util/crc32.h"
+#include "minorGems/util/stringUtils.h"
+#include "minorGems/util/SimpleVector.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+
+#define ARCHIVE_VERSION 1
+
+#define HEADER_BYTES 24
+#define RECORD_BYTES 32
+
+// record fields, in 32-bit words
+#define FIELD_HASH 0
+#define FIELD_NAME_OFFSET 1
+#define FIELD_NAME_LENGTH 2
+#define FIELD_FLAGS 3
+#define FIELD_DATA_OFFSET 4
+#define FIELD_STORED_LENGTH 5
+#define FIELD_RAW_LENGTH 6
+#define FIELD_CRC 7
+
+#define FLAG_COMPRESSED 1
+
+#define ENTRY_ALIGNMENT 16
+
+// large entries start on a page, so their pages can be released
+// without touching neighbors
+#define PAGE_ALIGNMENT 4096
+#define PAGE_ALIGNED_MIN_BYTES 65536
+
+
+
+static unsigned int readUInt32( unsigned char *inBytes ) {
+    return
+        (unsigned int)inBytes[0] |
+        (unsigned int)inBytes[1] << 8 |
+        (unsigned int)inBytes[2] << 16 |
+        (unsigned int)inBytes[3] << 24;
+    }
+
+
+
+static void writeUInt32( unsigned int inValue, unsigned char *outBytes ) {
+    outBytes[0] = inValue & 0xFF;
+    outBytes[1] = ( inValue >> 8 ) & 0xFF;
+    outBytes[2] = ( inValue >> 16 ) & 0xFF;
+    outBytes[3] = ( inValue >> 24 ) & 0xFF;
+    }
+
+
+
+static unsigned int readField( unsigned char *inRecord, int inField ) {
+    return readUInt32( &( inRecord[ inField * 4 ] ) );
+    }
+
+
+
+unsigned int AssetArchive::hashName( const char *inName, int inLength ) {
+    unsigned int hash = 2166136261U;
+
+    for( int i=0; i<inLength; i++ ) {
+        hash ^= (unsigned char)inName[i];
+        hash *= 16777619U;
+        }
+    return hash;
+    }
+
+
+
+// orders names by hash, then by bytes, then by length
+static int compareNames( unsigned int inHashA, const char *inNameA,
+                         int inLengthA,
+                         unsigned int inHashB, const char *inNameB,
+                         int inLengthB ) {
+    if( inHashA != inHashB ) {
+        return ( inHashA < inHashB ) ? -1 : 1;
+        }
+
+    int minLength = inLengthA;
+    if( inLengthB < minLength ) {
+        minLength = inLengthB;
+        }
+
+    int c = memcmp( inNameA, inNameB, minLength );
+
+    if( c != 0 ) {
+        return c;
+        }
+    return inLengthA - inLengthB;
+    }
+
+
+
+AssetArchive::AssetArchive( File *inFile )
+        : mFile( NULL ), mNumEntries( 0 ), mTOC( NULL ), mNames( NULL ) {
+
+    if( ! inFile->exists() ) {
+        return;
+        }
+
+    MappedFile *file = new MappedFile( inFile );
+
+    unsigned char *data = file->getData();
+    unsigned int length = (unsigned int)file->getLength();
+
+    if( data == NULL || length < HEADER_BYTES ||
+        memcmp( data, "MGAR", 4 ) != 0 ||
+        readUInt32( &( data[4] ) ) != ARCHIVE_VERSION ) {
+
+        delete file;
+        return;
+        }
+
+    unsigned int numEntries = readUInt32( &( data[8] ) );
+    unsigned int namesOffset = readUInt32( &( data[12] ) );
+    unsigned int namesLength = readUInt32( &( data[16] ) );
+
+    // check sizes before multiplying
+    if( numEntries > ( length - HEADER_BYTES ) / RECORD_BYTES ||
+        namesOffset != HEADER_BYTES + numEntries * RECORD_BYTES ||
+        namesLength > length - namesOffset ) {
+
+        delete file;
+        return;
+        }
+
+    // every entry in bounds, so lookups need no further checks
+    for( unsigned int i=0; i<numEntries; i++ ) {
+        unsigned char *record = &( data[ HEADER_BYTES + i * RECORD_BYTES ] );
+
+        unsigned int nameOffset = readField( record, FIELD_NAME_OFFSET );
+        unsigned int nameLength = readField( record, FIELD_NAME_LENGTH );
+        unsigned int dataOffset = readField( record, FIELD_DATA_OFFSET );
+        unsigned int storedLength = readField( record, FIELD_STORED_LENGTH );
+        unsigned int rawLength = readField( record, FIELD_RAW_LENGTH );
+
+        char isCompressed =
+            ( readField( record, FIELD_FLAGS ) & FLAG_COMPRESSED ) != 0;
+
+        if( nameOffset > namesLength ||
+            nameLength > namesLength - nameOffset ||
+            dataOffset > length ||
+            storedLength > length - dataOffset ||
+            rawLength > 0x7FFFFFFF ||
+            ( ! isCompressed && rawLength != storedLength ) ) {
+
+            printf( "Asset archive entry %d out of bounds\n", i );
+            delete file;
+            return;
+            }
+        }
+
+    mFile = file;
+    mNumEntries = (int)numEntries;
+    mTOC = &( data[ HEADER_BYTES ] );
+    mNames = &( data[ namesOffset ] );
+    }
+
+
+
+AssetArchive::~AssetArchive() {
+    if( mFile != NULL ) {
+        delete mFile;
+        }
+    }
+
+
+
+char AssetArchive::isOpen() {
+    return ( mFile != NULL );
+    }
+
+
+
+int AssetArchive::getNumEntries() {
+    return mNumEntries;
+    }
+
+
+
+unsigned char *AssetArchive::getRecord( int inIndex ) {
+    return &( mTOC[ inIndex * RECORD_BYTES ] );
+    }
+
+
+
+char *AssetArchive::getName( int inIndex ) {
+    if( inIndex < 0 || inIndex >= mNumEntries ) {
+        return NULL;
+        }
+
+    unsigned char *record = getRecord( inIndex );
+
+    int nameLength = readField( record, FIELD_NAME_LENGTH );
+
+    char *name = new char[ nameLength + 1 ];
+    memcpy( name, &( mNames[ readField( record, FIELD_NAME_OFFSET ) ] ),
+            nameLength );
+    name[ nameLength ] = '\0';
+
+    return name;
+    }
+
+
+
+int AssetArchive::findEntry( const char *inName ) {
+    if( mFile == NULL ) {
+        return -1;
+        }
+
+    int nameLength = strlen( inName );
+    unsigned int hash = hashName( inName, nameLength );
+
+    int low = 0;
+    int high = mNumEntries - 1;
+
+    while( low <= high ) {
+        int mid = ( low + high ) / 2;
+
+        unsigned char *record = getRecord( mid );
+
+        int c = compareNames(
+            readField( record, FIELD_HASH ),
+            (char *)&( mNames[ readField( record, FIELD_NAME_OFFSET ) ] ),
+            readField( record, FIELD_NAME_LENGTH ),
+            hash, inName, nameLength );
+
+        if( c == 0 ) {
+            return mid;
+            }
+        else if( c < 0 ) {
+            low = mid + 1;
+            }
+        else {
+            high = mid - 1;
+            }
+        }
+
+    return -1;
+    }
+
+
+
+char AssetArchive::contains( const char *inName ) {
+    return ( findEntry( inName ) != -1 );
+    }
+
+
+
+unsigned char *AssetArchive::getView( const char *inName, int *outLength ) {
+    int index = findEntry( inName );
+
+    if( index == -1 ) {
+        return NULL;
+        }
+
+    unsigned char *record = getRecord( index );
+
+    if( readField( record, FIELD_FLAGS ) & FLAG_COMPRESSED ) {
+        return NULL;
+        }
+
+    *outLength = readField( record, FIELD_STORED_LENGTH );
+    return &( mFile->getData()[ readField( record, FIELD_DATA_OFFSET ) ] );
+    }
+
+
+
+unsigned char *AssetArchive::getData( const char *inName, int *outLength,
+                                      char *outCopied ) {
+    int index = findEntry( inName );
+
+    if( index == -1 ) {
+        return NULL;
+        }
+
+    unsigned char *record = getRecord( index );
+
+    unsigned char *stored =
+        &( mFile->getData()[ readField( record, FIELD_DATA_OFFSET ) ] );
+    int storedLength = readField( record, FIELD_STORED_LENGTH );
+
+    if( readField( record, FIELD_FLAGS ) & FLAG_COMPRESSED ) {
+        int rawLength = readField( record, FIELD_RAW_LENGTH );
+
+        unsigned char *raw = zipDecompress( stored, storedLength, rawLength );
+
+        if( raw == NULL ) {
+            printf( "Failed to decompress asset %s\n", inName );
+            return NULL;
+            }
+
+        *outLength = rawLength;
+        *outCopied = true;
+        return raw;
+        }
+
+    *outLength = storedLength;
+    *outCopied = false;
+    return stored;
+    }
+
+
+
+MappedFile *AssetArchive::mapEntry( const char *inName ) {
+    int index = findEntry( inName );
+
+    if( index == -1 ) {
+        return NULL;
+        }
+
+    unsigned char *record = getRecord( index );
+
+    if( readField( record, FIELD_FLAGS ) & FLAG_COMPRESSED ) {
+        return NULL;
+        }
+
+    return new MappedFile( mFile, readField( record, FIELD_DATA_OFFSET ),
+                           readField( record, FIELD_STORED_LENGTH ) );
+    }
+
+
+
+int AssetArchive::verify() {
+    int numBad = 0;
+
+    for( int i=0; i<mNumEntries; i++ ) {
+        char *name = getName( i );
+
+        int length;
+        char copied;
+        unsigned char *data = getData( name, &length, &copied );
+
+        if( data == NULL ||
+            crc32( data, length ) != readField( getRecord( i ), FIELD_CRC ) ) {
+
+            printf( "Asset archive entry %s is corrupt\n", name );
+            numBad++;
+            }
+
+        if( data != NULL && copied ) {
+            delete [] data;
+            }
+        delete [] name;
+        }
+
+    return numBad;
+    }
+
+
+
+unsigned char *AssetArchive::readAsset( const char *inName,
+                                        int *outLength ) {
+    int length;
+    char copied;
+    unsigned char *data = getData( inName, &length, &copied );
+
+    if( data == NULL ) {
+        return NULL;
+        }
+
+    unsigned char *result = new unsigned char[ length + 1 ];
+    memcpy( result, data, length );
+    result[ length ] = '\0';
+
+    if( copied ) {
+        delete [] data;
+        }
+
+    *outLength = length;
+    return result;
+    }
+
+
+
+static int compareStrings( const void *inA, const void *inB ) {
+    return strcmp( *( (char **)inA ), *( (char **)inB ) );
+    }
+
+
+
+char **AssetArchive::listAssets( const char *inPrefix, int *outNumNames ) {
+    SimpleVector<char *> names;
+
+    int prefixLength = strlen( inPrefix );
+
+    // table is in hash order, so every entry must be checked
+    for( int i=0; i<mNumEntries; i++ ) {
+        unsigned char *record = getRecord( i );
+
+        if( (int)readField( record, FIELD_NAME_LENGTH ) >= prefixLength &&
+            memcmp( &( mNames[ readField( record, FIELD_NAME_OFFSET ) ] ),
+                    inPrefix, prefixLength ) == 0 ) {
+
+            names.push_back( getName( i ) );
+            }
+        }
+
+    char **result = names.getElementArray();
+    *outNumNames = names.size();
+
+    qsort( result, *outNumNames, sizeof( char * ), compareStrings );
+
+    return result;
+    }
+
+
+
+typedef struct PackedEntry {
+        const char *name;
+        int nameLength;
+        unsigned int hash;
+        unsigned int nameOffset;
+        unsigned int flags;
+        unsigned int dataOffset;
+        unsigned int storedLength;
+        unsigned int rawLength;
+        unsigned int crc;
+    } PackedEntry;
+
+
+
+static int comparePackedEntries( const void *inA, const void *inB ) {
+    PackedEntry *a = *( (PackedEntry **)inA );
+    PackedEntry *b = *( (PackedEntry **)inB );
+
+    return compareNames( a->hash, a->name, a->nameLength,
+                         b->hash, b->name, b->nameLength );
+    }
+
+
+
+static char writeZeros( FILE *inFile, int inCount ) {
+    unsigned char zeros[ PAGE_ALIGNMENT ];
+    memset( zeros, 0, inCount );
+
+    return ( fwrite( zeros, 1, inCount, inFile ) == (size_t)inCount );
+    }
+
+
+
+char AssetArchive::writeArchive( File *inArchiveFile,
+                                 int inNumEntries,
+                                 const char **inNames,
+                                 File **inFiles,
+                                 char inCompress,
+                                 long *outStoredBytes ) {
+
+    PackedEntry *entries = new PackedEntry[ inNumEntries ];
+
+    unsigned int namesLength = 0;
+
+    for( int i=0; i<inNumEntries; i++ ) {
+        PackedEntry *e = &( entries[i] );
+
+        e->name = inNames[i];
+        e->nameLength = strlen( inNames[i] );
+        e->hash = hashName( e->name, e->nameLength );
+        e->nameOffset = namesLength;
+        e->flags = 0;
+        e->dataOffset = 0;
+        e->storedLength = 0;
+        e->rawLength = 0;
+        e->crc = 0;
+
+        namesLength += e->nameLength;
+        }
+
+    unsigned int namesOffset = HEADER_BYTES + inNumEntries * RECORD_BYTES;
+    unsigned int dataStart = namesOffset + namesLength;
+
+
+    char *archiveName = inArchiveFile->getFullFileName();
+    FILE *file = fopen( archiveName, "wb" );
+    delete [] archiveName;
+
+    if( file == NULL ) {
+        delete [] entries;
+        return false;
+        }
+
+    char failed = false;
+    long storedBytes = 0;
+
+    // data is written in the order given, so files used together stay
+    // together on disk, after space for the header, table, and names
+    unsigned int offset = dataStart;
+
+    if( fseek( file, dataStart, SEEK_SET ) != 0 ) {
+        failed = true;
+        }
+
+    for( int i=0; i<inNumEntries && !failed; i++ ) {
+        PackedEntry *e = &( entries[i] );
+
+        int rawLength;
+        unsigned char *raw = inFiles[i]->readFileContents( &rawLength );
+
+        if( raw == NULL ) {
+            printf( "Failed to read %s for asset archive\n", e->name );
+            failed = true;
+            break;
+            }
+
+        e->rawLength = rawLength;
+        e->crc = crc32( raw, rawLength );
+
+        unsigned char *stored = raw;
+        int storedLength = rawLength;
+
+        if( inCompress && rawLength > 0 ) {
+            int compressedLength;
+            unsigned char *compressed =
+                zipCompress( raw, rawLength, &compressedLength );
+
+            if( compressed != NULL &&
+                compressedLength <= rawLength - rawLength / 8 ) {
+                stored = compressed;
+                storedLength = compressedLength;
+                e->flags |= FLAG_COMPRESSED;
+                }
+            else if( compressed != NULL ) {
+                delete [] compressed;
+                }
+            }
+
+        int alignment = ENTRY_ALIGNMENT;
+        if( storedLength >= PAGE_ALIGNED_MIN_BYTES ) {
+            alignment = PAGE_ALIGNMENT;
+            }
+
+        int padding = ( alignment - offset % alignment ) % alignment;
+
+        if( ! writeZeros( file, padding ) ||
+            fwrite( stored, 1, storedLength, file ) !=
+                (size_t)storedLength ) {
+            failed = true;
+            }
+
+        e->dataOffset = offset + padding;
+        e->storedLength = storedLength;
+
+        offset = e->dataOffset + storedLength;
+        storedBytes += storedLength;
+
+        if( stored != raw ) {
+            delete [] stored;
+            }
+        delete [] raw;
+        }
+
+
+    if( ! failed ) {
+        unsigned char *head = new unsigned char[ dataStart ];
+
+        memcpy( head, "MGAR", 4 );
+        writeUInt32( ARCHIVE_VERSION, &( head[4] ) );
+        writeUInt32( inNumEntries, &( head[8] ) );
+        writeUInt32( namesOffset, &( head[12] ) );
+        writeUInt32( namesLength, &( head[16] ) );
+        writeUInt32( 0, &( head[20] ) );
+
+        PackedEntry **sorted = new PackedEntry*[ inNumEntries ];
+        for( int i=0; i<inNumEntries; i++ ) {
+            sorted[i] = &( entries[i] );
+            }
+        qsort( sorted, inNumEntries, sizeof( PackedEntry * ),
+               comparePackedEntries );
+
+        for( int i=0; i<inNumEntries; i++ ) {
+            PackedEntry *e = sorted[i];
+
+            if( i > 0 && comparePackedEntries( &( sorted[i-1] ),
+                                               &( sorted[i] ) ) == 0 ) {
+                printf( "Duplicate asset archive entry %s\n", e->name );
+                failed = true;
+                }
+
+            unsigned char *record = &( head[ HEADER_BYTES +
+                                             i * RECORD_BYTES ] );
+
+            writeUInt32( e->hash, &( record[ FIELD_HASH * 4 ] ) );
+            writeUInt32( e->nameOffset, &( record[ FIELD_NAME_OFFSET * 4 ] ) );
+            writeUInt32( e->nameLength, &( record[ FIELD_NAME_LENGTH * 4 ] ) );
+            writeUInt32( e->flags, &( record[ FIELD_FLAGS * 4 ] ) );
+            writeUInt32( e->dataOffset, &( record[ FIELD_DATA_OFFSET * 4 ] ) );
+            writeUInt32( e->storedLength,
+                         &( record[ FIELD_STORED_LENGTH * 4 ] ) );
+            writeUInt32( e->rawLength, &( record[ FIELD_RAW_LENGTH * 4 ] ) );
+            writeUInt32( e->crc, &( record[ FIELD_CRC * 4 ] ) );
+
+            memcpy( &( head[ namesOffset + e->nameOffset ] ),
+                    e->name, e->nameLength );
+            }
+        delete [] sorted;
+
+        if( fseek( file, 0, SEEK_SET ) != 0 ||
+            fwrite( head, 1, dataStart, file ) != dataStart ) {
+            failed = true;
+            }
+
+        delete [] head;
+        }
+
+    if( fclose( file ) != 0 ) {
+        failed = true;
+        }
+
+    delete [] entries;
+
+    if( failed ) {
+        inArchiveFile->remove();
+        return false;
+        }
+
+    if( outStoredBytes != NULL ) {
+        *outStoredBytes = storedBytes;
+        }
+    return true;
+    }
@@ -0,0 +1,173 @@
+#ifndef ASSET_ARCHIVE_INCLUDED
+#define ASSET_ARCHIVE_INCLUDED
+
+
+
+#include "minorGems/io/file/AssetSource.h"
+#include "minorGems/io/file/MappedFile.h"
+#include "minorGems/io/file/File.h"
+
+
+
+/**
+ * Many small files packed into one memory-mapped file, so that startup
+ * pays for one open instead of an exists check, open, and read for each
+ * of thousands of files.
+ *
+ * Layout, all integers 32-bit little-endian:
+ *
+ *   header:  "MGAR", version, number of entries, offset of name table,
+ *            length of name table, reserved
+ *
+ *   table of contents:  one 32-byte record per entry, sorted by the FNV-1a
+ *            hash of the entry's name, then by name:
+ *            name hash, name offset, name length, flags, data offset,
+ *            stored length, raw length, CRC-32 of raw data
+ *
+ *   name table:  names, not \0-terminated, / separators
+ *
+ *   data:  each entry starts on a 16-byte boundary, or a page boundary for
+ *            entries of at least 64 KiB, and is stored raw or zlib
+ *            compressed
+ *
+ * A lookup is a binary search of the table of contents, which touches a
+ * handful of pages, and raw entries are returned as views of the mapping
+ * without copying.
+ *
+ * All functions are thread-safe once the archive is open.
+ */
+class AssetArchive : public AssetSource {
+
+    public:
+
+        /**
+         * Opens an archive.
+         *
+         * @param inFile the archive file.  Destroyed by caller.
+         */
+        AssetArchive( File *inFile );
+
+        ~AssetArchive();
+
+
+        // false if archive missing or malformed
+        char isOpen();
+
+
+        int getNumEntries();
+
+
+        // gets name of an entry in table order
+        // destroyed by caller
+        char *getName( int inIndex );
+
+
+        char contains( const char *inName );
+
+
+        /**
+         * Gets an entry without copying it.
+         *
+         * @param inName the entry's name.
+         * @param outLength pointer to where entry length should be
+         *   returned.
+         *
+         * @return the entry's bytes, valid until this class is destroyed,
+         *   or NULL if entry is missing or compressed.  Not \0-terminated.
+         */
+        unsigned char *getView( const char *inName, int *outLength );
+
+
+        /**
+         * Gets an entry, decompressing it if needed.
+         *
+         * @param inName the entry's name.
+         * @param outLength pointer to where entry length should be
+         *   returned.
+         * @param outCopied pointer to where flag should be returned, true
+         *   if result is a decompressed copy that must be destroyed by
+         *   caller, or false if it is a view of the archive.
+         *
+         * @return the entry's bytes, or NULL if missing or corrupt.
+         *   Not \0-terminated.
+         */
+        unsigned char *getData( const char *inName, int *outLength,
+                                char *outCopied );
+
+
+        /**
+         * Gets an entry as a mapped file sharing the archive's pages.
+         *
+         * @param inName the entry's name.
+         *
+         * @return a view, or NULL if entry missing or compressed.  Must
+         *   be destroyed by caller before this class is.
+         */
+        MappedFile *mapEntry( const char *inName );
+
+
+        // checks every entry against its CRC-32
+        // returns number of bad entries
+        int verify();
+
+
+        // implements AssetSource
+        virtual unsigned char *readAsset( const char *inName,
+                                          int *outLength );
+
+        virtual char **listAssets( const char *inPrefix,
+                                   int *outNumNames );
+
+
+
+        /**
+         * Writes an archive.
+         *
+         * @param inArchiveFile the file to write.  Destroyed by caller.
+         * @param inNumEntries the number of entries.
+         * @param inNames the name of each entry, with / separators.
+         *   Destroyed by caller.
+         * @param inFiles the file to read for each entry.  Destroyed by
+         *   caller.
+         * @param inCompress true to zlib compress each entry that shrinks
+         *   by at least an eighth, or false to store all entries raw.
+         *   Raw entries are read without copying.
+         * @param outStoredBytes pointer to where the total of stored entry
+         *   lengths should be returned, or NULL.
+         *
+         * @return true on success.
+         */
+        static char writeArchive( File *inArchiveFile,
+                                  int inNumEntries,
+                                  const char **inNames,
+                                  File **inFiles,
+                                  char inCompress,
+                                  long *outStoredBytes = NULL );
+
+
+        // hash used for table of contents
+        static unsigned int hashName( const char *inName, int inLength );
+
+
+
+    protected:
+
+        MappedFile *mFile;
+
+        int mNumEntries;
+
+        // point into mapping
+        unsigned char *mTOC;
+        unsigned char *mNames;
+
+
+        // returns index of entry, or -1
+        int findEntry( const char *inName );
+
+        // points to TOC record for an index
+        unsigned char *getRecord( int inIndex );
+    };
+
+
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef ASSET_SOURCE_INCLUDED
+#define ASSET_SOURCE_INCLUDED
+
+
+
+/**
+ * A read-only collection of named files that loaders can check before
+ * going to loose files on disk.
+ *
+ * Names are relative paths with / separators, like "languages/English.txt".
+ *
+ * Lets utility classes like SettingsManager and TranslationManager read
+ * from an archive (see AssetArchive) without linking against it.
+ */
+class AssetSource {
+
+    public:
+
+        virtual ~AssetSource() {
+            }
+
+
+        /**
+         * Reads a file.
+         *
+         * @param inName the file's name.
+         * @param outLength pointer to where the file length should be
+         *   returned.
+         *
+         * @return the file contents, \0-terminated one byte past outLength,
+         *   or NULL if not present.  Destroyed by caller.
+         */
+        virtual unsigned char *readAsset( const char *inName,
+                                          int *outLength ) = 0;
+
+
+        /**
+         * Lists files whose names start with a prefix.
+         *
+         * @param inPrefix the prefix, like "languages/".
+         * @param outNumNames pointer to where the number of names should be
+         *   returned.
+         *
+         * @return the full names, in sorted order.  Array and names
+         *   destroyed by caller.
+         */
+        virtual char **listAssets( const char *inPrefix,
+                                   int *outNumNames ) = 0;
+    };
+
+
+
+#endif
@@ -0,0 +1,506 @@
+#include "AsyncFileReader.h"
+
+#include "minorGems/util/stringUtils.h"
+
+#include <string.h>
+
+
+
+// request states
+#define READ_PENDING 0
+#define READ_IN_PROGRESS 1
+#define READ_DONE 2
+// handle freed before read finished
+#define READ_CANCELLED 3
+
+
+// pages are touched this far apart during read-ahead, small enough for
+// any page size in use
+#define READ_AHEAD_STRIDE 4096
+
+
+
+class AsyncFileReaderWorker : public Thread {
+
+    public:
+
+        AsyncFileReaderWorker( AsyncFileReader *inReader )
+                : mReader( inReader ) {
+            }
+
+
+        virtual void run() {
+            while( true ) {
+                AsyncFileRequest *r = mReader->getNextRequest();
+
+                if( r == NULL ) {
+                    return;
+                    }
+
+                mReader->readRequest( r );
+
+                mReader->requestFinished( r );
+                }
+            }
+
+
+    protected:
+        AsyncFileReader *mReader;
+    };
+
+
+
+AsyncFileReader::AsyncFileReader( int inNumThreads, int inMapMinBytes )
+        : mMapMinBytes( inMapMinBytes ),
+          mRequestsAvailable( 0 ),
+          mFirstHandle( 0 ), mNextHandle( 0 ),
+          mDoneHead( 0 ),
+          mStopping( false ) {
+
+    if( inNumThreads < 1 ) {
+        inNumThreads = 1;
+        }
+
+    for( int i=0; i<inNumThreads; i++ ) {
+        Thread *t = new AsyncFileReaderWorker( this );
+        mWorkers.push_back( t );
+        t->start();
+        }
+    }
+
+
+
+AsyncFileReader::~AsyncFileReader() {
+    mLock.lock();
+    mStopping = true;
+    mLock.unlock();
+
+    int numWorkers = mWorkers.size();
+
+    for( int i=0; i<numWorkers; i++ ) {
+        mRequestsAvailable.signal();
+        }
+
+    // reads in progress finish first
+    for( int i=0; i<numWorkers; i++ ) {
+        Thread *t = mWorkers.getElementDirect( i );
+        t->join();
+        delete t;
+        }
+
+
+    // cancelled requests waiting in the queue are only reachable there
+    for( int i=0; i<mPending.size(); i++ ) {
+        AsyncFileRequest *r = mPending.getElement( i )->request;
+
+        r->numQueued --;
+        freeIfUnused( r );
+        }
+    mPending.clear();
+
+    for( int i=0; i<mRequests.size(); i++ ) {
+        AsyncFileRequest *r = mRequests.getElementDirect( i );
+
+        if( r != NULL ) {
+            r->state = READ_CANCELLED;
+            freeIfUnused( r );
+            }
+        }
+    mRequests.deleteAll();
+    }
+
+
+
+void AsyncFileReader::freeRequestData( AsyncFileRequest *inRequest ) {
+    if( inRequest->mappedFile != NULL ) {
+        delete inRequest->mappedFile;
+        }
+    else if( inRequest->data != NULL ) {
+        delete [] inRequest->data;
+        }
+
+    inRequest->mappedFile = NULL;
+    inRequest->data = NULL;
+    }
+
+
+
+void AsyncFileReader::freeIfUnused( AsyncFileRequest *inRequest ) {
+    if( inRequest->state == READ_CANCELLED &&
+        inRequest->numQueued == 0 &&
+        ! inRequest->reading ) {
+
+        freeRequestData( inRequest );
+        delete [] inRequest->filePath;
+        delete inRequest;
+        }
+    }
+
+
+
+AsyncFileRequest *AsyncFileReader::getRequest( int inHandle ) {
+    int index = inHandle - mFirstHandle;
+
+    if( index < 0 || index >= mRequests.size() ) {
+        return NULL;
+        }
+
+    return mRequests.getElementDirect( index );
+    }
+
+
+
+void AsyncFileReader::forgetRequest( int inHandle ) {
+    int index = inHandle - mFirstHandle;
+
+    *( mRequests.getElement( index ) ) = NULL;
+
+    // handles are usually freed in roughly the order they were handed out
+    int numFreed = 0;
+    while( numFreed < mRequests.size() &&
+           mRequests.getElementDirect( numFreed ) == NULL ) {
+        numFreed++;
+        }
+
+    if( numFreed > 0 ) {
+        mRequests.deleteStartElements( numFreed );
+        mFirstHandle += numFreed;
+        }
+    }
+
+
+
+void AsyncFileReader::queueRequest( AsyncFileRequest *inRequest ) {
+    inRequest->queueSequence ++;
+    inRequest->numQueued ++;
+
+    AsyncFilePendingEntry entry = { inRequest, inRequest->queueSequence };
+
+    // higher priority first, then lower handle first
+    double key =
+        - (double)( inRequest->priority ) * 4294967296.0 +
+        (double)( inRequest->handle );
+
+    mPending.insert( entry, key );
+    }
+
+
+
+int AsyncFileReader::startRead( const char *inFilePath, int inPriority ) {
+    AsyncFileRequest *r = new AsyncFileRequest;
+
+    r->filePath = stringDuplicate( inFilePath );
+    r->priority = inPriority;
+    r->state = READ_PENDING;
+    r->data = NULL;
+    r->dataLength = -1;
+    r->mappedFile = NULL;
+    r->numQueued = 0;
+    r->queueSequence = 0;
+    r->reading = false;
+
+    mLock.lock();
+
+    r->handle = mNextHandle;
+    mNextHandle ++;
+
+    if( mRequests.size() == 0 ) {
+        // keep table starting at first live handle
+        mFirstHandle = r->handle;
+        }
+    mRequests.push_back( r );
+
+    queueRequest( r );
+
+    int handle = r->handle;
+
+    mLock.unlock();
+
+    mRequestsAvailable.signal();
+
+    return handle;
+    }
+
+
+
+void AsyncFileReader::setPriority( int inHandle, int inPriority ) {
+    char queued = false;
+
+    mLock.lock();
+
+    AsyncFileRequest *r = getRequest( inHandle );
+
+    if( r != NULL && r->state == READ_PENDING &&
+        r->priority != inPriority ) {
+
+        r->priority = inPriority;
+
+        // old entry goes stale
+        queueRequest( r );
+        queued = true;
+        }
+
+    mLock.unlock();
+
+    if( queued ) {
+        mRequestsAvailable.signal();
+        }
+    }
+
+
+
+void AsyncFileReader::cancel( int inHandle ) {
+    mLock.lock();
+
+    AsyncFileRequest *r = getRequest( inHandle );
+
+    if( r != NULL ) {
+        forgetRequest( inHandle );
+
+        if( r->state == READ_DONE ) {
+            freeRequestData( r );
+            }
+
+        r->state = READ_CANCELLED;
+
+        // else freed by the worker reading it, or when its last queue
+        // entry is popped
+        freeIfUnused( r );
+        }
+
+    mLock.unlock();
+    }
+
+
+
+char AsyncFileReader::isDone( int inHandle ) {
+    mLock.lock();
+
+    AsyncFileRequest *r = getRequest( inHandle );
+
+    char done = ( r != NULL && r->state == READ_DONE );
+
+    mLock.unlock();
+
+    return done;
+    }
+
+
+
+void AsyncFileReader::waitUntilDone( int inHandle ) {
+    while( true ) {
+        mLock.lock();
+
+        AsyncFileRequest *r = getRequest( inHandle );
+
+        char done = ( r == NULL || r->state == READ_DONE );
+
+        mLock.unlock();
+
+        if( done ) {
+            return;
+            }
+
+        // signaled after any read finishes, or already signaled if one
+        // finished since we checked
+        mRequestDone.wait();
+        }
+    }
+
+
+
+int AsyncFileReader::getNextDone() {
+    int handle = -1;
+
+    mLock.lock();
+
+    while( handle == -1 && mDoneHead < mDone.size() ) {
+        int h = mDone.getElementDirect( mDoneHead );
+        mDoneHead ++;
+
+        // skip handles freed since
+        if( getRequest( h ) != NULL ) {
+            handle = h;
+            }
+        }
+
+    if( mDoneHead == mDone.size() ) {
+        // everything reported, reuse the space
+        mDone.deleteAll();
+        mDoneHead = 0;
+        }
+
+    mLock.unlock();
+
+    return handle;
+    }
+
+
+
+unsigned char *AsyncFileReader::getData( int inHandle, int *outDataLength,
+                                         char *outMapped ) {
+    unsigned char *data = NULL;
+
+    mLock.lock();
+
+    AsyncFileRequest *r = getRequest( inHandle );
+
+    if( r != NULL && r->state == READ_DONE ) {
+        data = r->data;
+        *outDataLength = r->dataLength;
+
+        if( outMapped != NULL ) {
+            *outMapped = ( r->mappedFile != NULL );
+            }
+        }
+
+    mLock.unlock();
+
+    return data;
+    }
+
+
+
+void AsyncFileReader::release( int inHandle ) {
+    cancel( inHandle );
+    }
+
+
+
+unsigned char *AsyncFileReader::takeData( int inHandle, int *outDataLength ) {
+    char found = false;
+    unsigned char *data = NULL;
+    MappedFile *mappedFile = NULL;
+
+    mLock.lock();
+
+    AsyncFileRequest *r = getRequest( inHandle );
+
+    if( r != NULL && r->state == READ_DONE ) {
+        found = true;
+
+        data = r->data;
+        mappedFile = r->mappedFile;
+        *outDataLength = r->dataLength;
+
+        r->data = NULL;
+        r->mappedFile = NULL;
+
+        forgetRequest( inHandle );
+        r->state = READ_CANCELLED;
+        freeIfUnused( r );
+        }
+
+    mLock.unlock();
+
+    if( found && mappedFile != NULL ) {
+        // copy outside of lock
+        data = new unsigned char[ *outDataLength ];
+        memcpy( data, mappedFile->getData(), *outDataLength );
+
+        delete mappedFile;
+        }
+
+    return data;
+    }
+
+
+
+AsyncFileRequest *AsyncFileReader::getNextRequest() {
+    while( true ) {
+        mRequestsAvailable.wait();
+
+        mLock.lock();
+
+        if( mStopping ) {
+            mLock.unlock();
+            return NULL;
+            }
+
+        // one entry per signal
+        AsyncFilePendingEntry entry = mPending.removeMin();
+
+        AsyncFileRequest *r = entry.request;
+
+        r->numQueued --;
+
+        if( r->state == READ_PENDING &&
+            entry.sequence == r->queueSequence ) {
+
+            r->state = READ_IN_PROGRESS;
+            r->reading = true;
+
+            mLock.unlock();
+            return r;
+            }
+
+        // else stale entry for a cancelled or reprioritized request
+        freeIfUnused( r );
+
+        mLock.unlock();
+        }
+    }
+
+
+
+void AsyncFileReader::readRequest( AsyncFileRequest *inRequest ) {
+    // path and buffers of a request being read are only touched by
+    // the worker reading it
+    File f( NULL, inRequest->filePath );
+
+    if( mMapMinBytes >= 0 && f.exists() &&
+        f.getLength() >= mMapMinBytes ) {
+
+        MappedFile *mapped = new MappedFile( &f );
+
+        if( mapped->getData() != NULL ) {
+            inRequest->mappedFile = mapped;
+            inRequest->data = mapped->getData();
+            inRequest->dataLength = mapped->getLength();
+
+            // read ahead here, so caller doesn't fault pages in
+            mapped->adviseSequential();
+
+            volatile unsigned char sum = 0;
+            for( int i=0; i<inRequest->dataLength; i+=READ_AHEAD_STRIDE ) {
+                sum += inRequest->data[i];
+                }
+            sum += inRequest->data[ inRequest->dataLength - 1 ];
+
+            return;
+            }
+
+        // fall back on reading
+        delete mapped;
+        }
+
+    int dataLength;
+    inRequest->data = f.readFileContents( &dataLength );
+
+    if( inRequest->data != NULL ) {
+        inRequest->dataLength = dataLength;
+        }
+    }
+
+
+
+void AsyncFileReader::requestFinished( AsyncFileRequest *inRequest ) {
+    mLock.lock();
+
+    inRequest->reading = false;
+
+    if( inRequest->state == READ_CANCELLED ) {
+        // handle already freed
+        // older queue entries may still refer to it, if it was raised
+        // to a higher priority
+        freeIfUnused( inRequest );
+        }
+    else {
+        inRequest->state = READ_DONE;
+        mDone.push_back( inRequest->handle );
+        }
+
+    mLock.unlock();
+
+    mRequestDone.signal();
+    }
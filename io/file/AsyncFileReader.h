@@ -0,0 +1,234 @@
+#ifndef ASYNC_FILE_READER_INCLUDED
+#define ASYNC_FILE_READER_INCLUDED
+
+
+
+#include "minorGems/io/file/MappedFile.h"
+#include "minorGems/system/Thread.h"
+#include "minorGems/system/MutexLock.h"
+#include "minorGems/system/Semaphore.h"
+#include "minorGems/system/BinarySemaphore.h"
+#include "minorGems/util/SimpleVector.h"
+#include "minorGems/util/MinPriorityQueue.h"
+
+
+
+typedef struct AsyncFileRequest {
+        int handle;
+        char *filePath;
+
+        int priority;
+
+        // one of the request states in AsyncFileReader.cpp
+        int state;
+
+        // NULL if file missing or unreadable
+        unsigned char *data;
+        int dataLength;
+
+        // non-NULL if data is mapped rather than read into heap
+        MappedFile *mappedFile;
+
+        // entries for this request in the pending queue, only the
+        // newest of which is live
+        int numQueued;
+        int queueSequence;
+
+        // true while a worker is reading
+        char reading;
+    } AsyncFileRequest;
+
+
+
+typedef struct AsyncFilePendingEntry {
+        AsyncFileRequest *request;
+
+        // stale if it doesn't match request's queueSequence
+        int sequence;
+    } AsyncFilePendingEntry;
+
+
+
+/**
+ * Reads whole files on a pool of worker threads.
+ *
+ * Pending reads are served highest priority first, and in request order
+ * within a priority, so one large file doesn't hold up every small file
+ * queued behind it.
+ *
+ * Files at least as large as a threshold are memory-mapped instead of
+ * copied into heap buffers, and read ahead by the worker so the pages are
+ * resident before the read is reported done.
+ *
+ * Handles are handed out in increasing order.  Lookup by handle is O(1).
+ *
+ * Not deterministic:  which reads finish first depends on the disk and
+ * the scheduler.  Callers that need reads to finish on the same frame
+ * during playback must gate on their own record of when each read was
+ * seen done (gameSDL's checkAsyncFileReadDone does this).
+ *
+ * All functions except the constructor and destructor are thread-safe.
+ */
+class AsyncFileReader {
+
+    public:
+
+        /**
+         * Starts worker threads.
+         *
+         * @param inNumThreads the number of workers.  Defaults to 4.
+         *   Reads block on the disk more than the CPU, so more workers than
+         *   CPUs still help.
+         * @param inMapMinBytes files at least this large are mapped.
+         *   -1 to never map.  Defaults to 1 MiB.
+         */
+        AsyncFileReader( int inNumThreads = 4,
+                         int inMapMinBytes = 1048576 );
+
+
+        // cancels pending reads, waits for reads in progress, and
+        // frees all data not yet taken
+        ~AsyncFileReader();
+
+
+        /**
+         * Queues a file to read.
+         *
+         * @param inFilePath platform-dependent path from current directory.
+         *   Destroyed by caller.
+         * @param inPriority higher priorities are read first.
+         *   Defaults to 0.
+         *
+         * @return a handle for this read.
+         */
+        int startRead( const char *inFilePath, int inPriority = 0 );
+
+
+        /**
+         * Changes the priority of a read that hasn't started yet.
+         *
+         * Ignored for reads in progress or done.
+         */
+        void setPriority( int inHandle, int inPriority );
+
+
+        // frees the handle
+        // a pending read is skipped, and a read in progress is discarded
+        // when it finishes
+        void cancel( int inHandle );
+
+
+        // true if the read is done, including failed reads
+        char isDone( int inHandle );
+
+
+        // blocks until the read is done
+        void waitUntilDone( int inHandle );
+
+
+        /**
+         * Gets the next completed read, in the order reads completed.
+         *
+         * Each completed read is reported once, unless it was cancelled
+         * or freed before it is reported.
+         *
+         * @return a handle, or -1 if no reads have completed since the
+         *   last call.
+         */
+        int getNextDone();
+
+
+        /**
+         * Gets a completed read's data without copying or freeing it.
+         *
+         * @param inHandle a handle that isDone.
+         * @param outDataLength set to the data length.
+         * @param outMapped set to true if the data is memory-mapped,
+         *   or NULL to ignore.
+         *
+         * @return the data, or NULL if the read failed or isn't done.
+         *   Owned by the reader, valid until release is called.
+         */
+        unsigned char *getData( int inHandle, int *outDataLength,
+                                char *outMapped = NULL );
+
+
+        // frees a handle and its data
+        void release( int inHandle );
+
+
+        /**
+         * Takes a completed read's data and frees the handle.
+         *
+         * Mapped data is copied to the heap and unmapped.
+         *
+         * @return the data, destroyed by caller, or NULL if the read
+         *   failed or isn't done.
+         */
+        unsigned char *takeData( int inHandle, int *outDataLength );
+
+
+
+        // used by worker threads
+        // blocks until a request is ready to read, and marks it as reading
+        // returns NULL when stopping
+        AsyncFileRequest *getNextRequest();
+
+        // reads the file for a request from getNextRequest
+        void readRequest( AsyncFileRequest *inRequest );
+
+        void requestFinished( AsyncFileRequest *inRequest );
+
+
+    protected:
+
+        int mMapMinBytes;
+
+        SimpleVector<Thread *> mWorkers;
+
+        MutexLock mLock;
+
+        // signaled once per request queued, and once per worker at shutdown
+        Semaphore mRequestsAvailable;
+
+        // signaled whenever a request finishes
+        BinarySemaphore mRequestDone;
+
+        // indexed by handle - mFirstHandle
+        // NULL for handles freed
+        SimpleVector<AsyncFileRequest *> mRequests;
+        int mFirstHandle;
+
+        int mNextHandle;
+
+        // requests not yet read, including stale entries for ones
+        // cancelled or reprioritized while waiting, which are skipped
+        MinPriorityQueue<AsyncFilePendingEntry> mPending;
+
+        // handles in the order their reads completed
+        SimpleVector<int> mDone;
+        int mDoneHead;
+
+        char mStopping;
+
+
+        // NULL if handle freed or never handed out
+        AsyncFileRequest *getRequest( int inHandle );
+
+        // removes request from handle table, trimming freed handles from
+        // the front
+        void forgetRequest( int inHandle );
+
+        void queueRequest( AsyncFileRequest *inRequest );
+
+        static void freeRequestData( AsyncFileRequest *inRequest );
+
+        // frees a cancelled request once no worker or queue entry
+        // refers to it
+        static void freeIfUnused( AsyncFileRequest *inRequest );
+
+    };
+
+
+
+#endif
@@ -0,0 +1,115 @@
+#include "minorGems/common.h"
+#include "minorGems/io/file/File.h"
+
+
+
+#ifndef MAPPED_FILE_INCLUDED
+#define MAPPED_FILE_INCLUDED
+
+
+
+/**
+ * A whole file mapped read-only into memory.
+ *
+ * Pages are read from disk as they are touched, and count toward the
+ * process's resident memory only while they are in use, so large files
+ * can be opened without copying them into heap buffers.
+ *
+ * Note:  Implementation is provided separately for each platform (in the
+ *   unix/ and win32/ subdirectories).
+ */
+class MappedFile {
+
+    public:
+
+        /**
+         * Maps a file.
+         *
+         * @param inFile the file to map.  Destroyed by caller.
+         */
+        MappedFile( File *inFile );
+
+
+        /**
+         * Makes a view of part of another mapping, sharing its pages, so
+         * a file packed in an archive can be used like a mapped file.
+         *
+         * @param inParent the mapping.  Must outlive this class.
+         * @param inOffset the first byte of the view.
+         * @param inLength the length of the view.
+         */
+        MappedFile( MappedFile *inParent, int inOffset, int inLength );
+
+
+        // unmaps the file, if this class is not a view
+        ~MappedFile();
+
+
+        /**
+         * Gets the mapped bytes.
+         *
+         * @return the file contents, or NULL if the file is missing,
+         *   empty, or could not be mapped.  Valid until this class
+         *   is destroyed.
+         */
+        unsigned char *getData();
+
+
+        int getLength();
+
+
+        /**
+         * Hints that the file will be read from front to back, so the OS
+         * can read ahead more aggressively.
+         */
+        void adviseSequential();
+
+
+        /**
+         * Hints that a range will not be read again soon, so its pages can
+         * leave resident memory now.  The range stays readable, and is
+         * read back from disk if touched again.
+         *
+         * Only whole pages inside the range are released.
+         *
+         * @param inOffset the first byte of the range.
+         * @param inLength the length of the range.
+         */
+        void releaseRange( int inOffset, int inLength );
+
+
+    protected:
+
+        unsigned char *mData;
+        int mLength;
+
+        // used by platform-specific implementations
+        void *mNativeHandle;
+
+        // NULL unless this class is a view of another mapping
+        MappedFile *mParent;
+    };
+
+
+
+inline MappedFile::MappedFile( MappedFile *inParent, int inOffset,
+                               int inLength )
+    : mData( inParent->mData + inOffset ), mLength( inLength ),
+      mNativeHandle( NULL ), mParent( inParent ) {
+    }
+
+
+
+inline unsigned char *MappedFile::getData() {
+    return mData;
+    }
+
+
+
+inline int MappedFile::getLength() {
+    return mLength;
+    }
+
+
+
+#endif
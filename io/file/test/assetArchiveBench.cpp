@@ -0,0 +1,623 @@
+// Test and benchmark for AssetArchive
+//
+// Usage:  assetArchiveBench [files] [maxFileBytes]
+//
+// Checks contents of raw and compressed entries, zero-copy views and their
+// alignment, mapped entry views, listing by prefix, CRC verification, and
+// rejection of truncated archives and duplicate names.
+//
+// Then times a cold start:  reading every file with an exists check and a
+// separate open, the way gameSDL's loaders read loose files, against
+// opening one archive and looking each file up in it.  Pages are dropped
+// from the OS cache before each cold run with posix_fadvise, which some
+// file systems (tmpfs, some overlays) ignore, so warm runs are shown too.
+//
+// Writes its files to assetArchiveBenchFiles/, and removes them after.
+
+
+#include "minorGems/io/file/AssetArchive.h"
+#include "minorGems/system/Time.h"
+#include "minorGems/util/SimpleVector.h"
+#include "minorGems/util/stringUtils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+
+
+static int numFailed = 0;
+
+
+static void check( char inPassed, const char *inWhat ) {
+    if( ! inPassed ) {
+        printf( "FAILED:  %s\n", inWhat );
+        numFailed++;
+        }
+    }
+
+
+
+static const char *folderName = "assetArchiveBenchFiles";
+
+static const char *subfolders[2] = { "graphics", "sounds" };
+
+
+
+// text-like bytes for even seeds, which compress, and noise for odd seeds,
+// which don't
+static unsigned char fileByte( int inSeed, int inIndex ) {
+    if( inSeed % 2 == 0 ) {
+        return (unsigned char)( 'a' + ( inIndex / 7 + inSeed ) % 26 );
+        }
+    unsigned int x = (unsigned int)( inIndex * 2654435761U ) ^
+        (unsigned int)( inSeed * 40503 );
+    x ^= x >> 13;
+    x *= 0x5bd1e995;
+    return (unsigned char)( x >> 24 );
+    }
+
+
+
+static char dataMatches( unsigned char *inData, int inLength,
+                         int inSeed, int inExpectedLength ) {
+    if( inData == NULL || inLength != inExpectedLength ) {
+        return false;
+        }
+    for( int i=0; i<inLength; i++ ) {
+        if( inData[i] != fileByte( inSeed, i ) ) {
+            return false;
+            }
+        }
+    return true;
+    }
+
+
+
+typedef struct BenchFile {
+        // relative to folderName, like "graphics/file3.tga"
+        char *name;
+        File *file;
+        int seed;
+        int length;
+    } BenchFile;
+
+
+static SimpleVector<BenchFile> benchFiles;
+
+
+
+static void writeBenchFile( const char *inSubfolder, int inSeed,
+                            int inLength ) {
+    BenchFile b;
+    b.name = autoSprintf( "%s/file%d.tga", inSubfolder, inSeed );
+    b.seed = inSeed;
+    b.length = inLength;
+
+    char *path = autoSprintf( "%s/%s", folderName, b.name );
+    b.file = new File( NULL, path );
+    delete [] path;
+
+    unsigned char *data = new unsigned char[ inLength + 1 ];
+    for( int i=0; i<inLength; i++ ) {
+        data[i] = fileByte( inSeed, i );
+        }
+    b.file->writeToFile( data, inLength );
+    delete [] data;
+
+    benchFiles.push_back( b );
+    }
+
+
+
+static void clearBenchFiles() {
+    for( int i=0; i<benchFiles.size(); i++ ) {
+        BenchFile *b = benchFiles.getElement( i );
+        delete [] b->name;
+        delete b->file;
+        }
+    benchFiles.deleteAll();
+    }
+
+
+
+static void removeFolder( File *inFolder ) {
+    int numFiles;
+    File **files = inFolder->getChildFiles( &numFiles );
+
+    if( files != NULL ) {
+        for( int i=0; i<numFiles; i++ ) {
+            if( files[i]->isDirectory() ) {
+                removeFolder( files[i] );
+                }
+            else {
+                files[i]->remove();
+                }
+            delete files[i];
+            }
+        delete [] files;
+        }
+    inFolder->remove();
+    }
+
+
+
+static void removeTestFiles() {
+    File folder( NULL, folderName );
+
+    if( folder.exists() ) {
+        removeFolder( &folder );
+        }
+    }
+
+
+
+static void makeFolders() {
+    File folder( NULL, folderName );
+    folder.makeDirectory();
+
+    for( int s=0; s<2; s++ ) {
+        char *path = autoSprintf( "%s/%s", folderName, subfolders[s] );
+        File sub( NULL, path );
+        sub.makeDirectory();
+        delete [] path;
+        }
+    }
+
+
+
+static char writeBenchArchive( const char *inArchiveName, char inCompress ) {
+    int numFiles = benchFiles.size();
+
+    const char **names = new const char*[ numFiles ];
+    File **files = new File*[ numFiles ];
+
+    for( int i=0; i<numFiles; i++ ) {
+        names[i] = benchFiles.getElement( i )->name;
+        files[i] = benchFiles.getElement( i )->file;
+        }
+
+    File archiveFile( NULL, inArchiveName );
+    char result = AssetArchive::writeArchive( &archiveFile, numFiles,
+                                              names, files, inCompress );
+    delete [] names;
+    delete [] files;
+
+    return result;
+    }
+
+
+
+static void checkArchive( const char *inArchiveName, char inCompressed ) {
+    File archiveFile( NULL, inArchiveName );
+    AssetArchive archive( &archiveFile );
+
+    check( archive.isOpen(), "archive opens" );
+    check( archive.getNumEntries() == benchFiles.size(), "entry count" );
+
+    char allMatch = true;
+    char viewsRight = true;
+    char aligned = true;
+    char readAssetsMatch = true;
+    int numCompressed = 0;
+
+    for( int i=0; i<benchFiles.size(); i++ ) {
+        BenchFile *b = benchFiles.getElement( i );
+
+        int length;
+        char copied;
+        unsigned char *data = archive.getData( b->name, &length, &copied );
+
+        if( ! dataMatches( data, length, b->seed, b->length ) ) {
+            allMatch = false;
+            }
+
+        int viewLength;
+        unsigned char *view = archive.getView( b->name, &viewLength );
+
+        if( copied ) {
+            numCompressed++;
+            if( view != NULL ) {
+                viewsRight = false;
+                }
+            delete [] data;
+            }
+        else if( view != data || viewLength != length ) {
+            viewsRight = false;
+            }
+
+        if( view != NULL ) {
+            int alignment = ( viewLength >= 65536 ) ? 4096 : 16;
+            if( (size_t)view % alignment != 0 ) {
+                aligned = false;
+                }
+            }
+
+        unsigned char *copy = archive.readAsset( b->name, &length );
+        if( ! dataMatches( copy, length, b->seed, b->length ) ||
+            copy[ length ] != '\0' ) {
+            readAssetsMatch = false;
+            }
+        if( copy != NULL ) {
+            delete [] copy;
+            }
+        }
+
+    check( allMatch, "entry contents" );
+    check( viewsRight, "views only of raw entries, and equal to data" );
+    check( aligned, "raw entries aligned" );
+    check( readAssetsMatch, "readAsset contents terminated" );
+
+    if( inCompressed ) {
+        check( numCompressed > 0 && numCompressed < benchFiles.size(),
+               "only compressible entries compressed" );
+        }
+    else {
+        check( numCompressed == 0, "no entries compressed" );
+        }
+
+    check( ! archive.contains( "graphics/missing.tga" ), "missing entry" );
+    check( ! archive.contains( "graphics" ), "folder is not an entry" );
+
+    int length;
+    char copied;
+    check( archive.getData( "sounds/missing.aiff", &length,
+                            &copied ) == NULL,
+           "missing entry data" );
+
+    char namesFound = true;
+    for( int i=0; i<archive.getNumEntries(); i++ ) {
+        char *name = archive.getName( i );
+        if( ! archive.contains( name ) ) {
+            namesFound = false;
+            }
+        delete [] name;
+        }
+    check( namesFound, "every listed name found" );
+
+
+    int numGraphics = 0;
+    for( int i=0; i<benchFiles.size(); i++ ) {
+        if( strncmp( benchFiles.getElement( i )->name, "graphics/", 9 ) ==
+            0 ) {
+            numGraphics++;
+            }
+        }
+
+    int numListed;
+    char **listed = archive.listAssets( "graphics/", &numListed );
+
+    check( numListed == numGraphics, "list by prefix" );
+
+    char sorted = true;
+    for( int i=1; i<numListed; i++ ) {
+        if( strcmp( listed[i-1], listed[i] ) >= 0 ) {
+            sorted = false;
+            }
+        }
+
+    for( int i=0; i<numListed; i++ ) {
+        delete [] listed[i];
+        }
+    delete [] listed;
+
+    check( sorted, "list sorted" );
+
+    check( archive.verify() == 0, "verify clean archive" );
+    }
+
+
+
+static void checkMappedEntry( const char *inArchiveName ) {
+    File archiveFile( NULL, inArchiveName );
+    AssetArchive archive( &archiveFile );
+
+    // odd seeds are noise, so stored raw
+    BenchFile *large = NULL;
+    for( int i=0; i<benchFiles.size(); i++ ) {
+        BenchFile *b = benchFiles.getElement( i );
+        if( b->seed % 2 == 1 && b->length >= 65536 ) {
+            large = b;
+            break;
+            }
+        }
+
+    check( large != NULL, "large raw test file exists" );
+    if( large == NULL ) {
+        return;
+        }
+
+    MappedFile *entry = archive.mapEntry( large->name );
+
+    check( entry != NULL &&
+           dataMatches( entry->getData(), entry->getLength(),
+                        large->seed, large->length ),
+           "mapped entry contents" );
+
+    if( entry != NULL ) {
+        entry->releaseRange( 100, large->length - 200 );
+
+        // released pages come back from disk
+        check( dataMatches( entry->getData(), entry->getLength(),
+                            large->seed, large->length ),
+               "mapped entry contents after release" );
+        delete entry;
+        }
+
+    check( archive.mapEntry( "graphics/missing.tga" ) == NULL,
+           "missing entry not mapped" );
+    }
+
+
+
+static void checkDamaged( const char *inArchiveName ) {
+    File archiveFile( NULL, inArchiveName );
+
+    int length;
+    unsigned char *bytes = archiveFile.readFileContents( &length );
+
+    char *damagedName = autoSprintf( "%s/damaged.pack", folderName );
+    File damagedFile( NULL, damagedName );
+    delete [] damagedName;
+
+    // flip last byte, inside last entry's data
+    bytes[ length - 1 ] ^= 0xFF;
+    damagedFile.writeToFile( bytes, length );
+    bytes[ length - 1 ] ^= 0xFF;
+
+    AssetArchive *damaged = new AssetArchive( &damagedFile );
+    check( damaged->isOpen() && damaged->verify() == 1,
+           "damaged entry caught by verify" );
+    delete damaged;
+
+    // cut off in the middle of the data
+    damagedFile.writeToFile( bytes, length / 2 );
+
+    damaged = new AssetArchive( &damagedFile );
+    check( ! damaged->isOpen(), "truncated archive rejected" );
+    check( ! damaged->contains( benchFiles.getElement( 0 )->name ),
+           "rejected archive empty" );
+    delete damaged;
+
+    damagedFile.writeToFile( (unsigned char *)"MGAX", 4 );
+    damaged = new AssetArchive( &damagedFile );
+    check( ! damaged->isOpen(), "bad magic rejected" );
+    delete damaged;
+
+    damagedFile.remove();
+
+    File missingFile( NULL, "assetArchiveBenchMissing.pack" );
+    AssetArchive missing( &missingFile );
+    check( ! missing.isOpen(), "missing archive" );
+
+    delete [] bytes;
+
+
+    const char *names[2] = { "graphics/a.tga", "graphics/a.tga" };
+    File *files[2] = { benchFiles.getElement( 0 )->file,
+                       benchFiles.getElement( 1 )->file };
+
+    char *dupName = autoSprintf( "%s/dup.pack", folderName );
+    File dupFile( NULL, dupName );
+    delete [] dupName;
+
+    check( ! AssetArchive::writeArchive( &dupFile, 2, names, files, false ),
+           "duplicate names rejected" );
+    check( ! dupFile.exists(), "failed archive removed" );
+    }
+
+
+
+// asks OS to drop file's pages from its cache
+static void evict( File *inFile ) {
+    char *path = inFile->getFullFileName();
+    int fd = open( path, O_RDONLY );
+    delete [] path;
+
+    if( fd != -1 ) {
+        // dirty pages, like those of files just written, aren't dropped
+        fdatasync( fd );
+        posix_fadvise( fd, 0, 0, POSIX_FADV_DONTNEED );
+        close( fd );
+        }
+    }
+
+
+
+static void evictAll( const char *inArchiveName ) {
+    for( int i=0; i<benchFiles.size(); i++ ) {
+        evict( benchFiles.getElement( i )->file );
+        }
+    File archiveFile( NULL, inArchiveName );
+    evict( &archiveFile );
+    }
+
+
+
+// returns seconds to read every file, summing bytes into outChecksum
+static double timeLoose( long *outChecksum ) {
+    double start = Time::getCurrentTime();
+
+    long sum = 0;
+
+    for( int i=0; i<benchFiles.size(); i++ ) {
+        BenchFile *b = benchFiles.getElement( i );
+
+        char *path = autoSprintf( "%s/%s", folderName, b->name );
+        File f( NULL, path );
+        delete [] path;
+
+        if( f.exists() ) {
+            int length;
+            unsigned char *data = f.readFileContents( &length );
+
+            if( data != NULL ) {
+                for( int j=0; j<length; j += 512 ) {
+                    sum += data[j];
+                    }
+                delete [] data;
+                }
+            }
+        }
+
+    *outChecksum = sum;
+    return Time::getCurrentTime() - start;
+    }
+
+
+
+static double timeArchive( const char *inArchiveName, long *outChecksum ) {
+    double start = Time::getCurrentTime();
+
+    long sum = 0;
+
+    File archiveFile( NULL, inArchiveName );
+    AssetArchive archive( &archiveFile );
+
+    for( int i=0; i<benchFiles.size(); i++ ) {
+        BenchFile *b = benchFiles.getElement( i );
+
+        int length;
+        char copied;
+        unsigned char *data = archive.getData( b->name, &length, &copied );
+
+        if( data != NULL ) {
+            for( int j=0; j<length; j += 512 ) {
+                sum += data[j];
+                }
+            if( copied ) {
+                delete [] data;
+                }
+            }
+        }
+
+    *outChecksum = sum;
+    return Time::getCurrentTime() - start;
+    }
+
+
+
+int main( int inNumArgs, char **inArgs ) {
+
+    int numFiles = 3000;
+    int maxFileBytes = 16384;
+
+    if( inNumArgs > 1 ) {
+        numFiles = atoi( inArgs[1] );
+        }
+    if( inNumArgs > 2 ) {
+        maxFileBytes = atoi( inArgs[2] );
+        }
+
+    if( numFiles < 1 || maxFileBytes < 1 ) {
+        printf( "Usage:  assetArchiveBench [files] [maxFileBytes]\n" );
+        return 1;
+        }
+
+
+    removeTestFiles();
+    makeFolders();
+
+    char *rawName = autoSprintf( "%s/raw.pack", folderName );
+    char *zipName = autoSprintf( "%s/zip.pack", folderName );
+
+
+    // small and large files, compressible and not, including empty
+    for( int i=0; i<40; i++ ) {
+        int length = ( i * 997 ) % 5000;
+        if( i % 10 == 3 ) {
+            length = 100000 + i;
+            }
+        writeBenchFile( subfolders[ i % 2 ], i, length );
+        }
+
+    check( writeBenchArchive( rawName, false ), "write raw archive" );
+    check( writeBenchArchive( zipName, true ), "write compressed archive" );
+
+    checkArchive( rawName, false );
+    checkArchive( zipName, true );
+    checkMappedEntry( rawName );
+    checkDamaged( rawName );
+
+    if( numFailed == 0 ) {
+        printf( "Content, view, listing, and verification checks "
+                "passed\n\n" );
+        }
+
+
+    removeTestFiles();
+    clearBenchFiles();
+    makeFolders();
+
+    long totalBytes = 0;
+    for( int i=0; i<numFiles; i++ ) {
+        int length = 256 + ( i * 7919 ) % maxFileBytes;
+        writeBenchFile( subfolders[ i % 2 ], i, length );
+        totalBytes += length;
+        }
+
+    writeBenchArchive( rawName, false );
+    writeBenchArchive( zipName, true );
+
+    long looseSum, rawSum, zipSum;
+
+    printf( "%d files, %.2f MiB total:\n", numFiles,
+            totalBytes / ( 1024.0 * 1024.0 ) );
+
+    for( int cold=1; cold>=0; cold-- ) {
+        double looseTime, rawTime, zipTime;
+
+        // untimed pass first when warm, since cold runs evict everything
+        if( cold ) {
+            evictAll( rawName );
+            }
+        else {
+            timeLoose( &looseSum );
+            }
+        looseTime = timeLoose( &looseSum );
+
+        if( cold ) {
+            evictAll( rawName );
+            }
+        else {
+            timeArchive( rawName, &rawSum );
+            }
+        rawTime = timeArchive( rawName, &rawSum );
+
+        if( cold ) {
+            evictAll( zipName );
+            }
+        else {
+            timeArchive( zipName, &zipSum );
+            }
+        zipTime = timeArchive( zipName, &zipSum );
+
+        check( looseSum == rawSum && looseSum == zipSum,
+               "same bytes read every way" );
+
+        const char *label = cold ? "cold" : "warm";
+
+        printf( "%s  %-34s %9.2f ms\n", label,
+                "loose files, exists + open each", 1000 * looseTime );
+        printf( "%s  %-34s %9.2f ms\n", label,
+                "archive, raw views", 1000 * rawTime );
+        printf( "%s  %-34s %9.2f ms\n", label,
+                "archive, compressed", 1000 * zipTime );
+        }
+
+    delete [] rawName;
+    delete [] zipName;
+
+    removeTestFiles();
+    clearBenchFiles();
+
+    if( numFailed > 0 ) {
+        printf( "\n%d checks FAILED\n", numFailed );
+        return 1;
+        }
+
+    printf( "\nAll checks passed\n" );
+    return 0;
+    }
@@ -0,0 +1,443 @@
+// Test and benchmark for AsyncFileReader
+//
+// Usage:  asyncFileReaderTest [threads] [smallFiles] [largeMiB]
+//
+// Checks contents of small (read) and large (mapped) files, priority
+// order, reprioritizing, cancellation of pending, in-progress, and done
+// reads, and the completion queue.  Ordering checks hold a single worker
+// on a named pipe so the queue fills before anything else is read.
+//
+// Then queues one large file ahead of many small ones, and times how long
+// the small files wait:  one worker reading in request order, the way
+// gameSDL used to, against several workers with the small files raised
+// to a higher priority.
+//
+// Writes its files to asyncFileReaderTestFiles/, and removes them after.
+
+
+#include "minorGems/io/file/AsyncFileReader.h"
+#include "minorGems/io/file/File.h"
+#include "minorGems/system/Thread.h"
+#include "minorGems/system/Time.h"
+#include "minorGems/util/stringUtils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+
+
+static int numFailed = 0;
+
+
+static void check( char inPassed, const char *inWhat ) {
+    if( ! inPassed ) {
+        printf( "FAILED:  %s\n", inWhat );
+        numFailed++;
+        }
+    }
+
+
+
+static const char *folderName = "asyncFileReaderTestFiles";
+
+
+static char *filePath( const char *inName ) {
+    return autoSprintf( "%s/%s", folderName, inName );
+    }
+
+
+
+static unsigned char fileByte( int inSeed, int inIndex ) {
+    return (unsigned char)( ( inIndex * 31 + inSeed * 7 ) ^ ( inIndex >> 9 ) );
+    }
+
+
+
+static void writeTestFile( const char *inName, int inSeed, int inLength ) {
+    unsigned char *data = new unsigned char[ inLength ];
+    for( int i=0; i<inLength; i++ ) {
+        data[i] = fileByte( inSeed, i );
+        }
+
+    char *path = filePath( inName );
+    File f( NULL, path );
+    f.writeToFile( data, inLength );
+
+    delete [] path;
+    delete [] data;
+    }
+
+
+
+static char dataMatches( unsigned char *inData, int inLength,
+                         int inSeed, int inExpectedLength ) {
+    if( inData == NULL || inLength != inExpectedLength ) {
+        return false;
+        }
+    for( int i=0; i<inLength; i++ ) {
+        if( inData[i] != fileByte( inSeed, i ) ) {
+            return false;
+            }
+        }
+    return true;
+    }
+
+
+
+static void removeTestFiles() {
+    File folder( NULL, folderName );
+
+    if( folder.exists() ) {
+        int numFiles;
+        File **files = folder.getChildFiles( &numFiles );
+
+        for( int i=0; i<numFiles; i++ ) {
+            files[i]->remove();
+            delete files[i];
+            }
+        delete [] files;
+
+        folder.remove();
+        }
+    }
+
+
+
+// opening a named pipe for reading blocks until a writer opens it
+static char *pipePath = NULL;
+
+static int blockWorker( AsyncFileReader *inReader ) {
+    int handle = inReader->startRead( pipePath, 1000 );
+
+    // let worker get stuck on it
+    Thread::staticSleep( 50 );
+
+    return handle;
+    }
+
+
+static void unblockWorker() {
+    int fd = open( pipePath, O_WRONLY );
+    if( fd != -1 ) {
+        close( fd );
+        }
+    }
+
+
+
+static void checkContents() {
+    AsyncFileReader reader( 3, 1024 * 1024 );
+
+    int handles[20];
+    for( int i=0; i<20; i++ ) {
+        char *name = autoSprintf( "small%d", i );
+        char *path = filePath( name );
+
+        handles[i] = reader.startRead( path );
+
+        delete [] name;
+        delete [] path;
+        }
+
+    char *largePath = filePath( "large0" );
+    int largeHandle = reader.startRead( largePath );
+    delete [] largePath;
+
+    char *missingPath = filePath( "missing" );
+    int missingHandle = reader.startRead( missingPath );
+    delete [] missingPath;
+
+
+    char allMatch = true;
+    for( int i=0; i<20; i++ ) {
+        reader.waitUntilDone( handles[i] );
+
+        int length;
+        char mapped;
+        unsigned char *data = reader.getData( handles[i], &length, &mapped );
+
+        if( ! dataMatches( data, length, i, 1000 + i * 100 ) || mapped ) {
+            allMatch = false;
+            }
+        reader.release( handles[i] );
+        }
+    check( allMatch, "small files read into heap" );
+
+    reader.waitUntilDone( largeHandle );
+
+    int length;
+    char mapped;
+    unsigned char *data = reader.getData( largeHandle, &length, &mapped );
+    check( mapped, "large file mapped" );
+    check( dataMatches( data, length, 1000, 3 * 1024 * 1024 ),
+           "large file contents" );
+
+    unsigned char *taken = reader.takeData( largeHandle, &length );
+    check( dataMatches( taken, length, 1000, 3 * 1024 * 1024 ),
+           "taken large file copied" );
+    delete [] taken;
+
+    check( ! reader.isDone( largeHandle ), "taken handle freed" );
+
+    reader.waitUntilDone( missingHandle );
+    check( reader.isDone( missingHandle ), "missing file read done" );
+    check( reader.takeData( missingHandle, &length ) == NULL,
+           "missing file has no data" );
+    }
+
+
+
+static void checkOrder() {
+    AsyncFileReader reader( 1 );
+
+    int pipeHandle = blockWorker( &reader );
+
+    // queued while worker is stuck
+    int handles[6];
+    int priorities[6] = { 0, 0, 5, 5, -1, 0 };
+
+    for( int i=0; i<6; i++ ) {
+        char *name = autoSprintf( "small%d", i );
+        char *path = filePath( name );
+
+        handles[i] = reader.startRead( path, priorities[i] );
+
+        delete [] name;
+        delete [] path;
+        }
+
+    // last one raised above all others
+    reader.setPriority( handles[5], 10 );
+
+    // one cancelled while waiting
+    reader.cancel( handles[1] );
+
+    check( ! reader.isDone( handles[0] ), "nothing read while blocked" );
+
+    unblockWorker();
+
+    reader.waitUntilDone( pipeHandle );
+    for( int i=0; i<6; i++ ) {
+        if( i != 1 ) {
+            reader.waitUntilDone( handles[i] );
+            }
+        }
+
+    int expected[6] = { pipeHandle, handles[5], handles[2], handles[3],
+                        handles[0], handles[4] };
+
+    char orderMatches = true;
+    for( int i=0; i<6; i++ ) {
+        if( reader.getNextDone() != expected[i] ) {
+            orderMatches = false;
+            }
+        }
+    check( orderMatches,
+           "read by priority, then request order" );
+    check( reader.getNextDone() == -1, "completions reported once" );
+    check( ! reader.isDone( handles[1] ), "cancelled read never done" );
+
+
+    // cancel while read in progress
+    pipeHandle = blockWorker( &reader );
+
+    char *path = filePath( "small7" );
+    int afterHandle = reader.startRead( path );
+    delete [] path;
+
+    reader.cancel( pipeHandle );
+    unblockWorker();
+
+    reader.waitUntilDone( afterHandle );
+    check( ! reader.isDone( pipeHandle ), "cancelled in-progress read" );
+    check( reader.getNextDone() == afterHandle,
+           "cancelled in-progress read not reported" );
+    reader.release( afterHandle );
+
+
+    // raised then cancelled, so both queue entries are stale
+    pipeHandle = blockWorker( &reader );
+
+    path = filePath( "small8" );
+    int raisedHandle = reader.startRead( path );
+    delete [] path;
+
+    reader.setPriority( raisedHandle, 3 );
+    reader.setPriority( raisedHandle, 7 );
+    reader.cancel( raisedHandle );
+
+    unblockWorker();
+    reader.waitUntilDone( pipeHandle );
+
+    check( reader.getNextDone() == pipeHandle &&
+           reader.getNextDone() == -1,
+           "raised and cancelled read skipped" );
+
+    // leave some pending and some done for destructor to free
+    for( int i=0; i<5; i++ ) {
+        char *name = autoSprintf( "small%d", i );
+        path = filePath( name );
+        reader.startRead( path );
+        delete [] name;
+        delete [] path;
+        }
+    }
+
+
+
+static void checkManyHandles() {
+    AsyncFileReader reader( 2 );
+
+    char *path = filePath( "small3" );
+
+    char allMatch = true;
+
+    for( int i=0; i<2000; i++ ) {
+        int h = reader.startRead( path, i % 7 );
+
+        reader.waitUntilDone( h );
+
+        int length;
+        unsigned char *data = reader.takeData( h, &length );
+
+        if( ! dataMatches( data, length, 3, 1300 ) ) {
+            allMatch = false;
+            }
+        if( data != NULL ) {
+            delete [] data;
+            }
+        }
+    check( allMatch, "2000 reads through one table" );
+
+    delete [] path;
+    }
+
+
+
+// returns seconds until all small files done
+static double timeSmallBehindLarge( int inThreads, char inPrioritize,
+                                    int inNumSmall, double *outLargeTime ) {
+
+    // old behavior reads large file into heap
+    AsyncFileReader reader( inThreads, inPrioritize ? 1024 * 1024 : -1 );
+
+    double start = Time::getCurrentTime();
+
+    char *largePath = filePath( "large1" );
+    int largeHandle = reader.startRead( largePath );
+    delete [] largePath;
+
+    int *handles = new int[ inNumSmall ];
+    for( int i=0; i<inNumSmall; i++ ) {
+        char *name = autoSprintf( "small%d", i % 20 );
+        char *path = filePath( name );
+
+        handles[i] = reader.startRead( path, inPrioritize ? 1 : 0 );
+
+        delete [] name;
+        delete [] path;
+        }
+
+    for( int i=0; i<inNumSmall; i++ ) {
+        reader.waitUntilDone( handles[i] );
+        }
+    double smallTime = Time::getCurrentTime() - start;
+
+    reader.waitUntilDone( largeHandle );
+    *outLargeTime = Time::getCurrentTime() - start;
+
+    delete [] handles;
+
+    return smallTime;
+    }
+
+
+
+int main( int inNumArgs, char **inArgs ) {
+
+    int numThreads = 4;
+    int numSmall = 500;
+    int largeMiB = 64;
+
+    if( inNumArgs > 1 ) {
+        numThreads = atoi( inArgs[1] );
+        }
+    if( inNumArgs > 2 ) {
+        numSmall = atoi( inArgs[2] );
+        }
+    if( inNumArgs > 3 ) {
+        largeMiB = atoi( inArgs[3] );
+        }
+
+    if( numThreads < 1 || numSmall < 1 || largeMiB < 1 ) {
+        printf( "Usage:  asyncFileReaderTest [threads] [smallFiles] "
+                "[largeMiB]\n" );
+        return 1;
+        }
+
+
+    removeTestFiles();
+
+    File folder( NULL, folderName );
+    folder.makeDirectory();
+
+    for( int i=0; i<20; i++ ) {
+        char *name = autoSprintf( "small%d", i );
+        writeTestFile( name, i, 1000 + i * 100 );
+        delete [] name;
+        }
+    writeTestFile( "large0", 1000, 3 * 1024 * 1024 );
+    writeTestFile( "large1", 1001, largeMiB * 1024 * 1024 );
+
+    pipePath = filePath( "pipe" );
+    mkfifo( pipePath, 0600 );
+
+
+    checkContents();
+    checkOrder();
+    checkManyHandles();
+
+    if( numFailed == 0 ) {
+        printf( "Content, order, and cancellation checks passed\n\n" );
+        }
+
+
+    // warm the page cache, so both runs read from memory
+    double largeTime;
+    timeSmallBehindLarge( 1, false, numSmall, &largeTime );
+
+    double oldSmall = timeSmallBehindLarge( 1, false, numSmall, &largeTime );
+    double oldLarge = largeTime;
+
+    double newSmall = timeSmallBehindLarge( numThreads, true, numSmall,
+                                            &largeTime );
+    double newLarge = largeTime;
+
+    printf( "%d small files queued behind a %d MiB file:\n",
+            numSmall, largeMiB );
+    printf( "%-40s %12s %12s\n", "", "small done", "large done" );
+    printf( "%-40s %9.2f ms %9.2f ms\n", "1 worker, request order, copied",
+            1000 * oldSmall, 1000 * oldLarge );
+
+    char *label = autoSprintf( "%d workers, small first, mapped",
+                               numThreads );
+    printf( "%-40s %9.2f ms %9.2f ms\n", label,
+            1000 * newSmall, 1000 * newLarge );
+    delete [] label;
+
+
+    delete [] pipePath;
+    removeTestFiles();
+
+    if( numFailed > 0 ) {
+        printf( "\n%d checks FAILED\n", numFailed );
+        return 1;
+        }
+
+    printf( "\nAll checks passed\n" );
+    return 0;
+    }
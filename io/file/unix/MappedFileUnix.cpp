@@ -0,0 +1,78 @@
+#include "minorGems/io/file/MappedFile.h"
+
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+
+MappedFile::MappedFile( File *inFile )
+    : mData( NULL ), mLength( 0 ), mNativeHandle( NULL ), mParent( NULL ) {
+
+    char *fileName = inFile->getFullFileName();
+
+    int fd = open( fileName, O_RDONLY );
+
+    delete [] fileName;
+
+    if( fd == -1 ) {
+        return;
+        }
+
+    struct stat info;
+
+    if( fstat( fd, &info ) == 0 && info.st_size > 0 ) {
+
+        void *data = mmap( NULL, info.st_size, PROT_READ, MAP_PRIVATE,
+                           fd, 0 );
+
+        if( data != MAP_FAILED ) {
+            mData = (unsigned char *)data;
+            mLength = (int)info.st_size;
+            }
+        }
+
+    // mapping stays valid after close
+    close( fd );
+    }
+
+
+
+MappedFile::~MappedFile() {
+    if( mData != NULL && mParent == NULL ) {
+        munmap( mData, mLength );
+        }
+    }
+
+
+
+void MappedFile::adviseSequential() {
+    if( mData != NULL ) {
+        madvise( mData, mLength, MADV_SEQUENTIAL );
+        }
+    }
+
+
+
+void MappedFile::releaseRange( int inOffset, int inLength ) {
+    if( mData == NULL ) {
+        return;
+        }
+
+    long pageSize = sysconf( _SC_PAGESIZE );
+
+    // views may start part way into a page
+    long skew = (long)( (size_t)mData % pageSize );
+
+    // whole pages only
+    long start = 
+        ( skew + inOffset + pageSize - 1 ) / pageSize * pageSize - skew;
+    long end = (long)( skew + inOffset + inLength ) / pageSize * pageSize 
+        - skew;
+
+    if( end > start ) {
+        madvise( mData + start, end - start, MADV_DONTNEED );
+        }
+    }
@@ -0,0 +1,85 @@
+#include "minorGems/io/file/MappedFile.h"
+
+
+#include <windows.h>
+
+
+
+MappedFile::MappedFile( File *inFile )
+    : mData( NULL ), mLength( 0 ), mNativeHandle( NULL ), mParent( NULL ) {
+
+    char *fileName = inFile->getFullFileName();
+
+    HANDLE file = CreateFile( fileName, GENERIC_READ, FILE_SHARE_READ,
+                              NULL, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, NULL );
+
+    delete [] fileName;
+
+    if( file == INVALID_HANDLE_VALUE ) {
+        return;
+        }
+
+    DWORD length = GetFileSize( file, NULL );
+
+    if( length != INVALID_FILE_SIZE && length > 0 ) {
+
+        HANDLE mapping = CreateFileMapping( file, NULL, PAGE_READONLY,
+                                            0, 0, NULL );
+
+        if( mapping != NULL ) {
+            void *data = MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 );
+
+            if( data != NULL ) {
+                mData = (unsigned char *)data;
+                mLength = (int)length;
+                }
+
+            // view keeps the mapping alive
+            CloseHandle( mapping );
+            }
+        }
+
+    CloseHandle( file );
+    }
+
+
+
+MappedFile::~MappedFile() {
+    if( mData != NULL && mParent == NULL ) {
+        UnmapViewOfFile( mData );
+        }
+    }
+
+
+
+void MappedFile::adviseSequential() {
+    // no madvise equivalent for views, FILE_FLAG_SEQUENTIAL_SCAN only
+    // affects the cache for ReadFile
+    }
+
+
+
+void MappedFile::releaseRange( int inOffset, int inLength ) {
+    if( mData == NULL ) {
+        return;
+        }
+
+    SYSTEM_INFO info;
+    GetSystemInfo( &info );
+    long pageSize = info.dwPageSize;
+
+    // views may start part way into a page
+    long skew = (long)( (size_t)mData % pageSize );
+
+    long start = 
+        ( skew + inOffset + pageSize - 1 ) / pageSize * pageSize - skew;
+    long end = (long)( skew + inOffset + inLength ) / pageSize * pageSize 
+        - skew;
+
+    if( end > start ) {
+        // unlocking pages that aren't locked drops them from the
+        // working set
+        VirtualUnlock( mData + start, end - start );
+        }
+    }
@@ -0,0 +1,944 @@
+#ifndef COMPILED_EXPRESSION_INCLUDED
+#define COMPILED_EXPRESSION_INCLUDED
+
+#include "Expression.h"
+#include "ConstantExpression.h"
+#include "FixedConstantExpression.h"
+#include "InvertExpression.h"
+#include "NegateExpression.h"
+#include "PowerExpression.h"
+#include "ProductExpression.h"
+#include "SumExpression.h"
+#include "SinExpression.h"
+#include "CosExpression.h"
+#include "TanExpression.h"
+#include "LnExpression.h"
+#include "SqrtExpression.h"
+#include "ComparisonExpression.h"
+#include "BinaryLogicExpression.h"
+#include "VariableExpression.h"
+#include "MultiConstantArgumentExpression.h"
+
+#include "minorGems/util/SimpleVector.h"
+
+#include <math.h>
+#include <string.h>
+
+
+
+/**
+ * An Expression flattened into a linear tape of operations.
+ *
+ * Compilation folds constant subtrees and merges identical subtrees
+ * (common subexpression elimination), then orders the remaining
+ * operations so intermediate results can share a small set of registers.
+ *
+ * The tape evaluates a whole batch of samples per operation, with one
+ * tight loop per operation over arrays of doubles, which compilers
+ * vectorize for the arithmetic and comparison operations.  Each sample
+ * produces exactly the same double as Expression::evaluate would for the
+ * same variable values.
+ *
+ * The tape is a snapshot:  constants are read at compile time, so
+ * expressions must be recompiled after they are mutated.
+ *
+ * Variables passed to compile are read from caller-supplied arrays.
+ * Any other Variables in the expression are read through getValue for
+ * each use in each sample (so RandomVariables still draw fresh values),
+ * though the tape does not skip the second argument of logic operations
+ * the way the tree does.
+ *
+ * Not thread-safe; use one CompiledExpression per thread.
+ */
+class CompiledExpression {
+
+	public:
+
+
+        /**
+         * Compiles an expression.
+         *
+         * @param inExpression the expression to compile.  Must be
+         *   destroyed by caller.
+         * @param inVariables the variables that will be supplied as
+         *   input arrays to evaluate, in order.  Array must be destroyed
+         *   by caller.
+         * @param inNumVariables the number of input variables.
+         *
+         * @return the compiled expression, or NULL if inExpression contains
+         *   a node type (or comparison/logic operation) that can't be
+         *   compiled.  Must be destroyed by caller.
+         */
+        static CompiledExpression *compile( Expression *inExpression,
+                                            Variable **inVariables,
+                                            int inNumVariables );
+
+        ~CompiledExpression();
+
+
+
+        /**
+         * Evaluates the expression over a set of samples.
+         *
+         * @param inVariableValues one array per input variable, each
+         *   holding inNumSamples values.
+         * @param inNumSamples the number of samples.
+         * @param outResults array where inNumSamples results will be
+         *   returned.
+         */
+        void evaluate( double **inVariableValues, int inNumSamples,
+                       double *outResults );
+
+
+        // evaluates a single sample, with one value per input variable
+        double evaluate( double *inVariableValues );
+
+
+
+        // number of operations on the tape
+        int getNumInstructions();
+
+        // number of batch registers used by intermediate values
+        int getNumRegisters();
+
+
+
+        // number of samples evaluated per pass over the tape
+        static const int BATCH_SIZE = 256;
+
+
+        // internal node and tape representations, public for the compiler
+        enum Op {
+            opConstant = 0,
+            opInput,
+            opExternal,
+            opNegate,
+            opInvert,
+            opSin,
+            opCos,
+            opTan,
+            opLn,
+            opSqrt,
+            opSum,
+            opProduct,
+            opPower,
+            opCompare,
+            opLogic };
+
+
+        typedef struct Node {
+                Op op;
+                // comparison or logic operation
+                int kind;
+                int argA;
+                int argB;
+                double constant;
+                int inputIndex;
+                Variable *external;
+            } Node;
+
+
+        typedef struct Instruction {
+                Op op;
+                int kind;
+                // register numbers
+                int dest;
+                int argA;
+                int argB;
+                Variable *external;
+            } Instruction;
+
+
+	protected:
+
+        CompiledExpression();
+
+
+        Instruction *mInstructions;
+        int mNumInstructions;
+
+
+        // register layout:
+        //   [0, mNumInputs) input variables (point into caller arrays)
+        //   next mNumConstants: constants (filled once)
+        //   next mNumTemps: intermediate values
+        int mNumInputs;
+        int mNumConstants;
+        int mNumTemps;
+
+        // register holding the final value
+        int mResultRegister;
+
+        // BATCH_SIZE doubles for each constant and temp register
+        double *mStorage;
+
+        // current base pointer for each register
+        double **mRegisters;
+	};
+
+
+
+// builds the node graph with folding and subexpression merging
+class ExpressionCompilerGraph {
+    public:
+
+        ExpressionCompilerGraph( Variable **inVariables, int inNumVariables )
+                : mVariables( inVariables ), mNumVariables( inNumVariables ),
+                  mFailed( false ) {
+
+            mHashSize = 1024;
+            mHashTable = new int[ mHashSize ];
+            for( int i=0; i<mHashSize; i++ ) {
+                mHashTable[i] = -1;
+                }
+            }
+
+        ~ExpressionCompilerGraph() {
+            delete [] mHashTable;
+            }
+
+
+        // returns node index
+        int add( Expression *inExpression );
+
+
+        SimpleVector<CompiledExpression::Node> mNodes;
+
+        Variable **mVariables;
+        int mNumVariables;
+
+        // set if an unsupported node type was found
+        char mFailed;
+
+
+    protected:
+
+        int intern( CompiledExpression::Node *inNode );
+
+        unsigned int hash( CompiledExpression::Node *inNode );
+
+        char equal( CompiledExpression::Node *inA,
+                    CompiledExpression::Node *inB );
+
+        double fold( CompiledExpression::Node *inNode );
+
+        void growHash();
+
+        // open addressing, -1 for empty
+        int *mHashTable;
+        int mHashSize;
+
+        // next index in the chain for each node
+        SimpleVector<int> mChain;
+    };
+
+
+
+// the same operations Expression::evaluate performs, in the same order
+// shared by constant folding and the batch loops so results match exactly
+
+inline double compiledCompare( int inKind, double inA, double inB ) {
+    switch( inKind ) {
+        case ComparisonExpression::GREATER_THAN:
+            return ( inA > inB ) ? 1 : 0;
+        case ComparisonExpression::LESS_THAN:
+            return ( inA < inB ) ? 1 : 0;
+        case ComparisonExpression::GREATER_THAN_OR_EQUAL_TO:
+            return ( inA >= inB ) ? 1 : 0;
+        case ComparisonExpression::LESS_THAN_OR_EQUAL_TO:
+            return ( inA <= inB ) ? 1 : 0;
+        case ComparisonExpression::EQUAL_TO:
+            return ( inA == inB ) ? 1 : 0;
+        case ComparisonExpression::NOT_EQUAL_TO:
+            return ( inA != inB ) ? 1 : 0;
+        default:
+            return 0;
+        }
+    }
+
+
+
+inline double compiledLogic( int inKind, double inA, double inB ) {
+    switch( inKind ) {
+        case BinaryLogicExpression::LOGIC_AND:
+            return ( inA > 0 && inB > 0 ) ? 1 : 0;
+        case BinaryLogicExpression::LOGIC_OR:
+            return ( inA > 0 || inB > 0 ) ? 1 : 0;
+        case BinaryLogicExpression::LOGIC_XOR:
+            return ( ( inA > 0 && inB <= 0 ) || ( inA <= 0 && inB > 0 ) )
+                ? 1 : 0;
+        default:
+            return 0;
+        }
+    }
+
+
+
+// one loop per operation kind, so the switch folds away and the
+// loop body vectorizes
+template< int inKind >
+inline void compiledCompareLoop( double *outD, double *inA, double *inB,
+                                 int inN ) {
+    for( int s=0; s<inN; s++ ) {
+        outD[s] = compiledCompare( inKind, inA[s], inB[s] );
+        }
+    }
+
+
+
+template< int inKind >
+inline void compiledLogicLoop( double *outD, double *inA, double *inB,
+                               int inN ) {
+    for( int s=0; s<inN; s++ ) {
+        outD[s] = compiledLogic( inKind, inA[s], inB[s] );
+        }
+    }
+
+
+
+inline double ExpressionCompilerGraph::fold( CompiledExpression::Node *inNode ) {
+    double a = mNodes.getElementDirect( inNode->argA ).constant;
+    double b = 0;
+    if( inNode->argB != -1 ) {
+        b = mNodes.getElementDirect( inNode->argB ).constant;
+        }
+
+    switch( inNode->op ) {
+        case CompiledExpression::opNegate:
+            return -a;
+        case CompiledExpression::opInvert:
+            return 1 / a;
+        case CompiledExpression::opSin:
+            return sin( a );
+        case CompiledExpression::opCos:
+            return cos( a );
+        case CompiledExpression::opTan:
+            return tan( a );
+        case CompiledExpression::opLn:
+            return log( a );
+        case CompiledExpression::opSqrt:
+            return sqrt( a );
+        case CompiledExpression::opSum:
+            return a + b;
+        case CompiledExpression::opProduct:
+            return a * b;
+        case CompiledExpression::opPower:
+            return pow( a, b );
+        case CompiledExpression::opCompare:
+            return compiledCompare( inNode->kind, a, b );
+        case CompiledExpression::opLogic:
+            return compiledLogic( inNode->kind, a, b );
+        default:
+            return 0;
+        }
+    }
+
+
+
+inline unsigned int ExpressionCompilerGraph::hash(
+    CompiledExpression::Node *inNode ) {
+
+    unsigned int h = 2166136261U;
+
+    #define COMPILED_EXPRESSION_MIX( x ) h = ( h ^ (unsigned int)( x ) ) * 16777619U
+
+    COMPILED_EXPRESSION_MIX( inNode->op );
+    COMPILED_EXPRESSION_MIX( inNode->kind );
+    COMPILED_EXPRESSION_MIX( inNode->argA );
+    COMPILED_EXPRESSION_MIX( inNode->argB );
+    COMPILED_EXPRESSION_MIX( inNode->inputIndex );
+
+    unsigned char bytes[ sizeof( double ) ];
+    memcpy( bytes, &( inNode->constant ), sizeof( double ) );
+    for( unsigned int i=0; i<sizeof( double ); i++ ) {
+        COMPILED_EXPRESSION_MIX( bytes[i] );
+        }
+
+    #undef COMPILED_EXPRESSION_MIX
+
+    return h;
+    }
+
+
+
+inline char ExpressionCompilerGraph::equal( CompiledExpression::Node *inA,
+                                            CompiledExpression::Node *inB ) {
+    // constants compared bit-for-bit, so 0 and -0 (and NaNs) stay apart
+    return inA->op == inB->op &&
+        inA->kind == inB->kind &&
+        inA->argA == inB->argA &&
+        inA->argB == inB->argB &&
+        inA->inputIndex == inB->inputIndex &&
+        inA->external == inB->external &&
+        memcmp( &( inA->constant ), &( inB->constant ),
+                sizeof( double ) ) == 0;
+    }
+
+
+
+inline void ExpressionCompilerGraph::growHash() {
+    delete [] mHashTable;
+
+    mHashSize *= 2;
+    mHashTable = new int[ mHashSize ];
+    for( int i=0; i<mHashSize; i++ ) {
+        mHashTable[i] = -1;
+        }
+
+    int numNodes = mNodes.size();
+    for( int i=0; i<numNodes; i++ ) {
+        unsigned int bucket =
+            hash( mNodes.getElement( i ) ) & ( mHashSize - 1 );
+
+        *( mChain.getElement( i ) ) = mHashTable[ bucket ];
+        mHashTable[ bucket ] = i;
+        }
+    }
+
+
+
+inline int ExpressionCompilerGraph::intern( CompiledExpression::Node *inNode ) {
+
+    // external variables must be read once per use, so a random
+    // variable used twice still draws twice, like the tree
+    char mergeable = ( inNode->op != CompiledExpression::opExternal );
+
+    unsigned int bucket = hash( inNode ) & ( mHashSize - 1 );
+
+    if( mergeable ) {
+        int i = mHashTable[ bucket ];
+        while( i != -1 ) {
+            if( equal( mNodes.getElement( i ), inNode ) ) {
+                return i;
+                }
+            i = mChain.getElementDirect( i );
+            }
+        }
+
+    int index = mNodes.size();
+    mNodes.push_back( *inNode );
+    mChain.push_back( mHashTable[ bucket ] );
+    mHashTable[ bucket ] = index;
+
+    if( mNodes.size() > mHashSize ) {
+        growHash();
+        }
+
+    return index;
+    }
+
+
+
+inline int ExpressionCompilerGraph::add( Expression *inExpression ) {
+
+    CompiledExpression::Node node;
+    node.kind = 0;
+    node.argA = -1;
+    node.argB = -1;
+    node.constant = 0;
+    node.inputIndex = -1;
+    node.external = NULL;
+
+    long id = inExpression->getID();
+
+    if( id == ConstantExpression::staticGetID() ) {
+        node.op = CompiledExpression::opConstant;
+        node.constant = inExpression->evaluate();
+        return intern( &node );
+        }
+    if( id == FixedConstantExpression::staticGetID() ) {
+        node.op = CompiledExpression::opConstant;
+        node.constant = inExpression->evaluate();
+        return intern( &node );
+        }
+    if( id == VariableExpression::staticGetID() ) {
+        Variable *v = ( (VariableExpression *)inExpression )->getVariable();
+
+        for( int i=0; i<mNumVariables; i++ ) {
+            if( mVariables[i] == v ) {
+                node.op = CompiledExpression::opInput;
+                node.inputIndex = i;
+                return intern( &node );
+                }
+            }
+
+        node.op = CompiledExpression::opExternal;
+        node.external = v;
+        return intern( &node );
+        }
+    if( id == MultiConstantArgumentExpression::staticGetID() ) {
+        return add( ( (MultiConstantArgumentExpression *)inExpression )->
+                    getWrappedExpression() );
+        }
+
+
+    if( id == NegateExpression::staticGetID() ) {
+        node.op = CompiledExpression::opNegate;
+        }
+    else if( id == InvertExpression::staticGetID() ) {
+        node.op = CompiledExpression::opInvert;
+        }
+    else if( id == SinExpression::staticGetID() ) {
+        node.op = CompiledExpression::opSin;
+        }
+    else if( id == CosExpression::staticGetID() ) {
+        node.op = CompiledExpression::opCos;
+        }
+    else if( id == TanExpression::staticGetID() ) {
+        node.op = CompiledExpression::opTan;
+        }
+    else if( id == LnExpression::staticGetID() ) {
+        node.op = CompiledExpression::opLn;
+        }
+    else if( id == SqrtExpression::staticGetID() ) {
+        node.op = CompiledExpression::opSqrt;
+        }
+    else if( id == SumExpression::staticGetID() ) {
+        node.op = CompiledExpression::opSum;
+        }
+    else if( id == ProductExpression::staticGetID() ) {
+        node.op = CompiledExpression::opProduct;
+        }
+    else if( id == PowerExpression::staticGetID() ) {
+        node.op = CompiledExpression::opPower;
+        }
+    else if( id == ComparisonExpression::staticGetID() ) {
+        node.op = CompiledExpression::opCompare;
+        node.kind = ( (ComparisonExpression *)inExpression )->getComparison();
+        if( node.kind < ComparisonExpression::GREATER_THAN ||
+            node.kind > ComparisonExpression::NOT_EQUAL_TO ) {
+            mFailed = true;
+            return 0;
+            }
+        }
+    else if( id == BinaryLogicExpression::staticGetID() ) {
+        node.op = CompiledExpression::opLogic;
+        node.kind =
+            ( (BinaryLogicExpression *)inExpression )->getLogicOperation();
+        if( node.kind < BinaryLogicExpression::LOGIC_AND ||
+            node.kind > BinaryLogicExpression::LOGIC_XOR ) {
+            mFailed = true;
+            return 0;
+            }
+        }
+    else {
+        mFailed = true;
+        return 0;
+        }
+
+
+    int numArgs = inExpression->getNumArguments();
+
+    Expression *argA = inExpression->getArgument( 0 );
+
+    if( argA == NULL || mFailed ) {
+        mFailed = true;
+        return 0;
+        }
+    node.argA = add( argA );
+
+    if( numArgs > 1 ) {
+        Expression *argB = inExpression->getArgument( 1 );
+        if( argB == NULL || mFailed ) {
+            mFailed = true;
+            return 0;
+            }
+        node.argB = add( argB );
+        }
+
+    if( mFailed ) {
+        return 0;
+        }
+
+
+    // fold if all arguments are constants
+    char allConstant =
+        mNodes.getElementDirect( node.argA ).op ==
+        CompiledExpression::opConstant;
+
+    if( node.argB != -1 &&
+        mNodes.getElementDirect( node.argB ).op !=
+        CompiledExpression::opConstant ) {
+        allConstant = false;
+        }
+
+    if( allConstant ) {
+        double value = fold( &node );
+
+        node.op = CompiledExpression::opConstant;
+        node.kind = 0;
+        node.argA = -1;
+        node.argB = -1;
+        node.constant = value;
+        }
+
+    return intern( &node );
+    }
+
+
+
+
+inline CompiledExpression::CompiledExpression()
+        : mInstructions( NULL ), mNumInstructions( 0 ),
+          mNumInputs( 0 ), mNumConstants( 0 ), mNumTemps( 0 ),
+          mResultRegister( 0 ),
+          mStorage( NULL ), mRegisters( NULL ) {
+    }
+
+
+
+inline CompiledExpression::~CompiledExpression() {
+    if( mInstructions != NULL ) {
+        delete [] mInstructions;
+        }
+    if( mStorage != NULL ) {
+        delete [] mStorage;
+        }
+    if( mRegisters != NULL ) {
+        delete [] mRegisters;
+        }
+    }
+
+
+
+inline CompiledExpression *CompiledExpression::compile(
+    Expression *inExpression,
+    Variable **inVariables, int inNumVariables ) {
+
+    ExpressionCompilerGraph graph( inVariables, inNumVariables );
+
+    int root = graph.add( inExpression );
+
+    if( graph.mFailed ) {
+        return NULL;
+        }
+
+    int numNodes = graph.mNodes.size();
+    CompiledExpression::Node *nodes = graph.mNodes.getElementArray();
+
+
+    // folding leaves unreachable constants behind, find what's used
+    // children always have lower indices than their parents
+    char *reachable = new char[ numNodes ];
+    memset( reachable, false, numNodes );
+    reachable[ root ] = true;
+
+    for( int i=root; i>=0; i-- ) {
+        if( reachable[i] ) {
+            if( nodes[i].argA != -1 ) {
+                reachable[ nodes[i].argA ] = true;
+                }
+            if( nodes[i].argB != -1 ) {
+                reachable[ nodes[i].argB ] = true;
+                }
+            }
+        }
+
+
+    // last instruction that reads each node
+    int *lastUse = new int[ numNodes ];
+    for( int i=0; i<numNodes; i++ ) {
+        lastUse[i] = -1;
+        }
+    for( int i=0; i<numNodes; i++ ) {
+        if( reachable[i] ) {
+            if( nodes[i].argA != -1 ) {
+                lastUse[ nodes[i].argA ] = i;
+                }
+            if( nodes[i].argB != -1 ) {
+                lastUse[ nodes[i].argB ] = i;
+                }
+            }
+        }
+    // result must survive to the end
+    lastUse[ root ] = numNodes;
+
+
+    CompiledExpression *c = new CompiledExpression();
+    c->mNumInputs = inNumVariables;
+
+
+    // constants get fixed registers
+    int *nodeRegister = new int[ numNodes ];
+    SimpleVector<double> constants;
+
+    for( int i=0; i<numNodes; i++ ) {
+        nodeRegister[i] = -1;
+
+        if( ! reachable[i] ) {
+            continue;
+            }
+        if( nodes[i].op == opConstant ) {
+            nodeRegister[i] = inNumVariables + constants.size();
+            constants.push_back( nodes[i].constant );
+            }
+        else if( nodes[i].op == opInput ) {
+            nodeRegister[i] = nodes[i].inputIndex;
+            }
+        }
+    c->mNumConstants = constants.size();
+
+    int tempBase = inNumVariables + c->mNumConstants;
+
+
+    // operations in node order, reusing temp registers after last use
+    SimpleVector<Instruction> instructions;
+    SimpleVector<int> freeTemps;
+    int numTemps = 0;
+
+    for( int i=0; i<numNodes; i++ ) {
+        if( ! reachable[i] ||
+            nodes[i].op == opConstant || nodes[i].op == opInput ) {
+            continue;
+            }
+
+        Instruction inst;
+        inst.op = nodes[i].op;
+        inst.kind = nodes[i].kind;
+        inst.external = nodes[i].external;
+        inst.argA = -1;
+        inst.argB = -1;
+
+        if( nodes[i].argA != -1 ) {
+            inst.argA = nodeRegister[ nodes[i].argA ];
+            }
+        if( nodes[i].argB != -1 ) {
+            inst.argB = nodeRegister[ nodes[i].argB ];
+            }
+
+        // free argument temps that die here, so the result can reuse
+        // one of them (operations are elementwise, so in-place is safe)
+        int args[2] = { nodes[i].argA, nodes[i].argB };
+        for( int k=0; k<2; k++ ) {
+            int a = args[k];
+            if( a != -1 && lastUse[a] == i &&
+                nodeRegister[a] >= tempBase ) {
+
+                if( k == 1 && args[0] == args[1] ) {
+                    // already freed
+                    continue;
+                    }
+                freeTemps.push_back( nodeRegister[a] );
+                }
+            }
+
+        int dest;
+        if( freeTemps.size() > 0 ) {
+            dest = freeTemps.getElementDirect( freeTemps.size() - 1 );
+            freeTemps.deleteElement( freeTemps.size() - 1 );
+            }
+        else {
+            dest = tempBase + numTemps;
+            numTemps++;
+            }
+
+        nodeRegister[i] = dest;
+        inst.dest = dest;
+
+        instructions.push_back( inst );
+        }
+
+    c->mNumTemps = numTemps;
+    c->mResultRegister = nodeRegister[ root ];
+
+    c->mNumInstructions = instructions.size();
+    c->mInstructions = instructions.getElementArray();
+
+
+    int numRegisters = tempBase + numTemps;
+
+    c->mRegisters = new double*[ numRegisters ];
+    c->mStorage = new double[ ( c->mNumConstants + numTemps ) * BATCH_SIZE ];
+
+    for( int r=0; r<numRegisters; r++ ) {
+        c->mRegisters[r] = NULL;
+        }
+    for( int r=inNumVariables; r<numRegisters; r++ ) {
+        c->mRegisters[r] =
+            &( c->mStorage[ ( r - inNumVariables ) * BATCH_SIZE ] );
+        }
+    for( int k=0; k<c->mNumConstants; k++ ) {
+        double *reg = c->mRegisters[ inNumVariables + k ];
+        double value = constants.getElementDirect( k );
+        for( int s=0; s<BATCH_SIZE; s++ ) {
+            reg[s] = value;
+            }
+        }
+
+    delete [] reachable;
+    delete [] lastUse;
+    delete [] nodeRegister;
+    delete [] nodes;
+
+    return c;
+    }
+
+
+
+inline int CompiledExpression::getNumInstructions() {
+    return mNumInstructions;
+    }
+
+
+
+inline int CompiledExpression::getNumRegisters() {
+    return mNumTemps;
+    }
+
+
+
+inline void CompiledExpression::evaluate( double **inVariableValues,
+                                          int inNumSamples,
+                                          double *outResults ) {
+
+    for( int offset=0; offset<inNumSamples; offset += BATCH_SIZE ) {
+
+        int n = inNumSamples - offset;
+        if( n > BATCH_SIZE ) {
+            n = BATCH_SIZE;
+            }
+
+        for( int v=0; v<mNumInputs; v++ ) {
+            mRegisters[v] = &( inVariableValues[v][ offset ] );
+            }
+
+        for( int i=0; i<mNumInstructions; i++ ) {
+            Instruction *inst = &( mInstructions[i] );
+
+            double *d = mRegisters[ inst->dest ];
+            double *a = NULL;
+            double *b = NULL;
+
+            if( inst->argA != -1 ) {
+                a = mRegisters[ inst->argA ];
+                }
+            if( inst->argB != -1 ) {
+                b = mRegisters[ inst->argB ];
+                }
+
+            int s;
+            switch( inst->op ) {
+                case opExternal:
+                    for( s=0; s<n; s++ ) {
+                        d[s] = inst->external->getValue();
+                        }
+                    break;
+                case opNegate:
+                    for( s=0; s<n; s++ ) {
+                        d[s] = -a[s];
+                        }
+                    break;
+                case opInvert:
+                    for( s=0; s<n; s++ ) {
+                        d[s] = 1 / a[s];
+                        }
+                    break;
+                case opSin:
+                    for( s=0; s<n; s++ ) {
+                        d[s] = sin( a[s] );
+                        }
+                    break;
+                case opCos:
+                    for( s=0; s<n; s++ ) {
+                        d[s] = cos( a[s] );
+                        }
+                    break;
+                case opTan:
+                    for( s=0; s<n; s++ ) {
+                        d[s] = tan( a[s] );
+                        }
+                    break;
+                case opLn:
+                    for( s=0; s<n; s++ ) {
+                        d[s] = log( a[s] );
+                        }
+                    break;
+                case opSqrt:
+                    for( s=0; s<n; s++ ) {
+                        d[s] = sqrt( a[s] );
+                        }
+                    break;
+                case opSum:
+                    for( s=0; s<n; s++ ) {
+                        d[s] = a[s] + b[s];
+                        }
+                    break;
+                case opProduct:
+                    for( s=0; s<n; s++ ) {
+                        d[s] = a[s] * b[s];
+                        }
+                    break;
+                case opPower:
+                    for( s=0; s<n; s++ ) {
+                        d[s] = pow( a[s], b[s] );
+                        }
+                    break;
+                case opCompare:
+                    switch( inst->kind ) {
+                        case 0:
+                            compiledCompareLoop<0>( d, a, b, n );
+                            break;
+                        case 1:
+                            compiledCompareLoop<1>( d, a, b, n );
+                            break;
+                        case 2:
+                            compiledCompareLoop<2>( d, a, b, n );
+                            break;
+                        case 3:
+                            compiledCompareLoop<3>( d, a, b, n );
+                            break;
+                        case 4:
+                            compiledCompareLoop<4>( d, a, b, n );
+                            break;
+                        default:
+                            compiledCompareLoop<5>( d, a, b, n );
+                            break;
+                        }
+                    break;
+                case opLogic:
+                    switch( inst->kind ) {
+                        case 0:
+                            compiledLogicLoop<0>( d, a, b, n );
+                            break;
+                        case 1:
+                            compiledLogicLoop<1>( d, a, b, n );
+                            break;
+                        default:
+                            compiledLogicLoop<2>( d, a, b, n );
+                            break;
+                        }
+                    break;
+                default:
+                    break;
+                }
+            }
+
+        memcpy( &( outResults[ offset ] ), mRegisters[ mResultRegister ],
+                sizeof( double ) * n );
+        }
+    }
+
+
+
+inline double CompiledExpression::evaluate( double *inVariableValues ) {
+
+    double **columns = NULL;
+    if( mNumInputs > 0 ) {
+        columns = new double*[ mNumInputs ];
+        for( int v=0; v<mNumInputs; v++ ) {
+            columns[v] = &( inVariableValues[v] );
+            }
+        }
+
+    double result;
+    evaluate( columns, 1, &result );
+
+    if( columns != NULL ) {
+        delete [] columns;
+        }
+    return result;
+    }
+
+
+
+#endif
@@ -0,0 +1,350 @@
+// Checks CompiledExpression against tree-walking Expression::evaluate on
+// random trees over two variables, then times both on larger trees.
+//
+// Usage:  testCompiledExpression [numSamples]
+
+
+#include "CompiledExpression.h"
+
+#include "minorGems/system/Time.h"
+#include "minorGems/util/random/StdRandomSource.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+
+static Variable *variables[2];
+
+
+static Expression *randomLeaf( RandomSource *inRand ) {
+    switch( inRand->getRandomBoundedInt( 0, 3 ) ) {
+        case 0:
+            return new ConstantExpression(
+                inRand->getRandomBoundedDouble( -4, 4 ) );
+        case 1:
+            return new FixedConstantExpression(
+                inRand->getRandomBoundedDouble( -4, 4 ) );
+        case 2:
+            return new VariableExpression( variables[0] );
+        default:
+            return new VariableExpression( variables[1] );
+        }
+    }
+
+
+
+// every node type the compiler handles, with repeated subtrees thrown in
+// so subexpression merging has something to find
+// inFactoryMix limits nodes to the types RandomExpressionFactory builds
+static Expression *randomTree( RandomSource *inRand, int inDepth,
+                               char inFactoryMix = false ) {
+
+    if( inDepth == 0 || inRand->getRandomDouble() < 0.15 ) {
+        return randomLeaf( inRand );
+        }
+
+    Expression *e;
+
+    int type = inRand->getRandomBoundedInt( 0, 12 );
+    if( inFactoryMix ) {
+        int mix[4] = { 0, 2, 7, 8 };
+        type = mix[ inRand->getRandomBoundedInt( 0, 3 ) ];
+        }
+
+    switch( type ) {
+        case 0:
+            e = new NegateExpression( NULL );
+            break;
+        case 1:
+            e = new InvertExpression( NULL );
+            break;
+        case 2:
+            e = new SinExpression( NULL );
+            break;
+        case 3:
+            e = new CosExpression( NULL );
+            break;
+        case 4:
+            e = new TanExpression( NULL );
+            break;
+        case 5:
+            e = new LnExpression( NULL );
+            break;
+        case 6:
+            e = new SqrtExpression( NULL );
+            break;
+        case 7:
+            e = new SumExpression( NULL, NULL );
+            break;
+        case 8:
+            e = new ProductExpression( NULL, NULL );
+            break;
+        case 9:
+            e = new PowerExpression( NULL, NULL );
+            break;
+        case 10:
+            e = new ComparisonExpression(
+                inRand->getRandomBoundedInt( 0, 5 ), NULL, NULL );
+            break;
+        case 11:
+            e = new BinaryLogicExpression(
+                inRand->getRandomBoundedInt( 0, 2 ), NULL, NULL );
+            break;
+        default:
+            e = new MultiConstantArgumentExpression(
+                randomTree( inRand, inDepth - 1, inFactoryMix ) );
+            return e;
+        }
+
+    Expression *first = randomTree( inRand, inDepth - 1, inFactoryMix );
+    e->setArgument( 0, first );
+
+    if( e->getNumArguments() > 1 ) {
+        if( inRand->getRandomDouble() < 0.3 ) {
+            e->setArgument( 1, first->copy() );
+            }
+        else {
+            e->setArgument( 1,
+                            randomTree( inRand, inDepth - 1, inFactoryMix ) );
+            }
+        }
+
+    return e;
+    }
+
+
+
+// bit-identical, or NaN on both sides
+static char sameResult( double inA, double inB ) {
+    if( memcmp( &inA, &inB, sizeof( double ) ) == 0 ) {
+        return true;
+        }
+    return inA != inA && inB != inB;
+    }
+
+
+
+static void fillSamples( RandomSource *inRand, double **outColumns,
+                         int inNumSamples ) {
+    for( int v=0; v<2; v++ ) {
+        for( int s=0; s<inNumSamples; s++ ) {
+            outColumns[v][s] = inRand->getRandomBoundedDouble( -3, 3 );
+            }
+        }
+    }
+
+
+
+static void treeEvaluate( Expression *inExpression, double **inColumns,
+                          int inNumSamples, double *outResults ) {
+    for( int s=0; s<inNumSamples; s++ ) {
+        variables[0]->setValue( inColumns[0][s] );
+        variables[1]->setValue( inColumns[1][s] );
+        outResults[s] = inExpression->evaluate();
+        }
+    }
+
+
+
+// times tree walking against the tape on a random tree that doesn't
+// mostly fold away, returns the number of mismatched samples
+static int timeTree( const char *inName, RandomSource *inRand,
+                     char inFactoryMix,
+                     double **inColumns, int inNumSamples,
+                     double *outExpected, double *outResults ) {
+
+    Expression *tree = NULL;
+    CompiledExpression *compiled = NULL;
+
+    while( compiled == NULL || compiled->getNumInstructions() < 60 ) {
+        if( compiled != NULL ) {
+            delete compiled;
+            }
+        if( tree != NULL ) {
+            delete tree;
+            }
+        tree = randomTree( inRand, 11, inFactoryMix );
+        compiled = CompiledExpression::compile( tree, variables, 2 );
+        }
+
+    int numPasses = 50;
+
+    double t = Time::getCurrentTime();
+    for( int p=0; p<numPasses; p++ ) {
+        treeEvaluate( tree, inColumns, inNumSamples, outExpected );
+        }
+    double treeTime = ( Time::getCurrentTime() - t ) / numPasses;
+
+    t = Time::getCurrentTime();
+    for( int p=0; p<numPasses; p++ ) {
+        compiled->evaluate( inColumns, inNumSamples, outResults );
+        }
+    double tapeTime = ( Time::getCurrentTime() - t ) / numPasses;
+
+    int numBad = 0;
+    for( int s=0; s<inNumSamples; s++ ) {
+        if( ! sameResult( outExpected[s], outResults[s] ) ) {
+            numBad++;
+            }
+        }
+
+    printf( "\n%s:  %d samples, %d tape instructions, %d registers\n",
+            inName, inNumSamples, compiled->getNumInstructions(),
+            compiled->getNumRegisters() );
+    printf( "tree walk:  %8.3f ms\n", 1000 * treeTime );
+    printf( "tape:       %8.3f ms  (%.1fx)  %s\n", 1000 * tapeTime,
+            treeTime / tapeTime, numBad == 0 ? "ok" : "MISMATCH" );
+
+    delete compiled;
+    delete tree;
+
+    return numBad;
+    }
+
+
+
+int main( int inNumArgs, char **inArgs ) {
+
+    int numSamples = 10000;
+    if( inNumArgs > 1 ) {
+        numSamples = atoi( inArgs[1] );
+        }
+
+    StdRandomSource rand( 1 );
+
+    variables[0] = new Variable( (char *)"x", 0 );
+    variables[1] = new Variable( (char *)"y", 0 );
+
+    double *columns[2];
+    columns[0] = new double[ numSamples ];
+    columns[1] = new double[ numSamples ];
+
+    double *expected = new double[ numSamples ];
+    double *results = new double[ numSamples ];
+
+
+    // correctness over many random trees, including odd sample counts
+    int numTrees = 500;
+    int numBad = 0;
+    int totalInstructions = 0;
+
+    for( int t=0; t<numTrees; t++ ) {
+        Expression *tree = randomTree( &rand, 2 + t % 8 );
+
+        CompiledExpression *compiled =
+            CompiledExpression::compile( tree, variables, 2 );
+
+        if( compiled == NULL ) {
+            printf( "tree %d failed to compile\n", t );
+            numBad++;
+            delete tree;
+            continue;
+            }
+
+        totalInstructions += compiled->getNumInstructions();
+
+        int n = 1 + t * 37 % 1000;
+        fillSamples( &rand, columns, n );
+
+        treeEvaluate( tree, columns, n, expected );
+        compiled->evaluate( columns, n, results );
+
+        for( int s=0; s<n; s++ ) {
+            if( ! sameResult( expected[s], results[s] ) ) {
+                if( numBad < 10 ) {
+                    printf( "tree %d sample %d:  tree %.17g, tape %.17g\n",
+                            t, s, expected[s], results[s] );
+                    }
+                numBad++;
+                break;
+                }
+            }
+
+        // single-sample path
+        double point[2] = { columns[0][0], columns[1][0] };
+        if( ! sameResult( expected[0], compiled->evaluate( point ) ) ) {
+            printf( "tree %d single sample mismatch\n", t );
+            numBad++;
+            }
+
+        delete compiled;
+        delete tree;
+        }
+
+    printf( "%d random trees, %d tape instructions total:  %s\n",
+            numTrees, totalInstructions, numBad == 0 ? "ok" : "MISMATCH" );
+
+
+    // variables not passed to compile are read through getValue
+    Expression *partial =
+        new SumExpression( new VariableExpression( variables[0] ),
+                           new ProductExpression(
+                               new VariableExpression( variables[1] ),
+                               new ConstantExpression( 2 ) ) );
+
+    CompiledExpression *partialCompiled =
+        CompiledExpression::compile( partial, variables, 1 );
+
+    variables[1]->setValue( 0.25 );
+    double x = 3;
+    if( partialCompiled->evaluate( &x ) != 3.5 ) {
+        printf( "external variable mismatch\n" );
+        numBad++;
+        }
+    delete partialCompiled;
+    delete partial;
+
+
+    // constant subtrees fold away, repeated subtrees merge
+    Expression *folded =
+        new SumExpression(
+            new SinExpression(
+                new ProductExpression( new VariableExpression( variables[0] ),
+                                       new ConstantExpression( 3 ) ) ),
+            new ProductExpression(
+                new SinExpression(
+                    new ProductExpression(
+                        new VariableExpression( variables[0] ),
+                        new ConstantExpression( 3 ) ) ),
+                new LnExpression( new ConstantExpression( 10 ) ) ) );
+
+    CompiledExpression *foldedCompiled =
+        CompiledExpression::compile( folded, variables, 2 );
+
+    // x*3, sin, *ln(10), sum
+    if( foldedCompiled->getNumInstructions() != 4 ) {
+        printf( "expected 4 instructions after folding, got %d\n",
+                foldedCompiled->getNumInstructions() );
+        numBad++;
+        }
+    delete foldedCompiled;
+    delete folded;
+
+
+    if( numBad != 0 ) {
+        printf( "FAILED\n" );
+        return 1;
+        }
+
+
+    // timing, with the RandomExpressionFactory operation mix and with
+    // every operation
+    fillSamples( &rand, columns, numSamples );
+
+    int timeBad =
+        timeTree( "sum/product/negate/sin", &rand, true,
+                  columns, numSamples, expected, results ) +
+        timeTree( "all operations", &rand, false,
+                  columns, numSamples, expected, results );
+
+    delete [] columns[0];
+    delete [] columns[1];
+    delete [] expected;
+    delete [] results;
+    delete variables[0];
+    delete variables[1];
+
+    return timeBad == 0 ? 0 : 1;
+    }
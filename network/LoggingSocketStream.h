@@ -64,6 +64,9 @@ class LoggingSocketStream : public SocketStream {
         long read( unsigned char *inBuffer, long inNumBytes );
 
         long write( unsigned char *inBuffer, long inNumBytes );
+
+        long writeVector( unsigned char **inBuffers, long *inLengths,
+                          int inNumBuffers );
         
         
     protected:
@@ -74,6 +77,9 @@ class LoggingSocketStream : public SocketStream {
         FILE *mOutboundLogFile;
         unsigned long mInboundSizeSoFar;
         unsigned long mOutboundSizeSoFar;
+
+
+        void logOutbound( unsigned char *inBuffer, long inNumBytes );
         
     };        
 
@@ -157,9 +163,38 @@ inline long LoggingSocketStream::write( unsigned char *inBuffer,
 
     long returnVal = SocketStream::write( inBuffer, inNumBytes );
         
+    if( returnVal == inNumBytes ) {
+        logOutbound( inBuffer, inNumBytes );
+        }
+    
+    return returnVal;    
+    }
+
+
+
+inline long LoggingSocketStream::writeVector( unsigned char **inBuffers,
+                                              long *inLengths,
+                                              int inNumBuffers ) {
+
+    long returnVal = SocketStream::writeVector( inBuffers, inLengths,
+                                                inNumBuffers );
+
+    if( returnVal != -1 ) {
+        for( int i=0; i<inNumBuffers; i++ ) {
+            logOutbound( inBuffers[i], inLengths[i] );
+            }
+        }
+
+    return returnVal;
+    }
+
+
+
+inline void LoggingSocketStream::logOutbound( unsigned char *inBuffer,
+                                              long inNumBytes ) {
+
     if( mEnableOutboundLog &&
-        mOutboundSizeSoFar < mLogSizeLimit &&
-        returnVal == inNumBytes ) {
+        mOutboundSizeSoFar < mLogSizeLimit ) {
 
         int numToLog = inNumBytes;
         if( mOutboundSizeSoFar + numToLog > mLogSizeLimit ) {
@@ -172,8 +207,6 @@ inline long LoggingSocketStream::write( unsigned char *inBuffer,
             }
         mOutboundSizeSoFar += numToLog;
         }
-    
-    return returnVal;    
     }
     
     
@@ -62,6 +62,18 @@
 
 #include "minorGems/network/HostAddress.h"
 #include "minorGems/system/Time.h"
+#include "minorGems/util/SimpleVector.h"
+
+#include <string.h>
+
+
+
+// one chunk of a Socket's send queue
+typedef struct SocketSendBlock {
+        unsigned char *bytes;
+        int size;
+        int capacity;
+    } SocketSendBlock;
 
 
 
@@ -126,6 +138,48 @@ class Socket {
          * @return 1 on success, 0 on still waiting, -1 on error.
          */
         int isConnected();
+
+
+        /**
+         * For sockets whose connection is being watched by a SocketPoll:
+         *
+         * Checks the result of a non-blocking connect once the poller has
+         * seen the socket become writable or fail.  Updates the state that
+         * isConnected returns.
+         *
+         * @return 1 on success, -1 on error.
+         */
+        int finishConnect();
+
+
+        // true if a non-blocking connect has neither finished nor failed
+        char isConnectPending() {
+            return !mConnected && !mConnectFailed;
+            }
+
+
+        // called by SocketPoll implementations that report connection
+        // completion through finishConnect, so isConnected can skip its
+        // own select call
+        void setConnectionWatched( char inWatched ) {
+            mConnectionWatched = inWatched;
+            }
+
+
+        /**
+         * Puts this socket into non-blocking, no-delay mode for the rest of
+         * its lifetime.
+         *
+         * Non-blocking sends and zero-timeout receives then cost a single
+         * system call each.  Blocking sends and infinite-timeout receives
+         * still work, switching the socket back into blocking mode for the
+         * duration of the call.  Nagle's algorithm stays off regardless of
+         * send's inAllowDelay, so callers that want batching should use
+         * queueSend.
+         *
+         * @return true on success.
+         */
+        char setPersistentNonBlocking();
         
 
 
@@ -159,6 +213,73 @@ class Socket {
 		int send( unsigned char *inBuffer, int inNumBytes,
                   char inAllowedToBlock = true,
                   char inAllowDelay = true );
+
+
+        /**
+         * Queues bytes to be sent by a later flushSendQueue.
+         *
+         * Small writes are copied together into shared blocks, and each
+         * flush hands the whole queue to the OS in one gathered write.
+         * The queue is flushed automatically once it holds at least the
+         * flush threshold.  Bytes sent with send after bytes queued here
+         * are never reordered ahead of them.
+         *
+         * Only works on sockets in persistent non-blocking mode, since
+         * send only keeps its bytes behind the queue in that mode.
+         *
+         * @param inBuffer the bytes to queue.  Copied internally.
+         * @param inNumBytes the number of bytes.
+         *
+         * @return inNumBytes if the bytes were queued, -2 if the queue is
+         *   full (try again after a flush), or -1 for a socket error during
+         *   an automatic flush or if the socket is not in persistent
+         *   non-blocking mode.
+         */
+        int queueSend( unsigned char *inBuffer, int inNumBytes );
+
+
+        /**
+         * Sends as much of the send queue as the socket accepts without
+         * blocking.  Call once per frame, or whenever latency matters.
+         *
+         * @return the number of bytes sent (0 if the queue is empty or the
+         *   socket would block), or -1 for a socket error.
+         */
+        int flushSendQueue();
+
+
+        /**
+         * Sends several buffers in order, blocking until all are sent.
+         *
+         * Buffers are handed to the OS together, up to 64 per system call
+         * on platforms that support gathered writes.  Any bytes in the
+         * send queue are sent first (only sockets in persistent
+         * non-blocking mode can have a send queue).
+         *
+         * @param inBuffers the buffers to send.
+         * @param inLengths the number of bytes in each buffer.
+         * @param inNumBuffers the number of buffers.
+         *
+         * @return the number of bytes sent, or -1 for a socket error.
+         */
+        int sendVector( unsigned char **inBuffers, int *inLengths,
+                        int inNumBuffers );
+
+
+        // number of bytes queued but not yet sent
+        int getNumQueuedBytes() {
+            return mNumQueuedBytes;
+            }
+
+
+        /**
+         * Sets when queueSend flushes automatically and when it refuses
+         * more data.  Defaults are 16 KiB and 1 MiB.
+         */
+        void setSendQueueLimits( int inFlushThreshold, int inMaxQueuedBytes ) {
+            mFlushThreshold = inFlushThreshold;
+            mMaxQueuedBytes = inMaxQueuedBytes;
+            }
 		
 		
 		/**
@@ -282,19 +403,361 @@ class Socket {
         char mConnected;
         
         char mIsConnectionBroken;
+
+        char mConnectFailed;
+        char mConnectionWatched;
+
+        char mPersistentNonBlocking;
+
+
+        SimpleVector<SocketSendBlock> mSendQueue;
+        // bytes of the first block already sent
+        int mSendQueueHeadOffset;
+        int mNumQueuedBytes;
+        int mFlushThreshold;
+        int mMaxQueuedBytes;
+
+        // one emptied block kept to avoid an allocation per frame
+        SocketSendBlock mSpareBlock;
         
 
         // toggle Nagle algorithm (inValue=1 turns it off)
         void setNoDelay( int inValue );
+
+
+        // switches the OS-level blocking mode
+        // returns true on success
+        char setNativeNonBlocking( char inNonBlocking );
+
+
+        /**
+         * Sends several buffers with one system call without blocking.
+         *
+         * @return the number of bytes sent, -2 if the operation would block,
+         *   or -1 for a socket error.
+         */
+        int sendGathered( unsigned char **inBuffers, int *inLengths,
+                          int inNumBuffers );
+
+
+        // send for sockets in persistent non-blocking mode
+        int sendPersistent( unsigned char *inBuffer, int inNumBytes,
+                            char inAllowedToBlock );
+
+
+        // removes inNumBytes sent bytes from the front of the queue
+        void consumeSendQueue( int inNumBytes );
+
+        // frees all queued and spare blocks
+        void clearSendQueue();
         
         
 	};			
 
 
 
+// queue blocks are at least this big, so small writes share them
+#define SOCKET_SEND_BLOCK_SIZE 4096
+
+// most blocks handed to one gathered write
+#define SOCKET_MAX_GATHER 64
+
+
+
 inline Socket::Socket()
-    : mConnected( true ), mIsConnectionBroken( false ) {
+    : mConnected( true ), mIsConnectionBroken( false ),
+      mConnectFailed( false ), mConnectionWatched( false ),
+      mPersistentNonBlocking( false ),
+      mSendQueueHeadOffset( 0 ), mNumQueuedBytes( 0 ),
+      mFlushThreshold( 16384 ), mMaxQueuedBytes( 1048576 ) {
+
+    mSpareBlock.bytes = NULL;
+    mSpareBlock.size = 0;
+    mSpareBlock.capacity = 0;
+    }
+
+
+
+inline int Socket::queueSend( unsigned char *inBuffer, int inNumBytes ) {
+
+    if( ! mPersistentNonBlocking ) {
+        return -1;
+        }
+
+    if( mNumQueuedBytes + inNumBytes > mMaxQueuedBytes ) {
+        if( flushSendQueue() == -1 ) {
+            return -1;
+            }
+        if( mNumQueuedBytes > 0 &&
+            mNumQueuedBytes + inNumBytes > mMaxQueuedBytes ) {
+            return -2;
+            }
+        }
+
+    int numBlocks = mSendQueue.size();
+
+    SocketSendBlock *tail = NULL;
+    if( numBlocks > 0 ) {
+        tail = mSendQueue.getElement( numBlocks - 1 );
+        }
+
+    if( tail == NULL || tail->capacity - tail->size < inNumBytes ) {
+
+        SocketSendBlock block;
+
+        if( inNumBytes <= SOCKET_SEND_BLOCK_SIZE &&
+            mSpareBlock.bytes != NULL ) {
+            block = mSpareBlock;
+            mSpareBlock.bytes = NULL;
+            }
+        else {
+            block.capacity = SOCKET_SEND_BLOCK_SIZE;
+            if( inNumBytes > block.capacity ) {
+                block.capacity = inNumBytes;
+                }
+            block.bytes = new unsigned char[ block.capacity ];
+            }
+        block.size = 0;
+
+        mSendQueue.push_back( block );
+        tail = mSendQueue.getElement( numBlocks );
+        }
+
+    memcpy( &( tail->bytes[ tail->size ] ), inBuffer, inNumBytes );
+    tail->size += inNumBytes;
+    mNumQueuedBytes += inNumBytes;
+
+    if( mNumQueuedBytes >= mFlushThreshold ) {
+        if( flushSendQueue() == -1 ) {
+            return -1;
+            }
+        }
+
+    return inNumBytes;
+    }
+
+
+
+inline int Socket::flushSendQueue() {
+
+    int totalSent = 0;
+
+    unsigned char *buffers[ SOCKET_MAX_GATHER ];
+    int lengths[ SOCKET_MAX_GATHER ];
+
+    while( mNumQueuedBytes > 0 ) {
+
+        int numBuffers = mSendQueue.size();
+        if( numBuffers > SOCKET_MAX_GATHER ) {
+            numBuffers = SOCKET_MAX_GATHER;
+            }
+
+        int numGathered = 0;
+        for( int i=0; i<numBuffers; i++ ) {
+            SocketSendBlock *block = mSendQueue.getElement( i );
+            int offset = 0;
+            if( i == 0 ) {
+                offset = mSendQueueHeadOffset;
+                }
+            buffers[i] = &( block->bytes[ offset ] );
+            lengths[i] = block->size - offset;
+            numGathered += lengths[i];
+            }
+
+        int numSent = sendGathered( buffers, lengths, numBuffers );
+
+        if( numSent == -1 ) {
+            return -1;
+            }
+        if( numSent <= 0 ) {
+            // would block, rest goes out on a later flush
+            break;
+            }
+
+        consumeSendQueue( numSent );
+        totalSent += numSent;
+
+        if( numSent < numGathered ) {
+            // OS buffer full
+            break;
+            }
+        }
+
+    return totalSent;
+    }
+
+
+
+inline void Socket::consumeSendQueue( int inNumBytes ) {
+    mNumQueuedBytes -= inNumBytes;
+
+    int numDone = 0;
+    int numBlocks = mSendQueue.size();
+
+    while( inNumBytes > 0 && numDone < numBlocks ) {
+        SocketSendBlock *block = mSendQueue.getElement( numDone );
+        int left = block->size - mSendQueueHeadOffset;
+
+        if( inNumBytes < left ) {
+            mSendQueueHeadOffset += inNumBytes;
+            break;
+            }
+
+        inNumBytes -= left;
+        mSendQueueHeadOffset = 0;
+
+        if( mSpareBlock.bytes == NULL &&
+            block->capacity == SOCKET_SEND_BLOCK_SIZE ) {
+            mSpareBlock = *block;
+            }
+        else {
+            delete [] block->bytes;
+            }
+        numDone++;
+        }
+
+    if( numDone > 0 ) {
+        mSendQueue.deleteStartElements( numDone );
+        }
+    }
+
+
+
+inline void Socket::clearSendQueue() {
+    int numBlocks = mSendQueue.size();
+    for( int i=0; i<numBlocks; i++ ) {
+        delete [] mSendQueue.getElement( i )->bytes;
+        }
+    mSendQueue.deleteAll();
+
+    if( mSpareBlock.bytes != NULL ) {
+        delete [] mSpareBlock.bytes;
+        mSpareBlock.bytes = NULL;
+        }
+
+    mSendQueueHeadOffset = 0;
+    mNumQueuedBytes = 0;
+    }
+
+
+
+inline int Socket::sendPersistent( unsigned char *inBuffer, int inNumBytes,
+                                   char inAllowedToBlock ) {
+
+    if( ! inAllowedToBlock ) {
+        if( mNumQueuedBytes > 0 ) {
+            // keep queued bytes ahead of these
+            if( flushSendQueue() == -1 ) {
+                return -1;
+                }
+            if( mNumQueuedBytes > 0 ) {
+                return -2;
+                }
+            }
+        return sendGathered( &inBuffer, &inNumBytes, 1 );
+        }
+
+
+    // blocking send, rare in this mode
+    if( ! setNativeNonBlocking( false ) ) {
+        return -1;
+        }
+
+    int result = 0;
+    while( result != -1 && mNumQueuedBytes > 0 ) {
+        result = flushSendQueue();
+        }
+
+    if( result != -1 ) {
+        result = sendGathered( &inBuffer, &inNumBytes, 1 );
+        }
+
+    setNativeNonBlocking( true );
+
+    return result;
+    }
+
+
+
+inline int Socket::sendVector( unsigned char **inBuffers, int *inLengths,
+                               int inNumBuffers ) {
+
+    if( mPersistentNonBlocking ) {
+        if( ! setNativeNonBlocking( false ) ) {
+            return -1;
+            }
+
+        int result = 0;
+        while( result != -1 && mNumQueuedBytes > 0 ) {
+            result = flushSendQueue();
+            }
+
+        if( result == -1 ) {
+            setNativeNonBlocking( true );
+            return -1;
+            }
+        }
+
+
+    unsigned char *buffers[ SOCKET_MAX_GATHER ];
+    int lengths[ SOCKET_MAX_GATHER ];
+
+    int totalSent = 0;
+
+    // first buffer not completely sent, and bytes of it sent
+    int first = 0;
+    int firstOffset = 0;
+
+    while( first < inNumBuffers ) {
+
+        if( inLengths[ first ] == firstOffset ) {
+            first++;
+            firstOffset = 0;
+            continue;
+            }
+
+        int numGathered = 0;
+        int offset = firstOffset;
+
+        for( int i=first;
+             i<inNumBuffers && numGathered < SOCKET_MAX_GATHER; i++ ) {
+
+            buffers[ numGathered ] = &( inBuffers[i][ offset ] );
+            lengths[ numGathered ] = inLengths[i] - offset;
+            numGathered++;
+            offset = 0;
+            }
+
+        int numSent = sendGathered( buffers, lengths, numGathered );
+
+        if( numSent <= 0 ) {
+            totalSent = -1;
+            break;
+            }
+
+        totalSent += numSent;
+
+        // skip past sent bytes
+        while( numSent > 0 ) {
+            int left = inLengths[ first ] - firstOffset;
+
+            if( numSent < left ) {
+                firstOffset += numSent;
+                numSent = 0;
+                }
+            else {
+                numSent -= left;
+                first++;
+                firstOffset = 0;
+                }
+            }
+        }
+
+    if( mPersistentNonBlocking ) {
+        setNativeNonBlocking( true );
+        }
 
+    return totalSent;
     }
 
 
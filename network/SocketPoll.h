@@ -38,6 +38,11 @@ class SocketPoll {
 
         // watch for data ready to be read
         //
+        // some implementations also watch sockets that are still
+        // connecting, returning them from wait once their connect finishes
+        // or fails (see Socket::finishConnect), so isConnected needs
+        // no system call of its own
+        //
         // returns true on success, false on failure
         char addSocket( Socket *inSock, 
                         void *inOtherData = NULL );
@@ -90,6 +90,10 @@ class SocketStream : public InputStream, public OutputStream {
 		
 		// implements the OutputStream interface
 		virtual long write( unsigned char *inBuffer, long inNumBytes );
+
+        // sends buffers together in gathered writes
+        virtual long writeVector( unsigned char **inBuffers,
+                                  long *inLengths, int inNumBuffers );
 		
 		
 	protected:
@@ -165,4 +169,41 @@ inline long SocketStream::write( unsigned char *inBuffer, long inNumBytes ) {
 	
 	
 	
+inline long SocketStream::writeVector( unsigned char **inBuffers,
+                                       long *inLengths, int inNumBuffers ) {
+    long numTotalSent = 0;
+
+    int lengths[ SOCKET_MAX_GATHER ];
+
+    for( int i=0; i<inNumBuffers; i+=SOCKET_MAX_GATHER ) {
+
+        int numBuffers = inNumBuffers - i;
+        if( numBuffers > SOCKET_MAX_GATHER ) {
+            numBuffers = SOCKET_MAX_GATHER;
+            }
+
+        long numToSend = 0;
+        for( int b=0; b<numBuffers; b++ ) {
+            lengths[b] = inLengths[ i + b ];
+            numToSend += lengths[b];
+            }
+
+        int numSent = mSocket->sendVector( &( inBuffers[i] ), lengths,
+                                           numBuffers );
+
+        if( numSent != numToSend ) {
+            // socket error
+            OutputStream::setNewLastErrorConst(
+                "Network socket error on send." );
+            return -1;
+            }
+
+        numTotalSent += numSent;
+        }
+
+	return numTotalSent;
+	}
+
+
+
 #endif
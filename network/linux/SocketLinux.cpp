@@ -94,6 +94,7 @@
 
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <sys/errno.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
@@ -156,6 +157,8 @@ int Socket::initSocketFramework() {
 
 
 Socket::~Socket() {
+    clearSendQueue();
+    
     if( !mIsConnectionBroken ) {
 
         shutdown( mNativeSocketID, SHUT_RDWR );
@@ -172,13 +175,18 @@ int Socket::isConnected() {
     if( mConnected ) {
         return 1;
         }
+    if( mConnectFailed ) {
+        return -1;
+        }
+    if( mConnectionWatched ) {
+        // poller will call finishConnect when there's news
+        return 0;
+        }
     
 
     int ret;
 	fd_set fsr;
 	struct timeval tv;
-	int val;
-    socklen_t len;
 
 	FD_ZERO( &fsr );
 	FD_SET( mNativeSocketID, &fsr );
@@ -197,19 +205,22 @@ int Socket::isConnected() {
 
     // no timeout
     // error?
+    return finishConnect();
+    }
 
-	len = 4;
-	ret = getsockopt( mNativeSocketID, SOL_SOCKET, SO_ERROR, &val, &len );
+
+
+int Socket::finishConnect() {
+	int val;
+    socklen_t len = sizeof( val );
+
+	int ret = getsockopt( mNativeSocketID, SOL_SOCKET, SO_ERROR, &val, &len );
 	
-	if( ret < 0 ) {
+	if( ret < 0 || val != 0 ) {
 		// error
+        mConnectFailed = true;
         return -1;
         }
-
-	if( val != 0 ) {
-        // error
-		return -1;
-        }
 	
     // success
     mConnected = true;
@@ -219,6 +230,76 @@ int Socket::isConnected() {
 
 
 
+char Socket::setNativeNonBlocking( char inNonBlocking ) {
+    int flags = fcntl( mNativeSocketID, F_GETFL, 0 );
+
+    if( flags < 0 ) {
+        return false;
+        }
+
+    if( inNonBlocking ) {
+        flags |= O_NONBLOCK;
+        }
+    else {
+        flags &= ~O_NONBLOCK;
+        }
+
+    return fcntl( mNativeSocketID, F_SETFL, flags ) >= 0;
+    }
+
+
+
+char Socket::setPersistentNonBlocking() {
+    if( ! setNativeNonBlocking( true ) ) {
+        return false;
+        }
+    setNoDelay( 1 );
+
+    mPersistentNonBlocking = true;
+    return true;
+    }
+
+
+
+int Socket::sendGathered( unsigned char **inBuffers, int *inLengths,
+                          int inNumBuffers ) {
+
+    struct iovec vectors[ SOCKET_MAX_GATHER ];
+
+    if( inNumBuffers > SOCKET_MAX_GATHER ) {
+        inNumBuffers = SOCKET_MAX_GATHER;
+        }
+
+    for( int i=0; i<inNumBuffers; i++ ) {
+        vectors[i].iov_base = inBuffers[i];
+        vectors[i].iov_len = inLengths[i];
+        }
+
+    struct msghdr message;
+    memset( &message, 0, sizeof( message ) );
+    message.msg_iov = vectors;
+    message.msg_iovlen = inNumBuffers;
+
+    int flags = 0;
+#ifdef MSG_NOSIGNAL
+    flags |= MSG_NOSIGNAL;
+#endif
+
+    // blocks only if caller has put the socket back into blocking mode
+    int returnValue = sendmsg( mNativeSocketID, &message, flags );
+
+    while( returnValue == -1 && errno == EINTR ) {
+        returnValue = sendmsg( mNativeSocketID, &message, flags );
+        }
+
+    if( returnValue == -1 && ( errno == EAGAIN || errno == EWOULDBLOCK ) ) {
+        return -2;
+        }
+    return returnValue;
+    }
+
+
+
 void Socket::setNoDelay( int inValue ) {
 	
     int flag = inValue;
@@ -235,6 +316,10 @@ int Socket::send( unsigned char *inBuffer, int inNumBytes,
                   char inAllowedToBlock,
                   char inAllowDelay ) {
     
+    if( mPersistentNonBlocking ) {
+        // already no-delay, and flag changes would cost system calls
+        return sendPersistent( inBuffer, inNumBytes, inAllowedToBlock );
+        }
 
     if( inAllowedToBlock ) {
         if( ! inAllowDelay ) {
@@ -299,6 +384,16 @@ int Socket::receive( unsigned char *inBuffer, int inNumBytes,
 	long inTimeout ) {
 	
 	if( inTimeout == -1 ) {
+        if( mPersistentNonBlocking ) {
+            if( ! setNativeNonBlocking( false ) ) {
+                return -1;
+                }
+            int result = 
+                recv( mNativeSocketID, inBuffer, inNumBytes, MSG_WAITALL );
+            setNativeNonBlocking( true );
+            return result;
+            }
+        
         // use MSG_WAITALL flag here to block until inNumBytes has arrived
 		return recv( mNativeSocketID, inBuffer, inNumBytes, MSG_WAITALL );
 		}
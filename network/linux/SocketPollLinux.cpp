@@ -64,6 +64,14 @@ char SocketPoll::addSocket( Socket *inSock, void *inOtherData ) {
 
     struct epoll_event ev;
     ev.events = EPOLLIN | EPOLLPRI | EPOLLERR | EPOLLHUP;
+
+    char watchConnect = inSock->isConnectPending();
+    
+    if( watchConnect ) {
+        // writable once non-blocking connect finishes
+        ev.events |= EPOLLOUT;
+        }
+    
     // clear entire union to suppress valgrind uninit errors on platforms
     // with 32-bit pointers
     ev.data.u64 = 0;
@@ -74,6 +82,7 @@ char SocketPoll::addSocket( Socket *inSock, void *inOtherData ) {
     int result = epoll_ctl( epollHandle, EPOLL_CTL_ADD, socketID, &ev );
 
     if( result == 0 ) {
+        inSock->setConnectionWatched( watchConnect );
         return true;
         }
     return false;
@@ -144,6 +153,8 @@ void SocketPoll::removeSocket( Socket *inSock ) {
             
             epoll_ctl( epollHandle, EPOLL_CTL_DEL, socketID, &ev );
 
+            inSock->setConnectionWatched( false );
+
             delete s;
             mWatchedList.deleteElement( i );
             return;
@@ -196,7 +207,24 @@ SocketOrServer *SocketPoll::wait( int inTimeoutMS ) {
     
     
     // else we have an event!
+
+    SocketOrServer *s = (SocketOrServer *)( returnedEvents[0].data.ptr );
+
+    if( s->isSocket && s->sock->isConnectPending() ) {
+        // EPOLLOUT, or an error, for a connecting socket
+        s->sock->finishConnect();
+
+        // stop watching for writability, which would otherwise be
+        // reported on every wait from now on
+        struct epoll_event ev;
+        ev.events = EPOLLIN | EPOLLPRI | EPOLLERR | EPOLLHUP;
+        ev.data.u64 = 0;
+        ev.data.ptr = s;
+        
+        epoll_ctl( epollHandle, EPOLL_CTL_MOD, 
+                   s->sock->mNativeSocketID, &ev );
+        }
     
-    return (SocketOrServer *)( returnedEvents[0].data.ptr );
+    return s;
     }
 
@@ -24,21 +24,30 @@
 
 
 
+// unused budget kept, in seconds of messages
+#define LIMITER_BUDGET_SECONDS 0.05
+
+
+
+static int getMaxBudget( double inLimitPerSecond ) {
+    int maxBudget = (int)( inLimitPerSecond * LIMITER_BUDGET_SECONDS );
+
+    if( maxBudget < 1 ) {
+        maxBudget = 1;
+        }
+    return maxBudget;
+    }
+
+
+
 MessagePerSecondLimiter::MessagePerSecondLimiter( double inLimitPerSecond )
     : mLock( new MutexLock() ),
       mTransmitLock( new MutexLock() ),
-      mLimitPerSecond( inLimitPerSecond ) {
+      mLimitPerSecond( inLimitPerSecond ),
+      mMaxBudget( getMaxBudget( inLimitPerSecond ) ) {
 
-    if( mLimitPerSecond != -1 ) {
-        mMillisecondsBetweenMessages = (int)( 1000 / mLimitPerSecond );
-        }
-    else {
-        mMillisecondsBetweenMessages = 0;
-        }
-    
-    Time::getCurrentTime( &mSecondTimeOfLastMessage,
-                          &mMillisecondTimeOfLastMessage );
-    
+    // start with a full budget
+    mBudgetUsedTime = 0;
     }
 
 
@@ -53,15 +62,7 @@ MessagePerSecondLimiter::~MessagePerSecondLimiter() {
 void MessagePerSecondLimiter::setLimit( double inLimitPerSecond ) {
     mLock->lock();
     mLimitPerSecond = inLimitPerSecond;
-
-    if( mLimitPerSecond != -1 ) {
-        mMillisecondsBetweenMessages = (int)( 1000 / mLimitPerSecond );
-        }
-    else {
-        mMillisecondsBetweenMessages = 0;
-        }
-
-
+    mMaxBudget = getMaxBudget( inLimitPerSecond );
     mLock->unlock();
     }
 
@@ -78,6 +79,16 @@ double MessagePerSecondLimiter::getLimit() {
         
 
 void MessagePerSecondLimiter::messageTransmitted() {
+    messagesTransmitted( 1 );
+    }
+
+
+
+int MessagePerSecondLimiter::messagesTransmitted( int inNumMessages ) {
+    if( inNumMessages < 1 ) {
+        return 0;
+        }
+
     // allow only one transmitter to report at a time
     mTransmitLock->lock();
 
@@ -86,19 +97,52 @@ void MessagePerSecondLimiter::messageTransmitted() {
     // called while we touch the variables)
     mLock->lock();
 
+    int numAllowed = inNumMessages;
 
-    unsigned long millisecondsSinceLastMessage =
-        Time::getMillisecondsSince( mSecondTimeOfLastMessage,
-                                    mMillisecondTimeOfLastMessage );
+    while( mLimitPerSecond != -1 ) {
+        double secondsPerMessage = 1 / mLimitPerSecond;
+        
+        double currentTime = Time::getCurrentTime();
 
-    
-    if( millisecondsSinceLastMessage < mMillisecondsBetweenMessages ) {
-        // this message is coming too soon after last message
+        // budget unused for longer than this is lost
+        double earliestTime = currentTime - mMaxBudget * secondsPerMessage;
+        
+        int budget;
+        
+        if( mBudgetUsedTime <= earliestTime ) {
+            // full budget, set directly, since the time difference
+            // below can round down by a message at epoch-sized times
+            mBudgetUsedTime = earliestTime;
+            budget = mMaxBudget;
+            }
+        else {
+            // epsilon for time rounding
+            budget =
+                (int)( ( currentTime - mBudgetUsedTime ) / secondsPerMessage
+                       + 0.001 );
+            if( budget > mMaxBudget ) {
+                budget = mMaxBudget;
+                }
+            }
+
+        int needed = inNumMessages;
+        if( needed > mMaxBudget ) {
+            needed = mMaxBudget;
+            }
         
-        // sleep
-        unsigned long sleepTime =
-            mMillisecondsBetweenMessages -
-            millisecondsSinceLastMessage;
+        if( budget >= needed ) {
+            numAllowed = budget;
+            if( numAllowed > inNumMessages ) {
+                numAllowed = inNumMessages;
+                }
+            mBudgetUsedTime += numAllowed * secondsPerMessage;
+            break;
+            }
+
+        // these messages are coming too soon after the last ones
+        unsigned long sleepTime = (unsigned long)
+            ( 1000 * ( mBudgetUsedTime + needed * secondsPerMessage -
+                       currentTime ) ) + 1;
 
         // unlock main lock befor sleeping so that settings can be changed
         mLock->unlock();
@@ -109,21 +153,10 @@ void MessagePerSecondLimiter::messageTransmitted() {
         mLock->lock();
         }
 
-
-    Time::getCurrentTime( &mSecondTimeOfLastMessage,
-                          &mMillisecondTimeOfLastMessage );
     mLock->unlock();
 
     
     mTransmitLock->unlock();
-    }
-
-
-
-
-
-
-
-
-
 
+    return numAllowed;
+    }
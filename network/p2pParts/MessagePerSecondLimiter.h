@@ -19,12 +19,17 @@
 
 
 #include "minorGems/system/MutexLock.h"
+#include "minorGems/system/Time.h"
 
 
 
 /**
  * Class that limits the number of messages transmitted per second.
  *
+ * Up to 50 ms worth of unused budget is kept, so a transmitter with
+ * several messages ready can send them together, and a transmitter that
+ * has been idle can send that many at once.
+ *
  * @author Jason Rohrer
  */
 class MessagePerSecondLimiter {
@@ -82,6 +87,22 @@ class MessagePerSecondLimiter {
          * Thread safe.
          */
         void messageTransmitted();
+
+
+        
+        /**
+         * Called by a message transmitter with several messages ready to
+         * transmit together.  Blocks until as many as the kept budget
+         * holds (or all of them, if fewer) can be transmitted.
+         *
+         * Thread safe.
+         *
+         * @param inNumMessages the number of messages ready.
+         *
+         * @return how many of the messages, from the first, may be
+         *   transmitted now.  At least 1 if inNumMessages is at least 1.
+         */
+        int messagesTransmitted( int inNumMessages );
         
 
         
@@ -90,10 +111,13 @@ class MessagePerSecondLimiter {
         MutexLock *mTransmitLock;
         
         double mLimitPerSecond;
-        unsigned long  mMillisecondsBetweenMessages;
 
-        unsigned long mSecondTimeOfLastMessage;
-        unsigned long mMillisecondTimeOfLastMessage;
+        // messages of unused budget that can be kept
+        int mMaxBudget;
+
+        // when budget was last used up, in seconds, never further back
+        // than mMaxBudget messages
+        double mBudgetUsedTime;
 
 
         
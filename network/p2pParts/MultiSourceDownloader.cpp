@@ -15,8 +15,25 @@
 
 #include "MultiSourceDownloader.h"
 
+#include "minorGems/system/Thread.h"
+#include "minorGems/system/MutexLock.h"
+#include "minorGems/system/Semaphore.h"
+#include "minorGems/system/BinarySemaphore.h"
+#include "minorGems/system/Time.h"
+#include "minorGems/util/SimpleVector.h"
+#include "minorGems/util/stringUtils.h"
+#include "minorGems/crypto/hashes/sha1.h"
+
 
 #include <stdio.h>
+#include <string.h>
+
+#ifndef WIN_32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#endif
 
 
 int MULTISOURCE_DOWNLOAD_IN_PROGRESS = 0;
@@ -25,112 +42,993 @@ int MULTISOURCE_DOWNLOAD_CANCELED = 2;
 
 
 
-void multiSourceGetFile( void *inFileDescriptor,
-                         unsigned long inFileSize,
-                         unsigned long inChunkSize,
-                         int inNumSources,
-                         void **inFileSources,
-                         unsigned char * (*inChunkGetter)(
-                             void *, void *, unsigned long, unsigned long ),
-                         char (*inDownloadProgressHandler)(
-                             int, unsigned long, void * ),
-                         void *inProgressHandlerExtraArgument,
-                         char *inDestinationPath ) {
+// a source is dropped after this many failed or corrupt chunks in a row
+#define MAX_SOURCE_FAILURES 3
 
-    FILE *outputFile = fopen( inDestinationPath, "wb" );
+// weight of the newest sample in a source's throughput estimate
+#define RATE_SMOOTHING 0.3
 
-    if( outputFile == NULL ) {
+// seconds between saves of the chunk record while chunks arrive
+#define RECORD_SAVE_INTERVAL 1.0
 
-        inDownloadProgressHandler( MULTISOURCE_DOWNLOAD_FAILED,
-                                   0, inProgressHandlerExtraArgument );
-        return;
+// first line of the chunk record, followed by one bit per chunk
+#define RECORD_HEADER_FORMAT "multiSourceParts1 %lu %lu\n"
+
+
+// chunk states
+#define CHUNK_MISSING 0
+#define CHUNK_REQUESTED 1
+// one copy arrived and is being written, other copies are discarded
+#define CHUNK_WRITING 2
+#define CHUNK_DONE 3
+
+
+// returned by pickChunk
+#define PICK_WAIT -1
+#define PICK_EXIT -2
+
+
+
+typedef struct DownloadChunk {
+        char state;
+
+        // requests in flight, 2 once duplicated in the endgame
+        int numRequests;
+
+        // sources of the requests in flight, -1 if none
+        int source;
+        int duplicateSource;
+
+        double requestTime;
+    } DownloadChunk;
+
+
+
+typedef struct DownloadSource {
+        // bytes per second for one request, or -1 until the first chunk
+        // arrives
+        double rate;
+
+        int numRequests;
+
+        // in a row
+        int numFailures;
+
+        char dead;
+    } DownloadSource;
+
+
+
+// destination file, written at chunk offsets from several threads
+class ChunkFile {
+
+    public:
+
+        ChunkFile()
+#ifdef WIN_32
+                : mFile( NULL ) {
+#else
+                : mFD( -1 ) {
+#endif
+            }
+
+
+        ~ChunkFile() {
+            close();
+            }
+
+
+        // opens at inSize, emptying first unless inKeepContents
+        char open( char *inPath, unsigned long inSize, char inKeepContents ) {
+#ifdef WIN_32
+            if( inKeepContents ) {
+                mFile = fopen( inPath, "r+b" );
+                }
+            if( mFile == NULL ) {
+                mFile = fopen( inPath, "w+b" );
+                }
+            if( mFile == NULL ) {
+                return false;
+                }
+            if( inSize > 0 ) {
+                // write last byte to allocate whole file
+                if( fseek( mFile, inSize - 1, SEEK_SET ) != 0 ) {
+                    return false;
+                    }
+                int last = fgetc( mFile );
+                fseek( mFile, inSize - 1, SEEK_SET );
+                fputc( last == EOF ? 0 : last, mFile );
+                }
+            return true;
+#else
+            int flags = O_RDWR | O_CREAT;
+            if( ! inKeepContents ) {
+                flags |= O_TRUNC;
+                }
+
+            mFD = ::open( inPath, flags, 0644 );
+
+            if( mFD == -1 ) {
+                return false;
+                }
+            if( ftruncate( mFD, inSize ) != 0 ) {
+                return false;
+                }
+    #ifdef __linux__
+            if( inSize > 0 ) {
+                // reserve blocks now so the file isn't fragmented by out
+                // of order writes
+                // not supported on every file system, so failure is ok
+                posix_fallocate( mFD, 0, inSize );
+                }
+    #endif
+            return true;
+#endif
+            }
+
+
+        char write( unsigned long inOffset, unsigned char *inData,
+                    unsigned long inLength ) {
+#ifdef WIN_32
+            mLock.lock();
+            char ok =
+                fseek( mFile, inOffset, SEEK_SET ) == 0 &&
+                fwrite( inData, 1, inLength, mFile ) == inLength;
+            mLock.unlock();
+            return ok;
+#else
+            while( inLength > 0 ) {
+                ssize_t numWritten = pwrite( mFD, inData, inLength, inOffset );
+                if( numWritten <= 0 ) {
+                    return false;
+                    }
+                inData += numWritten;
+                inLength -= numWritten;
+                inOffset += numWritten;
+                }
+            return true;
+#endif
+            }
+
+
+        char read( unsigned long inOffset, unsigned char *inBuffer,
+                   unsigned long inLength ) {
+#ifdef WIN_32
+            mLock.lock();
+            char ok =
+                fseek( mFile, inOffset, SEEK_SET ) == 0 &&
+                fread( inBuffer, 1, inLength, mFile ) == inLength;
+            mLock.unlock();
+            return ok;
+#else
+            while( inLength > 0 ) {
+                ssize_t numRead = pread( mFD, inBuffer, inLength, inOffset );
+                if( numRead <= 0 ) {
+                    return false;
+                    }
+                inBuffer += numRead;
+                inLength -= numRead;
+                inOffset += numRead;
+                }
+            return true;
+#endif
+            }
+
+
+        // true if all writes reached the file
+        char close() {
+            char ok = true;
+#ifdef WIN_32
+            if( mFile != NULL ) {
+                ok = ( fclose( mFile ) == 0 );
+                mFile = NULL;
+                }
+#else
+            if( mFD != -1 ) {
+                ok = ( ::close( mFD ) == 0 );
+                mFD = -1;
+                }
+#endif
+            return ok;
+            }
+
+
+    protected:
+
+#ifdef WIN_32
+        FILE *mFile;
+        // seek and write must happen together
+        MutexLock mLock;
+#else
+        int mFD;
+#endif
+    };
+
+
+
+class MultiSourceDownload;
+
+
+class MultiSourceWorker : public Thread {
+
+    public:
+
+        MultiSourceWorker( MultiSourceDownload *inDownload, int inSource )
+                : mDownload( inDownload ), mSource( inSource ) {
+            }
+
+        virtual void run();
+
+
+    protected:
+        MultiSourceDownload *mDownload;
+        int mSource;
+    };
+
+
+
+class MultiSourceDownload {
+
+    public:
+
+        MultiSourceDownload( void *inFileDescriptor,
+                             unsigned long inFileSize,
+                             unsigned long inChunkSize,
+                             int inNumSources,
+                             void **inFileSources,
+                             unsigned char * (*inChunkGetter)(
+                                 void *, void *,
+                                 unsigned long, unsigned long ),
+                             int inRequestsPerSource,
+                             char **inChunkHashes );
+
+        ~MultiSourceDownload();
+
+
+        // opens destination, resuming from the chunk record at
+        // inRecordPath if it isn't NULL and matches
+        char open( char *inDestinationPath, char *inRecordPath );
+
+        // starts workers, and returns when download done, failed, or
+        // canceled
+        void run( char (*inDownloadProgressHandler)(
+                      int, unsigned long, void * ),
+                  void *inProgressHandlerExtraArgument,
+                  char *inRecordPath );
+
+
+        // used by workers
+        // blocks until source has a chunk to request
+        // returns -1 when worker should stop
+        long getNextChunk( int inSource );
+
+        void chunkReturned( int inSource, unsigned long inChunk,
+                            unsigned char *inData, double inSeconds );
+
+        void workerDone();
+
+        void *getSource( int inSource ) {
+            return mSources[ inSource ];
+            }
+
+        void *getFileDescriptor() {
+            return mFileDescriptor;
+            }
+
+        unsigned long getChunkSize( unsigned long inChunk ) {
+            if( inChunk == mNumChunks - 1 ) {
+                return mFileSize - inChunk * mChunkSize;
+                }
+            return mChunkSize;
+            }
+
+        unsigned char * (*mChunkGetter)(
+            void *, void *, unsigned long, unsigned long );
+
+
+    protected:
+
+        void *mFileDescriptor;
+        unsigned long mFileSize;
+        unsigned long mChunkSize;
+        unsigned long mNumChunks;
+
+        int mNumSources;
+        void **mSources;
+
+        int mRequestsPerSource;
+        char **mChunkHashes;
+
+        ChunkFile mFile;
+
+        MutexLock mLock;
+
+        DownloadChunk *mChunks;
+        DownloadSource *mSourceStates;
+
+        // one bit per chunk written, in chunk record order
+        unsigned char *mRecord;
+        int mRecordLength;
+
+        // chunks below this have all been requested at least once
+        unsigned long mNextChunk;
+
+        // chunks below mNextChunk that went back to missing
+        SimpleVector<unsigned long> mRetryChunks;
+
+        unsigned long mNumDone;
+        unsigned long mBytesDone;
+
+        int mNumLiveWorkers;
+
+        char mStopping;
+        char mWriteFailed;
+
+        // workers blocked in getNextChunk, woken with one signal each
+        int mNumWaiting;
+        Semaphore mWorkChanged;
+
+        // signaled when a chunk is written or a worker stops
+        BinarySemaphore mProgress;
+
+
+        // called with lock held
+        long pickChunk( int inSource );
+
+        int getAllowedRequests( int inSource );
+
+        void wakeWorkers();
+
+        char verifyChunk( unsigned long inChunk, unsigned char *inData );
+
+        char loadRecord( char *inRecordPath );
+
+        void saveRecord( char *inRecordPath );
+    };
+
+
+
+void MultiSourceWorker::run() {
+    while( true ) {
+        long chunk = mDownload->getNextChunk( mSource );
+
+        if( chunk < 0 ) {
+            mDownload->workerDone();
+            return;
+            }
+
+        double startTime = Time::getCurrentTime();
+
+        unsigned char *data =
+            mDownload->mChunkGetter( mDownload->getSource( mSource ),
+                                     mDownload->getFileDescriptor(),
+                                     chunk,
+                                     mDownload->getChunkSize( chunk ) );
+
+        mDownload->chunkReturned( mSource, chunk, data,
+                                  Time::getCurrentTime() - startTime );
         }
+    }
 
-    
-    // for now, just fetch chunks in linear order, using each file source
-    // until it fails
-    char failed = false;
-    char canceled = false;
 
-    unsigned long chunksSoFar = 0;
-    unsigned long numChunks = inFileSize / inChunkSize;
-    if( inFileSize % inChunkSize != 0 ) {
+
+MultiSourceDownload::MultiSourceDownload(
+    void *inFileDescriptor,
+    unsigned long inFileSize,
+    unsigned long inChunkSize,
+    int inNumSources,
+    void **inFileSources,
+    unsigned char * (*inChunkGetter)(
+        void *, void *, unsigned long, unsigned long ),
+    int inRequestsPerSource,
+    char **inChunkHashes )
+        : mChunkGetter( inChunkGetter ),
+          mFileDescriptor( inFileDescriptor ),
+          mFileSize( inFileSize ), mChunkSize( inChunkSize ),
+          mNumSources( inNumSources ), mSources( inFileSources ),
+          mRequestsPerSource( inRequestsPerSource ),
+          mChunkHashes( inChunkHashes ),
+          mNextChunk( 0 ),
+          mNumDone( 0 ), mBytesDone( 0 ),
+          mNumLiveWorkers( 0 ),
+          mStopping( false ), mWriteFailed( false ),
+          mNumWaiting( 0 ), mWorkChanged( 0 ) {
+
+    if( mRequestsPerSource < 1 ) {
+        mRequestsPerSource = 1;
+        }
+
+    mNumChunks = mFileSize / mChunkSize;
+    if( mFileSize % mChunkSize != 0 ) {
         // extra partial chunk
-        numChunks++;
+        mNumChunks++;
         }
 
-    unsigned long bytesSoFar = 0;
+    mChunks = new DownloadChunk[ mNumChunks ];
+    for( unsigned long i=0; i<mNumChunks; i++ ) {
+        mChunks[i].state = CHUNK_MISSING;
+        mChunks[i].numRequests = 0;
+        mChunks[i].source = -1;
+        mChunks[i].duplicateSource = -1;
+        mChunks[i].requestTime = 0;
+        }
+
+    mSourceStates = new DownloadSource[ mNumSources ];
+    for( int i=0; i<mNumSources; i++ ) {
+        mSourceStates[i].rate = -1;
+        mSourceStates[i].numRequests = 0;
+        mSourceStates[i].numFailures = 0;
+        mSourceStates[i].dead = false;
+        }
+
+    mRecordLength = ( mNumChunks + 7 ) / 8;
+    mRecord = new unsigned char[ mRecordLength ];
+    memset( mRecord, 0, mRecordLength );
+    }
+
+
+
+MultiSourceDownload::~MultiSourceDownload() {
+    delete [] mChunks;
+    delete [] mSourceStates;
+    delete [] mRecord;
+    }
+
+
+
+char MultiSourceDownload::open( char *inDestinationPath,
+                                char *inRecordPath ) {
 
-    int sourceIndex = 0;
+    char resuming = false;
 
-    while( sourceIndex < inNumSources &&
-           !failed &&
-           !canceled &&
-           chunksSoFar < numChunks ) {
-        
-        void *source = inFileSources[ sourceIndex ];
+    if( inRecordPath != NULL ) {
+        FILE *oldFile = fopen( inDestinationPath, "rb" );
 
-        unsigned long chunkSize = inChunkSize;
-        
-        if( chunksSoFar * inChunkSize + chunkSize > inFileSize ) {
-            // partial chunk
-            chunkSize = inFileSize - chunksSoFar * inChunkSize;
+        if( oldFile != NULL ) {
+            // only resume into a file of the right size
+            if( fseek( oldFile, 0, SEEK_END ) == 0 &&
+                (unsigned long)ftell( oldFile ) == mFileSize ) {
+
+                resuming = loadRecord( inRecordPath );
+                }
+            fclose( oldFile );
             }
+        }
+
+    if( ! mFile.open( inDestinationPath, mFileSize, resuming ) ) {
+        return false;
+        }
+
+    if( ! resuming ) {
+        return true;
+        }
+
 
-        unsigned char *chunkData =
-            inChunkGetter(
-                source, inFileDescriptor, chunksSoFar, chunkSize );
+    for( unsigned long i=0; i<mNumChunks; i++ ) {
+        if( mRecord[ i / 8 ] & ( 1 << ( i % 8 ) ) ) {
 
-        if( chunkData != NULL ) {
-            chunksSoFar += 1;
-            
-            bytesSoFar += chunkSize;
-            unsigned long numWritten =
-                fwrite( chunkData, 1, chunkSize, outputFile );
+            if( mChunkHashes != NULL ) {
+                // record may have been saved before data reached the disk
+                unsigned long size = getChunkSize( i );
+                unsigned char *data = new unsigned char[ size ];
 
-            if( numWritten == chunkSize ) {
-                char shouldContinue =
-                    inDownloadProgressHandler(
-                        MULTISOURCE_DOWNLOAD_IN_PROGRESS,
-                        bytesSoFar,
-                        inProgressHandlerExtraArgument );
+                char ok = mFile.read( i * mChunkSize, data, size ) &&
+                    verifyChunk( i, data );
 
-                if( !shouldContinue ) {
-                    canceled = true;
+                delete [] data;
 
-                    // call handler last time
-                    inDownloadProgressHandler(
-                        MULTISOURCE_DOWNLOAD_CANCELED,
-                        bytesSoFar,
-                        inProgressHandlerExtraArgument );
+                if( ! ok ) {
+                    mRecord[ i / 8 ] &= ~( 1 << ( i % 8 ) );
+                    continue;
                     }
                 }
+
+            mChunks[i].state = CHUNK_DONE;
+            mNumDone ++;
+            mBytesDone += getChunkSize( i );
+            }
+        }
+
+    return true;
+    }
+
+
+
+char MultiSourceDownload::loadRecord( char *inRecordPath ) {
+    FILE *recordFile = fopen( inRecordPath, "rb" );
+
+    if( recordFile == NULL ) {
+        return false;
+        }
+
+    unsigned long fileSize, chunkSize;
+
+    char ok =
+        fscanf( recordFile, RECORD_HEADER_FORMAT,
+                &fileSize, &chunkSize ) == 2 &&
+        fileSize == mFileSize &&
+        chunkSize == mChunkSize &&
+        fread( mRecord, 1, mRecordLength, recordFile ) ==
+            (unsigned long)mRecordLength;
+
+    fclose( recordFile );
+
+    if( ! ok ) {
+        memset( mRecord, 0, mRecordLength );
+        }
+
+    return ok;
+    }
+
+
+
+void MultiSourceDownload::saveRecord( char *inRecordPath ) {
+    // copy, so workers aren't held up by disk
+    unsigned char *record = new unsigned char[ mRecordLength ];
+
+    mLock.lock();
+    memcpy( record, mRecord, mRecordLength );
+    mLock.unlock();
+
+    FILE *recordFile = fopen( inRecordPath, "wb" );
+
+    if( recordFile != NULL ) {
+        fprintf( recordFile, RECORD_HEADER_FORMAT, mFileSize, mChunkSize );
+        fwrite( record, 1, mRecordLength, recordFile );
+        fclose( recordFile );
+        }
+
+    delete [] record;
+    }
+
+
+
+char MultiSourceDownload::verifyChunk( unsigned long inChunk,
+                                       unsigned char *inData ) {
+    if( mChunkHashes == NULL ) {
+        return true;
+        }
+
+    char *digest = computeSHA1Digest( inData, getChunkSize( inChunk ) );
+
+    char match = ( strcmp( digest, mChunkHashes[ inChunk ] ) == 0 );
+
+    delete [] digest;
+
+    return match;
+    }
+
+
+
+int MultiSourceDownload::getAllowedRequests( int inSource ) {
+    double rate = mSourceStates[ inSource ].rate;
+
+    if( rate < 0 ) {
+        // one request until measured
+        return 1;
+        }
+
+    double bestRate = rate;
+    for( int i=0; i<mNumSources; i++ ) {
+        if( ! mSourceStates[i].dead && mSourceStates[i].rate > bestRate ) {
+            bestRate = mSourceStates[i].rate;
+            }
+        }
+
+    int allowed = (int)( mRequestsPerSource * rate / bestRate + 0.5 );
+
+    if( allowed < 1 ) {
+        allowed = 1;
+        }
+    return allowed;
+    }
+
+
+
+long MultiSourceDownload::pickChunk( int inSource ) {
+    DownloadSource *source = &( mSourceStates[ inSource ] );
+
+    if( mStopping || source->dead || mNumDone == mNumChunks ) {
+        return PICK_EXIT;
+        }
+
+    if( source->numRequests >= getAllowedRequests( inSource ) ) {
+        return PICK_WAIT;
+        }
+
+
+    long pick = -1;
+
+    while( pick == -1 && mRetryChunks.size() > 0 ) {
+        unsigned long c = mRetryChunks.getElementDirect( 0 );
+        mRetryChunks.deleteElement( 0 );
+
+        if( mChunks[c].state == CHUNK_MISSING ) {
+            pick = c;
+            }
+        }
+
+    while( pick == -1 && mNextChunk < mNumChunks ) {
+        if( mChunks[ mNextChunk ].state == CHUNK_MISSING ) {
+            pick = mNextChunk;
+            }
+        mNextChunk ++;
+        }
+
+
+    if( pick == -1 ) {
+        // endgame
+        // duplicate the oldest request that this source didn't make
+        double oldestTime = 0;
+
+        for( unsigned long c=0; c<mNumChunks; c++ ) {
+            DownloadChunk *chunk = &( mChunks[c] );
+
+            if( chunk->state == CHUNK_REQUESTED &&
+                chunk->numRequests == 1 &&
+                chunk->source != inSource &&
+                ( pick == -1 || chunk->requestTime < oldestTime ) ) {
+
+                pick = c;
+                oldestTime = chunk->requestTime;
+                }
+            }
+
+        if( pick == -1 ) {
+            // nothing to do until a request fails
+            return PICK_WAIT;
+            }
+        }
+
+
+    DownloadChunk *chunk = &( mChunks[ pick ] );
+
+    if( chunk->numRequests == 0 ) {
+        chunk->state = CHUNK_REQUESTED;
+        chunk->source = inSource;
+        chunk->duplicateSource = -1;
+        chunk->requestTime = Time::getCurrentTime();
+        }
+    else {
+        chunk->duplicateSource = inSource;
+        }
+    chunk->numRequests ++;
+
+    source->numRequests ++;
+
+    return pick;
+    }
+
+
+
+void MultiSourceDownload::wakeWorkers() {
+    // called with lock held
+    for( int i=0; i<mNumWaiting; i++ ) {
+        mWorkChanged.signal();
+        }
+    mNumWaiting = 0;
+    }
+
+
+
+long MultiSourceDownload::getNextChunk( int inSource ) {
+    while( true ) {
+        mLock.lock();
+
+        long pick = pickChunk( inSource );
+
+        if( pick != PICK_WAIT ) {
+            mLock.unlock();
+
+            if( pick == PICK_EXIT ) {
+                return -1;
+                }
+            return pick;
+            }
+
+        mNumWaiting ++;
+        mLock.unlock();
+
+        mWorkChanged.wait();
+        }
+    }
+
+
+
+void MultiSourceDownload::chunkReturned( int inSource, unsigned long inChunk,
+                                         unsigned char *inData,
+                                         double inSeconds ) {
+
+    char good = ( inData != NULL && verifyChunk( inChunk, inData ) );
+
+    DownloadSource *source = &( mSourceStates[ inSource ] );
+    DownloadChunk *chunk = &( mChunks[ inChunk ] );
+
+    mLock.lock();
+
+    source->numRequests --;
+    chunk->numRequests --;
+
+    char shouldWrite = false;
+
+    if( good ) {
+        source->numFailures = 0;
+
+        if( inSeconds > 0 ) {
+            double rate = getChunkSize( inChunk ) / inSeconds;
+
+            if( source->rate < 0 ) {
+                source->rate = rate;
+                }
             else {
-                // failed to write to file, so download cannot continue
-                inDownloadProgressHandler( MULTISOURCE_DOWNLOAD_FAILED,
-                                           bytesSoFar,
-                                           inProgressHandlerExtraArgument );
-                failed = true;
+                source->rate = RATE_SMOOTHING * rate +
+                    ( 1 - RATE_SMOOTHING ) * source->rate;
                 }
-            delete [] chunkData;
+            }
+
+        if( chunk->state == CHUNK_REQUESTED ) {
+            chunk->state = CHUNK_WRITING;
+            shouldWrite = true;
+            }
+        // else a duplicate already arrived
+        }
+    else {
+        source->numFailures ++;
+
+        if( source->numFailures >= MAX_SOURCE_FAILURES ) {
+            source->dead = true;
+            }
+
+        if( chunk->state == CHUNK_REQUESTED && chunk->numRequests == 0 ) {
+            chunk->state = CHUNK_MISSING;
+            mRetryChunks.push_back( inChunk );
+            }
+        else if( chunk->state == CHUNK_REQUESTED &&
+                 chunk->source == inSource ) {
+            // duplicate still in flight
+            chunk->source = chunk->duplicateSource;
+            }
+        }
+
+    wakeWorkers();
+
+    mLock.unlock();
+
+
+    if( shouldWrite ) {
+        unsigned long size = getChunkSize( inChunk );
+
+        char written = mFile.write( inChunk * mChunkSize, inData, size );
+
+        mLock.lock();
+
+        if( written ) {
+            chunk->state = CHUNK_DONE;
+            mRecord[ inChunk / 8 ] |= ( 1 << ( inChunk % 8 ) );
+            mNumDone ++;
+            mBytesDone += size;
+            }
+        else {
+            mWriteFailed = true;
+            mStopping = true;
+            }
+
+        wakeWorkers();
+
+        mLock.unlock();
+
+        mProgress.signal();
+        }
+
+    if( inData != NULL ) {
+        delete [] inData;
+        }
+    }
+
+
+
+void MultiSourceDownload::workerDone() {
+    mLock.lock();
+    mNumLiveWorkers --;
+
+    // a dead source's last worker may leave others with nothing to
+    // duplicate
+    wakeWorkers();
+
+    mLock.unlock();
+
+    mProgress.signal();
+    }
+
+
+
+void MultiSourceDownload::run( char (*inDownloadProgressHandler)(
+                                   int, unsigned long, void * ),
+                               void *inProgressHandlerExtraArgument,
+                               char *inRecordPath ) {
+
+    SimpleVector<Thread *> workers;
+
+    mLock.lock();
+    mNumLiveWorkers = mNumSources * mRequestsPerSource;
+    mLock.unlock();
+
+    for( int s=0; s<mNumSources; s++ ) {
+        for( int i=0; i<mRequestsPerSource; i++ ) {
+            Thread *t = new MultiSourceWorker( this, s );
+            workers.push_back( t );
+            t->start();
+            }
+        }
+
+
+    unsigned long bytesReported = 0;
+    char canceled = false;
+    char complete = false;
+    char failed = false;
+
+    double lastSaveTime = Time::getCurrentTime();
+    char recordChanged = false;
+
+    while( true ) {
+        mLock.lock();
+
+        unsigned long bytesDone = mBytesDone;
+        int numLiveWorkers = mNumLiveWorkers;
+        complete = ( mNumDone == mNumChunks );
+        failed = mWriteFailed;
+
+        mLock.unlock();
+
+
+        if( bytesDone != bytesReported && ! canceled && ! failed ) {
+            bytesReported = bytesDone;
+            recordChanged = true;
+
+            char shouldContinue =
+                inDownloadProgressHandler(
+                    MULTISOURCE_DOWNLOAD_IN_PROGRESS,
+                    bytesDone,
+                    inProgressHandlerExtraArgument );
+
+            if( ! shouldContinue ) {
+                canceled = true;
+
+                mLock.lock();
+                mStopping = true;
+                wakeWorkers();
+                mLock.unlock();
+                }
+            }
+
+        if( numLiveWorkers == 0 ) {
+            break;
+            }
+
+        if( complete && ! canceled ) {
+            // stop workers waiting on or duplicating the last chunks
+            mLock.lock();
+            mStopping = true;
+            wakeWorkers();
+            mLock.unlock();
+            }
+
+        if( inRecordPath != NULL && recordChanged &&
+            Time::getCurrentTime() - lastSaveTime > RECORD_SAVE_INTERVAL ) {
+
+            saveRecord( inRecordPath );
+            lastSaveTime = Time::getCurrentTime();
+            recordChanged = false;
+            }
+
+        mProgress.wait();
+        }
+
+
+    // requests in flight have returned
+    for( int i=0; i<workers.size(); i++ ) {
+        Thread *t = workers.getElementDirect( i );
+        t->join();
+        delete t;
+        }
+
+    complete = ( mNumDone == mNumChunks );
+
+    if( ! mFile.close() ) {
+        failed = true;
+        }
+
+    if( inRecordPath != NULL ) {
+        if( complete && ! failed ) {
+            remove( inRecordPath );
             }
         else {
-            // else go on to the next host
-            sourceIndex ++;
+            saveRecord( inRecordPath );
             }
         }
 
-    // check if we got here because we ran out of hosts (another type of
-    // failure
-    if( !failed && !canceled &&
-        chunksSoFar < numChunks ) {
 
+    if( canceled ) {
+        // call handler last time
+        inDownloadProgressHandler( MULTISOURCE_DOWNLOAD_CANCELED,
+                                   mBytesDone,
+                                   inProgressHandlerExtraArgument );
+        }
+    else if( failed || ! complete ) {
+        // write failed, or we ran out of sources
         inDownloadProgressHandler( MULTISOURCE_DOWNLOAD_FAILED,
-                                   bytesSoFar,
+                                   mBytesDone,
+                                   inProgressHandlerExtraArgument );
+        }
+    else if( mBytesDone != bytesReported ) {
+        // last chunks arrived after we stopped checking
+        inDownloadProgressHandler( MULTISOURCE_DOWNLOAD_IN_PROGRESS,
+                                   mBytesDone,
                                    inProgressHandlerExtraArgument );
         }
-    
-    fclose( outputFile );    
     }
 
 
+
+void multiSourceGetFile( void *inFileDescriptor,
+                         unsigned long inFileSize,
+                         unsigned long inChunkSize,
+                         int inNumSources,
+                         void **inFileSources,
+                         unsigned char * (*inChunkGetter)(
+                             void *, void *, unsigned long, unsigned long ),
+                         char (*inDownloadProgressHandler)(
+                             int, unsigned long, void * ),
+                         void *inProgressHandlerExtraArgument,
+                         char *inDestinationPath ) {
+
+    multiSourceGetFileParallel( inFileDescriptor, inFileSize, inChunkSize,
+                                inNumSources, inFileSources, inChunkGetter,
+                                inDownloadProgressHandler,
+                                inProgressHandlerExtraArgument,
+                                inDestinationPath,
+                                4, NULL, false );
+    }
+
+
+
+void multiSourceGetFileParallel( void *inFileDescriptor,
+                                 unsigned long inFileSize,
+                                 unsigned long inChunkSize,
+                                 int inNumSources,
+                                 void **inFileSources,
+                                 unsigned char * (*inChunkGetter)(
+                                     void *, void *,
+                                     unsigned long, unsigned long ),
+                                 char (*inDownloadProgressHandler)(
+                                     int, unsigned long, void * ),
+                                 void *inProgressHandlerExtraArgument,
+                                 char *inDestinationPath,
+                                 int inRequestsPerSource,
+                                 char **inChunkHashes,
+                                 char inResumable ) {
+
+    char *recordPath = NULL;
+    if( inResumable ) {
+        recordPath = autoSprintf( "%s.parts", inDestinationPath );
+        }
+
+    MultiSourceDownload download( inFileDescriptor, inFileSize, inChunkSize,
+                                  inNumSources, inFileSources, inChunkGetter,
+                                  inRequestsPerSource, inChunkHashes );
+
+    if( ! download.open( inDestinationPath, recordPath ) ) {
+
+        inDownloadProgressHandler( MULTISOURCE_DOWNLOAD_FAILED,
+                                   0, inProgressHandlerExtraArgument );
+        }
+    else {
+        download.run( inDownloadProgressHandler,
+                      inProgressHandlerExtraArgument,
+                      recordPath );
+        }
+
+    if( recordPath != NULL ) {
+        delete [] recordPath;
+        }
+    }
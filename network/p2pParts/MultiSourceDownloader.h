@@ -14,6 +14,9 @@
 #define MULTISOURCE_DOWNLOADER_INCLUDED
 
 
+#include <stddef.h>
+
+
 
 /**
  * Abstract API for multi-source downloads.
@@ -32,6 +35,9 @@ extern int MULTISOURCE_DOWNLOAD_CANCELED;
 /**
  * Gets a file from multiple sources.
  *
+ * Same as multiSourceGetFileParallel with its default settings:  no chunk
+ * verification, and any partial file from an earlier call is overwritten.
+ *
  * @param inFileDescriptor abstract pointer to a file descriptor that can
  *   be used by inChunkGetter to identify a file.
  *   Must be destroyed by caller.
@@ -47,6 +53,7 @@ extern int MULTISOURCE_DOWNLOAD_CANCELED;
  *   and take the following arguments:
  *   ( void *inFileSource, void *inFileDescriptor,
  *     unsigned long inChunkNumber, unsigned long inChunkSize ).
+ *   Called from several threads at once, so must be thread-safe.
  * @praram inDownloadProgressHandler pointer to the handler function for
  *   download progress events.
  *   This function must return true to continue the download (or false
@@ -78,6 +85,63 @@ void multiSourceGetFile( void *inFileDescriptor,
 
 
 
+/**
+ * Gets a file from multiple sources, with several chunk requests in
+ * flight at once.
+ *
+ * Each source gets its own worker threads, one per request it may have
+ * in flight.  Sources start with one request each, and once a source's
+ * throughput is measured, it may have as many requests in flight as its
+ * share of the fastest source's throughput allows.  So faster sources are
+ * handed more chunks, and a slow source can't stall the download.
+ *
+ * Once every chunk has been requested, idle workers send one duplicate
+ * request for each of the oldest chunks still in flight, and whichever
+ * copy arrives first is kept.
+ *
+ * Chunks are written out of order into a file preallocated to full size.
+ * A source is dropped after 3 failed or corrupt chunks in a row, and its
+ * chunks go back to the other sources.
+ *
+ * Arguments are the same as for multiSourceGetFile, except:
+ *
+ * @param inRequestsPerSource the most requests in flight to one source.
+ *   Defaults to 4.
+ * @param inChunkHashes an array of SHA1 digests of each chunk, as
+ *   returned by computeSHA1Digest, or NULL to not verify chunks.
+ *   Corrupt chunks count as failures, and are fetched again.
+ *   Defaults to NULL.
+ *   Array and elements must be destroyed by caller.
+ * @param inResumable true to record which chunks have been written in
+ *   inDestinationPath.parts, and to resume from that record if it
+ *   matches inDestinationPath.  When chunk hashes are given, chunks
+ *   recorded as written are verified before resuming.
+ *   The record is removed once the file is complete.
+ *   Defaults to true.
+ *
+ * inDownloadProgressHandler is only called from the calling thread, and
+ * may not be called once per chunk if several arrive together.
+ * After a cancel, this function waits for requests in flight to return
+ * before calling the handler with MULTISOURCE_DOWNLOAD_CANCELED.
+ */
+void multiSourceGetFileParallel( void *inFileDescriptor,
+                                 unsigned long inFileSize,
+                                 unsigned long inChunkSize,
+                                 int inNumSources,
+                                 void **inFileSources,
+                                 unsigned char * (*inChunkGetter)(
+                                     void *, void *,
+                                     unsigned long, unsigned long ),
+                                 char (*inDownloadProgressHandler)(
+                                     int, unsigned long, void * ),
+                                 void *inProgressHandlerExtraArgument,
+                                 char *inDestinationPath,
+                                 int inRequestsPerSource = 4,
+                                 char **inChunkHashes = NULL,
+                                 char inResumable = true );
+
+
+
 #endif
 
 
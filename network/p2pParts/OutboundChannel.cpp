@@ -24,19 +24,44 @@
 
 #include "minorGems/network/p2pParts/OutboundChannel.h"
 
+#ifdef WIN_32
+#include <windows.h>
+#endif
+
+
+
+static void atomicAdd( volatile long *inValue, long inAmount ) {
+#ifdef WIN_32
+    InterlockedExchangeAdd( inValue, inAmount );
+#else
+    __sync_add_and_fetch( inValue, inAmount );
+#endif
+    }
+
+
+
+static void memoryBarrier() {
+#ifdef WIN_32
+    MemoryBarrier();
+#else
+    __sync_synchronize();
+#endif
+    }
+
 
 
 OutboundChannel::OutboundChannel( OutputStream *inOutputStream,
                                   HostAddress *inHost,
                                   MessagePerSecondLimiter *inLimiter,
                                   unsigned long inQueueSize )
-    : mLock( new MutexLock() ), mMessageReadySemaphore( new Semaphore() ),
+    : mMessageReadySemaphore( new BinarySemaphore() ),
+      mSenderWaiting( false ),
       mStream( inOutputStream ),
       mHost( inHost ),
       mLimiter( inLimiter ),
       mConnectionBroken( false ), mThreadStopped( false ),
-      mMessageQueue( new SimpleVector<char*>() ),
-      mHighPriorityMessageQueue( new SimpleVector<char*>() ),
+      mMessageQueue( new SharedMessageRing( inQueueSize ) ),
+      mHighPriorityMessageQueue( new SharedMessageRing( inQueueSize ) ),
       mMaxQueueSize( inQueueSize ),
       mDroppedMessageCount( 0 ),
       mSentMessageCount( 0 ) {
@@ -49,12 +74,8 @@ OutboundChannel::OutboundChannel( OutputStream *inOutputStream,
 
 
 OutboundChannel::~OutboundChannel() {
-    mLock->lock();
-
     mThreadStopped = true;
 
-    mLock->unlock();
-
     // wake the thread up if it is waiting
     mMessageReadySemaphore->signal();
     
@@ -62,81 +83,64 @@ OutboundChannel::~OutboundChannel() {
     join();
 
 
-    mLock->lock();
-
     delete mMessageReadySemaphore;
     
-    // clear the queues
-    int numMessages = mMessageQueue->size();
-    int i;
-    for( i=0; i<numMessages; i++ ) {
-        char *message = *( mMessageQueue->getElement( i ) );
-        delete [] message;
-        }
+    // releases queued messages
     delete mMessageQueue;
-
-    numMessages = mHighPriorityMessageQueue->size();
-    for( i=0; i<numMessages; i++ ) {
-        char *message = *( mHighPriorityMessageQueue->getElement( i ) );
-        delete [] message;
-        }
     delete mHighPriorityMessageQueue;
 
-    
-
     delete mHost;
-
-    mLock->unlock();
-
-    delete mLock;
     }
     
 
 
 char OutboundChannel::sendMessage( char * inMessage, int inPriority ) {
-    mLock->lock();
+    SharedMessage *message = new SharedMessage( inMessage );
 
+    char sent = sendMessage( message, inPriority );
 
-    char sent;
-    
-    if( !mConnectionBroken ) {
-        // add it to the queue
-        SimpleVector<char *> *queueToUse;
+    message->release();
 
-        if( inPriority <=0 ) {
-            queueToUse = mMessageQueue;
-            }
-        else {
-            queueToUse = mHighPriorityMessageQueue;
-            }
+    return sent;
+    }
 
-        
-        queueToUse->push_back( stringDuplicate( inMessage ) );
-        sent = true;
 
-        if( queueToUse->size() > mMaxQueueSize ) {
-            // the queue is over-full
-            // drop the oldest message
 
-            char *message = *( queueToUse->getElement( 0 ) );
-            queueToUse->deleteElement( 0 );
-            delete [] message;
+char OutboundChannel::sendMessage( SharedMessage *inMessage,
+                                   int inPriority ) {
+    if( mConnectionBroken ) {
+        // channel no longer working
+        return false;
+        }
+    
+    // add it to the queue
+    SharedMessageRing *queueToUse;
 
-            mDroppedMessageCount++;
-            }
+    if( inPriority <=0 ) {
+        queueToUse = mMessageQueue;
         }
     else {
-        // channel no longer working
-        sent = false;
+        queueToUse = mHighPriorityMessageQueue;
+        }
+
+    inMessage->addReference();
+
+    // the sending thread drops the oldest once more than the queue size
+    // are queued, so this only fails when it is a whole queue behind
+    if( ! queueToUse->push( inMessage ) ) {
+        inMessage->release();
+        atomicAdd( &mDroppedMessageCount, 1 );
         }
-        
-    mLock->unlock();
 
-    if( sent ) {
+    // sending thread sets the flag before checking the queues, and we
+    // check it after adding, so one of us sees the other
+    memoryBarrier();
+    
+    if( mSenderWaiting ) {
         mMessageReadySemaphore->signal();
         }
     
-    return sent;
+    return true;
     }
 
 
@@ -155,113 +159,162 @@ void OutboundChannel::setHost( HostAddress *inHost ) {
 
 
 int OutboundChannel::getSentMessageCount() {
-    mLock->lock();
-    int count = mSentMessageCount;
-    mLock->unlock();
+    return mSentMessageCount;
+    }
+
+
 
-    return count;
+// messages queued beyond the queue size are as good as dropped
+static int getExcess( SharedMessageRing *inQueue ) {
+    int excess = inQueue->size() - inQueue->getCapacity();
+    if( excess < 0 ) {
+        excess = 0;
+        }
+    return excess;
     }
 
 
 
 int OutboundChannel::getQueuedMessageCount() {
-    mLock->lock();
-    int count = mMessageQueue->size() + mHighPriorityMessageQueue->size();
-    mLock->unlock();
-
-    return count;
+    return 
+        mMessageQueue->size() - getExcess( mMessageQueue ) +
+        mHighPriorityMessageQueue->size() - 
+        getExcess( mHighPriorityMessageQueue );
     }
 
 
 
 int OutboundChannel::getDroppedMessageCount() {
-    mLock->lock();
-    int count = mDroppedMessageCount;
-    mLock->unlock();
+    return (int)mDroppedMessageCount +
+        getExcess( mMessageQueue ) + getExcess( mHighPriorityMessageQueue );
+    }
+
+
+
+char OutboundChannel::sendBatch( SharedMessage **inBatch, int inNumMessages,
+                                 unsigned char **inBuffers,
+                                 long *inLengths ) {
+    
+    long batchLength = 0;
+    
+    for( int i=0; i<inNumMessages; i++ ) {
+        inBuffers[i] = (unsigned char *)( inBatch[i]->getMessage() );
+        inLengths[i] = inBatch[i]->getLength();
+        batchLength += inLengths[i];
+        }
+    
+    long bytesSent = mStream->writeVector( inBuffers, inLengths,
+                                           inNumMessages );
+    
+    for( int i=0; i<inNumMessages; i++ ) {
+        inBatch[i]->release();
+        }
+    
+    if( bytesSent != batchLength ) {
+        return false;
+        }
 
-    return count;
+    mSentMessageCount += inNumMessages;
+    return true;
     }
 
 
 
 void OutboundChannel::run() {
-    mLock->lock();
-    char stopped = mThreadStopped;
-    mLock->unlock();
-
-    while( !stopped ) {
 
+    // both queues, emptied at once
+    int maxBatchSize = 2 * mMaxQueueSize;
+    if( maxBatchSize < 1 ) {
+        maxBatchSize = 1;
+        }
 
-        // get a message from the queue, checking high priority queue first
-        char *message = NULL;
+    SharedMessage **batch = new SharedMessage*[ maxBatchSize ];
+    unsigned char **buffers = new unsigned char*[ maxBatchSize ];
+    long *lengths = new long[ maxBatchSize ];
+    
 
-        mLock->lock();
+    while( !mThreadStopped ) {
 
-        if( mHighPriorityMessageQueue->size() >= 1 ) {
-            message = *( mHighPriorityMessageQueue->getElement( 0 ) );
-            mHighPriorityMessageQueue->deleteElement( 0 );             
-            }        
-        else if( mMessageQueue->size() >= 1 ) {
-            message = *( mMessageQueue->getElement( 0 ) );
-            mMessageQueue->deleteElement( 0 );            
+        // drop the oldest of anything beyond the queue size
+        int numDropped = 
+            mHighPriorityMessageQueue->dropOldest() + 
+            mMessageQueue->dropOldest();
+        
+        if( numDropped > 0 ) {
+            atomicAdd( &mDroppedMessageCount, numDropped );
             }
 
-        mLock->unlock();
+        int numReady = 
+            mHighPriorityMessageQueue->size() + mMessageQueue->size();
 
-        // note that we're unlocked during the send, so messages
-        // can be freely added to the queue without blocking while we send
-        // this message
+        if( numReady > maxBatchSize ) {
+            numReady = maxBatchSize;
+            }
         
-        if( message != NULL ) {
-
+        if( numReady > 0 && 
+            ( mHighPriorityMessageQueue->canPop() || 
+              mMessageQueue->canPop() ) ) {
+            
             // obey the limit
             // we will block here if message rate is too high
-            mLimiter->messageTransmitted();
-                        
-            int bytesSent = mStream->writeString( message );
-
-            int messageLength = strlen( message );
-    
-            delete [] message;
-
-
-            char sent;
+            // all that fit in the limiter's budget go out in one write
+            int batchLimit = mLimiter->messagesTransmitted( numReady );
+
+            if( batchLimit < numReady ) {
+                // more may have come in while we waited for the limiter
+                numDropped = 
+                    mHighPriorityMessageQueue->dropOldest() + 
+                    mMessageQueue->dropOldest();
+                
+                if( numDropped > 0 ) {
+                    atomicAdd( &mDroppedMessageCount, numDropped );
+                    }
+                }
             
-            if( bytesSent == messageLength ) {
-                sent = true;
-
-                mLock->lock();
-                mSentMessageCount++;
-                mLock->unlock();
+            // take messages from the queues, high priority queue first
+            int batchSize = 0;
+            SharedMessage *message;
+        
+            while( batchSize < batchLimit &&
+                   ( message = mHighPriorityMessageQueue->pop() ) != NULL ) {
+                batch[ batchSize ] = message;
+                batchSize++;
                 }
-            else {
-                sent = false;
+            while( batchSize < batchLimit &&
+                   ( message = mMessageQueue->pop() ) != NULL ) {
+                batch[ batchSize ] = message;
+                batchSize++;
                 }
 
-
-            if( !sent ) {
+            // messages can be freely added to the queues without
+            // blocking while we send this batch
+            if( batchSize > 0 &&
+                ! sendBatch( batch, batchSize, buffers, lengths ) ) {
                 // connection is broken
                 // stop this thread
-                
-                mLock->lock();
-
                 mConnectionBroken = true;
                 mThreadStopped = true;
-
-                mLock->unlock();
                 }
             }
         else {
             // no messages in the queue.
             // wait for more messages to be ready
-            mMessageReadySemaphore->wait();
+            mSenderWaiting = true;
+            memoryBarrier();
+
+            // check again, in case a message was added before senders
+            // could see the flag
+            if( ! mThreadStopped &&
+                ! mHighPriorityMessageQueue->canPop() &&
+                ! mMessageQueue->canPop() ) {
+                
+                mMessageReadySemaphore->wait();
+                }
+            mSenderWaiting = false;
             }
-        
-
-        // check if we've been stopped
-        mLock->lock();
-        stopped = mThreadStopped;
-        mLock->unlock();
         }
-    
+
+    delete [] batch;
+    delete [] buffers;
+    delete [] lengths;
     }
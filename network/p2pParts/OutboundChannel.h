@@ -29,14 +29,14 @@
 
 #include "minorGems/io/OutputStream.h"
 
-#include "minorGems/system/MutexLock.h"
-#include "minorGems/system/Semaphore.h"
+#include "minorGems/system/BinarySemaphore.h"
 
 #include "minorGems/system/Thread.h"
 
 #include "minorGems/util/SimpleVector.h"
 
 #include "minorGems/network/p2pParts/MessagePerSecondLimiter.h"
+#include "minorGems/network/p2pParts/SharedMessage.h"
 
 
 
@@ -68,6 +68,7 @@ class OutboundChannel : public Thread {
          * @param inLimiter the limiter for outbound messages.
          *   Must be destroyed by caller after this class is destroyed.
          * @param inQueueSize the size of the send queue.  Defaults to 50.
+         *   When more are queued, the oldest are dropped.
          */
         OutboundChannel( OutputStream *inOutputStream, HostAddress *inHost,
                          MessagePerSecondLimiter *inLimiter,
@@ -105,6 +106,29 @@ class OutboundChannel : public Thread {
 
 
 
+        /**
+         * Sends a shared message to this channel's receiver without
+         * copying it.
+         *
+         * Thread safe.
+         *
+         * Broadcasts should create one SharedMessage, send it to each
+         * channel, and then release it.
+         *
+         * @param inMessage the message to send.
+         *   This channel adds its own reference, and releases it once the
+         *   message is sent or dropped.  The caller's reference is
+         *   unchanged.
+         * @param inPriority the priority of this message, as for the
+         *   other sendMessage.
+         *
+         * @return true if the channel is still functioning properly,
+         *   or false if the channel has been broken.
+         */
+        char sendMessage( SharedMessage *inMessage, int inPriority = 0 );
+
+
+
         /**
          * Gets the host receiving from this channel.
          *
@@ -168,8 +192,13 @@ class OutboundChannel : public Thread {
         
     protected:
 
-        MutexLock *mLock;
-        Semaphore *mMessageReadySemaphore;
+        // signals coalesce, since the sending thread empties the queues
+        // whenever it wakes
+        BinarySemaphore *mMessageReadySemaphore;
+
+        // set while the sending thread waits on the semaphore, so senders
+        // only signal it then
+        volatile char mSenderWaiting;
         
         OutputStream *mStream;
         
@@ -178,20 +207,31 @@ class OutboundChannel : public Thread {
         MessagePerSecondLimiter *mLimiter;
         
         
-        char mConnectionBroken;
+        volatile char mConnectionBroken;
 
-        char mThreadStopped;
+        volatile char mThreadStopped;
 
 
-        SimpleVector<char*> *mMessageQueue;
-        SimpleVector<char*> *mHighPriorityMessageQueue;
+        // added to without locking by any thread, emptied by the sending
+        // thread
+        SharedMessageRing *mMessageQueue;
+        SharedMessageRing *mHighPriorityMessageQueue;
 
 
         int mMaxQueueSize;
         
-        int mDroppedMessageCount;
+        // changed atomically
+        volatile long mDroppedMessageCount;
+
+        // only changed by the sending thread
+        volatile int mSentMessageCount;
+
 
-        int mSentMessageCount;
+        // sends up to inNumMessages from the front of inBatch in as few
+        // writes as the limiter allows, releasing them
+        // returns false if the stream broke
+        char sendBatch( SharedMessage **inBatch, int inNumMessages,
+                        unsigned char **inBuffers, long *inLengths );
         
     };
 
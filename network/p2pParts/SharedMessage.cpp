@@ -0,0 +1,206 @@
+#include "SharedMessage.h"
+
+#include <string.h>
+
+#ifdef WIN_32
+#include <windows.h>
+#endif
+
+
+
+SharedMessage::SharedMessage( const char *inMessage )
+        : mLength( strlen( inMessage ) ),
+          mReferenceCount( 1 ) {
+
+    mMessage = new char[ mLength + 1 ];
+    memcpy( mMessage, inMessage, mLength + 1 );
+    }
+
+
+
+SharedMessage::~SharedMessage() {
+    delete [] mMessage;
+    }
+
+
+
+void SharedMessage::addReference() {
+#ifdef WIN_32
+    InterlockedIncrement( &mReferenceCount );
+#else
+    __sync_add_and_fetch( &mReferenceCount, 1 );
+#endif
+    }
+
+
+
+void SharedMessage::release() {
+#ifdef WIN_32
+    long count = InterlockedDecrement( &mReferenceCount );
+#else
+    long count = __sync_sub_and_fetch( &mReferenceCount, 1 );
+#endif
+
+    if( count == 0 ) {
+        delete this;
+        }
+    }
+
+
+
+static char compareAndSwap( volatile unsigned long *inValue,
+                            unsigned long inOldValue,
+                            unsigned long inNewValue ) {
+#ifdef WIN_32
+    return (unsigned long)InterlockedCompareExchange(
+        (volatile LONG *)inValue, (LONG)inNewValue, (LONG)inOldValue )
+        == inOldValue;
+#else
+    return __sync_bool_compare_and_swap( inValue, inOldValue, inNewValue );
+#endif
+    }
+
+
+
+static void memoryBarrier() {
+#ifdef WIN_32
+    MemoryBarrier();
+#else
+    __sync_synchronize();
+#endif
+    }
+
+
+
+SharedMessageRing::SharedMessageRing( int inCapacity )
+        : mCells( NULL ), mMask( 0 ), mCapacity( inCapacity ),
+          mTail( 0 ), mHead( 0 ) {
+
+    if( mCapacity < 0 ) {
+        mCapacity = 0;
+        }
+    if( mCapacity > 0 ) {
+        // power of two, with room for twice the capacity
+        unsigned long numCells = 2;
+        while( numCells < (unsigned long)( 2 * mCapacity ) ) {
+            numCells *= 2;
+            }
+        mMask = numCells - 1;
+
+        mCells = new RingCell[ numCells ];
+        for( unsigned long i=0; i<numCells; i++ ) {
+            mCells[i].sequence = i;
+            mCells[i].message = NULL;
+            }
+        }
+    }
+
+
+
+SharedMessageRing::~SharedMessageRing() {
+    if( mCells == NULL ) {
+        return;
+        }
+
+    SharedMessage *message;
+    while( ( message = pop() ) != NULL ) {
+        message->release();
+        }
+
+    delete [] mCells;
+    }
+
+
+
+char SharedMessageRing::push( SharedMessage *inMessage ) {
+    if( mCells == NULL ) {
+        return false;
+        }
+
+    unsigned long position = mTail;
+    RingCell *cell;
+
+    while( true ) {
+        cell = &( mCells[ position & mMask ] );
+
+        long difference = (long)( cell->sequence - position );
+
+        if( difference == 0 ) {
+            // free, claim it
+            if( compareAndSwap( &mTail, position, position + 1 ) ) {
+                break;
+                }
+            }
+        else if( difference < 0 ) {
+            // still holds a message from a lap ago
+            return false;
+            }
+        // another adder claimed it first
+        position = mTail;
+        }
+
+    cell->message = inMessage;
+
+    // message visible before the cell is marked as filled
+    memoryBarrier();
+    cell->sequence = position + 1;
+
+    return true;
+    }
+
+
+
+char SharedMessageRing::canPop() {
+    if( mCells == NULL ) {
+        return false;
+        }
+    return ( mCells[ mHead & mMask ].sequence == mHead + 1 );
+    }
+
+
+
+SharedMessage *SharedMessageRing::pop() {
+    if( ! canPop() ) {
+        return NULL;
+        }
+
+    unsigned long position = mHead;
+    RingCell *cell = &( mCells[ position & mMask ] );
+
+    memoryBarrier();
+    SharedMessage *message = cell->message;
+    memoryBarrier();
+
+    // free for the adder one lap ahead
+    cell->sequence = position + mMask + 1;
+    mHead = position + 1;
+
+    return message;
+    }
+
+
+
+int SharedMessageRing::dropOldest() {
+    int numDropped = 0;
+
+    while( size() > mCapacity ) {
+        SharedMessage *message = pop();
+        if( message == NULL ) {
+            break;
+            }
+        message->release();
+        numDropped++;
+        }
+
+    return numDropped;
+    }
+
+
+
+int SharedMessageRing::size() {
+    long count = (long)( mTail - mHead );
+    if( count < 0 ) {
+        count = 0;
+        }
+    return (int)count;
+    }
@@ -0,0 +1,145 @@
+#ifndef SHARED_MESSAGE_INCLUDED
+#define SHARED_MESSAGE_INCLUDED
+
+
+#include <stddef.h>
+
+
+
+/**
+ * A reference-counted, immutable message string.
+ *
+ * One message broadcast to many channels is queued by each of them
+ * without being copied, and freed once the last channel has sent or
+ * dropped it.
+ *
+ * Reference counting is atomic, so references may be added and released
+ * from any thread.
+ */
+class SharedMessage {
+
+    public:
+
+        /**
+         * Copies a message.  The caller holds the first reference.
+         *
+         * @param inMessage the \0-terminated message.
+         *   Must be destroyed by caller.
+         */
+        SharedMessage( const char *inMessage );
+
+
+        void addReference();
+
+        // drops a reference, destroying this message when the last one
+        // is dropped
+        void release();
+
+
+        // owned by this message
+        char *getMessage() {
+            return mMessage;
+            }
+
+        // not counting the \0
+        int getLength() {
+            return mLength;
+            }
+
+
+    protected:
+
+        // destroyed by release only
+        ~SharedMessage();
+
+        char *mMessage;
+        int mLength;
+
+        volatile long mReferenceCount;
+    };
+
+
+
+/**
+ * A FIFO of message references that any number of threads can add to
+ * without locking, while one thread removes them.
+ *
+ * The remover keeps the queue to its capacity by dropping the oldest
+ * messages.  Adders only fail when twice the capacity is queued, which
+ * means the remover has fallen a whole queue behind.
+ */
+class SharedMessageRing {
+
+    public:
+
+        SharedMessageRing( int inCapacity );
+
+        // releases messages still queued
+        // not safe while other threads use the ring
+        ~SharedMessageRing();
+
+
+        /**
+         * Adds a message to the back, taking over the caller's reference.
+         *
+         * Thread safe.
+         *
+         * @return true if added, or false if the ring is full (or has a
+         *   capacity of 0), in which case the caller keeps its reference.
+         */
+        char push( SharedMessage *inMessage );
+
+
+        // removes the oldest message, passing its reference to the caller
+        // returns NULL if empty, or if the oldest message is still being
+        // added
+        // only call from the removing thread
+        SharedMessage *pop();
+
+
+        // true if pop would return a message
+        // only call from the removing thread
+        char canPop();
+
+
+        // drops and releases the oldest messages until at most the
+        // capacity are queued, returning how many were dropped
+        // only call from the removing thread
+        int dropOldest();
+
+
+        // number queued, possibly more than the capacity until the
+        // remover drops the oldest
+        // approximate while messages are being added or removed
+        int size();
+
+
+        int getCapacity() {
+            return mCapacity;
+            }
+
+
+    protected:
+
+        typedef struct RingCell {
+                // position this cell is ready for:  equal to the
+                // position when free to add, one past it when filled
+                volatile unsigned long sequence;
+                SharedMessage *message;
+            } RingCell;
+
+        RingCell *mCells;
+        unsigned long mMask;
+
+        int mCapacity;
+
+        // next position to add to, claimed by adders
+        volatile unsigned long mTail;
+
+        // next position to remove from
+        volatile unsigned long mHead;
+    };
+
+
+
+#endif
@@ -0,0 +1,519 @@
+// Test harness for multiSourceGetFileParallel
+//
+// Usage:  multiSourceDownloaderTest [numChunks] [slowDelayMS]
+//
+// Simulated sources return chunks of a generated file after a fixed delay,
+// and fail or corrupt chunks at a given rate.  Checks that the file
+// arrives intact from sources of mixed speed and reliability, that faster
+// sources are handed more chunks, that the endgame duplicates chunks held
+// by a stalled source, that corrupt chunks are fetched again, and that a
+// canceled download resumes without fetching chunks it already has.
+//
+// Then times a file from one slow and two fast sources:  fetched in
+// order, one chunk at a time, the way multiSourceGetFile used to, against
+// the parallel scheduler.
+//
+// Writes multiSourceDownloaderTest.out and .parts, and removes them after.
+
+
+#include "minorGems/network/p2pParts/MultiSourceDownloader.h"
+#include "minorGems/system/Thread.h"
+#include "minorGems/system/MutexLock.h"
+#include "minorGems/system/Time.h"
+#include "minorGems/crypto/hashes/sha1.h"
+#include "minorGems/util/stringUtils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+
+static int numFailed = 0;
+
+
+static void check( char inPassed, const char *inWhat ) {
+    if( ! inPassed ) {
+        printf( "FAILED:  %s\n", inWhat );
+        numFailed++;
+        }
+    }
+
+
+
+static const char *outPath = "multiSourceDownloaderTest.out";
+static const char *partsPath = "multiSourceDownloaderTest.out.parts";
+
+static unsigned long chunkSize = 4096;
+// last chunk partial
+static unsigned long fileSize;
+
+
+
+static unsigned char fileByte( unsigned long inIndex ) {
+    return (unsigned char)( ( inIndex * 131 ) ^ ( inIndex >> 11 ) );
+    }
+
+
+
+typedef struct SimSource {
+        int delayMS;
+
+        // percent of requests that return NULL
+        int failPercent;
+
+        // percent of requests that return damaged data
+        int corruptPercent;
+
+        MutexLock *lock;
+        unsigned int randState;
+        int numRequests;
+        int numServed;
+    } SimSource;
+
+
+
+static void initSource( SimSource *inSource, int inDelayMS,
+                        int inFailPercent, int inCorruptPercent,
+                        unsigned int inSeed ) {
+    inSource->delayMS = inDelayMS;
+    inSource->failPercent = inFailPercent;
+    inSource->corruptPercent = inCorruptPercent;
+    inSource->lock = new MutexLock();
+    inSource->randState = inSeed;
+    inSource->numRequests = 0;
+    inSource->numServed = 0;
+    }
+
+
+
+static unsigned char *getChunk( void *inSource, void *inFileDescriptor,
+                                unsigned long inChunkNumber,
+                                unsigned long inChunkSize ) {
+    SimSource *source = (SimSource *)inSource;
+
+    source->lock->lock();
+    source->numRequests ++;
+
+    // per-source LCG, so runs repeat
+    source->randState = source->randState * 1103515245 + 12345;
+    int roll = ( source->randState >> 16 ) % 100;
+
+    source->lock->unlock();
+
+
+    Thread::staticSleep( source->delayMS );
+
+    if( roll < source->failPercent ) {
+        return NULL;
+        }
+
+    unsigned char *data = new unsigned char[ inChunkSize ];
+
+    unsigned long start = inChunkNumber * chunkSize;
+    for( unsigned long i=0; i<inChunkSize; i++ ) {
+        data[i] = fileByte( start + i );
+        }
+
+    if( roll < source->failPercent + source->corruptPercent ) {
+        data[ inChunkSize / 2 ] ^= 0x55;
+        }
+
+    source->lock->lock();
+    source->numServed ++;
+    source->lock->unlock();
+
+    return data;
+    }
+
+
+
+typedef struct ProgressRecord {
+        int numCalls;
+        int lastCode;
+        unsigned long lastBytes;
+
+        // cancel once this many bytes arrive, or 0 to never cancel
+        unsigned long cancelAtBytes;
+
+        // calls after FAILED or CANCELED, or bytes going backwards
+        char misordered;
+
+        // when last byte arrived
+        double completeTime;
+    } ProgressRecord;
+
+
+
+static char progressHandler( int inResultCode, unsigned long inBytes,
+                             void *inExtraArgument ) {
+    ProgressRecord *r = (ProgressRecord *)inExtraArgument;
+
+    if( r->numCalls > 0 &&
+        ( r->lastCode != MULTISOURCE_DOWNLOAD_IN_PROGRESS ||
+          inBytes < r->lastBytes ) ) {
+        r->misordered = true;
+        }
+
+    r->numCalls ++;
+    r->lastCode = inResultCode;
+    r->lastBytes = inBytes;
+
+    if( inBytes == fileSize ) {
+        r->completeTime = Time::getCurrentTime();
+        }
+
+    if( r->cancelAtBytes > 0 && inBytes >= r->cancelAtBytes ) {
+        return false;
+        }
+    return true;
+    }
+
+
+
+static void initProgress( ProgressRecord *inRecord ) {
+    inRecord->numCalls = 0;
+    inRecord->lastCode = -1;
+    inRecord->lastBytes = 0;
+    inRecord->cancelAtBytes = 0;
+    inRecord->misordered = false;
+    inRecord->completeTime = 0;
+    }
+
+
+
+static char fileMatches() {
+    FILE *f = fopen( outPath, "rb" );
+    if( f == NULL ) {
+        return false;
+        }
+
+    char match = true;
+    unsigned long i = 0;
+    int c;
+    while( match && ( c = fgetc( f ) ) != EOF ) {
+        if( i >= fileSize || c != fileByte( i ) ) {
+            match = false;
+            }
+        i++;
+        }
+    fclose( f );
+
+    return match && i == fileSize;
+    }
+
+
+
+static char fileExists( const char *inPath ) {
+    FILE *f = fopen( inPath, "rb" );
+    if( f != NULL ) {
+        fclose( f );
+        return true;
+        }
+    return false;
+    }
+
+
+
+static char **makeChunkHashes( unsigned long inNumChunks ) {
+    char **hashes = new char*[ inNumChunks ];
+
+    unsigned char *data = new unsigned char[ chunkSize ];
+
+    for( unsigned long c=0; c<inNumChunks; c++ ) {
+        unsigned long start = c * chunkSize;
+        unsigned long size = chunkSize;
+        if( start + size > fileSize ) {
+            size = fileSize - start;
+            }
+        for( unsigned long i=0; i<size; i++ ) {
+            data[i] = fileByte( start + i );
+            }
+        hashes[c] = computeSHA1Digest( data, size );
+        }
+
+    delete [] data;
+    return hashes;
+    }
+
+
+
+static void download( SimSource *inSources, int inNumSources,
+                      ProgressRecord *inProgress,
+                      int inRequestsPerSource, char **inHashes ) {
+    void **sources = new void*[ inNumSources ];
+    for( int i=0; i<inNumSources; i++ ) {
+        sources[i] = &( inSources[i] );
+        }
+
+    multiSourceGetFileParallel( NULL, fileSize, chunkSize,
+                                inNumSources, sources, getChunk,
+                                progressHandler, inProgress,
+                                (char *)outPath,
+                                inRequestsPerSource, inHashes, true );
+    delete [] sources;
+    }
+
+
+
+static void freeSources( SimSource *inSources, int inNumSources ) {
+    for( int i=0; i<inNumSources; i++ ) {
+        delete inSources[i].lock;
+        }
+    }
+
+
+
+static char finishedWhole( ProgressRecord *inProgress ) {
+    return inProgress->lastCode == MULTISOURCE_DOWNLOAD_IN_PROGRESS &&
+        inProgress->lastBytes == fileSize &&
+        ! inProgress->misordered;
+    }
+
+
+
+// mixed speeds, flaky sources, one dead source
+static void checkMixedSources( unsigned long inNumChunks ) {
+    SimSource s[4];
+    initSource( &s[0], 1, 0, 0, 1 );
+    initSource( &s[1], 8, 0, 0, 2 );
+    initSource( &s[2], 2, 20, 0, 3 );
+    initSource( &s[3], 1, 100, 0, 4 );
+
+    ProgressRecord p;
+    initProgress( &p );
+
+    download( s, 4, &p, 4, NULL );
+
+    check( finishedWhole( &p ), "mixed sources finished" );
+    check( fileMatches(), "mixed sources file contents" );
+    check( ! fileExists( partsPath ), "record removed when complete" );
+    check( s[0].numServed > s[1].numServed,
+           "fast source handed more chunks than slow one" );
+    check( s[3].numRequests <= 3 + 3,
+           "dead source dropped" );
+
+    freeSources( s, 4 );
+    }
+
+
+
+// corrupt chunks caught by hashes
+static void checkCorruption( unsigned long inNumChunks, char **inHashes ) {
+    SimSource s[3];
+    initSource( &s[0], 1, 0, 15, 5 );
+    initSource( &s[1], 1, 0, 15, 6 );
+    initSource( &s[2], 2, 0, 0, 15 );
+
+    ProgressRecord p;
+    initProgress( &p );
+
+    download( s, 3, &p, 3, inHashes );
+
+    check( finishedWhole( &p ), "corrupting sources finished" );
+    check( fileMatches(), "corrupt chunks fetched again" );
+
+    freeSources( s, 3 );
+    }
+
+
+
+// a stalled source holds a chunk until the endgame duplicates it
+static void checkEndgame( unsigned long inNumChunks, int inStallMS ) {
+    SimSource s[2];
+    initSource( &s[0], 1, 0, 0, 7 );
+    initSource( &s[1], inStallMS, 0, 0, 8 );
+
+    ProgressRecord p;
+    initProgress( &p );
+
+    double start = Time::getCurrentTime();
+
+    // returns once stalled source answers
+    download( s, 2, &p, 2, NULL );
+
+    check( finishedWhole( &p ) && fileMatches(), "stalled source finished" );
+    check( p.completeTime - start < 0.8 * inStallMS / 1000.0,
+           "endgame fetched chunk held by stalled source" );
+
+    freeSources( s, 2 );
+    }
+
+
+
+// canceled partway, then resumed
+static void checkResume( unsigned long inNumChunks, char **inHashes ) {
+    SimSource s[2];
+    initSource( &s[0], 1, 0, 0, 9 );
+    initSource( &s[1], 2, 0, 0, 10 );
+
+    ProgressRecord p;
+    initProgress( &p );
+    p.cancelAtBytes = fileSize / 2;
+
+    download( s, 2, &p, 2, inHashes );
+
+    check( p.lastCode == MULTISOURCE_DOWNLOAD_CANCELED && ! p.misordered,
+           "cancel reported last" );
+    check( fileExists( partsPath ), "record kept after cancel" );
+
+    unsigned long chunksBefore = p.lastBytes / chunkSize;
+
+    freeSources( s, 2 );
+
+
+    initSource( &s[0], 1, 0, 0, 11 );
+    initSource( &s[1], 2, 0, 0, 12 );
+    initProgress( &p );
+
+    download( s, 2, &p, 2, inHashes );
+
+    check( finishedWhole( &p ) && fileMatches(), "resumed download" );
+
+    int numRequested = s[0].numRequests + s[1].numRequests;
+    check( (unsigned long)numRequested <= inNumChunks - chunksBefore + 4,
+           "resume skipped chunks already written" );
+    check( ! fileExists( partsPath ), "record removed after resume" );
+
+    freeSources( s, 2 );
+    }
+
+
+
+static void checkAllFail() {
+    SimSource s[2];
+    initSource( &s[0], 1, 100, 0, 13 );
+    initSource( &s[1], 1, 100, 0, 14 );
+
+    ProgressRecord p;
+    initProgress( &p );
+
+    download( s, 2, &p, 2, NULL );
+
+    check( p.lastCode == MULTISOURCE_DOWNLOAD_FAILED && ! p.misordered,
+           "failure reported last when sources run out" );
+    check( fileExists( partsPath ), "record kept after failure" );
+
+    remove( partsPath );
+    freeSources( s, 2 );
+    }
+
+
+
+// fetches in order from the first source that works, like the old
+// multiSourceGetFile
+static double timeLinear( SimSource *inSources, int inNumSources ) {
+    double start = Time::getCurrentTime();
+
+    FILE *f = fopen( outPath, "wb" );
+
+    unsigned long numChunks = ( fileSize + chunkSize - 1 ) / chunkSize;
+    int s = 0;
+    unsigned long c = 0;
+    while( c < numChunks && s < inNumSources ) {
+        unsigned long size = chunkSize;
+        if( c * chunkSize + size > fileSize ) {
+            size = fileSize - c * chunkSize;
+            }
+        unsigned char *data = getChunk( &( inSources[s] ), NULL, c, size );
+
+        if( data != NULL ) {
+            fwrite( data, 1, size, f );
+            delete [] data;
+            c++;
+            }
+        else {
+            s++;
+            }
+        }
+    fclose( f );
+
+    return Time::getCurrentTime() - start;
+    }
+
+
+
+int main( int inNumArgs, char **inArgs ) {
+
+    unsigned long numChunks = 120;
+    int slowDelay = 20;
+
+    if( inNumArgs > 1 ) {
+        numChunks = atoi( inArgs[1] );
+        }
+    if( inNumArgs > 2 ) {
+        slowDelay = atoi( inArgs[2] );
+        }
+
+    if( numChunks < 8 || slowDelay < 1 ) {
+        printf( "Usage:  multiSourceDownloaderTest [numChunks >= 8] "
+                "[slowDelayMS]\n" );
+        return 1;
+        }
+
+    fileSize = numChunks * chunkSize - chunkSize / 3;
+
+    remove( outPath );
+    remove( partsPath );
+
+    char **hashes = makeChunkHashes( numChunks );
+
+
+    checkMixedSources( numChunks );
+    checkCorruption( numChunks, hashes );
+    checkEndgame( numChunks, 25 * slowDelay );
+    checkResume( numChunks, hashes );
+    checkAllFail();
+
+    if( numFailed == 0 ) {
+        printf( "Mixed source, corruption, endgame, and resume checks "
+                "passed\n\n" );
+        }
+
+
+    SimSource s[3];
+    initSource( &s[0], slowDelay, 0, 0, 20 );
+    initSource( &s[1], slowDelay / 4, 0, 0, 21 );
+    initSource( &s[2], slowDelay / 4, 0, 0, 22 );
+
+    double linearTime = timeLinear( s, 3 );
+    remove( outPath );
+
+    s[0].numServed = 0;
+
+    ProgressRecord p;
+    initProgress( &p );
+
+    double start = Time::getCurrentTime();
+    download( s, 3, &p, 4, hashes );
+    double parallelTime = Time::getCurrentTime() - start;
+
+    check( finishedWhole( &p ) && fileMatches(), "timed download" );
+
+    printf( "%lu chunks of %lu bytes, one %d ms source listed first, "
+            "two %d ms sources:\n",
+            numChunks, chunkSize, slowDelay, slowDelay / 4 );
+    printf( "%-40s %9.2f ms\n", "in order, one request at a time",
+            1000 * linearTime );
+    printf( "%-40s %9.2f ms  (slow source served %d)\n",
+            "parallel, 4 requests per source",
+            1000 * parallelTime, s[0].numServed );
+
+    freeSources( s, 3 );
+
+    for( unsigned long c=0; c<numChunks; c++ ) {
+        delete [] hashes[c];
+        }
+    delete [] hashes;
+
+    remove( outPath );
+    remove( partsPath );
+
+    if( numFailed > 0 ) {
+        printf( "\n%d checks FAILED\n", numFailed );
+        return 1;
+        }
+
+    printf( "\nAll checks passed\n" );
+    return 0;
+    }
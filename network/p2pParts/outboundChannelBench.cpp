@@ -0,0 +1,448 @@
+// Test and benchmark for OutboundChannel
+//
+// Usage:  outboundChannelBench [channels] [messages] [messageBytes]
+//
+// Checks priority order, batching of queued messages into one vectored
+// write, dropping the oldest message from a full queue, and broken
+// streams.  Checks that messages piling up behind a slow stream go out
+// many per write, and that a rate-limited channel still batches up to its
+// limiter's budget while keeping to the rate.
+//
+// Then broadcasts messages to many channels writing to null streams, and
+// times until all are sent:  copying each message per channel, against
+// one shared message per broadcast.  With more channels than cores, every
+// broadcast wakes every sending thread, so expect close to one message
+// per write there.
+
+
+#include "minorGems/network/p2pParts/OutboundChannel.h"
+#include "minorGems/system/BinarySemaphore.h"
+#include "minorGems/system/MutexLock.h"
+#include "minorGems/system/Thread.h"
+#include "minorGems/system/Time.h"
+#include "minorGems/util/stringUtils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+
+static int numFailed = 0;
+
+
+static void check( char inPassed, const char *inWhat ) {
+    if( ! inPassed ) {
+        printf( "FAILED:  %s\n", inWhat );
+        numFailed++;
+        }
+    }
+
+
+
+// records what is written, and can hold the writer until opened
+class RecordingStream : public OutputStream {
+
+    public:
+
+        RecordingStream( char inRecord = true, char inBroken = false )
+                : mRecord( inRecord ), mBroken( inBroken ),
+                  mGated( false ), mWriteDelay( 0 ),
+                  mNumWrites( 0 ),
+                  mNumBytes( 0 ) {
+            }
+
+
+        // next write blocks until open is called
+        void gate() {
+            mGated = true;
+            }
+
+        // waits until writer is blocked at the gate
+        void waitAtGate() {
+            mEntered.wait();
+            }
+
+        void open() {
+            mOpen.signal();
+            }
+
+
+        virtual long write( unsigned char *inBuffer, long inNumBytes ) {
+            return writeVector( &inBuffer, &inNumBytes, 1 );
+            }
+
+
+        virtual long writeVector( unsigned char **inBuffers,
+                                  long *inLengths, int inNumBuffers ) {
+            if( mGated ) {
+                mGated = false;
+                mEntered.signal();
+                mOpen.wait();
+                }
+            if( mWriteDelay > 0 ) {
+                Thread::staticSleep( mWriteDelay );
+                }
+
+            mLock.lock();
+
+            mNumWrites ++;
+
+            long total = 0;
+            for( int i=0; i<inNumBuffers; i++ ) {
+                if( mRecord ) {
+                    mData.appendArray( (char *)inBuffers[i], inLengths[i] );
+                    mData.push_back( '|' );
+                    }
+                total += inLengths[i];
+                }
+            mNumBytes += total;
+
+            mLock.unlock();
+
+            if( mBroken ) {
+                return -1;
+                }
+            return total;
+            }
+
+
+        // destroyed by caller
+        char *getRecord() {
+            mLock.lock();
+            char *record = mData.getElementString();
+            mLock.unlock();
+            return record;
+            }
+
+
+        char mRecord;
+        char mBroken;
+        volatile char mGated;
+
+        // milliseconds each write takes
+        int mWriteDelay;
+
+        int mNumWrites;
+        long mNumBytes;
+
+
+    protected:
+        MutexLock mLock;
+        SimpleVector<char> mData;
+
+        BinarySemaphore mEntered;
+        BinarySemaphore mOpen;
+    };
+
+
+
+static void waitForSent( OutboundChannel *inChannel, int inCount ) {
+    double start = Time::getCurrentTime();
+
+    while( inChannel->getSentMessageCount() < inCount &&
+           Time::getCurrentTime() - start < 10 ) {
+        Thread::staticSleep( 1 );
+        }
+    }
+
+
+
+static HostAddress *makeHost() {
+    return new HostAddress( stringDuplicate( "127.0.0.1" ), 0 );
+    }
+
+
+
+static void checkOrderAndBatching( MessagePerSecondLimiter *inLimiter ) {
+    RecordingStream stream;
+    OutboundChannel channel( &stream, makeHost(), inLimiter, 50 );
+
+    stream.gate();
+    channel.sendMessage( (char *)"first" );
+    stream.waitAtGate();
+
+    channel.sendMessage( (char *)"a" );
+    channel.sendMessage( (char *)"H", 1 );
+    channel.sendMessage( (char *)"b" );
+
+    SharedMessage *shared = new SharedMessage( "c" );
+    channel.sendMessage( shared );
+    shared->release();
+
+    check( channel.getQueuedMessageCount() == 4, "queued while blocked" );
+
+    stream.open();
+    waitForSent( &channel, 5 );
+
+    char *record = stream.getRecord();
+    check( strcmp( record, "first|H|a|b|c|" ) == 0,
+           "high priority sent first, then in order" );
+    delete [] record;
+
+    check( stream.mNumWrites == 2,
+           "queued messages sent in one vectored write" );
+    check( channel.getSentMessageCount() == 5, "sent count" );
+    }
+
+
+
+static void checkDropOldest( MessagePerSecondLimiter *inLimiter ) {
+    RecordingStream stream;
+    OutboundChannel channel( &stream, makeHost(), inLimiter, 3 );
+
+    stream.gate();
+    channel.sendMessage( (char *)"first" );
+    stream.waitAtGate();
+
+    const char *messages[5] = { "1", "2", "3", "4", "5" };
+    for( int i=0; i<5; i++ ) {
+        channel.sendMessage( (char *)messages[i] );
+        }
+
+    check( channel.getDroppedMessageCount() == 2, "two dropped" );
+    check( channel.getQueuedMessageCount() == 3, "queue stays full" );
+
+    stream.open();
+    waitForSent( &channel, 4 );
+
+    char *record = stream.getRecord();
+    check( strcmp( record, "first|3|4|5|" ) == 0, "oldest dropped" );
+    delete [] record;
+    }
+
+
+
+static void checkLimited() {
+    // 50 ms of budget is 50 messages
+    MessagePerSecondLimiter limiter( 1000 );
+
+    RecordingStream stream;
+    OutboundChannel channel( &stream, makeHost(), &limiter, 50 );
+
+    stream.gate();
+    channel.sendMessage( (char *)"first" );
+    stream.waitAtGate();
+
+    channel.sendMessage( (char *)"a" );
+    channel.sendMessage( (char *)"b" );
+
+    stream.open();
+    waitForSent( &channel, 3 );
+
+    char *record = stream.getRecord();
+    check( strcmp( record, "first|a|b|" ) == 0, "limited channel order" );
+    delete [] record;
+
+    check( stream.mNumWrites == 2,
+           "limited channel sends queued messages in one write" );
+
+
+    // 10 messages of budget, so 100 take at least 0.45 sec
+    MessagePerSecondLimiter slowLimiter( 200 );
+
+    RecordingStream slowStream( false );
+    OutboundChannel slowChannel( &slowStream, makeHost(), &slowLimiter,
+                                 200 );
+
+    double start = Time::getCurrentTime();
+    for( int i=0; i<100; i++ ) {
+        slowChannel.sendMessage( (char *)"m" );
+        }
+    waitForSent( &slowChannel, 100 );
+    double seconds = Time::getCurrentTime() - start;
+
+    printf( "100 messages at 200 per second:  %.3f sec, %d writes\n",
+            seconds, slowStream.mNumWrites );
+
+    check( slowChannel.getSentMessageCount() == 100,
+           "limited channel sends everything" );
+    check( seconds >= 0.4, "limited channel keeps to its rate" );
+    check( slowStream.mNumWrites <= 25,
+           "limited channel batches up to its budget" );
+    }
+
+
+
+// messages sent while a slow write is in progress go out together
+static void checkCoalescing( MessagePerSecondLimiter *inLimiter ) {
+    RecordingStream stream( false );
+    stream.mWriteDelay = 2;
+
+    OutboundChannel channel( &stream, makeHost(), inLimiter, 1000 );
+
+    int numMessages = 500;
+
+    double start = Time::getCurrentTime();
+    for( int i=0; i<numMessages; i++ ) {
+        channel.sendMessage( (char *)"m" );
+        if( i % 50 == 49 ) {
+            // a burst every 5 ms
+            Thread::staticSleep( 5 );
+            }
+        }
+    waitForSent( &channel, numMessages );
+    double seconds = Time::getCurrentTime() - start;
+
+    double perWrite = (double)numMessages / stream.mNumWrites;
+
+    printf( "%d messages behind 2 ms writes:  %.3f sec, "
+            "%.2f messages per write\n",
+            numMessages, seconds, perWrite );
+
+    check( channel.getSentMessageCount() == numMessages,
+           "slow stream gets everything" );
+    check( perWrite >= 10, "messages behind a slow write coalesce" );
+    }
+
+
+
+static void checkBroken( MessagePerSecondLimiter *inLimiter ) {
+    RecordingStream stream( true, true );
+    OutboundChannel channel( &stream, makeHost(), inLimiter, 50 );
+
+    channel.sendMessage( (char *)"x" );
+
+    double start = Time::getCurrentTime();
+    char stillWorking = true;
+    while( stillWorking && Time::getCurrentTime() - start < 10 ) {
+        Thread::staticSleep( 1 );
+        stillWorking = channel.sendMessage( (char *)"y" );
+        }
+
+    check( ! stillWorking, "broken stream breaks channel" );
+    }
+
+
+
+// returns seconds until every channel has sent every message
+static double timeBroadcast( int inNumChannels, int inNumMessages,
+                             int inMessageBytes, char inShared,
+                             MessagePerSecondLimiter *inLimiter,
+                             int *outNumWrites ) {
+
+    RecordingStream **streams = new RecordingStream*[ inNumChannels ];
+    OutboundChannel **channels = new OutboundChannel*[ inNumChannels ];
+
+    for( int c=0; c<inNumChannels; c++ ) {
+        streams[c] = new RecordingStream( false );
+        channels[c] = new OutboundChannel( streams[c], makeHost(),
+                                           inLimiter, inNumMessages );
+        }
+
+    char *text = new char[ inMessageBytes + 1 ];
+    memset( text, 'm', inMessageBytes );
+    text[ inMessageBytes ] = '\0';
+
+    double start = Time::getCurrentTime();
+
+    for( int m=0; m<inNumMessages; m++ ) {
+        if( inShared ) {
+            SharedMessage *message = new SharedMessage( text );
+            for( int c=0; c<inNumChannels; c++ ) {
+                channels[c]->sendMessage( message );
+                }
+            message->release();
+            }
+        else {
+            for( int c=0; c<inNumChannels; c++ ) {
+                channels[c]->sendMessage( text );
+                }
+            }
+        }
+
+    for( int c=0; c<inNumChannels; c++ ) {
+        waitForSent( channels[c], inNumMessages );
+        }
+
+    double seconds = Time::getCurrentTime() - start;
+
+    char allSent = true;
+    *outNumWrites = 0;
+
+    for( int c=0; c<inNumChannels; c++ ) {
+        if( streams[c]->mNumBytes !=
+            (long)inNumMessages * inMessageBytes ) {
+            allSent = false;
+            }
+        *outNumWrites += streams[c]->mNumWrites;
+
+        delete channels[c];
+        delete streams[c];
+        }
+    check( allSent, "broadcast reached every channel" );
+
+    delete [] text;
+    delete [] channels;
+    delete [] streams;
+
+    return seconds;
+    }
+
+
+
+int main( int inNumArgs, char **inArgs ) {
+
+    int numChannels = 200;
+    int numMessages = 2000;
+    int messageBytes = 200;
+
+    if( inNumArgs > 1 ) {
+        numChannels = atoi( inArgs[1] );
+        }
+    if( inNumArgs > 2 ) {
+        numMessages = atoi( inArgs[2] );
+        }
+    if( inNumArgs > 3 ) {
+        messageBytes = atoi( inArgs[3] );
+        }
+
+    if( numChannels < 1 || numMessages < 1 || messageBytes < 1 ) {
+        printf( "Usage:  outboundChannelBench [channels] [messages] "
+                "[messageBytes]\n" );
+        return 1;
+        }
+
+
+    MessagePerSecondLimiter noLimit;
+
+    checkOrderAndBatching( &noLimit );
+    checkDropOldest( &noLimit );
+    checkLimited();
+    checkCoalescing( &noLimit );
+    checkBroken( &noLimit );
+
+    if( numFailed == 0 ) {
+        printf( "Order, batching, drop, limit, coalescing, and broken "
+                "stream checks passed\n\n" );
+        }
+
+
+    int copiedWrites, sharedWrites;
+
+    double copiedTime = timeBroadcast( numChannels, numMessages,
+                                       messageBytes, false, &noLimit,
+                                       &copiedWrites );
+    double sharedTime = timeBroadcast( numChannels, numMessages,
+                                       messageBytes, true, &noLimit,
+                                       &sharedWrites );
+
+    double totalMessages = (double)numChannels * numMessages;
+
+    printf( "%d messages of %d bytes broadcast to %d channels:\n",
+            numMessages, messageBytes, numChannels );
+    printf( "%-32s %9.2f ms  %6.2f messages per write\n",
+            "copied per channel", 1000 * copiedTime,
+            totalMessages / copiedWrites );
+    printf( "%-32s %9.2f ms  %6.2f messages per write\n",
+            "shared", 1000 * sharedTime,
+            totalMessages / sharedWrites );
+
+    if( numFailed > 0 ) {
+        printf( "\n%d checks FAILED\n", numFailed );
+        return 1;
+        }
+
+    printf( "\nAll checks passed\n" );
+    return 0;
+    }
@@ -0,0 +1,269 @@
+// Small-message send rate over loopback
+//
+// Usage:  socketSendBench [numMessages] [messageSize] [messagesPerFrame]
+//
+// Sends the same stream of small messages three ways:  non-blocking,
+// no-delay send calls on an ordinary socket (mode switched around every
+// call), the same calls on a socket in persistent non-blocking mode, and
+// queueSend with one flushSendQueue per "frame" of messages.  A receiver
+// thread checks every byte of each stream, and queueSend must refuse the
+// ordinary socket.
+//
+// The connection is opened with a non-blocking connect and completed
+// through a SocketPoll.
+
+
+#include "Socket.h"
+#include "SocketClient.h"
+#include "SocketServer.h"
+#include "SocketPoll.h"
+#include "HostAddress.h"
+
+#include "minorGems/system/Thread.h"
+#include "minorGems/system/Time.h"
+#include "minorGems/util/stringUtils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+
+
+#define BENCH_PORT 5077
+
+
+
+// stream byte at position inPosition
+static unsigned char streamByte( long inPosition ) {
+    return (unsigned char)( inPosition % 251 );
+    }
+
+
+
+class ReceiverThread : public Thread {
+
+    public:
+
+        ReceiverThread( Socket *inSock, long inNumBytes )
+            : mSock( inSock ), mNumBytes( inNumBytes ),
+              mNumReceived( 0 ), mNumBad( 0 ) {
+            }
+
+        virtual void run() {
+            unsigned char buffer[ 65536 ];
+
+            while( mNumReceived < mNumBytes ) {
+                int numRead = mSock->receive( buffer, sizeof( buffer ), 1000 );
+
+                if( numRead == -2 ) {
+                    continue;
+                    }
+                if( numRead <= 0 ) {
+                    printf( "Receive failed after %ld bytes\n",
+                            mNumReceived );
+                    return;
+                    }
+
+                for( int i=0; i<numRead; i++ ) {
+                    if( buffer[i] != streamByte( mNumReceived + i ) ) {
+                        mNumBad++;
+                        }
+                    }
+                mNumReceived += numRead;
+                }
+            }
+
+        Socket *mSock;
+        long mNumBytes;
+        long mNumReceived;
+        long mNumBad;
+    };
+
+
+
+// 0 = plain send, 1 = persistent send, 2 = queueSend with frame flushes
+static char runMode( int inMode, const char *inName,
+                     int inNumMessages, int inMessageSize,
+                     int inMessagesPerFrame ) {
+
+    SocketServer server( BENCH_PORT + inMode, 10 );
+
+    HostAddress address( stringDuplicate( "127.0.0.1" ),
+                         BENCH_PORT + inMode );
+
+    char timedOut;
+    Socket *sender = SocketClient::connectToServer( &address, 0, &timedOut );
+
+    if( sender == NULL ) {
+        printf( "Connect failed\n" );
+        return false;
+        }
+
+    Socket *receiver = server.acceptConnection( 5000 );
+
+    if( receiver == NULL ) {
+        printf( "Accept failed\n" );
+        delete sender;
+        return false;
+        }
+
+
+    // connection completion reported by the poller
+    SocketPoll poll;
+    poll.addSocket( sender );
+
+    while( sender->isConnectPending() ) {
+        poll.wait( 1000 );
+        }
+    poll.removeSocket( sender );
+
+    if( sender->isConnected() != 1 ) {
+        printf( "Connect failed\n" );
+        delete receiver;
+        delete sender;
+        return false;
+        }
+
+
+    if( inMode > 0 ) {
+        sender->setPersistentNonBlocking();
+        }
+    else {
+        // send would not stay behind queued bytes on an ordinary socket
+        unsigned char byte = 0;
+        if( sender->queueSend( &byte, 1 ) != -1 ) {
+            printf( "queueSend accepted on an ordinary socket\n" );
+            delete receiver;
+            delete sender;
+            return false;
+            }
+        }
+
+    long numBytes = (long)inNumMessages * inMessageSize;
+
+    ReceiverThread thread( receiver, numBytes );
+    thread.start();
+
+
+    unsigned char *message = new unsigned char[ inMessageSize ];
+    long position = 0;
+    long numCalls = 0;
+    char error = false;
+
+    double startTime = Time::getCurrentTime();
+
+    for( int m=0; m<inNumMessages && !error; m++ ) {
+        for( int i=0; i<inMessageSize; i++ ) {
+            message[i] = streamByte( position + i );
+            }
+        position += inMessageSize;
+
+        if( inMode == 2 ) {
+            int result = sender->queueSend( message, inMessageSize );
+
+            while( result == -2 ) {
+                // queue full, receiver is behind
+                sender->flushSendQueue();
+                Thread::staticSleep( 1 );
+                result = sender->queueSend( message, inMessageSize );
+                }
+            if( result == -1 ) {
+                error = true;
+                }
+
+            if( ( m + 1 ) % inMessagesPerFrame == 0 ) {
+                numCalls++;
+                if( sender->flushSendQueue() == -1 ) {
+                    error = true;
+                    }
+                }
+            }
+        else {
+            int numSent = 0;
+            while( numSent < inMessageSize && !error ) {
+                numCalls++;
+                int result = sender->send( &( message[ numSent ] ),
+                                           inMessageSize - numSent,
+                                           false, false );
+                if( result == -2 ) {
+                    Thread::staticSleep( 1 );
+                    }
+                else if( result < 0 ) {
+                    error = true;
+                    }
+                else {
+                    numSent += result;
+                    }
+                }
+            }
+        }
+
+    while( !error && sender->getNumQueuedBytes() > 0 ) {
+        numCalls++;
+        if( sender->flushSendQueue() == -1 ) {
+            error = true;
+            }
+        if( sender->getNumQueuedBytes() > 0 ) {
+            Thread::staticSleep( 1 );
+            }
+        }
+
+    double sendTime = Time::getCurrentTime() - startTime;
+
+    thread.join();
+
+    double totalTime = Time::getCurrentTime() - startTime;
+
+    char ok = !error &&
+        thread.mNumReceived == numBytes && thread.mNumBad == 0;
+
+    printf( "%-34s %8.0f msg/s sent, %8.0f msg/s received, "
+            "%8ld send calls  %s\n",
+            inName,
+            inNumMessages / ( sendTime > 0 ? sendTime : 0.001 ),
+            inNumMessages / ( totalTime > 0 ? totalTime : 0.001 ),
+            numCalls,
+            ok ? "ok" : "CORRUPT" );
+
+    delete [] message;
+    delete receiver;
+    delete sender;
+
+    return ok;
+    }
+
+
+
+int main( int inNumArgs, char **inArgs ) {
+
+    int numMessages = 200000;
+    int messageSize = 24;
+    int messagesPerFrame = 100;
+
+    if( inNumArgs > 1 ) {
+        numMessages = atoi( inArgs[1] );
+        }
+    if( inNumArgs > 2 ) {
+        messageSize = atoi( inArgs[2] );
+        }
+    if( inNumArgs > 3 ) {
+        messagesPerFrame = atoi( inArgs[3] );
+        }
+
+    printf( "%d messages of %d bytes, %d messages per frame\n\n",
+            numMessages, messageSize, messagesPerFrame );
+
+    int numBad = 0;
+
+    numBad += !runMode( 0, "send, mode switched per call",
+                        numMessages, messageSize, messagesPerFrame );
+    numBad += !runMode( 1, "send, persistent non-blocking",
+                        numMessages, messageSize, messagesPerFrame );
+    numBad += !runMode( 2, "queueSend, flushed once per frame",
+                        numMessages, messageSize, messagesPerFrame );
+
+    if( numBad != 0 ) {
+        printf( "FAILED\n" );
+        return 1;
+        }
+    return 0;
+    }
@@ -45,6 +45,9 @@
 #include "minorGems/util/log/AppLog.h"
 #include "minorGems/util/stringUtils.h"
 #include "minorGems/util/SimpleVector.h"
+#include "minorGems/system/Thread.h"
+#include "minorGems/system/Time.h"
+#include "minorGems/network/web/WebConnectionPool.h"
 
 
 
@@ -92,79 +95,52 @@ char *WebClient::getMimeType( char *inURL ) {
 
 
 
-char *WebClient::executeWebMethod( const char *inMethod,
-                                   char *inURL, 
-                                   char *inBody,
-                                   int *outContentLength,
-                                   char **outFinalURL,
-                                   char **outMimeType,
-                                   long inTimeoutInMilliseconds ) {
+// steps pool until request done
+// times out if no bytes arrive for inTimeoutInMilliseconds
+// returns 1 on success, -1 on error or timeout
+static int waitForRequest( WebConnectionPool *inPool, int inHandle,
+                           long inTimeoutInMilliseconds ) {
 
-    char *returnString = NULL;
-    
+    int lastProgress = 0;
+    double lastProgressTime = Time::getCurrentTime();
     
-    const char *startString = "http://";
+    while( true ) {
+        int result = inPool->step( inHandle );
 
-    char *urlCopy = stringDuplicate( inURL );
-
-    
-    char *urlStart = stringLocateIgnoreCase(  urlCopy, startString );
-
-    char *serverStart;
-    
-    if( urlStart == NULL ) {
-        // no http:// at start of URL
-        serverStart = urlCopy;
-        }
-    else {
-        serverStart = &( urlStart[ strlen( startString ) ] );
-        }
-    
-    // find the first occurrence of "/", which is the end of the
-    // server name
-
-    char *serverNameCopy = stringDuplicate( serverStart );
-        
-    char *serverEnd = strstr( serverNameCopy, "/" );
+        if( result != 0 ) {
+            return result;
+            }
 
-    const char *getPath = strstr( serverStart, "/" );
+        int progress = inPool->getProgressSize( inHandle );
+        double now = Time::getCurrentTime();
 
-        
-    if( serverEnd == NULL ) {
-        serverEnd = &( serverStart[ strlen( serverStart ) ] );
-        getPath = "/";
+        if( progress != lastProgress ) {
+            lastProgress = progress;
+            lastProgressTime = now;
+            }
+        else if( inTimeoutInMilliseconds >= 0 &&
+                 ( now - lastProgressTime ) * 1000 >
+                 inTimeoutInMilliseconds ) {
+            return -1;
+            }
+        else {
+            // nothing new, don't spin
+            Thread::staticSleep( 1 );
+            }
         }
-    // terminate the url here to extract the server name
-    serverEnd[0] = '\0';
-
-    int portNumber = 80;
+    }
 
-        // look for a port number
-    char *colon = strstr( serverNameCopy, ":" );
-    if( colon != NULL ) {
-        char *portNumberString = &( colon[1] );
-                
-        int numRead = sscanf( portNumberString, "%d",
-                              & portNumber );
-        if( numRead != 1 ) {
-            portNumber = 80;
-            }
 
-        // terminate the name here so port isn't taken as part
-        // of the address
-        colon[0] = '\0';
-        }
 
-    HostAddress *host = new HostAddress(
-        stringDuplicate( serverNameCopy ),
-        portNumber );
+char *WebClient::executeWebMethod( const char *inMethod,
+                                   char *inURL, 
+                                   char *inBody,
+                                   int *outContentLength,
+                                   char **outFinalURL,
+                                   char **outMimeType,
+                                   long inTimeoutInMilliseconds ) {
 
-    // will be set to true if we time out while connecting
-    char timedOut;
-    
-    Socket *sock = SocketClient::connectToServer( host,
-                                                  inTimeoutInMilliseconds,
-                                                  &timedOut );
+    char *returnString = NULL;
 
     char *finalURL = stringDuplicate( inURL );
     char *mimeType = NULL;
@@ -172,172 +148,67 @@ char *WebClient::executeWebMethod( const char *inMethod,
     int receivedLength = 0;
 
     
-    if( sock != NULL ) {
-        SocketStream *stream = new SocketStream( sock );
+    WebConnectionPool *pool = WebConnectionPool::getSharedPool();
 
-        // reuse the same timeout for read operations
-        stream->setReadTimeout( inTimeoutInMilliseconds );
-        
-        // method and trailing space need to be sent in the same
-        // buffer to work around a bug in certain web servers
-        char *methodWithSpace = new char[ strlen( inMethod ) + 2 ];
-        sprintf( methodWithSpace, "%s ", inMethod );
-        
-        // send the request
-        stream->writeString( methodWithSpace );
-        stream->writeString( getPath );
-        stream->writeString( " HTTP/1.0\r\n" );
-        stream->writeString( "Host: " );
-        stream->writeString( serverNameCopy );
-        stream->writeString( "\r\n" );
-        
-        if( inBody != NULL ) {
-            char *lengthString = autoSprintf( "Content-Length: %d\r\n",
-                                              strlen( inBody ) );
-            stream->writeString( lengthString );
-            delete [] lengthString;
-            stream->writeString(
-                "Content-Type: application/x-www-form-urlencoded\r\n\r\n" );
-            
-            stream->writeString( inBody );
-            }
-        else {
-            stream->writeString( "\r\n" );
-            }
-        
+    int handle = pool->startRequest( inMethod, inURL, inBody );
+    
+    if( waitForRequest( pool, handle, inTimeoutInMilliseconds ) == 1 ) {
         
+        int statusCode = pool->getStatusCode( handle );
 
-        delete [] methodWithSpace;
-
-        // the simplest thing to do is to read upto the
-        // socket close first, then extract the content
+        char handled = false;
         
-        char *received = receiveData( stream, &receivedLength );
-
-        char *content = NULL;
-
-        char notFound = false;
-
-        if( stringLocateIgnoreCase( received, "404 Not Found" ) != NULL ) {
-            notFound = true;            
+        if( statusCode == 404 ) {
+            handled = true;
             }
-        
-        // watch for redirection headers
-        if( stringLocateIgnoreCase( received, "302 Found" ) != NULL ||
-            stringLocateIgnoreCase( received,
-                                    "301 Moved Permanently" ) != NULL ||
-            stringLocateIgnoreCase( received,
-                                    "302 Object Moved" ) != NULL ) {
-
+        else if( statusCode == 301 || statusCode == 302 ) {
             // call ourself recursively to fetch the redirection
-            const char *locationTag = "Location: ";
-            char *locationTagStart =
-                stringLocateIgnoreCase( received, locationTag );
-
-            if( locationTagStart != NULL ) {
-
-                char *locationStart =
-                    &( locationTagStart[ strlen( locationTag ) ] );
-
-                // replace next \r with \0
-                char *nextChar = locationStart;
-                while( nextChar[0] != '\r' && nextChar[0] != '\0' ) {
-                    nextChar = &( nextChar[1] );
-                    }
-                nextChar[0] = '\0';
+            char *location = pool->getResponseHeader( handle, "Location" );
 
+            if( location != NULL ) {
+                handled = true;
+                
                 char *newFinalURL;
                 
-                content = getWebPage( locationStart, &receivedLength,
-                                      &newFinalURL,
-                                      &mimeType );
+                returnString = getWebPage( location, &receivedLength,
+                                           &newFinalURL,
+                                           &mimeType,
+                                           inTimeoutInMilliseconds );
                 delete [] finalURL;
                 finalURL = newFinalURL;
 
-                if( content == NULL ) {
-                    // not found recursively
-                    notFound = true;
-                    }
-                }                        
-            }
-
-        const char *contentStartString = "\r\n\r\n";
-        const char *contentTypeStartString = "Content-type:";
-
-        if( notFound ) {
-            returnString = NULL;
+                delete [] location;
+                }
             }
-        else {
-            if( content == NULL ) {
-
-                // scan for content type
-                char *contentTypeStartMarker =
-                    stringLocateIgnoreCase( received, contentTypeStartString );
 
-                if( contentTypeStartMarker != NULL ) {
-                    // skip marker
-                    char *contentTypeStart =
-                        &( contentTypeStartMarker[
-                            strlen( contentTypeStartString ) ] );
+        if( ! handled ) {
+            char *contentType = 
+                pool->getResponseHeader( handle, "Content-Type" );
 
-                    // extract content type
-                    // make sure the buffer is big enough
-                    char *contentType =
-                        new char[ strlen( contentTypeStartMarker ) ];
-
-                    int numRead = sscanf( contentTypeStart, "%s", contentType );
+            if( contentType != NULL ) {
+                // only the type, not any parameters after it
+                char *typeOnly = new char[ strlen( contentType ) + 1 ];
+                
+                int numRead = sscanf( contentType, "%s", typeOnly );
 
-                    if( numRead == 1 ) {
-                        // trim
-                        mimeType = stringDuplicate( contentType );
+                if( numRead == 1 ) {
+                    char *parameterStart = strstr( typeOnly, ";" );
+                    if( parameterStart != NULL ) {
+                        parameterStart[0] = '\0';
                         }
-                    delete [] contentType;
-                    }
-
-                // extract the content from what we've received
-                char *contentStart = strstr( received, contentStartString );
-            
-                if( contentStart != NULL ) {
-                    content =
-                        &( contentStart[ strlen( contentStartString ) ] );
-
-
-                    receivedLength =
-                        receivedLength
-                        - strlen( contentStartString )
-                        - ( (int)contentStart - (int)received );
-
-                    returnString = new char[ receivedLength + 1 ];
-                    returnString = (char*)memcpy( returnString,
-                                                  content, receivedLength );
-
-                    returnString[ receivedLength ] = '\0';
+                    mimeType = stringDuplicate( typeOnly );
                     }
+                delete [] typeOnly;
+                delete [] contentType;
                 }
-            else {
-                // we already obtained our content recursively
-                returnString = new char[ receivedLength + 1 ];
-                returnString = (char*)memcpy( returnString,
-                                              content, receivedLength );
-                
-                returnString[ receivedLength ] = '\0';
 
-                delete [] content;
-                }
+            // \0-terminated by pool
+            returnString = 
+                (char *)pool->getResult( handle, &receivedLength );
             }
-        
-        delete [] received;
-                               
-        delete stream;
-        delete sock;
         }
 
-    delete host;
-
-        
-    delete [] serverNameCopy;
-
-    delete [] urlCopy;
+    pool->clearRequest( handle );
 
 
     if( outFinalURL != NULL ) {
@@ -382,22 +253,14 @@ char *WebClient::receiveData( SocketStream *inSocketStream,
             }
 
         if( numRead > 0 ) {
-            for( int i=0; i<numRead; i++ ) {
-                receivedVector->push_back( buffer[i] );
-                }
+            receivedVector->appendArray( (char *)buffer, numRead );
             }
         }
 
     delete [] buffer;
 
-    // copy our vector into an array
     int receivedSize = receivedVector->size();
-    char *received = new char[ receivedSize + 1 ];
-        
-    for( int i=0; i<receivedSize; i++ ) {
-        received[i] = *( receivedVector->getElement( i ) );
-        }
-    received[ receivedSize ] = '\0';
+    char *received = receivedVector->getElementString();
                 
     delete receivedVector;
 
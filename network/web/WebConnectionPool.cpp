@@ -0,0 +1,1357 @@
+#include "WebConnectionPool.h"
+
+#include "minorGems/network/SocketClient.h"
+#include "minorGems/system/Time.h"
+#include "minorGems/util/stringUtils.h"
+#include "minorGems/util/StringBufferOutputStream.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+
+
+// request states
+// waiting in host queue for a connection
+#define WEB_PENDING 0
+// on a connection, response not complete
+#define WEB_SENT 1
+#define WEB_DONE 2
+#define WEB_ERROR 3
+
+
+// response parser states
+#define PARSE_HEADERS 0
+#define PARSE_LENGTH 1
+#define PARSE_CHUNK_SIZE 2
+#define PARSE_CHUNK_DATA 3
+#define PARSE_CHUNK_DATA_END 4
+#define PARSE_TRAILER 5
+#define PARSE_UNTIL_CLOSE 6
+
+
+// longest header block or chunk line we accept
+#define MAX_HEADER_BYTES 65536
+
+#define RECEIVE_BUFFER_START_SIZE 16384
+
+// a connection stops reading while its current request has this many body
+// bytes waiting for takeBody
+#define MAX_UNTAKEN_BODY_BYTES ( 1024 * 1024 )
+
+
+
+struct WebPoolHost {
+        // where we connect, proxy if one is used
+        char *name;
+        int port;
+
+        // NULL until looked up, or after a connection to it failed
+        HostAddress *numericalAddress;
+        LookupThread *lookupThread;
+
+        SimpleVector<WebPoolConnection *> connections;
+
+        // waiting for a connection, in request order
+        SimpleVector<WebPoolRequest *> pending;
+    };
+
+
+
+struct WebPoolConnection {
+        WebPoolHost *host;
+
+        Socket *sock;
+        char connected;
+
+        // server closes after current response, send nothing more
+        char closeAfter;
+
+        int numServed;
+        double lastUsedTime;
+
+        // requests owed a response, oldest first
+        SimpleVector<WebPoolRequest *> pipeline;
+
+        // requests at start of pipeline that are fully sent
+        int numSent;
+        // bytes sent of the next one
+        int sendOffset;
+
+        // received bytes not yet parsed are from recvStart to recvEnd
+        unsigned char *recv;
+        int recvStart;
+        int recvEnd;
+        int recvSize;
+
+        int parseState;
+        // body or chunk bytes still expected
+        long remaining;
+    };
+
+
+
+WebConnectionPool *WebConnectionPool::sSharedPool = NULL;
+MutexLock WebConnectionPool::sSharedPoolLock;
+
+
+
+WebConnectionPool::WebConnectionPool( int inMaxConnectionsPerHost,
+                                      int inMaxPipelineDepth,
+                                      double inIdleTimeoutSeconds )
+        : mMaxConnectionsPerHost( inMaxConnectionsPerHost ),
+          mMaxPipelineDepth( inMaxPipelineDepth ),
+          mIdleTimeoutSeconds( inIdleTimeoutSeconds ),
+          mFirstHandle( 0 ), mNextHandle( 0 ),
+          mNumConnectionsOpened( 0 ),
+          mNumRequestsCompleted( 0 ) {
+
+    if( mMaxConnectionsPerHost < 1 ) {
+        mMaxConnectionsPerHost = 1;
+        }
+    if( mMaxPipelineDepth < 1 ) {
+        mMaxPipelineDepth = 1;
+        }
+    }
+
+
+
+WebConnectionPool::~WebConnectionPool() {
+    for( int h=0; h<mHosts.size(); h++ ) {
+        WebPoolHost *host = mHosts.getElementDirect( h );
+
+        for( int c=0; c<host->connections.size(); c++ ) {
+            WebPoolConnection *connection =
+                host->connections.getElementDirect( c );
+
+            // live requests are freed below, through the handle table
+            for( int i=0; i<connection->pipeline.size(); i++ ) {
+                WebPoolRequest *r = connection->pipeline.getElementDirect( i );
+                if( r->cancelled ) {
+                    freeRequest( r );
+                    }
+                }
+
+            delete connection->sock;
+            delete [] connection->recv;
+            delete connection;
+            }
+
+        if( host->lookupThread != NULL ) {
+            // this might block
+            delete host->lookupThread;
+            }
+        if( host->numericalAddress != NULL ) {
+            delete host->numericalAddress;
+            }
+
+        delete [] host->name;
+        delete host;
+        }
+    mHosts.deleteAll();
+
+    for( int i=0; i<mRequests.size(); i++ ) {
+        WebPoolRequest *r = mRequests.getElementDirect( i );
+
+        if( r != NULL ) {
+            freeRequest( r );
+            }
+        }
+    mRequests.deleteAll();
+    }
+
+
+
+WebConnectionPool *WebConnectionPool::getSharedPool() {
+    sSharedPoolLock.lock();
+
+    if( sSharedPool == NULL ) {
+        sSharedPool = new WebConnectionPool();
+        }
+    WebConnectionPool *pool = sSharedPool;
+
+    sSharedPoolLock.unlock();
+
+    return pool;
+    }
+
+
+
+void WebConnectionPool::freeSharedPool() {
+    sSharedPoolLock.lock();
+
+    if( sSharedPool != NULL ) {
+        delete sSharedPool;
+        sSharedPool = NULL;
+        }
+
+    sSharedPoolLock.unlock();
+    }
+
+
+
+void WebConnectionPool::freeRequest( WebPoolRequest *inRequest ) {
+    delete [] inRequest->requestText;
+    delete [] inRequest->url;
+
+    if( inRequest->headers != NULL ) {
+        delete [] inRequest->headers;
+        }
+    delete inRequest->body;
+
+    delete inRequest;
+    }
+
+
+
+WebPoolRequest *WebConnectionPool::getRequest( int inHandle ) {
+    int index = inHandle - mFirstHandle;
+
+    if( index < 0 || index >= mRequests.size() ) {
+        return NULL;
+        }
+
+    return mRequests.getElementDirect( index );
+    }
+
+
+
+void WebConnectionPool::forgetRequest( int inHandle ) {
+    int index = inHandle - mFirstHandle;
+
+    *( mRequests.getElement( index ) ) = NULL;
+
+    int numFreed = 0;
+    while( numFreed < mRequests.size() &&
+           mRequests.getElementDirect( numFreed ) == NULL ) {
+        numFreed++;
+        }
+
+    if( numFreed > 0 ) {
+        mRequests.deleteStartElements( numFreed );
+        mFirstHandle += numFreed;
+        }
+    }
+
+
+
+WebPoolHost *WebConnectionPool::getHost( const char *inName, int inPort ) {
+    for( int i=0; i<mHosts.size(); i++ ) {
+        WebPoolHost *host = mHosts.getElementDirect( i );
+
+        if( host->port == inPort &&
+            strcasecmp( host->name, inName ) == 0 ) {
+            return host;
+            }
+        }
+
+    WebPoolHost *host = new WebPoolHost;
+
+    host->name = stringDuplicate( inName );
+    host->port = inPort;
+    host->numericalAddress = NULL;
+    host->lookupThread = NULL;
+
+    mHosts.push_back( host );
+
+    return host;
+    }
+
+
+
+int WebConnectionPool::startRequest( const char *inMethod, const char *inURL,
+                                     const char *inBody,
+                                     const char *inProxy ) {
+
+    const char *startString = "http://";
+
+    char *urlCopy = stringDuplicate( inURL );
+
+    char *urlStart = stringLocateIgnoreCase( urlCopy, startString );
+
+    char *serverStart;
+
+    if( urlStart == NULL ) {
+        // no http:// at start of URL
+        serverStart = urlCopy;
+        }
+    else {
+        serverStart = &( urlStart[ strlen( startString ) ] );
+        }
+
+
+    const char *target;
+
+    if( inProxy != NULL ) {
+        // for proxy, pass entire URL as method target
+        target = inURL;
+        }
+    else {
+        // for direct connection, pass only file sub-path from URL
+        target = strstr( serverStart, "/" );
+        }
+
+    // host name and port, as sent in Host header
+    char *requestHostName = stringDuplicate( serverStart );
+
+    char *hostNameEnd = strstr( requestHostName, "/" );
+    if( hostNameEnd == NULL ) {
+        hostNameEnd = &( requestHostName[ strlen( requestHostName ) ] );
+
+        if( inProxy == NULL ) {
+            target = "/";
+            }
+        }
+    hostNameEnd[0] = '\0';
+
+
+    char *serverName;
+
+    if( inProxy != NULL ) {
+        serverName = stringDuplicate( inProxy );
+        }
+    else {
+        serverName = stringDuplicate( requestHostName );
+        }
+
+    int portNumber = 80;
+
+    // look for a port number
+    char *colon = strstr( serverName, ":" );
+    if( colon != NULL ) {
+        int numRead = sscanf( &( colon[1] ), "%d", &portNumber );
+        if( numRead != 1 ) {
+            portNumber = 80;
+            }
+
+        // terminate the name here so port isn't taken as part
+        // of the address
+        colon[0] = '\0';
+        }
+
+
+    char isHead = ( strcmp( inMethod, "HEAD" ) == 0 );
+    char idempotent = isHead || ( strcmp( inMethod, "GET" ) == 0 );
+
+
+    // compose the request into a buffered stream
+    StringBufferOutputStream tempStream;
+
+    tempStream.writeString( inMethod );
+    tempStream.writeString( " " );
+    tempStream.writeString( target );
+    tempStream.writeString( " HTTP/1.1\r\n" );
+    tempStream.writeString( "Host: " );
+    tempStream.writeString( requestHostName );
+    tempStream.writeString( "\r\n" );
+
+    if( inBody != NULL ) {
+        char *lengthString = autoSprintf( "Content-Length: %d\r\n",
+                                          (int)strlen( inBody ) );
+        tempStream.writeString( lengthString );
+        delete [] lengthString;
+        tempStream.writeString(
+            "Content-Type: application/x-www-form-urlencoded\r\n\r\n" );
+
+        tempStream.writeString( inBody );
+        }
+    else {
+        if( ! idempotent ) {
+            // HTTP/1.1 servers wait for a body unless told there is none
+            tempStream.writeString( "Content-Length: 0\r\n" );
+            }
+        tempStream.writeString( "\r\n" );
+        }
+
+
+    WebPoolRequest *r = new WebPoolRequest;
+
+    r->requestText = tempStream.getString();
+    r->requestLength = strlen( r->requestText );
+    r->url = stringDuplicate( inURL );
+    r->idempotent = idempotent;
+    r->isHead = isHead;
+    r->state = WEB_PENDING;
+    r->cancelled = false;
+    r->numRetries = 0;
+    r->pipelined = false;
+    r->progressSize = 0;
+    r->statusCode = -1;
+    r->headers = NULL;
+    r->body = new SimpleVector<unsigned char>();
+    r->bodyStart = 0;
+    r->taking = false;
+
+
+    mLock.lock();
+
+    r->host = getHost( serverName, portNumber );
+    r->host->pending.push_back( r );
+
+    r->handle = mNextHandle;
+    mNextHandle ++;
+
+    if( mRequests.size() == 0 ) {
+        // keep table starting at first live handle
+        mFirstHandle = r->handle;
+        }
+    mRequests.push_back( r );
+
+    int handle = r->handle;
+
+    mLock.unlock();
+
+
+    delete [] serverName;
+    delete [] requestHostName;
+    delete [] urlCopy;
+
+    return handle;
+    }
+
+
+
+int WebConnectionPool::step( int inHandle ) {
+    mLock.lock();
+
+    double now = Time::getCurrentTime();
+
+    for( int i=0; i<mHosts.size(); i++ ) {
+        stepHost( mHosts.getElementDirect( i ), now );
+        }
+
+    WebPoolRequest *r = getRequest( inHandle );
+
+    int result = -1;
+
+    if( r != NULL ) {
+        if( r->state == WEB_DONE ) {
+            result = 1;
+            }
+        else if( r->state != WEB_ERROR ) {
+            result = 0;
+            }
+        }
+
+    mLock.unlock();
+
+    return result;
+    }
+
+
+
+void WebConnectionPool::stepAll() {
+    mLock.lock();
+
+    double now = Time::getCurrentTime();
+
+    for( int i=0; i<mHosts.size(); i++ ) {
+        stepHost( mHosts.getElementDirect( i ), now );
+        }
+
+    mLock.unlock();
+    }
+
+
+
+int WebConnectionPool::getProgressSize( int inHandle ) {
+    mLock.lock();
+
+    WebPoolRequest *r = getRequest( inHandle );
+
+    int size = 0;
+    if( r != NULL ) {
+        size = r->progressSize;
+        }
+
+    mLock.unlock();
+
+    return size;
+    }
+
+
+
+int WebConnectionPool::getStatusCode( int inHandle ) {
+    mLock.lock();
+
+    WebPoolRequest *r = getRequest( inHandle );
+
+    int code = -1;
+    if( r != NULL && r->state == WEB_DONE ) {
+        code = r->statusCode;
+        }
+
+    mLock.unlock();
+
+    return code;
+    }
+
+
+
+// finds a header in a block of \r\n-terminated lines
+// returns trimmed value, or NULL
+static char *findHeader( const char *inHeaders, const char *inName ) {
+    int nameLength = strlen( inName );
+
+    const char *line = inHeaders;
+
+    while( line != NULL && line[0] != '\0' ) {
+        const char *lineEnd = strstr( line, "\r\n" );
+        if( lineEnd == NULL ) {
+            lineEnd = &( line[ strlen( line ) ] );
+            }
+
+        if( lineEnd - line > nameLength &&
+            line[ nameLength ] == ':' &&
+            strncasecmp( line, inName, nameLength ) == 0 ) {
+
+            const char *valueStart = &( line[ nameLength + 1 ] );
+            while( valueStart < lineEnd &&
+                   ( valueStart[0] == ' ' || valueStart[0] == '\t' ) ) {
+                valueStart++;
+                }
+
+            const char *valueEnd = lineEnd;
+            while( valueEnd > valueStart &&
+                   ( valueEnd[-1] == ' ' || valueEnd[-1] == '\t' ) ) {
+                valueEnd--;
+                }
+
+            int valueLength = valueEnd - valueStart;
+
+            char *value = new char[ valueLength + 1 ];
+            memcpy( value, valueStart, valueLength );
+            value[ valueLength ] = '\0';
+
+            return value;
+            }
+
+        if( lineEnd[0] == '\0' ) {
+            return NULL;
+            }
+        line = &( lineEnd[2] );
+        }
+
+    return NULL;
+    }
+
+
+
+// true if header is present and lists inToken
+static char headerHasToken( const char *inHeaders, const char *inName,
+                            const char *inToken ) {
+    char *value = findHeader( inHeaders, inName );
+
+    if( value == NULL ) {
+        return false;
+        }
+
+    char found = ( stringLocateIgnoreCase( value, inToken ) != NULL );
+
+    delete [] value;
+
+    return found;
+    }
+
+
+
+char *WebConnectionPool::getResponseHeader( int inHandle,
+                                            const char *inName ) {
+    mLock.lock();
+
+    WebPoolRequest *r = getRequest( inHandle );
+
+    char *value = NULL;
+    if( r != NULL && r->state == WEB_DONE && r->headers != NULL ) {
+        value = findHeader( r->headers, inName );
+        }
+
+    mLock.unlock();
+
+    return value;
+    }
+
+
+
+unsigned char *WebConnectionPool::getResult( int inHandle, int *outSize ) {
+    mLock.lock();
+
+    WebPoolRequest *r = getRequest( inHandle );
+
+    unsigned char *result = NULL;
+
+    if( r != NULL && r->state == WEB_DONE ) {
+        int size = r->body->size() - r->bodyStart;
+
+        result = new unsigned char[ size + 1 ];
+        if( size > 0 ) {
+            memcpy( result, r->body->getElement( r->bodyStart ), size );
+            }
+        result[ size ] = '\0';
+
+        *outSize = size;
+        }
+
+    mLock.unlock();
+
+    return result;
+    }
+
+
+
+int WebConnectionPool::takeBody( int inHandle, unsigned char *outBuffer,
+                                 int inMaxBytes ) {
+    mLock.lock();
+
+    WebPoolRequest *r = getRequest( inHandle );
+
+    int numTaken = 0;
+
+    if( r != NULL ) {
+        r->taking = true;
+        }
+
+    if( r != NULL && r->statusCode >= 200 && r->statusCode < 300 ) {
+        numTaken = r->body->size() - r->bodyStart;
+
+        if( numTaken > inMaxBytes ) {
+            numTaken = inMaxBytes;
+            }
+        if( numTaken > 0 ) {
+            memcpy( outBuffer, r->body->getElement( r->bodyStart ),
+                    numTaken );
+            r->bodyStart += numTaken;
+            }
+
+        if( r->bodyStart > r->body->size() / 2 ) {
+            // drop taken bytes once they are most of the body, so each
+            // byte is moved at most once on average
+            r->body->deleteStartElements( r->bodyStart );
+            r->bodyStart = 0;
+            }
+        }
+
+    mLock.unlock();
+
+    return numTaken;
+    }
+
+
+
+void WebConnectionPool::clearRequest( int inHandle ) {
+    mLock.lock();
+
+    WebPoolRequest *r = getRequest( inHandle );
+
+    if( r != NULL ) {
+        forgetRequest( inHandle );
+
+        if( r->state == WEB_PENDING ) {
+            r->host->pending.deleteElementEqualTo( r );
+            freeRequest( r );
+            }
+        else if( r->state == WEB_SENT ) {
+            // freed once its response is read, or its connection closes
+            r->cancelled = true;
+            }
+        else {
+            freeRequest( r );
+            }
+        }
+
+    mLock.unlock();
+    }
+
+
+
+int WebConnectionPool::getNumConnectionsOpened() {
+    mLock.lock();
+    int num = mNumConnectionsOpened;
+    mLock.unlock();
+    return num;
+    }
+
+
+
+int WebConnectionPool::getNumRequestsCompleted() {
+    mLock.lock();
+    int num = mNumRequestsCompleted;
+    mLock.unlock();
+    return num;
+    }
+
+
+
+int WebConnectionPool::getNumOpenConnections() {
+    mLock.lock();
+
+    int num = 0;
+    for( int i=0; i<mHosts.size(); i++ ) {
+        num += mHosts.getElementDirect( i )->connections.size();
+        }
+
+    mLock.unlock();
+    return num;
+    }
+
+
+
+void WebConnectionPool::failRequest( WebPoolRequest *inRequest ) {
+    if( inRequest->cancelled ) {
+        freeRequest( inRequest );
+        return;
+        }
+
+    printf( "Error:  WebConnectionPool request failed for URL:  %s\n",
+            inRequest->url );
+
+    inRequest->state = WEB_ERROR;
+    }
+
+
+
+void WebConnectionPool::stepHost( WebPoolHost *inHost, double inNow ) {
+
+    if( inHost->lookupThread != NULL &&
+        inHost->lookupThread->isLookupDone() ) {
+
+        inHost->numericalAddress = inHost->lookupThread->getResult();
+
+        delete inHost->lookupThread;
+        inHost->lookupThread = NULL;
+
+        if( inHost->numericalAddress == NULL ) {
+            printf( "Error:  "
+                    "WebConnectionPool failed to lookup %s\n",
+                    inHost->name );
+
+            for( int i=0; i<inHost->pending.size(); i++ ) {
+                failRequest( inHost->pending.getElementDirect( i ) );
+                }
+            inHost->pending.deleteAll();
+            }
+        }
+
+    assignPending( inHost, inNow );
+
+
+    // walk backwards, since closing removes connections
+    for( int c=inHost->connections.size() - 1; c>=0; c-- ) {
+        WebPoolConnection *connection =
+            inHost->connections.getElementDirect( c );
+
+        if( ! stepConnection( connection, inNow ) ) {
+            closeConnection( connection );
+            }
+        else if( connection->pipeline.size() == 0 &&
+                 inNow - connection->lastUsedTime > mIdleTimeoutSeconds ) {
+            closeConnection( connection );
+            }
+        }
+    }
+
+
+
+void WebConnectionPool::assignPending( WebPoolHost *inHost, double inNow ) {
+
+    while( inHost->pending.size() > 0 ) {
+        WebPoolRequest *r = inHost->pending.getElementDirect( 0 );
+
+        WebPoolConnection *chosen = NULL;
+
+        // an idle connection first
+        for( int c=0; c<inHost->connections.size(); c++ ) {
+            WebPoolConnection *connection =
+                inHost->connections.getElementDirect( c );
+
+            if( ! connection->closeAfter &&
+                connection->pipeline.size() == 0 ) {
+                chosen = connection;
+                break;
+                }
+            }
+
+        // then a new connection
+        if( chosen == NULL &&
+            inHost->connections.size() < mMaxConnectionsPerHost ) {
+
+            if( inHost->numericalAddress == NULL ) {
+                if( inHost->lookupThread == NULL ) {
+                    HostAddress address( stringDuplicate( inHost->name ),
+                                         inHost->port );
+                    inHost->lookupThread = new LookupThread( &address );
+                    }
+                // wait for lookup
+                return;
+                }
+
+            chosen = openConnection( inHost );
+
+            if( chosen == NULL ) {
+                inHost->pending.deleteElement( 0 );
+                failRequest( r );
+                continue;
+                }
+            }
+
+        // then pipelined behind the shortest line, only on connections
+        // that have shown they stay open, and only behind requests
+        // that are safe to send again
+        if( chosen == NULL && r->idempotent ) {
+            for( int c=0; c<inHost->connections.size(); c++ ) {
+                WebPoolConnection *connection =
+                    inHost->connections.getElementDirect( c );
+
+                int depth = connection->pipeline.size();
+
+                if( connection->closeAfter ||
+                    connection->numServed == 0 ||
+                    depth >= mMaxPipelineDepth ||
+                    ( chosen != NULL &&
+                      depth >= chosen->pipeline.size() ) ) {
+                    continue;
+                    }
+
+                char allIdempotent = true;
+                for( int i=0; i<depth; i++ ) {
+                    if( ! connection->pipeline.getElementDirect( i )->
+                        idempotent ) {
+                        allIdempotent = false;
+                        break;
+                        }
+                    }
+
+                if( allIdempotent ) {
+                    chosen = connection;
+                    }
+                }
+            }
+
+        if( chosen == NULL ) {
+            // wait in order for a free connection
+            return;
+            }
+
+        inHost->pending.deleteElement( 0 );
+
+        r->state = WEB_SENT;
+        r->pipelined = ( chosen->pipeline.size() > 0 );
+        chosen->pipeline.push_back( r );
+        chosen->lastUsedTime = inNow;
+        }
+    }
+
+
+
+WebPoolConnection *WebConnectionPool::openConnection( WebPoolHost *inHost ) {
+    // use timeout of 0 for non-blocking
+    char timedOut;
+
+    Socket *sock = SocketClient::connectToServer( inHost->numericalAddress,
+                                                  0, &timedOut );
+
+    if( sock == NULL ) {
+        printf( "Error:  "
+                "WebConnectionPool failed to construct socket to %s:%d\n",
+                inHost->numericalAddress->mAddressString,
+                inHost->numericalAddress->mPort );
+        return NULL;
+        }
+
+    mNumConnectionsOpened ++;
+
+    WebPoolConnection *connection = new WebPoolConnection;
+
+    connection->host = inHost;
+    connection->sock = sock;
+    connection->connected = false;
+    connection->closeAfter = false;
+    connection->numServed = 0;
+    connection->lastUsedTime = Time::getCurrentTime();
+    connection->numSent = 0;
+    connection->sendOffset = 0;
+    connection->recvSize = RECEIVE_BUFFER_START_SIZE;
+    connection->recv = new unsigned char[ connection->recvSize ];
+    connection->recvStart = 0;
+    connection->recvEnd = 0;
+    connection->parseState = PARSE_HEADERS;
+    connection->remaining = 0;
+
+    inHost->connections.push_back( connection );
+
+    return connection;
+    }
+
+
+
+char WebConnectionPool::stepConnection( WebPoolConnection *inConnection,
+                                        double inNow ) {
+    WebPoolConnection *c = inConnection;
+
+    if( ! c->connected ) {
+        int connectStatus = c->sock->isConnected();
+
+        if( connectStatus == 0 ) {
+            // still trying to connect
+            return true;
+            }
+        else if( connectStatus < 0 ) {
+            printf( "Error:  "
+                    "WebConnectionPool failed to connect to %s:%d\n",
+                    c->host->name, c->host->port );
+
+            // maybe the address changed, look it up again next time
+            if( c->host->numericalAddress != NULL ) {
+                delete c->host->numericalAddress;
+                c->host->numericalAddress = NULL;
+                }
+            return false;
+            }
+
+        c->connected = true;
+
+        // one system call per send and receive from here on
+        c->sock->setPersistentNonBlocking();
+        }
+
+
+    if( ! sendRequests( c ) ) {
+        return false;
+        }
+
+
+    char closed = false;
+
+    while( true ) {
+        if( c->pipeline.size() > 0 ) {
+            WebPoolRequest *r = c->pipeline.getElementDirect( 0 );
+
+            if( r->taking && ! r->cancelled &&
+                r->body->size() - r->bodyStart + c->recvEnd - c->recvStart
+                > MAX_UNTAKEN_BODY_BYTES ) {
+                // leave the rest in the socket until some is taken
+                break;
+                }
+            }
+
+        if( c->recvEnd == c->recvSize ) {
+            // consume what we have before making room
+            if( ! parseResponses( c, inNow ) ) {
+                return false;
+                }
+
+            if( c->recvStart > 0 ) {
+                // make room at end
+                int numUnparsed = c->recvEnd - c->recvStart;
+                memmove( c->recv, &( c->recv[ c->recvStart ] ),
+                         numUnparsed );
+                c->recvStart = 0;
+                c->recvEnd = numUnparsed;
+                }
+            else if( c->recvEnd == c->recvSize ) {
+                // a header block or chunk line longer than the buffer
+                unsigned char *newRecv = new unsigned char[ c->recvSize * 2 ];
+                memcpy( newRecv, c->recv, c->recvEnd );
+                delete [] c->recv;
+                c->recv = newRecv;
+                c->recvSize *= 2;
+                }
+            }
+
+        int numRead = c->sock->receive( &( c->recv[ c->recvEnd ] ),
+                                        c->recvSize - c->recvEnd, 0 );
+
+        if( numRead > 0 ) {
+            c->recvEnd += numRead;
+            }
+        else if( numRead == -2 ) {
+            // nothing more for now
+            break;
+            }
+        else {
+            closed = true;
+            break;
+            }
+        }
+
+
+    if( ! parseResponses( c, inNow ) ) {
+        return false;
+        }
+
+    if( closed ) {
+        if( c->pipeline.size() > 0 &&
+            c->parseState == PARSE_UNTIL_CLOSE ) {
+            finishRequest( c, inNow );
+            }
+        return false;
+        }
+
+    if( c->closeAfter && c->numSent == 0 && c->sendOffset == 0 &&
+        c->parseState == PARSE_HEADERS ) {
+        // no response owed, and nothing more will be sent here
+        return false;
+        }
+
+    // send any requests that were waiting on an earlier response
+    return sendRequests( c );
+    }
+
+
+
+char WebConnectionPool::sendRequests( WebPoolConnection *inConnection ) {
+    WebPoolConnection *c = inConnection;
+
+    if( ! c->connected ) {
+        return true;
+        }
+
+    while( c->numSent < c->pipeline.size() && ! c->closeAfter ) {
+        WebPoolRequest *r = c->pipeline.getElementDirect( c->numSent );
+
+        int numSent = c->sock->send(
+            (unsigned char *)&( r->requestText[ c->sendOffset ] ),
+            r->requestLength - c->sendOffset,
+            // non-blocking
+            false, false );
+
+        if( numSent == -2 ) {
+            return true;
+            }
+        if( numSent < 0 ) {
+            return false;
+            }
+
+        c->sendOffset += numSent;
+
+        if( c->sendOffset < r->requestLength ) {
+            // socket buffer full
+            return true;
+            }
+
+        c->numSent ++;
+        c->sendOffset = 0;
+        }
+
+    return true;
+    }
+
+
+
+// finds \r\n in inData, returns offset of \r or -1
+static int findLineEnd( unsigned char *inData, int inLength ) {
+    for( int i=0; i<inLength - 1; i++ ) {
+        if( inData[i] == '\r' && inData[i+1] == '\n' ) {
+            return i;
+            }
+        }
+    return -1;
+    }
+
+
+
+char WebConnectionPool::parseResponses( WebPoolConnection *inConnection,
+                                        double inNow ) {
+    WebPoolConnection *c = inConnection;
+
+    if( c->recvEnd == c->recvStart ) {
+        return true;
+        }
+
+    if( ! parseBuffered( c, inNow ) ) {
+        printf( "Error:  "
+                "WebConnectionPool got badly formatted response "
+                "from %s:%d\n", c->host->name, c->host->port );
+        return false;
+        }
+
+    if( c->recvEnd == c->recvStart ) {
+        // all parsed, start again at front of buffer
+        c->recvStart = 0;
+        c->recvEnd = 0;
+        }
+
+    return true;
+    }
+
+
+
+char WebConnectionPool::parseBuffered( WebPoolConnection *inConnection,
+                                       double inNow ) {
+    WebPoolConnection *c = inConnection;
+
+    while( c->pipeline.size() > 0 ) {
+        WebPoolRequest *r = c->pipeline.getElementDirect( 0 );
+
+        unsigned char *data = &( c->recv[ c->recvStart ] );
+        int available = c->recvEnd - c->recvStart;
+
+        switch( c->parseState ) {
+
+            case PARSE_HEADERS: {
+                int headerEnd = -1;
+                for( int i=0; i<available - 3; i++ ) {
+                    if( data[i] == '\r' && data[i+1] == '\n' &&
+                        data[i+2] == '\r' && data[i+3] == '\n' ) {
+                        headerEnd = i;
+                        break;
+                        }
+                    }
+
+                if( headerEnd == -1 ) {
+                    return ( available <= MAX_HEADER_BYTES );
+                    }
+
+                // status line and header lines, each ending in \r\n
+                char *headers = new char[ headerEnd + 3 ];
+                memcpy( headers, data, headerEnd + 2 );
+                headers[ headerEnd + 2 ] = '\0';
+
+                int headerLength = headerEnd + 4;
+                c->recvStart += headerLength;
+                r->progressSize += headerLength;
+
+                int majorVersion, minorVersion, statusCode;
+
+                int numRead = sscanf( headers, "HTTP/%d.%d %d",
+                                      &majorVersion, &minorVersion,
+                                      &statusCode );
+                if( numRead != 3 ) {
+                    delete [] headers;
+                    return false;
+                    }
+
+                if( statusCode >= 100 && statusCode < 200 ) {
+                    // interim response, real one follows
+                    delete [] headers;
+                    break;
+                    }
+
+                r->statusCode = statusCode;
+                r->headers = headers;
+
+                if( majorVersion == 1 && minorVersion == 0 ) {
+                    if( ! headerHasToken( headers, "Connection",
+                                          "keep-alive" ) ) {
+                        c->closeAfter = true;
+                        }
+                    }
+                else if( headerHasToken( headers, "Connection", "close" ) ) {
+                    c->closeAfter = true;
+                    }
+
+                char *lengthString = findHeader( headers, "Content-Length" );
+
+                if( r->isHead || statusCode == 204 || statusCode == 304 ) {
+                    finishRequest( c, inNow );
+                    }
+                else if( headerHasToken( headers, "Transfer-Encoding",
+                                         "chunked" ) ) {
+                    c->parseState = PARSE_CHUNK_SIZE;
+                    }
+                else if( lengthString != NULL ) {
+                    c->remaining = atol( lengthString );
+
+                    if( c->remaining <= 0 ) {
+                        finishRequest( c, inNow );
+                        }
+                    else {
+                        c->parseState = PARSE_LENGTH;
+                        }
+                    }
+                else {
+                    c->parseState = PARSE_UNTIL_CLOSE;
+                    c->closeAfter = true;
+                    }
+
+                if( lengthString != NULL ) {
+                    delete [] lengthString;
+                    }
+                break;
+                }
+
+            case PARSE_LENGTH:
+            case PARSE_CHUNK_DATA: {
+                if( available == 0 ) {
+                    return true;
+                    }
+
+                int numTaken = available;
+                if( numTaken > c->remaining ) {
+                    numTaken = (int)( c->remaining );
+                    }
+
+                r->body->appendArray( data, numTaken );
+                r->progressSize += numTaken;
+                c->recvStart += numTaken;
+                c->remaining -= numTaken;
+
+                if( c->remaining == 0 ) {
+                    if( c->parseState == PARSE_LENGTH ) {
+                        finishRequest( c, inNow );
+                        }
+                    else {
+                        c->parseState = PARSE_CHUNK_DATA_END;
+                        }
+                    }
+                break;
+                }
+
+            case PARSE_CHUNK_SIZE:
+            case PARSE_TRAILER: {
+                int lineEnd = findLineEnd( data, available );
+
+                if( lineEnd == -1 ) {
+                    return ( available <= MAX_HEADER_BYTES );
+                    }
+
+                c->recvStart += lineEnd + 2;
+                r->progressSize += lineEnd + 2;
+
+                if( c->parseState == PARSE_TRAILER ) {
+                    if( lineEnd == 0 ) {
+                        // empty line ends trailer
+                        finishRequest( c, inNow );
+                        }
+                    break;
+                    }
+
+                // size in hex, maybe followed by ;extensions
+                char *line = new char[ lineEnd + 1 ];
+                memcpy( line, data, lineEnd );
+                line[ lineEnd ] = '\0';
+
+                unsigned long chunkSize;
+                int numRead = sscanf( line, "%lx", &chunkSize );
+
+                delete [] line;
+
+                if( numRead != 1 ) {
+                    return false;
+                    }
+
+                if( chunkSize == 0 ) {
+                    c->parseState = PARSE_TRAILER;
+                    }
+                else {
+                    c->remaining = (long)chunkSize;
+                    c->parseState = PARSE_CHUNK_DATA;
+                    }
+                break;
+                }
+
+            case PARSE_CHUNK_DATA_END: {
+                if( available < 2 ) {
+                    return true;
+                    }
+                if( data[0] != '\r' || data[1] != '\n' ) {
+                    return false;
+                    }
+
+                c->recvStart += 2;
+                r->progressSize += 2;
+                c->parseState = PARSE_CHUNK_SIZE;
+                break;
+                }
+
+            case PARSE_UNTIL_CLOSE: {
+                r->body->appendArray( data, available );
+                r->progressSize += available;
+                c->recvStart += available;
+                return true;
+                }
+            }
+        }
+
+    // bytes beyond the last response asked for
+    return ( c->recvStart == c->recvEnd );
+    }
+
+
+
+void WebConnectionPool::finishRequest( WebPoolConnection *inConnection,
+                                       double inNow ) {
+    WebPoolConnection *c = inConnection;
+
+    WebPoolRequest *r = c->pipeline.getElementDirect( 0 );
+    c->pipeline.deleteElement( 0 );
+
+    if( c->numSent > 0 ) {
+        c->numSent --;
+        }
+    else {
+        // answered before it was fully sent, so the server isn't
+        // reading the rest of it as a request
+        c->sendOffset = 0;
+        c->closeAfter = true;
+        }
+
+    c->parseState = PARSE_HEADERS;
+    c->remaining = 0;
+    c->numServed ++;
+    c->lastUsedTime = inNow;
+
+    mNumRequestsCompleted ++;
+
+    if( r->cancelled ) {
+        freeRequest( r );
+        }
+    else {
+        r->state = WEB_DONE;
+        }
+    }
+
+
+
+void WebConnectionPool::closeConnection( WebPoolConnection *inConnection ) {
+    WebPoolConnection *c = inConnection;
+    WebPoolHost *host = c->host;
+
+    // to go back on the front of the queue, in their original order
+    int numRequeued = 0;
+
+    for( int i=0; i<c->pipeline.size(); i++ ) {
+        WebPoolRequest *r = c->pipeline.getElementDirect( i );
+
+        char answered =
+            r->progressSize > 0 ||
+            ( i == 0 && c->recvEnd > c->recvStart );
+
+        char unsent =
+            i > c->numSent ||
+            ( i == c->numSent && c->sendOffset == 0 );
+
+        if( r->cancelled ) {
+            freeRequest( r );
+            }
+        else if( unsent && c->numServed > 0 ) {
+            // queued behind a response that ended the connection
+            r->state = WEB_PENDING;
+            host->pending.push_middle( r, numRequeued );
+            numRequeued ++;
+            }
+        else if( ! answered && r->idempotent && c->numServed > 0 &&
+                 ( r->pipelined || r->numRetries < 1 ) ) {
+            // server closed a kept-alive connection before getting to
+            // this one, which is normal
+            // if it was sent behind others, server's limit on requests
+            // per connection explains it, else it may be what broke it
+            if( ! r->pipelined ) {
+                r->numRetries ++;
+                }
+            r->state = WEB_PENDING;
+            host->pending.push_middle( r, numRequeued );
+            numRequeued ++;
+            }
+        else {
+            failRequest( r );
+            }
+        }
+
+    delete c->sock;
+    delete [] c->recv;
+
+    host->connections.deleteElementEqualTo( c );
+
+    delete c;
+    }
@@ -0,0 +1,288 @@
+#ifndef WEB_CONNECTION_POOL_INCLUDED
+#define WEB_CONNECTION_POOL_INCLUDED
+
+
+
+#include "minorGems/network/Socket.h"
+#include "minorGems/network/HostAddress.h"
+#include "minorGems/network/LookupThread.h"
+#include "minorGems/system/MutexLock.h"
+#include "minorGems/util/SimpleVector.h"
+
+
+
+typedef struct WebPoolHost WebPoolHost;
+typedef struct WebPoolConnection WebPoolConnection;
+
+
+
+typedef struct WebPoolRequest {
+        int handle;
+
+        WebPoolHost *host;
+
+        // complete request text, headers and body
+        char *requestText;
+        int requestLength;
+
+        char *url;
+
+        // GET and HEAD may be pipelined and retried
+        char idempotent;
+        char isHead;
+
+        // one of the request states in WebConnectionPool.cpp
+        int state;
+
+        // handle freed while response still owed on a connection
+        char cancelled;
+
+        // times sent alone on a connection that closed before answering
+        int numRetries;
+
+        // sent behind other requests on its current connection
+        char pipelined;
+
+        // bytes of response received so far, headers included
+        int progressSize;
+
+        int statusCode;
+
+        // raw header lines, \0-terminated, NULL until headers arrive
+        char *headers;
+
+        SimpleVector<unsigned char> *body;
+
+        // body bytes before this have been given out by takeBody
+        int bodyStart;
+
+        // takeBody has been called, so bytes not yet taken are limited
+        char taking;
+    } WebPoolRequest;
+
+
+
+/**
+ * Keeps HTTP/1.1 connections open between requests, so that a series of
+ * requests to the same host pays for one TCP handshake instead of one
+ * each.
+ *
+ * Requests to a host go to an idle open connection if there is one, are
+ * pipelined behind earlier requests on an open connection if they are
+ * GET or HEAD, or else open a new connection, up to a limit per host.
+ * Requests beyond that wait in order.  Host names are looked up once and
+ * cached.  Responses may be framed by Content-Length, chunked encoding,
+ * or connection close.
+ *
+ * Idle connections are closed after a timeout, or as soon as the server
+ * closes them.  A GET or HEAD that was sent on a reused connection, but
+ * got no response before the server closed it, is sent again on another
+ * connection:  once if it was sent alone, or as often as needed if it was
+ * pipelined behind others, since the server's limit on requests per
+ * connection explains that.
+ *
+ * Nothing blocks:  all socket work happens in step, which callers
+ * invoke every frame, or in a loop for blocking use (see WebClient).
+ *
+ * All functions are thread-safe.
+ */
+class WebConnectionPool {
+
+    public:
+
+        /**
+         * Constructs a pool.
+         *
+         * @param inMaxConnectionsPerHost the most connections open to one
+         *   host at a time.  Defaults to 4.
+         * @param inMaxPipelineDepth the most requests outstanding on one
+         *   connection.  1 turns pipelining off.  Defaults to 4.
+         * @param inIdleTimeoutSeconds how long an unused connection is
+         *   kept open.  Defaults to 10.
+         */
+        WebConnectionPool( int inMaxConnectionsPerHost = 4,
+                           int inMaxPipelineDepth = 4,
+                           double inIdleTimeoutSeconds = 10 );
+
+
+        // closes all connections and frees all requests
+        // may block on outstanding host name lookups
+        ~WebConnectionPool();
+
+
+
+        /**
+         * Gets the pool shared by WebRequest and WebClient, creating it
+         * on first call.
+         */
+        static WebConnectionPool *getSharedPool();
+
+
+        // destroys the shared pool, if it exists
+        // only call once no WebRequests remain
+        static void freeSharedPool();
+
+
+
+        /**
+         * Starts a request.
+         *
+         * @param inMethod GET, POST, etc.
+         * @param inURL the url to retrieve.
+         * @param inBody the body of the request, in
+         *   application/x-www-form-urlencoded format, or NULL.
+         * @param inProxy the address of a proxy in address:port format,
+         *   or NULL to not use a proxy.  Defaults to NULL.
+         *
+         * @return a handle for the request.
+         */
+        int startRequest( const char *inMethod, const char *inURL,
+                          const char *inBody, const char *inProxy = NULL );
+
+
+        /**
+         * Does all pending socket work for every request in the pool,
+         * then checks one request.
+         *
+         * @return 1 if request complete, -1 if it hit an error (or handle
+         *   is unknown), or 0 if still in progress.
+         */
+        int step( int inHandle );
+
+
+        // does all pending socket work, without checking any request
+        void stepAll();
+
+
+        // gets bytes received for a request so far, headers included
+        int getProgressSize( int inHandle );
+
+
+        // gets HTTP status code of a complete request, or -1
+        int getStatusCode( int inHandle );
+
+
+        /**
+         * Gets a response header of a complete request.
+         *
+         * @param inHandle the request.
+         * @param inName the header name, matched ignoring case.
+         *
+         * @return the header value with surrounding space trimmed, or
+         *   NULL if not present.  Destroyed by caller.
+         */
+        char *getResponseHeader( int inHandle, const char *inName );
+
+
+        /**
+         * Gets the response body of a complete request.
+         *
+         * @param inHandle the request.
+         * @param outSize pointer to where body length should be returned.
+         *
+         * @return the body, \0-terminated one byte past outSize, or NULL if
+         *   request not complete.  Destroyed by caller.
+         */
+        unsigned char *getResult( int inHandle, int *outSize );
+
+
+        /**
+         * Takes body bytes received so far, before the request is
+         * complete, so that a large response can be handled as it
+         * arrives instead of held whole.
+         *
+         * Only the body of a 2xx response is given out.  Bytes taken
+         * are not returned again by getResult.  A request that has been
+         * answered is never re-sent, so taken bytes are never repeated.
+         *
+         * Once this has been called for a request, its connection stops
+         * reading while more than about 1 MiB of body waits to be
+         * taken, so a slow taker holds the rest in the server's socket
+         * rather than in memory here.  Keep calling this until the
+         * request is done, or it stalls.
+         *
+         * @param inHandle the request.
+         * @param outBuffer where bytes should be returned.
+         * @param inMaxBytes the most bytes to take.
+         *
+         * @return the number of bytes taken, or 0 if none are waiting.
+         */
+        int takeBody( int inHandle, unsigned char *outBuffer,
+                      int inMaxBytes );
+
+
+        // frees a request, cancelling it if not complete
+        // a response still owed on a connection is read and discarded
+        void clearRequest( int inHandle );
+
+
+
+        // number of TCP connections opened so far
+        int getNumConnectionsOpened();
+
+        // number of requests completed so far
+        int getNumRequestsCompleted();
+
+        // number of connections currently open
+        int getNumOpenConnections();
+
+
+
+    protected:
+
+        int mMaxConnectionsPerHost;
+        int mMaxPipelineDepth;
+        double mIdleTimeoutSeconds;
+
+        MutexLock mLock;
+
+        SimpleVector<WebPoolHost *> mHosts;
+
+        // indexed by handle - mFirstHandle, NULL for freed handles
+        SimpleVector<WebPoolRequest *> mRequests;
+        int mFirstHandle;
+        int mNextHandle;
+
+        int mNumConnectionsOpened;
+        int mNumRequestsCompleted;
+
+        static WebConnectionPool *sSharedPool;
+        static MutexLock sSharedPoolLock;
+
+
+        WebPoolRequest *getRequest( int inHandle );
+        void forgetRequest( int inHandle );
+
+        void freeRequest( WebPoolRequest *inRequest );
+
+        WebPoolHost *getHost( const char *inName, int inPort );
+
+        void stepHost( WebPoolHost *inHost, double inNow );
+
+        void assignPending( WebPoolHost *inHost, double inNow );
+
+        WebPoolConnection *openConnection( WebPoolHost *inHost );
+
+        // returns false if connection has failed or closed
+        char stepConnection( WebPoolConnection *inConnection, double inNow );
+
+        char sendRequests( WebPoolConnection *inConnection );
+
+        // parses received bytes, returns false on a malformed response,
+        // or bytes nobody asked for
+        char parseResponses( WebPoolConnection *inConnection, double inNow );
+
+        char parseBuffered( WebPoolConnection *inConnection, double inNow );
+
+        void finishRequest( WebPoolConnection *inConnection,
+                            double inNow );
+
+        void failRequest( WebPoolRequest *inRequest );
+
+        // requeues or fails outstanding requests
+        void closeConnection( WebPoolConnection *inConnection );
+    };
+
+
+
+#endif
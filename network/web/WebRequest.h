@@ -2,13 +2,13 @@
 #define WEB_REQUEST_INCLUDED
 
 
-#include "minorGems/network/Socket.h"
-#include "minorGems/network/HostAddress.h"
-#include "minorGems/network/LookupThread.h"
+#include "minorGems/network/web/WebConnectionPool.h"
 
 
 
 // a non-blocking web request
+// sent on a connection from the shared WebConnectionPool, which may be
+// reused from earlier requests to the same host
 class WebRequest {
         
 
@@ -46,31 +46,23 @@ class WebRequest {
 
         // gets the response body as bytes
         unsigned char *getResult( int *outSize );
+
+
+        // takes body bytes received so far, before the request is
+        // complete, so large downloads can be handled as they arrive
+        // bytes taken are not returned again by getResult
+        // returns number of bytes taken, at most inMaxBytes, 0 if none
+        int takeResultBytes( unsigned char *outBuffer, int inMaxBytes );
         
         
 
     protected:
-        char mError;
-        
         char *mURL;
 
-        char *mRequest;
-        
-        int mRequestPosition;
-        
-        SimpleVector<char> mResponse;
-        
-        char mResultReady;
-        
-        char *mResult;
-        
-        int mResultSize;
+        int mHandle;
 
-        HostAddress *mSuppliedAddress;
-        HostAddress *mNumericalAddress;
-        LookupThread *mLookupThread;
-        
-        Socket *mSock;
+        // set once a 404 has been reported
+        char mNotFound;
         
     };
 
@@ -0,0 +1,929 @@
+// Test and benchmark for WebConnectionPool
+//
+// Usage:  webConnectionPoolTest [requests]
+//
+// Runs a small HTTP/1.1 server on loopback that counts the connections it
+// accepts, each one a TCP handshake.  Checks Content-Length, chunked,
+// and read-until-close bodies, HEAD, 404, POST, pipelined bursts, a
+// server that closes kept-alive connections after a few requests,
+// bodies taken as they arrive, a taker that stalls, cancellation, idle
+// timeout, and WebClient redirects and MIME types.
+//
+// Then sends a series of requests one after another:  to a server that
+// closes each connection after one response, the way every WebRequest
+// and WebClient call used to run, against the same server keeping
+// connections alive.
+
+
+#include "minorGems/network/web/WebConnectionPool.h"
+#include "minorGems/network/web/WebRequest.h"
+#include "minorGems/network/web/WebClient.h"
+#include "minorGems/network/SocketServer.h"
+#include "minorGems/system/Thread.h"
+#include "minorGems/system/MutexLock.h"
+#include "minorGems/system/Time.h"
+#include "minorGems/util/SimpleVector.h"
+#include "minorGems/util/stringUtils.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+
+#define TEST_PORT 5079
+
+
+
+static int numFailed = 0;
+
+
+static void check( char inPassed, const char *inWhat ) {
+    if( ! inPassed ) {
+        printf( "FAILED:  %s\n", inWhat );
+        numFailed++;
+        }
+    }
+
+
+
+static char bodyByte( int inIndex ) {
+    return (char)( 'a' + inIndex % 26 );
+    }
+
+
+static char bodyMatches( unsigned char *inBody, int inLength,
+                         int inExpectedLength ) {
+    if( inBody == NULL || inLength != inExpectedLength ) {
+        return false;
+        }
+    for( int i=0; i<inLength; i++ ) {
+        if( inBody[i] != bodyByte( i ) ) {
+            return false;
+            }
+        }
+    return true;
+    }
+
+
+
+// server settings, changed between checks while no requests are running
+static MutexLock serverLock;
+static int numAccepted = 0;
+// 0 for no limit
+static int maxRequestsPerConnection = 0;
+static char stopServer = false;
+
+
+static char isServerStopping() {
+    serverLock.lock();
+    char stopping = stopServer;
+    serverLock.unlock();
+    return stopping;
+    }
+
+
+
+static void sendAll( Socket *inSock, const char *inText, int inLength = -1 ) {
+    if( inLength == -1 ) {
+        inLength = strlen( inText );
+        }
+    inSock->send( (unsigned char *)inText, inLength, true, false );
+    }
+
+
+
+// serves requests on one connection
+class ConnectionThread : public Thread {
+
+    public:
+
+        ConnectionThread( Socket *inSock )
+                : mSock( inSock ) {
+            }
+
+        virtual void run() {
+            serve();
+
+            // closing is how the client sees the end
+            delete mSock;
+            }
+
+
+    protected:
+        Socket *mSock;
+
+
+        void serve() {
+            SimpleVector<char> received;
+            unsigned char buffer[ 4096 ];
+
+            int numServed = 0;
+
+            serverLock.lock();
+            int maxRequests = maxRequestsPerConnection;
+            serverLock.unlock();
+
+            while( ! isServerStopping() ) {
+                int numRead = mSock->receive( buffer, sizeof( buffer ), 50 );
+
+                if( numRead == -2 ) {
+                    continue;
+                    }
+                if( numRead < 0 ) {
+                    return;
+                    }
+
+                received.appendArray( (char *)buffer, numRead );
+
+                // serve every complete request received so far
+                while( true ) {
+                    char *text = received.getElementString();
+                    char *headerEnd = strstr( text, "\r\n\r\n" );
+
+                    if( headerEnd == NULL ) {
+                        delete [] text;
+                        break;
+                        }
+
+                    int headerLength = ( headerEnd - text ) + 4;
+
+                    int bodyLength = 0;
+                    char *lengthTag =
+                        stringLocateIgnoreCase( text, "Content-Length:" );
+                    if( lengthTag != NULL && lengthTag < headerEnd ) {
+                        sscanf( &( lengthTag[15] ), "%d", &bodyLength );
+                        }
+
+                    if( received.size() < headerLength + bodyLength ) {
+                        delete [] text;
+                        break;
+                        }
+
+                    char method[16], path[256];
+                    sscanf( text, "%15s %255s", method, path );
+
+                    char *body = stringDuplicate( "" );
+                    if( bodyLength > 0 ) {
+                        delete [] body;
+                        body = new char[ bodyLength + 1 ];
+                        memcpy( body, &( text[ headerLength ] ), bodyLength );
+                        body[ bodyLength ] = '\0';
+                        }
+
+                    delete [] text;
+                    received.deleteStartElements( headerLength + bodyLength );
+
+                    numServed ++;
+
+                    char closeNow = respond( method, path, body,
+                                             maxRequests > 0 &&
+                                             numServed >= maxRequests );
+                    delete [] body;
+
+                    if( closeNow ) {
+                        // drop requests pipelined behind, but read them
+                        // first, as real servers do, so the close isn't
+                        // a reset that loses responses already sent
+                        while( mSock->receive( buffer, sizeof( buffer ),
+                                               20 ) > 0 ) {
+                            }
+                        return;
+                        }
+                    }
+                }
+            }
+
+
+        // returns true if connection should close
+        char respond( const char *inMethod, const char *inPath,
+                      const char *inBody, char inLastAllowed ) {
+
+            int n = 0;
+
+            if( strcmp( inMethod, "POST" ) == 0 ) {
+                char *response = autoSprintf(
+                    "HTTP/1.1 200 OK\r\n"
+                    "Content-Length: %d\r\n\r\n%s",
+                    (int)strlen( inBody ), inBody );
+                sendAll( mSock, response );
+                delete [] response;
+                }
+            else if( sscanf( inPath, "/len/%d", &n ) == 1 ||
+                     sscanf( inPath, "/close/%d", &n ) == 1 ) {
+
+                char close = ( strstr( inPath, "/close/" ) == inPath );
+
+                char *header = autoSprintf(
+                    "HTTP/1.1 200 OK\r\n"
+                    "Content-Type: text/plain; charset=utf-8\r\n"
+                    "Content-Length: %d\r\n%s\r\n",
+                    n, close ? "Connection: close\r\n" : "" );
+                sendAll( mSock, header );
+                delete [] header;
+
+                if( strcmp( inMethod, "HEAD" ) != 0 ) {
+                    sendBody( 0, n );
+                    }
+
+                if( close ) {
+                    return true;
+                    }
+                }
+            else if( sscanf( inPath, "/chunked/%d", &n ) == 1 ) {
+                sendAll( mSock,
+                         "HTTP/1.1 200 OK\r\n"
+                         "Transfer-Encoding: chunked\r\n\r\n" );
+
+                int sent = 0;
+                while( sent < n ) {
+                    int chunk = n - sent;
+                    if( chunk > 1000 ) {
+                        chunk = 1000;
+                        }
+
+                    char *sizeLine = autoSprintf( "%x;ext=1\r\n", chunk );
+                    sendAll( mSock, sizeLine );
+                    delete [] sizeLine;
+
+                    sendBody( sent, chunk );
+                    sendAll( mSock, "\r\n" );
+                    sent += chunk;
+                    }
+                sendAll( mSock, "0\r\nX-Trailer: yes\r\n\r\n" );
+                }
+            else if( sscanf( inPath, "/old/%d", &n ) == 1 ) {
+                // HTTP/1.0, body ends at close
+                sendAll( mSock, "HTTP/1.0 200 OK\r\n\r\n" );
+                sendBody( 0, n );
+                return true;
+                }
+            else if( strcmp( inPath, "/redirect" ) == 0 ) {
+                char *response = autoSprintf(
+                    "HTTP/1.1 302 Found\r\n"
+                    "Location: http://127.0.0.1:%d/len/100\r\n"
+                    "Content-Length: 0\r\n\r\n", TEST_PORT );
+                sendAll( mSock, response );
+                delete [] response;
+                }
+            else {
+                sendAll( mSock,
+                         "HTTP/1.1 404 Not Found\r\n"
+                         "Content-Length: 9\r\n\r\nnot found" );
+                }
+
+            return inLastAllowed;
+            }
+
+
+        void sendBody( int inStart, int inLength ) {
+            char *body = new char[ inLength ];
+            for( int i=0; i<inLength; i++ ) {
+                body[i] = bodyByte( inStart + i );
+                }
+            sendAll( mSock, body, inLength );
+            delete [] body;
+            }
+    };
+
+
+
+class ServerThread : public Thread {
+
+    public:
+
+        ServerThread( SocketServer *inServer )
+                : mServer( inServer ) {
+            }
+
+        ~ServerThread() {
+            for( int i=0; i<mConnections.size(); i++ ) {
+                Thread *t = mConnections.getElementDirect( i );
+                t->join();
+                delete t;
+                }
+            }
+
+
+        virtual void run() {
+            while( ! isServerStopping() ) {
+                char timedOut;
+                Socket *sock = mServer->acceptConnection( 50, &timedOut );
+
+                if( sock != NULL ) {
+                    serverLock.lock();
+                    numAccepted ++;
+                    serverLock.unlock();
+
+                    Thread *t = new ConnectionThread( sock );
+                    mConnections.push_back( t );
+                    t->start();
+                    }
+                }
+            }
+
+    protected:
+        SocketServer *mServer;
+        SimpleVector<Thread *> mConnections;
+    };
+
+
+
+static int getNumAccepted() {
+    serverLock.lock();
+    int n = numAccepted;
+    serverLock.unlock();
+    return n;
+    }
+
+
+static void setMaxRequestsPerConnection( int inMax ) {
+    serverLock.lock();
+    maxRequestsPerConnection = inMax;
+    serverLock.unlock();
+    }
+
+
+
+static char *testURL( const char *inPath ) {
+    return autoSprintf( "http://127.0.0.1:%d%s", TEST_PORT, inPath );
+    }
+
+
+
+// steps until done, returns final step result
+static int waitFor( WebConnectionPool *inPool, int inHandle ) {
+    double start = Time::getCurrentTime();
+
+    while( Time::getCurrentTime() - start < 10 ) {
+        int result = inPool->step( inHandle );
+        if( result != 0 ) {
+            return result;
+            }
+        // yield only, so timings show network costs rather than sleeps
+        Thread::staticSleep( 0 );
+        }
+    return 0;
+    }
+
+
+
+// starts a GET, waits for it, checks body, frees it
+static char getAndCheck( WebConnectionPool *inPool, const char *inPath,
+                         int inExpectedLength ) {
+    char *url = testURL( inPath );
+    int handle = inPool->startRequest( "GET", url, NULL );
+    delete [] url;
+
+    char passed = false;
+
+    if( waitFor( inPool, handle ) == 1 ) {
+        int length;
+        unsigned char *body = inPool->getResult( handle, &length );
+
+        passed = bodyMatches( body, length, inExpectedLength );
+        delete [] body;
+        }
+
+    inPool->clearRequest( handle );
+
+    return passed;
+    }
+
+
+
+// like getAndCheck, but takes body bytes while it arrives, in small
+// pieces, and only the rest with getResult
+static char takeAndCheck( WebConnectionPool *inPool, const char *inPath,
+                          int inExpectedLength ) {
+    char *url = testURL( inPath );
+    int handle = inPool->startRequest( "GET", url, NULL );
+    delete [] url;
+
+    unsigned char *body = new unsigned char[ inExpectedLength + 1 ];
+    int length = 0;
+
+    int result = 0;
+    double start = Time::getCurrentTime();
+
+    while( result == 0 && Time::getCurrentTime() - start < 10 ) {
+        result = inPool->step( handle );
+
+        int numTaken = 1;
+        while( numTaken > 0 && length < inExpectedLength ) {
+            int maxTaken = inExpectedLength - length;
+            if( maxTaken > 999 ) {
+                maxTaken = 999;
+                }
+            numTaken = inPool->takeBody( handle, &( body[ length ] ),
+                                         maxTaken );
+            length += numTaken;
+            }
+        Thread::staticSleep( 0 );
+        }
+
+    char passed = false;
+
+    if( result == 1 ) {
+        int restLength;
+        unsigned char *rest = inPool->getResult( handle, &restLength );
+
+        if( length + restLength == inExpectedLength ) {
+            memcpy( &( body[ length ] ), rest, restLength );
+            passed = bodyMatches( body, inExpectedLength, inExpectedLength );
+            }
+        delete [] rest;
+        }
+
+    delete [] body;
+
+    inPool->clearRequest( handle );
+
+    return passed;
+    }
+
+
+
+// a taker that stops taking should stall the download, not have the pool
+// buffer the rest of it
+static void checkStalledTaker() {
+    WebConnectionPool pool;
+
+    int bodyLength = 8 * 1024 * 1024;
+
+    char *path = autoSprintf( "/len/%d", bodyLength );
+    char *url = testURL( path );
+    delete [] path;
+
+    int handle = pool.startRequest( "GET", url, NULL );
+    delete [] url;
+
+    unsigned char *body = new unsigned char[ bodyLength + 1 ];
+
+    // take a little, then nothing for a while
+    int length = 0;
+    double start = Time::getCurrentTime();
+    while( length == 0 && Time::getCurrentTime() - start < 10 ) {
+        pool.step( handle );
+        length = pool.takeBody( handle, body, 1000 );
+        Thread::staticSleep( 0 );
+        }
+
+    start = Time::getCurrentTime();
+    while( Time::getCurrentTime() - start < 0.5 ) {
+        pool.step( handle );
+        Thread::staticSleep( 1 );
+        }
+
+    // untaken body, plus at most a receive buffer beyond the limit
+    check( pool.getProgressSize( handle ) < 3 * 1024 * 1024,
+           "stalled taker holds download back" );
+
+    int result = 0;
+    start = Time::getCurrentTime();
+    while( result == 0 && Time::getCurrentTime() - start < 10 ) {
+        result = pool.step( handle );
+        length += pool.takeBody( handle, &( body[ length ] ),
+                                 bodyLength - length );
+        }
+
+    int restLength = 0;
+    unsigned char *rest = pool.getResult( handle, &restLength );
+
+    char passed = false;
+    if( rest != NULL && length + restLength == bodyLength ) {
+        memcpy( &( body[ length ] ), rest, restLength );
+        passed = bodyMatches( body, bodyLength, bodyLength );
+        }
+    check( passed, "stalled body resumes intact" );
+
+    if( rest != NULL ) {
+        delete [] rest;
+        }
+    delete [] body;
+
+    pool.clearRequest( handle );
+    }
+
+
+
+// starts many GETs at once, waits for all
+static char burstAndCheck( WebConnectionPool *inPool, int inCount,
+                           int inLength ) {
+    char *path = autoSprintf( "/len/%d", inLength );
+    char *url = testURL( path );
+    delete [] path;
+
+    int *handles = new int[ inCount ];
+    for( int i=0; i<inCount; i++ ) {
+        handles[i] = inPool->startRequest( "GET", url, NULL );
+        }
+    delete [] url;
+
+    char allMatch = true;
+
+    for( int i=0; i<inCount; i++ ) {
+        int length;
+        unsigned char *body = NULL;
+
+        if( waitFor( inPool, handles[i] ) == 1 ) {
+            body = inPool->getResult( handles[i], &length );
+            }
+        if( ! bodyMatches( body, length, inLength ) ) {
+            allMatch = false;
+            }
+        if( body != NULL ) {
+            delete [] body;
+            }
+        inPool->clearRequest( handles[i] );
+        }
+
+    delete [] handles;
+
+    return allMatch;
+    }
+
+
+
+static void checkFraming() {
+    WebConnectionPool pool;
+
+    int acceptedBefore = getNumAccepted();
+
+    char allMatch = true;
+    for( int i=0; i<20; i++ ) {
+        char *path = autoSprintf( "/len/%d", i * 1000 );
+        if( ! getAndCheck( &pool, path, i * 1000 ) ) {
+            allMatch = false;
+            }
+        delete [] path;
+        }
+    check( allMatch, "Content-Length bodies" );
+
+    allMatch = true;
+    for( int i=0; i<5; i++ ) {
+        char *path = autoSprintf( "/chunked/%d", i * 2345 );
+        if( ! getAndCheck( &pool, path, i * 2345 ) ) {
+            allMatch = false;
+            }
+        delete [] path;
+        }
+    check( allMatch, "chunked bodies" );
+
+    check( getAndCheck( &pool, "/len/300000", 300000 ), "large body" );
+
+    check( getAndCheck( &pool, "/chunked/300000", 300000 ),
+           "large chunked body" );
+
+    check( takeAndCheck( &pool, "/len/300000", 300000 ),
+           "body taken as it arrives" );
+    check( takeAndCheck( &pool, "/chunked/300000", 300000 ),
+           "chunked body taken as it arrives" );
+
+    check( getNumAccepted() - acceptedBefore == 1,
+           "sequential requests share one connection" );
+
+
+    // HEAD gets headers only, even though Content-Length is set
+    char *url = testURL( "/len/5000" );
+    int handle = pool.startRequest( "HEAD", url, NULL );
+    delete [] url;
+
+    check( waitFor( &pool, handle ) == 1, "HEAD completes" );
+
+    char *lengthHeader = pool.getResponseHeader( handle, "content-length" );
+    check( lengthHeader != NULL && strcmp( lengthHeader, "5000" ) == 0,
+           "header lookup ignores case" );
+    if( lengthHeader != NULL ) {
+        delete [] lengthHeader;
+        }
+
+    int length;
+    unsigned char *body = pool.getResult( handle, &length );
+    check( body != NULL && length == 0, "HEAD has no body" );
+    delete [] body;
+    pool.clearRequest( handle );
+
+    check( getAndCheck( &pool, "/len/10", 10 ), "GET after HEAD" );
+
+
+    // POST echoes body
+    url = testURL( "/post" );
+    handle = pool.startRequest( "POST", url, "a=1&b=2" );
+    delete [] url;
+
+    check( waitFor( &pool, handle ) == 1, "POST completes" );
+    body = pool.getResult( handle, &length );
+    check( body != NULL && strcmp( (char *)body, "a=1&b=2" ) == 0,
+           "POST body" );
+    delete [] body;
+    pool.clearRequest( handle );
+
+
+    // close after response, then HTTP/1.0 body ending at close
+    acceptedBefore = getNumAccepted();
+
+    check( getAndCheck( &pool, "/close/777", 777 ), "Connection: close" );
+    check( getAndCheck( &pool, "/old/5555", 5555 ), "body ended by close" );
+    check( getAndCheck( &pool, "/len/10", 10 ), "GET after close" );
+
+    // first reuses open connection, then each needs a new one
+    check( getNumAccepted() - acceptedBefore == 2,
+           "closed connections not reused" );
+
+
+    // 404 reported by status
+    url = testURL( "/nothing" );
+    handle = pool.startRequest( "GET", url, NULL );
+    delete [] url;
+    check( waitFor( &pool, handle ) == 1 &&
+           pool.getStatusCode( handle ) == 404, "404 status" );
+
+    unsigned char errorBody[10];
+    check( pool.takeBody( handle, errorBody, 10 ) == 0,
+           "error body not taken" );
+    pool.clearRequest( handle );
+    }
+
+
+
+static void checkPipelining() {
+    WebConnectionPool pool( 2, 4 );
+
+    // one to learn that server keeps connections alive
+    check( getAndCheck( &pool, "/len/10", 10 ), "first request" );
+
+    int acceptedBefore = getNumAccepted();
+
+    check( burstAndCheck( &pool, 24, 3000 ), "pipelined burst" );
+
+    check( getNumAccepted() - acceptedBefore <= 1,
+           "burst stays within connection limit" );
+
+
+    // server drops connections after 3 requests, even with more
+    // pipelined behind them
+    setMaxRequestsPerConnection( 3 );
+
+    WebConnectionPool closingPool( 2, 4 );
+
+    check( getAndCheck( &closingPool, "/len/10", 10 ), "first request" );
+
+    check( burstAndCheck( &closingPool, 24, 2000 ),
+           "pipelined requests retried after server closes" );
+
+    // sequential requests find kept-alive connection closed
+    char allMatch = true;
+    for( int i=0; i<10; i++ ) {
+        if( ! getAndCheck( &closingPool, "/chunked/100", 100 ) ) {
+            allMatch = false;
+            }
+        }
+    check( allMatch, "sequential requests across server closes" );
+
+    setMaxRequestsPerConnection( 0 );
+    }
+
+
+
+static void checkCancelAndIdle() {
+    WebConnectionPool pool( 1, 4, 0.2 );
+
+    check( getAndCheck( &pool, "/len/10", 10 ), "first request" );
+
+    int acceptedBefore = getNumAccepted();
+
+    // cancel while large response in flight, and one still pending
+    char *url = testURL( "/len/2000000" );
+    int bigHandle = pool.startRequest( "GET", url, NULL );
+    delete [] url;
+
+    url = testURL( "/len/50" );
+    int queuedHandle = pool.startRequest( "POST", url, "x=1" );
+    delete [] url;
+
+    while( pool.getProgressSize( bigHandle ) == 0 ) {
+        pool.step( bigHandle );
+        Thread::staticSleep( 1 );
+        }
+    pool.clearRequest( bigHandle );
+    pool.clearRequest( queuedHandle );
+
+    check( getAndCheck( &pool, "/len/123", 123 ),
+           "request after cancelled ones" );
+
+    check( getNumAccepted() - acceptedBefore == 0,
+           "cancelled response read and discarded" );
+
+    check( pool.step( bigHandle ) == -1, "freed handle unknown" );
+
+
+    // idle timeout
+    check( pool.getNumOpenConnections() == 1, "connection kept open" );
+
+    Thread::staticSleep( 300 );
+    pool.stepAll();
+
+    check( pool.getNumOpenConnections() == 0, "idle connection closed" );
+
+
+    // server closing idle connection is noticed
+    setMaxRequestsPerConnection( 1 );
+    check( getAndCheck( &pool, "/len/10", 10 ), "request before close" );
+    setMaxRequestsPerConnection( 0 );
+
+    double start = Time::getCurrentTime();
+    while( pool.getNumOpenConnections() > 0 &&
+           Time::getCurrentTime() - start < 0.15 ) {
+        pool.stepAll();
+        Thread::staticSleep( 1 );
+        }
+    check( pool.getNumOpenConnections() == 0,
+           "server close seen before idle timeout" );
+    }
+
+
+
+static void checkSharedClients() {
+    // WebRequest and WebClient share one pool
+    int acceptedBefore = getNumAccepted();
+
+    char *url = testURL( "/len/400" );
+
+    char allMatch = true;
+
+    for( int i=0; i<5; i++ ) {
+        WebRequest request( "GET", url, NULL );
+
+        double start = Time::getCurrentTime();
+        int result = 0;
+        while( result == 0 && Time::getCurrentTime() - start < 10 ) {
+            result = request.step();
+            Thread::staticSleep( 1 );
+            }
+
+        int length;
+        unsigned char *body = request.getResult( &length );
+        if( result != 1 || ! bodyMatches( body, length, 400 ) ) {
+            allMatch = false;
+            }
+        if( body != NULL ) {
+            delete [] body;
+            }
+
+        int contentLength;
+        char *page = WebClient::getWebPage( url, &contentLength,
+                                            NULL, NULL, 5000 );
+        if( ! bodyMatches( (unsigned char *)page, contentLength, 400 ) ) {
+            allMatch = false;
+            }
+        if( page != NULL ) {
+            delete [] page;
+            }
+        }
+    check( allMatch, "WebRequest and WebClient bodies" );
+
+    check( getNumAccepted() - acceptedBefore == 1,
+           "WebRequest and WebClient share connection" );
+
+    delete [] url;
+
+
+    url = testURL( "/nothing" );
+    WebRequest missing( "GET", url, NULL );
+    int result = 0;
+    while( result == 0 ) {
+        result = missing.step();
+        Thread::staticSleep( 1 );
+        }
+    check( result == -1, "WebRequest 404 is an error" );
+
+    int contentLength;
+    char *page = WebClient::getWebPage( url, &contentLength );
+    check( page == NULL, "WebClient 404 is NULL" );
+    delete [] url;
+
+
+    url = testURL( "/redirect" );
+    char *finalURL;
+    char *mimeType;
+    page = WebClient::getWebPage( url, &contentLength, &finalURL,
+                                  &mimeType );
+    delete [] url;
+
+    check( bodyMatches( (unsigned char *)page, contentLength, 100 ),
+           "redirect followed" );
+
+    char *expectedURL = testURL( "/len/100" );
+    check( finalURL != NULL && strcmp( finalURL, expectedURL ) == 0,
+           "final URL" );
+    check( mimeType != NULL && strcmp( mimeType, "text/plain" ) == 0,
+           "MIME type" );
+    delete [] expectedURL;
+
+    if( page != NULL ) {
+        delete [] page;
+        }
+    delete [] finalURL;
+    if( mimeType != NULL ) {
+        delete [] mimeType;
+        }
+    }
+
+
+
+// returns seconds for inCount sequential GETs
+static double timeSequential( WebConnectionPool *inPool, const char *inPath,
+                              int inLength, int inCount,
+                              int *outHandshakes ) {
+    int acceptedBefore = getNumAccepted();
+
+    double start = Time::getCurrentTime();
+
+    char allMatch = true;
+    for( int i=0; i<inCount; i++ ) {
+        if( ! getAndCheck( inPool, inPath, inLength ) ) {
+            allMatch = false;
+            }
+        }
+
+    double seconds = Time::getCurrentTime() - start;
+
+    check( allMatch, "timed request bodies" );
+
+    *outHandshakes = getNumAccepted() - acceptedBefore;
+
+    return seconds;
+    }
+
+
+
+int main( int inNumArgs, char **inArgs ) {
+
+    int numRequests = 500;
+
+    if( inNumArgs > 1 ) {
+        numRequests = atoi( inArgs[1] );
+        }
+
+    if( numRequests < 1 ) {
+        printf( "Usage:  webConnectionPoolTest [requests]\n" );
+        return 1;
+        }
+
+
+    SocketServer *server = new SocketServer( TEST_PORT, 100 );
+
+    ServerThread *serverThread = new ServerThread( server );
+    serverThread->start();
+
+
+    checkFraming();
+    checkPipelining();
+    checkStalledTaker();
+    checkCancelAndIdle();
+    checkSharedClients();
+
+    if( numFailed == 0 ) {
+        printf( "Framing, pipelining, retry, cancel, idle, and client "
+                "checks passed\n\n" );
+        }
+
+
+    WebConnectionPool pool;
+
+    int closedHandshakes, keptHandshakes;
+
+    double closedTime = timeSequential( &pool, "/close/1000", 1000,
+                                        numRequests, &closedHandshakes );
+    double keptTime = timeSequential( &pool, "/len/1000", 1000,
+                                      numRequests, &keptHandshakes );
+
+    printf( "%d sequential requests for 1000 bytes:\n", numRequests );
+    printf( "%-32s %9.2f ms  %5d handshakes\n",
+            "connection closed each time", 1000 * closedTime,
+            closedHandshakes );
+    printf( "%-32s %9.2f ms  %5d handshakes\n",
+            "connection kept alive", 1000 * keptTime, keptHandshakes );
+    printf( "%d handshakes saved\n", closedHandshakes - keptHandshakes );
+
+    check( keptHandshakes == 1, "kept-alive run uses one connection" );
+
+
+    WebConnectionPool::freeSharedPool();
+
+    serverLock.lock();
+    stopServer = true;
+    serverLock.unlock();
+    serverThread->join();
+    delete serverThread;
+    delete server;
+
+    if( numFailed > 0 ) {
+        printf( "\n%d checks FAILED\n", numFailed );
+        return 1;
+        }
+
+    printf( "\nAll checks passed\n" );
+    return 0;
+    }
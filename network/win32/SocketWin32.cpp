@@ -143,6 +143,8 @@ int Socket::initSocketFramework() {
 
 Socket::~Socket() {
 
+    clearSendQueue();
+
     if( !mIsConnectionBroken ) {
         
         // 2 specifies shutting down both sends and receives
@@ -160,14 +162,19 @@ int Socket::isConnected() {
     if( mConnected ) {
         return 1;
         }
+    if( mConnectFailed ) {
+        return -1;
+        }
+    if( mConnectionWatched ) {
+        // poller will call finishConnect when there's news
+        return 0;
+        }
     
 	unsigned int socketID = mNativeSocketID;
 
     int ret;
 	fd_set fsr;
 	struct timeval tv;
-	int val;
-    socklen_t len;
 
 	FD_ZERO( &fsr );
 	FD_SET( socketID, &fsr );
@@ -186,19 +193,23 @@ int Socket::isConnected() {
 
     // no timeout
     // error?
+    return finishConnect();
+    }
 
-	len = 4;
-	ret = getsockopt( socketID, SOL_SOCKET, SO_ERROR, (char*)( &val ), &len );
+
+
+int Socket::finishConnect() {
+	int val;
+    socklen_t len = sizeof( val );
+
+	int ret = getsockopt( mNativeSocketID, SOL_SOCKET, SO_ERROR,
+                          (char*)( &val ), &len );
 	
-	if( ret < 0 ) {
+	if( ret < 0 || val != 0 ) {
 		// error
+        mConnectFailed = true;
         return -1;
         }
-
-	if( val != 0 ) {
-        // error
-		return -1;
-        }
 	
     // success
     mConnected = true;
@@ -208,6 +219,61 @@ int Socket::isConnected() {
 
 
 
+char Socket::setNativeNonBlocking( char inNonBlocking ) {
+    // 1 for non-blocking, 0 for blocking
+    u_long socketMode = inNonBlocking ? 1 : 0;
+    
+    return ioctlsocket( mNativeSocketID, FIONBIO, &socketMode ) == 0;
+    }
+
+
+
+char Socket::setPersistentNonBlocking() {
+    if( ! setNativeNonBlocking( true ) ) {
+        return false;
+        }
+    setNoDelay( 1 );
+
+    mPersistentNonBlocking = true;
+    return true;
+    }
+
+
+
+int Socket::sendGathered( unsigned char **inBuffers, int *inLengths,
+                          int inNumBuffers ) {
+
+    // WSASend needs winsock2, which clashes with winsock.h used here
+    // queue blocks are big enough that a send per block is cheap
+    int totalSent = 0;
+    
+    for( int i=0; i<inNumBuffers; i++ ) {
+        int result = ::send( mNativeSocketID, (char*)inBuffers[i],
+                             inLengths[i], 0 );
+        
+        if( result == -1 ) {
+            if( WSAGetLastError() != WSAEWOULDBLOCK ) {
+                return -1;
+                }
+            if( totalSent == 0 ) {
+                return -2;
+                }
+            return totalSent;
+            }
+        
+        totalSent += result;
+        
+        if( result < inLengths[i] ) {
+            // OS buffer full
+            break;
+            }
+        }
+    
+    return totalSent;
+    }
+
+
+
 void Socket::setNoDelay( int inValue ) {
 
     int flag = inValue;
@@ -225,6 +291,11 @@ int Socket::send( unsigned char *inBuffer, int inNumBytes,
                   char inAllowedToBlock,
                   char inAllowDelay ) {
 	
+    if( mPersistentNonBlocking ) {
+        // already no-delay, and mode changes would cost system calls
+        return sendPersistent( inBuffer, inNumBytes, inAllowedToBlock );
+        }
+    
 	unsigned int socketID = mNativeSocketID;
 
     if( inAllowedToBlock ) {
@@ -291,6 +362,13 @@ int Socket::receive( unsigned char *inBuffer, int inNumBytes,
 
     char stopLooping = false;
     
+
+    if( mPersistentNonBlocking && inTimeout == -1 ) {
+        // blocking for the duration of this call
+        if( ! setNativeNonBlocking( false ) ) {
+            return -1;
+            }
+        }
     
 	// for win32, we can't specify MSG_WAITALL
 	// so we have too loop until the entire message is received,
@@ -323,15 +401,19 @@ int Socket::receive( unsigned char *inBuffer, int inNumBytes,
 
             // 1 for non-blocking, 0 for blocking
             u_long socketMode = 1;
-            ioctlsocket( socketID, FIONBIO, &socketMode );
+            if( ! mPersistentNonBlocking ) {
+                ioctlsocket( socketID, FIONBIO, &socketMode );
+                }
 
 			numReceivedIn = 
 				timed_read( socketID, remainingBuffer,
                             numRemaining, inTimeout );
 
-            // back to blocking
-            socketMode = 0;
-            ioctlsocket( socketID, FIONBIO, &socketMode );
+            if( ! mPersistentNonBlocking ) {
+                // back to blocking
+                socketMode = 0;
+                ioctlsocket( socketID, FIONBIO, &socketMode );
+                }
 
 
             // stop looping after one timed read
@@ -369,6 +451,10 @@ int Socket::receive( unsigned char *inBuffer, int inNumBytes,
 			
 		}
 
+    if( mPersistentNonBlocking && inTimeout == -1 ) {
+        setNativeNonBlocking( true );
+        }
+
     if( error ) {
         return errorReturnValue;
         }
@@ -0,0 +1,527 @@
+#include "SoundSpriteMixer.h"
+
+#include <math.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+
+
+static double lanczos2( double inX ) {
+    if( inX == 0 ) {
+        return 1;
+        }
+    if( inX <= -2 || inX >= 2 ) {
+        return 0;
+        }
+    double px = M_PI * inX;
+    return 2 * sin( px ) * sin( px / 2 ) / ( px * px );
+    }
+
+
+
+SoundSpriteMixer::SoundSpriteMixer( char inSincResampling )
+    : mVoices( 100 ), mStoppedStreams( 100 ) {
+
+    int numPhases = 1 << MIXER_PHASE_BITS;
+    int one = 1 << MIXER_GAIN_BITS;
+
+    for( int p=0; p<numPhases; p++ ) {
+        double t = (double)p / numPhases;
+        double w[4];
+
+        if( inSincResampling ) {
+            double sum = 0;
+            for( int k=0; k<4; k++ ) {
+                w[k] = lanczos2( ( k - 1 ) - t );
+                sum += w[k];
+                }
+            for( int k=0; k<4; k++ ) {
+                w[k] /= sum;
+                }
+            }
+        else {
+            // Catmull-Rom
+            double t2 = t * t;
+            double t3 = t2 * t;
+            w[0] = 0.5 * ( -t3 + 2 * t2 - t );
+            w[1] = 0.5 * ( 3 * t3 - 5 * t2 + 2 );
+            w[2] = 0.5 * ( -3 * t3 + 4 * t2 + t );
+            w[3] = 0.5 * ( t3 - t2 );
+            }
+
+        // quantize so taps sum to exactly one
+        int16_t *taps = &( mTable[ p * 4 ] );
+        int sum = 0;
+        int largest = 1;
+        for( int k=0; k<4; k++ ) {
+            taps[k] = (int16_t)lrint( w[k] * one );
+            sum += taps[k];
+            if( taps[k] > taps[largest] ) {
+                largest = k;
+                }
+            }
+        taps[largest] += one - sum;
+        }
+    }
+
+
+
+SoundSpriteMixer::~SoundSpriteMixer() {
+    }
+
+
+
+int16_t *SoundSpriteMixer::allocSamples( int inNumSamples ) {
+    int16_t *storage = new int16_t[ inNumSamples + 2 * MIXER_PAD_SAMPLES ];
+    memset( storage, 0,
+            sizeof( int16_t ) * ( inNumSamples + 2 * MIXER_PAD_SAMPLES ) );
+
+    return &( storage[ MIXER_PAD_SAMPLES ] );
+    }
+
+
+
+void SoundSpriteMixer::freeSamples( int16_t *inSamples ) {
+    delete [] ( inSamples - MIXER_PAD_SAMPLES );
+    }
+
+
+
+static int16_t toGain( double inVolume ) {
+    long gain = lrint( inVolume * ( 1 << MIXER_GAIN_BITS ) );
+    if( gain > 32767 ) {
+        gain = 32767;
+        }
+    if( gain < -32767 ) {
+        gain = -32767;
+        }
+    return (int16_t)gain;
+    }
+
+
+
+void SoundSpriteMixer::addVoice( int16_t *inSamples, int inNumSamples,
+                                 double inRate,
+                                 double inVolumeL, double inVolumeR,
+                                 int inTag ) {
+    MixerVoice v;
+
+    v.samples = inSamples;
+    v.numSamples = inNumSamples;
+    v.stream = NULL;
+    v.position = 0;
+    v.fraction = 0;
+
+    v.unitRate = ( inRate == 1.0 );
+
+    double whole = floor( inRate );
+    v.stepWhole = (int)whole;
+    v.stepFraction = (uint32_t)( ( inRate - whole ) * 4294967296.0 );
+
+    v.gainL = toGain( inVolumeL );
+    v.gainR = toGain( inVolumeR );
+
+    v.tag = inTag;
+
+    mVoices.push_back( v );
+    }
+
+
+
+void SoundSpriteMixer::addStreamVoice( MixerStream *inStream,
+                                       int inNumSamples, double inRate,
+                                       double inVolumeL, double inVolumeR,
+                                       int inTag ) {
+    if( inRate > MIXER_MAX_STREAM_RATE ) {
+        inRate = MIXER_MAX_STREAM_RATE;
+        }
+
+    addVoice( NULL, inNumSamples, inRate, inVolumeL, inVolumeR, inTag );
+
+    mVoices.getElement( mVoices.size() - 1 )->stream = inStream;
+    }
+
+
+
+MixerStream *SoundSpriteMixer::getStoppedStream() {
+    int numStopped = mStoppedStreams.size();
+
+    if( numStopped == 0 ) {
+        return NULL;
+        }
+
+    MixerStream *stream = mStoppedStreams.getElementDirect( numStopped - 1 );
+    mStoppedStreams.deleteElement( numStopped - 1 );
+
+    return stream;
+    }
+
+
+
+int SoundSpriteMixer::getNumVoices() {
+    return mVoices.size();
+    }
+
+
+
+char SoundSpriteMixer::isPlaying( int inTag ) {
+    for( int i=0; i<mVoices.size(); i++ ) {
+        if( mVoices.getElement( i )->tag == inTag ) {
+            return true;
+            }
+        }
+    return false;
+    }
+
+
+
+void SoundSpriteMixer::removeVoice( int inIndex ) {
+    MixerStream *stream = mVoices.getElement( inIndex )->stream;
+
+    if( stream != NULL ) {
+        mStoppedStreams.push_back( stream );
+        }
+
+    mVoices.deleteElement( inIndex );
+    }
+
+
+
+void SoundSpriteMixer::removeVoices( int inTag ) {
+    for( int i=mVoices.size()-1; i>=0; i-- ) {
+        if( mVoices.getElement( i )->tag == inTag ) {
+            removeVoice( i );
+            }
+        }
+    }
+
+
+
+void SoundSpriteMixer::removeAllVoices() {
+    for( int i=mVoices.size()-1; i>=0; i-- ) {
+        removeVoice( i );
+        }
+    }
+
+
+
+int SoundSpriteMixer::resampleVoice( MixerVoice *inVoice, int inNumFrames ) {
+
+    // same end point as linear interpolation between neighbors
+    int limit = inVoice->numSamples - 1;
+
+    int position = inVoice->position;
+    uint32_t fraction = inVoice->fraction;
+
+    int n = 0;
+
+    while( n < inNumFrames && position < limit ) {
+        mTapIndex[n] = position - 1;
+        mTapPhase[n] = ( fraction >> ( 32 - MIXER_PHASE_BITS ) ) * 4;
+
+        uint32_t newFraction = fraction + inVoice->stepFraction;
+        position += inVoice->stepWhole;
+        if( newFraction < fraction ) {
+            // carry
+            position++;
+            }
+        fraction = newFraction;
+        n++;
+        }
+
+    inVoice->position = position;
+    inVoice->fraction = fraction;
+
+
+    int16_t *samples = inVoice->samples;
+
+#ifdef __SSE2__
+    // finish last group of four with harmless taps in the padding
+    int numGroups = ( n + 3 ) / 4;
+    for( int i=n; i<numGroups * 4; i++ ) {
+        mTapIndex[i] = -1;
+        mTapPhase[i] = 0;
+        }
+
+    __m128i round = _mm_set1_epi32( 1 << ( MIXER_GAIN_BITS - 1 ) );
+
+    for( int g=0; g<numGroups; g++ ) {
+        int *index = &( mTapIndex[ g * 4 ] );
+        int *phase = &( mTapPhase[ g * 4 ] );
+
+        // taps for two outputs per register, one multiply-add
+        __m128i s01 = _mm_unpacklo_epi64(
+            _mm_loadl_epi64( (__m128i *)&( samples[ index[0] ] ) ),
+            _mm_loadl_epi64( (__m128i *)&( samples[ index[1] ] ) ) );
+        __m128i s23 = _mm_unpacklo_epi64(
+            _mm_loadl_epi64( (__m128i *)&( samples[ index[2] ] ) ),
+            _mm_loadl_epi64( (__m128i *)&( samples[ index[3] ] ) ) );
+
+        __m128i c01 = _mm_unpacklo_epi64(
+            _mm_loadl_epi64( (__m128i *)&( mTable[ phase[0] ] ) ),
+            _mm_loadl_epi64( (__m128i *)&( mTable[ phase[1] ] ) ) );
+        __m128i c23 = _mm_unpacklo_epi64(
+            _mm_loadl_epi64( (__m128i *)&( mTable[ phase[2] ] ) ),
+            _mm_loadl_epi64( (__m128i *)&( mTable[ phase[3] ] ) ) );
+
+        // pairwise tap sums, two per output
+        __m128 m01 = _mm_castsi128_ps( _mm_madd_epi16( s01, c01 ) );
+        __m128 m23 = _mm_castsi128_ps( _mm_madd_epi16( s23, c23 ) );
+
+        __m128i even = _mm_castps_si128(
+            _mm_shuffle_ps( m01, m23, _MM_SHUFFLE( 2, 0, 2, 0 ) ) );
+        __m128i odd = _mm_castps_si128(
+            _mm_shuffle_ps( m01, m23, _MM_SHUFFLE( 3, 1, 3, 1 ) ) );
+
+        __m128i sum = _mm_add_epi32( _mm_add_epi32( even, odd ), round );
+        sum = _mm_srai_epi32( sum, MIXER_GAIN_BITS );
+
+        _mm_storel_epi64( (__m128i *)&( mResampled[ g * 4 ] ),
+                          _mm_packs_epi32( sum, sum ) );
+        }
+#else
+    for( int i=0; i<n; i++ ) {
+        int16_t *s = &( samples[ mTapIndex[i] ] );
+        int16_t *c = &( mTable[ mTapPhase[i] ] );
+
+        int sum = s[0] * c[0] + s[1] * c[1] + s[2] * c[2] + s[3] * c[3];
+        sum = ( sum + ( 1 << ( MIXER_GAIN_BITS - 1 ) ) ) >> MIXER_GAIN_BITS;
+
+        if( sum > 32767 ) {
+            sum = 32767;
+            }
+        else if( sum < -32768 ) {
+            sum = -32768;
+            }
+        mResampled[i] = (int16_t)sum;
+        }
+#endif
+
+    // addScaled reads whole groups
+    memset( &( mResampled[n] ), 0, sizeof( int16_t ) * 8 );
+
+    return n;
+    }
+
+
+
+void SoundSpriteMixer::addScaled( int16_t *inMono, int inNumFrames,
+                                  int16_t inGainL, int16_t inGainR,
+                                  int32_t *ioSum ) {
+#ifdef __SSE2__
+    // reads and sums up to 7 frames past inNumFrames, which callers
+    // either pad with zeros or ignore
+    __m128i gains = _mm_set_epi16( inGainR, inGainL, inGainR, inGainL,
+                                   inGainR, inGainL, inGainR, inGainL );
+
+    for( int i=0; i<inNumFrames; i+=8 ) {
+        __m128i s = _mm_loadu_si128( (__m128i *)&( inMono[i] ) );
+
+        // each sample twice, once per channel
+        __m128i halves[2];
+        halves[0] = _mm_unpacklo_epi16( s, s );
+        halves[1] = _mm_unpackhi_epi16( s, s );
+
+        for( int h=0; h<2; h++ ) {
+            __m128i low = _mm_mullo_epi16( halves[h], gains );
+            __m128i high = _mm_mulhi_epi16( halves[h], gains );
+
+            __m128i p0 = _mm_srai_epi32( _mm_unpacklo_epi16( low, high ),
+                                         MIXER_ACCUM_SHIFT );
+            __m128i p1 = _mm_srai_epi32( _mm_unpackhi_epi16( low, high ),
+                                         MIXER_ACCUM_SHIFT );
+
+            __m128i *sum = (__m128i *)&( ioSum[ 2 * i + 8 * h ] );
+
+            _mm_storeu_si128( sum,
+                              _mm_add_epi32( _mm_loadu_si128( sum ), p0 ) );
+            _mm_storeu_si128( sum + 1,
+                              _mm_add_epi32( _mm_loadu_si128( sum + 1 ),
+                                             p1 ) );
+            }
+        }
+#else
+    for( int i=0; i<inNumFrames; i++ ) {
+        int s = inMono[i];
+        ioSum[ 2 * i ] += ( s * inGainL ) >> MIXER_ACCUM_SHIFT;
+        ioSum[ 2 * i + 1 ] += ( s * inGainR ) >> MIXER_ACCUM_SHIFT;
+        }
+#endif
+    }
+
+
+
+void SoundSpriteMixer::sumVoice( MixerVoice *inVoice, int inNumFrames,
+                                 int32_t *ioSum ) {
+    if( inVoice->unitRate ) {
+        int n = inVoice->numSamples - inVoice->position;
+        if( n > inNumFrames ) {
+            n = inNumFrames;
+            }
+        if( n > 0 ) {
+            addScaled( &( inVoice->samples[ inVoice->position ] ), n,
+                       inVoice->gainL, inVoice->gainR, ioSum );
+            inVoice->position += n;
+            }
+        }
+    else {
+        int n = resampleVoice( inVoice, inNumFrames );
+        if( n > 0 ) {
+            addScaled( mResampled, n,
+                       inVoice->gainL, inVoice->gainR, ioSum );
+            }
+        }
+    }
+
+
+
+void SoundSpriteMixer::sumStreamVoice( MixerVoice *inVoice, int inNumFrames,
+                                       int32_t *ioSum ) {
+
+    uint64_t step = (uint64_t)inVoice->stepWhole << 32 |
+        inVoice->stepFraction;
+
+    // furthest tap this block can read, relative to position
+    int span = (int)( ( inVoice->fraction +
+                        (uint64_t)inNumFrames * step ) >> 32 ) + 3;
+
+    // one tap before position, and padding for whole-group reads after
+    int windowLength = span + 1 + MIXER_PAD_SAMPLES;
+
+    inVoice->stream->readSamples( inVoice->position - 1, windowLength,
+                                  mStreamWindow );
+
+    // same voice, playing from the window
+    MixerVoice windowVoice = *inVoice;
+    windowVoice.samples = &( mStreamWindow[1] );
+    windowVoice.numSamples = inVoice->numSamples - inVoice->position;
+    windowVoice.position = 0;
+
+    sumVoice( &windowVoice, inNumFrames, ioSum );
+
+    inVoice->position += windowVoice.position;
+    inVoice->fraction = windowVoice.fraction;
+    }
+
+
+
+void SoundSpriteMixer::sumVoices( int inNumFrames, int32_t *outSum ) {
+    memset( outSum, 0, sizeof( int32_t ) * 2 * ( inNumFrames + 8 ) );
+
+    int numVoices = mVoices.size();
+
+    for( int v=0; v<numVoices; v++ ) {
+        MixerVoice *voice = mVoices.getElement( v );
+
+        if( voice->stream != NULL ) {
+            sumStreamVoice( voice, inNumFrames, outSum );
+            }
+        else {
+            sumVoice( voice, inNumFrames, outSum );
+            }
+        }
+    }
+
+
+
+void SoundSpriteMixer::mix( unsigned char *ioStream, int inNumFrames,
+                            NoClip *inVoiceLimiter, double inNormalizeFactor,
+                            float *ioLoudness, float inFadePerSample,
+                            NoClip *inTotalLimiter ) {
+
+    double sumScale = 1.0 / ( 1 << ( MIXER_GAIN_BITS - MIXER_ACCUM_SHIFT ) );
+
+    float loudness = *ioLoudness;
+
+    for( int start=0; start<inNumFrames; start += MIXER_BLOCK_FRAMES ) {
+        int n = inNumFrames - start;
+        if( n > MIXER_BLOCK_FRAMES ) {
+            n = MIXER_BLOCK_FRAMES;
+            }
+
+        sumVoices( n, mSum );
+
+        unsigned char *stream = &( ioStream[ 4 * start ] );
+
+        for( int i=0; i<n; i++ ) {
+            double l = mSum[ 2 * i ] * sumScale;
+            double r = mSum[ 2 * i + 1 ] * sumScale;
+
+            double maxVal = fabs( l );
+            if( fabs( r ) > maxVal ) {
+                maxVal = fabs( r );
+                }
+
+            // voice cap, normalization, and loudness in one gain
+            double gain = audioNoClipGain( inVoiceLimiter, maxVal ) *
+                inNormalizeFactor * loudness;
+
+            if( inFadePerSample != 0 ) {
+                loudness -= inFadePerSample;
+                if( loudness < 0.0f ) {
+                    loudness = 0.0f;
+                    }
+                }
+
+            int16_t streamL = (int16_t)( stream[1] << 8 | stream[0] );
+            int16_t streamR = (int16_t)( stream[3] << 8 | stream[2] );
+
+            l = l * gain + streamL;
+            r = r * gain + streamR;
+
+            maxVal = fabs( l );
+            if( fabs( r ) > maxVal ) {
+                maxVal = fabs( r );
+                }
+
+            gain = audioNoClipGain( inTotalLimiter, maxVal );
+
+            long outL = lrint( l * gain );
+            long outR = lrint( r * gain );
+
+            if( outL > 32767 ) {
+                outL = 32767;
+                }
+            else if( outL < -32768 ) {
+                outL = -32768;
+                }
+            if( outR > 32767 ) {
+                outR = 32767;
+                }
+            else if( outR < -32768 ) {
+                outR = -32768;
+                }
+
+            stream[0] = (unsigned char)( outL & 0xFF );
+            stream[1] = (unsigned char)( ( outL >> 8 ) & 0xFF );
+            stream[2] = (unsigned char)( outR & 0xFF );
+            stream[3] = (unsigned char)( ( outR >> 8 ) & 0xFF );
+            stream += 4;
+            }
+        }
+
+    *ioLoudness = loudness;
+
+
+    if( loudness == 0 ) {
+        // faded out completely
+        removeAllVoices();
+        return;
+        }
+
+    for( int i=mVoices.size()-1; i>=0; i-- ) {
+        MixerVoice *voice = mVoices.getElement( i );
+
+        int end = voice->numSamples;
+        if( ! voice->unitRate ) {
+            end--;
+            }
+
+        if( voice->position >= end ) {
+            removeVoice( i );
+            }
+        }
+    }
@@ -0,0 +1,262 @@
+#ifndef SOUND_SPRITE_MIXER_INCLUDED
+#define SOUND_SPRITE_MIXER_INCLUDED
+
+
+#include "minorGems/sound/audioNoClip.h"
+#include "minorGems/util/SimpleVector.h"
+
+#include <stdint.h>
+
+
+
+// zero samples kept before and after every mixer sound, so block loops
+// and resampling taps can read past either end without bounds checks
+#define MIXER_PAD_SAMPLES 8
+
+// frames mixed per internal block
+#define MIXER_BLOCK_FRAMES 256
+
+// fractional bits of voice gains
+#define MIXER_GAIN_BITS 14
+
+// voice products are shifted down by this much before summing, leaving
+// MIXER_GAIN_BITS - MIXER_ACCUM_SHIFT fractional bits in the sum
+#define MIXER_ACCUM_SHIFT 8
+
+// resampling table has 1 << MIXER_PHASE_BITS phases of 4 taps each
+#define MIXER_PHASE_BITS 8
+
+// streamed voices play no faster than this
+#define MIXER_MAX_STREAM_RATE 8
+
+
+
+/**
+ * Source of samples for a voice that is not held in memory all at once.
+ */
+class MixerStream {
+
+    public:
+
+        virtual ~MixerStream() {
+            }
+
+
+        /**
+         * Copies samples out of the stream.
+         *
+         * Called from the mixing thread, so must not block.  Starts never
+         * decrease from one call to the next, so samples before inStart
+         * can be discarded.
+         *
+         * @param inStart the first sample, may be -1.
+         * @param inCount the number of samples.
+         * @param outSamples where to put them.  Samples before the
+         *   start of the sound, past its end, or not yet available are
+         *   set to zero.
+         */
+        virtual void readSamples( int inStart, int inCount,
+                                  int16_t *outSamples ) = 0;
+    };
+
+
+
+typedef struct MixerVoice {
+        // padded samples, from SoundSpriteMixer::allocSamples
+        int16_t *samples;
+        int numSamples;
+
+        // or NULL for voices that play from samples
+        MixerStream *stream;
+
+        // read position, whole and 32-bit fractional parts
+        int position;
+        uint32_t fraction;
+
+        int stepWhole;
+        uint32_t stepFraction;
+        char unitRate;
+
+        int16_t gainL;
+        int16_t gainR;
+
+        int tag;
+    } MixerVoice;
+
+
+
+/**
+ * Mixes many playing 16-bit mono sound sprites into a stereo stream.
+ *
+ * Voices are summed in fixed point, a block at a time, with separate
+ * loops for unit-rate voices (straight multiply-add from the sprite) and
+ * variable-rate voices (4-tap polyphase resampling from a precomputed
+ * table).  Both use SSE2 where available.  Limiting, normalization,
+ * loudness fades, and the final mix with the rest of the stream happen
+ * in a single pass per block.
+ *
+ * Not thread-safe.  Callers that mix from an audio thread must lock
+ * around addVoice and removeVoices.
+ */
+class SoundSpriteMixer {
+
+    public:
+
+        /**
+         * Constructs a mixer.
+         *
+         * @param inSincResampling true to resample variable-rate voices
+         *   with a windowed-sinc (Lanczos, 2 lobes) table, false for a
+         *   Catmull-Rom cubic table.  Both use 4 taps.
+         */
+        SoundSpriteMixer( char inSincResampling = false );
+
+        ~SoundSpriteMixer();
+
+
+        /**
+         * Allocates zeroed sample storage in the padded layout voices need.
+         *
+         * @param inNumSamples the number of samples.
+         *
+         * @return storage for inNumSamples samples.  Must be freed by
+         *   caller with freeSamples.
+         */
+        static int16_t *allocSamples( int inNumSamples );
+
+        static void freeSamples( int16_t *inSamples );
+
+
+        /**
+         * Starts a voice.
+         *
+         * @param inSamples samples from allocSamples.  Not copied, must
+         *   stay allocated until the voice finishes or is removed.
+         * @param inNumSamples the number of samples.
+         * @param inRate playback rate, 1 for original pitch.
+         * @param inVolumeL, inVolumeR channel volumes, below 2.
+         * @param inTag caller's value for removeVoices.
+         */
+        void addVoice( int16_t *inSamples, int inNumSamples,
+                       double inRate, double inVolumeL, double inVolumeR,
+                       int inTag );
+
+
+        /**
+         * Starts a voice that pulls its samples from a stream.
+         *
+         * @param inStream the stream.  Not destroyed by mixer.  Once the
+         *   voice finishes or is removed, the stream is returned by
+         *   getStoppedStream.
+         * @param inNumSamples the length of the stream.
+         * @param inRate playback rate, at most MIXER_MAX_STREAM_RATE.
+         * Other parameters as for addVoice.
+         */
+        void addStreamVoice( MixerStream *inStream, int inNumSamples,
+                             double inRate,
+                             double inVolumeL, double inVolumeR,
+                             int inTag );
+
+
+        /**
+         * Gets a stream whose voice has stopped, so the caller can destroy
+         * it outside of the mixing thread.
+         *
+         * @return a stopped stream, or NULL if there are none.
+         */
+        MixerStream *getStoppedStream();
+
+
+        int getNumVoices();
+
+
+        // true if any voice with this tag is playing
+        char isPlaying( int inTag );
+
+
+        // stops all voices with a given tag
+        void removeVoices( int inTag );
+
+        void removeAllVoices();
+
+
+
+        /**
+         * Mixes all voices into a stream, advancing them and removing those
+         * that finish.
+         *
+         * For each stereo sample, the voice sum is limited by
+         * inVoiceLimiter, scaled by inNormalizeFactor and *ioLoudness,
+         * added to the stream, limited by inTotalLimiter, and written back.
+         *
+         * @param ioStream interleaved stereo 16-bit little-endian samples.
+         * @param inNumFrames the number of stereo samples in ioStream.
+         * @param inVoiceLimiter limiter for the voice sum.
+         * @param inNormalizeFactor gain applied after inVoiceLimiter.
+         * @param ioLoudness loudness of the voice sum.  Reduced by
+         *   inFadePerSample per stereo sample, stopping at 0.  All voices
+         *   are removed once it reaches 0.
+         * @param inFadePerSample the fade step, or 0 for no fade.
+         * @param inTotalLimiter limiter for the final mix.
+         */
+        void mix( unsigned char *ioStream, int inNumFrames,
+                  NoClip *inVoiceLimiter, double inNormalizeFactor,
+                  float *ioLoudness, float inFadePerSample,
+                  NoClip *inTotalLimiter );
+
+
+
+        /**
+         * Sums a block of all voices, advancing them but not removing
+         * finished ones.
+         *
+         * @param inNumFrames at most MIXER_BLOCK_FRAMES.
+         * @param outSum interleaved stereo sum, with
+         *   MIXER_GAIN_BITS - MIXER_ACCUM_SHIFT fractional bits.  Must
+         *   hold 2 * ( MIXER_BLOCK_FRAMES + 8 ) values.
+         */
+        void sumVoices( int inNumFrames, int32_t *outSum );
+
+
+    protected:
+
+        SimpleVector<MixerVoice> mVoices;
+
+        SimpleVector<MixerStream *> mStoppedStreams;
+
+        // [phase][tap], taps for positions -1, 0, 1, 2
+        int16_t mTable[ ( 1 << MIXER_PHASE_BITS ) * 4 ];
+
+        int32_t mSum[ 2 * ( MIXER_BLOCK_FRAMES + 8 ) ];
+
+        int16_t mResampled[ MIXER_BLOCK_FRAMES + 8 ];
+        int mTapIndex[ MIXER_BLOCK_FRAMES + 4 ];
+        int mTapPhase[ MIXER_BLOCK_FRAMES + 4 ];
+
+        // window of a streamed voice for one block, plus taps and padding
+        int16_t mStreamWindow[ MIXER_BLOCK_FRAMES * MIXER_MAX_STREAM_RATE +
+                               2 * MIXER_PAD_SAMPLES ];
+
+
+        // resamples a variable-rate voice into mResampled
+        // returns number of frames produced
+        int resampleVoice( MixerVoice *inVoice, int inNumFrames );
+
+        // adds mono samples into mSum-style stereo sums
+        void addScaled( int16_t *inMono, int inNumFrames,
+                        int16_t inGainL, int16_t inGainR, int32_t *ioSum );
+
+        // sums one voice that plays from samples
+        void sumVoice( MixerVoice *inVoice, int inNumFrames,
+                       int32_t *ioSum );
+
+        // sums one voice through mStreamWindow
+        void sumStreamVoice( MixerVoice *inVoice, int inNumFrames,
+                             int32_t *ioSum );
+
+        void removeVoice( int inIndex );
+    };
+
+
+
+#endif
@@ -0,0 +1,204 @@
+#include "StreamedSound.h"
+
+#include "minorGems/sound/formats/aiff.h"
+
+#include <string.h>
+
+
+
+// samples converted per stream per pass of the reader thread
+#define STREAM_FILL_CHUNK 8192
+
+// file pages are released in runs at least this long
+#define STREAM_RELEASE_BYTES 262144
+
+
+
+StreamedSound::StreamedSound( MappedFile *inFile, int inSampleOffset,
+                              int inNumSamples, int inRingSamples )
+    : mFile( inFile ), mSampleOffset( inSampleOffset ),
+      mNumSamples( inNumSamples ), mRingSize( inRingSamples ),
+      mRingStart( 0 ), mRingEnd( 0 ), mReleasedBytes( 0 ) {
+
+    mRing = new int16_t[ mRingSize ];
+    }
+
+
+
+StreamedSound::~StreamedSound() {
+    delete [] mRing;
+    }
+
+
+
+int StreamedSound::getBufferBytes() {
+    return mRingSize * (int)sizeof( int16_t );
+    }
+
+
+
+void StreamedSound::readSamples( int inStart, int inCount,
+                                 int16_t *outSamples ) {
+    mLock.lock();
+    int ringEnd = mRingEnd;
+    mLock.unlock();
+
+    // available part of the request
+    int start = inStart;
+    if( start < 0 ) {
+        start = 0;
+        }
+    int end = inStart + inCount;
+    if( end > ringEnd ) {
+        end = ringEnd;
+        }
+
+    if( end <= start ) {
+        // underrun, or entirely before the start
+        memset( outSamples, 0, sizeof( int16_t ) * inCount );
+        }
+    else {
+        memset( outSamples, 0, sizeof( int16_t ) * ( start - inStart ) );
+
+        int out = start - inStart;
+        int i = start;
+        while( i < end ) {
+            int slot = i % mRingSize;
+            int length = mRingSize - slot;
+            if( length > end - i ) {
+                length = end - i;
+                }
+            memcpy( &( outSamples[ out ] ), &( mRing[ slot ] ),
+                    sizeof( int16_t ) * length );
+            out += length;
+            i += length;
+            }
+
+        memset( &( outSamples[ out ] ), 0,
+                sizeof( int16_t ) * ( inCount - out ) );
+        }
+
+
+    // samples before inStart won't be read again
+    mLock.lock();
+    if( inStart > mRingStart ) {
+        mRingStart = inStart;
+        }
+    if( mRingStart > mRingEnd ) {
+        // fell behind, skip what was missed
+        mRingEnd = mRingStart;
+        }
+    mLock.unlock();
+    }
+
+
+
+int StreamedSound::fill( int inMaxSamples ) {
+    mLock.lock();
+    int ringStart = mRingStart;
+    int ringEnd = mRingEnd;
+    mLock.unlock();
+
+    int n = ringStart + mRingSize - ringEnd;
+    if( n > mNumSamples - ringEnd ) {
+        n = mNumSamples - ringEnd;
+        }
+    if( n > inMaxSamples ) {
+        n = inMaxSamples;
+        }
+    if( n <= 0 ) {
+        return 0;
+        }
+
+    // slots from ringEnd on are not being read
+    unsigned char *data = mFile->getData() + mSampleOffset;
+
+    int i = ringEnd;
+    while( i < ringEnd + n ) {
+        int slot = i % mRingSize;
+        int length = mRingSize - slot;
+        if( length > ringEnd + n - i ) {
+            length = ringEnd + n - i;
+            }
+        convertBigEndian16( &( data[ 2 * i ] ), length, &( mRing[ slot ] ) );
+        i += length;
+        }
+
+    mLock.lock();
+    if( mRingEnd == ringEnd ) {
+        mRingEnd = ringEnd + n;
+        }
+    // else reader skipped ahead, and this chunk is stale
+    mLock.unlock();
+
+
+    int convertedBytes = 2 * ( ringEnd + n );
+    if( convertedBytes - mReleasedBytes >= STREAM_RELEASE_BYTES ||
+        ringEnd + n == mNumSamples ) {
+
+        mFile->releaseRange( mSampleOffset + mReleasedBytes,
+                             convertedBytes - mReleasedBytes );
+        mReleasedBytes = convertedBytes;
+        }
+
+    return n;
+    }
+
+
+
+SoundStreamReader::SoundStreamReader()
+    : mStopped( false ) {
+    start();
+    }
+
+
+
+SoundStreamReader::~SoundStreamReader() {
+    mLock.lock();
+    mStopped = true;
+    mLock.unlock();
+
+    join();
+    }
+
+
+
+void SoundStreamReader::addStream( StreamedSound *inStream ) {
+    mLock.lock();
+    mStreams.push_back( inStream );
+    mLock.unlock();
+    }
+
+
+
+void SoundStreamReader::removeStream( StreamedSound *inStream ) {
+    mLock.lock();
+    mStreams.deleteElementEqualTo( inStream );
+    mLock.unlock();
+    }
+
+
+
+void SoundStreamReader::run() {
+    while( true ) {
+        mLock.lock();
+
+        if( mStopped ) {
+            mLock.unlock();
+            return;
+            }
+
+        int numFilled = 0;
+        for( int i=0; i<mStreams.size(); i++ ) {
+            numFilled +=
+                mStreams.getElementDirect( i )->fill( STREAM_FILL_CHUNK );
+            }
+
+        mLock.unlock();
+
+        if( numFilled == 0 ) {
+            // all rings full
+            staticSleep( 5 );
+            }
+        }
+    }
@@ -0,0 +1,121 @@
+#ifndef STREAMED_SOUND_INCLUDED
+#define STREAMED_SOUND_INCLUDED
+
+
+#include "minorGems/sound/SoundSpriteMixer.h"
+#include "minorGems/io/file/MappedFile.h"
+#include "minorGems/system/MutexLock.h"
+#include "minorGems/system/Thread.h"
+#include "minorGems/util/SimpleVector.h"
+
+
+
+/**
+ * One playback of a long sound from a mapped AIFF file.
+ *
+ * Samples are converted from the file's big-endian PCM into a small ring
+ * buffer a chunk at a time, ahead of the mixer, usually by a
+ * SoundStreamReader thread.  File pages behind the ring are released as
+ * playback moves on, so neither the file nor a decoded copy of it stays
+ * resident.
+ */
+class StreamedSound : public MixerStream {
+
+    public:
+
+        /**
+         * Constructs a stream.
+         *
+         * @param inFile the mapped file.  Destroyed by caller after this
+         *   stream is destroyed.
+         * @param inSampleOffset byte offset of the first big-endian sample
+         *   in inFile.
+         * @param inNumSamples the number of samples.
+         * @param inRingSamples the ring buffer size.
+         */
+        StreamedSound( MappedFile *inFile, int inSampleOffset,
+                       int inNumSamples, int inRingSamples = 32768 );
+
+        virtual ~StreamedSound();
+
+
+        virtual void readSamples( int inStart, int inCount,
+                                  int16_t *outSamples );
+
+
+        /**
+         * Converts more of the file into the ring buffer.  Safe to call
+         * while the mixer reads from another thread, but only one thread
+         * may fill at a time.
+         *
+         * @param inMaxSamples the most samples to convert.
+         *
+         * @return the number of samples converted, 0 if the ring is full
+         *   or the whole sound has been converted.
+         */
+        int fill( int inMaxSamples );
+
+
+        // size of the ring buffer
+        int getBufferBytes();
+
+
+    protected:
+
+        MappedFile *mFile;
+        int mSampleOffset;
+        int mNumSamples;
+
+        int16_t *mRing;
+        int mRingSize;
+
+        // guards mRingStart and mRingEnd
+        MutexLock mLock;
+
+        // sample numbers held in the ring, [mRingStart, mRingEnd)
+        int mRingStart;
+        int mRingEnd;
+
+        // file bytes before this have been released
+        int mReleasedBytes;
+    };
+
+
+
+/**
+ * Background thread that keeps StreamedSound ring buffers full.
+ */
+class SoundStreamReader : public Thread {
+
+    public:
+
+        // starts the thread
+        SoundStreamReader();
+
+        // stops and joins the thread
+        ~SoundStreamReader();
+
+
+        // inStream not destroyed by reader
+        void addStream( StreamedSound *inStream );
+
+        // once this returns, the reader never touches inStream again
+        void removeStream( StreamedSound *inStream );
+
+
+        virtual void run();
+
+
+    protected:
+
+        // guards mStreams and mStopped, held during each fill pass
+        MutexLock mLock;
+
+        SimpleVector<StreamedSound *> mStreams;
+
+        char mStopped;
+    };
+
+
+
+#endif
@@ -1,3 +1,5 @@
+#ifndef AUDIO_NO_CLIP_INCLUDED
+#define AUDIO_NO_CLIP_INCLUDED
 
 
 typedef struct NoClip {
@@ -29,3 +31,56 @@ void audioNoClip( NoClip *inC,
 
 
 
+// steps the limiter forward by one stereo sample, for callers that fuse
+// limiting into a larger per-sample pass
+//
+// inMaxVal is the larger absolute value of the sample's two channels
+//
+// returns the gain to apply to that sample
+inline double audioNoClipGain( NoClip *inC, double inMaxVal ) {
+        
+    // do nothing if signal is not clipping and gain is full
+    if( inC->gain == 1.0 && inMaxVal <= inC->maxVolume ) {
+        return 1.0;
+        }
+    
+    if( inC->gain != 1.0 
+        && 
+        ( inC->gain + inC->gainDecayPerSample ) * inMaxVal <= 
+        inC->maxVolume ) {
+        
+        inC->currentHoldTime++;
+        
+        if( inC->currentHoldTime > inC->holdTime ) {
+            
+            inC->gain += inC->gainDecayPerSample;
+            
+            if( inC->gain > 1.0 ) {
+                inC->gain = 1.0;
+                }
+            }
+        }
+    else if( inMaxVal * inC->gain > inC->maxVolume ) {
+        
+        // new peak
+        
+        // restart hold
+        inC->currentHoldTime = 0;
+        
+        // prevent clipping
+        inC->gain = inC->maxVolume / inMaxVal;
+        
+        inC->gainDecayPerSample = ( 1.0 - inC->gain ) / inC->decayTime;
+        }
+    else {
+        // not a new peak, not way under peak value
+        // hit old peak again, continue holding
+        inC->currentHoldTime = 0;
+        }
+    
+    return inC->gain;
+    }
+
+
+
+#endif
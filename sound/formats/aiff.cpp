@@ -11,6 +11,10 @@
 
 #include "minorGems/util/StringBufferOutputStream.h"
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 
 
 unsigned char *getAIFFHeader( int inNumChannels, int inSampleSizeInBits,
@@ -95,24 +99,24 @@ unsigned char *getAIFFHeader( int inNumChannels, int inSampleSizeInBits,
 
 
 
-int16_t *readMono16AIFFData( unsigned char *inData, int inNumBytes,
-                             int *outNumSamples, int *outSampleRate ) {
+int findMono16AIFFSamples( unsigned char *inData, int inNumBytes,
+                           int *outNumSamples, int *outSampleRate ) {
     
     if( inNumBytes < 34 ) {
         printf( "AIFF not long enough for header\n" );
-        return NULL;
+        return -1;
         }
     
     // byte 20 and 21 are num channels
 
     if( inData[20] != 0 || inData[21] != 1 ) {
         printf( "AIFF not mono\n" );
-        return NULL;
+        return -1;
         }
     
     if( inData[26] != 0 || inData[27] != 16 ) {
         printf( "AIFF not 16-bit\n" );
-        return NULL;
+        return -1;
         }
     
 
@@ -137,21 +141,57 @@ int16_t *readMono16AIFFData( unsigned char *inData, int inNumBytes,
     
     int numBytes = numSamples * 2;
                         
-    if( inNumBytes < sampleStartByte + numBytes ) {
+    if( numSamples < 0 || inNumBytes < sampleStartByte + numBytes ) {
         printf( "AIFF not long enough for inData\n" );
-        return NULL;
+        return -1;
         }
-    
-    int16_t *samples = new int16_t[numSamples];
-                            
 
-    int b = sampleStartByte;
-    for( int i=0; i<numSamples; i++ ) {
-        samples[i] = 
+    *outNumSamples = numSamples;
+
+    return sampleStartByte;
+    }
+
+
+
+void convertBigEndian16( unsigned char *inData, int inNumSamples,
+                         int16_t *outSamples ) {
+    int i = 0;
+
+#ifdef __SSE2__
+    // swap bytes within each 16-bit lane, 8 samples at a time
+    for( ; i + 8 <= inNumSamples; i += 8 ) {
+        __m128i v = _mm_loadu_si128( (__m128i *)&( inData[ 2 * i ] ) );
+        v = _mm_or_si128( _mm_slli_epi16( v, 8 ), _mm_srli_epi16( v, 8 ) );
+        _mm_storeu_si128( (__m128i *)&( outSamples[i] ), v );
+        }
+#endif
+
+    int b = 2 * i;
+    for( ; i<inNumSamples; i++ ) {
+        outSamples[i] = 
             ( inData[b] << 8 ) |
             inData[b+1];
         b += 2;
         }
+    }
+
+
+
+int16_t *readMono16AIFFData( unsigned char *inData, int inNumBytes,
+                             int *outNumSamples, int *outSampleRate ) {
+    
+    int numSamples;
+    int sampleStartByte = findMono16AIFFSamples( inData, inNumBytes,
+                                                 &numSamples, 
+                                                 outSampleRate );
+
+    if( sampleStartByte == -1 ) {
+        return NULL;
+        }
+    
+    int16_t *samples = new int16_t[numSamples];
+
+    convertBigEndian16( &( inData[ sampleStartByte ] ), numSamples, samples );
     
     *outNumSamples = numSamples;
                             
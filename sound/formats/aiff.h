@@ -41,4 +41,18 @@ int16_t *readMono16AIFFData( unsigned char *inData, int inNumBytes,
                              int *outSampleRate = NULL );
 
 
+
+// finds the big-endian samples of a mono 16-bit AIFF without copying them
+// returns byte offset of first sample in inData, or -1 on failure
+int findMono16AIFFSamples( unsigned char *inData, int inNumBytes,
+                           int *outNumSamples,
+                           int *outSampleRate = NULL );
+
+
+
+// converts big-endian 16-bit samples (as stored in AIFF files) to native
+void convertBigEndian16( unsigned char *inData, int inNumSamples,
+                         int16_t *outSamples );
+
+
 #endif
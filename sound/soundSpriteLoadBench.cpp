@@ -0,0 +1,389 @@
+// Benchmark for loading sound sprites from mapped AIFF files
+//
+// Usage:  soundSpriteLoadBench [numShortFiles] [longSeconds]
+//
+// Writes a folder of short AIFF files plus one long one, then loads the
+// short ones the way gameSDL used to (read whole file, convert to a
+// temporary array, copy into mixer storage), and again by mapping them
+// and decoding a tenth of them on "first play."  Reports time and growth
+// in resident memory for each, split into private memory and mapped file
+// pages (which the OS can drop and read again as needed).
+//
+// The long file is then played through a StreamedSound, at rate 1 and at
+// a resampled rate, and compared sample for sample against the same voice
+// played from fully decoded samples:  once with the ring filled by hand
+// between blocks, and once in real time with a SoundStreamReader thread.
+
+
+#include "SoundSpriteMixer.h"
+#include "StreamedSound.h"
+#include "formats/aiff.h"
+
+#include "minorGems/io/file/File.h"
+#include "minorGems/io/file/MappedFile.h"
+#include "minorGems/system/Thread.h"
+#include "minorGems/system/Time.h"
+#include "minorGems/util/random/CustomRandomSource.h"
+#include "minorGems/util/stringUtils.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+
+#define SAMPLE_RATE 44100
+#define SHORT_SAMPLES ( SAMPLE_RATE * 2 )
+#define BLOCK_FRAMES 512
+#define FOLDER_NAME "soundSpriteLoadBenchFiles"
+
+
+
+// resident memory in KiB, split into private pages and mapped file pages
+// (which the OS can drop at any time), or -1 where unknown
+static void getResidentKiB( long *outPrivate, long *outFile ) {
+    *outPrivate = -1;
+    *outFile = -1;
+#ifdef __linux__
+    FILE *f = fopen( "/proc/self/smaps_rollup", "r" );
+    if( f == NULL ) {
+        return;
+        }
+    long resident = -1;
+    long anonymous = -1;
+    char line[200];
+    while( fgets( line, sizeof( line ), f ) != NULL ) {
+        sscanf( line, "Rss: %ld", &resident );
+        sscanf( line, "Anonymous: %ld", &anonymous );
+        }
+    fclose( f );
+    if( resident != -1 && anonymous != -1 ) {
+        *outPrivate = anonymous;
+        *outFile = resident - anonymous;
+        }
+#endif
+    }
+
+
+
+typedef struct Measurement {
+        double startTime;
+        long startPrivate, startFile;
+    } Measurement;
+
+
+
+static void startMeasure( Measurement *outM ) {
+    getResidentKiB( &( outM->startPrivate ), &( outM->startFile ) );
+    outM->startTime = Time::getCurrentTime();
+    }
+
+
+
+static void printMeasure( Measurement *inM, const char *inLabel,
+                          const char *inResult ) {
+    double t = Time::getCurrentTime() - inM->startTime;
+    long privateKiB, fileKiB;
+    getResidentKiB( &privateKiB, &fileKiB );
+
+    printf( "%-34s %7.1f ms  %+7ld KiB private  %+7ld KiB file  %s\n",
+            inLabel, 1000 * t, privateKiB - inM->startPrivate,
+            fileKiB - inM->startFile, inResult );
+    }
+
+
+
+static File *getBenchFile( int inIndex ) {
+    char *name = autoSprintf( "sound%04d.aiff", inIndex );
+    File *f = new File( new Path( FOLDER_NAME ), name );
+    delete [] name;
+    return f;
+    }
+
+
+
+static void writeAIFF( File *inFile, int inNumSamples, double inFreq,
+                       CustomRandomSource *inRandSource ) {
+    int headerLength;
+    unsigned char *header = getAIFFHeader( 1, 16, SAMPLE_RATE, inNumSamples,
+                                           &headerLength );
+
+    int numBytes = headerLength + 2 * inNumSamples;
+    unsigned char *data = new unsigned char[ numBytes ];
+    memcpy( data, header, headerLength );
+    delete [] header;
+
+    for( int i=0; i<inNumSamples; i++ ) {
+        double t = (double)i / SAMPLE_RATE;
+        int16_t v = (int16_t)(
+            12000 * sin( 2 * M_PI * inFreq * t ) +
+            2000 * inRandSource->getRandomBoundedDouble( -1, 1 ) );
+        data[ headerLength + 2 * i ] = (unsigned char)( ( v >> 8 ) & 0xFF );
+        data[ headerLength + 2 * i + 1 ] = (unsigned char)( v & 0xFF );
+        }
+
+    inFile->writeToFile( data, numBytes );
+    delete [] data;
+    }
+
+
+
+// plays inNumFrames of the long sound from decoded samples and from a
+// stream at each of inRates, returns number of differing output bytes
+static int compareStreamed( MappedFile *inFile, int inOffset,
+                            int inNumSamples, int16_t *inDecoded,
+                            int inNumFrames, char inUseThread ) {
+
+    double rates[2] = { 1.0, 1.37 };
+    int numDiff = 0;
+
+    for( int r=0; r<2; r++ ) {
+        SoundSpriteMixer decodedMixer;
+        SoundSpriteMixer streamMixer;
+
+        decodedMixer.addVoice( inDecoded, inNumSamples, rates[r],
+                               0.6, 0.4, 0 );
+
+        StreamedSound *stream = new StreamedSound( inFile, inOffset,
+                                                   inNumSamples );
+        stream->fill( 16384 );
+        streamMixer.addStreamVoice( stream, inNumSamples, rates[r],
+                                    0.6, 0.4, 0 );
+
+        SoundStreamReader *reader = NULL;
+        if( inUseThread ) {
+            reader = new SoundStreamReader();
+            reader->addStream( stream );
+            }
+
+        NoClip limiters[4];
+        for( int i=0; i<4; i++ ) {
+            limiters[i] = resetAudioNoClip( 32767, SAMPLE_RATE / 2,
+                                            SAMPLE_RATE / 2 );
+            }
+        float loudnessA = 1.0f;
+        float loudnessB = 1.0f;
+
+        unsigned char a[ BLOCK_FRAMES * 4 ];
+        unsigned char b[ BLOCK_FRAMES * 4 ];
+
+        double blockSeconds = (double)BLOCK_FRAMES / SAMPLE_RATE;
+        double startTime = Time::getCurrentTime();
+
+        for( int f=0; f + BLOCK_FRAMES <= inNumFrames; f += BLOCK_FRAMES ) {
+            if( inUseThread ) {
+                // pace like an audio callback
+                int block = f / BLOCK_FRAMES;
+                double wait = startTime + block * blockSeconds -
+                    Time::getCurrentTime();
+                if( wait > 0 ) {
+                    Thread::staticSleep( (int)( wait * 1000 ) );
+                    }
+                }
+            else {
+                stream->fill( 8192 );
+                }
+
+            memset( a, 0, sizeof( a ) );
+            memset( b, 0, sizeof( b ) );
+            decodedMixer.mix( a, BLOCK_FRAMES, &( limiters[0] ), 1.0,
+                              &loudnessA, 0, &( limiters[1] ) );
+            streamMixer.mix( b, BLOCK_FRAMES, &( limiters[2] ), 1.0,
+                             &loudnessB, 0, &( limiters[3] ) );
+
+            for( int i=0; i<BLOCK_FRAMES * 4; i++ ) {
+                if( a[i] != b[i] ) {
+                    numDiff++;
+                    }
+                }
+            }
+
+        if( reader != NULL ) {
+            reader->removeStream( stream );
+            delete reader;
+            }
+
+        streamMixer.removeAllVoices();
+        while( streamMixer.getStoppedStream() != NULL ) {
+            }
+        delete stream;
+        }
+
+    return numDiff;
+    }
+
+
+
+int main( int inNumArgs, char **inArgs ) {
+
+    int numShortFiles = 400;
+    double longSeconds = 120;
+
+    if( inNumArgs > 1 ) {
+        numShortFiles = atoi( inArgs[1] );
+        }
+    if( inNumArgs > 2 ) {
+        longSeconds = atof( inArgs[2] );
+        }
+
+    int longSamples = (int)( longSeconds * SAMPLE_RATE );
+
+
+    File folder( NULL, FOLDER_NAME );
+    if( ! folder.exists() ) {
+        folder.makeDirectory();
+        }
+
+    CustomRandomSource randSource( 33 );
+
+    for( int i=0; i<=numShortFiles; i++ ) {
+        File *f = getBenchFile( i );
+        if( i < numShortFiles ) {
+            writeAIFF( f, SHORT_SAMPLES, 110 + i, &randSource );
+            }
+        else {
+            writeAIFF( f, longSamples, 220, &randSource );
+            }
+        delete f;
+        }
+
+    printf( "%d files of %.1f s, one of %.1f s, at %d Hz\n\n",
+            numShortFiles, (double)SHORT_SAMPLES / SAMPLE_RATE,
+            longSeconds, SAMPLE_RATE );
+
+
+    // old path, every file read and decoded up front
+    int16_t **oldSamples = new int16_t*[ numShortFiles ];
+
+    Measurement m;
+    startMeasure( &m );
+
+    for( int i=0; i<numShortFiles; i++ ) {
+        File *f = getBenchFile( i );
+        int numBytes;
+        unsigned char *data = f->readFileContents( &numBytes );
+        delete f;
+
+        int numSamples;
+        int16_t *samples = readMono16AIFFData( data, numBytes, &numSamples );
+        delete [] data;
+
+        oldSamples[i] = SoundSpriteMixer::allocSamples( numSamples );
+        memcpy( oldSamples[i], samples, numSamples * sizeof( int16_t ) );
+        delete [] samples;
+        }
+
+    printMeasure( &m, "read and decode all", "" );
+
+
+    // mapped, a tenth decoded when first played
+    MappedFile **files = new MappedFile*[ numShortFiles ];
+    int *offsets = new int[ numShortFiles ];
+    int16_t **newSamples = new int16_t*[ numShortFiles ];
+
+    startMeasure( &m );
+
+    for( int i=0; i<numShortFiles; i++ ) {
+        File *f = getBenchFile( i );
+        files[i] = new MappedFile( f );
+        delete f;
+
+        int numSamples;
+        offsets[i] = findMono16AIFFSamples( files[i]->getData(),
+                                            files[i]->getLength(),
+                                            &numSamples );
+        newSamples[i] = NULL;
+        }
+
+    printMeasure( &m, "map all", "" );
+
+    int numPlayed = 0;
+    for( int i=0; i<numShortFiles; i += 10 ) {
+        newSamples[i] = SoundSpriteMixer::allocSamples( SHORT_SAMPLES );
+        convertBigEndian16( &( files[i]->getData()[ offsets[i] ] ),
+                            SHORT_SAMPLES, newSamples[i] );
+        files[i]->releaseRange( offsets[i], SHORT_SAMPLES * 2 );
+        numPlayed++;
+        }
+
+
+
+    int numBad = 0;
+    for( int i=0; i<numShortFiles; i++ ) {
+        if( offsets[i] == -1 ) {
+            numBad++;
+            }
+        else if( newSamples[i] != NULL &&
+                 memcmp( newSamples[i], oldSamples[i],
+                         SHORT_SAMPLES * sizeof( int16_t ) ) != 0 ) {
+            numBad++;
+            }
+        }
+
+
+    char *label = autoSprintf( "map all, then decode %d on play",
+                               numPlayed );
+    printMeasure( &m, label, numBad == 0 ? "ok" : "MISMATCH" );
+    delete [] label;
+
+    for( int i=0; i<numShortFiles; i++ ) {
+        SoundSpriteMixer::freeSamples( oldSamples[i] );
+        if( newSamples[i] != NULL ) {
+            SoundSpriteMixer::freeSamples( newSamples[i] );
+            }
+        delete files[i];
+        }
+    delete [] oldSamples;
+    delete [] newSamples;
+    delete [] offsets;
+    delete [] files;
+
+
+    // long file, streamed
+    File *longFile = getBenchFile( numShortFiles );
+    MappedFile longMap( longFile );
+    delete longFile;
+
+    longMap.adviseSequential();
+
+    int numSamples;
+    int offset = findMono16AIFFSamples( longMap.getData(),
+                                        longMap.getLength(), &numSamples );
+
+    int16_t *decoded = SoundSpriteMixer::allocSamples( numSamples );
+    convertBigEndian16( &( longMap.getData()[ offset ] ), numSamples,
+                        decoded );
+
+    StreamedSound sizeCheck( &longMap, offset, numSamples );
+
+    printf( "\n%.1f s sound:  %d KiB decoded, %d KiB streaming buffer\n",
+            longSeconds, numSamples * 2 / 1024,
+            sizeCheck.getBufferBytes() / 1024 );
+
+    int fullDiff = compareStreamed( &longMap, offset, numSamples, decoded,
+                                    numSamples / 2, false );
+    printf( "streamed, filled between blocks:  %s\n",
+            fullDiff == 0 ? "ok" : "MISMATCH" );
+
+    int threadDiff = compareStreamed( &longMap, offset, numSamples, decoded,
+                                      SAMPLE_RATE * 3, true );
+    printf( "streamed, 3 s with reader thread:  %s\n",
+            threadDiff == 0 ? "ok" : "MISMATCH" );
+
+    SoundSpriteMixer::freeSamples( decoded );
+
+
+    for( int i=0; i<=numShortFiles; i++ ) {
+        File *f = getBenchFile( i );
+        f->remove();
+        delete f;
+        }
+    folder.remove();
+
+    if( numBad != 0 || fullDiff != 0 || threadDiff != 0 ) {
+        printf( "FAILED\n" );
+        return 1;
+        }
+    return 0;
+    }
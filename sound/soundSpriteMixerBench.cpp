@@ -0,0 +1,319 @@
+// Benchmark for SoundSpriteMixer
+//
+// Usage:  soundSpriteMixerBench [numVoices] [seconds] [blockFrames]
+//
+// Mixes voices over a music stream at 48 kHz the way the SDL audio
+// callback used to (doubles, floor/ceil linear interpolation, separate
+// limiter and normalization passes), then with SoundSpriteMixer, and
+// compares speed and output.  Half the voices play at rate 1, half at
+// random rates.
+
+
+#include "SoundSpriteMixer.h"
+
+#include "minorGems/system/Time.h"
+#include "minorGems/util/random/CustomRandomSource.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+
+#define SAMPLE_RATE 48000
+#define NUM_SPRITES 16
+
+
+
+typedef struct OldVoice {
+        int16_t *samples;
+        int numSamples;
+        int samplesPlayed;
+        double samplesPlayedF;
+        double rate;
+        double volumeL, volumeR;
+    } OldVoice;
+
+
+
+// the old per-sample mix, including its end-of-block passes
+static void oldMix( OldVoice *inVoices, int inNumVoices,
+                    unsigned char *ioStream, int inNumFrames,
+                    double *inBufferL, double *inBufferR,
+                    NoClip *inVoiceLimiter, double inNormalizeFactor,
+                    NoClip *inTotalLimiter ) {
+
+    for( int i=0; i<inNumFrames; i++ ) {
+        inBufferL[i] = 0.0;
+        inBufferR[i] = 0.0;
+        }
+
+    for( int v=0; v<inNumVoices; v++ ) {
+        OldVoice *s = &( inVoices[v] );
+        int filled = 0;
+
+        if( s->rate == 1 ) {
+            while( filled < inNumFrames && s->samplesPlayed < s->numSamples ) {
+                int16_t sample = s->samples[ s->samplesPlayed ];
+                inBufferL[ filled ] += s->volumeL * sample;
+                inBufferR[ filled ] += s->volumeR * sample;
+                filled++;
+                s->samplesPlayed++;
+                }
+            }
+        else {
+            while( filled < inNumFrames &&
+                   s->samplesPlayedF < s->numSamples - 1 ) {
+                int aIndex = (int)floor( s->samplesPlayedF );
+                int bIndex = (int)ceil( s->samplesPlayedF );
+                double bWeight = s->samplesPlayedF - aIndex;
+                double aWeight = 1 - bWeight;
+                double blend = s->samples[ aIndex ] * aWeight +
+                    s->samples[ bIndex ] * bWeight;
+                inBufferL[ filled ] += s->volumeL * blend;
+                inBufferR[ filled ] += s->volumeR * blend;
+                filled++;
+                s->samplesPlayedF += s->rate;
+                }
+            }
+        }
+
+    audioNoClip( inVoiceLimiter, inBufferL, inBufferR, inNumFrames );
+
+    if( inNormalizeFactor != 1.0 ) {
+        for( int i=0; i<inNumFrames; i++ ) {
+            inBufferL[i] *= inNormalizeFactor;
+            inBufferR[i] *= inNormalizeFactor;
+            }
+        }
+
+    int b = 0;
+    for( int i=0; i<inNumFrames; i++ ) {
+        int16_t l = (int16_t)( ( ioStream[b+1] << 8 ) | ioStream[b] );
+        int16_t r = (int16_t)( ( ioStream[b+3] << 8 ) | ioStream[b+2] );
+        b += 4;
+        inBufferL[i] += l;
+        inBufferR[i] += r;
+        }
+
+    audioNoClip( inTotalLimiter, inBufferL, inBufferR, inNumFrames );
+
+    b = 0;
+    for( int i=0; i<inNumFrames; i++ ) {
+        int16_t l = (int16_t)lrint( inBufferL[i] );
+        int16_t r = (int16_t)lrint( inBufferR[i] );
+        ioStream[b++] = (unsigned char)( l & 0xFF );
+        ioStream[b++] = (unsigned char)( ( l >> 8 ) & 0xFF );
+        ioStream[b++] = (unsigned char)( r & 0xFF );
+        ioStream[b++] = (unsigned char)( ( r >> 8 ) & 0xFF );
+        }
+    }
+
+
+
+// a quiet music bed for the voices to mix over
+static void fillMusic( unsigned char *outStream, int inFirstFrame,
+                       int inNumFrames ) {
+    int b = 0;
+    for( int i=0; i<inNumFrames; i++ ) {
+        double t = (double)( inFirstFrame + i ) / SAMPLE_RATE;
+        int16_t l = (int16_t)( 3000 * sin( 2 * M_PI * 220 * t ) );
+        int16_t r = (int16_t)( 3000 * sin( 2 * M_PI * 330 * t ) );
+        outStream[b++] = (unsigned char)( l & 0xFF );
+        outStream[b++] = (unsigned char)( ( l >> 8 ) & 0xFF );
+        outStream[b++] = (unsigned char)( r & 0xFF );
+        outStream[b++] = (unsigned char)( ( r >> 8 ) & 0xFF );
+        }
+    }
+
+
+
+static int16_t streamSample( unsigned char *inStream, int inIndex ) {
+    return (int16_t)( ( inStream[ 2 * inIndex + 1 ] << 8 ) |
+                      inStream[ 2 * inIndex ] );
+    }
+
+
+
+int main( int inNumArgs, char **inArgs ) {
+
+    int numVoices = 64;
+    double seconds = 10;
+    int blockFrames = 512;
+
+    if( inNumArgs > 1 ) {
+        numVoices = atoi( inArgs[1] );
+        }
+    if( inNumArgs > 2 ) {
+        seconds = atof( inArgs[2] );
+        }
+    if( inNumArgs > 3 ) {
+        blockFrames = atoi( inArgs[3] );
+        }
+
+    int totalFrames = (int)( seconds * SAMPLE_RATE );
+    int numBlocks = totalFrames / blockFrames;
+    totalFrames = numBlocks * blockFrames;
+
+    // long enough that no voice ends, rates up to 1.25
+    int spriteLength = totalFrames * 5 / 4 + 16;
+
+    CustomRandomSource randSource( 17 );
+
+    int16_t *sprites[ NUM_SPRITES ];
+    for( int s=0; s<NUM_SPRITES; s++ ) {
+        sprites[s] = SoundSpriteMixer::allocSamples( spriteLength );
+
+        double freq = 110 * ( s + 1 );
+        for( int i=0; i<spriteLength; i++ ) {
+            double t = (double)i / SAMPLE_RATE;
+            sprites[s][i] = (int16_t)(
+                12000 * sin( 2 * M_PI * freq * t ) +
+                2000 * randSource.getRandomBoundedDouble( -1, 1 ) );
+            }
+        }
+
+
+    OldVoice *oldVoices = new OldVoice[ numVoices ];
+    SoundSpriteMixer mixer;
+
+    for( int v=0; v<numVoices; v++ ) {
+        OldVoice *o = &( oldVoices[v] );
+        o->samples = sprites[ v % NUM_SPRITES ];
+        o->numSamples = spriteLength;
+        o->samplesPlayed = 0;
+        o->samplesPlayedF = 0;
+        o->rate = 1.0;
+        if( v % 2 == 1 ) {
+            o->rate = randSource.getRandomBoundedDouble( 0.8, 1.25 );
+            }
+
+        double volume = randSource.getRandomBoundedDouble( 0.02, 0.08 );
+        double p = M_PI * randSource.getRandomDouble() * 0.5;
+        o->volumeL = volume * cos( p );
+        o->volumeR = volume * sin( p );
+
+        mixer.addVoice( o->samples, o->numSamples, o->rate,
+                        o->volumeL, o->volumeR, v );
+        }
+
+
+    // same limiter settings as gameSDL defaults
+    NoClip oldVoiceLimiter = resetAudioNoClip( 32767, SAMPLE_RATE / 2,
+                                               SAMPLE_RATE / 2 );
+    NoClip oldTotalLimiter = resetAudioNoClip( 32767, SAMPLE_RATE / 20,
+                                               SAMPLE_RATE / 20 );
+    NoClip newVoiceLimiter = oldVoiceLimiter;
+    NoClip newTotalLimiter = oldTotalLimiter;
+
+
+    unsigned char *oldOut = new unsigned char[ totalFrames * 4 ];
+    unsigned char *newOut = new unsigned char[ totalFrames * 4 ];
+
+    for( int b=0; b<numBlocks; b++ ) {
+        fillMusic( &( oldOut[ b * blockFrames * 4 ] ),
+                   b * blockFrames, blockFrames );
+        }
+    memcpy( newOut, oldOut, totalFrames * 4 );
+
+    double *bufferL = new double[ blockFrames ];
+    double *bufferR = new double[ blockFrames ];
+
+
+    double t = Time::getCurrentTime();
+    for( int b=0; b<numBlocks; b++ ) {
+        oldMix( oldVoices, numVoices, &( oldOut[ b * blockFrames * 4 ] ),
+                blockFrames, bufferL, bufferR,
+                &oldVoiceLimiter, 1.0, &oldTotalLimiter );
+        }
+    double oldTime = Time::getCurrentTime() - t;
+
+
+    float loudness = 1.0f;
+
+    t = Time::getCurrentTime();
+    for( int b=0; b<numBlocks; b++ ) {
+        mixer.mix( &( newOut[ b * blockFrames * 4 ] ), blockFrames,
+                   &newVoiceLimiter, 1.0, &loudness, 0, &newTotalLimiter );
+        }
+    double newTime = Time::getCurrentTime() - t;
+
+
+    // difference between linear and cubic interpolation, plus rounding
+    double signalPower = 0;
+    double errorPower = 0;
+    int maxDiff = 0;
+    for( int i=0; i<totalFrames * 2; i++ ) {
+        int a = streamSample( oldOut, i );
+        int b = streamSample( newOut, i );
+        signalPower += (double)a * a;
+        errorPower += (double)( a - b ) * ( a - b );
+        if( abs( a - b ) > maxDiff ) {
+            maxDiff = abs( a - b );
+            }
+        }
+
+    double blockBudget = 1000.0 * blockFrames / SAMPLE_RATE;
+
+    printf( "%d voices, %.1f s at %d Hz, %d-frame blocks "
+            "(%.2f ms of audio each)\n\n",
+            numVoices, seconds, SAMPLE_RATE, blockFrames, blockBudget );
+
+    printf( "%-22s %8.3f ms per block, %5.1f%% of real time\n",
+            "old double mix", 1000 * oldTime / numBlocks,
+            100 * 1000 * oldTime / numBlocks / blockBudget );
+    printf( "%-22s %8.3f ms per block, %5.1f%% of real time  (%.1fx)\n",
+            "SoundSpriteMixer", 1000 * newTime / numBlocks,
+            100 * 1000 * newTime / numBlocks / blockBudget,
+            oldTime / newTime );
+
+    printf( "\noutput difference:  %.1f dB below signal, max %d\n",
+            10 * log10( signalPower / ( errorPower + 1 ) ), maxDiff );
+
+
+    // rate 1 voices alone should match to within rounding
+    SoundSpriteMixer unitMixer;
+    OldVoice unitVoice = oldVoices[0];
+    unitVoice.samplesPlayed = 0;
+    unitMixer.addVoice( unitVoice.samples, unitVoice.numSamples, 1.0,
+                        unitVoice.volumeL, unitVoice.volumeR, 0 );
+
+    NoClip limiters[4];
+    for( int i=0; i<4; i++ ) {
+        limiters[i] = resetAudioNoClip( 32767, SAMPLE_RATE / 2,
+                                        SAMPLE_RATE / 2 );
+        }
+
+    memset( oldOut, 0, blockFrames * 4 );
+    memset( newOut, 0, blockFrames * 4 );
+    oldMix( &unitVoice, 1, oldOut, blockFrames, bufferL, bufferR,
+            &( limiters[0] ), 1.0, &( limiters[1] ) );
+    unitMixer.mix( newOut, blockFrames, &( limiters[2] ), 1.0, &loudness, 0,
+                   &( limiters[3] ) );
+
+    int unitDiff = 0;
+    for( int i=0; i<blockFrames * 2; i++ ) {
+        int d = abs( streamSample( oldOut, i ) - streamSample( newOut, i ) );
+        if( d > unitDiff ) {
+            unitDiff = d;
+            }
+        }
+    printf( "rate 1 voice alone:  max difference %d\n", unitDiff );
+
+
+    delete [] bufferL;
+    delete [] bufferR;
+    delete [] oldOut;
+    delete [] newOut;
+    delete [] oldVoices;
+    for( int s=0; s<NUM_SPRITES; s++ ) {
+        SoundSpriteMixer::freeSamples( sprites[s] );
+        }
+
+    if( unitDiff > 1 ) {
+        printf( "FAILED\n" );
+        return 1;
+        }
+    return 0;
+    }
@@ -0,0 +1,180 @@
+#include "ThreadPool.h"
+
+
+#ifdef WIN_32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+
+
+class ThreadPoolWorker : public Thread {
+
+    public:
+
+        ThreadPoolWorker( ThreadPool *inPool )
+                : mPool( inPool ) {
+            }
+
+
+        virtual void run() {
+            while( true ) {
+                ThreadPoolJob *job = mPool->getNextJob();
+
+                if( job == NULL ) {
+                    return;
+                    }
+
+                job->runJob();
+
+                mPool->jobFinished();
+                }
+            }
+
+
+    protected:
+        ThreadPool *mPool;
+    };
+
+
+
+
+int ThreadPool::getNumCPUs() {
+    int num = 1;
+
+    #ifdef WIN_32
+        SYSTEM_INFO info;
+        GetSystemInfo( &info );
+        num = (int)info.dwNumberOfProcessors;
+    #elif defined( _SC_NPROCESSORS_ONLN )
+        num = (int)sysconf( _SC_NPROCESSORS_ONLN );
+    #endif
+
+    if( num < 1 ) {
+        num = 1;
+        }
+    return num;
+    }
+
+
+
+ThreadPool::ThreadPool( int inNumThreads )
+        : mJobsAvailable( 0 ), mAllDone( 0 ),
+          mQueueHead( 0 ), mNumOutstanding( 0 ),
+          mWaiting( false ), mStopping( false ) {
+
+    if( inNumThreads < 1 ) {
+        inNumThreads = getNumCPUs();
+        }
+
+    for( int i=0; i<inNumThreads; i++ ) {
+        Thread *t = new ThreadPoolWorker( this );
+        mWorkers.push_back( t );
+        t->start();
+        }
+    }
+
+
+
+ThreadPool::~ThreadPool() {
+    waitForAllJobs();
+
+    mLock.lock();
+    mStopping = true;
+    mLock.unlock();
+
+    int numWorkers = mWorkers.size();
+
+    for( int i=0; i<numWorkers; i++ ) {
+        mJobsAvailable.signal();
+        }
+
+    for( int i=0; i<numWorkers; i++ ) {
+        Thread *t = mWorkers.getElementDirect( i );
+        t->join();
+        delete t;
+        }
+    }
+
+
+
+int ThreadPool::getNumThreads() {
+    return mWorkers.size();
+    }
+
+
+
+void ThreadPool::addJob( ThreadPoolJob *inJob ) {
+    mLock.lock();
+
+    if( mQueueHead == mQueue.size() ) {
+        // everything handed out, reuse the space
+        mQueue.deleteAll();
+        mQueueHead = 0;
+        }
+
+    mQueue.push_back( inJob );
+    mNumOutstanding ++;
+
+    mLock.unlock();
+
+    mJobsAvailable.signal();
+    }
+
+
+
+ThreadPoolJob *ThreadPool::getNextJob() {
+    mJobsAvailable.wait();
+
+    mLock.lock();
+
+    ThreadPoolJob *job = NULL;
+
+    if( mQueueHead < mQueue.size() ) {
+        job = mQueue.getElementDirect( mQueueHead );
+        mQueueHead ++;
+        }
+    // else stopping
+
+    mLock.unlock();
+
+    return job;
+    }
+
+
+
+void ThreadPool::jobFinished() {
+    mLock.lock();
+
+    mNumOutstanding --;
+
+    char signalDone = false;
+
+    if( mNumOutstanding == 0 && mWaiting ) {
+        mWaiting = false;
+        signalDone = true;
+        }
+
+    mLock.unlock();
+
+    if( signalDone ) {
+        mAllDone.signal();
+        }
+    }
+
+
+
+void ThreadPool::waitForAllJobs() {
+    mLock.lock();
+
+    if( mNumOutstanding == 0 ) {
+        mLock.unlock();
+        return;
+        }
+
+    mWaiting = true;
+    mLock.unlock();
+
+    mAllDone.wait();
+    }
@@ -0,0 +1,106 @@
+#ifndef THREAD_POOL_INCLUDED
+#define THREAD_POOL_INCLUDED
+
+
+
+#include "minorGems/system/Thread.h"
+#include "minorGems/system/MutexLock.h"
+#include "minorGems/system/Semaphore.h"
+#include "minorGems/util/SimpleVector.h"
+
+
+
+/**
+ * A unit of work that can be handed to a ThreadPool.
+ */
+class ThreadPoolJob {
+    public:
+
+        virtual ~ThreadPoolJob() {
+            }
+
+        // called on one of the pool's worker threads
+        virtual void runJob() = 0;
+    };
+
+
+
+/**
+ * Fixed-size pool of worker threads pulling jobs from a shared FIFO queue.
+ *
+ * Jobs are not owned by the pool.  The caller must keep a job alive until
+ * waitForAllJobs returns.
+ *
+ * waitForAllJobs may only be called from one thread at a time, and never
+ * from inside a job.
+ *
+ * Platform-independent (built on Thread, MutexLock and Semaphore).
+ */
+class ThreadPool {
+
+    public:
+
+        /**
+         * Constructs a pool and starts its worker threads.
+         *
+         * @param inNumThreads the number of worker threads, or -1 to
+         *   use one per online CPU.  Defaults to -1.
+         */
+        ThreadPool( int inNumThreads = -1 );
+
+
+        // finishes any queued jobs, then stops and joins all workers
+        ~ThreadPool();
+
+
+        int getNumThreads();
+
+
+        // queues a job to be run by the next free worker
+        void addJob( ThreadPoolJob *inJob );
+
+
+        // blocks until every job added so far has finished running
+        void waitForAllJobs();
+
+
+        // number of CPUs currently online, at least 1
+        static int getNumCPUs();
+
+
+
+        // used by worker threads
+        // returns NULL when the pool is shutting down
+        ThreadPoolJob *getNextJob();
+        void jobFinished();
+
+
+    private:
+
+        SimpleVector<Thread *> mWorkers;
+
+        MutexLock mLock;
+
+        // signaled once per queued job, and once per worker at shutdown
+        Semaphore mJobsAvailable;
+
+        // signaled when the outstanding count drops to zero while
+        // someone is waiting
+        Semaphore mAllDone;
+
+        SimpleVector<ThreadPoolJob *> mQueue;
+
+        // index of the next job to hand out in mQueue
+        int mQueueHead;
+
+        int mNumOutstanding;
+
+        char mWaiting;
+
+        char mStopping;
+
+    };
+
+
+
+#endif
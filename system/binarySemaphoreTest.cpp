@@ -0,0 +1,160 @@
+// Test for BinarySemaphore wait and signal
+//
+// Usage:  binarySemaphoreTest [numRounds]
+//
+// Checks that a signal given before wait is kept (once, since the semaphore
+// is binary), that timed waits time out, and that a waiter woken early,
+// with the signal already taken by another thread between its wakeup and
+// its return, goes back to waiting instead of returning as if signaled.
+// The early-wakeup race is repeated for many rounds, with and without a
+// timeout.
+
+
+#include "BinarySemaphore.h"
+#include "Thread.h"
+#include "Time.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+
+
+static int numFailed = 0;
+
+
+static void check( char inPassed, const char *inWhat ) {
+    if( ! inPassed ) {
+        printf( "FAILED:  %s\n", inWhat );
+        numFailed++;
+        }
+    }
+
+
+
+// waits on a semaphore once, and records the result
+class OneWaitThread : public Thread {
+
+    public:
+
+        OneWaitThread( BinarySemaphore *inSemaphore, int inTimeout )
+                : mSemaphore( inSemaphore ), mTimeout( inTimeout ),
+                  mStarted( false ), mDone( false ), mResult( -1 ) {
+            }
+
+        void run() {
+            mStarted = true;
+            mResult = mSemaphore->wait( mTimeout );
+            mDone = true;
+            }
+
+        BinarySemaphore *mSemaphore;
+        int mTimeout;
+
+        volatile char mStarted;
+        volatile char mDone;
+        volatile int mResult;
+    };
+
+
+
+static void checkSignalBeforeWait() {
+    BinarySemaphore semaphore;
+
+    semaphore.signal();
+    check( semaphore.wait( 1000 ) == 1, "signal before timed wait kept" );
+
+    semaphore.signal();
+    check( semaphore.wait() == 1, "signal before wait kept" );
+
+    // binary, so two signals only let one wait through
+    semaphore.signal();
+    semaphore.signal();
+    check( semaphore.wait( 1000 ) == 1, "first of two signals kept" );
+    check( semaphore.wait( 50 ) == 0, "second of two signals not kept" );
+
+    double start = Time::getCurrentTime();
+    check( semaphore.wait( 100 ) == 0, "unsignaled wait times out" );
+    check( Time::getCurrentTime() - start >= 0.09,
+           "unsignaled wait waits out its timeout" );
+    }
+
+
+
+// one round of a waiter woken by a signal that this thread takes
+// first, returns true if the waiter wrongly returned as signaled
+static char stolenSignalRound( int inWaiterTimeout ) {
+    BinarySemaphore semaphore;
+
+    OneWaitThread waiter( &semaphore, inWaiterTimeout );
+    waiter.start();
+
+    while( ! waiter.mStarted ) {
+        Thread::staticSleep( 0 );
+        }
+    // let it block in wait
+    Thread::staticSleep( 1 );
+
+    // wakes the waiter, but we usually re-lock the mutex first and take
+    // the signal
+    semaphore.signal();
+    char stolen = ( semaphore.wait( 0 ) == 1 );
+
+    char wrong = false;
+
+    if( stolen ) {
+        // waiter must not have passed on a signal that we took
+        Thread::staticSleep( 5 );
+
+        if( waiter.mDone && waiter.mResult == 1 ) {
+            wrong = true;
+            }
+        }
+
+    // release the waiter either way
+    semaphore.signal();
+    waiter.join();
+
+    return wrong;
+    }
+
+
+
+int main( int inNumArgs, char **inArgs ) {
+
+    int numRounds = 200;
+
+    if( inNumArgs > 1 ) {
+        numRounds = atoi( inArgs[1] );
+        }
+
+    checkSignalBeforeWait();
+
+
+    int numWrong = 0;
+    int numTimedWrong = 0;
+
+    for( int r=0; r<numRounds; r++ ) {
+        if( stolenSignalRound( -1 ) ) {
+            numWrong++;
+            }
+        if( stolenSignalRound( 10000 ) ) {
+            numTimedWrong++;
+            }
+        }
+
+    printf( "%d rounds, %d early returns from wait, "
+            "%d from timed wait\n",
+            numRounds, numWrong, numTimedWrong );
+
+    check( numWrong == 0, "wait keeps waiting after an early wakeup" );
+    check( numTimedWrong == 0,
+           "timed wait keeps waiting after an early wakeup" );
+
+    if( numFailed > 0 ) {
+        printf( "%d checks failed\n", numFailed );
+        return 1;
+        }
+
+    printf( "All checks passed\n" );
+    return 0;
+    }
@@ -0,0 +1,84 @@
+#ifndef CPU_FEATURES_INCLUDED
+#define CPU_FEATURES_INCLUDED
+
+
+
+/**
+ * Include this file to check, at run time, for instruction set extensions
+ * that a build can't assume.
+ *
+ * On x86 with GCC or Clang, CPU_FEATURES_X86 is defined, and functions
+ * marked with CPU_TARGET( "sse4.1,pclmul" ) (for example) may use those
+ * extensions' intrinsics from <immintrin.h> without the whole file being
+ * built for them.  Such functions must only be called after checking
+ * getCPUFeatures().
+ *
+ * Elsewhere, every feature reads as missing.
+ */
+
+
+
+typedef struct CPUFeatures {
+        char sse2;
+        char ssse3;
+        char sse41;
+        char pclmul;
+
+        // SHA-1 and SHA-256 extensions
+        char sha;
+    } CPUFeatures;
+
+
+
+#if defined(__GNUC__) && ( defined(__x86_64__) || defined(__i386__) )
+
+#define CPU_FEATURES_X86
+
+#define CPU_TARGET( inFeatures ) __attribute__(( target( inFeatures ) ))
+
+#include <cpuid.h>
+
+
+inline CPUFeatures detectCPUFeatures() {
+    CPUFeatures f = { false, false, false, false, false };
+
+    unsigned int a, b, c, d;
+
+    if( __get_cpuid( 1, &a, &b, &c, &d ) ) {
+        f.sse2 = ( d >> 26 ) & 1;
+        f.ssse3 = ( c >> 9 ) & 1;
+        f.sse41 = ( c >> 19 ) & 1;
+        f.pclmul = ( c >> 1 ) & 1;
+        }
+
+    if( __get_cpuid_max( 0, 0 ) >= 7 ) {
+        __cpuid_count( 7, 0, a, b, c, d );
+        f.sha = ( b >> 29 ) & 1;
+        }
+
+    return f;
+    }
+
+
+#else
+
+
+inline CPUFeatures detectCPUFeatures() {
+    CPUFeatures f = { false, false, false, false, false };
+    return f;
+    }
+
+
+#endif
+
+
+
+// detected once, on first call
+inline const CPUFeatures *getCPUFeatures() {
+    static CPUFeatures features = detectCPUFeatures();
+    return &features;
+    }
+
+
+
+#endif
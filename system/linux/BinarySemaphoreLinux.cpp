@@ -105,7 +105,13 @@ int BinarySemaphore::wait( int inTimeoutInMilliseconds ) {
 
         if( inTimeoutInMilliseconds == -1 ) {
             // no timeout
-            pthread_cond_wait( &( condPointer[0] ), &( mutexPointer[0] ) );
+            // loop, since another waiter can take the signal between
+            // our wakeup and our re-locking of the mutex (and cond waits
+            // can wake spuriously)
+            while( mSemaphoreValue == 0 ) {
+                pthread_cond_wait( &( condPointer[0] ), 
+                                   &( mutexPointer[0] ) );
+                }
             }
         else {
             // use timeout version
@@ -142,11 +148,15 @@ int BinarySemaphore::wait( int inTimeoutInMilliseconds ) {
             abstime.tv_sec = absTimeoutSec;
             abstime.tv_nsec = absTimeoutNsec;
 
-            int result = pthread_cond_timedwait( &( condPointer[0] ),
+            int result = 0;
+            
+            while( mSemaphoreValue == 0 && result == 0 ) {
+                result = pthread_cond_timedwait( &( condPointer[0] ),
                                                  &( mutexPointer[0] ),
                                                  &abstime );
+                }
 
-            if( result != 0 ) {
+            if( mSemaphoreValue == 0 ) {
                 // timed out
                 returnValue = 0;
                 }
@@ -65,6 +65,8 @@ SettingsManagerStaticMembers SettingsManager::mStaticMembers;
 
 char SettingsManager::mHashingOn = false;
 
+AssetSource *SettingsManager::mAssetSource = NULL;
+
 
 
 void SettingsManager::setDirectoryName( const char *inName ) {
@@ -99,6 +101,41 @@ void SettingsManager::setHashingOn( char inOn ) {
 
 
 
+void SettingsManager::setAssetSource( AssetSource *inSource ) {
+    mAssetSource = inSource;
+    }
+
+
+
+char *SettingsManager::readSettingsFile( const char *inSettingName,
+                                         const char *inExtension ) {
+
+    char *fileName = getSettingsFileName( inSettingName, inExtension );
+    File *settingsFile = new File( NULL, fileName );
+
+    delete [] fileName;
+    
+    char *fileContents = settingsFile->readFileContents();
+
+    delete settingsFile;
+
+    if( fileContents == NULL && mAssetSource != NULL ) {
+        // asset names always use / separators
+        char *assetName = autoSprintf( "%s/%s.%s",
+                                       mStaticMembers.mDirectoryName,
+                                       inSettingName, inExtension );
+        int length;
+        fileContents = 
+            (char *)mAssetSource->readAsset( assetName, &length );
+        
+        delete [] assetName;
+        }
+
+    return fileContents;
+    }
+
+
+
 
 SimpleVector<char *> *SettingsManager::getSetting( 
     const char *inSettingName ) {
@@ -215,15 +252,7 @@ SimpleVector<double> *SettingsManager::getDoubleSettingMulti(
 
 char *SettingsManager::getSettingContents( const char *inSettingName ) {
 
-    char *fileName = getSettingsFileName( inSettingName );
-    File *settingsFile = new File( NULL, fileName );
-
-    delete [] fileName;
-    
-    char *fileContents = settingsFile->readFileContents();
-
-    delete settingsFile;
-
+    char *fileContents = readSettingsFile( inSettingName, "ini" );
     
     if( fileContents == NULL ) {
         return NULL;
@@ -231,15 +260,7 @@ char *SettingsManager::getSettingContents( const char *inSettingName ) {
     
     if( mHashingOn ) {
         
-        char *hashFileName = getSettingsFileName( inSettingName, "hash" );
-        
-        File *hashFile = new File( NULL, hashFileName );
-        
-        delete [] hashFileName;
-        
-        char *savedHash = hashFile->readFileContents();
-        
-        delete hashFile;
+        char *savedHash = readSettingsFile( inSettingName, "hash" );
 
         if( savedHash == NULL ) {
             printf( "Hash missing for setting %s\n", inSettingName );
@@ -60,6 +60,8 @@
 
 #include "minorGems/system/Time.h"
 
+#include "minorGems/io/file/AssetSource.h"
+
 #include <stdio.h>
 
 
@@ -133,6 +135,19 @@ class SettingsManager {
         static void setHashingOn( char inOn );
 
 
+
+        /**
+         * Sets a source to read settings from when their files are
+         * missing from the settings directory, like an archive of default
+         * settings.  Settings are always written to files, so saved
+         * settings override the source.
+         *
+         * @param inSource the source, or NULL for none.  Destroyed by
+         *   caller after settings are no longer read.
+         */
+        static void setAssetSource( AssetSource *inSource );
+
+
         
         /**
          * Gets a setting, tokenized by whitespace into separate strings.
@@ -375,6 +390,14 @@ class SettingsManager {
         static SettingsManagerStaticMembers mStaticMembers;
 
         static char mHashingOn;
+
+        static AssetSource *mAssetSource;
+
+
+        // reads a settings file, or the asset source's copy if missing
+        // returns NULL if neither found
+        static char *readSettingsFile( const char *inSettingName,
+                                       const char *inExtension );
         
 
         /**
@@ -272,6 +272,14 @@ class SimpleVector {
 
         char printExpansionMessage;
         const char *vectorName;
+
+
+        // doubles allocated space until it holds inMinSize elements
+        void expandToHold( int inMinSize );
+
+        // appends with one memcpy
+        // only for element types that need no copy constructor
+        void appendBlock( Type *inArray, int inSize );
 		};
 		
 		
@@ -594,46 +602,74 @@ inline void SimpleVector<Type>::push_back(Type x)	{
 		numFilledElements++;
 		}
 	else {					// need to allocate more space for vector
+        expandToHold( numFilledElements + 1 );
+		
+		elements[numFilledElements] = x;
+		numFilledElements++;	
+		}
+	}
+
+
+
+template <class Type>
+inline void SimpleVector<Type>::expandToHold( int inMinSize ) {
+    if( inMinSize <= maxSize ) {
+        return;
+        }
 
-		int newMaxSize = maxSize << 1;		// double size
+    int newMaxSize = maxSize;
+    if( newMaxSize < 1 ) {
+        newMaxSize = 1;
+        }
+    
+    while( newMaxSize < inMinSize ) {
+        newMaxSize = newMaxSize << 1;		// double size
+        }
 		
-        if( printExpansionMessage ) {
-            printf( "SimpleVector \"%s\" is expanding itself from %d to %d"
-                    " max elements\n", vectorName, maxSize, newMaxSize );
-            }
+    if( printExpansionMessage ) {
+        printf( "SimpleVector \"%s\" is expanding itself from %d to %d"
+                " max elements\n", vectorName, maxSize, newMaxSize );
+        }
 
 
-        // NOTE:  memcpy does not work here, because it does not invoke
-        // copy constructors on elements.
-        // And then "delete []" below causes destructors to be invoked
-        //  on old elements, which are shallow copies of new objects.
+    // NOTE:  memcpy does not work here, because it does not invoke
+    // copy constructors on elements.
+    // And then "delete []" below causes destructors to be invoked
+    //  on old elements, which are shallow copies of new objects.
 
-        Type *newAlloc = new Type[newMaxSize];
-        /*
-		unsigned int sizeOfElement = sizeof(Type);
-		unsigned int numBytesToMove = sizeOfElement*(numFilledElements);
+    Type *newAlloc = new Type[newMaxSize];
+    /*
+    unsigned int sizeOfElement = sizeof(Type);
+    unsigned int numBytesToMove = sizeOfElement*(numFilledElements);
 		
 
-		// move into new space
-		memcpy((void *)newAlloc, (void *) elements, numBytesToMove);
-		*/
+    // move into new space
+    memcpy((void *)newAlloc, (void *) elements, numBytesToMove);
+    */
 
-        // must use element-by-element assignment to invoke constructors
-        for( int i=0; i<numFilledElements; i++ ) {
-            newAlloc[i] = elements[i];
-            }
+    // must use element-by-element assignment to invoke constructors
+    for( int i=0; i<numFilledElements; i++ ) {
+        newAlloc[i] = elements[i];
+        }
         
 
-		// delete old space
-		delete [] elements;
-		
-		elements = newAlloc;
-		maxSize = newMaxSize;	
+    // delete old space
+    delete [] elements;
 		
-		elements[numFilledElements] = x;
-		numFilledElements++;	
-		}
-	}
+    elements = newAlloc;
+    maxSize = newMaxSize;	
+    }
+
+
+
+template <class Type>
+inline void SimpleVector<Type>::appendBlock( Type *inArray, int inSize ) {
+    expandToHold( numFilledElements + inSize );
+    
+    memcpy( (void *)&( elements[ numFilledElements ] ), (void *)inArray, 
+            inSize * sizeof( Type ) );
+    numFilledElements += inSize;
+    }
 
 
 template <class Type>
@@ -719,6 +755,23 @@ inline char *SimpleVector<char>::getElementString() {
     }
 
 
+// chars are appended a block at a time, since receive and file loops
+// append large buffers this way
+template <>
+inline void SimpleVector<char>::appendArray( char *inArray, int inSize ) {
+    appendBlock( inArray, inSize );
+    }
+
+
+
+template <>
+inline void SimpleVector<unsigned char>::appendArray( unsigned char *inArray,
+                                                      int inSize ) {
+    appendBlock( inArray, inSize );
+    }
+
+
+
 template <>
 inline void SimpleVector<char>::appendElementString( const char *inString ) {
     unsigned int numChars = strlen( inString );
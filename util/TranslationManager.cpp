@@ -46,7 +46,54 @@ char *TranslationManager::getDirectoryName() {
 
 
 
+void TranslationManager::setAssetSource( AssetSource *inSource ) {
+    mStaticMembers.mAssetSource = inSource;
+    }
+
+
+
+// adds a language name if not already present
+// inName destroyed by caller
+static void addLanguageName( SimpleVector<char*> *inLanguageNames,
+                             const char *inName ) {
+    for( int i=0; i<inLanguageNames->size(); i++ ) {
+        if( strcmp( inLanguageNames->getElementDirect( i ), inName ) == 0 ) {
+            return;
+            }
+        }
+    inLanguageNames->push_back( stringDuplicate( inName ) );
+    }
+
+
+
 char **TranslationManager::getAvailableLanguages( int *outNumLanguages ) {
+    SimpleVector<char*> *languageNames = new SimpleVector<char*>();
+
+    if( mStaticMembers.mAssetSource != NULL ) {
+        char *prefix = autoSprintf( "%s/", mStaticMembers.mDirectoryName );
+        int prefixLength = strlen( prefix );
+
+        int numAssets;
+        char **assetNames = 
+            mStaticMembers.mAssetSource->listAssets( prefix, &numAssets );
+
+        for( int i=0; i<numAssets; i++ ) {
+            // skip prefix, and files in subdirectories
+            char *name = &( assetNames[i][ prefixLength ] );
+            
+            char *extensionPointer = strstr( name, ".txt" );
+
+            if( extensionPointer != NULL && strchr( name, '/' ) == NULL ) {
+                extensionPointer[0] = '\0';
+                
+                addLanguageName( languageNames, name );
+                }
+            delete [] assetNames[i];
+            }
+        delete [] assetNames;
+        delete [] prefix;
+        }
+
     File *languageDirectory = new File( NULL, mStaticMembers.mDirectoryName );
 
     if( languageDirectory->exists() && languageDirectory->isDirectory() ) {
@@ -55,7 +102,6 @@ char **TranslationManager::getAvailableLanguages( int *outNumLanguages ) {
         File **childFiles = languageDirectory->getChildFiles( &numChildFiles );
                 
         if( childFiles != NULL ) {
-            SimpleVector<char*> *languageNames = new SimpleVector<char*>();
 
             for( int i=0; i<numChildFiles; i++ ) {
 
@@ -67,32 +113,26 @@ char **TranslationManager::getAvailableLanguages( int *outNumLanguages ) {
                     // terminate string, cutting off extension
                     extensionPointer[0] = '\0';
 
-                    languageNames->push_back( stringDuplicate( name ) );
+                    addLanguageName( languageNames, name );
                     }
 
                 delete [] name;
                 delete childFiles[i];
                 }
             delete [] childFiles;
-
-            char **returnArray = languageNames->getElementArray();
-
-            *outNumLanguages = languageNames->size();
-
-            delete languageNames;
-
-
-            delete languageDirectory;
-            return returnArray;
             }
 
         }
 
     delete languageDirectory;
     
-    // default, if we didn't return above
-    *outNumLanguages = 0;
-    return new char*[0];
+    char **returnArray = languageNames->getElementArray();
+
+    *outNumLanguages = languageNames->size();
+
+    delete languageNames;
+
+    return returnArray;
     }
 
 
@@ -167,6 +207,7 @@ const char *TranslationManager::translate( const char *inTranslationKey ) {
 TranslationManagerStaticMembers::TranslationManagerStaticMembers()
     : mDirectoryName( NULL ),
       mLanguageName( NULL ),
+      mAssetSource( NULL ),
       mTranslationKeys( NULL ),
       mNaturalLanguageStrings( NULL ) {
 
@@ -240,9 +281,28 @@ void TranslationManagerStaticMembers::setDirectoryAndLanguage(
     char dataSet = false;
     
 
+    if( mAssetSource != NULL ) {
+        char *assetName = autoSprintf( "%s/%s.txt", mDirectoryName,
+                                       newLanguageName );
+        int length;
+        char *languageData = 
+            (char *)mAssetSource->readAsset( assetName, &length );
+
+        delete [] assetName;
+
+        if( languageData != NULL ) {
+            dataSet = true;
+
+            setTranslationData( languageData, inClearOldKeys );
+            delete [] languageData;
+            }
+        }
+
+
     File *directoryFile = new File( NULL, mDirectoryName );
 
-    if( directoryFile->exists() && directoryFile->isDirectory() ) {
+    if( !dataSet && 
+        directoryFile->exists() && directoryFile->isDirectory() ) {
 
         char *languageFileName = autoSprintf( "%s.txt", newLanguageName );
         
@@ -28,6 +28,7 @@
 
 
 #include "minorGems/util/SimpleVector.h"
+#include "minorGems/io/file/AssetSource.h"
 #include <string>
 
 
@@ -70,6 +71,18 @@ class TranslationManager {
          */
         static char *getDirectoryName();
 
+
+
+        /**
+         * Sets a source, like an archive, to check for language files
+         * before the language directory.  Takes effect on the next
+         * setLanguage call.
+         *
+         * @param inSource the source, or NULL for none.  Destroyed by
+         *   caller after languages are no longer set.
+         */
+        static void setAssetSource( AssetSource *inSource );
+
         
 
         /**
@@ -202,6 +215,9 @@ class TranslationManagerStaticMembers {
         
         char *mDirectoryName;
         char *mLanguageName;
+
+        // checked before directory, or NULL
+        AssetSource *mAssetSource;
         
         // vectors mapping keys to strings
         SimpleVector<char *> *mTranslationKeys;
@@ -0,0 +1,197 @@
+#include "adler32.h"
+
+#include "minorGems/system/cpuFeatures.h"
+
+#ifdef CPU_FEATURES_X86
+#include <immintrin.h>
+#endif
+
+
+
+// largest prime below 65536
+#define ADLER_BASE 65521
+
+// most bytes that can be summed before s2 might overflow 32 bits
+#define ADLER_NMAX 5552
+
+
+
+unsigned int adler32UpdateScalar( unsigned int inAdler,
+                                  const unsigned char *inData,
+                                  int inDataLength ) {
+    unsigned int s1 = inAdler & 0xFFFF;
+    unsigned int s2 = ( inAdler >> 16 ) & 0xFFFF;
+
+    const unsigned char *p = inData;
+    int length = inDataLength;
+
+    while( length > 0 ) {
+        int n = ADLER_NMAX;
+        if( n > length ) {
+            n = length;
+            }
+        length -= n;
+
+        // reduce only once per run
+        while( n >= 8 ) {
+            s1 += p[0]; s2 += s1;
+            s1 += p[1]; s2 += s1;
+            s1 += p[2]; s2 += s1;
+            s1 += p[3]; s2 += s1;
+            s1 += p[4]; s2 += s1;
+            s1 += p[5]; s2 += s1;
+            s1 += p[6]; s2 += s1;
+            s1 += p[7]; s2 += s1;
+            p += 8;
+            n -= 8;
+            }
+        while( n > 0 ) {
+            s1 += *p++;
+            s2 += s1;
+            n--;
+            }
+
+        s1 %= ADLER_BASE;
+        s2 %= ADLER_BASE;
+        }
+
+    return ( s2 << 16 ) | s1;
+    }
+
+
+
+#ifdef CPU_FEATURES_X86
+
+// 32 bytes at a time:  s1 gains the sum of the bytes, and s2 gains 32 times
+// the old s1 plus each byte weighted by its distance from the end
+CPU_TARGET( "ssse3" )
+unsigned int adler32UpdateSSSE3( unsigned int inAdler,
+                                 const unsigned char *inData,
+                                 int inDataLength ) {
+    unsigned int s1 = inAdler & 0xFFFF;
+    unsigned int s2 = ( inAdler >> 16 ) & 0xFFFF;
+
+    const unsigned char *p = inData;
+
+    int numBlocks = inDataLength / 32;
+    int tailLength = inDataLength - numBlocks * 32;
+
+    const __m128i tapsHigh = _mm_setr_epi8( 32, 31, 30, 29, 28, 27, 26, 25,
+                                            24, 23, 22, 21, 20, 19, 18, 17 );
+    const __m128i tapsLow = _mm_setr_epi8( 16, 15, 14, 13, 12, 11, 10, 9,
+                                           8, 7, 6, 5, 4, 3, 2, 1 );
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ones = _mm_set1_epi16( 1 );
+
+    while( numBlocks > 0 ) {
+        int n = ADLER_NMAX / 32;
+        if( n > numBlocks ) {
+            n = numBlocks;
+            }
+        numBlocks -= n;
+
+        // sum of s1 before each block, times 32 at the end
+        __m128i vPrevS1 = _mm_cvtsi32_si128( (int)( s1 * n ) );
+        __m128i vS1 = zero;
+        __m128i vS2 = _mm_cvtsi32_si128( (int)s2 );
+
+        for( int b=0; b<n; b++ ) {
+            __m128i bytes1 = _mm_loadu_si128( (const __m128i *)p );
+            __m128i bytes2 = _mm_loadu_si128( (const __m128i *)( p + 16 ) );
+
+            vPrevS1 = _mm_add_epi32( vPrevS1, vS1 );
+
+            vS1 = _mm_add_epi32( vS1, _mm_sad_epu8( bytes1, zero ) );
+            vS1 = _mm_add_epi32( vS1, _mm_sad_epu8( bytes2, zero ) );
+
+            vS2 = _mm_add_epi32(
+                vS2,
+                _mm_madd_epi16( _mm_maddubs_epi16( bytes1, tapsHigh ),
+                                ones ) );
+            vS2 = _mm_add_epi32(
+                vS2,
+                _mm_madd_epi16( _mm_maddubs_epi16( bytes2, tapsLow ),
+                                ones ) );
+            p += 32;
+            }
+
+        vS2 = _mm_add_epi32( vS2, _mm_slli_epi32( vPrevS1, 5 ) );
+
+        // add up lanes
+        vS1 = _mm_add_epi32( vS1, _mm_shuffle_epi32( vS1, 0x4E ) );
+        s1 += (unsigned int)_mm_cvtsi128_si32( vS1 );
+
+        vS2 = _mm_add_epi32( vS2, _mm_shuffle_epi32( vS2, 0xB1 ) );
+        vS2 = _mm_add_epi32( vS2, _mm_shuffle_epi32( vS2, 0x4E ) );
+        s2 = (unsigned int)_mm_cvtsi128_si32( vS2 );
+
+        s1 %= ADLER_BASE;
+        s2 %= ADLER_BASE;
+        }
+
+    return adler32UpdateScalar( ( s2 << 16 ) | s1, p, tailLength );
+    }
+
+#else
+
+unsigned int adler32UpdateSSSE3( unsigned int inAdler,
+                                 const unsigned char *inData,
+                                 int inDataLength ) {
+    return adler32UpdateScalar( inAdler, inData, inDataLength );
+    }
+
+#endif
+
+
+
+typedef unsigned int ( *Adler32Function )( unsigned int inAdler,
+                                           const unsigned char *inData,
+                                           int inDataLength );
+
+
+static Adler32Function pickAdler32Function() {
+    if( getCPUFeatures()->ssse3 ) {
+        return adler32UpdateSSSE3;
+        }
+    return adler32UpdateScalar;
+    }
+
+
+
+unsigned int adler32Update( unsigned int inAdler,
+                            const unsigned char *inData, int inDataLength ) {
+    static Adler32Function function = pickAdler32Function();
+
+    return function( inAdler, inData, inDataLength );
+    }
+
+
+
+unsigned int adler32Combine( unsigned int inAdlerA, unsigned int inAdlerB,
+                             unsigned long inLengthB ) {
+    const unsigned long base = ADLER_BASE;
+
+    unsigned long rem = inLengthB % base;
+
+    unsigned long sum1 = inAdlerA & 0xffff;
+    unsigned long sum2 = ( rem * sum1 ) % base;
+
+    sum1 += ( inAdlerB & 0xffff ) + base - 1;
+    sum2 += ( ( inAdlerA >> 16 ) & 0xffff ) + ( ( inAdlerB >> 16 ) & 0xffff )
+        + base - rem;
+
+    if( sum1 >= base ) {
+        sum1 -= base;
+        }
+    if( sum1 >= base ) {
+        sum1 -= base;
+        }
+    if( sum2 >= ( base << 1 ) ) {
+        sum2 -= ( base << 1 );
+        }
+    if( sum2 >= base ) {
+        sum2 -= base;
+        }
+
+    return (unsigned int)( sum1 | ( sum2 << 16 ) );
+    }
@@ -0,0 +1,44 @@
+#ifndef ADLER32_INCLUDED
+#define ADLER32_INCLUDED
+
+
+
+/**
+ * Continues an Adler-32 checksum (as used by zlib) over more data.
+ *
+ * Uses SSSE3 where the CPU supports it.
+ *
+ * @param inAdler the checksum of the data so far, or 1 to start.
+ * @param inData the data to add.  Destroyed by caller.
+ * @param inDataLength the length of the data.
+ *
+ * @return the checksum of all the data.
+ */
+unsigned int adler32Update( unsigned int inAdler,
+                            const unsigned char *inData, int inDataLength );
+
+
+
+// checksum of data A followed by data B, from each one's checksum and
+// the length of B, as zlib's adler32_combine
+unsigned int adler32Combine( unsigned int inAdlerA, unsigned int inAdlerB,
+                             unsigned long inLengthB );
+
+
+
+// the implementations that adler32Update picks from, for testing and
+// benchmarking
+// each takes the same parameters as adler32Update
+
+unsigned int adler32UpdateScalar( unsigned int inAdler,
+                                  const unsigned char *inData,
+                                  int inDataLength );
+
+// only call if getCPUFeatures() reports ssse3
+unsigned int adler32UpdateSSSE3( unsigned int inAdler,
+                                 const unsigned char *inData,
+                                 int inDataLength );
+
+
+
+#endif
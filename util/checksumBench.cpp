@@ -0,0 +1,388 @@
+// Test and benchmark for the CRC-32, Adler-32 and SHA-1 paths
+//
+// Usage:  checksumBench [megabytes]
+//
+// Checks every path this CPU supports against zlib (CRC-32 and Adler-32)
+// and against the portable SHA-1 and its test vectors, over many lengths
+// and alignments, plus chained updates, Adler-32 combining, and
+// multi-buffer SHA-1 against one buffer at a time.
+//
+// Then prints GB/s for each path.  The 64 KiB multi-buffer rows are the
+// best of several rounds.
+
+
+#include "minorGems/util/crc32.h"
+#include "minorGems/util/adler32.h"
+#include "minorGems/crypto/hashes/sha1.h"
+#include "minorGems/system/cpuFeatures.h"
+#include "minorGems/system/Time.h"
+
+#include <zlib.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+
+static int numFailed = 0;
+
+
+static void check( char inPassed, const char *inWhat ) {
+    if( ! inPassed ) {
+        printf( "FAILED:  %s\n", inWhat );
+        numFailed++;
+        }
+    }
+
+
+
+static unsigned int randState = 12345;
+
+static int randInt( int inMin, int inMax ) {
+    randState = randState * 1103515245 + 12345;
+    return inMin + (int)( ( randState >> 8 ) % ( inMax - inMin + 1 ) );
+    }
+
+
+
+typedef unsigned int ( *ChecksumFunction )( unsigned int inStart,
+                                            const unsigned char *inData,
+                                            int inDataLength );
+
+typedef void ( *SHA1BlocksFunction )( sha1_quadbyte state[5],
+                                      const sha1_byte *data,
+                                      unsigned int numBlocks );
+
+
+
+static const CPUFeatures *cpu;
+
+
+static int numCRCPaths = 0;
+static const char *crcNames[3];
+static ChecksumFunction crcPaths[3];
+
+static int numAdlerPaths = 0;
+static const char *adlerNames[2];
+static ChecksumFunction adlerPaths[2];
+
+static int numSHA1Paths = 0;
+static const char *sha1Names[3];
+static SHA1BlocksFunction sha1Paths[3];
+
+
+static void findPaths() {
+    cpu = getCPUFeatures();
+
+    crcNames[ numCRCPaths ] = "bytewise";
+    crcPaths[ numCRCPaths++ ] = crc32UpdateBytewise;
+    crcNames[ numCRCPaths ] = "slice-by-8";
+    crcPaths[ numCRCPaths++ ] = crc32UpdateSliceBy8;
+    if( cpu->pclmul && cpu->sse41 ) {
+        crcNames[ numCRCPaths ] = "PCLMUL";
+        crcPaths[ numCRCPaths++ ] = crc32UpdatePCLMUL;
+        }
+
+    adlerNames[ numAdlerPaths ] = "scalar";
+    adlerPaths[ numAdlerPaths++ ] = adler32UpdateScalar;
+    if( cpu->ssse3 ) {
+        adlerNames[ numAdlerPaths ] = "SSSE3";
+        adlerPaths[ numAdlerPaths++ ] = adler32UpdateSSSE3;
+        }
+
+    sha1Names[ numSHA1Paths ] = "portable";
+    sha1Paths[ numSHA1Paths++ ] = SHA1_BlocksPortable;
+    if( cpu->sha && cpu->sse41 && cpu->ssse3 ) {
+        sha1Names[ numSHA1Paths ] = "SHA-NI";
+        sha1Paths[ numSHA1Paths++ ] = SHA1_BlocksSHANI;
+        }
+    }
+
+
+
+static void checkCRCAndAdler( unsigned char *inData, int inLength ) {
+
+    for( int length=0; length<=inLength;
+         length += ( length < 300 ) ? 1 : 997 ) {
+
+        for( int offset=0; offset<4 && offset<=length; offset++ ) {
+            const unsigned char *p = &( inData[ offset ] );
+            int n = length - offset;
+
+            unsigned int zlibCRC = crc32( 0L, p, n );
+            unsigned int zlibAdler = adler32( 1L, p, n );
+
+            for( int i=0; i<numCRCPaths; i++ ) {
+                check( crcPaths[i]( 0, p, n ) == zlibCRC,
+                       crcNames[i] );
+                }
+            check( crc32( p, n ) == zlibCRC, "crc32" );
+
+            for( int i=0; i<numAdlerPaths; i++ ) {
+                check( adlerPaths[i]( 1, p, n ) == zlibAdler,
+                       adlerNames[i] );
+                }
+            check( adler32Update( 1, p, n ) == zlibAdler,
+                   "adler32Update" );
+            }
+        }
+
+    // chained across a split
+    int split = inLength / 3;
+
+    check( crc32Update( crc32( inData, split ), &( inData[ split ] ),
+                        inLength - split ) == crc32( inData, inLength ),
+           "chained crc32Update" );
+
+    unsigned int adlerA = adler32Update( 1, inData, split );
+    unsigned int adlerB = adler32Update( 1, &( inData[ split ] ),
+                                         inLength - split );
+    unsigned int adlerWhole = adler32Update( 1, inData, inLength );
+
+    check( adler32Update( adlerA, &( inData[ split ] ),
+                          inLength - split ) == adlerWhole,
+           "chained adler32Update" );
+    check( adler32Combine( adlerA, adlerB, inLength - split ) == adlerWhole,
+           "adler32Combine" );
+    }
+
+
+
+static void checkSHA1( unsigned char *inData, int inLength ) {
+    // block paths agree on every block
+    int numBlocks = inLength / 64;
+
+    sha1_quadbyte reference[5] = { 1, 2, 3, 4, 5 };
+    SHA1_BlocksPortable( reference, inData + 1, numBlocks - 1 );
+
+    for( int i=1; i<numSHA1Paths; i++ ) {
+        sha1_quadbyte state[5] = { 1, 2, 3, 4, 5 };
+        sha1Paths[i]( state, inData + 1, numBlocks - 1 );
+
+        check( memcmp( state, reference, sizeof( state ) ) == 0,
+               sha1Names[i] );
+        }
+
+    char *hash = computeSHA1Digest( (char *)"abc" );
+    check( strcmp( hash, "A9993E364706816ABA3E25717850C26C9CD0D89D" ) == 0,
+           "SHA-1 of abc" );
+    delete [] hash;
+
+    unsigned char *millionA = new unsigned char[ 1000000 ];
+    memset( millionA, 'a', 1000000 );
+    hash = computeSHA1Digest( millionA, 1000000 );
+    check( strcmp( hash, "34AA973CD4C4DAA4F61EEB2BDBAD27316534016F" ) == 0,
+           "SHA-1 of a million a's" );
+    delete [] hash;
+
+    check( millionA[0] == 'a' && millionA[999999] == 'a',
+           "SHA-1 leaves input alone" );
+    delete [] millionA;
+
+
+    // multi-buffer, with lengths around block boundaries and lanes that
+    // finish at different times
+    int lengths[] = { 0, 1, 55, 56, 63, 64, 65, 127, 128, 129, 1000,
+                      4096, 70000, 3, 64 * 7, 100, 64 * 20 + 5, 200000,
+                      17, 640 };
+    int numBuffers = sizeof( lengths ) / sizeof( int );
+
+    unsigned char **buffers = new unsigned char *[ numBuffers ];
+
+    unsigned char *expected =
+        new unsigned char[ numBuffers * SHA1_DIGEST_LENGTH ];
+    unsigned char *digests =
+        new unsigned char[ numBuffers * SHA1_DIGEST_LENGTH ];
+
+    for( int i=0; i<numBuffers; i++ ) {
+        buffers[i] = &( inData[ randInt( 0, inLength - lengths[i] ) ] );
+
+        unsigned char *digest = computeRawSHA1Digest( buffers[i],
+                                                      lengths[i] );
+        memcpy( &( expected[ i * SHA1_DIGEST_LENGTH ] ), digest,
+                SHA1_DIGEST_LENGTH );
+        delete [] digest;
+        }
+
+    computeRawSHA1Digests( numBuffers, buffers, lengths, digests );
+    check( memcmp( digests, expected,
+                   numBuffers * SHA1_DIGEST_LENGTH ) == 0,
+           "multi-buffer SHA-1" );
+
+    if( cpu->sse2 ) {
+        // fewer buffers than lanes, too
+        for( int n=1; n<=numBuffers; n += 3 ) {
+            memset( digests, 0, numBuffers * SHA1_DIGEST_LENGTH );
+            computeRawSHA1DigestsFourLanes( n, buffers, lengths, digests );
+            check( memcmp( digests, expected,
+                           n * SHA1_DIGEST_LENGTH ) == 0,
+                   "four-lane SHA-1" );
+            }
+        }
+
+    delete [] buffers;
+    delete [] expected;
+    delete [] digests;
+    }
+
+
+
+static void printRate( const char *inAlgorithm, const char *inPath,
+                       double inSeconds, double inNumBytes ) {
+    printf( "  %-10s %-12s %6.2f GB/s\n", inAlgorithm, inPath,
+            inNumBytes / inSeconds / 1e9 );
+    }
+
+
+
+int main( int inNumArgs, char **inArgs ) {
+
+    int megabytes = 64;
+
+    if( inNumArgs > 1 ) {
+        megabytes = atoi( inArgs[1] );
+        }
+
+    findPaths();
+
+    printf( "CPU:  sse2 %d, ssse3 %d, sse4.1 %d, pclmul %d, sha %d\n",
+            cpu->sse2, cpu->ssse3, cpu->sse41, cpu->pclmul, cpu->sha );
+
+
+    int testLength = 300000;
+    unsigned char *testData = new unsigned char[ testLength ];
+    for( int i=0; i<testLength; i++ ) {
+        // runs of 255 push Adler-32 sums hardest
+        if( i % 3 == 0 ) {
+            testData[i] = (unsigned char)randInt( 0, 255 );
+            }
+        else {
+            testData[i] = 255;
+            }
+        }
+
+    checkCRCAndAdler( testData, 20000 );
+    checkSHA1( testData, testLength );
+
+    delete [] testData;
+
+    if( numFailed > 0 ) {
+        printf( "%d checks failed\n", numFailed );
+        return 1;
+        }
+
+    printf( "All checks passed\n\n" );
+
+
+    int length = megabytes * 1024 * 1024;
+    unsigned char *data = new unsigned char[ length ];
+    for( int i=0; i<length; i++ ) {
+        data[i] = (unsigned char)randInt( 0, 255 );
+        }
+
+    // keep results live
+    unsigned int sink = 0;
+
+    for( int i=0; i<numCRCPaths; i++ ) {
+        double start = Time::getCurrentTime();
+        sink += crcPaths[i]( 0, data, length );
+        printRate( "CRC-32", crcNames[i], Time::getCurrentTime() - start,
+                   length );
+        }
+
+    for( int i=0; i<numAdlerPaths; i++ ) {
+        double start = Time::getCurrentTime();
+        sink += adlerPaths[i]( 1, data, length );
+        printRate( "Adler-32", adlerNames[i], Time::getCurrentTime() - start,
+                   length );
+        }
+
+    for( int i=0; i<numSHA1Paths; i++ ) {
+        sha1_quadbyte state[5] = { 1, 2, 3, 4, 5 };
+        double start = Time::getCurrentTime();
+        sha1Paths[i]( state, data, length / 64 );
+        printRate( "SHA-1", sha1Names[i], Time::getCurrentTime() - start,
+                   length );
+        sink += state[0];
+        }
+
+
+    // many 64 KiB files
+    int bufferLength = 64 * 1024;
+    int numBuffers = length / bufferLength;
+
+    unsigned char **buffers = new unsigned char *[ numBuffers ];
+    int *lengths = new int[ numBuffers ];
+
+    for( int i=0; i<numBuffers; i++ ) {
+        buffers[i] = &( data[ i * bufferLength ] );
+        lengths[i] = bufferLength;
+        }
+
+    unsigned char *digests =
+        new unsigned char[ numBuffers * SHA1_DIGEST_LENGTH ];
+    unsigned char *pickedDigests =
+        new unsigned char[ numBuffers * SHA1_DIGEST_LENGTH ];
+
+    // best of several interleaved rounds, since one pass of each is
+    // too noisy to tell the picked path from the one it picks
+    int numModes = 3;
+    const char *modeNames[3] = { "each", "four lanes", "picked" };
+    double bestTimes[3] = { -1, -1, -1 };
+
+    for( int r=0; r<5; r++ ) {
+        for( int m=0; m<numModes; m++ ) {
+            if( m == 1 && ! cpu->sse2 ) {
+                continue;
+                }
+            double start = Time::getCurrentTime();
+
+            if( m == 0 ) {
+                for( int i=0; i<numBuffers; i++ ) {
+                    SHA_CTX context;
+                    SHA1_Init( &context );
+                    SHA1_Update( &context, buffers[i], lengths[i] );
+                    SHA1_Final( &( digests[ i * SHA1_DIGEST_LENGTH ] ),
+                                &context );
+                    }
+                }
+            else if( m == 1 ) {
+                computeRawSHA1DigestsFourLanes( numBuffers, buffers,
+                                                lengths, pickedDigests );
+                }
+            else {
+                computeRawSHA1Digests( numBuffers, buffers, lengths,
+                                       pickedDigests );
+                }
+
+            double time = Time::getCurrentTime() - start;
+            if( bestTimes[m] < 0 || time < bestTimes[m] ) {
+                bestTimes[m] = time;
+                }
+            }
+        }
+
+    for( int m=0; m<numModes; m++ ) {
+        if( bestTimes[m] >= 0 ) {
+            printRate( "SHA-1 64K", modeNames[m], bestTimes[m], length );
+            }
+        }
+
+    // with SHA-NI, picked should be the per-buffer path
+    printf( "  (picked uses %s)\n",
+            ( cpu->sse2 && ! ( cpu->sha && cpu->sse41 && cpu->ssse3 ) )
+            ? "four lanes" : "each buffer alone" );
+
+    sink += digests[0] + pickedDigests[0];
+
+    delete [] buffers;
+    delete [] lengths;
+    delete [] digests;
+    delete [] pickedDigests;
+    delete [] data;
+
+    printf( "\n(%u)\n", sink );
+
+    return 0;
+    }
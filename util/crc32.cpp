@@ -42,6 +42,19 @@
 
 
 
+#include "crc32.h"
+
+#include "minorGems/system/endian.h"
+#include "minorGems/system/cpuFeatures.h"
+
+#include <string.h>
+
+#ifdef CPU_FEATURES_X86
+#include <immintrin.h>
+#endif
+
+
+
 static unsigned int crc32Table[] = {
 	0x00000000, 0x77073096, 0xee0e612c, 0x990951ba, 0x076dc419, 0x706af48f,
 	0xe963a535, 0x9e6495a3,	0x0edb8832, 0x79dcb8a4, 0xe0d5e91e, 0x97d2d988,
@@ -90,19 +103,255 @@ static unsigned int crc32Table[] = {
 
 
 
-unsigned int crc32( const unsigned char *inData, 
-                    int inDataLength ) {
-	
-    const unsigned char *p;
-    unsigned int crc = 0;
-    
+// the kernels below work on the CRC register, which is the CRC-32
+// before its final inversion
+
 
-	p = inData;
-	crc = crc ^ ~0U;
+
+static unsigned int bytewiseKernel( unsigned int inRegister,
+                                    const unsigned char *inData,
+                                    int inDataLength ) {
+    unsigned int crc = inRegister;
+    const unsigned char *p = inData;
 
 	while( inDataLength-- ) {
 		crc = crc32Table[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
         }
-    
-    return crc ^ ~0U;
+
+    return crc;
+    }
+
+
+
+// table k gives the CRC of a byte followed by k zero bytes
+class CRC32SliceTables {
+    public:
+
+        CRC32SliceTables() {
+            memcpy( mTables[0], crc32Table, sizeof( mTables[0] ) );
+
+            for( int k=1; k<8; k++ ) {
+                for( int n=0; n<256; n++ ) {
+                    unsigned int prev = mTables[ k - 1 ][n];
+                    mTables[k][n] = mTables[0][ prev & 0xFF ] ^ ( prev >> 8 );
+                    }
+                }
+            }
+
+        unsigned int mTables[8][256];
+    };
+
+
+
+static unsigned int sliceBy8Kernel( unsigned int inRegister,
+                                    const unsigned char *inData,
+                                    int inDataLength ) {
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+    static CRC32SliceTables slices;
+
+    unsigned int ( *t )[256] = slices.mTables;
+
+    unsigned int crc = inRegister;
+    const unsigned char *p = inData;
+    int length = inDataLength;
+
+    while( length >= 8 ) {
+        unsigned int one, two;
+        memcpy( &one, p, 4 );
+        memcpy( &two, p + 4, 4 );
+
+        one ^= crc;
+
+        crc = 
+            t[7][ one & 0xFF ] ^ t[6][ ( one >> 8 ) & 0xFF ] ^
+            t[5][ ( one >> 16 ) & 0xFF ] ^ t[4][ one >> 24 ] ^
+            t[3][ two & 0xFF ] ^ t[2][ ( two >> 8 ) & 0xFF ] ^
+            t[1][ ( two >> 16 ) & 0xFF ] ^ t[0][ two >> 24 ];
+
+        p += 8;
+        length -= 8;
+        }
+
+    return bytewiseKernel( crc, p, length );
+#else
+    return bytewiseKernel( inRegister, inData, inDataLength );
+#endif
+    }
+
+
+
+#ifdef CPU_FEATURES_X86
+
+// folding by carry-less multiplication, from Gopal et al., "Fast CRC
+// Computation for Generic Polynomials Using PCLMULQDQ Instruction"
+// (Intel, 2009), with the bit-reflected constants for this polynomial
+//
+// inDataLength must be at least 64 and a multiple of 16
+CPU_TARGET( "sse4.1,pclmul" )
+static unsigned int pclmulKernel( unsigned int inRegister,
+                                  const unsigned char *inData,
+                                  int inDataLength ) {
+
+    const unsigned char *p = inData;
+    int length = inDataLength;
+
+    // x^(4*128+32) mod P and x^(4*128-32) mod P, for folding 4 lanes
+    const __m128i k1k2 = _mm_set_epi64x( 0x01c6e41596LL, 0x0154442bd4LL );
+    // same for folding by 128 bits
+    const __m128i k3k4 = _mm_set_epi64x( 0x00ccaa009eLL, 0x01751997d0LL );
+    // x^64 mod P, for folding 96 bits to 64
+    const __m128i k5k0 = _mm_set_epi64x( 0, 0x0163cd6124LL );
+    // P and its Barrett constant
+    const __m128i poly = _mm_set_epi64x( 0x01f7011641LL, 0x01db710641LL );
+
+    const __m128i low32Mask = _mm_setr_epi32( ~0, 0, ~0, 0 );
+
+    __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8;
+
+    x1 = _mm_loadu_si128( (const __m128i *)( p ) );
+    x2 = _mm_loadu_si128( (const __m128i *)( p + 16 ) );
+    x3 = _mm_loadu_si128( (const __m128i *)( p + 32 ) );
+    x4 = _mm_loadu_si128( (const __m128i *)( p + 48 ) );
+
+    x1 = _mm_xor_si128( x1, _mm_cvtsi32_si128( (int)inRegister ) );
+
+    p += 64;
+    length -= 64;
+
+    // fold four 128-bit lanes at once
+    while( length >= 64 ) {
+        x5 = _mm_clmulepi64_si128( x1, k1k2, 0x00 );
+        x6 = _mm_clmulepi64_si128( x2, k1k2, 0x00 );
+        x7 = _mm_clmulepi64_si128( x3, k1k2, 0x00 );
+        x8 = _mm_clmulepi64_si128( x4, k1k2, 0x00 );
+
+        x1 = _mm_clmulepi64_si128( x1, k1k2, 0x11 );
+        x2 = _mm_clmulepi64_si128( x2, k1k2, 0x11 );
+        x3 = _mm_clmulepi64_si128( x3, k1k2, 0x11 );
+        x4 = _mm_clmulepi64_si128( x4, k1k2, 0x11 );
+
+        x1 = _mm_xor_si128( _mm_xor_si128( x1, x5 ),
+                            _mm_loadu_si128( (const __m128i *)( p ) ) );
+        x2 = _mm_xor_si128( _mm_xor_si128( x2, x6 ),
+                            _mm_loadu_si128( (const __m128i *)( p + 16 ) ) );
+        x3 = _mm_xor_si128( _mm_xor_si128( x3, x7 ),
+                            _mm_loadu_si128( (const __m128i *)( p + 32 ) ) );
+        x4 = _mm_xor_si128( _mm_xor_si128( x4, x8 ),
+                            _mm_loadu_si128( (const __m128i *)( p + 48 ) ) );
+
+        p += 64;
+        length -= 64;
+        }
+
+    // fold the lanes into one
+    __m128i lanes[3] = { x2, x3, x4 };
+
+    for( int i=0; i<3; i++ ) {
+        x5 = _mm_clmulepi64_si128( x1, k3k4, 0x00 );
+        x1 = _mm_clmulepi64_si128( x1, k3k4, 0x11 );
+        x1 = _mm_xor_si128( _mm_xor_si128( x1, lanes[i] ), x5 );
+        }
+
+    // then fold in any remaining 16-byte blocks
+    while( length >= 16 ) {
+        x2 = _mm_loadu_si128( (const __m128i *)p );
+
+        x5 = _mm_clmulepi64_si128( x1, k3k4, 0x00 );
+        x1 = _mm_clmulepi64_si128( x1, k3k4, 0x11 );
+        x1 = _mm_xor_si128( _mm_xor_si128( x1, x2 ), x5 );
+
+        p += 16;
+        length -= 16;
+        }
+
+    // 128 bits down to 64
+    x2 = _mm_clmulepi64_si128( x1, k3k4, 0x10 );
+    x1 = _mm_srli_si128( x1, 8 );
+    x1 = _mm_xor_si128( x1, x2 );
+
+    x2 = _mm_srli_si128( x1, 4 );
+    x1 = _mm_and_si128( x1, low32Mask );
+    x1 = _mm_clmulepi64_si128( x1, k5k0, 0x00 );
+    x1 = _mm_xor_si128( x1, x2 );
+
+    // Barrett reduction down to 32
+    x0 = poly;
+    x2 = _mm_and_si128( x1, low32Mask );
+    x2 = _mm_clmulepi64_si128( x2, x0, 0x10 );
+    x2 = _mm_and_si128( x2, low32Mask );
+    x2 = _mm_clmulepi64_si128( x2, x0, 0x00 );
+    x1 = _mm_xor_si128( x1, x2 );
+
+    return (unsigned int)_mm_extract_epi32( x1, 1 );
+    }
+
+#endif
+
+
+
+unsigned int crc32UpdateBytewise( unsigned int inCRC,
+                                  const unsigned char *inData,
+                                  int inDataLength ) {
+    return ~bytewiseKernel( ~inCRC, inData, inDataLength );
+    }
+
+
+
+unsigned int crc32UpdateSliceBy8( unsigned int inCRC,
+                                  const unsigned char *inData,
+                                  int inDataLength ) {
+    return ~sliceBy8Kernel( ~inCRC, inData, inDataLength );
+    }
+
+
+
+unsigned int crc32UpdatePCLMUL( unsigned int inCRC,
+                                const unsigned char *inData,
+                                int inDataLength ) {
+#ifdef CPU_FEATURES_X86
+    if( inDataLength < 64 ) {
+        return crc32UpdateSliceBy8( inCRC, inData, inDataLength );
+        }
+
+    int foldLength = inDataLength & ~15;
+
+    unsigned int crc = pclmulKernel( ~inCRC, inData, foldLength );
+
+    return ~sliceBy8Kernel( crc, inData + foldLength,
+                            inDataLength - foldLength );
+#else
+    return crc32UpdateSliceBy8( inCRC, inData, inDataLength );
+#endif
+    }
+
+
+
+typedef unsigned int ( *CRC32Function )( unsigned int inCRC,
+                                         const unsigned char *inData,
+                                         int inDataLength );
+
+
+static CRC32Function pickCRC32Function() {
+    const CPUFeatures *cpu = getCPUFeatures();
+
+    if( cpu->pclmul && cpu->sse41 ) {
+        return crc32UpdatePCLMUL;
+        }
+    return crc32UpdateSliceBy8;
+    }
+
+
+
+unsigned int crc32Update( unsigned int inCRC,
+                          const unsigned char *inData, int inDataLength ) {
+    static CRC32Function function = pickCRC32Function();
+
+    return function( inCRC, inData, inDataLength );
+    }
+
+
+
+unsigned int crc32( const unsigned char *inData, 
+                    int inDataLength ) {
+    return crc32Update( 0, inData, inDataLength );
     }
@@ -1,4 +1,55 @@
+#ifndef CRC32_INCLUDED
+#define CRC32_INCLUDED
 
 
+
+// CRC-32 as used by zlib, PNG and zip (polynomial 0xedb88320)
+//
+// Uses carry-less multiply folding or slice-by-8 tables, whichever the
+// CPU supports
 unsigned int crc32( const unsigned char *inData, 
                     int inDataLength );
+
+
+
+/**
+ * Continues a CRC-32 over more data.
+ *
+ * crc32Update( crc32( A ), B ) is the same as crc32( AB ), and
+ * crc32Update( 0, A ) is the same as crc32( A ).
+ *
+ * @param inCRC the CRC-32 of the data so far.
+ * @param inData the data to add.  Destroyed by caller.
+ * @param inDataLength the length of the data.
+ *
+ * @return the CRC-32 of all the data.
+ */
+unsigned int crc32Update( unsigned int inCRC,
+                          const unsigned char *inData, int inDataLength );
+
+
+
+// the implementations that crc32Update picks from, for testing and
+// benchmarking
+// each takes the same parameters as crc32Update
+
+// one table lookup per byte
+unsigned int crc32UpdateBytewise( unsigned int inCRC,
+                                  const unsigned char *inData,
+                                  int inDataLength );
+
+// eight lookups per 8 bytes, in independent tables
+// same as bytewise on big-endian CPUs
+unsigned int crc32UpdateSliceBy8( unsigned int inCRC,
+                                  const unsigned char *inData,
+                                  int inDataLength );
+
+// folds 64 bytes at a time with PCLMULQDQ
+// only call if getCPUFeatures() reports pclmul and sse41
+unsigned int crc32UpdatePCLMUL( unsigned int inCRC,
+                                const unsigned char *inData,
+                                int inDataLength );
+
+
+
+#endif
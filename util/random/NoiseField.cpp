@@ -0,0 +1,416 @@
+#include "NoiseField.h"
+
+#include <string.h>
+#include <limits.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+
+
+#define NOISE_X_PRIME 0x8DA6B343U
+#define NOISE_Y_PRIME 0xD8163841U
+
+
+
+// 32-bit finalizer (lowbias32), every input bit affects every output bit
+static inline unsigned int noiseMix( unsigned int inH ) {
+    inH ^= inH >> 16;
+    inH *= 0x7FEB352DU;
+    inH ^= inH >> 15;
+    inH *= 0x846CA68BU;
+    inH ^= inH >> 16;
+    return inH;
+    }
+
+
+
+static inline int floorDiv( int inA, int inB ) {
+    int q = inA / inB;
+    if( inA % inB != 0 && inA < 0 ) {
+        q--;
+        }
+    return q;
+    }
+
+
+
+static inline int roundUpToFour( int inX ) {
+    return ( inX + 3 ) & ~3;
+    }
+
+
+
+// quintic fade, zero first and second derivatives at 0 and 1
+static inline float noiseFade( float inT ) {
+    return inT * inT * inT * ( inT * ( inT * 6 - 15 ) + 10 );
+    }
+
+
+
+static unsigned int octaveKey( unsigned int inSeed, int inOctave ) {
+    return noiseMix( inSeed + (unsigned int)inOctave * 0x9E3779B9U );
+    }
+
+
+
+unsigned int NoiseField::hash( unsigned int inKey, int inX, int inY ) {
+    return noiseMix( (unsigned int)inX * NOISE_X_PRIME ^
+                     (unsigned int)inY * NOISE_Y_PRIME ^ inKey );
+    }
+
+
+
+#ifdef __SSE2__
+
+// SSE2 has no 32-bit low multiply
+static inline __m128i noiseMul32( __m128i inA, __m128i inB ) {
+    __m128i even = _mm_mul_epu32( inA, inB );
+    __m128i odd = _mm_mul_epu32( _mm_srli_epi64( inA, 32 ),
+                                 _mm_srli_epi64( inB, 32 ) );
+    return _mm_unpacklo_epi32(
+        _mm_shuffle_epi32( even, _MM_SHUFFLE( 0, 0, 2, 0 ) ),
+        _mm_shuffle_epi32( odd, _MM_SHUFFLE( 0, 0, 2, 0 ) ) );
+    }
+
+
+
+static inline __m128i noiseMix4( __m128i inH ) {
+    inH = _mm_xor_si128( inH, _mm_srli_epi32( inH, 16 ) );
+    inH = noiseMul32( inH, _mm_set1_epi32( (int)0x7FEB352DU ) );
+    inH = _mm_xor_si128( inH, _mm_srli_epi32( inH, 15 ) );
+    inH = noiseMul32( inH, _mm_set1_epi32( (int)0x846CA68BU ) );
+    inH = _mm_xor_si128( inH, _mm_srli_epi32( inH, 16 ) );
+    return inH;
+    }
+
+#endif
+
+
+
+// lattice values for a row of lattice points
+// value noise fills outA, gradient noise fills outA (x) and outB (y)
+// inNumCols must be a multiple of 4
+static void latticeRow( unsigned int inKey, int inCX, int inCY,
+                        int inNumCols, char inGradient,
+                        float *outA, float *outB ) {
+
+    unsigned int yTerm = (unsigned int)inCY * NOISE_Y_PRIME ^ inKey;
+
+    float valueScale = 1.0f / 8388608.0f;
+    float gradScale = 1.0f / 32768.0f;
+
+#ifdef __SSE2__
+
+    __m128i xs = _mm_setr_epi32( inCX, inCX + 1, inCX + 2, inCX + 3 );
+    __m128i four = _mm_set1_epi32( 4 );
+    __m128i xPrime = _mm_set1_epi32( (int)NOISE_X_PRIME );
+    __m128i yTerms = _mm_set1_epi32( (int)yTerm );
+    __m128i lowMask = _mm_set1_epi32( 0xFFFF );
+
+    __m128 one = _mm_set1_ps( 1.0f );
+    __m128 valueScales = _mm_set1_ps( valueScale );
+    __m128 gradScales = _mm_set1_ps( gradScale );
+
+    for( int i=0; i<inNumCols; i+=4 ) {
+        __m128i h = noiseMix4(
+            _mm_xor_si128( noiseMul32( xs, xPrime ), yTerms ) );
+
+        if( inGradient ) {
+            __m128 gx = _mm_cvtepi32_ps( _mm_and_si128( h, lowMask ) );
+            __m128 gy = _mm_cvtepi32_ps( _mm_srli_epi32( h, 16 ) );
+            _mm_storeu_ps( &( outA[i] ),
+                           _mm_sub_ps( _mm_mul_ps( gx, gradScales ), one ) );
+            _mm_storeu_ps( &( outB[i] ),
+                           _mm_sub_ps( _mm_mul_ps( gy, gradScales ), one ) );
+            }
+        else {
+            __m128 v = _mm_cvtepi32_ps( _mm_srli_epi32( h, 8 ) );
+            _mm_storeu_ps( &( outA[i] ),
+                           _mm_sub_ps( _mm_mul_ps( v, valueScales ), one ) );
+            }
+
+        xs = _mm_add_epi32( xs, four );
+        }
+
+#else
+
+    for( int i=0; i<inNumCols; i++ ) {
+        unsigned int h =
+            noiseMix( (unsigned int)( inCX + i ) * NOISE_X_PRIME ^ yTerm );
+
+        if( inGradient ) {
+            outA[i] = (float)(int)( h & 0xFFFF ) * gradScale - 1.0f;
+            outB[i] = (float)(int)( h >> 16 ) * gradScale - 1.0f;
+            }
+        else {
+            outA[i] = (float)(int)( h >> 8 ) * valueScale - 1.0f;
+            }
+        }
+
+#endif
+    }
+
+
+
+// out += amp * ( (1-u) * left + u * right ), over a multiple of 4 samples
+// where left = f * g0 + c0 and right = (f-1) * g1 + c1
+// (value noise passes NULL gradients, so left = c0 and right = c1)
+static void combineRow( float inAmplitude, int inNumSamples,
+                        float *inF, float *inFMinusOne, float *inU,
+                        float *inG0, float *inC0,
+                        float *inG1, float *inC1,
+                        float *ioValues ) {
+
+#ifdef __SSE2__
+
+    __m128 amp = _mm_set1_ps( inAmplitude );
+    __m128 one = _mm_set1_ps( 1.0f );
+
+    for( int i=0; i<inNumSamples; i+=4 ) {
+        __m128 left = _mm_loadu_ps( &( inC0[i] ) );
+        __m128 right = _mm_loadu_ps( &( inC1[i] ) );
+
+        if( inG0 != NULL ) {
+            left = _mm_add_ps(
+                _mm_mul_ps( _mm_loadu_ps( &( inF[i] ) ),
+                            _mm_loadu_ps( &( inG0[i] ) ) ),
+                left );
+            right = _mm_add_ps(
+                _mm_mul_ps( _mm_loadu_ps( &( inFMinusOne[i] ) ),
+                            _mm_loadu_ps( &( inG1[i] ) ) ),
+                right );
+            }
+
+        __m128 u = _mm_loadu_ps( &( inU[i] ) );
+
+        __m128 n = _mm_add_ps( _mm_mul_ps( _mm_sub_ps( one, u ), left ),
+                               _mm_mul_ps( u, right ) );
+
+        _mm_storeu_ps( &( ioValues[i] ),
+                       _mm_add_ps( _mm_loadu_ps( &( ioValues[i] ) ),
+                                   _mm_mul_ps( amp, n ) ) );
+        }
+
+#else
+
+    for( int i=0; i<inNumSamples; i++ ) {
+        float left = inC0[i];
+        float right = inC1[i];
+
+        if( inG0 != NULL ) {
+            left = inF[i] * inG0[i] + left;
+            right = inFMinusOne[i] * inG1[i] + right;
+            }
+
+        float u = inU[i];
+        float n = ( 1.0f - u ) * left + u * right;
+
+        ioValues[i] = ioValues[i] + inAmplitude * n;
+        }
+
+#endif
+    }
+
+
+
+NoiseField::NoiseField( unsigned int inSeed, int inBaseCellSize,
+                        int inNumOctaves, float inPersistence,
+                        char inGradient )
+        : mSeed( inSeed ), mBaseCellSize( inBaseCellSize ),
+          mNumOctaves( inNumOctaves ), mPersistence( inPersistence ),
+          mGradient( inGradient ) {
+
+    if( mBaseCellSize < 1 ) {
+        mBaseCellSize = 1;
+        }
+    if( mNumOctaves < 1 ) {
+        mNumOctaves = 1;
+        }
+    }
+
+
+
+void NoiseField::addOctave( int inOctave, int inCellSize, float inAmplitude,
+                            int inX, int inY, int inHeight,
+                            int inStride, float *ioValues ) {
+
+    int c = inCellSize;
+    float invC = 1.0f / (float)c;
+
+    unsigned int key = octaveKey( mSeed, inOctave );
+
+
+    // lattice columns touched by the padded rows, plus one on the right
+    int firstCX = floorDiv( inX, c );
+    int lastCX = floorDiv( inX + inStride - 1, c ) + 1;
+    int numCols = roundUpToFour( lastCX - firstCX + 1 );
+
+
+    // per-sample x terms, which depend only on the global x coordinate
+    int *colIndex = new int[ inStride ];
+    float *fx = new float[ inStride ];
+    float *fxMinusOne = new float[ inStride ];
+    float *ux = new float[ inStride ];
+
+    for( int i=0; i<inStride; i++ ) {
+        int x = inX + i;
+        int cx = floorDiv( x, c );
+
+        colIndex[i] = cx - firstCX;
+        fx[i] = (float)( x - cx * c ) * invC;
+        fxMinusOne[i] = fx[i] - 1.0f;
+        ux[i] = noiseFade( fx[i] );
+        }
+
+
+    // lattice rows above and below the current sample row
+    float *topA = new float[ numCols ];
+    float *topB = new float[ numCols ];
+    float *bottomA = new float[ numCols ];
+    float *bottomB = new float[ numCols ];
+
+    // lattice rows blended for the current sample row
+    float *mixG = new float[ numCols ];
+    float *mixC = new float[ numCols ];
+
+    // blended values gathered out to each sample
+    float *g0 = new float[ inStride ];
+    float *c0 = new float[ inStride ];
+    float *g1 = new float[ inStride ];
+    float *c1 = new float[ inStride ];
+
+    int currentCY = INT_MIN;
+
+    for( int j=0; j<inHeight; j++ ) {
+        int y = inY + j;
+        int cy = floorDiv( y, c );
+
+        if( cy != currentCY ) {
+            if( currentCY != INT_MIN && cy == currentCY + 1 ) {
+                float *temp = topA;
+                topA = bottomA;
+                bottomA = temp;
+                temp = topB;
+                topB = bottomB;
+                bottomB = temp;
+                }
+            else {
+                latticeRow( key, firstCX, cy, numCols, mGradient,
+                            topA, topB );
+                }
+            latticeRow( key, firstCX, cy + 1, numCols, mGradient,
+                        bottomA, bottomB );
+            currentCY = cy;
+            }
+
+        float fy = (float)( y - cy * c ) * invC;
+        float uy = noiseFade( fy );
+        float vy = 1.0f - uy;
+
+        if( mGradient ) {
+            float fyMinusOne = fy - 1.0f;
+
+            for( int i=0; i<numCols; i++ ) {
+                mixG[i] = vy * topA[i] + uy * bottomA[i];
+                mixC[i] = vy * ( topB[i] * fy ) +
+                    uy * ( bottomB[i] * fyMinusOne );
+                }
+
+            for( int i=0; i<inStride; i++ ) {
+                int k = colIndex[i];
+                g0[i] = mixG[k];
+                c0[i] = mixC[k];
+                g1[i] = mixG[ k + 1 ];
+                c1[i] = mixC[ k + 1 ];
+                }
+
+            combineRow( inAmplitude, inStride, fx, fxMinusOne, ux,
+                        g0, c0, g1, c1, &( ioValues[ j * inStride ] ) );
+            }
+        else {
+            for( int i=0; i<numCols; i++ ) {
+                mixC[i] = vy * topA[i] + uy * bottomA[i];
+                }
+
+            for( int i=0; i<inStride; i++ ) {
+                int k = colIndex[i];
+                c0[i] = mixC[k];
+                c1[i] = mixC[ k + 1 ];
+                }
+
+            combineRow( inAmplitude, inStride, fx, fxMinusOne, ux,
+                        NULL, c0, NULL, c1, &( ioValues[ j * inStride ] ) );
+            }
+        }
+
+    delete [] colIndex;
+    delete [] fx;
+    delete [] fxMinusOne;
+    delete [] ux;
+    delete [] topA;
+    delete [] topB;
+    delete [] bottomA;
+    delete [] bottomB;
+    delete [] mixG;
+    delete [] mixC;
+    delete [] g0;
+    delete [] c0;
+    delete [] g1;
+    delete [] c1;
+    }
+
+
+
+void NoiseField::fillRect( int inX, int inY, int inWidth, int inHeight,
+                           float *outValues ) {
+
+    if( inWidth <= 0 || inHeight <= 0 ) {
+        return;
+        }
+
+    // rows padded so every sample goes through the same vector code,
+    // whatever its position in the rectangle
+    int stride = roundUpToFour( inWidth );
+
+    float *values = new float[ stride * inHeight ];
+    memset( values, 0, sizeof( float ) * stride * inHeight );
+
+
+    float totalAmplitude = 0;
+    float amplitude = 1;
+    for( int o=0; o<mNumOctaves; o++ ) {
+        totalAmplitude += amplitude;
+        amplitude *= mPersistence;
+        }
+
+    amplitude = 1;
+    int cellSize = mBaseCellSize;
+
+    for( int o=0; o<mNumOctaves; o++ ) {
+        addOctave( o, cellSize, amplitude / totalAmplitude,
+                   inX, inY, inHeight, stride, values );
+
+        amplitude *= mPersistence;
+        if( cellSize > 1 ) {
+            cellSize /= 2;
+            }
+        }
+
+
+    for( int j=0; j<inHeight; j++ ) {
+        memcpy( &( outValues[ j * inWidth ] ), &( values[ j * stride ] ),
+                sizeof( float ) * inWidth );
+        }
+
+    delete [] values;
+    }
+
+
+
+float NoiseField::getValue( int inX, int inY ) {
+    float value;
+    fillRect( inX, inY, 1, 1, &value );
+    return value;
+    }
@@ -0,0 +1,90 @@
+#ifndef NOISE_FIELD_INCLUDED
+#define NOISE_FIELD_INCLUDED
+
+
+
+/**
+ * Multi-octave value or gradient noise over an unbounded integer grid.
+ *
+ * Lattice values come from a counter-based hash of (seed, octave, x, y)
+ * instead of a RandomSource stream, so there is no state shared between
+ * calls:  any rectangle of the field can be filled on its own, in any
+ * order and on any thread, and neighboring rectangles line up exactly.
+ * A sample's value is bit-for-bit the same no matter which rectangle it
+ * is generated as part of.
+ *
+ * Unlike genFractalNoise2d, sizes do not need to be powers of two, and
+ * a large field never needs to be generated all at once.
+ *
+ * Interpolation and octave accumulation use SSE2 where available.
+ */
+class NoiseField {
+
+    public:
+
+        /**
+         * Constructs a field.
+         *
+         * @param inSeed seed for the whole field.
+         * @param inBaseCellSize the spacing, in samples, between lattice
+         *   points of the first (coarsest) octave.  Each later octave
+         *   halves the spacing, down to a minimum of 1.
+         * @param inNumOctaves the number of octaves to sum.
+         * @param inPersistence amplitude of each octave relative to the
+         *   one before it.  0.5 gives 1/f noise.
+         * @param inGradient true for gradient (Perlin-style) noise, false
+         *   for value noise.
+         */
+        NoiseField( unsigned int inSeed, int inBaseCellSize,
+                    int inNumOctaves, float inPersistence = 0.5f,
+                    char inGradient = true );
+
+
+        /**
+         * Fills a rectangle of the field.  Values are in roughly [-1,1],
+         * with octave amplitudes normalized to sum to 1.
+         *
+         * Safe to call from several threads at once.
+         *
+         * @param inX, inY the field coordinates of the rectangle's
+         *   top-left sample.  May be negative.
+         * @param inWidth, inHeight the rectangle size.
+         * @param outValues inWidth*inHeight row-major values.  Must be
+         *   destroyed by caller.
+         */
+        void fillRect( int inX, int inY, int inWidth, int inHeight,
+                       float *outValues );
+
+
+        // fills a single sample, same value fillRect would produce
+        float getValue( int inX, int inY );
+
+
+
+        /**
+         * The lattice hash, exposed for callers that want other noise
+         * shapes from the same seed.
+         *
+         * @return 32 well-mixed bits for the given key and coordinates.
+         */
+        static unsigned int hash( unsigned int inKey, int inX, int inY );
+
+
+    protected:
+
+        unsigned int mSeed;
+        int mBaseCellSize;
+        int mNumOctaves;
+        float mPersistence;
+        char mGradient;
+
+
+        // adds one octave into a padded rectangle
+        void addOctave( int inOctave, int inCellSize, float inAmplitude,
+                        int inX, int inY, int inHeight,
+                        int inStride, float *ioValues );
+    };
+
+
+
+#endif
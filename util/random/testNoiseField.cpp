@@ -0,0 +1,197 @@
+// Checks that NoiseField tiles line up exactly with larger rectangles,
+// fills a world in parallel tiles, and times NoiseField against
+// genFractalNoise2d.
+//
+// Usage:  testNoiseField [numThreads]
+
+
+#include "NoiseField.h"
+#include "Noise.h"
+
+#include "minorGems/system/Time.h"
+#include "minorGems/system/ThreadPool.h"
+#include "minorGems/util/random/CustomRandomSource.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+
+// fills inRect in uneven tiles and compares to one big fill
+static int checkTiles( NoiseField *inField, int inX, int inY,
+                       int inW, int inH, int inTileW, int inTileH ) {
+
+    float *whole = new float[ inW * inH ];
+    inField->fillRect( inX, inY, inW, inH, whole );
+
+    float *tile = new float[ inTileW * inTileH ];
+
+    int numBad = 0;
+
+    for( int ty=0; ty<inH; ty+=inTileH ) {
+        for( int tx=0; tx<inW; tx+=inTileW ) {
+            int w = inTileW;
+            int h = inTileH;
+            if( tx + w > inW ) {
+                w = inW - tx;
+                }
+            if( ty + h > inH ) {
+                h = inH - ty;
+                }
+
+            inField->fillRect( inX + tx, inY + ty, w, h, tile );
+
+            for( int y=0; y<h; y++ ) {
+                if( memcmp( &( tile[ y * w ] ),
+                            &( whole[ ( ty + y ) * inW + tx ] ),
+                            sizeof( float ) * w ) != 0 ) {
+                    numBad++;
+                    }
+                }
+            }
+        }
+
+    // and single samples
+    for( int i=0; i<50; i++ ) {
+        int x = ( i * 37 ) % inW;
+        int y = ( i * 53 ) % inH;
+        float v = inField->getValue( inX + x, inY + y );
+        if( memcmp( &v, &( whole[ y * inW + x ] ), sizeof( float ) ) != 0 ) {
+            numBad++;
+            }
+        }
+
+    delete [] whole;
+    delete [] tile;
+
+    return numBad;
+    }
+
+
+
+class NoiseTileJob : public ThreadPoolJob {
+    public:
+        NoiseField *mField;
+        int mX, mY, mW, mH;
+        int mWorldW;
+        float *mWorld;
+
+        virtual void runJob() {
+            float *tile = new float[ mW * mH ];
+            mField->fillRect( mX, mY, mW, mH, tile );
+
+            for( int y=0; y<mH; y++ ) {
+                memcpy( &( mWorld[ ( mY + y ) * mWorldW + mX ] ),
+                        &( tile[ y * mW ] ), sizeof( float ) * mW );
+                }
+            delete [] tile;
+            }
+    };
+
+
+
+int main( int inNumArgs, char **inArgs ) {
+
+    int numThreads = -1;
+    if( inNumArgs > 1 ) {
+        numThreads = atoi( inArgs[1] );
+        }
+
+    int numBad = 0;
+
+    for( int g=0; g<2; g++ ) {
+        NoiseField field( 1234, 64, 6, 0.5f, g );
+
+        int bad = checkTiles( &field, -150, -77, 301, 203, 37, 23 ) +
+            checkTiles( &field, 1000000, -2000000, 130, 90, 64, 64 ) +
+            checkTiles( &field, -3, -5, 17, 9, 1, 1 );
+
+        printf( "%s noise, tiles match whole rectangles:  %s\n",
+                g ? "gradient" : "value", bad == 0 ? "ok" : "MISMATCH" );
+        numBad += bad;
+        }
+
+
+    int size = 1024;
+    int numOctaves = 8;
+    float *world = new float[ size * size ];
+
+    NoiseField field( 99, 256, numOctaves, 0.5f, true );
+
+    double t = Time::getCurrentTime();
+    field.fillRect( 0, 0, size, size, world );
+    double fieldTime = Time::getCurrentTime() - t;
+
+    float minV = world[0];
+    float maxV = world[0];
+    double sum = 0;
+    for( int i=0; i<size*size; i++ ) {
+        if( world[i] < minV ) {
+            minV = world[i];
+            }
+        if( world[i] > maxV ) {
+            maxV = world[i];
+            }
+        sum += world[i];
+        }
+    printf( "\n%dx%d, %d octaves:  range [%.3f, %.3f], mean %.4f\n",
+            size, size, numOctaves, minV, maxV, sum / ( size * size ) );
+
+
+    // same world as 64x64 chunks across a pool
+    ThreadPool pool( numThreads );
+
+    float *tiledWorld = new float[ size * size ];
+
+    int chunk = 64;
+    int numChunks = ( size / chunk ) * ( size / chunk );
+    NoiseTileJob *jobs = new NoiseTileJob[ numChunks ];
+
+    t = Time::getCurrentTime();
+    for( int i=0; i<numChunks; i++ ) {
+        jobs[i].mField = &field;
+        jobs[i].mX = ( i % ( size / chunk ) ) * chunk;
+        jobs[i].mY = ( i / ( size / chunk ) ) * chunk;
+        jobs[i].mW = chunk;
+        jobs[i].mH = chunk;
+        jobs[i].mWorldW = size;
+        jobs[i].mWorld = tiledWorld;
+        pool.addJob( &( jobs[i] ) );
+        }
+    pool.waitForAllJobs();
+    double tiledTime = Time::getCurrentTime() - t;
+
+    int tiledBad = 0;
+    if( memcmp( world, tiledWorld, sizeof( float ) * size * size ) != 0 ) {
+        tiledBad = 1;
+        }
+    numBad += tiledBad;
+
+
+    double *oldBuffer = new double[ size * size ];
+    CustomRandomSource randSource( 99 );
+
+    t = Time::getCurrentTime();
+    genFractalNoise2d( oldBuffer, size, 256, 1.0, true, &randSource );
+    double oldTime = Time::getCurrentTime() - t;
+
+    printf( "genFractalNoise2d:                   %8.1f ms\n",
+            1000 * oldTime );
+    printf( "NoiseField, one rectangle:           %8.1f ms\n",
+            1000 * fieldTime );
+    printf( "NoiseField, %3d chunks, %2d threads:  %8.1f ms  %s\n",
+            numChunks, pool.getNumThreads(), 1000 * tiledTime,
+            tiledBad == 0 ? "ok" : "MISMATCH" );
+
+    delete [] jobs;
+    delete [] world;
+    delete [] tiledWorld;
+    delete [] oldBuffer;
+
+    if( numBad != 0 ) {
+        printf( "FAILED\n" );
+        return 1;
+        }
+    return 0;
+    }